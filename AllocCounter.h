@@ -0,0 +1,88 @@
+//----------------------------------------------------------------------------------
+//	Heap allocation counter (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Counts operator new calls per thread so a code path can be checked for
+// "no heap allocation once warm". Counting only happens in a module that
+// expands FONTPREVIEW_DEFINE_ALLOC_COUNTER() once at namespace scope (the
+// bench always does, the plugin when FONTPREVIEW_ALLOC_COUNTER is 1);
+// elsewhere Scope reports zero and Installed() is false.
+#ifndef FONTPREVIEW_ALLOC_COUNTER
+#if defined(_DEBUG)
+#define FONTPREVIEW_ALLOC_COUNTER 1
+#else
+#define FONTPREVIEW_ALLOC_COUNTER 0
+#endif
+#endif
+
+namespace AllocCounter
+{
+	struct ThreadCounts
+	{
+		uint64_t count = 0;
+		uint64_t bytes = 0;
+	};
+
+	// Per thread, so background tasks allocating meanwhile do not show up
+	// in a UI-thread measurement.
+	inline ThreadCounts &Current()
+	{
+		static thread_local ThreadCounts counts;
+		return counts;
+	}
+
+	inline bool &InstalledFlag()
+	{
+		static bool installed = false;
+		return installed;
+	}
+
+	inline bool Installed() { return InstalledFlag(); }
+
+	inline void Record(size_t bytes)
+	{
+		ThreadCounts &c = Current();
+		c.count++;
+		c.bytes += bytes;
+	}
+
+	// Allocations made by the current thread since construction.
+	class Scope
+	{
+	public:
+		Scope() : m_start(Current()) {}
+
+		uint64_t Allocations() const { return Current().count - m_start.count; }
+		uint64_t Bytes() const { return Current().bytes - m_start.bytes; }
+
+	private:
+		ThreadCounts m_start;
+	};
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC reports malloc/free inside replaced operators as mismatched once inlined.
+#define FONTPREVIEW_ALLOC_COUNTER_DIAGNOSTICS _Pragma("GCC diagnostic ignored \"-Wmismatched-new-delete\"")
+#else
+#define FONTPREVIEW_ALLOC_COUNTER_DIAGNOSTICS
+#endif
+
+// Replaces the global operator new/delete of the including module. The
+// array and nothrow forms forward to these by default.
+#define FONTPREVIEW_DEFINE_ALLOC_COUNTER()                                      \
+	FONTPREVIEW_ALLOC_COUNTER_DIAGNOSTICS                                       \
+	void *operator new(std::size_t size)                                        \
+	{                                                                           \
+		AllocCounter::Record(size);                                             \
+		if (void *p = std::malloc(size ? size : 1))                             \
+			return p;                                                           \
+		throw std::bad_alloc();                                                 \
+	}                                                                           \
+	void operator delete(void *p) noexcept { std::free(p); }                    \
+	void operator delete(void *p, std::size_t) noexcept { std::free(p); }       \
+	static const bool fpAllocCounterInstalled_ = (AllocCounter::InstalledFlag() = true)
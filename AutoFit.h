@@ -0,0 +1,248 @@
+//----------------------------------------------------------------------------------
+//	Auto-fit text size from cached metrics (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+// The single-line preview can pick the largest size at which the sample
+// text fits the pane instead of a fixed 48 DIPs. Laying the text out once
+// per candidate size would cost a full DirectWrite layout per search step;
+// instead the text is measured once per font and text at a reference size
+// (cluster advances, break opportunities, line height) and every candidate
+// size is checked by scaling those and wrapping them greedily, which is
+// allocation-free and linear in the number of words. Only the chosen size
+// gets a real layout. A resize searches again starting from the previous
+// answer (Refit), since the fit is monotone in the pane's width and height.
+namespace AutoFit
+{
+	// Per text cluster, as reported by the layout.
+	enum ClusterFlags : uint8_t
+	{
+		kCanBreakAfter = 1 << 0,
+		kMustBreakAfter = 1 << 1, // hard line break
+		kWhitespace = 1 << 2,	  // hangs past the right edge
+	};
+
+	// Unbreakable run of clusters ending at a break opportunity.
+	struct Word
+	{
+		float ink = 0.0f;	// without trailing whitespace
+		float total = 0.0f; // with it
+		bool mustBreak = false;
+	};
+
+	// A text measured at one DIP per em; everything scales with the size.
+	class Metrics
+	{
+	public:
+		// Widths at `referenceSize`, one per cluster, and the height of one
+		// line at that size.
+		void Assign(const float *widths, const uint8_t *flags, size_t clusters, float lineHeight, float referenceSize)
+		{
+			float scale = referenceSize > 0.0f ? 1.0f / referenceSize : 0.0f;
+			m_words.clear();
+			m_lineHeight = lineHeight * scale;
+			m_longest = 0.0f;
+			Word word;
+			for (size_t i = 0; i < clusters; i++)
+			{
+				float w = widths[i] * scale;
+				word.total += w;
+				if ((flags[i] & kWhitespace) == 0)
+					word.ink = word.total;
+				bool must = (flags[i] & kMustBreakAfter) != 0;
+				if (must || (flags[i] & kCanBreakAfter) != 0 || i + 1 == clusters)
+				{
+					word.mustBreak = must;
+					m_longest = (std::max)(m_longest, word.ink);
+					m_words.push_back(word);
+					word = Word{};
+				}
+			}
+			m_words.shrink_to_fit();
+		}
+
+		const std::vector<Word> &Words() const { return m_words; }
+		float LineHeight() const { return m_lineHeight; }
+		float LongestWord() const { return m_longest; }
+		bool Empty() const { return m_words.empty() || m_lineHeight <= 0.0f; }
+		size_t Bytes() const { return sizeof(*this) + m_words.capacity() * sizeof(Word); }
+
+	private:
+		std::vector<Word> m_words;
+		float m_lineHeight = 0.0f;
+		float m_longest = 0.0f;
+	};
+
+	// Lines the text wraps to at `size` in `maxWidth`, or maxLines + 1 as
+	// soon as it needs more (or a word alone is wider than the box, which
+	// would break inside the word).
+	inline int CountLines(const Metrics &m, float size, float maxWidth, int maxLines)
+	{
+		int lines = 1;
+		float x = 0.0f;
+		for (const Word &w : m.Words())
+		{
+			float ink = w.ink * size;
+			if (ink > maxWidth)
+				return maxLines + 1;
+			if (x > 0.0f && x + ink > maxWidth)
+			{
+				if (++lines > maxLines)
+					return lines;
+				x = 0.0f;
+			}
+			x += w.total * size;
+			if (w.mustBreak)
+			{
+				if (++lines > maxLines)
+					return lines;
+				x = 0.0f;
+			}
+		}
+		return lines;
+	}
+
+	inline bool Fits(const Metrics &m, float size, float width, float height)
+	{
+		if (m.Empty() || size <= 0.0f)
+			return false;
+		int maxLines = (int)std::floor(height / (m.LineHeight() * size));
+		return maxLines >= 1 && CountLines(m, size, width, maxLines) <= maxLines;
+	}
+
+	struct Options
+	{
+		float minSize = 8.0f;	// DIPs; used when even this does not fit
+		float maxSize = 400.0f; // DIPs
+		float precision = 0.25f;
+	};
+
+	struct Result
+	{
+		float size = 0.0f;
+		int steps = 0; // Fits calls
+		bool fits = false;
+	};
+
+	// The previous answer and the box it was for.
+	struct Last
+	{
+		float width = 0.0f;
+		float height = 0.0f;
+		float size = 0.0f;
+		bool fits = false;
+	};
+
+	namespace detail
+	{
+		// Bisect [lo, hi) with lo known to fit and hi known not to (or
+		// past the upper bound).
+		inline Result Bisect(const Metrics &m, float width, float height, float lo, float hi, float precision, int steps)
+		{
+			while (hi - lo > precision)
+			{
+				float mid = (lo + hi) * 0.5f;
+				steps++;
+				if (Fits(m, mid, width, height))
+					lo = mid;
+				else
+					hi = mid;
+			}
+			return Result{lo, steps, true};
+		}
+
+		// Sizes above these can never fit: one line must fit vertically and
+		// the longest word horizontally.
+		inline float UpperBound(const Metrics &m, float width, float height, const Options &o)
+		{
+			float hi = (std::min)(o.maxSize, height / m.LineHeight());
+			if (m.LongestWord() > 0.0f)
+				hi = (std::min)(hi, width / m.LongestWord());
+			return hi;
+		}
+	}
+
+	// Largest size in [minSize, maxSize] (to `precision`) at which the text
+	// fits `width` x `height`; minSize with fits = false when none does.
+	inline Result Search(const Metrics &m, float width, float height, const Options &o = Options{})
+	{
+		if (m.Empty())
+			return Result{o.minSize, 0, false};
+		float hi = detail::UpperBound(m, width, height, o);
+		if (hi < o.minSize || !Fits(m, o.minSize, width, height))
+			return Result{o.minSize, 1, false};
+		if (Fits(m, hi, width, height))
+			return Result{hi, 2, true};
+		return detail::Bisect(m, width, height, o.minSize, hi, o.precision, 2);
+	}
+
+	// Search for a new box starting from the last answer: a box at least as
+	// large in both directions still fits the last size, so only larger
+	// sizes are probed; otherwise the last size is checked and the search
+	// gallops down from it. Probes grow in doubling steps from 1/16 of the
+	// last size, so a small drag costs a few probes plus a short bisection.
+	inline Result Refit(const Metrics &m, float width, float height, const Last &last, const Options &o = Options{})
+	{
+		if (m.Empty() || !last.fits || last.size <= 0.0f)
+			return Search(m, width, height, o);
+		if (width == last.width && height == last.height)
+			return Result{last.size, 0, true};
+		float hi = detail::UpperBound(m, width, height, o);
+		if (hi < o.minSize)
+			return Result{o.minSize, 0, false};
+		float start = (std::min)(last.size, hi);
+		bool grew = width >= last.width && height >= last.height;
+		int steps = 0;
+		bool startFits = grew && start == last.size;
+		if (!startFits)
+		{
+			steps++;
+			startFits = Fits(m, start, width, height);
+		}
+		float step = (std::max)(o.precision, start * 0.0625f);
+		if (startFits)
+		{
+			// Gallop upwards until a size does not fit.
+			float lo = start;
+			while (true)
+			{
+				float probe = lo + step;
+				if (probe >= hi)
+				{
+					steps++;
+					if (Fits(m, hi, width, height))
+						return Result{hi, steps, true};
+					return detail::Bisect(m, width, height, lo, hi, o.precision, steps);
+				}
+				steps++;
+				if (!Fits(m, probe, width, height))
+					return detail::Bisect(m, width, height, lo, probe, o.precision, steps);
+				lo = probe;
+				step *= 2.0f;
+			}
+		}
+		// Gallop downwards until a size fits.
+		float upper = start;
+		while (true)
+		{
+			float probe = upper - step;
+			if (probe <= o.minSize)
+			{
+				steps++;
+				if (!Fits(m, o.minSize, width, height))
+					return Result{o.minSize, steps, false};
+				return detail::Bisect(m, width, height, o.minSize, upper, o.precision, steps);
+			}
+			steps++;
+			if (Fits(m, probe, width, height))
+				return detail::Bisect(m, width, height, probe, upper, o.precision, steps);
+			upper = probe;
+			step *= 2.0f;
+		}
+	}
+}
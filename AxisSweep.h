@@ -0,0 +1,224 @@
+//----------------------------------------------------------------------------------
+//	Axis-sweep animation: keyframes, frame ring and playback pacing (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+// A sweep animates variation axes from their minimum to their maximum and
+// back. The loop is cut into a fixed number of keyframes that are rendered
+// ahead of time (on workers, in any order) into a FrameRing. Playback then
+// only picks a finished frame: the Pacer maps the wall clock to a keyframe,
+// so late timer ticks skip frames instead of slowing the animation down,
+// and records how far each presented frame was from its slot.
+namespace AxisSweep
+{
+	constexpr int kMinFrames = 2;
+	constexpr int kMaxFrames = 120;
+
+	// Triangle wave over one loop: 0 at frame 0, 1 at the middle, and back
+	// towards 0, so the last frame runs seamlessly into the first.
+	inline float Phase(int frame, int frameCount)
+	{
+		if (frameCount < 2)
+			return 0.0f;
+		// Distance from frame 0 in whole frames keeps k and frameCount-k
+		// bit-identical.
+		int pos = ((frame % frameCount) + frameCount) % frameCount;
+		int fromStart = (std::min)(pos, frameCount - pos);
+		return (std::min)(1.0f, 2.0f * (float)fromStart / (float)frameCount);
+	}
+
+	inline float KeyframeValue(float from, float to, int frame, int frameCount)
+	{
+		return from + (to - from) * Phase(frame, frameCount);
+	}
+
+	// Keyframes that fit `budgetBytes` at `frameBytes` each, clamped to
+	// [kMinFrames, maxFrames]; 0 when not even kMinFrames fit.
+	inline int FrameCountFor(size_t frameBytes, size_t budgetBytes, int maxFrames = kMaxFrames)
+	{
+		if (frameBytes == 0)
+			return 0;
+		size_t fit = budgetBytes / frameBytes;
+		if (fit < (size_t)kMinFrames)
+			return 0;
+		return (int)(std::min)(fit, (size_t)(std::max)(kMinFrames, (std::min)(maxFrames, kMaxFrames)));
+	}
+
+	// Fixed set of keyframe slots filled out of order by producers. Reading a
+	// frame is valid once Complete() returned true on the reading thread.
+	template <typename T>
+	class FrameRing
+	{
+	public:
+		// Drop every frame and size the ring for a new sweep; returns the
+		// generation producers must pass to Store.
+		uint32_t Reset(int frameCount)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_frames.clear();
+			m_frames.resize(frameCount > 0 ? (size_t)frameCount : 0);
+			m_ready.assign(m_frames.size(), 0);
+			m_readyCount = 0;
+			m_bytes = 0;
+			return ++m_generation;
+		}
+
+		// Park a finished keyframe. Stale generations and repeats are
+		// ignored; returns true when this completes the ring.
+		bool Store(uint32_t generation, int index, T frame, size_t bytes)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (generation != m_generation || index < 0 || index >= (int)m_frames.size() || m_ready[index])
+				return false;
+			m_frames[index] = std::move(frame);
+			m_ready[index] = 1;
+			m_readyCount++;
+			m_bytes += bytes;
+			return m_readyCount == (int)m_frames.size();
+		}
+
+		bool Complete() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return !m_frames.empty() && m_readyCount == (int)m_frames.size();
+		}
+
+		int ReadyCount() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_readyCount;
+		}
+
+		int FrameCount() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return (int)m_frames.size();
+		}
+
+		size_t Bytes() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_bytes;
+		}
+
+		const T &Frame(int index) const { return m_frames[(size_t)index]; }
+
+	private:
+		mutable std::mutex m_mutex;
+		std::vector<T> m_frames;
+		std::vector<uint8_t> m_ready;
+		int m_readyCount = 0;
+		size_t m_bytes = 0;
+		uint32_t m_generation = 0;
+	};
+
+	// Wall-clock playback at a fixed rate with per-frame jitter samples.
+	// Tick may be called more often than the frame rate; it reports a new
+	// frame only when the clock moved into another slot. Allocation-free.
+	class Pacer
+	{
+	public:
+		static constexpr int kSampleCount = 512;
+
+		struct Stats
+		{
+			uint64_t presented = 0;
+			uint64_t dropped = 0; // keyframes skipped because a tick came late
+			uint64_t pauses = 0;
+			double p50JitterMs = 0.0;
+			double p95JitterMs = 0.0;
+			double maxJitterMs = 0.0;
+			double meanIntervalMs = 0.0;
+		};
+
+		void Start(double fps, int frameCount, double nowMs)
+		{
+			m_periodMs = fps > 0.0 ? 1000.0 / fps : 1000.0 / 30.0;
+			m_frameCount = frameCount > 0 ? frameCount : 1;
+			m_startMs = nowMs;
+			m_lastSlot = -1;
+			m_lastPresentMs = -1.0;
+			m_intervalSumMs = 0.0;
+			m_intervals = 0;
+			m_sampleCount = 0;
+			m_sampleNext = 0;
+			m_stats = Stats{};
+		}
+
+		double PeriodMs() const { return m_periodMs; }
+
+		// Returns the keyframe to present at `nowMs`, or -1 when the current
+		// one is still on screen.
+		int Tick(double nowMs)
+		{
+			int64_t slot = (int64_t)std::floor((nowMs - m_startMs) / m_periodMs);
+			if (slot < 0)
+				slot = 0;
+			if (slot == m_lastSlot)
+				return -1;
+			if (m_lastSlot >= 0 && slot > m_lastSlot + 1)
+				m_stats.dropped += (uint64_t)(slot - m_lastSlot - 1);
+			if (m_lastPresentMs >= 0.0)
+			{
+				double interval = nowMs - m_lastPresentMs;
+				m_intervalSumMs += interval;
+				m_intervals++;
+				// Jitter: distance from the ideal presentation time of the slot.
+				double ideal = m_startMs + (double)slot * m_periodMs;
+				m_samples[m_sampleNext] = (float)(nowMs - ideal);
+				m_sampleNext = (m_sampleNext + 1) % kSampleCount;
+				if (m_sampleCount < kSampleCount)
+					m_sampleCount++;
+			}
+			m_lastSlot = slot;
+			m_lastPresentMs = nowMs;
+			m_stats.presented++;
+			return (int)(slot % m_frameCount);
+		}
+
+		// Playback was held (window hidden): the gap is neither jitter nor
+		// dropped frames. The animation continues from the clock on resume.
+		void Pause()
+		{
+			if (m_lastPresentMs < 0.0)
+				return;
+			m_stats.pauses++;
+			m_lastPresentMs = -1.0;
+			m_lastSlot = -1;
+		}
+
+		Stats GetStats() const
+		{
+			Stats s = m_stats;
+			s.meanIntervalMs = m_intervals ? m_intervalSumMs / (double)m_intervals : 0.0;
+			if (m_sampleCount == 0)
+				return s;
+			float sorted[kSampleCount];
+			std::copy(m_samples, m_samples + m_sampleCount, sorted);
+			std::sort(sorted, sorted + m_sampleCount);
+			s.p50JitterMs = sorted[(m_sampleCount - 1) / 2];
+			s.p95JitterMs = sorted[(size_t)((m_sampleCount - 1) * 0.95)];
+			s.maxJitterMs = sorted[m_sampleCount - 1];
+			return s;
+		}
+
+	private:
+		double m_periodMs = 1000.0 / 30.0;
+		int m_frameCount = 1;
+		double m_startMs = 0.0;
+		int64_t m_lastSlot = -1;
+		double m_lastPresentMs = -1.0;
+		double m_intervalSumMs = 0.0;
+		uint64_t m_intervals = 0;
+		float m_samples[kSampleCount] = {};
+		int m_sampleCount = 0;
+		int m_sampleNext = 0;
+		Stats m_stats;
+	};
+}
@@ -0,0 +1,244 @@
+//----------------------------------------------------------------------------------
+//	Batched, diffed font replacement on timeline objects (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <climits>
+#include <string>
+#include <vector>
+
+// Replacing a font on many objects happens inside one edit section: the
+// objects in a layer / frame range are collected first, then written. Each
+// object is written only through the effects it actually has (standard
+// text, this plugin's Variable Font Text) and only where the stored value
+// differs, so re-applying the same font costs reads and no writes. The
+// functions are templates over the host's EDIT_SECTION so the benchmark can
+// drive them with a stub; they use find_object, get_object_layer_frame,
+// get_object_item_value and set_object_item_value (SelectedLayers also the
+// selection and focus getters), and read the effect an object has from
+// get_object_item_value returning null.
+namespace BatchEdit
+{
+	constexpr const wchar_t *kTextEffect = L"テキスト";
+	constexpr const wchar_t *kVFEffect = L"Variable Font Text";
+	constexpr const wchar_t *kFontItem = L"フォント";
+	constexpr const wchar_t *kFileItem = L"フォントファイル";
+
+	// A font the way objects store it, UTF-8: a system family name, or a
+	// font file (the Variable Font Text effect only).
+	struct FontRef
+	{
+		std::string name;
+		std::string file;
+
+		bool Empty() const { return name.empty() && file.empty(); }
+		bool IsFile() const { return !file.empty(); }
+	};
+
+	// What a standard text object stores as `name`, or a Variable Font
+	// Text object as `name` / `file` (a file wins when both are set).
+	inline bool Matches(const FontRef &font, const char *name, const char *file)
+	{
+		if (file && *file)
+			return font.IsFile() && font.file == file;
+		return !font.IsFile() && name && font.name == name;
+	}
+
+	struct Replacement
+	{
+		bool anyFont = false; // every text object, whatever its font
+		FontRef from;		  // otherwise only objects using this font
+		FontRef to;
+	};
+
+	// Layers and frames are inclusive; layerLast < 0 means up to the
+	// section's info->layer_max.
+	struct Scope
+	{
+		int layerFirst = 0;
+		int layerLast = -1;
+		int frameFirst = 0;
+		int frameLast = INT_MAX;
+	};
+
+	template <typename Object>
+	struct Write
+	{
+		Object object;
+		const wchar_t *effect;
+		const wchar_t *item;
+		const char *value; // points into the Replacement
+	};
+
+	struct Stats
+	{
+		size_t scanned = 0;		// objects visited
+		size_t matched = 0;		// text objects using the source font
+		size_t changed = 0;		// objects that needed at least one write
+		size_t writes = 0;		// set_object_item_value calls issued
+		size_t failed = 0;		// of those, rejected by the host
+		size_t unchanged = 0;	// matched items already holding the value
+		size_t unsupported = 0; // standard text asked to take a font file
+	};
+
+	// Writes for one object, appended to `out`. Returns true when the
+	// object has a text effect using the source font.
+	template <typename Edit, typename Object>
+	bool PlanObject(Edit *edit, Object object, const Replacement &r, std::vector<Write<Object>> &out, Stats &stats)
+	{
+		size_t before = out.size();
+		bool matched = false;
+		auto diff = [&](const wchar_t *effect, const wchar_t *item, const char *current, const std::string &wanted)
+		{
+			if (wanted == current)
+				stats.unchanged++;
+			else
+				out.push_back(Write<Object>{object, effect, item, wanted.c_str()});
+		};
+
+		const char *textFont = edit->get_object_item_value(object, kTextEffect, kFontItem);
+		if (textFont && (r.anyFont || Matches(r.from, textFont, nullptr)))
+		{
+			matched = true;
+			if (r.to.IsFile())
+				stats.unsupported++;
+			else
+				diff(kTextEffect, kFontItem, textFont, r.to.name);
+		}
+
+		// get_object_item_value's buffer may be reused by the next call.
+		const char *vfFont = edit->get_object_item_value(object, kVFEffect, kFontItem);
+		if (vfFont)
+		{
+			std::string font = vfFont;
+			const char *vfFile = edit->get_object_item_value(object, kVFEffect, kFileItem);
+			if (r.anyFont || Matches(r.from, font.c_str(), vfFile))
+			{
+				matched = true;
+				static const std::string kNone;
+				diff(kVFEffect, kFontItem, font.c_str(), r.to.IsFile() ? kNone : r.to.name);
+				diff(kVFEffect, kFileItem, vfFile ? vfFile : "", r.to.file);
+			}
+		}
+
+		if (matched)
+			stats.matched++;
+		if (out.size() > before)
+			stats.changed++;
+		return matched;
+	}
+
+	// Every object overlapping `scope`, layer by layer in frame order.
+	template <typename Edit, typename Fn>
+	void ForEachObject(Edit *edit, const Scope &scope, Fn &&fn)
+	{
+		if (!edit->find_object || !edit->get_object_layer_frame)
+			return;
+		int layerLast = scope.layerLast >= 0 ? scope.layerLast : edit->info ? edit->info->layer_max : 0;
+		for (int layer = scope.layerFirst; layer <= layerLast; layer++)
+		{
+			int frame = scope.frameFirst;
+			while (frame <= scope.frameLast)
+			{
+				auto object = edit->find_object(layer, frame);
+				if (!object)
+					break;
+				auto lf = edit->get_object_layer_frame(object);
+				if (lf.start > scope.frameLast)
+					break;
+				if (lf.end >= scope.frameFirst)
+					fn(object);
+				if (lf.end < frame || lf.end == INT_MAX)
+					break;
+				frame = lf.end + 1;
+			}
+		}
+	}
+
+	// Issue the planned writes.
+	template <typename Edit, typename Object>
+	void ApplyWrites(Edit *edit, const std::vector<Write<Object>> &writes, Stats &stats)
+	{
+		for (const Write<Object> &w : writes)
+		{
+			stats.writes++;
+			if (!edit->set_object_item_value(w.object, w.effect, w.item, w.value))
+				stats.failed++;
+		}
+	}
+
+	// Replace the font on every matching object in `scope`. `writes` is
+	// scratch space (kept by the caller so its capacity is reused).
+	template <typename Edit, typename Object>
+	Stats ReplaceInScope(Edit *edit, const Scope &scope, const Replacement &r, std::vector<Write<Object>> &writes)
+	{
+		Stats stats;
+		writes.clear();
+		if (!edit || !edit->get_object_item_value || !edit->set_object_item_value)
+			return stats;
+		ForEachObject(edit, scope, [&](Object object)
+					  {
+			stats.scanned++;
+			PlanObject(edit, object, r, writes, stats); });
+		ApplyWrites(edit, writes, stats);
+		return stats;
+	}
+
+	// Narrow `scope` to the layers spanned by the selected objects, or the
+	// focused object's layer when nothing is selected. Returns false (and
+	// leaves `scope` alone) when there is neither.
+	template <typename Edit>
+	bool SelectedLayers(Edit *edit, Scope &scope)
+	{
+		if (!edit || !edit->get_object_layer_frame)
+			return false;
+		int first = INT_MAX, last = -1;
+		auto add = [&](int layer)
+		{
+			first = layer < first ? layer : first;
+			last = layer > last ? layer : last;
+		};
+		int n = edit->get_selected_object_num && edit->get_selected_object ? edit->get_selected_object_num() : 0;
+		for (int i = 0; i < n; i++)
+		{
+			if (auto object = edit->get_selected_object(i))
+				add(edit->get_object_layer_frame(object).layer);
+		}
+		if (last < 0 && edit->get_focus_object)
+		{
+			if (auto object = edit->get_focus_object())
+				add(edit->get_object_layer_frame(object).layer);
+		}
+		if (last < 0)
+			return false;
+		scope.layerFirst = first;
+		scope.layerLast = last;
+		return true;
+	}
+
+	// The font an object's text effect uses (Variable Font Text first);
+	// false for objects without one.
+	template <typename Edit, typename Object>
+	bool ReadFont(Edit *edit, Object object, FontRef &out)
+	{
+		if (!edit || !object || !edit->get_object_item_value)
+			return false;
+		if (const char *font = edit->get_object_item_value(object, kVFEffect, kFontItem))
+		{
+			out.name = font;
+			const char *file = edit->get_object_item_value(object, kVFEffect, kFileItem);
+			out.file = file ? file : "";
+			if (out.IsFile())
+				out.name.clear();
+			return true;
+		}
+		if (const char *font = edit->get_object_item_value(object, kTextEffect, kFontItem))
+		{
+			out.name = font;
+			out.file.clear();
+			return true;
+		}
+		return false;
+	}
+}
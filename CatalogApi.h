@@ -0,0 +1,508 @@
+//----------------------------------------------------------------------------------
+//	Module side of the font catalog API (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cwctype>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "FontCatalogApi.h"
+#include "FontHash.h"
+#include "FontPreviewCore.h"
+
+// Implements FontCatalogApi.h. The UI thread publishes snapshots built
+// from the catalog; callers on any thread take references to the current
+// one. Entries are immutable and shared between snapshots, so publishing
+// after one font's axes resolve rebuilds that entry and a vector of
+// pointers, not the whole catalog. Taking a reference holds a mutex for a
+// pointer copy only; nothing a caller does waits for the UI thread.
+// Change notifications run on a thread of their own, started by the first
+// subscription, so a hidden window (whose background queue is held back)
+// does not delay them. For the same reason entry details (axes, coverage)
+// are resolved for clients by a DetailPass rather than the UI's queue.
+namespace CatalogApi
+{
+	// One catalog row, with the strings the C structs point into.
+	struct Entry
+	{
+		std::wstring displayName;
+		std::wstring familyName;
+		std::wstring filePath;
+		std::wstring sourcePath;
+		std::wstring identity;
+		std::wstring nameLower; // search index for FONT_CATALOG_QUERY::text
+		uint32_t faceIndex = 0;
+		uint32_t flags = 0;
+		uint64_t contentHash = 0;
+		std::vector<FONT_CATALOG_AXIS> axes;
+	};
+
+	// Codepoints probed per coverage flag when a font's details resolve.
+	struct CoverageProbe
+	{
+		uint32_t codepoint;
+		uint32_t flag;
+	};
+	constexpr CoverageProbe kCoverageProbes[] = {
+		{0x0041, FONT_CATALOG_COVERAGE_LATIN},	  // A
+		{0x3042, FONT_CATALOG_COVERAGE_KANA},	  // あ
+		{0x6F22, FONT_CATALOG_COVERAGE_KANJI},	  // 漢
+		{0xAC00, FONT_CATALOG_COVERAGE_HANGUL},	  // 가
+		{0x0416, FONT_CATALOG_COVERAGE_CYRILLIC}, // Ж
+		{0x03A9, FONT_CATALOG_COVERAGE_GREEK},	  // Ω
+	};
+	constexpr size_t kCoverageProbeCount = sizeof(kCoverageProbes) / sizeof(kCoverageProbes[0]);
+
+	// `Item` is the plugin's FontItem (or a look-alike): displayName,
+	// familyName, filePath, sourcePath, isSystemFont, faceIndex,
+	// contentHash, axesResolved, axisRanges, axisDefaults and coverage.
+	template <typename Item>
+	std::shared_ptr<const Entry> MakeEntry(const Item &item)
+	{
+		auto e = std::make_shared<Entry>();
+		e->displayName = item.displayName;
+		e->familyName = item.familyName;
+		e->filePath = item.filePath;
+		e->sourcePath = item.sourcePath;
+		e->identity = FontPreviewCore::BuildFontIdentity(item);
+		e->nameLower = FontPreviewCore::ToLower(item.displayName);
+		e->faceIndex = item.faceIndex;
+		e->contentHash = item.contentHash;
+		e->flags = item.isSystemFont ? FONT_CATALOG_FLAG_SYSTEM : FONT_CATALOG_FLAG_FILE;
+		if (item.axesResolved)
+			e->flags |= FONT_CATALOG_FLAG_DETAILS_RESOLVED | (item.coverage & 0xFF00u);
+		if (!item.axisRanges.empty())
+			e->flags |= FONT_CATALOG_FLAG_VARIABLE;
+		e->axes.reserve(item.axisRanges.size());
+		for (size_t i = 0; i < item.axisRanges.size(); i++)
+		{
+			FONT_CATALOG_AXIS axis{};
+			std::strncpy(axis.tag, item.axisRanges[i].first.c_str(), 4);
+			axis.min_value = item.axisRanges[i].second.first;
+			axis.max_value = item.axisRanges[i].second.second;
+			axis.default_value = i < item.axisDefaults.size() ? item.axisDefaults[i] : axis.min_value;
+			e->axes.push_back(axis);
+		}
+		return e;
+	}
+}
+
+// The opaque handle of FontCatalogApi.h.
+struct FONT_CATALOG_SNAPSHOT
+{
+	mutable std::atomic<int> refs{1};
+	uint64_t serial = 0;
+	std::vector<std::shared_ptr<const CatalogApi::Entry>> entries;
+	// Hash64 of the identity to entry index; shared while the font set
+	// stays the same.
+	std::shared_ptr<const std::unordered_multimap<uint64_t, int>> byIdentity;
+};
+
+namespace CatalogApi
+{
+	inline void Retain(const FONT_CATALOG_SNAPSHOT *s)
+	{
+		if (s)
+			s->refs.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	inline void Release(const FONT_CATALOG_SNAPSHOT *s)
+	{
+		if (s && s->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			delete s;
+	}
+
+	inline bool GetEntry(const FONT_CATALOG_SNAPSHOT *s, int index, FONT_CATALOG_ENTRY *out)
+	{
+		if (!s || !out || out->struct_size < (int)sizeof(int) || index < 0 || index >= (int)s->entries.size())
+			return false;
+		const Entry &e = *s->entries[index];
+		FONT_CATALOG_ENTRY full{};
+		full.struct_size = out->struct_size;
+		full.display_name = e.displayName.c_str();
+		full.family_name = e.familyName.c_str();
+		full.file_path = e.filePath.c_str();
+		full.source_path = e.sourcePath.c_str();
+		full.identity = e.identity.c_str();
+		full.face_index = e.faceIndex;
+		full.flags = e.flags;
+		full.content_hash = e.contentHash;
+		full.axis_count = (int)e.axes.size();
+		full.axes = e.axes.empty() ? nullptr : e.axes.data();
+		// An older caller's struct is a prefix of this one.
+		size_t size = (size_t)out->struct_size < sizeof(full) ? (size_t)out->struct_size : sizeof(full);
+		std::memcpy(out, &full, size);
+		return true;
+	}
+
+	inline uint64_t HashIdentity(const wchar_t *identity, size_t length)
+	{
+		return FontHash::Hash64(identity, length * sizeof(wchar_t));
+	}
+
+	inline int FindIdentity(const FONT_CATALOG_SNAPSHOT *s, const wchar_t *identity)
+	{
+		if (!s || !identity || !s->byIdentity)
+			return -1;
+		auto range = s->byIdentity->equal_range(HashIdentity(identity, std::wcslen(identity)));
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (s->entries[it->second]->identity == identity)
+				return it->second;
+		}
+		return -1;
+	}
+
+	// Same matching as the window's search box (FontPreviewCore::
+	// FilterCatalog), against the precomputed lowercase names.
+	inline int Query(const FONT_CATALOG_SNAPSHOT *s, const FONT_CATALOG_QUERY *q, int *indices, int capacity)
+	{
+		if (!s || !q || q->struct_size < (int)(offsetof(FONT_CATALOG_QUERY, require_all) + sizeof(q->require_all)))
+			return -1;
+		uint32_t typeFlag = q->type == FONT_CATALOG_TYPE_SYSTEM ? FONT_CATALOG_FLAG_SYSTEM : q->type == FONT_CATALOG_TYPE_FILE ? FONT_CATALOG_FLAG_FILE : 0;
+		if (q->type < FONT_CATALOG_TYPE_ALL || q->type > FONT_CATALOG_TYPE_FILE)
+			return -1;
+		uint32_t required = q->require_all | typeFlag;
+		std::wstring text;
+		if (q->text)
+		{
+			text = q->text;
+			for (wchar_t &c : text)
+				c = (wchar_t)std::towlower((wint_t)c);
+		}
+		int count = 0;
+		for (size_t i = 0; i < s->entries.size(); i++)
+		{
+			const Entry &e = *s->entries[i];
+			if ((e.flags & required) != required)
+				continue;
+			if (!text.empty() && e.nameLower.find(text) == std::wstring::npos)
+				continue;
+			if (indices && count < capacity)
+				indices[count] = (int)i;
+			count++;
+		}
+		return count;
+	}
+
+	class Publisher
+	{
+	public:
+		Publisher()
+		{
+			m_current = new FONT_CATALOG_SNAPSHOT();
+		}
+
+		~Publisher()
+		{
+			Shutdown();
+			Release(m_current);
+		}
+
+		Publisher(const Publisher &) = delete;
+		Publisher &operator=(const Publisher &) = delete;
+
+		// Replace the current snapshot; returns its serial. `sameFonts`
+		// says only entry details changed (same fonts, same order), so the
+		// identity index is carried over.
+		uint64_t Publish(std::vector<std::shared_ptr<const Entry>> entries, bool sameFonts = false)
+		{
+			auto *s = new FONT_CATALOG_SNAPSHOT();
+			s->entries = std::move(entries);
+			if (sameFonts)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_current->entries.size() == s->entries.size())
+					s->byIdentity = m_current->byIdentity;
+			}
+			if (!s->byIdentity)
+			{
+				auto index = std::make_shared<std::unordered_multimap<uint64_t, int>>();
+				index->reserve(s->entries.size());
+				for (size_t i = 0; i < s->entries.size(); i++)
+					index->emplace(HashIdentity(s->entries[i]->identity.c_str(), s->entries[i]->identity.size()), (int)i);
+				s->byIdentity = std::move(index);
+			}
+			const FONT_CATALOG_SNAPSHOT *old;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				s->serial = ++m_serial;
+				old = m_current;
+				m_current = s;
+			}
+			Release(old);
+			{
+				std::lock_guard<std::mutex> lock(m_notifyMutex);
+				m_pendingSerial = s->serial;
+			}
+			m_notifyCv.notify_one();
+			return s->serial;
+		}
+
+		const FONT_CATALOG_SNAPSHOT *Acquire()
+		{
+			const FONT_CATALOG_SNAPSHOT *s;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				Retain(m_current);
+				s = m_current;
+				if (m_hasClient)
+					return s;
+			}
+			OnFirstClient();
+			return s;
+		}
+
+		// `fn` runs once, on the caller's thread, the first time anyone
+		// acquires a snapshot or subscribes: from then on the module should
+		// resolve every entry's details (see DetailPass).
+		void SetClientCallback(std::function<void()> fn)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_clientCallback = std::move(fn);
+		}
+
+		bool HasClient()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_hasClient;
+		}
+
+		uint64_t Serial()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_serial;
+		}
+
+		int Subscribe(FONT_CATALOG_CHANGED callback, void *user)
+		{
+			if (!callback)
+				return 0;
+			int token;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_stopped)
+					return 0;
+				if (!m_notifier.joinable())
+					m_notifier = std::thread([this]
+											 { NotifyLoop(); });
+				token = ++m_lastToken;
+				m_subscribers.push_back(Subscriber{token, callback, user});
+				if (m_hasClient)
+					return token;
+			}
+			OnFirstClient();
+			return token;
+		}
+
+		// Waits for a running notification unless called from inside one.
+		void Unsubscribe(int token)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				for (size_t i = 0; i < m_subscribers.size(); i++)
+				{
+					if (m_subscribers[i].token == token)
+					{
+						m_subscribers.erase(m_subscribers.begin() + (ptrdiff_t)i);
+						break;
+					}
+				}
+			}
+			std::lock_guard<std::recursive_mutex> wait(m_dispatchMutex);
+		}
+
+		size_t Subscribers()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_subscribers.size();
+		}
+
+		// Stop notifying and drop every subscriber. Snapshots callers still
+		// hold stay valid.
+		void Shutdown()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stopped = true;
+				m_subscribers.clear();
+				m_clientCallback = nullptr;
+			}
+			{
+				std::lock_guard<std::mutex> lock(m_notifyMutex);
+				m_stop = true;
+			}
+			m_notifyCv.notify_one();
+			if (m_notifier.joinable())
+				m_notifier.join();
+		}
+
+	private:
+		struct Subscriber
+		{
+			int token;
+			FONT_CATALOG_CHANGED callback;
+			void *user;
+		};
+
+		void OnFirstClient()
+		{
+			std::function<void()> fn;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_hasClient)
+					return;
+				m_hasClient = true;
+				fn = m_clientCallback;
+			}
+			if (fn)
+				fn();
+		}
+
+		// Reports the latest serial only, so a burst of publishes costs
+		// subscribers one call.
+		void NotifyLoop()
+		{
+			std::unique_lock<std::mutex> lock(m_notifyMutex);
+			while (true)
+			{
+				m_notifyCv.wait(lock, [this]
+								{ return m_stop || m_pendingSerial != m_notifiedSerial; });
+				if (m_stop)
+					return;
+				uint64_t serial = m_notifiedSerial = m_pendingSerial;
+				lock.unlock();
+				Dispatch(serial);
+				lock.lock();
+			}
+		}
+
+		void Dispatch(uint64_t serial)
+		{
+			std::lock_guard<std::recursive_mutex> dispatching(m_dispatchMutex);
+			std::vector<Subscriber> subscribers;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				subscribers = m_subscribers;
+			}
+			for (const Subscriber &sub : subscribers)
+			{
+				{
+					// Skip anyone an earlier callback unsubscribed.
+					std::lock_guard<std::mutex> lock(m_mutex);
+					bool live = false;
+					for (const Subscriber &s : m_subscribers)
+						live |= s.token == sub.token;
+					if (!live)
+						continue;
+				}
+				sub.callback(sub.user, serial);
+			}
+		}
+
+		std::mutex m_mutex; // m_current, m_serial, m_subscribers
+		const FONT_CATALOG_SNAPSHOT *m_current = nullptr;
+		uint64_t m_serial = 0;
+		std::vector<Subscriber> m_subscribers;
+		int m_lastToken = 0;
+		bool m_stopped = false;
+		bool m_hasClient = false;
+		std::function<void()> m_clientCallback;
+
+		std::recursive_mutex m_dispatchMutex; // held while callbacks run
+		std::mutex m_notifyMutex;
+		std::condition_variable m_notifyCv;
+		uint64_t m_pendingSerial = 0;
+		uint64_t m_notifiedSerial = 0;
+		bool m_stop = false;
+		std::thread m_notifier;
+	};
+
+	// Resolves entry details on a thread of its own, in catalog order. The
+	// UI's background queue holds low-priority work back while the window
+	// is hidden or occluded, which is when another plugin is most likely to
+	// be reading the catalog; this pass is not held back. Start and Stop are
+	// for one (the UI) thread; `fn` reports results the way it likes.
+	class DetailPass
+	{
+	public:
+		DetailPass() = default;
+		DetailPass(const DetailPass &) = delete;
+		DetailPass &operator=(const DetailPass &) = delete;
+		~DetailPass() { Stop(); }
+
+		// Run fn(i) for every i in [0, count), replacing a running pass.
+		void Start(size_t count, std::function<void(size_t)> fn)
+		{
+			Stop();
+			m_cancel = false;
+			m_done = 0;
+			m_thread = std::thread([this, count, fn = std::move(fn)]
+								   {
+				for (size_t i = 0; i < count && !m_cancel.load(std::memory_order_relaxed); i++)
+				{
+					fn(i);
+					m_done.fetch_add(1, std::memory_order_release);
+				} });
+		}
+
+		// Returns once the item in progress is done; the rest are skipped.
+		void Stop()
+		{
+			m_cancel = true;
+			if (m_thread.joinable())
+				m_thread.join();
+		}
+
+		// Items finished by the current (or last) pass.
+		size_t Done() const { return m_done.load(std::memory_order_acquire); }
+
+	private:
+		std::atomic<bool> m_cancel{false};
+		std::atomic<size_t> m_done{0};
+		std::thread m_thread;
+	};
+
+	inline Publisher &Global()
+	{
+		static Publisher publisher;
+		return publisher;
+	}
+
+	// The table GetFontCatalogApi hands out, over Global(); null for a
+	// version this module does not implement.
+	inline const FONT_CATALOG_API *GetApi(int version)
+	{
+		static const FONT_CATALOG_API api = {
+			FONT_CATALOG_API_VERSION,
+			(int)sizeof(FONT_CATALOG_API),
+			[]() -> const FONT_CATALOG_SNAPSHOT *
+			{ return Global().Acquire(); },
+			&Retain,
+			&Release,
+			[](const FONT_CATALOG_SNAPSHOT *s) -> uint64_t
+			{ return s ? s->serial : 0; },
+			[](const FONT_CATALOG_SNAPSHOT *s) -> int
+			{ return s ? (int)s->entries.size() : 0; },
+			&GetEntry,
+			&FindIdentity,
+			&Query,
+			[](FONT_CATALOG_CHANGED callback, void *user) -> int
+			{ return Global().Subscribe(callback, user); },
+			[](int token)
+			{ Global().Unsubscribe(token); },
+		};
+		return version >= 1 && version <= FONT_CATALOG_API_VERSION ? &api : nullptr;
+	}
+}
@@ -0,0 +1,245 @@
+//----------------------------------------------------------------------------------
+//	Compare view: pinned fonts and shared line breaking (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "FontPreviewCore.h"
+
+// The compare view stacks the sample text in every pinned font. Pins are
+// kept by stable identity (FontPreviewCore::BuildFontIdentity plus the face
+// row) so they survive re-enumeration and restarts. Text analysis (script
+// runs, break opportunities) depends only on the sample text and is done
+// once; each font then only shapes and breaks its own glyph widths against
+// the shared opportunities with BreakLines.
+namespace Compare
+{
+	constexpr int kMaxPinned = 6;
+	constexpr int kMaxRowLines = 4;
+
+	struct Pin
+	{
+		std::wstring identity; // FontPreviewCore::BuildFontIdentity
+		int faceIndex = -1;	   // face row, -1 for the family row
+	};
+
+	enum class ToggleResult
+	{
+		Added,
+		Removed,
+		Full
+	};
+
+	class PinSet
+	{
+	public:
+		const std::vector<Pin> &Pins() const { return m_pins; }
+		size_t Size() const { return m_pins.size(); }
+		bool IsDirty() const { return m_dirty; }
+
+		int Find(const std::wstring &identity, int faceIndex) const
+		{
+			for (size_t i = 0; i < m_pins.size(); i++)
+			{
+				if (m_pins[i].faceIndex == faceIndex && m_pins[i].identity == identity)
+					return (int)i;
+			}
+			return -1;
+		}
+
+		// Pin or unpin; new pins go to the bottom of the view.
+		ToggleResult Toggle(const std::wstring &identity, int faceIndex)
+		{
+			int at = Find(identity, faceIndex);
+			if (at >= 0)
+			{
+				m_pins.erase(m_pins.begin() + at);
+				m_dirty = true;
+				return ToggleResult::Removed;
+			}
+			if ((int)m_pins.size() >= kMaxPinned)
+				return ToggleResult::Full;
+			m_pins.push_back(Pin{identity, faceIndex});
+			m_dirty = true;
+			return ToggleResult::Added;
+		}
+
+		void Clear()
+		{
+			m_dirty |= !m_pins.empty();
+			m_pins.clear();
+		}
+
+		// Binary file in the FontHash cache's layout: magic, version, count,
+		// then per pin the identity as UTF-32 code units and the face row.
+		// Returns false (and keeps nothing) on a foreign or truncated file.
+		bool Load(std::istream &in)
+		{
+			char magic[4];
+			uint32_t version = 0, count = 0;
+			if (!in.read(magic, 4) || std::memcmp(magic, kMagic, 4) != 0)
+				return false;
+			if (!ReadU32(in, version) || version != kVersion || !ReadU32(in, count) || count > (uint32_t)kMaxPinned)
+				return false;
+			std::vector<Pin> pins(count);
+			for (Pin &pin : pins)
+			{
+				uint32_t len = 0, face = 0;
+				if (!ReadU32(in, len) || len > 32768)
+					return false;
+				pin.identity.resize(len);
+				for (uint32_t c = 0; c < len; c++)
+				{
+					uint32_t ch = 0;
+					if (!ReadU32(in, ch))
+						return false;
+					pin.identity[c] = (wchar_t)ch;
+				}
+				if (!ReadU32(in, face))
+					return false;
+				pin.faceIndex = (int)(int32_t)face;
+			}
+			m_pins = std::move(pins);
+			m_dirty = false;
+			return true;
+		}
+
+		void Save(std::ostream &out)
+		{
+			out.write(kMagic, 4);
+			WriteU32(out, kVersion);
+			WriteU32(out, (uint32_t)m_pins.size());
+			for (const Pin &pin : m_pins)
+			{
+				WriteU32(out, (uint32_t)pin.identity.size());
+				for (wchar_t ch : pin.identity)
+					WriteU32(out, (uint32_t)ch);
+				WriteU32(out, (uint32_t)(int32_t)pin.faceIndex);
+			}
+			m_dirty = false;
+		}
+
+	private:
+		static constexpr const char *kMagic = "FPCP";
+		static constexpr uint32_t kVersion = 1;
+
+		static bool ReadU32(std::istream &in, uint32_t &v)
+		{
+			unsigned char b[4];
+			if (!in.read((char *)b, 4))
+				return false;
+			v = (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+			return true;
+		}
+
+		static void WriteU32(std::ostream &out, uint32_t v)
+		{
+			unsigned char b[4] = {(unsigned char)v, (unsigned char)(v >> 8), (unsigned char)(v >> 16), (unsigned char)(v >> 24)};
+			out.write((const char *)b, 4);
+		}
+
+		std::vector<Pin> m_pins;
+		bool m_dirty = false;
+	};
+
+	// Catalog index of every pin, or -1 for pins whose font is gone (they
+	// stay pinned in case the font comes back).
+	template <typename Item>
+	void ResolvePins(const std::vector<Item> &fonts, const std::vector<Pin> &pins, std::vector<int> &outFontIndices)
+	{
+		outFontIndices.assign(pins.size(), -1);
+		if (pins.empty())
+			return;
+		std::unordered_map<std::wstring, int> byIdentity;
+		byIdentity.reserve(fonts.size());
+		for (size_t i = 0; i < fonts.size(); i++)
+			byIdentity.emplace(FontPreviewCore::BuildFontIdentity(fonts[i]), (int)i);
+		for (size_t p = 0; p < pins.size(); p++)
+		{
+			auto it = byIdentity.find(pins[p].identity);
+			if (it != byIdentity.end())
+				outFontIndices[p] = it->second;
+		}
+	}
+
+	//---------------------------------------------------------------------
+	//	Line breaking
+	//---------------------------------------------------------------------
+	// Per text position, from the shared analysis; a font masks out
+	// positions inside its own clusters before breaking.
+	enum BreakFlags : uint8_t
+	{
+		kCanBreakAfter = 1 << 0,
+		kMustBreakAfter = 1 << 1,
+		kWhitespace = 1 << 2, // may hang past the right edge
+	};
+
+	// Text positions [start, end) and their advance sum.
+	struct LineSpan
+	{
+		uint32_t start = 0;
+		uint32_t end = 0;
+		float width = 0.0f;
+	};
+
+	// Greedy breaking of `count` positions whose advances are `widths` (a
+	// cluster's width sits on its first position, the rest are 0). Lines
+	// end at the last break opportunity that fits, or mid-word when a word
+	// alone is wider than `maxWidth`. Returns the number of lines written;
+	// text past `maxLines` lines is dropped. Allocation-free.
+	inline int BreakLines(const float *widths, const uint8_t *flags, uint32_t count, float maxWidth, LineSpan *out, int maxLines)
+	{
+		int lines = 0;
+		uint32_t start = 0;
+		while (start < count && lines < maxLines)
+		{
+			float width = 0.0f;
+			float inkWidth = 0.0f; // without trailing whitespace
+			uint32_t breakAt = 0;  // position after the last opportunity, 0 = none
+			float breakWidth = 0.0f;
+			uint32_t i = start;
+			for (; i < count; i++)
+			{
+				float next = width + widths[i];
+				bool white = (flags[i] & kWhitespace) != 0;
+				if (!white && next > maxWidth && i > start)
+					break;
+				width = next;
+				if (!white)
+					inkWidth = width;
+				if ((flags[i] & kMustBreakAfter) != 0)
+				{
+					i++;
+					breakAt = 0;
+					break;
+				}
+				if ((flags[i] & kCanBreakAfter) != 0)
+				{
+					breakAt = i + 1;
+					breakWidth = inkWidth;
+				}
+			}
+			LineSpan &line = out[lines++];
+			line.start = start;
+			if (i < count && breakAt > start && (flags[i - 1] & kMustBreakAfter) == 0)
+			{
+				line.end = breakAt;
+				line.width = breakWidth;
+			}
+			else
+			{
+				line.end = i;
+				line.width = inkWidth;
+			}
+			start = line.end;
+		}
+		return lines;
+	}
+}
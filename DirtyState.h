@@ -0,0 +1,171 @@
+//----------------------------------------------------------------------------------
+//	Coalesced invalidation state (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// UI handlers mark what they made stale instead of repainting on the spot;
+// the window posts itself one flush message on the first mark and repaints
+// each stale region once when it arrives. A click that raises both
+// LVN_ITEMCHANGED and NM_CLICK, or a filter change that also moves the
+// selection, therefore costs one detail update and one preview render.
+// Counters attribute every flush to the user actions that requested it.
+// UI-thread only: not synchronised.
+namespace DirtyState
+{
+	enum Region : uint32_t
+	{
+		None = 0,
+		ListAll = 1 << 0,  // row set or order changed: invalidate the visible list
+		ListRows = 1 << 1, // text of specific rows changed (see Mark's row)
+		Detail = 1 << 2,   // name / type / axis labels
+		Preview = 1 << 3,  // GPU preview
+	};
+
+	enum class Action : int
+	{
+		Filter = 0,
+		Selection,
+		Expand,
+		SampleText,
+		Background,
+		FacesReady,
+		AxesReady,
+		AxisSlider,
+		AxisSweep, // sweep animation stopped: back to the still preview
+		PreviewMode,
+		PreviewScroll,
+		ComparePins, // pinned set or its faces changed
+		GlyphTable,	 // glyph browser's cmap index arrived
+		Shown, // back to visible after frames were skipped (Visibility.h)
+		Favorites, // a family's ★ mark changed
+		Count
+	};
+
+	inline const char *ActionName(Action a)
+	{
+		static const char *const kNames[] = {"filter", "selection", "expand", "sample", "background", "faces", "axes", "slider", "sweep", "mode", "scroll", "pins", "glyphs", "shown", "favorites"};
+		int i = (int)a;
+		return i >= 0 && i < (int)Action::Count ? kNames[i] : "?";
+	}
+
+	// Per action: how often it asked for a repaint and what the flushes it
+	// took part in actually repainted. requests - flushes is what
+	// coalescing saved.
+	struct ActionCounts
+	{
+		uint64_t requests = 0;
+		uint64_t flushes = 0;
+		uint64_t listRepaints = 0;
+		uint64_t rowRepaints = 0;
+		uint64_t detailUpdates = 0;
+		uint64_t previewRenders = 0;
+	};
+
+	// What one flush has to repaint. rowFirst..rowLast is valid when
+	// `regions` has ListRows.
+	struct Flush
+	{
+		uint32_t regions = None;
+		uint32_t actions = 0; // bit per Action
+		int rowFirst = -1;
+		int rowLast = -1;
+	};
+
+	class Tracker
+	{
+	public:
+		// Row ranges wider than this are repainted as a whole list.
+		static constexpr int kMaxRowSpan = 64;
+
+		// Returns true on the first mark since the last Take(), i.e. when
+		// the caller has to schedule a flush.
+		bool Mark(Action action, uint32_t regions, int row = -1)
+		{
+			if (regions == None)
+				return false;
+			bool first = m_pending.regions == None;
+			m_counts[(int)action].requests++;
+			m_pending.actions |= 1u << (int)action;
+			if ((regions & ListRows) != 0)
+			{
+				regions &= ~(uint32_t)ListRows;
+				if (row >= 0)
+					AddRow(row);
+			}
+			m_pending.regions |= regions;
+			if ((m_pending.regions & ListAll) != 0)
+				m_pending.regions &= ~(uint32_t)ListRows;
+			return first && m_pending.regions != None;
+		}
+
+		bool Pending() const { return m_pending.regions != None; }
+
+		// Hand out the pending work, reset it and count it against every
+		// action that contributed.
+		Flush Take()
+		{
+			Flush f = m_pending;
+			m_pending = Flush{};
+			if (f.regions == None)
+				return f;
+			m_flushes++;
+			for (int i = 0; i < (int)Action::Count; i++)
+			{
+				if ((f.actions & (1u << i)) == 0)
+					continue;
+				ActionCounts &c = m_counts[i];
+				c.flushes++;
+				if ((f.regions & ListAll) != 0)
+					c.listRepaints++;
+				if ((f.regions & ListRows) != 0)
+					c.rowRepaints++;
+				if ((f.regions & Detail) != 0)
+					c.detailUpdates++;
+				if ((f.regions & Preview) != 0)
+					c.previewRenders++;
+			}
+			return f;
+		}
+
+		// Drop pending work without counting it (window going away).
+		void Discard() { m_pending = Flush{}; }
+
+		const ActionCounts &Counts(Action action) const { return m_counts[(int)action]; }
+		uint64_t Flushes() const { return m_flushes; }
+
+		void ResetCounts()
+		{
+			for (auto &c : m_counts)
+				c = ActionCounts{};
+			m_flushes = 0;
+		}
+
+	private:
+		void AddRow(int row)
+		{
+			if ((m_pending.regions & ListAll) != 0)
+				return;
+			if ((m_pending.regions & ListRows) == 0)
+			{
+				m_pending.regions |= ListRows;
+				m_pending.rowFirst = m_pending.rowLast = row;
+				return;
+			}
+			if (row < m_pending.rowFirst)
+				m_pending.rowFirst = row;
+			if (row > m_pending.rowLast)
+				m_pending.rowLast = row;
+			if (m_pending.rowLast - m_pending.rowFirst >= kMaxRowSpan)
+			{
+				m_pending.regions &= ~(uint32_t)ListRows;
+				m_pending.regions |= ListAll;
+			}
+		}
+
+		Flush m_pending;
+		ActionCounts m_counts[(int)Action::Count];
+		uint64_t m_flushes = 0;
+	};
+}
@@ -0,0 +1,274 @@
+//----------------------------------------------------------------------------------
+//	Favorites and recently used fonts (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cwchar>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "FontPreviewCore.h"
+
+// Most work happens in a handful of fonts: the ones marked as favorites
+// and the ones recently applied to objects. Both lists are kept by stable
+// identity (FontPreviewCore::BuildFontIdentity) so they survive
+// re-enumeration and restarts; Resolve maps them onto a catalog as a
+// membership bitset (for FilterCatalog's Favorites and Recent filters and
+// the list's ★ marks) and as indices (for warm-start preloading).
+namespace Favorites
+{
+	constexpr size_t kMaxFavorites = 4096;
+	constexpr size_t kMaxRecent = 16;
+
+	enum class ToggleResult
+	{
+		Added,
+		Removed,
+		Full
+	};
+
+	class WorkingSet
+	{
+	public:
+		// In the order they were marked.
+		const std::vector<std::wstring> &Favorites() const { return m_favorites; }
+		// Most recent first.
+		const std::vector<std::wstring> &Recent() const { return m_recent; }
+		bool IsDirty() const { return m_dirty; }
+
+		bool IsFavorite(const std::wstring &identity) const
+		{
+			return Find(m_favorites, identity) >= 0;
+		}
+
+		ToggleResult ToggleFavorite(const std::wstring &identity)
+		{
+			int at = Find(m_favorites, identity);
+			if (at >= 0)
+			{
+				m_favorites.erase(m_favorites.begin() + at);
+				m_dirty = true;
+				return ToggleResult::Removed;
+			}
+			if (m_favorites.size() >= kMaxFavorites)
+				return ToggleResult::Full;
+			m_favorites.push_back(identity);
+			m_dirty = true;
+			return ToggleResult::Added;
+		}
+
+		// Move (or add) `identity` to the front of the recent list, dropping
+		// the oldest past kMaxRecent. Returns false when it already was the
+		// most recent, so repeated applies of one font write nothing.
+		bool Touch(const std::wstring &identity)
+		{
+			if (identity.empty() || (!m_recent.empty() && m_recent.front() == identity))
+				return false;
+			int at = Find(m_recent, identity);
+			if (at >= 0)
+				m_recent.erase(m_recent.begin() + at);
+			else if (m_recent.size() >= kMaxRecent)
+				m_recent.pop_back();
+			m_recent.insert(m_recent.begin(), identity);
+			m_dirty = true;
+			return true;
+		}
+
+		// The fonts worth warming first: recent ones (most recent first),
+		// then favorites (newest first), without duplicates.
+		void PreloadOrder(size_t limit, std::vector<std::wstring> &out) const
+		{
+			out.clear();
+			for (const std::wstring &id : m_recent)
+			{
+				if (out.size() >= limit)
+					return;
+				out.push_back(id);
+			}
+			for (size_t i = m_favorites.size(); i-- > 0 && out.size() < limit;)
+			{
+				if (Find(m_recent, m_favorites[i]) < 0)
+					out.push_back(m_favorites[i]);
+			}
+		}
+
+		// Binary file in the FontHash cache's layout: magic, version, then
+		// the favorites and the recent list, each as a count followed by
+		// identities in UTF-32 code units. Returns false (and keeps
+		// nothing) on a foreign or truncated file.
+		bool Load(std::istream &in)
+		{
+			char magic[4];
+			uint32_t version = 0;
+			if (!in.read(magic, 4) || std::memcmp(magic, kMagic, 4) != 0)
+				return false;
+			if (!ReadU32(in, version) || version != kVersion)
+				return false;
+			std::vector<std::wstring> favorites, recent;
+			if (!ReadList(in, kMaxFavorites, favorites) || !ReadList(in, kMaxRecent, recent))
+				return false;
+			m_favorites = std::move(favorites);
+			m_recent = std::move(recent);
+			m_dirty = false;
+			return true;
+		}
+
+		void Save(std::ostream &out)
+		{
+			out.write(kMagic, 4);
+			WriteU32(out, kVersion);
+			WriteList(out, m_favorites);
+			WriteList(out, m_recent);
+			m_dirty = false;
+		}
+
+	private:
+		static constexpr const char *kMagic = "FPFV";
+		static constexpr uint32_t kVersion = 1;
+
+		static int Find(const std::vector<std::wstring> &list, const std::wstring &identity)
+		{
+			for (size_t i = 0; i < list.size(); i++)
+			{
+				if (list[i] == identity)
+					return (int)i;
+			}
+			return -1;
+		}
+
+		static bool ReadU32(std::istream &in, uint32_t &v)
+		{
+			unsigned char b[4];
+			if (!in.read((char *)b, 4))
+				return false;
+			v = (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+			return true;
+		}
+
+		static void WriteU32(std::ostream &out, uint32_t v)
+		{
+			unsigned char b[4] = {(unsigned char)v, (unsigned char)(v >> 8), (unsigned char)(v >> 16), (unsigned char)(v >> 24)};
+			out.write((const char *)b, 4);
+		}
+
+		static bool ReadList(std::istream &in, size_t maxCount, std::vector<std::wstring> &out)
+		{
+			uint32_t count = 0;
+			if (!ReadU32(in, count) || count > maxCount)
+				return false;
+			out.resize(count);
+			for (std::wstring &identity : out)
+			{
+				uint32_t len = 0;
+				if (!ReadU32(in, len) || len > 32768)
+					return false;
+				identity.resize(len);
+				for (uint32_t c = 0; c < len; c++)
+				{
+					uint32_t ch = 0;
+					if (!ReadU32(in, ch))
+						return false;
+					identity[c] = (wchar_t)ch;
+				}
+			}
+			return true;
+		}
+
+		static void WriteList(std::ostream &out, const std::vector<std::wstring> &list)
+		{
+			WriteU32(out, (uint32_t)list.size());
+			for (const std::wstring &identity : list)
+			{
+				WriteU32(out, (uint32_t)identity.size());
+				for (wchar_t ch : identity)
+					WriteU32(out, (uint32_t)ch);
+			}
+		}
+
+		std::vector<std::wstring> m_favorites;
+		std::vector<std::wstring> m_recent;
+		bool m_dirty = false;
+	};
+
+	// Looks catalog entries up against a list of identities without
+	// building each entry's identity string: system fonts by display name,
+	// file fonts by path and then face index.
+	class Matcher
+	{
+	public:
+		explicit Matcher(const std::vector<std::wstring> &identities)
+		{
+			for (size_t i = 0; i < identities.size(); i++)
+			{
+				const std::wstring &id = identities[i];
+				if (id.compare(0, 4, L"sys:") == 0)
+				{
+					m_system.emplace(id.substr(4), (int)i);
+					continue;
+				}
+				size_t hash = id.rfind(L'#');
+				if (id.compare(0, 5, L"file:") != 0 || hash == std::wstring::npos || hash < 5 || hash + 1 == id.size())
+					continue;
+				wchar_t *end = nullptr;
+				long long face = std::wcstoll(id.c_str() + hash + 1, &end, 10);
+				if (*end != L'\0')
+					continue;
+				m_files[id.substr(5, hash - 5)].emplace_back(face, (int)i);
+			}
+		}
+
+		// Position of the entry's identity in the list, or -1.
+		template <typename Item>
+		int Find(const Item &item) const
+		{
+			if (item.isSystemFont)
+			{
+				auto it = m_system.find(item.displayName);
+				return it == m_system.end() ? -1 : it->second;
+			}
+			auto it = m_files.find(item.filePath);
+			if (it == m_files.end())
+				return -1;
+			for (const auto &face : it->second)
+			{
+				if (face.first == (long long)item.faceIndex)
+					return face.second;
+			}
+			return -1;
+		}
+
+	private:
+		std::unordered_map<std::wstring, int> m_system;
+		std::unordered_map<std::wstring, std::vector<std::pair<long long, int>>> m_files; // path -> (face, position)
+	};
+
+	// Catalog membership of `identities` as a bitset, and optionally the
+	// catalog index of each identity (-1 for fonts that are gone; they stay
+	// listed in case the font comes back). One pass over the catalog.
+	template <typename Item>
+	void Resolve(const std::vector<Item> &fonts, const std::vector<std::wstring> &identities, FontPreviewCore::CatalogBits &outBits,
+				 std::vector<int> *outIndices = nullptr)
+	{
+		FontPreviewCore::ResetBits(outBits, fonts.size());
+		if (outIndices)
+			outIndices->assign(identities.size(), -1);
+		if (identities.empty())
+			return;
+		Matcher matcher(identities);
+		for (size_t i = 0; i < fonts.size(); i++)
+		{
+			int at = matcher.Find(fonts[i]);
+			if (at < 0)
+				continue;
+			FontPreviewCore::SetBit(outBits, i);
+			if (outIndices && (*outIndices)[at] < 0)
+				(*outIndices)[at] = (int)i;
+		}
+	}
+}
@@ -0,0 +1,132 @@
+//----------------------------------------------------------------------------------
+//	FontPreview font catalog API (C ABI)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <wchar.h>
+
+// Other plugins and tools can read the font list FontPreview has already
+// enumerated instead of scanning DirectWrite again. Load FontPreview.aux2
+// (or find it already loaded), look up the exported GetFontCatalogApi and
+// ask for the version this header describes:
+//
+//   typedef const FONT_CATALOG_API *(*GET_FONT_CATALOG_API)(int version);
+//   const FONT_CATALOG_API *api = get(FONT_CATALOG_API_VERSION);
+//   const FONT_CATALOG_SNAPSHOT *s = api->acquire_snapshot();
+//   ... api->entry_count(s), api->get_entry(s, i, &entry) ...
+//   api->release_snapshot(s);
+//
+// A snapshot is an immutable, reference-counted copy of the catalog. Any
+// thread may acquire, read, query and release one without waiting for
+// FontPreview's UI thread; every string and array it hands out stays valid
+// until the snapshot is released. When the catalog changes (re-enumeration,
+// or axis and coverage details resolving in the background) a new snapshot
+// replaces the current one and subscribers are notified.
+//
+// Details resolve after the listing. Names, paths, identity, face_index,
+// content_hash and the SYSTEM/FILE flags are known as soon as an entry is
+// listed. The VARIABLE flag, the COVERAGE_* flags, axis_count and axes are
+// read from each font afterwards: until an entry has
+// FONT_CATALOG_FLAG_DETAILS_RESOLVED they are usually unset (0, null),
+// which means "not known yet", not "no axes, no coverage"; a require_all
+// query on them only sees resolved entries. From the first
+// acquire_snapshot or subscribe on, FontPreview resolves every entry in
+// the background, also while its window is hidden; resolved entries
+// appear in new snapshots (batched, a few per second at most) and
+// subscribers are notified as usual. A catalog is fully resolved when a
+// query with require_all = FONT_CATALOG_FLAG_DETAILS_RESOLVED counts
+// entry_count entries.
+//
+// Compatibility: later versions only append members to the structs below
+// and functions to FONT_CATALOG_API. Structs the caller fills in or passes
+// carry their size in `struct_size`, so older callers keep working.
+
+#define FONT_CATALOG_API_VERSION 1
+
+// FONT_CATALOG_ENTRY::flags
+#define FONT_CATALOG_FLAG_SYSTEM 0x0001			  // installed font (family name)
+#define FONT_CATALOG_FLAG_FILE 0x0002			  // from the plugin's Fonts folder (file path)
+#define FONT_CATALOG_FLAG_VARIABLE 0x0004		  // has variation axes; valid with DETAILS_RESOLVED
+#define FONT_CATALOG_FLAG_DETAILS_RESOLVED 0x0008 // axes and coverage are known (see above)
+// Scripts the font has glyphs for; valid with FONT_CATALOG_FLAG_DETAILS_RESOLVED.
+#define FONT_CATALOG_COVERAGE_LATIN 0x0100
+#define FONT_CATALOG_COVERAGE_KANA 0x0200
+#define FONT_CATALOG_COVERAGE_KANJI 0x0400
+#define FONT_CATALOG_COVERAGE_HANGUL 0x0800
+#define FONT_CATALOG_COVERAGE_CYRILLIC 0x1000
+#define FONT_CATALOG_COVERAGE_GREEK 0x2000
+
+// FONT_CATALOG_QUERY::type
+#define FONT_CATALOG_TYPE_ALL 0
+#define FONT_CATALOG_TYPE_SYSTEM 1
+#define FONT_CATALOG_TYPE_FILE 2
+
+typedef struct FONT_CATALOG_SNAPSHOT FONT_CATALOG_SNAPSHOT; // opaque
+
+typedef struct FONT_CATALOG_AXIS
+{
+	char tag[5]; // "wght", NUL terminated
+	float min_value;
+	float max_value;
+	float default_value;
+} FONT_CATALOG_AXIS;
+
+typedef struct FONT_CATALOG_ENTRY
+{
+	int struct_size;				// set by the caller to sizeof(FONT_CATALOG_ENTRY)
+	const wchar_t *display_name;	// as listed, e.g. "Noto Sans JP" or "Foo [Foo.ttf #2]"
+	const wchar_t *family_name;		// DirectWrite family name
+	const wchar_t *file_path;		// Fonts folder file; "" for system fonts
+	const wchar_t *source_path;		// file backing the face when known, "" otherwise
+	const wchar_t *identity;		// stable across sessions: "sys:<family>" or "file:<path>#<face>"
+	uint32_t face_index;			// face within a collection file
+	uint32_t flags;					// FONT_CATALOG_FLAG_* | FONT_CATALOG_COVERAGE_*
+	uint64_t content_hash;			// same value for byte-identical font files
+	int axis_count;					// valid with FONT_CATALOG_FLAG_DETAILS_RESOLVED
+	const FONT_CATALOG_AXIS *axes;	// axis_count entries
+} FONT_CATALOG_ENTRY;
+
+typedef struct FONT_CATALOG_QUERY
+{
+	int struct_size;	  // sizeof(FONT_CATALOG_QUERY)
+	int type;			  // FONT_CATALOG_TYPE_*
+	const wchar_t *text;  // case-insensitive substring of display_name; null or "" matches all
+	uint32_t require_all; // flags every result must have
+} FONT_CATALOG_QUERY;
+
+// Called on FontPreview's notification thread after a new snapshot is
+// published; several quick changes may be reported once, with the latest
+// serial. Acquire the snapshot from here if needed.
+typedef void (*FONT_CATALOG_CHANGED)(void *user, uint64_t serial);
+
+typedef struct FONT_CATALOG_API
+{
+	int version;	 // FONT_CATALOG_API_VERSION of the module
+	int struct_size; // sizeof(FONT_CATALOG_API) of the module
+
+	// The current snapshot, with one reference for the caller. Never null;
+	// empty until the first enumeration finishes.
+	const FONT_CATALOG_SNAPSHOT *(*acquire_snapshot)(void);
+	void (*retain_snapshot)(const FONT_CATALOG_SNAPSHOT *snapshot);
+	void (*release_snapshot)(const FONT_CATALOG_SNAPSHOT *snapshot);
+
+	// Increases with every published snapshot.
+	uint64_t (*snapshot_serial)(const FONT_CATALOG_SNAPSHOT *snapshot);
+	int (*entry_count)(const FONT_CATALOG_SNAPSHOT *snapshot);
+	// Fills `entry` (whose struct_size the caller set); false when `index`
+	// is out of range.
+	bool (*get_entry)(const FONT_CATALOG_SNAPSHOT *snapshot, int index, FONT_CATALOG_ENTRY *entry);
+	// Entry index for an identity, or -1.
+	int (*find_identity)(const FONT_CATALOG_SNAPSHOT *snapshot, const wchar_t *identity);
+
+	// Indices of matching entries in catalog order, up to `capacity` of
+	// them into `indices` (may be null). Returns the total match count, or
+	// -1 for a bad query.
+	int (*query)(const FONT_CATALOG_SNAPSHOT *snapshot, const FONT_CATALOG_QUERY *query, int *indices, int capacity);
+
+	// Returns a non-zero token. After unsubscribe returns, the callback is
+	// not running and will not be called again.
+	int (*subscribe)(FONT_CATALOG_CHANGED callback, void *user);
+	void (*unsubscribe)(int token);
+} FONT_CATALOG_API;
@@ -0,0 +1,259 @@
+//----------------------------------------------------------------------------------
+//	Font content hashing (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <istream>
+#include <ostream>
+
+namespace FontHash
+{
+	//---------------------------------------------------------------------
+	//	XXH64
+	//---------------------------------------------------------------------
+	// Fast non-cryptographic 64-bit hash (XXH64 algorithm). Used to detect
+	// byte-identical font files regardless of their file name or location.
+	namespace detail
+	{
+		constexpr uint64_t kP1 = 11400714785074694791ULL;
+		constexpr uint64_t kP2 = 14029467366897019727ULL;
+		constexpr uint64_t kP3 = 1609587929392839161ULL;
+		constexpr uint64_t kP4 = 9650029242287828579ULL;
+		constexpr uint64_t kP5 = 2870177450012600261ULL;
+
+		inline uint64_t Rotl(uint64_t v, int r) { return (v << r) | (v >> (64 - r)); }
+		inline uint64_t Read64(const uint8_t *p)
+		{
+			uint64_t v;
+			std::memcpy(&v, p, sizeof(v));
+			return v;
+		}
+		inline uint32_t Read32(const uint8_t *p)
+		{
+			uint32_t v;
+			std::memcpy(&v, p, sizeof(v));
+			return v;
+		}
+		inline uint64_t Round(uint64_t acc, uint64_t input)
+		{
+			acc += input * kP2;
+			acc = Rotl(acc, 31);
+			return acc * kP1;
+		}
+		inline uint64_t MergeRound(uint64_t acc, uint64_t val)
+		{
+			acc ^= Round(0, val);
+			return acc * kP1 + kP4;
+		}
+	}
+
+	inline uint64_t Hash64(const void *data, size_t size, uint64_t seed = 0)
+	{
+		using namespace detail;
+		const uint8_t *p = static_cast<const uint8_t *>(data);
+		const uint8_t *end = p + size;
+		uint64_t h;
+		if (size >= 32)
+		{
+			const uint8_t *limit = end - 32;
+			uint64_t v1 = seed + kP1 + kP2;
+			uint64_t v2 = seed + kP2;
+			uint64_t v3 = seed;
+			uint64_t v4 = seed - kP1;
+			do
+			{
+				v1 = Round(v1, Read64(p));
+				v2 = Round(v2, Read64(p + 8));
+				v3 = Round(v3, Read64(p + 16));
+				v4 = Round(v4, Read64(p + 24));
+				p += 32;
+			} while (p <= limit);
+			h = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+			h = MergeRound(h, v1);
+			h = MergeRound(h, v2);
+			h = MergeRound(h, v3);
+			h = MergeRound(h, v4);
+		}
+		else
+		{
+			h = seed + kP5;
+		}
+		h += (uint64_t)size;
+		while (p + 8 <= end)
+		{
+			h ^= Round(0, Read64(p));
+			h = Rotl(h, 27) * kP1 + kP4;
+			p += 8;
+		}
+		if (p + 4 <= end)
+		{
+			h ^= (uint64_t)Read32(p) * kP1;
+			h = Rotl(h, 23) * kP2 + kP3;
+			p += 4;
+		}
+		while (p < end)
+		{
+			h ^= (uint64_t)(*p) * kP5;
+			h = Rotl(h, 11) * kP1;
+			p++;
+		}
+		h ^= h >> 33;
+		h *= kP2;
+		h ^= h >> 29;
+		h *= kP3;
+		h ^= h >> 32;
+		return h;
+	}
+
+	//---------------------------------------------------------------------
+	//	Hash cache
+	//---------------------------------------------------------------------
+	// Remembers file hashes keyed by path and validated by (mtime, size) so
+	// a warm start only has to stat files instead of reading them.
+	// Thread-safe; hashing workers may call Lookup/Store concurrently.
+	class HashCache
+	{
+	public:
+		bool Lookup(const std::wstring &path, uint64_t mtime, uint64_t size, uint64_t &outHash)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto it = m_entries.find(path);
+			if (it == m_entries.end() || it->second.mtime != mtime || it->second.size != size)
+				return false;
+			it->second.touched = true;
+			outHash = it->second.hash;
+			return true;
+		}
+
+		void Store(const std::wstring &path, uint64_t mtime, uint64_t size, uint64_t hash)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			Entry &e = m_entries[path];
+			e.mtime = mtime;
+			e.size = size;
+			e.hash = hash;
+			e.touched = true;
+			m_dirty = true;
+		}
+
+		size_t Size() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_entries.size();
+		}
+
+		bool IsDirty() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_dirty;
+		}
+
+		// Binary format: "FPHC" u32 version, u32 count, then per entry
+		// u32 pathLen, pathLen x u32 code units, u64 mtime, u64 size, u64 hash.
+		bool Load(std::istream &in)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			char magic[4] = {0};
+			if (!in.read(magic, 4) || std::memcmp(magic, kMagic, 4) != 0)
+				return false;
+			uint32_t version = 0, count = 0;
+			if (!ReadU32(in, version) || version != kVersion || !ReadU32(in, count))
+				return false;
+			std::unordered_map<std::wstring, Entry> loaded;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				uint32_t len = 0;
+				if (!ReadU32(in, len) || len > 32768)
+					return false;
+				std::wstring path(len, L'\0');
+				for (uint32_t c = 0; c < len; c++)
+				{
+					uint32_t ch = 0;
+					if (!ReadU32(in, ch))
+						return false;
+					path[c] = (wchar_t)ch;
+				}
+				Entry e;
+				if (!ReadU64(in, e.mtime) || !ReadU64(in, e.size) || !ReadU64(in, e.hash))
+					return false;
+				loaded[path] = e;
+			}
+			m_entries.swap(loaded);
+			m_dirty = false;
+			return true;
+		}
+
+		// Writes only entries looked up or stored during this session so
+		// removed fonts do not accumulate in the cache file.
+		void Save(std::ostream &out)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			uint32_t count = 0;
+			for (const auto &kv : m_entries)
+				if (kv.second.touched)
+					count++;
+			out.write(kMagic, 4);
+			WriteU32(out, kVersion);
+			WriteU32(out, count);
+			for (const auto &kv : m_entries)
+			{
+				if (!kv.second.touched)
+					continue;
+				WriteU32(out, (uint32_t)kv.first.size());
+				for (wchar_t ch : kv.first)
+					WriteU32(out, (uint32_t)ch);
+				WriteU64(out, kv.second.mtime);
+				WriteU64(out, kv.second.size);
+				WriteU64(out, kv.second.hash);
+			}
+			m_dirty = false;
+		}
+
+	private:
+		struct Entry
+		{
+			uint64_t mtime = 0;
+			uint64_t size = 0;
+			uint64_t hash = 0;
+			bool touched = false;
+		};
+
+		static constexpr const char *kMagic = "FPHC";
+		static constexpr uint32_t kVersion = 1;
+
+		static bool ReadU32(std::istream &in, uint32_t &v)
+		{
+			uint8_t b[4];
+			if (!in.read(reinterpret_cast<char *>(b), 4))
+				return false;
+			v = (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+			return true;
+		}
+		static bool ReadU64(std::istream &in, uint64_t &v)
+		{
+			uint32_t lo = 0, hi = 0;
+			if (!ReadU32(in, lo) || !ReadU32(in, hi))
+				return false;
+			v = (uint64_t)lo | ((uint64_t)hi << 32);
+			return true;
+		}
+		static void WriteU32(std::ostream &out, uint32_t v)
+		{
+			uint8_t b[4] = {(uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24)};
+			out.write(reinterpret_cast<const char *>(b), 4);
+		}
+		static void WriteU64(std::ostream &out, uint64_t v)
+		{
+			WriteU32(out, (uint32_t)v);
+			WriteU32(out, (uint32_t)(v >> 32));
+		}
+
+		mutable std::mutex m_mutex;
+		std::unordered_map<std::wstring, Entry> m_entries;
+		bool m_dirty = false;
+	};
+}
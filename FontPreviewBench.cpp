@@ -0,0 +1,4782 @@
+//----------------------------------------------------------------------------------
+//	FontPreview benchmarks (portable console tool)
+//----------------------------------------------------------------------------------
+// Micro/replay benchmarks for the plugin's portable pieces. Builds with the
+// FontPreviewBench.vcxproj project on Windows, or on any C++17 compiler:
+//   g++ -std=c++17 -O2 -pthread FontPreviewBench.cpp -o FontPreviewBench
+//
+// Usage: FontPreviewBench <benchmark> [options]
+//   log [iterations]   per-call overhead of disabled/enabled log sites
+//   trace [threads] [spansPerThread] [out.json]
+//                      span overhead, concurrent-writer consistency and
+//                      histogram accuracy of Trace.h
+//   replay [script|-] [repeat]
+//                      replay an interaction script (catalog, filter,
+//                      selection, aliases) against FontPreviewCore.h and
+//                      check per-step latency / allocation budgets
+//   previewcache [iterations]
+//                      key equality/hash per field, byte-budget eviction,
+//                      RetainFonts/InvalidateFont and stats (PreviewCache.h)
+//   memory [threads] [insertsPerThread]
+//                      eviction order and pressure behaviour of the
+//                      global memory budget over LruCache clients
+//   invalidate [iterations]
+//                      coalescing and per-action repaint counters of
+//                      DirtyState.h
+//   visibility         state machine of Visibility.h and TaskQueue
+//                      hold-back / resume while hidden or occluded
+//   sweep [threads] [frames] [width] [height]
+//                      keyframe precompute throughput on the worker pool
+//                      and playback jitter of AxisSweep.h
+//   specimen [threads]  waterfall geometry of Specimen.h, visible-only
+//                      relayout and TaskQueue::ParallelFor
+//   compare [iterations]
+//                      pin set persistence and resolution, and line
+//                      breaking against shared analysis (Compare.h)
+//   glyphs [iterations] cmap parsing, block navigation and atlas reuse
+//                      with and without page prefetch (GlyphGrid.h)
+//   autofit [iterations] fitted size against a brute-force scan, and fit
+//                      time for long paragraphs while resizing (AutoFit.h)
+//   batch [objects]    font replacement over a stub EDIT_SECTION timeline:
+//                      scope, per-effect writes and skipped no-ops (BatchEdit.h)
+//   capi [fonts]       headless client of the exported catalog API
+//                      (FontCatalogApi.h): versioning, snapshot lifetime,
+//                      queries, change notifications, reader contention,
+//                      details resolved for clients while the queue is held
+//   zip [entries]      zip central directory index (ZipIndex.h): Zip64,
+//                      entry names, corrupted images, packs in a scanned
+//                      folder, member views against extracted copies
+//   woff [dir]         inflate and WOFF decoding against reference streams
+//                      and corrupted input, WOFF2 headers, the decoded-font
+//                      cache (Woff.h), streaming/parallel decode throughput;
+//                      also decodes every web font under `dir`
+//   catalog [fonts|dir] [requests]
+//                      build a catalog from a synthetic corpus (or `dir`)
+//                      with axes read eagerly and lazily: startup time,
+//                      faces and fvar tables read (SfntReader.h, FontScan.h)
+//   session [fonts] [dir]
+//                      session snapshot round-trip and size (Session.h),
+//                      damaged files, carrying the selection over to a
+//                      changed catalog, restore time against a scan of `dir`
+//   favorites [fonts]  favorites and recent list persistence and order,
+//                      resolution by identity after reordering, the
+//                      bitset filter against matching identities (Favorites.h),
+//                      warm start layouts after a catalog swap (LayoutCache.h)
+#include <cstdio>
+#include <cstdint>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <functional>
+#include <fstream>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+#include <sstream>
+#include <iterator>
+#include <filesystem>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include "LogGate.h"
+#include "Trace.h"
+#include "FontHash.h"
+#include "PreviewCache.h"
+#include "LayoutCache.h"
+#include "FontPreviewCore.h"
+#include "SfntReader.h"
+#include "FontScan.h"
+#include "ZipIndex.h"
+#include "Woff.h"
+#include "AllocCounter.h"
+#include "MemoryBudget.h"
+#include "DirtyState.h"
+#include "Visibility.h"
+#include "TaskQueue.h"
+#include "AxisSweep.h"
+#include "Specimen.h"
+#include "Compare.h"
+#include "GlyphGrid.h"
+#include "AutoFit.h"
+#include "BatchEdit.h"
+#include "CatalogApi.h"
+#include "Session.h"
+#include "Favorites.h"
+
+// Counted in every build so replay can report allocations per step.
+FONTPREVIEW_DEFINE_ALLOC_COUNTER();
+
+namespace
+{
+	//---------------------------------------------------------------------
+	//	Timing helpers
+	//---------------------------------------------------------------------
+	using Clock = std::chrono::steady_clock;
+
+	double ElapsedNs(Clock::time_point t0, Clock::time_point t1)
+	{
+		return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+	}
+
+	// Run `fn(iterations)` once and return ns per iteration.
+	double TimePerCall(uint64_t iterations, const std::function<void(uint64_t)> &fn)
+	{
+		auto t0 = Clock::now();
+		fn(iterations);
+		auto t1 = Clock::now();
+		return iterations ? ElapsedNs(t0, t1) / (double)iterations : 0.0;
+	}
+
+	void PrintRow(const char *name, double nsPerCall)
+	{
+		std::printf("  %-40s %10.2f ns/call\n", name, nsPerCall);
+	}
+
+	//---------------------------------------------------------------------
+	//	log: LogGate overhead
+	//---------------------------------------------------------------------
+	// Stand-in for the host LOG_HANDLE: counts messages and characters so
+	// the formatted text cannot be optimized away.
+	struct CountingLogHandle
+	{
+		void (*log)(CountingLogHandle *, const wchar_t *);
+		void (*info)(CountingLogHandle *, const wchar_t *);
+		void (*warn)(CountingLogHandle *, const wchar_t *);
+		void (*error)(CountingLogHandle *, const wchar_t *);
+		void (*verbose)(CountingLogHandle *, const wchar_t *);
+		uint64_t messages = 0;
+		uint64_t chars = 0;
+	};
+
+	void CountMessage(CountingLogHandle *h, const wchar_t *msg)
+	{
+		h->messages++;
+		h->chars += std::wcslen(msg);
+	}
+
+	CountingLogHandle MakeCountingHandle()
+	{
+		CountingLogHandle h{};
+		h.log = h.info = h.warn = h.error = h.verbose = &CountMessage;
+		return h;
+	}
+
+	int RunLogBenchmark(int argc, char **argv)
+	{
+		uint64_t iterations = argc > 0 ? std::strtoull(argv[0], nullptr, 10) : 0;
+		if (iterations == 0)
+			iterations = 5000000;
+		CountingLogHandle sink = MakeCountingHandle();
+		CountingLogHandle *logger = &sink;
+		volatile int width = 640, height = 480;
+		std::wstring family = L"Noto Sans JP";
+
+		std::printf("log: %llu iterations (FONTPREVIEW_LOG_VERBOSE=%d)\n", (unsigned long long)iterations, FONTPREVIEW_LOG_VERBOSE);
+
+		LogGate::SetLevel(LogGate::Level::Info);
+		PrintRow("baseline (empty loop)", TimePerCall(iterations, [&](uint64_t n)
+													   { for (uint64_t i = 0; i < n; i++) width = width + 0; }));
+
+		// What the plugin did before: format first, let the host drop it.
+		PrintRow("ungated swprintf + verbose()", TimePerCall(iterations, [&](uint64_t n)
+															  {
+			for (uint64_t i = 0; i < n; i++)
+			{
+				wchar_t buf[160];
+				std::swprintf(buf, 160, L"RenderPreview start[%ls]: size=%dx%d selected=%d", L"WM_PAINT", (int)width, (int)height, (int)i);
+				logger->verbose(logger, buf);
+			} }));
+		PrintRow("ungated wstring concat + verbose()", TimePerCall(iterations, [&](uint64_t n)
+																	{
+			for (uint64_t i = 0; i < n; i++)
+			{
+				std::wstring msg = L"EnumerateFonts: added " + family;
+				logger->verbose(logger, msg.c_str());
+			} }));
+
+		uint64_t before = sink.messages;
+		PrintRow("FP_LOG Verbose, level=Info (disabled)", TimePerCall(iterations, [&](uint64_t n)
+																	   {
+			for (uint64_t i = 0; i < n; i++)
+				FP_LOG(logger, Verbose, kCatRender, L"RenderPreview start[%ls]: size=%dx%d selected=%d", L"WM_PAINT", (int)width, (int)height, (int)i); }));
+		PrintRow("FP_LOG_LAZY Verbose (disabled)", TimePerCall(iterations, [&](uint64_t n)
+																{
+			for (uint64_t i = 0; i < n; i++)
+				FP_LOG_LAZY(logger, Verbose, kCatEnum, [&]
+							{ return L"EnumerateFonts: added " + family; }); }));
+		PrintRow("FP_LOG_VERBOSE (stripped or disabled)", TimePerCall(iterations, [&](uint64_t n)
+																	   {
+			for (uint64_t i = 0; i < n; i++)
+				FP_LOG_VERBOSE(logger, kCatRender, L"RenderPreview start[%ls]: size=%dx%d selected=%d", L"WM_PAINT", (int)width, (int)height, (int)i); }));
+		uint64_t leaked = sink.messages - before;
+
+		LogGate::SetLevel(LogGate::Level::Verbose);
+		LogGate::SetCategories(LogGate::kCatAll & ~LogGate::kCatRender);
+		PrintRow("FP_LOG Verbose, category masked", TimePerCall(iterations, [&](uint64_t n)
+																 {
+			for (uint64_t i = 0; i < n; i++)
+				FP_LOG(logger, Verbose, kCatRender, L"RenderPreview start[%ls]: size=%dx%d selected=%d", L"WM_PAINT", (int)width, (int)height, (int)i); }));
+		LogGate::SetCategories(LogGate::kCatAll);
+
+		PrintRow("FP_LOG Verbose, enabled", TimePerCall(iterations, [&](uint64_t n)
+														 {
+			for (uint64_t i = 0; i < n; i++)
+				FP_LOG(logger, Verbose, kCatRender, L"RenderPreview start[%ls]: size=%dx%d selected=%d", L"WM_PAINT", (int)width, (int)height, (int)i); }));
+		uint64_t rateBefore = sink.messages;
+		PrintRow("FP_LOG_RATE Verbose 500ms, enabled", TimePerCall(iterations, [&](uint64_t n)
+																	{
+			for (uint64_t i = 0; i < n; i++)
+				FP_LOG_RATE(logger, Verbose, kCatRender, 500, L"RenderPreview start[%ls]: size=%dx%d selected=%d", L"WM_PAINT", (int)width, (int)height, (int)i); }));
+
+		std::printf("  disabled sites emitted %llu messages (expected 0); rate-limited site emitted %llu\n",
+					(unsigned long long)leaked, (unsigned long long)(sink.messages - rateBefore));
+		std::printf("  sink total: %llu messages, %llu chars\n", (unsigned long long)sink.messages, (unsigned long long)sink.chars);
+		return leaked == 0 ? 0 : 1;
+	}
+
+	//---------------------------------------------------------------------
+	//	trace: Trace.h overhead and consistency
+	//---------------------------------------------------------------------
+	bool Check(bool ok, const char *what)
+	{
+		std::printf("  [%s] %s\n", ok ? "ok" : "FAIL", what);
+		return ok;
+	}
+
+	int RunTraceBenchmark(int argc, char **argv)
+	{
+		unsigned threads = argc > 0 ? (unsigned)std::strtoul(argv[0], nullptr, 10) : 0;
+		uint64_t perThread = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 0;
+		const char *jsonPath = argc > 2 ? argv[2] : nullptr;
+		if (threads == 0)
+			threads = 8;
+		if (perThread == 0)
+			perThread = 200000;
+		bool ok = true;
+		Trace::Registry &reg = Trace::Registry::Get();
+
+		std::printf("trace: overhead (%llu spans)\n", (unsigned long long)perThread);
+		Trace::SetEnabled(false);
+		PrintRow("FP_TRACE_SCOPE disabled", TimePerCall(perThread, [](uint64_t n)
+														 {
+			for (uint64_t i = 0; i < n; i++)
+			{
+				FP_TRACE_SCOPE("bench.disabled");
+			} }));
+		Trace::SetEnabled(true);
+		PrintRow("FP_TRACE_SCOPE enabled", TimePerCall(perThread, [](uint64_t n)
+														{
+			for (uint64_t i = 0; i < n; i++)
+			{
+				FP_TRACE_SCOPE("bench.enabled");
+			} }));
+
+		std::printf("trace: %u concurrent writers x %llu spans\n", threads, (unsigned long long)perThread);
+		reg.Reset();
+		uint32_t workerOp = reg.RegisterOp("bench.worker");
+		auto t0 = Clock::now();
+		std::vector<std::thread> workers;
+		for (unsigned t = 0; t < threads; t++)
+		{
+			workers.emplace_back([perThread]
+								 {
+				for (uint64_t i = 0; i < perThread; i++)
+				{
+					FP_TRACE_SCOPE("bench.worker");
+				} });
+		}
+		for (auto &w : workers)
+			w.join();
+		auto t1 = Clock::now();
+		uint64_t expected = (uint64_t)threads * perThread;
+		std::printf("  %.2f ns/span across threads\n", ElapsedNs(t0, t1) / (double)expected);
+		Trace::Histogram::Summary worker = reg.Summarize(workerOp);
+		ok &= Check(worker.count == expected, "histogram count == spans written");
+		ok &= Check(reg.GetRing().Written() == expected, "ring tickets == spans written");
+		std::vector<Trace::Event> events = reg.GetRing().Snapshot();
+		ok &= Check(events.size() <= Trace::kRingCapacity && events.size() >= Trace::kRingCapacity * 9 / 10,
+					"snapshot holds (almost) a full ring of recent events");
+		bool validOps = std::all_of(events.begin(), events.end(), [&](const Trace::Event &e)
+									{ return e.op == workerOp; });
+		ok &= Check(validOps, "every snapshot event belongs to the worker op");
+		std::unordered_map<uint32_t, uint64_t> lastStart;
+		bool ordered = true;
+		for (const auto &e : events)
+		{
+			uint64_t &last = lastStart[e.threadId];
+			if (e.startNs < last)
+				ordered = false;
+			last = e.startNs;
+		}
+		ok &= Check(ordered, "per-thread events are in start order");
+
+		std::printf("trace: histogram accuracy\n");
+		Trace::Histogram h;
+		std::vector<uint64_t> samples;
+		for (uint64_t v = 1; v <= 100000; v++)
+			samples.push_back(v * 37 % 100000 + 1000);
+		for (uint64_t v : samples)
+			h.Record(v);
+		std::sort(samples.begin(), samples.end());
+		auto exact = [&](double q)
+		{ return samples[(size_t)(q * (double)samples.size()) - 1]; };
+		Trace::Histogram::Summary hs = h.Summarize();
+		auto within = [](uint64_t got, uint64_t want)
+		{ return std::fabs((double)got - (double)want) <= (double)want * 0.125; };
+		ok &= Check(within(hs.p50Ns, exact(0.50)) && within(hs.p95Ns, exact(0.95)) && within(hs.p99Ns, exact(0.99)),
+					"p50/p95/p99 within 12.5% of exact");
+		ok &= Check(hs.maxNs == samples.back(), "max is exact");
+
+		for (const auto &line : reg.SummaryLines())
+			std::printf("  %s\n", line.c_str());
+		if (jsonPath)
+		{
+			std::ofstream out(jsonPath, std::ios::binary);
+			reg.WriteChromeTrace(out);
+			std::printf("  wrote %s\n", jsonPath);
+		}
+		return ok ? 0 : 1;
+	}
+
+	//---------------------------------------------------------------------
+	//	replay: scripted interaction against the headless core
+	//---------------------------------------------------------------------
+	// Script lines (UTF-8, `#` starts a comment):
+	//   load synthetic <count>        generated catalog, half system / half folder
+	//   load dir <path>               every TTF/OTF/TTC under <path> (FontScan.h)
+	//   type <text>                   append to the query one character at a time
+	//   erase <count>                 backspace the query
+	//   clear                         empty the query
+	//   filter all|system|folder      change FontTypeFilter
+	//   down <count> / up <count>     arrow through the rows
+	//   browse down|up <count>        same, recorded as "browse": meant for rows
+	//                                 already visited (steady state, no allocation)
+	//
+	// Each selection step runs what the plugin's warm selection runs outside
+	// Win32/Direct2D: FilterCatalog/row lookup, the detail labels
+	// (FontPreviewCore::FormatDetail, as UpdateDetailPanel) and the preview
+	// key and lookup (PreviewCache::AssignKey + Find, as
+	// MakePreviewBitmapKey). An `allocs` budget covers that code only;
+	// SetWindowTextW, the face lock, ListView and drawing are not measured
+	// here (Debug plugin builds log a warning for those instead).
+	//   expand                        expand the selected family into styles
+	//   sample <text>                 retype the sample text one character at a time
+	//   axis <tag> <value>            set a slider coordinate used by VF aliases
+	//   alias text|vf <count>         build aliases, moving down a row between them
+	//   budget <step> p95|p99|max <ms>
+	//   budget <step> allocs <per call>
+	const char *const kDefaultReplayScript =
+		"load synthetic 10000\n"
+		"type noto\n"
+		"down 200\n"
+		"browse up 40\n"
+		"browse down 40\n"
+		"filter folder\n"
+		"filter system\n"
+		"filter all\n"
+		"expand\n"
+		"down 20\n"
+		"sample The quick brown fox あいうえお 永\n"
+		"axis wght 700\n"
+		"axis opsz 24\n"
+		"alias vf 25\n"
+		"alias text 25\n"
+		"erase 4\n"
+		"budget type p95 10\n"
+		"budget filter p95 10\n"
+		"budget select p95 0.5\n"
+		"budget sample p95 0.5\n"
+		"budget alias p95 1\n"
+		"budget type allocs 20000\n"
+		"budget select allocs 64\n"
+		"budget browse allocs 0\n";
+
+	enum class ReplayStep
+	{
+		Load,
+		Type,
+		Filter,
+		Select,
+		Browse,
+		Expand,
+		Sample,
+		Alias,
+		Count
+	};
+
+	const char *const kReplayStepNames[] = {"load", "type", "filter", "select", "browse", "expand", "sample", "alias"};
+
+	struct ReplayStats
+	{
+		Trace::Histogram latency;
+		uint64_t calls = 0;
+		uint64_t allocs = 0;
+		uint64_t allocBytes = 0;
+	};
+
+	struct ReplayBudget
+	{
+		ReplayStep step = ReplayStep::Load;
+		std::string metric;
+		double limit = 0.0;
+	};
+
+	// Shape of the plugin's FontItem as far as FontPreviewCore is concerned.
+	struct BenchFont
+	{
+		std::wstring displayName;
+		std::wstring filePath;
+		std::wstring sourcePath;
+		bool isSystemFont = true;
+		uint32_t faceIndex = 0;
+		uint64_t contentHash = 0;
+		int faceCount = 1;
+		std::wstring familyName;
+		std::wstring cacheKey;
+		bool axesResolved = false;
+		std::wstring axisTooltip;
+	};
+
+	struct ReplaySession
+	{
+		std::vector<BenchFont> fonts;
+		std::vector<int> filtered;
+		std::vector<FontPreviewCore::ListRow> rows;
+		std::unordered_set<int> expanded;
+		FontPreviewCore::FontTypeFilter filter = FontPreviewCore::FontTypeFilter::All;
+		std::wstring query;
+		std::wstring sample = L"あいうABC123";
+		int selectedFont = -1;
+		int selectedFace = -1;
+		int row = -1;
+		// Stands in for the bitmap cache: same keys, an int instead of a bitmap.
+		PreviewCache::Cache<int> previews{48u * 1024u * 1024u};
+		// Reused across selections, as in the plugin.
+		PreviewCache::Key lookupKey;
+		FontPreviewCore::DetailText detail;
+		// Stand in for the plugin's enumerated face names, built once.
+		std::vector<std::wstring> faceNames;
+		size_t aliasBytes = 0;
+		FontPreviewCore::AxisCoordinates axes; // slider coordinates for VF aliases
+	};
+
+	std::wstring FromUtf8(const std::string &s)
+	{
+		std::wstring out;
+		for (size_t i = 0; i < s.size();)
+		{
+			uint8_t c = (uint8_t)s[i];
+			int extra = c < 0x80 ? 0 : c < 0xE0 ? 1 : c < 0xF0 ? 2 : 3;
+			uint32_t cp = extra == 0 ? c : extra == 1 ? (c & 0x1F) : extra == 2 ? (c & 0x0F) : (c & 0x07);
+			for (int k = 1; k <= extra && i + k < s.size(); k++)
+				cp = (cp << 6) | ((uint8_t)s[i + k] & 0x3F);
+			i += extra + 1;
+			if (sizeof(wchar_t) == 2 && cp >= 0x10000)
+			{
+				out.push_back((wchar_t)(0xD800 + ((cp - 0x10000) >> 10)));
+				out.push_back((wchar_t)(0xDC00 + ((cp - 0x10000) & 0x3FF)));
+			}
+			else
+			{
+				out.push_back((wchar_t)cp);
+			}
+		}
+		return out;
+	}
+
+	void BuildFaceNames(ReplaySession &s)
+	{
+		int faces = 0;
+		for (const BenchFont &f : s.fonts)
+			faces = std::max(faces, f.faceCount);
+		s.faceNames.clear();
+		for (int i = 0; i < faces; i++)
+			s.faceNames.push_back(L"Style " + std::to_wstring(i));
+	}
+
+	void LoadSyntheticCatalog(ReplaySession &s, size_t count)
+	{
+		static const wchar_t *const kFamilies[] = {
+			L"Noto Sans", L"Noto Serif", L"Source Han Sans", L"Source Han Serif", L"BIZ UDGothic", L"BIZ UDMincho",
+			L"Meiryo", L"Yu Gothic", L"M PLUS 1p", L"Zen Kaku Gothic", L"Roboto", L"Inter", L"Fira Sans", L"IBM Plex Sans"};
+		static const wchar_t *const kSuffixes[] = {L"", L" JP", L" KR", L" SC", L" Mono", L" Display", L" Condensed", L" Rounded"};
+		const size_t families = sizeof(kFamilies) / sizeof(kFamilies[0]);
+		const size_t suffixes = sizeof(kSuffixes) / sizeof(kSuffixes[0]);
+		uint64_t seed = 0x9E3779B97F4A7C15ull;
+		s.fonts.clear();
+		s.fonts.reserve(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			seed ^= seed << 13;
+			seed ^= seed >> 7;
+			seed ^= seed << 17;
+			BenchFont f;
+			std::wstring family = std::wstring(kFamilies[i % families]) + kSuffixes[(i / families) % suffixes];
+			size_t variant = i / (families * suffixes);
+			if (variant > 0)
+				family += L" " + std::to_wstring(variant);
+			f.isSystemFont = (seed & 1) == 0;
+			if (f.isSystemFont)
+			{
+				f.displayName = family;
+				f.sourcePath = L"C:\\Windows\\Fonts\\font" + std::to_wstring(i) + L".ttf";
+			}
+			else
+			{
+				std::wstring file = L"font" + std::to_wstring(i) + L".ttf";
+				f.displayName = family + L" [" + file + L"]";
+				f.filePath = L"C:\\Fonts\\" + file;
+				f.sourcePath = f.filePath;
+			}
+			f.contentHash = seed;
+			f.faceCount = 1 + (int)((seed >> 8) % 9);
+			if ((seed >> 16) % 4 == 0)
+			{
+				f.axesResolved = true;
+				f.axisTooltip = L"wght 100-900 (既定 400)";
+			}
+			FontPreviewCore::PrecomputeDisplayStrings(f);
+			s.fonts.push_back(std::move(f));
+		}
+		BuildFaceNames(s);
+	}
+
+	bool LoadDirectoryCatalog(ReplaySession &s, const std::string &dir)
+	{
+		s.fonts.clear();
+		bool listed = FontScan::ScanDirectory(dir, true, [&](const FontScan::Face &face)
+											  {
+			BenchFont f;
+			f.isSystemFont = false;
+			f.filePath = face.filePath;
+			f.sourcePath = face.filePath;
+			f.displayName = FontScan::DisplayName(face.info.familyName, face.fileName);
+			f.faceIndex = face.info.faceIndex;
+			f.contentHash = face.contentHash;
+			f.faceCount = face.info.namedInstanceCount > 0 ? face.info.namedInstanceCount : 1;
+			FontPreviewCore::PrecomputeDisplayStrings(f);
+			s.fonts.push_back(std::move(f)); });
+		BuildFaceNames(s);
+		return listed;
+	}
+
+	// Headless ApplyFilter: filter, keep or move the selection, rebuild rows.
+	void ReplayApplyFilter(ReplaySession &s)
+	{
+		FontPreviewCore::FilterCatalog(s.fonts, s.filter, s.query, s.filtered);
+		FontPreviewCore::ReconcileSelection(s.filtered, s.selectedFont, s.selectedFace);
+		FontPreviewCore::BuildListRows(s.filtered, [&](int fontIdx)
+									   { return s.expanded.count(fontIdx) ? s.fonts[fontIdx].faceCount : 0; }, s.rows);
+		s.row = FontPreviewCore::FindListRow(s.rows, s.selectedFont, s.selectedFace);
+	}
+
+	// What the UI thread does for the selected preview without a GPU: the
+	// detail label text and the bitmap-cache lookup (insert on miss).
+	void ReplayPreview(ReplaySession &s)
+	{
+		if (s.selectedFont < 0)
+			return;
+		const BenchFont &item = s.fonts[s.selectedFont];
+		const wchar_t *faceName = s.selectedFace >= 0 && s.selectedFace < item.faceCount ? s.faceNames[s.selectedFace].c_str() : nullptr;
+		FontPreviewCore::FormatDetail(item, faceName, item.faceCount, s.detail);
+		PreviewCache::Key &key = s.lookupKey;
+		PreviewCache::AssignKey(key, item.cacheKey, (uint64_t)(s.selectedFace + 1), s.sample, 640, 240, 0xFFFFFF, 96);
+		if (!s.previews.Find(key))
+			s.previews.Insert(key, s.selectedFont);
+	}
+
+	void ReplaySelectRow(ReplaySession &s, int row)
+	{
+		if (row < 0 || row >= (int)s.rows.size())
+			return;
+		s.row = row;
+		s.selectedFont = s.rows[row].fontIndex;
+		s.selectedFace = s.rows[row].faceIndex;
+		ReplayPreview(s);
+	}
+
+	struct ReplayRunner
+	{
+		ReplaySession session;
+		ReplayStats stats[(int)ReplayStep::Count];
+		std::vector<ReplayBudget> budgets;
+		bool collectBudgets = true;
+
+		template <typename Fn>
+		void Measure(ReplayStep step, Fn &&fn)
+		{
+			AllocCounter::Scope allocs;
+			auto t0 = Clock::now();
+			fn();
+			auto t1 = Clock::now();
+			ReplayStats &st = stats[(int)step];
+			st.latency.Record((uint64_t)ElapsedNs(t0, t1));
+			st.calls++;
+			st.allocs += allocs.Allocations();
+			st.allocBytes += allocs.Bytes();
+		}
+
+		bool Execute(const std::string &line, int lineNo)
+		{
+			std::istringstream in(line);
+			std::string cmd;
+			in >> cmd;
+			if (cmd.empty() || cmd[0] == '#')
+				return true;
+			std::string rest;
+			std::getline(in >> std::ws, rest);
+			ReplaySession &s = session;
+			if (cmd == "load")
+			{
+				std::istringstream args(rest);
+				std::string kind, value;
+				args >> kind;
+				std::getline(args >> std::ws, value);
+				bool loaded = true;
+				Measure(ReplayStep::Load, [&]
+						{
+					if (kind == "synthetic")
+						LoadSyntheticCatalog(s, (size_t)std::strtoull(value.c_str(), nullptr, 10));
+					else
+						loaded = kind == "dir" && LoadDirectoryCatalog(s, value);
+					s.query.clear();
+					s.selectedFont = s.selectedFace = -1;
+					s.expanded.clear();
+					s.previews.Clear();
+					ReplayApplyFilter(s); });
+				if (!loaded)
+					return Fail(lineNo, "could not load catalog");
+				if (s.fonts.empty())
+					return Fail(lineNo, "catalog is empty");
+			}
+			else if (cmd == "type")
+			{
+				for (wchar_t ch : FromUtf8(rest))
+					Measure(ReplayStep::Type, [&]
+							{
+						s.query.push_back(ch);
+						ReplayApplyFilter(s);
+						ReplayPreview(s); });
+			}
+			else if (cmd == "erase")
+			{
+				int n = std::atoi(rest.c_str());
+				for (int i = 0; i < n && !s.query.empty(); i++)
+					Measure(ReplayStep::Type, [&]
+							{
+						s.query.pop_back();
+						ReplayApplyFilter(s);
+						ReplayPreview(s); });
+			}
+			else if (cmd == "clear" || cmd == "filter")
+			{
+				if (cmd == "filter")
+				{
+					if (rest == "all")
+						s.filter = FontPreviewCore::FontTypeFilter::All;
+					else if (rest == "system")
+						s.filter = FontPreviewCore::FontTypeFilter::System;
+					else if (rest == "folder")
+						s.filter = FontPreviewCore::FontTypeFilter::Folder;
+					else
+						return Fail(lineNo, "filter expects all|system|folder");
+				}
+				Measure(ReplayStep::Filter, [&]
+						{
+					if (cmd == "clear")
+						s.query.clear();
+					ReplayApplyFilter(s);
+					ReplayPreview(s); });
+			}
+			else if (cmd == "down" || cmd == "up" || cmd == "browse")
+			{
+				ReplayStep step = ReplayStep::Select;
+				std::string dir = cmd;
+				std::istringstream args(rest);
+				if (cmd == "browse")
+				{
+					step = ReplayStep::Browse;
+					args >> dir;
+					if (dir != "down" && dir != "up")
+						return Fail(lineNo, "browse expects down|up <count>");
+				}
+				int n = 0;
+				args >> n;
+				int delta = dir == "down" ? 1 : -1;
+				for (int i = 0; i < n; i++)
+					Measure(step, [&]
+							{ ReplaySelectRow(s, FontPreviewCore::StepListRow(s.rows, s.row, delta)); });
+			}
+			else if (cmd == "expand")
+			{
+				Measure(ReplayStep::Expand, [&]
+						{
+					if (s.selectedFont >= 0)
+						s.expanded.insert(s.selectedFont);
+					FontPreviewCore::BuildListRows(s.filtered, [&](int fontIdx)
+												   { return s.expanded.count(fontIdx) ? s.fonts[fontIdx].faceCount : 0; }, s.rows);
+					s.row = FontPreviewCore::FindListRow(s.rows, s.selectedFont, s.selectedFace); });
+			}
+			else if (cmd == "axis")
+			{
+				std::istringstream args(rest);
+				std::string tag;
+				float value = 0.0f;
+				if (!(args >> tag >> value) || tag.size() != 4)
+					return Fail(lineNo, "axis expects <tag> <value>");
+				auto it = std::find_if(s.axes.begin(), s.axes.end(), [&](const std::pair<std::string, float> &a)
+									   { return a.first == tag; });
+				if (it != s.axes.end())
+					it->second = value;
+				else
+					s.axes.emplace_back(tag, value);
+			}
+			else if (cmd == "sample")
+			{
+				std::wstring text = FromUtf8(rest);
+				s.sample.clear();
+				for (wchar_t ch : text)
+					Measure(ReplayStep::Sample, [&]
+							{
+						s.sample.push_back(ch);
+						ReplayPreview(s); });
+			}
+			else if (cmd == "alias")
+			{
+				std::istringstream args(rest);
+				std::string kind;
+				int n = 0;
+				args >> kind >> n;
+				if (kind != "text" && kind != "vf")
+					return Fail(lineNo, "alias expects text|vf");
+				for (int i = 0; i < n; i++)
+				{
+					Measure(ReplayStep::Alias, [&]
+							{
+						if (s.selectedFont < 0)
+							return;
+						const BenchFont &item = s.fonts[s.selectedFont];
+						std::string alias = kind == "vf"
+							? FontPreviewCore::BuildVFAliasForItem(item, s.sample, 0, &s.axes)
+							: FontPreviewCore::BuildTextAliasForItem(item, s.sample, 0);
+						s.aliasBytes += alias.size(); });
+					ReplaySelectRow(s, FontPreviewCore::StepListRow(s.rows, s.row, 1));
+				}
+			}
+			else if (cmd == "budget")
+			{
+				std::istringstream args(rest);
+				std::string step;
+				ReplayBudget b;
+				args >> step >> b.metric >> b.limit;
+				const char *const *name = std::find_if(std::begin(kReplayStepNames), std::end(kReplayStepNames), [&](const char *n)
+													   { return step == n; });
+				if (name == std::end(kReplayStepNames) || (b.metric != "p95" && b.metric != "p99" && b.metric != "max" && b.metric != "allocs"))
+					return Fail(lineNo, "budget expects <step> p95|p99|max|allocs <limit>");
+				b.step = (ReplayStep)(name - std::begin(kReplayStepNames));
+				if (collectBudgets)
+					budgets.push_back(b);
+			}
+			else
+			{
+				return Fail(lineNo, "unknown command");
+			}
+			return true;
+		}
+
+		bool Fail(int lineNo, const char *what)
+		{
+			std::printf("  script line %d: %s\n", lineNo, what);
+			return false;
+		}
+
+		bool CheckBudgets()
+		{
+			bool ok = true;
+			for (const auto &b : budgets)
+			{
+				const ReplayStats &st = stats[(int)b.step];
+				Trace::Histogram::Summary h = st.latency.Summarize();
+				double value = b.metric == "allocs" ? (st.calls ? (double)st.allocs / (double)st.calls : 0.0)
+							   : b.metric == "p95"  ? (double)h.p95Ns / 1e6
+							   : b.metric == "p99"  ? (double)h.p99Ns / 1e6
+													: (double)h.maxNs / 1e6;
+				char what[160];
+				std::snprintf(what, sizeof(what), "%s %s %.3f <= %.3f%s", kReplayStepNames[(int)b.step], b.metric.c_str(), value, b.limit,
+							  b.metric == "allocs" ? "" : " ms");
+				ok &= Check(value <= b.limit, what);
+			}
+			return ok;
+		}
+
+		void PrintStats() const
+		{
+			std::printf("  %-8s %7s %10s %10s %10s %10s %10s %12s %10s\n", "step", "calls", "mean ms", "p50 ms", "p95 ms", "p99 ms", "max ms", "allocs/call", "KB/call");
+			for (int i = 0; i < (int)ReplayStep::Count; i++)
+			{
+				const ReplayStats &st = stats[i];
+				if (st.calls == 0)
+					continue;
+				Trace::Histogram::Summary h = st.latency.Summarize();
+				std::printf("  %-8s %7llu %10.4f %10.4f %10.4f %10.4f %10.4f %12.1f %10.2f\n", kReplayStepNames[i], (unsigned long long)st.calls,
+							h.meanNs / 1e6, h.p50Ns / 1e6, h.p95Ns / 1e6, h.p99Ns / 1e6, h.maxNs / 1e6,
+							(double)st.allocs / (double)st.calls, (double)st.allocBytes / 1024.0 / (double)st.calls);
+			}
+		}
+	};
+
+	// replay [script|-] [repeat]: `-` or no script runs the built-in one.
+	// Exit code 1 when the script fails or a budget is exceeded.
+	int RunReplayBenchmark(int argc, char **argv)
+	{
+		std::string scriptName = argc > 0 ? argv[0] : "-";
+		int repeat = argc > 1 ? std::atoi(argv[1]) : 0;
+		if (repeat <= 0)
+			repeat = 3;
+		std::string script = kDefaultReplayScript;
+		if (scriptName != "-")
+		{
+			std::ifstream in(scriptName, std::ios::binary);
+			if (!in)
+			{
+				std::printf("replay: cannot open %s\n", scriptName.c_str());
+				return 1;
+			}
+			script.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		}
+
+		ReplayRunner runner;
+		for (int pass = 0; pass < repeat; pass++)
+		{
+			runner.collectBudgets = pass == 0;
+			std::istringstream lines(script);
+			std::string line;
+			int lineNo = 0;
+			while (std::getline(lines, line))
+			{
+				lineNo++;
+				if (!line.empty() && line.back() == '\r')
+					line.pop_back();
+				if (!runner.Execute(line, lineNo))
+					return 1;
+			}
+		}
+		std::printf("replay: script=%s passes=%d fonts=%zu rows=%zu alias bytes=%zu\n", scriptName == "-" ? "(built-in)" : scriptName.c_str(),
+					repeat, runner.session.fonts.size(), runner.session.rows.size(), runner.session.aliasBytes);
+		runner.PrintStats();
+		return runner.CheckBudgets() ? 0 : 1;
+	}
+
+	//---------------------------------------------------------------------
+	//	previewcache: PreviewCache.h keys, eviction and catalog retention
+	//---------------------------------------------------------------------
+	PreviewCache::Key MakePreviewKey(const std::wstring &fontKey, const wchar_t *text, uint32_t width, uint32_t height)
+	{
+		PreviewCache::Key key;
+		key.fontKey = fontKey;
+		key.textHash = PreviewCache::HashText(text);
+		key.width = width;
+		key.height = height;
+		key.bgColor = 0xFFFFFF;
+		return key;
+	}
+
+	int RunPreviewCacheBenchmark(int argc, char **argv)
+	{
+		uint64_t iterations = argc > 0 ? std::strtoull(argv[0], nullptr, 10) : 0;
+		if (iterations == 0)
+			iterations = 200000;
+		bool ok = true;
+		PreviewCache::KeyHash hash;
+
+		std::printf("previewcache: keys\n");
+		{
+			const PreviewCache::Key base = MakePreviewKey(L"sys:Meiryo@0123456789abcdef", L"あいうABC123", 640, 240);
+			// One variant per field; each must be a different key with a
+			// different hash.
+			std::vector<std::pair<const char *, PreviewCache::Key>> variants;
+			PreviewCache::Key k = base;
+			k.fontKey = L"sys:Meiryo@0123456789abcdee";
+			variants.push_back({"fontKey (content hash)", k});
+			k = base;
+			k.faceHash = 1;
+			variants.push_back({"faceHash", k});
+			k = base;
+			k.textHash = PreviewCache::HashText(L"あいうABC124");
+			variants.push_back({"textHash", k});
+			k = base;
+			k.width++;
+			variants.push_back({"width", k});
+			k = base;
+			k.height++;
+			variants.push_back({"height", k});
+			k = base;
+			k.bgColor = 0xFFFFFE;
+			variants.push_back({"bgColor", k});
+			k = base;
+			k.dpi = 144;
+			variants.push_back({"dpi", k});
+			k = base;
+			std::swap(k.width, k.height);
+			variants.push_back({"width/height swapped", k});
+			PreviewCache::Key copy = base;
+			ok &= Check(copy == base && hash(copy) == hash(base), "equal keys compare and hash equal");
+			for (const auto &v : variants)
+			{
+				char what[96];
+				std::snprintf(what, sizeof(what), "%s changes equality and the hash", v.first);
+				ok &= Check(!(v.second == base) && hash(v.second) != hash(base), what);
+			}
+
+			// Hash spread over a realistic key mix: fonts x sizes x colours.
+			std::unordered_set<size_t> hashes;
+			size_t keys = 0;
+			for (int font = 0; font < 500; font++)
+			{
+				for (uint32_t width = 400; width < 420; width++)
+				{
+					for (uint32_t bg : {0xFFFFFFu, 0x000000u})
+					{
+						PreviewCache::Key key = MakePreviewKey(L"file:C:\\Fonts\\font" + std::to_wstring(font) + L".ttf#0@0", L"sample", width, 300);
+						key.bgColor = bg;
+						hashes.insert(hash(key));
+						keys++;
+					}
+				}
+			}
+			ok &= Check(hashes.size() == keys, "no hash collisions across 20000 font/size/colour keys");
+		}
+
+		std::printf("previewcache: eviction\n");
+		{
+			// Room for exactly three 100x100 previews.
+			const size_t bitmap = PreviewCache::BitmapBytes(100, 100);
+			PreviewCache::Cache<int> cache(bitmap * 3);
+			PreviewCache::Key a = MakePreviewKey(L"a", L"t", 100, 100), b = MakePreviewKey(L"b", L"t", 100, 100),
+							  c = MakePreviewKey(L"c", L"t", 100, 100), d = MakePreviewKey(L"d", L"t", 100, 100);
+			cache.Insert(a, 1);
+			cache.Insert(b, 2);
+			cache.Insert(c, 3);
+			ok &= Check(cache.ResidentBytes() == bitmap * 3 && cache.GetStats().entries == 3, "resident bytes are width x height x 4 per preview");
+			ok &= Check(cache.Find(a) && *cache.Find(a) == 1, "a hit returns the stored bitmap");
+			cache.Insert(d, 4);
+			ok &= Check(!cache.Contains(b) && cache.Contains(a) && cache.Contains(c) && cache.Contains(d),
+						"inserting past the budget evicts the least recently used (a hit refreshes)");
+			ok &= Check(cache.GetStats().evictions == 1 && cache.ResidentBytes() == bitmap * 3, "one eviction, still within budget");
+			PreviewCache::Key big = MakePreviewKey(L"big", L"t", 200, 200);
+			ok &= Check(!cache.Insert(big, 5) && cache.GetStats().entries == 3, "a preview larger than the budget is not stored");
+			cache.Insert(c, 30);
+			ok &= Check(*cache.Find(c) == 30 && cache.ResidentBytes() == bitmap * 3, "re-inserting a key replaces it without double counting");
+			ok &= Check(cache.Trim(bitmap) == bitmap && !cache.Contains(a) && cache.GetStats().entries == 2, "Trim frees from the cold end");
+			cache.SetCapacity(bitmap);
+			ok &= Check(cache.GetStats().entries == 1 && cache.Contains(c), "shrinking the budget keeps the hottest preview");
+
+			PreviewCache::Cache<int>::Stats stats = cache.GetStats();
+			cache.Find(d);
+			cache.Find(c);
+			PreviewCache::Cache<int>::Stats after = cache.GetStats();
+			ok &= Check(after.hits == stats.hits + 1 && after.misses == stats.misses + 1, "hits and misses are counted per lookup");
+			cache.Contains(c);
+			ok &= Check(cache.GetStats().hits == after.hits && cache.GetStats().misses == after.misses, "Contains counts neither");
+		}
+
+		std::printf("previewcache: catalog changes\n");
+		{
+			ReplaySession s;
+			LoadSyntheticCatalog(s, 200);
+			PreviewCache::Cache<int> cache(64u * 1024u * 1024u);
+			for (const auto &f : s.fonts)
+			{
+				cache.Insert(MakePreviewKey(f.cacheKey, L"t", 64, 64), 0);
+				cache.Insert(MakePreviewKey(f.cacheKey, L"u", 64, 64), 0);
+			}
+			// Next enumeration: font 0 is gone, font 1's file was replaced.
+			std::wstring gone = s.fonts[0].cacheKey, replaced = s.fonts[1].cacheKey;
+			s.fonts.erase(s.fonts.begin());
+			s.fonts[0].contentHash ^= 1;
+			FontPreviewCore::PrecomputeDisplayStrings(s.fonts[0]);
+			std::unordered_set<std::wstring> live;
+			for (const auto &f : s.fonts)
+				live.insert(f.cacheKey);
+			size_t dropped = cache.RetainFonts(live);
+			ok &= Check(dropped == 4 && !cache.Contains(MakePreviewKey(gone, L"t", 64, 64)) && !cache.Contains(MakePreviewKey(replaced, L"u", 64, 64)),
+						"RetainFonts drops removed fonts and fonts whose content changed");
+			ok &= Check(cache.Contains(MakePreviewKey(s.fonts[5].cacheKey, L"t", 64, 64)) && cache.GetStats().entries == 2 * (s.fonts.size() - 1),
+						"unchanged fonts keep their previews");
+			size_t beforeBytes = cache.ResidentBytes();
+			ok &= Check(cache.InvalidateFont(s.fonts[5].cacheKey) == 2 && !cache.Contains(MakePreviewKey(s.fonts[5].cacheKey, L"u", 64, 64)) &&
+							cache.ResidentBytes() == beforeBytes - 2 * PreviewCache::BitmapBytes(64, 64),
+						"InvalidateFont drops every preview of one font and its bytes");
+			ok &= Check(cache.InvalidateFont(L"sys:none") == 0, "invalidating an uncached font drops nothing");
+		}
+
+		std::printf("previewcache: lookup cost (%llu lookups)\n", (unsigned long long)iterations);
+		{
+			PreviewCache::Cache<int> cache(256u * 1024u * 1024u);
+			std::vector<PreviewCache::Key> keys;
+			for (int i = 0; i < 256; i++)
+			{
+				keys.push_back(MakePreviewKey(L"file:C:\\Fonts\\font" + std::to_wstring(i) + L".ttf#0@00000000deadbeef", L"あいうABC123", 640, 240));
+				cache.Insert(keys.back(), i);
+			}
+			PreviewCache::Key lookup;
+			size_t sink = 0;
+			double ns = TimePerCall(iterations, [&](uint64_t n)
+									{
+				for (uint64_t i = 0; i < n; i++)
+				{
+					const PreviewCache::Key &src = keys[i & 255];
+					lookup.fontKey.assign(src.fontKey);
+					lookup.textHash = src.textHash;
+					lookup.width = src.width;
+					lookup.height = src.height;
+					lookup.bgColor = src.bgColor;
+					if (int *hit = cache.Find(lookup))
+						sink += (size_t)*hit;
+				} });
+			PreviewCache::Cache<int>::Stats stats = cache.GetStats();
+			std::printf("  %.1f ns per hit, hit rate %.1f%%  [sink %zu]\n", ns, stats.HitRate() * 100.0, sink);
+			ok &= Check(stats.hits == iterations && stats.misses == 0, "every lookup of a cached key hits");
+		}
+		return ok ? 0 : 1;
+	}
+
+	//---------------------------------------------------------------------
+	//	memory: MemoryBudget.h eviction order and pressure
+	//---------------------------------------------------------------------
+	// Stand-in for a plugin cache: an LruCache behind its own mutex,
+	// registered with the manager the same way the plugin registers its
+	// preview and font caches.
+	struct BudgetedCache
+	{
+		std::mutex mutex;
+		LruCache<uint64_t, int> cache;
+
+		void Put(uint64_t key, size_t bytes)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			cache.Put(key, 0, bytes);
+		}
+
+		size_t Bytes()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return cache.Bytes();
+		}
+
+		int Register(MemoryBudget::Manager &mgr, const char *name, MemoryBudget::Priority priority)
+		{
+			return mgr.Register(
+				name, priority, [this]()
+				{ return Bytes(); },
+				[this](size_t bytes)
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					return cache.Trim(bytes);
+				});
+		}
+	};
+
+	int RunMemoryBenchmark(int argc, char **argv)
+	{
+		unsigned threads = argc > 0 ? (unsigned)std::strtoul(argv[0], nullptr, 10) : 0;
+		uint64_t perThread = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 0;
+		if (threads == 0)
+			threads = 4;
+		if (perThread == 0)
+			perThread = 20000;
+		using MemoryBudget::Priority;
+		const size_t kKB = 1024;
+		bool ok = true;
+
+		std::printf("memory: eviction order\n");
+		{
+			MemoryBudget::Manager mgr(100 * kKB);
+			BudgetedCache low, normal, high;
+			high.Register(mgr, "high", Priority::High);
+			normal.Register(mgr, "normal", Priority::Normal);
+			low.Register(mgr, "low", Priority::Low);
+			for (uint64_t i = 0; i < 5; i++)
+			{
+				low.Put(i, 10 * kKB);
+				normal.Put(i, 10 * kKB);
+				high.Put(i, 10 * kKB);
+			}
+			ok &= Check(mgr.Enforce() == 50 * kKB && mgr.TotalBytes() == 100 * kKB, "enforce frees exactly the excess");
+			ok &= Check(low.Bytes() == 0 && normal.Bytes() == 50 * kKB && high.Bytes() == 50 * kKB, "low priority is emptied first");
+
+			low.Put(100, 10 * kKB);
+			for (uint64_t i = 0; i < 3; i++)
+				normal.Put(200 + i, 10 * kKB);
+			mgr.Enforce();
+			ok &= Check(low.Bytes() == 0 && normal.Bytes() == 50 * kKB && high.Bytes() == 50 * kKB,
+						"normal trimmed only after low, and only as much as needed");
+
+			mgr.SetBudget(30 * kKB);
+			mgr.Enforce();
+			ok &= Check(normal.Bytes() == 0 && high.Bytes() == 30 * kKB, "a lower budget reaches high priority last");
+			MemoryBudget::Manager::Stats st = mgr.GetStats();
+			ok &= Check(st.overBudget == 0 && st.trimmedBytes == 160 * kKB, "stats count trimmed bytes");
+		}
+
+		std::printf("memory: accounting-only clients\n");
+		{
+			MemoryBudget::Manager mgr(10 * kKB);
+			size_t fixedBytes = 25 * kKB;
+			mgr.Register("fixed", Priority::High, [&]()
+						 { return fixedBytes; });
+			BudgetedCache low;
+			int lowId = low.Register(mgr, "low", Priority::Low);
+			low.Put(1, 5 * kKB);
+			mgr.Enforce();
+			ok &= Check(low.Bytes() == 0 && mgr.TotalBytes() == fixedBytes, "trimmable clients are emptied, fixed one is kept");
+			ok &= Check(mgr.GetStats().overBudget == 1, "unreachable budget is counted as over budget");
+			mgr.Unregister(lowId);
+			int clients = 0;
+			mgr.ForEachClient([&](const char *, Priority, size_t)
+							  { clients++; });
+			ok &= Check(clients == 1, "unregister removes the client");
+		}
+
+		std::printf("memory: pressure (%u inserters, %llu inserts each)\n", threads, (unsigned long long)perThread);
+		{
+			const size_t budget = 4 * 1024 * kKB;
+			MemoryBudget::Manager mgr(budget);
+			BudgetedCache caches[3];
+			const Priority priorities[3] = {Priority::Low, Priority::Normal, Priority::High};
+			const char *names[3] = {"low", "normal", "high"};
+			for (int i = 0; i < 3; i++)
+				caches[i].Register(mgr, names[i], priorities[i]);
+
+			std::atomic<bool> done{false};
+			std::atomic<uint64_t> inserted{0};
+			std::thread enforcer([&]()
+								 {
+				while (!done.load(std::memory_order_acquire))
+				{
+					mgr.Enforce();
+					std::this_thread::yield();
+				} });
+			std::vector<std::thread> workers;
+			auto t0 = Clock::now();
+			for (unsigned t = 0; t < threads; t++)
+			{
+				workers.emplace_back([&, t]()
+									 {
+					std::mt19937_64 rng(0x9E3779B97F4A7C15ull ^ t);
+					for (uint64_t i = 0; i < perThread; i++)
+					{
+						uint64_t r = rng();
+						caches[r % 3].Put(((uint64_t)t << 40) | i, 1 * kKB + (size_t)((r >> 8) % (64 * kKB)));
+						inserted.fetch_add(1, std::memory_order_relaxed);
+					} });
+			}
+			for (auto &w : workers)
+				w.join();
+			done.store(true, std::memory_order_release);
+			enforcer.join();
+			auto t1 = Clock::now();
+			mgr.Enforce();
+
+			MemoryBudget::Manager::Stats st = mgr.GetStats();
+			std::printf("  %llu inserts in %.1f ms, %llu enforcements, %llu trims, %.1f MB trimmed, peak %.1f MB\n",
+						(unsigned long long)inserted.load(), ElapsedNs(t0, t1) / 1e6, (unsigned long long)st.enforcements,
+						(unsigned long long)st.trims, st.trimmedBytes / (1024.0 * 1024.0), st.peakBytes / (1024.0 * 1024.0));
+			mgr.ForEachClient([](const char *name, Priority priority, size_t bytes)
+							  { std::printf("  %-8s %-6s %8.1f KB\n", name, MemoryBudget::PriorityName(priority), bytes / 1024.0); });
+			ok &= Check(mgr.TotalBytes() <= budget, "total fits the budget after enforce");
+			ok &= Check(caches[2].Bytes() >= caches[0].Bytes(), "high priority keeps at least as much as low");
+
+			// Steady state: a cold Enforce with nothing to trim must not allocate.
+			AllocCounter::Scope scope;
+			for (int i = 0; i < 1000; i++)
+				mgr.Enforce();
+			ok &= Check(scope.Allocations() == 0, "enforce does not allocate");
+		}
+		return ok ? 0 : 1;
+	}
+
+	//---------------------------------------------------------------------
+	//	invalidate: DirtyState.h coalescing
+	//---------------------------------------------------------------------
+	int RunInvalidateBenchmark(int argc, char **argv)
+	{
+		uint64_t iterations = argc > 0 ? std::strtoull(argv[0], nullptr, 10) : 0;
+		if (iterations == 0)
+			iterations = 10000000;
+		using DirtyState::Action;
+		bool ok = true;
+
+		std::printf("invalidate: coalescing\n");
+		{
+			// One keystroke in the search box: the filter rebuilds the rows
+			// and moves the selection, which also changes.
+			DirtyState::Tracker t;
+			int posts = 0;
+			posts += t.Mark(Action::Filter, DirtyState::ListAll);
+			posts += t.Mark(Action::Filter, DirtyState::Detail | DirtyState::Preview);
+			posts += t.Mark(Action::Selection, DirtyState::Detail | DirtyState::Preview);
+			DirtyState::Flush f = t.Take();
+			ok &= Check(posts == 1 && !t.Pending(), "one flush posted for filter + selection");
+			ok &= Check(f.regions == (DirtyState::ListAll | DirtyState::Detail | DirtyState::Preview), "flush carries the union of regions");
+			const DirtyState::ActionCounts &sel = t.Counts(Action::Selection);
+			ok &= Check(t.Counts(Action::Filter).requests == 2 && sel.requests == 1 && sel.flushes == 1 && sel.previewRenders == 1,
+						"counters attribute the single render to both actions");
+
+			// Background axis results for neighbouring rows collapse into
+			// one row range; far-apart rows fall back to the whole list.
+			for (int row = 10; row < 40; row += 3)
+				t.Mark(Action::AxesReady, DirtyState::ListRows, row);
+			f = t.Take();
+			ok &= Check(f.regions == DirtyState::ListRows && f.rowFirst == 10 && f.rowLast == 37, "nearby rows merge into one range");
+			t.Mark(Action::FacesReady, DirtyState::ListRows, 5);
+			t.Mark(Action::FacesReady, DirtyState::ListRows, 5 + DirtyState::Tracker::kMaxRowSpan);
+			f = t.Take();
+			ok &= Check(f.regions == DirtyState::ListAll, "a wide range becomes a full list repaint");
+			t.Mark(Action::Expand, DirtyState::ListAll);
+			t.Mark(Action::AxesReady, DirtyState::ListRows, 3);
+			f = t.Take();
+			ok &= Check(f.regions == DirtyState::ListAll && t.Flushes() == 4, "rows are absorbed by a pending full repaint");
+			ok &= Check(!t.Mark(Action::AxesReady, DirtyState::ListRows, -1) && !t.Pending(), "an empty mark schedules nothing");
+		}
+
+		std::printf("invalidate: overhead (%llu marks)\n", (unsigned long long)iterations);
+		{
+			DirtyState::Tracker t;
+			uint64_t flushes = 0;
+			PrintRow("Mark (coalesced, flush every 8)", TimePerCall(iterations, [&](uint64_t n)
+																	 {
+				for (uint64_t i = 0; i < n; i++)
+				{
+					t.Mark((Action)(i % (uint64_t)Action::Count), DirtyState::Preview | DirtyState::ListRows, (int)(i & 31));
+					if ((i & 7) == 7)
+						flushes += t.Take().regions != DirtyState::None;
+				} }));
+			for (int i = 0; i < (int)Action::Count; i++)
+			{
+				const DirtyState::ActionCounts &c = t.Counts((Action)i);
+				std::printf("  %-10s requests=%llu flushes=%llu preview=%llu\n", DirtyState::ActionName((Action)i),
+							(unsigned long long)c.requests, (unsigned long long)c.flushes, (unsigned long long)c.previewRenders);
+			}
+			ok &= Check(flushes == t.Flushes() && flushes == iterations / 8, "one flush per batch");
+		}
+		return ok ? 0 : 1;
+	}
+
+	//---------------------------------------------------------------------
+	//	visibility: Visibility.h state machine and TaskQueue gating
+	//---------------------------------------------------------------------
+	int RunVisibilityBenchmark(int, char **)
+	{
+		using Visibility::State;
+		bool ok = true;
+
+		std::printf("visibility: state machine\n");
+		{
+			Visibility::Scheduler v;
+			ok &= Check(v.Current() == State::Visible && v.RunnableLevels() == 3 && v.BeginFrame(), "starts visible, everything runs");
+			Visibility::Transition t = v.SetShown(false);
+			ok &= Check(t.changed && t.to == State::Hidden && v.RunnableLevels() == 0 && !v.BeginFrame(), "hidden: no tasks, frames skipped");
+			t = v.SetShown(true);
+			ok &= Check(t.changed && t.to == State::Visible && t.repaint, "shown again: repaint requested for the skipped frame");
+			t = v.SetOccluded(true);
+			ok &= Check(t.to == State::Occluded && v.RunnableLevels() == 1 && v.NeedsProbe(), "occluded: High only, probing");
+			t = v.SetMinimized(true);
+			ok &= Check(t.to == State::Hidden && !v.NeedsProbe(), "minimised wins over occluded");
+			t = v.SetMinimized(false);
+			ok &= Check(t.to == State::Occluded && !t.repaint, "restored while still covered stays occluded");
+			t = v.SetOccluded(true, true);
+			ok &= Check(!t.changed, "a probe that changes nothing is not a transition");
+			t = v.SetOccluded(false, true);
+			ok &= Check(t.to == State::Visible && !t.repaint, "uncovered without skipped frames: no repaint");
+			const Visibility::Stats &st = v.GetStats();
+			ok &= Check(st.transitions == 6 && st.timesHidden == 2 && st.timesOccluded == 2 && st.skippedFrames == 1 && st.probes == 2,
+						"stats count transitions, skipped frames and probes");
+		}
+
+		std::printf("visibility: task hold-back\n");
+		{
+			TaskQueue q;
+			q.Start(1);
+			std::mutex m;
+			std::vector<int> ran; // priority of each task in execution order
+			std::atomic<int> done{0};
+			auto post = [&](TaskQueue::Priority p)
+			{
+				q.Post(p, 1, [&, p]
+					   {
+					std::lock_guard<std::mutex> lock(m);
+					ran.push_back((int)p);
+					done++; });
+			};
+			auto waitFor = [&](int n)
+			{
+				for (int i = 0; i < 2000 && done.load() < n; i++)
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				return done.load() >= n;
+			};
+			Visibility::Scheduler v;
+			v.SetShown(false);
+			q.SetRunnableLevels(v.RunnableLevels());
+			for (int i = 0; i < 5; i++)
+			{
+				post(TaskQueue::Priority::Low);
+				post(TaskQueue::Priority::Normal);
+				post(TaskQueue::Priority::High);
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			ok &= Check(done.load() == 0 && q.Pending() == 15, "hidden: nothing runs, nothing is dropped");
+			v.SetShown(true);
+			v.SetOccluded(true);
+			q.SetRunnableLevels(v.RunnableLevels());
+			bool highDone = waitFor(5);
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			ok &= Check(highDone && done.load() == 5 && q.Pending() == 10, "occluded: only High tasks run");
+			v.SetOccluded(false, true);
+			q.SetRunnableLevels(v.RunnableLevels());
+			ok &= Check(waitFor(15) && q.Pending() == 0, "visible: held-back tasks resume");
+			std::lock_guard<std::mutex> lock(m);
+			ok &= Check(std::is_sorted(ran.begin(), ran.end()), "resumed work drains in priority order");
+			q.Shutdown();
+		}
+		return ok ? 0 : 1;
+	}
+
+	//---------------------------------------------------------------------
+	//	sweep: AxisSweep.h precompute and playback
+	//---------------------------------------------------------------------
+	// Stand-in for rasterizing one keyframe: a row of glyph-like boxes whose
+	// stems thicken with the weight axis, 4x supersampled horizontally. The
+	// plugin shapes and draws with DirectWrite instead; this keeps the
+	// per-frame cost in the same order so pool scaling is meaningful.
+	void RasterizeSyntheticFrame(float weight, int width, int height, std::vector<uint8_t> &out)
+	{
+		out.assign((size_t)width * height, 0);
+		const int cell = (std::max)(8, height / 2);
+		const float stem = 1.0f + weight / 100.0f;
+		for (int y = 0; y < height; y++)
+		{
+			uint8_t *row = out.data() + (size_t)y * width;
+			int cy = y % cell;
+			bool bar = cy >= cell / 2 - (int)stem / 2 && cy <= cell / 2 + (int)stem / 2;
+			for (int x = 0; x < width; x++)
+			{
+				int hits = 0;
+				for (int sub = 0; sub < 4; sub++)
+				{
+					float fx = (float)(x % cell) + sub * 0.25f;
+					bool left = fx >= cell * 0.2f && fx < cell * 0.2f + stem;
+					bool right = fx >= cell * 0.8f - stem && fx < cell * 0.8f;
+					hits += (left || right || (bar && fx >= cell * 0.2f && fx < cell * 0.8f)) ? 1 : 0;
+				}
+				row[x] = (uint8_t)(hits * 255 / 4);
+			}
+		}
+	}
+
+	int RunSweepBenchmark(int argc, char **argv)
+	{
+		unsigned threads = argc > 0 ? (unsigned)std::strtoul(argv[0], nullptr, 10) : 0;
+		int frames = argc > 1 ? std::atoi(argv[1]) : 0;
+		int width = argc > 2 ? std::atoi(argv[2]) : 0;
+		int height = argc > 3 ? std::atoi(argv[3]) : 0;
+		if (threads == 0)
+			threads = (std::max)(1u, (std::min)(8u, std::thread::hardware_concurrency()));
+		if (frames <= 0)
+			frames = 60;
+		if (width <= 0)
+			width = 640;
+		if (height <= 0)
+			height = 240;
+		bool ok = true;
+
+		std::printf("sweep: keyframes and pacing\n");
+		{
+			ok &= Check(AxisSweep::Phase(0, 60) == 0.0f && AxisSweep::Phase(30, 60) == 1.0f, "loop starts at the minimum and turns at the maximum");
+			bool symmetric = true;
+			for (int k = 1; k < 60; k++)
+				symmetric &= AxisSweep::Phase(k, 60) == AxisSweep::Phase(60 - k, 60);
+			ok &= Check(symmetric, "the way back mirrors the way out");
+			ok &= Check(AxisSweep::KeyframeValue(100.0f, 900.0f, 15, 60) == 500.0f, "keyframes interpolate the axis range");
+			ok &= Check(AxisSweep::FrameCountFor(1000, 100000, 60) == 60 && AxisSweep::FrameCountFor(1000, 10000, 60) == 10 &&
+							AxisSweep::FrameCountFor(1000, 1500, 60) == 0,
+						"frame count follows the byte budget");
+
+			AxisSweep::Pacer p;
+			p.Start(50.0, 10, 0.0); // 20 ms slots
+			int shown = 0;
+			for (int i = 0; i < 40; i++)
+				shown += p.Tick(i * 10.0) >= 0; // ticks at twice the rate
+			AxisSweep::Pacer::Stats st = p.GetStats();
+			ok &= Check(shown == 20 && st.dropped == 0 && st.maxJitterMs == 0.0 && st.meanIntervalMs == 20.0, "on-time ticks present every slot once");
+			ok &= Check(p.Tick(445.0) == 2 && p.GetStats().dropped == 2 && p.GetStats().maxJitterMs == 5.0, "a late tick skips ahead and records jitter");
+			p.Pause();
+			ok &= Check(p.Tick(2000.0) == 0 && p.GetStats().dropped == 2 && p.GetStats().pauses == 1, "a pause is neither jitter nor drops");
+
+			AxisSweep::FrameRing<int> ring;
+			uint32_t gen = ring.Reset(4);
+			ok &= Check(!ring.Store(gen + 1, 0, 1, 1) && ring.ReadyCount() == 0, "stale generations are ignored");
+			bool done = false;
+			for (int i : {3, 1, 1, 0, 2})
+				done = ring.Store(gen, i, i * 10, 8) || done;
+			ok &= Check(done && ring.Complete() && ring.Bytes() == 32 && ring.Frame(3) == 30, "out-of-order stores complete the ring once");
+		}
+
+		size_t frameBytes = (size_t)width * height;
+		std::printf("sweep: precompute %d frames of %dx%d (%.1f MB)\n", frames, width, height, frames * frameBytes / (1024.0 * 1024.0));
+		double singleMs = 0.0;
+		for (unsigned t = 1; t <= threads; t = t < threads && t * 2 > threads ? threads : t * 2)
+		{
+			AxisSweep::FrameRing<std::vector<uint8_t>> ring;
+			uint32_t gen = ring.Reset(frames);
+			TaskQueue q;
+			q.Start(t);
+			std::atomic<int> stored{0};
+			auto t0 = Clock::now();
+			for (int k = 0; k < frames; k++)
+			{
+				q.Post(TaskQueue::Priority::Normal, 1, [&, k]
+					   {
+					std::vector<uint8_t> pixels;
+					RasterizeSyntheticFrame(AxisSweep::KeyframeValue(100.0f, 900.0f, k, frames), width, height, pixels);
+					ring.Store(gen, k, std::move(pixels), frameBytes);
+					stored++; });
+			}
+			while (stored.load() < frames)
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+			double ms = ElapsedNs(t0, Clock::now()) / 1e6;
+			q.Shutdown();
+			if (t == 1)
+				singleMs = ms;
+			std::printf("  threads=%-2u %8.2f ms  %8.1f frames/s  %8.1f MB/s  speedup=%.2fx\n", t, ms, frames * 1000.0 / ms,
+						frames * frameBytes / (1024.0 * 1024.0) / (ms / 1000.0), singleMs / ms);
+			ok &= Check(ring.Complete() && ring.Bytes() == frames * frameBytes, "every keyframe stored");
+			bool mirrored = true;
+			for (int k = 1; k < frames; k++)
+				mirrored &= ring.Frame(k) == ring.Frame(frames - k);
+			ok &= Check(mirrored, "keyframes k and frames-k are identical");
+		}
+
+		std::printf("sweep: playback at 30 fps for 1 s (ticks at twice the rate)\n");
+		{
+			AxisSweep::Pacer p;
+			auto t0 = Clock::now();
+			auto nowMs = [&]
+			{ return ElapsedNs(t0, Clock::now()) / 1e6; };
+			p.Start(30.0, frames, nowMs());
+			auto period = std::chrono::microseconds((int64_t)(p.PeriodMs() * 500.0));
+			auto next = Clock::now();
+			while (nowMs() < 1000.0)
+			{
+				next += period;
+				std::this_thread::sleep_until(next);
+				p.Tick(nowMs());
+			}
+			AxisSweep::Pacer::Stats st = p.GetStats();
+			std::printf("  presented=%llu dropped=%llu interval=%.2f ms jitter p50=%.2f p95=%.2f max=%.2f ms\n", (unsigned long long)st.presented,
+						(unsigned long long)st.dropped, st.meanIntervalMs, st.p50JitterMs, st.p95JitterMs, st.maxJitterMs);
+			ok &= Check(st.presented + st.dropped >= 29 && st.presented + st.dropped <= 32, "the clock, not the tick count, drives the frame");
+		}
+		return ok ? 0 : 1;
+	}
+
+	//---------------------------------------------------------------------
+	//	specimen: Specimen.h geometry and TaskQueue::ParallelFor
+	//---------------------------------------------------------------------
+	int RunSpecimenBenchmark(int argc, char **argv)
+	{
+		unsigned threads = argc > 0 ? (unsigned)std::strtoul(argv[0], nullptr, 10) : 0;
+		if (threads == 0)
+			threads = 4;
+		using Specimen::Mode;
+		bool ok = true;
+
+		std::printf("specimen: geometry\n");
+		{
+			Specimen::Plan p = Specimen::MakePlan(Mode::Waterfall, 12, 600.0f);
+			int n = (int)(sizeof(Specimen::kWaterfallSizes) / sizeof(float));
+			ok &= Check(p.count == n && p.sizes[0] == 8.0f && p.sizes[n - 1] == 144.0f, "waterfall runs from 8 to 144 pt");
+			bool increasing = true;
+			for (int i = 1; i < p.count; i++)
+				increasing &= p.tops[i] > p.tops[i - 1];
+			ok &= Check(increasing && Specimen::ContentHeight(p) > 1000.0f, "lines stack downwards");
+			int first = 0, last = 0;
+			Specimen::VisibleRange(p, 0.0f, 200.0f, first, last);
+			ok &= Check(first == 0 && last > 0 && last < p.count && p.tops[last - 1] < 200.0f && p.tops[last] >= 200.0f, "top of the view shows the small sizes");
+			float bottom = Specimen::ClampScroll(p, 1e9f, 200.0f);
+			Specimen::VisibleRange(p, bottom, 200.0f, first, last);
+			ok &= Check(bottom == Specimen::ContentHeight(p) - 200.0f && last == p.count && first > 0, "scrolling clamps at the last line");
+			ok &= Check(Specimen::ClampScroll(p, -50.0f, 200.0f) == 0.0f, "and at the top");
+			float before = p.tops[5];
+			ok &= Check(Specimen::SetMeasured(p, 2, p.heights[2] + 10.0f) && p.tops[5] == before + 10.0f, "a measured height moves the lines below");
+
+			Specimen::Plan para = Specimen::MakePlan(Mode::Paragraph, 200, 300.0f);
+			ok &= Check(para.count > 0 && para.heights[para.count - 1] > Specimen::EstimateHeight(Mode::Waterfall, para.sizes[para.count - 1], 200, 300.0f),
+						"paragraph blocks wrap to several lines");
+			std::wstring text;
+			Specimen::MakeParagraphText(L"あいうABC", text);
+			ok &= Check(text.size() >= Specimen::kParagraphMinChars && text.compare(0, 7, L"あいうABC ") == 0, "paragraph text repeats the sample");
+			ok &= Check(Specimen::MakePlan(Mode::Single, 10, 100.0f).count == 0, "single-line mode has no specimen lines");
+		}
+
+		std::printf("specimen: text change relays out visible lines only\n");
+		{
+			// Stand-in layout cache keyed by (text, line), as in the plugin.
+			std::unordered_set<uint64_t> cache;
+			int built = 0;
+			auto frame = [&](uint64_t textHash, float scroll)
+			{
+				Specimen::Plan p = Specimen::MakePlan(Mode::Waterfall, 12, 600.0f);
+				int first = 0, last = 0;
+				Specimen::VisibleRange(p, Specimen::ClampScroll(p, scroll, 300.0f), 300.0f, first, last);
+				for (int i = first; i < last; i++)
+					built += cache.insert(textHash * 131 + (uint64_t)i).second ? 1 : 0;
+				return last - first;
+			};
+			int visible = frame(1, 0.0f);
+			int firstBuild = built;
+			frame(1, 0.0f);
+			ok &= Check(firstBuild == visible && built == firstBuild, "a repaint reuses every visible line");
+			built = 0;
+			visible = frame(2, 0.0f);
+			ok &= Check(built == visible && visible < (int)(sizeof(Specimen::kWaterfallSizes) / sizeof(float)), "new text lays out the visible lines, not all sizes");
+			built = 0;
+			frame(2, 1e9f);
+			ok &= Check(built > 0, "scrolling lays out lines as they come into view");
+		}
+
+		std::printf("specimen: ParallelFor (%u workers)\n", threads);
+		{
+			TaskQueue q;
+			q.Start(threads);
+			std::vector<std::atomic<int>> hits(64);
+			q.ParallelFor(hits.size(), threads, TaskQueue::Priority::High, 7, [&](size_t i)
+						  { hits[i]++; });
+			bool once = true;
+			for (auto &h : hits)
+				once &= h.load() == 1;
+			ok &= Check(once, "every index runs exactly once");
+
+			q.SetRunnableLevels(0);
+			int ran = 0;
+			std::thread::id caller = std::this_thread::get_id();
+			bool onCaller = true;
+			q.ParallelFor(10, threads, TaskQueue::Priority::High, 7, [&](size_t)
+						  { ran++; onCaller &= std::this_thread::get_id() == caller; });
+			ok &= Check(ran == 10 && onCaller, "held-back workers: the caller does all the work");
+			q.SetRunnableLevels(3);
+
+			// Layout stand-in: ~0.5 ms of work per line, 20 lines.
+			auto work = [](size_t i)
+			{
+				volatile double x = 0.0;
+				for (int k = 0; k < 200000; k++)
+					x = x + std::sqrt((double)(k + i));
+			};
+			auto t0 = Clock::now();
+			for (size_t i = 0; i < 20; i++)
+				work(i);
+			double serialMs = ElapsedNs(t0, Clock::now()) / 1e6;
+			t0 = Clock::now();
+			q.ParallelFor(20, threads, TaskQueue::Priority::High, 7, work);
+			double parallelMs = ElapsedNs(t0, Clock::now()) / 1e6;
+			std::printf("  20 lines: serial %.2f ms, parallel %.2f ms (%.2fx)\n", serialMs, parallelMs, serialMs / parallelMs);
+			q.Shutdown();
+		}
+		return ok ? 0 : 1;
+	}
+
+	//---------------------------------------------------------------------
+	//	compare: Compare.h pins and shared line breaking
+	//---------------------------------------------------------------------
+	// Break flags the way the plugin derives them from the analyser's
+	// breakpoints, for a stand-in classifier: spaces and CJK allow breaks.
+	void BenchBreakFlags(const std::wstring &text, std::vector<uint8_t> &out)
+	{
+		out.assign(text.size(), 0);
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			bool space = text[i] == L' ';
+			bool cjk = text[i] >= 0x3000;
+			bool nextCjk = i + 1 < text.size() && text[i + 1] >= 0x3000;
+			out[i] = (uint8_t)((space ? Compare::kWhitespace : 0) | (space || cjk || nextCjk ? Compare::kCanBreakAfter : 0) |
+							   (text[i] == L'\n' ? Compare::kMustBreakAfter : 0));
+		}
+	}
+
+	int RunCompareBenchmark(int argc, char **argv)
+	{
+		int iterations = argc > 0 ? std::atoi(argv[0]) : 2000;
+		if (iterations <= 0)
+			iterations = 2000;
+		bool ok = true;
+
+		std::printf("compare: pins\n");
+		{
+			Compare::PinSet pins;
+			ok &= Check(pins.Toggle(L"sys:Meiryo", -1) == Compare::ToggleResult::Added && pins.Toggle(L"sys:Meiryo", 2) == Compare::ToggleResult::Added,
+						"a family and one of its faces pin separately");
+			ok &= Check(pins.Toggle(L"sys:Meiryo", -1) == Compare::ToggleResult::Removed && pins.Size() == 1, "toggling again unpins");
+			for (int i = 0; i < Compare::kMaxPinned; i++)
+				pins.Toggle(L"file:C:\\f" + std::to_wstring(i) + L".ttf#0", -1);
+			ok &= Check(pins.Size() == (size_t)Compare::kMaxPinned && pins.Toggle(L"sys:Yu Gothic", -1) == Compare::ToggleResult::Full,
+						"the set is capped");
+
+			std::stringstream file;
+			pins.Save(file);
+			Compare::PinSet loaded;
+			ok &= Check(!pins.IsDirty() && loaded.Load(file) && loaded.Size() == pins.Size(), "pins round-trip through the pin file");
+			bool same = true;
+			for (size_t i = 0; i < pins.Size(); i++)
+				same &= loaded.Pins()[i].identity == pins.Pins()[i].identity && loaded.Pins()[i].faceIndex == pins.Pins()[i].faceIndex;
+			ok &= Check(same && loaded.Pins()[0].faceIndex == 2, "in order, with face rows");
+			std::stringstream foreign("FPHC\x01\x00\x00\x00");
+			ok &= Check(!loaded.Load(foreign) && loaded.Size() == pins.Size(), "a foreign file is ignored");
+
+			// Pins survive re-enumeration in another order and missing fonts.
+			std::vector<BenchFont> catalog(4);
+			catalog[0].displayName = L"Yu Gothic";
+			catalog[1].displayName = L"Meiryo";
+			catalog[2].isSystemFont = false;
+			catalog[2].filePath = L"C:\\f3.ttf";
+			catalog[3].isSystemFont = false;
+			catalog[3].filePath = L"C:\\f0.ttf";
+			std::vector<int> indices;
+			Compare::ResolvePins(catalog, pins.Pins(), indices);
+			ok &= Check(indices.size() == pins.Size() && indices[0] == 1 && indices[1] == 3 && indices[4] == 2 && indices[2] == -1,
+						"pins resolve by identity, missing fonts stay pinned");
+		}
+
+		std::printf("compare: BreakLines\n");
+		{
+			Compare::LineSpan lines[Compare::kMaxRowLines];
+			std::wstring latin = L"aaa bbb ccc";
+			std::vector<uint8_t> flags;
+			BenchBreakFlags(latin, flags);
+			std::vector<float> widths(latin.size(), 10.0f);
+			int n = Compare::BreakLines(widths.data(), flags.data(), (uint32_t)latin.size(), 75.0f, lines, Compare::kMaxRowLines);
+			ok &= Check(n == 2 && lines[0].end == 8 && lines[0].width == 70.0f && lines[1].start == 8 && lines[1].end == 11,
+						"words wrap at spaces, trailing space hangs");
+			n = Compare::BreakLines(widths.data(), flags.data(), (uint32_t)latin.size(), 1000.0f, lines, Compare::kMaxRowLines);
+			ok &= Check(n == 1 && lines[0].end == 11 && lines[0].width == 110.0f, "a wide row is one line");
+			n = Compare::BreakLines(widths.data(), flags.data(), (uint32_t)latin.size(), 25.0f, lines, Compare::kMaxRowLines);
+			ok &= Check(n == 4 && lines[0].end == 2 && lines[1].end == 4, "a word wider than the row breaks inside it");
+			ok &= Check(lines[3].end < (uint32_t)latin.size(), "text past the last line is dropped");
+
+			std::wstring cjk = L"あいうえおかきくけこ";
+			BenchBreakFlags(cjk, flags);
+			widths.assign(cjk.size(), 20.0f);
+			n = Compare::BreakLines(widths.data(), flags.data(), (uint32_t)cjk.size(), 100.0f, lines, Compare::kMaxRowLines);
+			ok &= Check(n == 2 && lines[0].end == 5 && lines[1].end == 10, "CJK breaks between any two characters");
+			// A cluster: the width sits on its first position and its
+			// inner positions carry no break flags.
+			widths[3] = 40.0f;
+			widths[4] = 0.0f;
+			flags[3] = 0;
+			n = Compare::BreakLines(widths.data(), flags.data(), (uint32_t)cjk.size(), 100.0f, lines, Compare::kMaxRowLines);
+			ok &= Check(n == 2 && lines[0].end == 5 && lines[0].width == 100.0f, "clusters stay whole");
+
+			std::wstring forced = L"ab\ncd";
+			BenchBreakFlags(forced, flags);
+			widths.assign(forced.size(), 10.0f);
+			n = Compare::BreakLines(widths.data(), flags.data(), (uint32_t)forced.size(), 1000.0f, lines, Compare::kMaxRowLines);
+			ok &= Check(n == 2 && lines[0].end == 3 && lines[1].start == 3, "mandatory breaks end the line");
+		}
+
+		std::printf("compare: shared analysis vs per-font analysis (%d texts x %d fonts)\n", iterations, Compare::kMaxPinned);
+		{
+			std::wstring text;
+			while (text.size() < 400)
+				text += L"The quick brown fox 素早い茶色の狐が のろまな犬を飛び越える ";
+			std::vector<std::vector<float>> fontWidths(Compare::kMaxPinned, std::vector<float>(text.size()));
+			std::mt19937 rng(7);
+			for (auto &w : fontWidths)
+				for (size_t i = 0; i < text.size(); i++)
+					w[i] = (text[i] >= 0x3000 ? 24.0f : 11.0f) + (float)(rng() % 5);
+			std::vector<uint8_t> flags;
+			Compare::LineSpan lines[Compare::kMaxRowLines];
+			size_t sink = 0;
+			auto t0 = Clock::now();
+			for (int it = 0; it < iterations; it++)
+			{
+				BenchBreakFlags(text, flags);
+				for (const auto &w : fontWidths)
+					sink += (size_t)Compare::BreakLines(w.data(), flags.data(), (uint32_t)text.size(), 600.0f, lines, Compare::kMaxRowLines);
+			}
+			double sharedNs = ElapsedNs(t0, Clock::now()) / iterations;
+			t0 = Clock::now();
+			for (int it = 0; it < iterations; it++)
+			{
+				for (const auto &w : fontWidths)
+				{
+					BenchBreakFlags(text, flags);
+					sink += (size_t)Compare::BreakLines(w.data(), flags.data(), (uint32_t)text.size(), 600.0f, lines, Compare::kMaxRowLines);
+				}
+			}
+			double perFontNs = ElapsedNs(t0, Clock::now()) / iterations;
+			std::printf("  per text change: shared %.1f us, per font %.1f us (sink=%zu)\n", sharedNs / 1000.0, perFontNs / 1000.0, sink);
+			ok &= Check(sink > 0, "every font broke into lines");
+		}
+		return ok ? 0 : 1;
+	}
+
+	//---------------------------------------------------------------------
+	//	glyphs: GlyphGrid.h cmap index, blocks and atlas under scrolling
+	//---------------------------------------------------------------------
+	void PutU16(std::vector<uint8_t> &b, uint32_t v)
+	{
+		b.push_back((uint8_t)(v >> 8));
+		b.push_back((uint8_t)v);
+	}
+
+	void PutU32(std::vector<uint8_t> &b, uint32_t v)
+	{
+		PutU16(b, v >> 16);
+		PutU16(b, v & 0xFFFF);
+	}
+
+	// A format 4 segment: glyph = c + delta, or glyphs[c - start] when
+	// `glyphs` is not empty (idRangeOffset form).
+	struct BenchSegment
+	{
+		uint16_t start;
+		uint16_t end;
+		uint16_t delta;
+		std::vector<uint16_t> glyphs;
+	};
+
+	std::vector<uint8_t> BuildFormat4(std::vector<BenchSegment> segs)
+	{
+		segs.push_back(BenchSegment{0xFFFF, 0xFFFF, 1, {}});
+		uint32_t n = (uint32_t)segs.size();
+		std::vector<uint8_t> b;
+		PutU16(b, 4);
+		PutU16(b, 0); // length, patched below
+		PutU16(b, 0);
+		PutU16(b, n * 2);
+		PutU16(b, 0);
+		PutU16(b, 0);
+		PutU16(b, 0);
+		for (const auto &s : segs)
+			PutU16(b, s.end);
+		PutU16(b, 0);
+		for (const auto &s : segs)
+			PutU16(b, s.start);
+		for (const auto &s : segs)
+			PutU16(b, s.delta);
+		uint32_t arrayAt = 0;
+		for (uint32_t i = 0; i < n; i++)
+		{
+			PutU16(b, segs[i].glyphs.empty() ? 0 : 2 * (n - i) + 2 * arrayAt);
+			arrayAt += (uint32_t)segs[i].glyphs.size();
+		}
+		for (const auto &s : segs)
+			for (uint16_t g : s.glyphs)
+				PutU16(b, g);
+		b[2] = (uint8_t)(b.size() >> 8);
+		b[3] = (uint8_t)b.size();
+		return b;
+	}
+
+	// {first, last, startGlyph} groups.
+	std::vector<uint8_t> BuildFormat12(const std::vector<std::array<uint32_t, 3>> &groups)
+	{
+		std::vector<uint8_t> b;
+		PutU16(b, 12);
+		PutU16(b, 0);
+		PutU32(b, 16 + 12 * (uint32_t)groups.size());
+		PutU32(b, 0);
+		PutU32(b, (uint32_t)groups.size());
+		for (const auto &g : groups)
+		{
+			PutU32(b, g[0]);
+			PutU32(b, g[1]);
+			PutU32(b, g[2]);
+		}
+		return b;
+	}
+
+	// A cmap table holding the subtables under (platform, encoding).
+	std::vector<uint8_t> BuildCmap(const std::vector<std::pair<std::pair<uint16_t, uint16_t>, std::vector<uint8_t>>> &subtables)
+	{
+		std::vector<uint8_t> b;
+		PutU16(b, 0);
+		PutU16(b, (uint32_t)subtables.size());
+		uint32_t offset = 4 + 8 * (uint32_t)subtables.size();
+		for (const auto &s : subtables)
+		{
+			PutU16(b, s.first.first);
+			PutU16(b, s.first.second);
+			PutU32(b, offset);
+			offset += (uint32_t)s.second.size();
+		}
+		for (const auto &s : subtables)
+			b.insert(b.end(), s.second.begin(), s.second.end());
+		return b;
+	}
+
+	bool ParseIndex(const std::vector<uint8_t> &cmap, GlyphGrid::CodepointIndex &index)
+	{
+		std::vector<std::pair<uint32_t, uint32_t>> pairs;
+		if (!GlyphGrid::ReadCmap(cmap.data(), cmap.size(), pairs))
+			return false;
+		index.Assign(std::move(pairs));
+		return true;
+	}
+
+	// Frames of a scroll through `layout`: cells rasterized on demand per
+	// frame, with or without prefetching the next page between frames.
+	struct ScrollRun
+	{
+		uint64_t frames = 0;
+		uint64_t onDemand = 0;
+		uint64_t prefetched = 0;
+		uint32_t worstFrame = 0;
+		bool visibleKept = true; // every visible cell got a slot
+		size_t maxUsed = 0;
+	};
+
+	ScrollRun SimulateScroll(const GlyphGrid::CodepointIndex &index, const GlyphGrid::Layout &layout, float viewHeight, int capacity,
+							 const std::vector<float> &scrolls, bool prefetch)
+	{
+		ScrollRun run;
+		GlyphGrid::AtlasSlots slots;
+		slots.Reset(capacity);
+		uint64_t stamp = 0;
+		float last = 0.0f;
+		for (float target : scrolls)
+		{
+			float scroll = GlyphGrid::ClampScroll(layout, target, viewHeight);
+			bool down = scroll >= last;
+			last = scroll;
+			uint32_t first = 0, end = 0;
+			GlyphGrid::VisibleCells(layout, scroll, viewHeight, first, end);
+			stamp++;
+			uint32_t missing = 0;
+			for (uint32_t i = first; i < end; i++)
+			{
+				uint32_t cp = index.CodepointAt(i);
+				if (slots.Find(cp, stamp) >= 0)
+					continue;
+				missing++;
+				run.visibleKept &= slots.Allocate(cp, stamp, stamp) >= 0;
+			}
+			run.frames++;
+			run.onDemand += missing;
+			run.worstFrame = (std::max)(run.worstFrame, missing);
+			if (prefetch)
+			{
+				uint32_t pf = 0, pl = 0;
+				GlyphGrid::AdjacentPage(layout, first, end, down, pf, pl);
+				for (uint32_t i = pf; i < pl; i++)
+				{
+					uint32_t cp = index.CodepointAt(i);
+					if (!slots.Contains(cp) && slots.Allocate(cp, stamp - 1, stamp) >= 0)
+						run.prefetched++;
+				}
+			}
+			run.maxUsed = (std::max)(run.maxUsed, slots.Used());
+		}
+		return run;
+	}
+
+	int RunGlyphsBenchmark(int argc, char **argv)
+	{
+		int iterations = argc > 0 ? std::atoi(argv[0]) : 200;
+		if (iterations <= 0)
+			iterations = 200;
+		bool ok = true;
+
+		std::printf("glyphs: cmap\n");
+		{
+			// ASCII by delta, six kana through the glyph array with a hole.
+			std::vector<uint8_t> f4 = BuildFormat4({BenchSegment{0x20, 0x7E, (uint16_t)(0x10000 - 29), {}},
+													BenchSegment{0x3041, 0x3046, 0, {200, 201, 0, 203, 204, 205}}});
+			GlyphGrid::CodepointIndex index;
+			ok &= Check(ParseIndex(BuildCmap({{{3, 1}, f4}}), index), "format 4 parses");
+			ok &= Check(index.Count() == 95 + 5 && index.Ranges().size() == 3, "glyph-0 codepoints are left out");
+			ok &= Check(index.CodepointAt(0) == 0x20 && index.CodepointAt(94) == 0x7E && index.CodepointAt(95) == 0x3041 &&
+							index.CodepointAt(97) == 0x3044,
+						"indices run through the ranges");
+			ok &= Check(index.LowerBound(0x3043) == 97 && index.Contains(0x3044) && !index.Contains(0x3043) && index.LowerBound(0x10000) == index.Count(),
+						"LowerBound lands on the next mapped codepoint");
+
+			// Format 12 wins over format 4; a group starting at glyph 0
+			// loses only its first codepoint.
+			std::vector<uint8_t> f12 = BuildFormat12({{0x20, 0x7E, 3}, {0x3000, 0x3002, 0}, {0x4E00, 0x9FFF, 100}, {0x20000, 0x2A6DF, 30000}});
+			ok &= Check(ParseIndex(BuildCmap({{{3, 1}, f4}, {{3, 10}, f12}}), index), "format 12 parses");
+			ok &= Check(index.Count() == 95 + 2 + 0x5200 + 0xA6E0 && index.Contains(0x20000) && !index.Contains(0x3000) && index.Contains(0x3001),
+						"the full-Unicode subtable is preferred");
+			std::vector<GlyphGrid::BlockEntry> blocks;
+			GlyphGrid::ListBlocks(index, blocks);
+			ok &= Check(blocks.size() == 4 && blocks[0].count == 95 && blocks[1].count == 2 && blocks[2].count == 0x5200 && blocks[3].count == 0xA6E0,
+						"blocks are listed with their glyph counts");
+			ok &= Check(GlyphGrid::FindBlockEntry(blocks, 96) == 1 && GlyphGrid::FindBlockEntry(blocks, 97) == 2 &&
+							GlyphGrid::FindBlockEntry(blocks, index.Count() - 1) == 3,
+						"glyph indices map back to their block");
+
+			std::vector<uint8_t> symbol = BuildCmap({{{3, 0}, BuildFormat4({BenchSegment{0xF020, 0xF0FF, 0, {}}})}});
+			ok &= Check(ParseIndex(symbol, index) && index.Count() == 0xE0 && index.CodepointAt(0) == 0xF020, "symbol fonts use their (3,0) subtable");
+			std::vector<uint8_t> mac = BuildCmap({{{1, 0}, BuildFormat4({BenchSegment{0x20, 0x7E, 1, {}}})}});
+			ok &= Check(!ParseIndex(mac, index), "tables without a Unicode subtable are rejected");
+
+			// Truncation at every length stays inside the buffer.
+			std::vector<uint8_t> full = BuildCmap({{{3, 1}, f4}, {{3, 10}, f12}});
+			size_t parsed = 0;
+			for (size_t len = 0; len < full.size(); len++)
+			{
+				std::vector<uint8_t> cut(full.begin(), full.begin() + len);
+				std::vector<std::pair<uint32_t, uint32_t>> pairs;
+				parsed += GlyphGrid::ReadCmap(cut.data(), cut.size(), pairs) ? 1 : 0;
+			}
+			std::printf("  truncated tables: %zu of %zu lengths still parse\n", parsed, full.size());
+		}
+
+		std::printf("glyphs: go-to input\n");
+		{
+			auto parse = [](const wchar_t *s, uint32_t expect)
+			{
+				uint32_t cp = 0;
+				bool got = GlyphGrid::ParseCodepoint(s, std::wcslen(s), cp);
+				return expect == 0 ? !got : got && cp == expect;
+			};
+			ok &= Check(parse(L"U+4E00", 0x4E00) && parse(L"u+20000", 0x20000) && parse(L"0x3042", 0x3042) && parse(L" 4e00 ", 0x4E00),
+						"hex with or without a prefix");
+			ok &= Check(parse(L"あ", 0x3042) && parse(L"A", 0x41) && parse(L"\xD840\xDC00", 0x20000), "a single character is itself");
+			ok &= Check(parse(L"", 0) && parse(L"U+", 0) && parse(L"xyz", 0) && parse(L"U+110000", 0) && parse(L"\xD840", 0), "junk is rejected");
+		}
+
+		std::printf("glyphs: atlas slots\n");
+		{
+			GlyphGrid::AtlasSlots slots;
+			slots.Reset(4);
+			for (uint32_t cp = 'a'; cp <= 'd'; cp++)
+				slots.Allocate(cp, 1, 1);
+			ok &= Check(slots.Find('a', 2) >= 0 && slots.Find('b', 2) >= 0, "filled slots are found");
+			int e = slots.Allocate('e', 2, 2);
+			int f = slots.Allocate('f', 2, 2);
+			ok &= Check(e >= 0 && f >= 0 && slots.Contains('a') && slots.Contains('b') && !slots.Contains('c') && !slots.Contains('d'),
+						"only cells outside the current frame are evicted");
+			ok &= Check(slots.Allocate('g', 2, 2) == -1 && slots.GetStats().full == 1, "a fully protected atlas refuses instead of evicting");
+			ok &= Check(slots.Allocate('g', 3, 3) >= 0 && slots.Used() == 4, "older frames free their cells");
+		}
+
+		std::printf("glyphs: large CJK cmap (%d iterations)\n", iterations);
+		{
+			// A Pan-CJK-sized format 12: the big blocks plus thousands of
+			// small scattered groups.
+			std::vector<std::array<uint32_t, 3>> groups = {{0x20, 0x7E, 1}, {0x3000, 0x30FF, 200}, {0x3400, 0x4DBF, 500}, {0x4E00, 0x9FFF, 7000}, {0xAC00, 0xD7A3, 28000}};
+			uint32_t glyph = 40000;
+			for (uint32_t cp = 0x20000; cp + 2 <= 0x2A6DF; cp += 4)
+			{
+				groups.push_back({cp, cp + 2, glyph});
+				glyph += 3;
+			}
+			std::vector<uint8_t> cmap = BuildCmap({{{3, 10}, BuildFormat12(groups)}});
+			GlyphGrid::CodepointIndex index;
+			auto t0 = Clock::now();
+			std::vector<GlyphGrid::BlockEntry> blocks;
+			for (int it = 0; it < iterations; it++)
+			{
+				ParseIndex(cmap, index);
+				GlyphGrid::ListBlocks(index, blocks);
+			}
+			double parseUs = ElapsedNs(t0, Clock::now()) / iterations / 1000.0;
+			std::printf("  %u codepoints, %zu ranges, %zu blocks: parse+index %.1f us, index %zu KB (flat list would be %zu KB)\n", index.Count(),
+						index.Ranges().size(), blocks.size(), parseUs, index.Bytes() / 1024, (size_t)index.Count() * sizeof(uint32_t) / 1024);
+			ok &= Check(index.Count() > 65000 && index.Bytes() < (size_t)index.Count() * sizeof(uint32_t), "the index is smaller than the glyph list");
+
+			uint64_t sink = 0;
+			std::mt19937 rng(42);
+			t0 = Clock::now();
+			const int lookups = 1000000;
+			for (int i = 0; i < lookups; i++)
+				sink += index.CodepointAt((uint32_t)(rng() % index.Count()));
+			std::printf("  CodepointAt: %.1f ns (sink=%llu)\n", ElapsedNs(t0, Clock::now()) / lookups, (unsigned long long)sink);
+
+			// An 800x400 preview of 64-DIP cells, scrolled down and back up
+			// wheel notch by wheel notch, then jumping between blocks.
+			float viewHeight = 400.0f - 20.0f - 22.0f;
+			GlyphGrid::Layout layout = GlyphGrid::MakeLayout(index.Count(), 780.0f, 64.0f);
+			uint32_t first = 0, end = 0;
+			GlyphGrid::VisibleCells(layout, 30.0f, viewHeight, first, end);
+			int columns = 2048 / 64;
+			int capacity = ((int)std::ceil((end - first) * 2.5f) + columns - 1) / columns * columns;
+			std::vector<float> scrolls;
+			for (int i = 0; i < 3000; i++)
+				scrolls.push_back(i * 60.0f);
+			for (int i = 3000; i >= 0; i--)
+				scrolls.push_back(i * 60.0f);
+			for (const auto &b : blocks)
+				scrolls.push_back(GlyphGrid::ScrollForIndex(layout, b.firstIndex));
+			ScrollRun cold = SimulateScroll(index, layout, viewHeight, capacity, scrolls, false);
+			ScrollRun warm = SimulateScroll(index, layout, viewHeight, capacity, scrolls, true);
+			std::printf("  %d visible cells, atlas %d slots (%zu KB)\n", (int)(end - first), capacity, (size_t)capacity * 64 * 64 * 4 / 1024);
+			std::printf("  no prefetch: %.2f cells rasterized per frame on demand, worst %u\n", (double)cold.onDemand / cold.frames, cold.worstFrame);
+			std::printf("  prefetch:    %.2f cells rasterized per frame on demand, worst %u, %.2f prefetched per frame\n",
+						(double)warm.onDemand / warm.frames, warm.worstFrame, (double)warm.prefetched / warm.frames);
+			ok &= Check(cold.visibleKept && warm.visibleKept, "every visible cell always gets a slot");
+			ok &= Check(warm.maxUsed <= (size_t)capacity && cold.maxUsed <= (size_t)capacity, "the atlas never grows");
+			ok &= Check(warm.onDemand * 4 < cold.onDemand, "prefetch takes most rasterizing off the frame");
+		}
+		return ok ? 0 : 1;
+	}
+
+	//---------------------------------------------------------------------
+	//	autofit: size search over cached metrics (AutoFit.h)
+	//---------------------------------------------------------------------
+	// A paragraph measured at 100 DIPs, the way MeasureAutoFit reports it:
+	// Latin words with trailing spaces, runs of CJK that break anywhere,
+	// and a hard break every so often.
+	AutoFit::Metrics MakeParagraphMetrics(size_t clusters, uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		std::vector<float> widths;
+		std::vector<uint8_t> flags;
+		widths.reserve(clusters);
+		flags.reserve(clusters);
+		while (widths.size() < clusters)
+		{
+			if (rng() % 3 == 0)
+			{
+				for (int n = 2 + (int)(rng() % 12); n > 0 && widths.size() < clusters; n--)
+				{
+					widths.push_back(100.0f);
+					flags.push_back(AutoFit::kCanBreakAfter);
+				}
+				continue;
+			}
+			for (int n = 2 + (int)(rng() % 9); n > 0; n--)
+			{
+				widths.push_back(45.0f + (float)(rng() % 20));
+				flags.push_back(0);
+			}
+			widths.push_back(26.0f);
+			flags.push_back(AutoFit::kCanBreakAfter | AutoFit::kWhitespace | (rng() % 40 == 0 ? AutoFit::kMustBreakAfter : 0));
+		}
+		widths.resize(clusters);
+		flags.resize(clusters);
+		AutoFit::Metrics m;
+		m.Assign(widths.data(), flags.data(), clusters, 133.0f, 100.0f);
+		return m;
+	}
+
+	// Largest fitting size on a 1/64 DIP grid, by scanning.
+	float BruteForceFit(const AutoFit::Metrics &m, float width, float height, const AutoFit::Options &o)
+	{
+		float best = o.minSize;
+		for (float s = o.minSize; s <= o.maxSize; s += 1.0f / 64.0f)
+		{
+			if (AutoFit::Fits(m, s, width, height))
+				best = s;
+		}
+		return best;
+	}
+
+	int RunAutoFitBenchmark(int argc, char **argv)
+	{
+		int iterations = argc > 0 ? std::atoi(argv[0]) : 20;
+		if (iterations <= 0)
+			iterations = 20;
+		bool ok = true;
+		AutoFit::Options o;
+
+		std::printf("autofit: correctness\n");
+		{
+			const float widths[] = {60, 60, 30, 60, 60, 30, 60};
+			const uint8_t flags[] = {0, 0, AutoFit::kCanBreakAfter | AutoFit::kWhitespace, 0, 0, AutoFit::kCanBreakAfter | AutoFit::kWhitespace, 0};
+			AutoFit::Metrics m;
+			m.Assign(widths, flags, 7, 120.0f, 100.0f);
+			ok &= Check(m.Words().size() == 3 && std::fabs(m.LongestWord() - 1.2f) < 1e-5f && std::fabs(m.LineHeight() - 1.2f) < 1e-5f,
+						"clusters group into words at break opportunities");
+			AutoFit::Metrics two;
+			two.Assign(widths, flags, 6, 120.0f, 100.0f);
+			ok &= Check(AutoFit::CountLines(two, 100.0f, 270.0f, 8) == 1 && AutoFit::CountLines(two, 100.0f, 269.0f, 8) == 2,
+						"trailing whitespace hangs past the edge");
+			ok &= Check(AutoFit::CountLines(m, 100.0f, 100.0f, 8) == 9, "a word wider than the box never fits");
+			ok &= Check(AutoFit::Search(AutoFit::Metrics{}, 100.0f, 100.0f).fits == false, "empty metrics do not fit");
+
+			AutoFit::Metrics para = MakeParagraphMetrics(600, 7);
+			bool exact = true, monotone = true, refitAgrees = true;
+			float previous = 0.0f;
+			AutoFit::Last last;
+			for (int w = 200; w <= 1600; w += 50)
+			{
+				float h = w * 0.5f;
+				AutoFit::Result r = AutoFit::Search(para, (float)w, h, o);
+				float brute = BruteForceFit(para, (float)w, h, o);
+				bool any = AutoFit::Fits(para, o.minSize, (float)w, h);
+				exact &= r.fits == any && (!any || (AutoFit::Fits(para, r.size, (float)w, h) && std::fabs(r.size - brute) <= o.precision));
+				monotone &= r.size >= previous;
+				previous = r.size;
+				AutoFit::Result re = AutoFit::Refit(para, (float)w, h, last, o);
+				refitAgrees &= re.fits == r.fits && std::fabs(re.size - r.size) <= o.precision;
+				last = AutoFit::Last{(float)w, h, re.size, re.fits};
+			}
+			ok &= Check(exact, "Search matches a brute-force scan within the precision");
+			ok &= Check(monotone, "a larger box never gets a smaller size");
+			ok &= Check(refitAgrees, "Refit from the previous box agrees with Search");
+			AutoFit::Result tiny = AutoFit::Search(para, 40.0f, 20.0f, o);
+			ok &= Check(!tiny.fits && tiny.size == o.minSize, "too small a box falls back to the minimum size");
+		}
+
+		// The plugin's 8 DIP floor would leave the longest text unfitted;
+		// a lower one keeps every box searching.
+		o.minSize = 1.0f;
+		std::printf("autofit: long paragraphs, drag-resize 400->1400 DIPs in 1 DIP steps and back\n");
+		for (size_t clusters : {500u, 5000u, 20000u})
+		{
+			AutoFit::Metrics m = MakeParagraphMetrics(clusters, 11);
+			std::vector<std::pair<float, float>> boxes;
+			for (int w = 400; w <= 1400; w++)
+				boxes.emplace_back((float)w, 300.0f + w * 0.25f);
+			for (int w = 1400; w >= 400; w--)
+				boxes.emplace_back((float)w, 300.0f + w * 0.25f);
+			uint64_t searchSteps = 0, refitSteps = 0;
+			double searchNs = 0.0, refitNs = 0.0;
+			float checksum = 0.0f;
+			bool agree = true;
+			for (int it = 0; it < iterations; it++)
+			{
+				auto t0 = Clock::now();
+				for (const auto &b : boxes)
+				{
+					AutoFit::Result r = AutoFit::Search(m, b.first, b.second, o);
+					searchSteps += (uint64_t)r.steps;
+					checksum += r.size;
+				}
+				auto t1 = Clock::now();
+				AutoFit::Last last;
+				for (const auto &b : boxes)
+				{
+					AutoFit::Result r = AutoFit::Refit(m, b.first, b.second, last, o);
+					last = AutoFit::Last{b.first, b.second, r.size, r.fits};
+					refitSteps += (uint64_t)r.steps;
+					checksum -= r.size;
+				}
+				auto t2 = Clock::now();
+				searchNs += (double)ElapsedNs(t0, t1);
+				refitNs += (double)ElapsedNs(t1, t2);
+			}
+			double fits = (double)boxes.size() * iterations;
+			agree = std::fabs(checksum) / fits <= o.precision;
+			std::printf("  %5zu clusters (%5zu words, %4zu KB): Search %5.1f steps %7.2f us/fit, Refit %5.1f steps %7.2f us/fit\n", clusters, m.Words().size(),
+						m.Bytes() / 1024, searchSteps / fits, searchNs / fits / 1000.0, refitSteps / fits, refitNs / fits / 1000.0);
+			ok &= Check(agree, "Refit and Search pick the same sizes on average");
+			ok &= Check(refitSteps < searchSteps, "refitting from the last size takes fewer probes");
+		}
+		return ok ? 0 : 1;
+	}
+
+	//---------------------------------------------------------------------
+	//	batch: diffed font replacement against a stub EDIT_SECTION
+	//---------------------------------------------------------------------
+	// A timeline in memory behind the same function-pointer surface as the
+	// host's EDIT_SECTION. Objects are sorted by layer and start frame;
+	// every set_object_item_value also appends an undo record, which is
+	// roughly what the host does per write.
+	using BenchObject = const void *;
+
+	struct BenchLayerFrame
+	{
+		int layer, start, end;
+	};
+
+	struct BenchEditInfo
+	{
+		int layer_max = 0;
+	};
+
+	struct BenchEditSection
+	{
+		BenchEditInfo *info;
+		BenchObject (*find_object)(int layer, int frame);
+		BenchLayerFrame (*get_object_layer_frame)(BenchObject object);
+		const char *(*get_object_item_value)(BenchObject object, const wchar_t *effect, const wchar_t *item);
+		bool (*set_object_item_value)(BenchObject object, const wchar_t *effect, const wchar_t *item, const char *value);
+		BenchObject (*get_focus_object)();
+		BenchObject (*get_selected_object)(int index);
+		int (*get_selected_object_num)();
+	};
+
+	struct StubObject
+	{
+		int layer = 0, start = 0, end = 0;
+		bool text = false, vf = false;
+		std::string textFont, vfFont, vfFile;
+	};
+
+	struct StubTimeline
+	{
+		std::vector<StubObject> objects;
+		std::vector<size_t> layerBegin; // index of each layer's first object; one past the last layer too
+		std::vector<std::string> undo;
+		std::vector<size_t> selected; // indices into `objects`
+		size_t focus = SIZE_MAX;
+		size_t gets = 0, sets = 0, rejected = 0;
+	};
+
+	StubTimeline g_stub;
+
+	BenchObject StubFindObject(int layer, int frame)
+	{
+		if (layer < 0 || layer + 1 >= (int)g_stub.layerBegin.size())
+			return nullptr;
+		auto first = g_stub.objects.begin() + (ptrdiff_t)g_stub.layerBegin[layer];
+		auto last = g_stub.objects.begin() + (ptrdiff_t)g_stub.layerBegin[layer + 1];
+		auto it = std::lower_bound(first, last, frame, [](const StubObject &o, int f)
+								   { return o.end < f; });
+		return it == last ? nullptr : &*it;
+	}
+
+	BenchLayerFrame StubLayerFrame(BenchObject object)
+	{
+		const StubObject *o = (const StubObject *)object;
+		return BenchLayerFrame{o->layer, o->start, o->end};
+	}
+
+	BenchObject StubFocusObject()
+	{
+		return g_stub.focus < g_stub.objects.size() ? &g_stub.objects[g_stub.focus] : nullptr;
+	}
+
+	BenchObject StubSelectedObject(int index)
+	{
+		return index >= 0 && index < (int)g_stub.selected.size() ? &g_stub.objects[g_stub.selected[index]] : nullptr;
+	}
+
+	int StubSelectedObjectNum()
+	{
+		return (int)g_stub.selected.size();
+	}
+
+	std::string *StubItem(BenchObject object, const wchar_t *effect, const wchar_t *item)
+	{
+		StubObject *o = (StubObject *)object;
+		bool font = std::wcscmp(item, BatchEdit::kFontItem) == 0;
+		if (std::wcscmp(effect, BatchEdit::kTextEffect) == 0)
+			return o->text && font ? &o->textFont : nullptr;
+		if (std::wcscmp(effect, BatchEdit::kVFEffect) == 0 && o->vf)
+			return font ? &o->vfFont : std::wcscmp(item, BatchEdit::kFileItem) == 0 ? &o->vfFile : nullptr;
+		return nullptr;
+	}
+
+	const char *StubGetValue(BenchObject object, const wchar_t *effect, const wchar_t *item)
+	{
+		g_stub.gets++;
+		std::string *value = StubItem(object, effect, item);
+		return value ? value->c_str() : nullptr;
+	}
+
+	bool StubSetValue(BenchObject object, const wchar_t *effect, const wchar_t *item, const char *value)
+	{
+		g_stub.sets++;
+		std::string *target = StubItem(object, effect, item);
+		if (!target)
+		{
+			g_stub.rejected++;
+			return false;
+		}
+		g_stub.undo.push_back(*target);
+		*target = value;
+		return true;
+	}
+
+	// `count` objects over `layers` layers: 45% standard text, 35% Variable
+	// Font Text (half with a font file), the rest without text.
+	void BuildStubTimeline(int count, int layers, uint32_t seed)
+	{
+		static const char *const kFonts[] = {"Meiryo", "Yu Gothic", "BIZ UDGothic", "Noto Sans JP"};
+		std::mt19937 rng(seed);
+		g_stub = StubTimeline{};
+		g_stub.objects.reserve((size_t)count);
+		for (int layer = 0; layer < layers; layer++)
+		{
+			g_stub.layerBegin.push_back(g_stub.objects.size());
+			int frame = 0;
+			for (int i = 0; i < count / layers; i++)
+			{
+				StubObject o;
+				o.layer = layer;
+				o.start = frame + (int)(rng() % 20);
+				o.end = o.start + 30 + (int)(rng() % 90);
+				frame = o.end + 1;
+				uint32_t kind = rng() % 20;
+				if (kind < 9)
+				{
+					o.text = true;
+					o.textFont = kFonts[rng() % 4];
+				}
+				else if (kind < 16)
+				{
+					o.vf = true;
+					if (rng() % 2)
+						o.vfFont = kFonts[rng() % 4];
+					else
+						o.vfFile = rng() % 2 ? "C:\\Fonts\\RobotoFlex.ttf" : "C:\\Fonts\\Meiryo.ttc";
+				}
+				g_stub.objects.push_back(std::move(o));
+			}
+		}
+		g_stub.layerBegin.push_back(g_stub.objects.size());
+	}
+
+	BenchEditSection MakeStubSection(BenchEditInfo &info)
+	{
+		info.layer_max = (int)g_stub.layerBegin.size() - 2;
+		return BenchEditSection{&info, &StubFindObject, &StubLayerFrame, &StubGetValue, &StubSetValue, &StubFocusObject, &StubSelectedObject,
+								&StubSelectedObjectNum};
+	}
+
+	// What SetFontTextObject used to do for each object: every value of
+	// both effects, whether the object has them or not.
+	size_t ApplyUnconditionally(BenchEditSection *edit, const BatchEdit::Scope &scope, const BatchEdit::FontRef &to)
+	{
+		size_t objects = 0;
+		BatchEdit::ForEachObject(edit, scope, [&](BenchObject object)
+								 {
+			objects++;
+			if (!to.IsFile())
+			{
+				edit->set_object_item_value(object, BatchEdit::kTextEffect, BatchEdit::kFontItem, to.name.c_str());
+				edit->set_object_item_value(object, BatchEdit::kVFEffect, BatchEdit::kFontItem, to.name.c_str());
+				edit->set_object_item_value(object, BatchEdit::kVFEffect, BatchEdit::kFileItem, "");
+			}
+			else
+			{
+				edit->set_object_item_value(object, BatchEdit::kVFEffect, BatchEdit::kFontItem, "");
+				edit->set_object_item_value(object, BatchEdit::kVFEffect, BatchEdit::kFileItem, to.file.c_str());
+			} });
+		return objects;
+	}
+
+	int RunBatchBenchmark(int argc, char **argv)
+	{
+		int objects = argc > 0 ? std::atoi(argv[0]) : 10000;
+		if (objects <= 0)
+			objects = 10000;
+		const int layers = 100;
+		bool ok = true;
+		BenchEditInfo info;
+		std::vector<BatchEdit::Write<BenchObject>> writes;
+
+		std::printf("batch: correctness\n");
+		{
+			BuildStubTimeline(2000, 20, 3);
+			BenchEditSection edit = MakeStubSection(info);
+			size_t visited = 0;
+			BatchEdit::ForEachObject(&edit, BatchEdit::Scope{}, [&](BenchObject)
+									 { visited++; });
+			ok &= Check(visited == g_stub.objects.size(), "the whole timeline is visited once");
+
+			std::vector<StubObject> before = g_stub.objects;
+			BatchEdit::Replacement r;
+			r.from.name = "Meiryo";
+			r.to.name = "Yu Mincho";
+			BatchEdit::Stats stats = BatchEdit::ReplaceInScope(&edit, BatchEdit::Scope{}, r, writes);
+			bool replaced = true, untouched = true;
+			size_t expected = 0;
+			for (size_t i = 0; i < before.size(); i++)
+			{
+				const StubObject &was = before[i], &now = g_stub.objects[i];
+				bool textHit = was.text && was.textFont == "Meiryo";
+				bool vfHit = was.vf && was.vfFile.empty() && was.vfFont == "Meiryo";
+				expected += textHit || vfHit;
+				replaced &= (!textHit || now.textFont == "Yu Mincho") && (!vfHit || now.vfFont == "Yu Mincho");
+				untouched &= (textHit || now.textFont == was.textFont) && (vfHit || (now.vfFont == was.vfFont && now.vfFile == was.vfFile));
+			}
+			ok &= Check(replaced && stats.matched == expected, "every object using the source font gets the new one");
+			ok &= Check(untouched, "objects using other fonts or files are left alone");
+			ok &= Check(stats.writes == expected && g_stub.rejected == 0, "one write per object, only to the effect it has");
+			BatchEdit::Stats again = BatchEdit::ReplaceInScope(&edit, BatchEdit::Scope{}, r, writes);
+			ok &= Check(again.matched == 0 && again.writes == 0, "re-applying writes nothing");
+
+			r = BatchEdit::Replacement{};
+			r.anyFont = true;
+			r.to.file = "C:\\Fonts\\RobotoFlex.ttf";
+			BatchEdit::Scope scope;
+			scope.layerFirst = 2;
+			scope.layerLast = 4;
+			scope.frameFirst = 500;
+			scope.frameLast = 2000;
+			before = g_stub.objects;
+			stats = BatchEdit::ReplaceInScope(&edit, scope, r, writes);
+			bool inScope = true, fileSet = true;
+			size_t texts = 0;
+			for (size_t i = 0; i < before.size(); i++)
+			{
+				const StubObject &was = before[i], &now = g_stub.objects[i];
+				bool within = was.layer >= 2 && was.layer <= 4 && was.end >= 500 && was.start <= 2000;
+				if (!within)
+					inScope &= now.vfFont == was.vfFont && now.vfFile == was.vfFile;
+				else if (was.vf)
+					fileSet &= now.vfFont.empty() && now.vfFile == "C:\\Fonts\\RobotoFlex.ttf";
+				texts += within && was.text;
+				fileSet &= now.textFont == was.textFont;
+			}
+			ok &= Check(inScope, "nothing outside the layer / frame range changes");
+			ok &= Check(fileSet, "a font file goes to Variable Font Text only");
+			ok &= Check(stats.unsupported == texts && g_stub.rejected == 0, "standard text is counted as unsupported, not written");
+
+			// The layers of the selected objects, else the focused one's.
+			auto firstOn = [](int layer)
+			{ return g_stub.layerBegin[layer]; };
+			g_stub.selected = {firstOn(8), firstOn(5) + 3, firstOn(6)};
+			scope = BatchEdit::Scope{};
+			ok &= Check(BatchEdit::SelectedLayers(&edit, scope) && scope.layerFirst == 5 && scope.layerLast == 8, "selected objects give their layer span");
+			g_stub.selected.clear();
+			g_stub.focus = firstOn(11) + 2;
+			scope = BatchEdit::Scope{};
+			ok &= Check(BatchEdit::SelectedLayers(&edit, scope) && scope.layerFirst == 11 && scope.layerLast == 11,
+						"without a selection the focused object's layer is used");
+			g_stub.focus = SIZE_MAX;
+			BatchEdit::Scope untouchedScope;
+			ok &= Check(!BatchEdit::SelectedLayers(&edit, untouchedScope) && untouchedScope.layerFirst == 0 && untouchedScope.layerLast == -1,
+						"with neither, no layer range is made");
+
+			g_stub.selected = {firstOn(7), firstOn(9)};
+			scope = BatchEdit::Scope{};
+			BatchEdit::SelectedLayers(&edit, scope);
+			g_stub.selected.clear();
+			r = BatchEdit::Replacement{};
+			r.anyFont = true;
+			r.to.name = "Layer Gothic";
+			before = g_stub.objects;
+			stats = BatchEdit::ReplaceInScope(&edit, scope, r, writes);
+			bool onLayers = true;
+			size_t layerTexts = 0;
+			for (size_t i = 0; i < before.size(); i++)
+			{
+				const StubObject &was = before[i], &now = g_stub.objects[i];
+				bool within = was.layer >= 7 && was.layer <= 9;
+				layerTexts += within && (was.text || was.vf);
+				if (within)
+					onLayers &= (!was.text || now.textFont == "Layer Gothic") && (!was.vf || now.vfFont == "Layer Gothic");
+				else
+					onLayers &= now.textFont == was.textFont && now.vfFont == was.vfFont && now.vfFile == was.vfFile;
+			}
+			ok &= Check(onLayers && stats.matched == layerTexts && stats.failed == 0, "a layer range replaces text on those layers only");
+
+			BatchEdit::FontRef font;
+			BenchObject object = edit.find_object(3, 600);
+			ok &= Check(object && BatchEdit::ReadFont(&edit, object, font) == (((const StubObject *)object)->text || ((const StubObject *)object)->vf),
+						"the focused object's font reads back");
+		}
+
+		std::printf("batch: %d objects on %d layers, replace one font everywhere\n", objects, layers);
+		{
+			BatchEdit::FontRef to;
+			to.name = "Yu Mincho";
+
+			BuildStubTimeline(objects, layers, 9);
+			BenchEditSection edit = MakeStubSection(info);
+			auto t0 = Clock::now();
+			size_t visited = ApplyUnconditionally(&edit, BatchEdit::Scope{}, to);
+			double naiveMs = ElapsedNs(t0, Clock::now()) / 1e6;
+			size_t naiveSets = g_stub.sets, naiveRejected = g_stub.rejected, naiveUndo = g_stub.undo.size();
+
+			BuildStubTimeline(objects, layers, 9);
+			edit = MakeStubSection(info);
+			BatchEdit::Replacement r;
+			r.from.name = "Meiryo";
+			r.to = to;
+			t0 = Clock::now();
+			BatchEdit::Stats stats = BatchEdit::ReplaceInScope(&edit, BatchEdit::Scope{}, r, writes);
+			double batchMs = ElapsedNs(t0, Clock::now()) / 1e6;
+			size_t batchGets = g_stub.gets;
+
+			g_stub.gets = g_stub.sets = 0;
+			t0 = Clock::now();
+			BatchEdit::Stats again = BatchEdit::ReplaceInScope(&edit, BatchEdit::Scope{}, r, writes);
+			double againMs = ElapsedNs(t0, Clock::now()) / 1e6;
+
+			r.anyFont = true;
+			g_stub.gets = g_stub.sets = 0;
+			t0 = Clock::now();
+			BatchEdit::Stats all = BatchEdit::ReplaceInScope(&edit, BatchEdit::Scope{}, r, writes);
+			double allMs = ElapsedNs(t0, Clock::now()) / 1e6;
+
+			std::printf("  unconditional:  %zu objects, %zu writes (%zu rejected), %zu undo records, %.2f ms\n", visited, naiveSets, naiveRejected, naiveUndo,
+						naiveMs);
+			std::printf("  batched+diffed: %zu objects, %zu matched, %zu writes, %zu reads, %.2f ms\n", stats.scanned, stats.matched, stats.writes, batchGets,
+						batchMs);
+			std::printf("  re-apply:       %zu writes, %.2f ms\n", again.writes, againMs);
+			std::printf("  all text:       %zu matched, %zu writes, %zu unchanged, %.2f ms\n", all.matched, all.writes, all.unchanged, allMs);
+			ok &= Check(stats.scanned == (size_t)objects / layers * layers, "every object is visited");
+			ok &= Check(stats.writes < naiveSets / 5 && stats.failed == 0, "only needed writes are issued, none rejected");
+			ok &= Check(again.writes == 0 && all.unchanged >= stats.writes, "values already in place are skipped");
+		}
+		return ok ? 0 : 1;
+	}
+
+	//---------------------------------------------------------------------
+	//	capi: headless client of the font catalog API (FontCatalogApi.h)
+	//---------------------------------------------------------------------
+	// The module side publishes a synthetic catalog through
+	// CatalogApi::Global(), the way the plugin does after EnumerateFonts;
+	// everything else goes through the FONT_CATALOG_API table only, as
+	// another plugin would after GetProcAddress("GetFontCatalogApi").
+	struct CatalogFont
+	{
+		std::wstring displayName;
+		std::wstring familyName;
+		std::wstring filePath;
+		std::wstring sourcePath;
+		bool isSystemFont = true;
+		uint32_t faceIndex = 0;
+		uint64_t contentHash = 0;
+		bool axesResolved = false;
+		std::vector<std::pair<std::string, std::pair<float, float>>> axisRanges;
+		std::vector<float> axisDefaults;
+		uint32_t coverage = 0;
+	};
+
+	std::vector<CatalogFont> MakeCatalogFonts(size_t count)
+	{
+		static const wchar_t *const kStems[] = {L"Noto Sans", L"Noto Serif", L"Source Han Sans", L"Yu Gothic", L"Meiryo", L"Roboto", L"Inter", L"BIZ UDPGothic"};
+		std::vector<CatalogFont> fonts(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			CatalogFont &f = fonts[i];
+			f.familyName = std::wstring(kStems[i % 8]) + L" " + std::to_wstring(i);
+			f.isSystemFont = i % 3 != 0;
+			f.displayName = f.isSystemFont ? f.familyName : f.familyName + L" [F" + std::to_wstring(i) + L".ttf]";
+			f.filePath = f.isSystemFont ? L"" : L"C:\\Plugin\\Fonts\\F" + std::to_wstring(i) + L".ttf";
+			f.sourcePath = f.isSystemFont ? L"C:\\Windows\\Fonts\\S" + std::to_wstring(i) + L".ttf" : f.filePath;
+			f.contentHash = FontHash::Hash64(&i, sizeof(i));
+			if (i % 5 == 0)
+			{
+				f.axisRanges = {{"wght", {100.0f, 900.0f}}, {"wdth", {75.0f, 125.0f}}};
+				f.axisDefaults = {400.0f, 100.0f};
+			}
+		}
+		return fonts;
+	}
+
+	std::vector<std::shared_ptr<const CatalogApi::Entry>> MakeCatalogEntries(const std::vector<CatalogFont> &fonts)
+	{
+		std::vector<std::shared_ptr<const CatalogApi::Entry>> entries;
+		entries.reserve(fonts.size());
+		for (const CatalogFont &f : fonts)
+			entries.push_back(CatalogApi::MakeEntry(f));
+		return entries;
+	}
+
+	struct ChangeCounter
+	{
+		std::atomic<int> calls{0};
+		std::atomic<uint64_t> lastSerial{0};
+		std::atomic<int> busyMs{0}; // time each call takes
+	};
+
+	void CountChange(void *user, uint64_t serial)
+	{
+		auto *c = static_cast<ChangeCounter *>(user);
+		if (c->busyMs > 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(c->busyMs.load()));
+		c->calls++;
+		c->lastSerial = serial;
+	}
+
+	bool WaitFor(const std::function<bool()> &done)
+	{
+		for (int i = 0; i < 2000 && !done(); i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		return done();
+	}
+
+	int RunCatalogApiBenchmark(int argc, char **argv)
+	{
+		size_t count = argc > 0 ? (size_t)std::atoi(argv[0]) : 5000;
+		if (count < 16)
+			count = 5000;
+		bool ok = true;
+		CatalogApi::Publisher &module = CatalogApi::Global();
+
+		std::printf("capi: contract\n");
+		const FONT_CATALOG_API *api = CatalogApi::GetApi(FONT_CATALOG_API_VERSION);
+		ok &= Check(api && api->version == FONT_CATALOG_API_VERSION && api->struct_size == (int)sizeof(FONT_CATALOG_API), "the current version is served");
+		ok &= Check(!CatalogApi::GetApi(0) && !CatalogApi::GetApi(FONT_CATALOG_API_VERSION + 1), "unknown versions are refused");
+		if (!api)
+			return 1;
+		const FONT_CATALOG_SNAPSHOT *empty = api->acquire_snapshot();
+		ok &= Check(empty && api->entry_count(empty) == 0, "before the first enumeration the snapshot is empty");
+		api->release_snapshot(empty);
+
+		std::vector<CatalogFont> fonts = MakeCatalogFonts(count);
+		module.Publish(MakeCatalogEntries(fonts));
+		const FONT_CATALOG_SNAPSHOT *s = api->acquire_snapshot();
+		ok &= Check(api->entry_count(s) == (int)count, "every font is listed");
+		FONT_CATALOG_ENTRY e{};
+		e.struct_size = sizeof(e);
+		bool fields = api->get_entry(s, 5, &e) && std::wcscmp(e.display_name, fonts[5].displayName.c_str()) == 0 &&
+					  std::wcscmp(e.family_name, fonts[5].familyName.c_str()) == 0 && e.axis_count == 2 && std::strcmp(e.axes[0].tag, "wght") == 0 &&
+					  e.axes[0].max_value == 900.0f && e.axes[1].default_value == 100.0f && (e.flags & FONT_CATALOG_FLAG_VARIABLE) != 0 &&
+					  (e.flags & FONT_CATALOG_FLAG_DETAILS_RESOLVED) == 0 && e.content_hash == fonts[5].contentHash;
+		ok &= Check(fields, "entries carry names, axes and flags");
+		ok &= Check(!api->get_entry(s, (int)count, &e) && !api->get_entry(s, -1, &e), "out-of-range indices are rejected");
+		ok &= Check(api->find_identity(s, e.identity) == 5 && api->find_identity(s, L"sys:nope") == -1, "identities resolve to indices");
+
+		// A version-0 style caller that only knows the first members.
+		struct OldEntry
+		{
+			int struct_size;
+			const wchar_t *display_name;
+			const wchar_t *family_name;
+		} old{};
+		struct
+		{
+			OldEntry entry;
+			uint32_t guard = 0xA5A5A5A5;
+		} probe;
+		probe.entry.struct_size = sizeof(OldEntry);
+		ok &= Check(api->get_entry(s, 3, (FONT_CATALOG_ENTRY *)&probe.entry) && probe.guard == 0xA5A5A5A5 &&
+						std::wcscmp(probe.entry.family_name, fonts[3].familyName.c_str()) == 0,
+					"a smaller struct_size is filled without overrunning");
+		(void)old;
+
+		FONT_CATALOG_QUERY q{};
+		q.struct_size = sizeof(q);
+		q.type = FONT_CATALOG_TYPE_FILE;
+		q.text = L"NOTO SANS";
+		std::vector<int> found(count);
+		int total = api->query(s, &q, found.data(), (int)found.size());
+		std::vector<BenchFont> coreFonts(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			coreFonts[i].displayName = fonts[i].displayName;
+			coreFonts[i].isSystemFont = fonts[i].isSystemFont;
+		}
+		std::vector<int> expected;
+		FontPreviewCore::FilterCatalog(coreFonts, FontPreviewCore::FontTypeFilter::Folder, L"NOTO SANS", expected);
+		ok &= Check(total == (int)expected.size() && std::equal(expected.begin(), expected.end(), found.begin()), "queries match the window's filter");
+		q.type = FONT_CATALOG_TYPE_ALL;
+		q.text = nullptr;
+		q.require_all = FONT_CATALOG_FLAG_VARIABLE;
+		ok &= Check(api->query(s, &q, nullptr, 0) == (int)((count + 4) / 5), "flag queries count without an output buffer");
+		q.struct_size = 4;
+		ok &= Check(api->query(s, &q, nullptr, 0) == -1, "truncated queries are rejected");
+
+		// Details resolve for one font: only its entry is rebuilt and the
+		// old snapshot stays readable.
+		ChangeCounter changes;
+		int token = api->subscribe(&CountChange, &changes);
+		fonts[5].axesResolved = true;
+		fonts[5].coverage = FONT_CATALOG_COVERAGE_LATIN | FONT_CATALOG_COVERAGE_KANA;
+		std::vector<std::shared_ptr<const CatalogApi::Entry>> entries = MakeCatalogEntries(fonts);
+		uint64_t serial = module.Publish(entries);
+		const FONT_CATALOG_SNAPSHOT *s2 = api->acquire_snapshot();
+		FONT_CATALOG_ENTRY e2{};
+		e2.struct_size = sizeof(e2);
+		ok &= Check(api->snapshot_serial(s2) == serial && api->snapshot_serial(s) < serial, "serials increase");
+		ok &= Check(api->get_entry(s2, 5, &e2) && (e2.flags & FONT_CATALOG_COVERAGE_KANA) && (e2.flags & FONT_CATALOG_FLAG_DETAILS_RESOLVED) &&
+						api->get_entry(s, 5, &e) && (e.flags & FONT_CATALOG_FLAG_DETAILS_RESOLVED) == 0,
+					"a new snapshot does not change an old one");
+		ok &= Check(WaitFor([&]
+							{ return changes.lastSerial == serial; }),
+					"subscribers hear about the new snapshot");
+
+		// A burst of publishes while the subscriber is busy is coalesced.
+		changes.calls = 0;
+		changes.busyMs = 2;
+		for (int i = 0; i < 200; i++)
+		{
+			serial = module.Publish(entries, true);
+			if (i % 10 == 0)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		ok &= Check(WaitFor([&]
+							{ return changes.lastSerial == serial; }) &&
+						changes.calls < 200,
+					"bursts of changes are reported with the latest serial");
+		changes.busyMs = 0;
+		api->unsubscribe(token);
+		int before = changes.calls;
+		module.Publish(entries);
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		ok &= Check(changes.calls == before, "no calls after unsubscribe returns");
+		api->release_snapshot(s2);
+		api->release_snapshot(s);
+		std::printf("  %d notifications for 200 publishes\n", before);
+
+		std::printf("capi: %zu fonts, readers against a publishing module\n", count);
+		{
+			std::atomic<bool> stop{false};
+			std::atomic<uint64_t> reads{0};
+			std::atomic<int> bad{0};
+			std::vector<std::vector<double>> acquireNs(4);
+			std::vector<std::thread> readers;
+			for (int t = 0; t < 4; t++)
+			{
+				readers.emplace_back([&, t]
+									 {
+					FONT_CATALOG_QUERY rq{};
+					rq.struct_size = sizeof(rq);
+					rq.text = L"gothic";
+					while (!stop)
+					{
+						auto t0 = Clock::now();
+						const FONT_CATALOG_SNAPSHOT *snap = api->acquire_snapshot();
+						acquireNs[t].push_back(ElapsedNs(t0, Clock::now()));
+						FONT_CATALOG_ENTRY re{};
+						re.struct_size = sizeof(re);
+						int n = api->entry_count(snap);
+						if (n != (int)count || !api->get_entry(snap, n - 1, &re) || api->query(snap, &rq, nullptr, 0) <= 0)
+							bad++;
+						api->release_snapshot(snap);
+						reads++;
+					} });
+			}
+			auto t0 = Clock::now();
+			int publishes = 0;
+			double publishNs = 0.0;
+			for (; publishes < 200; publishes++)
+			{
+				size_t changed = (size_t)publishes * 7 % count;
+				fonts[changed].axesResolved = true;
+				entries[changed] = CatalogApi::MakeEntry(fonts[changed]);
+				auto p0 = Clock::now();
+				module.Publish(entries, true);
+				publishNs += ElapsedNs(p0, Clock::now());
+			}
+			stop = true;
+			for (auto &r : readers)
+				r.join();
+			double wallMs = ElapsedNs(t0, Clock::now()) / 1e6;
+			std::vector<double> all;
+			for (const auto &v : acquireNs)
+				all.insert(all.end(), v.begin(), v.end());
+			std::sort(all.begin(), all.end());
+			double p50 = all.empty() ? 0.0 : all[all.size() / 2];
+			double p99 = all.empty() ? 0.0 : all[all.size() * 99 / 100];
+			auto r0 = Clock::now();
+			module.Publish(entries);
+			double fullNs = ElapsedNs(r0, Clock::now());
+			std::printf("  %d publishes (one entry rebuilt each): %.1f us/publish; after re-enumeration (new identity index): %.1f us\n", publishes,
+						publishNs / publishes / 1000.0, fullNs / 1000.0);
+			std::printf("  4 readers: %llu snapshot reads in %.1f ms, acquire p50 %.2f us p99 %.2f us (%u hardware threads)\n", (unsigned long long)reads.load(),
+						wallMs, p50 / 1000.0, p99 / 1000.0, std::thread::hardware_concurrency());
+			ok &= Check(bad == 0, "readers always see a whole catalog");
+
+			const FONT_CATALOG_SNAPSHOT *snap = api->acquire_snapshot();
+			FONT_CATALOG_QUERY rq{};
+			rq.struct_size = sizeof(rq);
+			rq.text = L"gothic";
+			const int rounds = 200;
+			auto q0 = Clock::now();
+			int hits = 0;
+			for (int i = 0; i < rounds; i++)
+				hits += api->query(snap, &rq, found.data(), (int)found.size());
+			double queryUs = ElapsedNs(q0, Clock::now()) / rounds / 1000.0;
+			q0 = Clock::now();
+			for (int i = 0; i < rounds; i++)
+			{
+				FontPreviewCore::FilterCatalog(coreFonts, FontPreviewCore::FontTypeFilter::All, L"gothic", expected);
+				hits -= (int)expected.size();
+			}
+			double filterUs = ElapsedNs(q0, Clock::now()) / rounds / 1000.0;
+			api->release_snapshot(snap);
+			std::printf("  query over the shared index: %.1f us, FilterCatalog (lowercases every name): %.1f us\n", queryUs, filterUs);
+			ok &= Check(hits == 0, "the index and FilterCatalog agree");
+		}
+
+		std::printf("capi: details for clients while the window is hidden\n");
+		{
+			// As enumerated: no axes until a font's details resolve.
+			std::vector<CatalogFont> listed = MakeCatalogFonts(count);
+			std::vector<CatalogFont> truth = listed;
+			for (CatalogFont &f : listed)
+			{
+				f.axisRanges.clear();
+				f.axisDefaults.clear();
+			}
+			CatalogApi::Publisher local;
+			std::atomic<int> clients{0};
+			local.SetClientCallback([&]
+									{ clients++; });
+			std::vector<std::shared_ptr<const CatalogApi::Entry>> lazy = MakeCatalogEntries(listed);
+			local.Publish(lazy);
+			ok &= Check(clients == 0 && !local.HasClient(), "publishing alone reports no client");
+			CatalogApi::Release(local.Acquire());
+			CatalogApi::Release(local.Acquire());
+			ok &= Check(clients == 1 && local.HasClient(), "the first acquire reports a client, once");
+			CatalogApi::Publisher subscribed;
+			subscribed.SetClientCallback([&]
+										 { clients++; });
+			int sub = subscribed.Subscribe(&CountChange, &changes);
+			ok &= Check(clients == 2, "so does the first subscription");
+			subscribed.Unsubscribe(sub);
+			subscribed.Shutdown();
+
+			// The plugin's queue runs nothing while the window is hidden.
+			TaskQueue hidden;
+			hidden.Start(1);
+			hidden.SetRunnableLevels(0);
+			std::atomic<int> rowRequests{0};
+			hidden.Post(TaskQueue::Priority::Low, 1, [&]
+						{ rowRequests++; });
+
+			// Worker: resolve and park; UI thread: apply and publish.
+			std::mutex parkedMutex;
+			std::vector<size_t> parked;
+			CatalogApi::DetailPass pass;
+			pass.Start(count, [&](size_t i)
+					   {
+				std::lock_guard<std::mutex> lock(parkedMutex);
+				parked.push_back(i); });
+			size_t applied = 0;
+			int publishes = 0;
+			bool done = WaitFor([&]
+								{
+				std::vector<size_t> batch;
+				{
+					std::lock_guard<std::mutex> lock(parkedMutex);
+					batch.swap(parked);
+				}
+				for (size_t i : batch)
+				{
+					listed[i] = truth[i];
+					listed[i].axesResolved = true;
+					lazy[i] = CatalogApi::MakeEntry(listed[i]);
+				}
+				if (!batch.empty())
+				{
+					local.Publish(lazy, true);
+					publishes++;
+				}
+				applied += batch.size();
+				return applied == count; });
+			ok &= Check(done && pass.Done() == count && rowRequests == 0, "the detail pass resolves every entry while the queue is held back");
+
+			const FONT_CATALOG_SNAPSHOT *snap = local.Acquire();
+			FONT_CATALOG_QUERY vq{};
+			vq.struct_size = sizeof(vq);
+			vq.require_all = FONT_CATALOG_FLAG_DETAILS_RESOLVED;
+			int resolved = CatalogApi::Query(snap, &vq, nullptr, 0);
+			vq.require_all = FONT_CATALOG_FLAG_VARIABLE;
+			int variable = CatalogApi::Query(snap, &vq, nullptr, 0);
+			CatalogApi::Release(snap);
+			ok &= Check(resolved == (int)count && variable == (int)((count + 4) / 5), "a VARIABLE query then finds every variable font");
+			std::printf("  %zu entries resolved in %d publishes\n", count, publishes);
+
+			std::atomic<int> slow{0};
+			pass.Start(count, [&](size_t)
+					   {
+				slow++;
+				std::this_thread::sleep_for(std::chrono::milliseconds(1)); });
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			pass.Stop();
+			int ran = slow;
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			ok &= Check(ran < (int)count && slow == ran && pass.Done() == (size_t)ran, "stopping a pass skips the rest");
+			hidden.Shutdown();
+			local.Shutdown();
+		}
+		module.Shutdown();
+		return ok ? 0 : 1;
+	}
+
+	//---------------------------------------------------------------------
+	//	zip: font packs served from the archive image
+	//---------------------------------------------------------------------
+	void PutLE16(std::vector<uint8_t> &b, uint32_t v)
+	{
+		b.push_back((uint8_t)v);
+		b.push_back((uint8_t)(v >> 8));
+	}
+
+	void PutLE32(std::vector<uint8_t> &b, uint32_t v)
+	{
+		PutLE16(b, v & 0xFFFF);
+		PutLE16(b, v >> 16);
+	}
+
+	void PutLE64(std::vector<uint8_t> &b, uint64_t v)
+	{
+		PutLE32(b, (uint32_t)v);
+		PutLE32(b, (uint32_t)(v >> 32));
+	}
+
+	// A name table holding the family (name 1) as a Windows English record.
+	std::vector<uint8_t> BuildNameTable(const std::string &family)
+	{
+		std::vector<uint8_t> name;
+		PutU16(name, 0);
+		PutU16(name, 1);
+		PutU16(name, 6 + 12);
+		PutU16(name, 3);
+		PutU16(name, 1);
+		PutU16(name, 0x0409);
+		PutU16(name, 1);
+		PutU16(name, (uint32_t)family.size() * 2);
+		PutU16(name, 0);
+		for (char c : family)
+			PutU16(name, (uint8_t)c);
+		return name;
+	}
+
+	// The smallest sfnt SfntReader accepts: just the name table, padded to
+	// `size` bytes.
+	std::vector<uint8_t> BuildNamedFont(const std::string &family, size_t size = 0)
+	{
+		std::vector<uint8_t> name = BuildNameTable(family);
+		std::vector<uint8_t> b;
+		PutU32(b, 0x00010000);
+		PutU16(b, 1);
+		PutU16(b, 16);
+		PutU16(b, 0);
+		PutU16(b, 0);
+		b.insert(b.end(), {'n', 'a', 'm', 'e'});
+		PutU32(b, 0);
+		PutU32(b, 12 + 16);
+		PutU32(b, (uint32_t)name.size());
+		b.insert(b.end(), name.begin(), name.end());
+		if (b.size() < size)
+			b.resize(size, 0xCD);
+		return b;
+	}
+
+	struct ZipMember
+	{
+		std::string name;
+		std::vector<uint8_t> data; // written as is; `method` only labels it
+		uint16_t method = ZipIndex::kStored;
+		uint16_t flags = 0;
+		std::string unicodePath; // Info-ZIP 0x7075 field when set
+		bool zip64 = false;		 // sizes and offset in a Zip64 extra field
+		uint32_t localPadding = 0; // extra bytes in the local header only
+	};
+
+	// An archive image as a zip writer lays it out: local headers and
+	// data, central directory, then the (Zip64) end records and comment.
+	std::vector<uint8_t> BuildZip(const std::vector<ZipMember> &members, const std::string &comment = std::string(), bool zip64End = false)
+	{
+		std::vector<uint8_t> b;
+		std::vector<uint64_t> offsets;
+		for (const auto &m : members)
+		{
+			offsets.push_back(b.size());
+			PutLE32(b, 0x04034b50);
+			PutLE16(b, 20);
+			PutLE16(b, m.flags);
+			PutLE16(b, m.method);
+			PutLE32(b, 0);
+			PutLE32(b, ZipIndex::Crc32(m.data.data(), m.data.size()));
+			PutLE32(b, (uint32_t)m.data.size());
+			PutLE32(b, (uint32_t)m.data.size());
+			PutLE16(b, (uint32_t)m.name.size());
+			PutLE16(b, m.localPadding);
+			b.insert(b.end(), m.name.begin(), m.name.end());
+			b.insert(b.end(), m.localPadding, 0);
+			b.insert(b.end(), m.data.begin(), m.data.end());
+		}
+		uint64_t dirOffset = b.size();
+		for (size_t i = 0; i < members.size(); i++)
+		{
+			const ZipMember &m = members[i];
+			std::vector<uint8_t> extra;
+			if (m.zip64)
+			{
+				PutLE16(extra, 0x0001);
+				PutLE16(extra, 24);
+				PutLE64(extra, m.data.size());
+				PutLE64(extra, m.data.size());
+				PutLE64(extra, offsets[i]);
+			}
+			if (!m.unicodePath.empty())
+			{
+				PutLE16(extra, 0x7075);
+				PutLE16(extra, 5 + (uint32_t)m.unicodePath.size());
+				extra.push_back(1);
+				PutLE32(extra, ZipIndex::Crc32((const uint8_t *)m.name.data(), m.name.size()));
+				extra.insert(extra.end(), m.unicodePath.begin(), m.unicodePath.end());
+			}
+			uint32_t size32 = m.zip64 ? 0xFFFFFFFFu : (uint32_t)m.data.size();
+			PutLE32(b, 0x02014b50);
+			PutLE16(b, 0x031E);
+			PutLE16(b, 20);
+			PutLE16(b, m.flags);
+			PutLE16(b, m.method);
+			PutLE32(b, 0);
+			PutLE32(b, ZipIndex::Crc32(m.data.data(), m.data.size()));
+			PutLE32(b, size32);
+			PutLE32(b, size32);
+			PutLE16(b, (uint32_t)m.name.size());
+			PutLE16(b, (uint32_t)extra.size());
+			PutLE16(b, 0);
+			PutLE16(b, 0);
+			PutLE16(b, 0);
+			PutLE32(b, 0);
+			PutLE32(b, m.zip64 ? 0xFFFFFFFFu : (uint32_t)offsets[i]);
+			b.insert(b.end(), m.name.begin(), m.name.end());
+			b.insert(b.end(), extra.begin(), extra.end());
+		}
+		uint64_t dirSize = b.size() - dirOffset;
+		if (zip64End)
+		{
+			uint64_t z64 = b.size();
+			PutLE32(b, 0x06064b50);
+			PutLE64(b, 44);
+			PutLE16(b, 45);
+			PutLE16(b, 45);
+			PutLE32(b, 0);
+			PutLE32(b, 0);
+			PutLE64(b, members.size());
+			PutLE64(b, members.size());
+			PutLE64(b, dirSize);
+			PutLE64(b, dirOffset);
+			PutLE32(b, 0x07064b50);
+			PutLE32(b, 0);
+			PutLE64(b, z64);
+			PutLE32(b, 1);
+		}
+		PutLE32(b, 0x06054b50);
+		PutLE16(b, 0);
+		PutLE16(b, 0);
+		PutLE16(b, zip64End ? 0xFFFF : (uint32_t)members.size());
+		PutLE16(b, zip64End ? 0xFFFF : (uint32_t)members.size());
+		PutLE32(b, zip64End ? 0xFFFFFFFFu : (uint32_t)dirSize);
+		PutLE32(b, zip64End ? 0xFFFFFFFFu : (uint32_t)dirOffset);
+		PutLE16(b, (uint32_t)comment.size());
+		b.insert(b.end(), comment.begin(), comment.end());
+		return b;
+	}
+
+	// The entry's bytes in the image, when servable.
+	bool ServedBytes(const std::vector<uint8_t> &image, const ZipIndex::Entry &e, const std::vector<uint8_t> &expected)
+	{
+		return e.Servable() && e.size == expected.size() && std::equal(expected.begin(), expected.end(), image.begin() + (size_t)e.dataOffset) &&
+			   ZipIndex::Crc32(image.data() + e.dataOffset, (size_t)e.size) == e.crc32;
+	}
+
+	int RunZipBenchmark(int argc, char **argv)
+	{
+		size_t count = argc > 0 ? (size_t)std::atoi(argv[0]) : 20000;
+		if (count < 16)
+			count = 20000;
+		bool ok = true;
+
+		std::printf("zip: central directory\n");
+		const char check[] = "123456789";
+		ok &= Check(ZipIndex::Crc32((const uint8_t *)check, 9) == 0xCBF43926u &&
+						ZipIndex::Crc32((const uint8_t *)check + 4, 5, ZipIndex::Crc32((const uint8_t *)check, 4)) == 0xCBF43926u,
+					"CRC-32 matches the reference value, also when chained");
+
+		std::vector<uint8_t> lato = BuildNamedFont("Lato", 4096);
+		std::vector<uint8_t> mono = BuildNamedFont("Source Code Pro", 3000);
+		std::vector<ZipMember> members(6);
+		members[0].name = "fonts/";
+		members[1].name = "fonts/Lato.ttf";
+		members[1].data = lato;
+		members[1].localPadding = 9; // local extra field longer than the central one
+		members[2].name = "fonts/Mono.OTF";
+		members[2].data = mono;
+		members[2].method = ZipIndex::kDeflated;
+		members[3].name = "__MACOSX/fonts/._Lato.ttf";
+		members[3].data = {0, 5, 22, 7};
+		members[4].name = "readme.txt";
+		members[4].data = {'h', 'i'};
+		members[5].name = "locked.ttf";
+		members[5].data = mono;
+		members[5].flags = 0x0001;
+		std::vector<uint8_t> image = BuildZip(members, "font pack v1");
+		std::vector<ZipIndex::Entry> entries;
+		ZipIndex::Stats stats;
+		ok &= Check(ZipIndex::Read(image.data(), image.size(), entries, &stats) && entries.size() == 6, "every entry is indexed past an archive comment");
+		ok &= Check(stats.servable == 4 && stats.compressed == 1 && stats.encrypted == 1 && stats.invalid == 0, "stored, compressed and encrypted entries are counted");
+		ok &= Check(ServedBytes(image, entries[1], lato), "a stored entry's bytes start after the local header's own extra field");
+		ok &= Check(entries[0].IsDirectory() && !ZipIndex::IsServableFont(entries[0]) && ZipIndex::IsServableFont(entries[1]) &&
+						!ZipIndex::IsServableFont(entries[2]) && !ZipIndex::IsServableFont(entries[3]) && !ZipIndex::IsServableFont(entries[4]) &&
+						!ZipIndex::IsServableFont(entries[5]),
+					"only stored, unencrypted font files are servable (not folders, resource forks, deflated or encrypted ones)");
+
+		ZipIndex::Index index;
+		ok &= Check(index.Assign(image.data(), image.size()) && index.Find("fonts/Lato.ttf") == &index.Entries()[1] && !index.Find("fonts/lato.ttf"),
+					"lookup by stored name");
+
+		// Zip64: sizes and offsets in the extra field, directory found
+		// through the Zip64 end record.
+		std::vector<ZipMember> big(2);
+		big[0].name = "a.ttf";
+		big[0].data = lato;
+		big[0].zip64 = true;
+		big[1].name = "b.ttf";
+		big[1].data = mono;
+		big[1].zip64 = true;
+		image = BuildZip(big, std::string(), true);
+		ok &= Check(ZipIndex::Read(image.data(), image.size(), entries, &stats) && entries.size() == 2 && ServedBytes(image, entries[0], lato) &&
+						ServedBytes(image, entries[1], mono),
+					"Zip64 directories and extra fields");
+
+		// Names: the UTF-8 flag, unflagged UTF-8, Info-ZIP's Unicode path
+		// and a legacy code page name (Shift_JIS "フォント.ttf").
+		const std::string utf8Name = "\xE3\x83\x95\xE3\x82\xA9\xE3\x83\xB3\xE3\x83\x88.ttf";
+		const std::string sjisName = "\x83\x74\x83\x48\x83\x93\x83\x67.ttf";
+		std::vector<ZipMember> named(4);
+		named[0].name = utf8Name;
+		named[0].flags = 0x0800;
+		named[1].name = "ja/" + utf8Name;
+		named[2].name = sjisName;
+		named[2].unicodePath = "u/" + utf8Name;
+		named[3].name = sjisName;
+		for (auto &m : named)
+			m.data = lato;
+		image = BuildZip(named);
+		ok &= Check(ZipIndex::Read(image.data(), image.size(), entries) && entries.size() == 4, "named entries are indexed");
+		if (entries.size() == 4)
+		{
+			const std::wstring wide = L"フォント.ttf";
+			ok &= Check(FontScan::DecodeEntryName(entries[0]) == wide && FontScan::DecodeEntryName(entries[1]) == L"ja/" + wide,
+						"UTF-8 names decode with or without the flag");
+			ok &= Check(entries[2].utf8 && FontScan::DecodeEntryName(entries[2]) == L"u/" + wide, "the Unicode path extra field replaces the stored name");
+			std::wstring legacy = FontScan::DecodeEntryName(entries[3]);
+			ok &= Check(!ZipIndex::IsValidUtf8(entries[3].name) && legacy.size() == sjisName.size() && legacy[0] == 0x83 && ZipIndex::IsServableFont(entries[3]),
+						"code page names round-trip byte for byte and stay servable");
+		}
+		ok &= Check(!ZipIndex::IsValidUtf8("\xC0\xAF") && !ZipIndex::IsValidUtf8("\xE3\x83") && !ZipIndex::IsValidUtf8("\xF8\x88\x80\x80\x80") &&
+						ZipIndex::IsValidUtf8("plain.ttf") && ZipIndex::IsValidUtf8("\xF0\x9F\x98\x80"),
+					"overlong, truncated and 5-byte sequences are not UTF-8");
+
+		std::printf("zip: hostile images\n");
+		image = BuildZip(members, "comment");
+		{
+			size_t accepted = 0;
+			bool bounded = true;
+			for (size_t n = 0; n < image.size(); n++)
+			{
+				std::vector<uint8_t> prefix(image.begin(), image.begin() + n);
+				if (ZipIndex::Read(prefix.data(), prefix.size(), entries))
+					accepted++;
+			}
+			ok &= Check(accepted == 0, "no truncation of the image is read as an archive");
+
+			std::mt19937 rng(47);
+			size_t readable = 0, servedChecked = 0;
+			for (int round = 0; round < 20000; round++)
+			{
+				std::vector<uint8_t> bad = image;
+				int flips = 1 + (int)(rng() % 4);
+				for (int f = 0; f < flips; f++)
+					bad[rng() % bad.size()] = (uint8_t)rng();
+				if (!ZipIndex::Read(bad.data(), bad.size(), entries))
+					continue;
+				readable++;
+				for (const auto &e : entries)
+				{
+					if (!e.Servable())
+						continue;
+					servedChecked++;
+					if (e.dataOffset > bad.size() || e.size > bad.size() - e.dataOffset)
+						bounded = false;
+				}
+			}
+			ok &= Check(bounded, "servable ranges of corrupted images stay inside the image");
+			std::printf("  20000 corrupted images: %zu still indexed, %zu servable ranges checked\n", readable, servedChecked);
+		}
+		{
+			std::vector<uint8_t> bad = BuildZip(members);
+			size_t eocd = bad.size() - 22;
+			bad[eocd + 16] = 0xF0; // directory offset past the end
+			ok &= Check(!ZipIndex::Read(bad.data(), bad.size(), entries), "a directory outside the image is refused");
+			bad = BuildZip(members);
+			bad[eocd + 10] = 0xFF; // claims more records than the directory holds
+			bad[eocd + 11] = 0x7F;
+			ok &= Check(!ZipIndex::Read(bad.data(), bad.size(), entries), "an impossible record count is refused before reserving");
+			std::vector<ZipMember> lying(1);
+			lying[0].name = "lie.ttf";
+			lying[0].data = lato;
+			bad = BuildZip(lying);
+			// Point the central record's local header offset past the end.
+			size_t central = bad.size() - 22 - (46 + lying[0].name.size());
+			bad[central + 42] = 0xFF;
+			bad[central + 45] = 0x7F;
+			ok &= Check(ZipIndex::Read(bad.data(), bad.size(), entries, &stats) && entries.size() == 1 && !entries[0].Servable() && stats.invalid == 1,
+						"an entry whose local header is out of bounds is listed but not served");
+		}
+
+		std::printf("zip: packs in a font folder\n");
+		{
+			std::filesystem::path dir = std::filesystem::temp_directory_path() / "FontPreviewBench-zip";
+			std::error_code ec;
+			std::filesystem::remove_all(dir, ec);
+			std::filesystem::create_directories(dir, ec);
+			auto write = [&](const char *name, const std::vector<uint8_t> &bytes)
+			{
+				std::ofstream out(dir / name, std::ios::binary);
+				out.write((const char *)bytes.data(), (std::streamsize)bytes.size());
+			};
+			write("plain.ttf", mono);
+			write("pack.zip", BuildZip(members));
+			write("broken.zip", std::vector<uint8_t>(100, 0x50));
+			std::vector<FontScan::Face> faces;
+			FontScan::Stats scan;
+			bool listed = FontScan::ScanDirectory(dir, false, [&](const FontScan::Face &f)
+												  { faces.push_back(f); }, &scan);
+			ok &= Check(listed && faces.size() == 2 && scan.archives == 2 && scan.packedFonts == 1 && scan.compressedFonts == 1 && scan.unreadable == 1,
+						"stored pack fonts are listed beside plain files; deflated ones are counted and skipped");
+			if (faces.size() == 2)
+			{
+				const FontScan::Face &packed = faces[0];
+				std::wstring archive, entry;
+				ok &= Check(FontScan::SplitArchiveMemberPath(packed.filePath, archive, entry) && entry == L"fonts/Lato.ttf" &&
+								FontScan::DisplayName(packed.info.familyName, packed.fileName) == L"Lato [pack.zip/fonts/Lato.ttf]" &&
+								packed.contentHash == FontHash::Hash64(lato.data(), lato.size()) && !FontScan::IsArchiveMemberPath(faces[1].filePath),
+							"a packed face is named, addressed and hashed like the extracted file");
+			}
+			std::filesystem::remove_all(dir, ec);
+		}
+
+		std::printf("zip: %zu-entry pack\n", count);
+		{
+			std::vector<ZipMember> many(count);
+			std::vector<uint8_t> small = BuildNamedFont("Pack", 256);
+			for (size_t i = 0; i < count; i++)
+			{
+				many[i].name = "family" + std::to_string(i / 8) + "/style" + std::to_string(i % 8) + ".ttf";
+				many[i].data = small;
+			}
+			image = BuildZip(many);
+			const int rounds = 10;
+			auto t0 = Clock::now();
+			for (int r = 0; r < rounds; r++)
+				index.Assign(image.data(), image.size(), &stats);
+			double assignMs = ElapsedNs(t0, Clock::now()) / rounds / 1e6;
+			size_t found = 0;
+			double findNs = TimePerCall(count, [&](uint64_t n)
+										{
+				for (uint64_t i = 0; i < n; i++)
+					found += index.Find(many[(size_t)(i * 7919 % count)].name) != nullptr; });
+			std::printf("  index %.2f MB image: %.2f ms (%.0f ns/entry), lookup %.0f ns\n", image.size() / (1024.0 * 1024.0), assignMs,
+						assignMs * 1e6 / count, findNs);
+			ok &= Check(stats.servable == count && found == count, "every entry is servable and found by name");
+		}
+
+		std::printf("zip: serving a member, view vs extraction\n");
+		{
+			// What the plugin's loader does per font open: the view is a
+			// pointer into the mapped archive; extraction copies the member
+			// first. Both then read the whole font once (hashing).
+			std::vector<ZipMember> one(1);
+			one[0].name = "big.ttf";
+			one[0].data = BuildNamedFont("Big", 8 * 1024 * 1024);
+			image = BuildZip(one);
+			index.Assign(image.data(), image.size());
+			const ZipIndex::Entry &e = index.Entries()[0];
+			const int rounds = 20;
+			uint64_t sink = 0;
+			AllocCounter::Scope allocs;
+			auto t0 = Clock::now();
+			for (int r = 0; r < rounds; r++)
+			{
+				const uint8_t *view = image.data() + e.dataOffset;
+				sink += FontHash::Hash64(view, (size_t)e.size, (uint64_t)r);
+			}
+			double viewMs = ElapsedNs(t0, Clock::now()) / rounds / 1e6;
+			uint64_t viewAllocs = allocs.Allocations();
+			t0 = Clock::now();
+			for (int r = 0; r < rounds; r++)
+			{
+				std::vector<uint8_t> copy(image.begin() + (size_t)e.dataOffset, image.begin() + (size_t)(e.dataOffset + e.size));
+				sink += FontHash::Hash64(copy.data(), copy.size(), (uint64_t)r);
+			}
+			double copyMs = ElapsedNs(t0, Clock::now()) / rounds / 1e6;
+			std::printf("  8 MB member: view %.2f ms, extracted copy %.2f ms (%.1fx) [%llx]\n", viewMs, copyMs, viewMs > 0 ? copyMs / viewMs : 0.0,
+						(unsigned long long)(sink & 0xF));
+			ok &= Check(viewAllocs == 0, "serving from the view allocates nothing");
+		}
+		return ok ? 0 : 1;
+	}
+
+	//---------------------------------------------------------------------
+	//	woff: web font decoding and the decoded-font cache
+	//---------------------------------------------------------------------
+	// "glyph0 glyph37 glyph74 ..." (n words): the reference streams below
+	// are zlib's output for it.
+	std::string GlyphText(int n)
+	{
+		std::string s;
+		for (int i = 0; i < n; i++)
+			s += "glyph" + std::to_string(i * 37 % 1000) + " ";
+		return s;
+	}
+
+	// zlib.compress(GlyphText(120), 9): dynamic Huffman blocks.
+	const uint8_t kDynamicStream[] = {
+		0x78, 0xDA, 0x45, 0xD3, 0xBB, 0x71, 0x03, 0x41, 0x0C, 0x04, 0xD1, 0x54, 0x14, 0x02, 0xB0, 0xF8,
+		0x2C, 0x10, 0x11, 0x65, 0xC8, 0x90, 0xCB, 0xEC, 0x25, 0x15, 0xA7, 0x29, 0xEB, 0xD6, 0xEA, 0xBA,
+		0x57, 0x85, 0x79, 0x7C, 0x3D, 0xBF, 0x3F, 0xED, 0xE3, 0xF1, 0xF7, 0x89, 0xFB, 0xFA, 0xDE, 0x7C,
+		0x7D, 0xDD, 0x5D, 0x8F, 0x1C, 0x3D, 0xA6, 0x5E, 0x8F, 0x73, 0x8E, 0x1E, 0xB5, 0x7A, 0x6C, 0xAB,
+		0x12, 0x41, 0x4E, 0xDD, 0x34, 0x85, 0x33, 0x55, 0xCE, 0x51, 0xB9, 0x5C, 0xE5, 0x2A, 0x95, 0x6B,
+		0x55, 0xEE, 0xA3, 0x72, 0xB7, 0xCA, 0xD7, 0x82, 0x1F, 0x54, 0xF9, 0x5E, 0x95, 0xC7, 0x55, 0x9E,
+		0x52, 0x79, 0x46, 0xE5, 0x3D, 0x2A, 0x6F, 0xAB, 0xBC, 0xAB, 0x72, 0x10, 0x0E, 0xC0, 0x06, 0xF8,
+		0x02, 0x4E, 0xC0, 0x0E, 0x78, 0x00, 0x17, 0xE0, 0x43, 0x6E, 0x01, 0x37, 0xE0, 0x00, 0x6C, 0x80,
+		0x2F, 0xE0, 0x04, 0xEC, 0x80, 0x07, 0x70, 0x01, 0x3E, 0xFC, 0xE0, 0x02, 0x6E, 0xC0, 0x01, 0xD8,
+		0x00, 0x5F, 0xC0, 0x09, 0xD8, 0x01, 0xAB, 0x1C, 0x84, 0xD5, 0x75, 0x5B, 0xC0, 0x0D, 0x38, 0x00,
+		0x1B, 0xE0, 0x0B, 0x38, 0x01, 0x3B, 0xE0, 0x01, 0x5C, 0x80, 0x55, 0xCE, 0xBB, 0x80, 0x1B, 0x70,
+		0x00, 0x36, 0xC0, 0x17, 0x70, 0x02, 0x76, 0xC0, 0x03, 0xB8, 0x00, 0xAB, 0x3C, 0xB9, 0x80, 0x1B,
+		0x70, 0x00, 0x36, 0xC0, 0x2A, 0x07, 0x61, 0x2E, 0xD9, 0xB8, 0xE4, 0x2C, 0xC0, 0x5C, 0xB2, 0x73,
+		0xC9, 0xD5, 0x80, 0xB9, 0xE4, 0x60, 0x21, 0xCD, 0x25, 0x1B, 0x97, 0x9C, 0x0E, 0x98, 0x4B, 0x76,
+		0x2E, 0xB9, 0x54, 0xAE, 0xE1, 0x92, 0x4F, 0x03, 0xE6, 0x92, 0x8D, 0x4B, 0x7E, 0x8F, 0x8F, 0xF5,
+		0x0D, 0xEB, 0x1B, 0xD6, 0x37, 0xAC, 0x6F, 0x59, 0xDF, 0xB2, 0xBE, 0xFD, 0x5F, 0x1F, 0x61, 0xC0,
+		0x5C, 0x32, 0xDB, 0x73, 0xB6, 0x77, 0xD8, 0xDE, 0x61, 0x7B, 0x87, 0xED, 0xC5, 0x79, 0x2F, 0x84,
+		0x4B, 0xFE, 0xDD, 0xDE, 0x0F, 0xD4, 0xA8, 0x57, 0x6D,
+	};
+
+	// GlyphText(120)[:160] through zlib with Z_FIXED: fixed Huffman codes.
+	const uint8_t kFixedStream[] = {
+		0x78, 0x01, 0x4B, 0xCF, 0xA9, 0x2C, 0xC8, 0x30, 0x50, 0x48, 0x07, 0x51, 0xC6, 0xE6, 0x10, 0xDA,
+		0xDC, 0x04, 0x42, 0x1B, 0x1A, 0x1A, 0x42, 0x19, 0x26, 0x16, 0x50, 0x86, 0x85, 0x29, 0x84, 0x61,
+		0x64, 0x64, 0x04, 0x65, 0x98, 0x5A, 0x42, 0x19, 0x96, 0x66, 0x50, 0x53, 0x8C, 0x8D, 0x61, 0xC6,
+		0x41, 0xCD, 0x35, 0x31, 0x80, 0x1A, 0x6C, 0x62, 0x02, 0x35, 0xD9, 0xC4, 0x02, 0x6A, 0xB2, 0xA9,
+		0x21, 0xD4, 0x64, 0x53, 0x53, 0xA8, 0xC9, 0xA6, 0x96, 0x50, 0x93, 0xCD, 0x8C, 0x40, 0x26, 0x03,
+		0x00, 0x83, 0x09, 0x33, 0xCB,
+	};
+
+	// Deflate writer for test data: greedy LZ77 over the 32 KiB window
+	// with the fixed Huffman code, or stored blocks.
+	class DeflateWriter
+	{
+	public:
+		explicit DeflateWriter(std::vector<uint8_t> &out) : m_out(out) {}
+
+		void Bits(uint32_t v, int n)
+		{
+			m_buf |= (uint64_t)v << m_count;
+			m_count += n;
+			while (m_count >= 8)
+			{
+				m_out.push_back((uint8_t)m_buf);
+				m_buf >>= 8;
+				m_count -= 8;
+			}
+		}
+
+		// Huffman codes go most significant bit first.
+		void Code(uint32_t code, int len)
+		{
+			uint32_t reversed = 0;
+			for (int b = 0; b < len; b++)
+				reversed |= ((code >> b) & 1) << (len - 1 - b);
+			Bits(reversed, len);
+		}
+
+		void Literal(uint32_t sym)
+		{
+			if (sym < 144)
+				Code(0x30 + sym, 8);
+			else if (sym < 256)
+				Code(0x190 + sym - 144, 9);
+			else if (sym < 280)
+				Code(sym - 256, 7);
+			else
+				Code(0xC0 + sym - 280, 8);
+		}
+
+		void Match(size_t length, size_t distance)
+		{
+			static const uint16_t kLengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+			static const uint8_t kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+			static const uint16_t kDistBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+			static const uint8_t kDistExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+			int l = 28;
+			while (kLengthBase[l] > length)
+				l--;
+			Literal(257 + l);
+			Bits((uint32_t)(length - kLengthBase[l]), kLengthExtra[l]);
+			int d = 29;
+			while (kDistBase[d] > distance)
+				d--;
+			Code(d, 5);
+			Bits((uint32_t)(distance - kDistBase[d]), kDistExtra[d]);
+		}
+
+		void Fixed(const uint8_t *data, size_t size)
+		{
+			Bits(1, 1);
+			Bits(1, 2);
+			std::vector<int32_t> head(1 << 15, -1);
+			auto hash = [&](size_t i)
+			{ return ((data[i] << 10) ^ (data[i + 1] << 5) ^ data[i + 2]) & 0x7FFF; };
+			for (size_t i = 0; i < size;)
+			{
+				size_t best = 0, distance = 0;
+				if (i + 3 <= size)
+				{
+					int32_t cand = head[hash(i)];
+					head[hash(i)] = (int32_t)i;
+					if (cand >= 0 && i - (size_t)cand <= 32768)
+					{
+						size_t n = 0;
+						while (n < 258 && i + n < size && data[cand + n] == data[i + n])
+							n++;
+						if (n >= 3)
+						{
+							best = n;
+							distance = i - (size_t)cand;
+						}
+					}
+				}
+				if (best)
+				{
+					Match(best, distance);
+					i += best;
+				}
+				else
+					Literal(data[i++]);
+			}
+			Literal(256);
+			if (m_count)
+				Bits(0, 8 - m_count);
+		}
+
+		void Stored(const uint8_t *data, size_t size)
+		{
+			size_t pos = 0;
+			do
+			{
+				size_t n = std::min<size_t>(size - pos, 65535);
+				Bits(pos + n == size ? 1 : 0, 1);
+				Bits(0, 2);
+				if (m_count)
+					Bits(0, 8 - m_count);
+				Bits((uint32_t)n, 16);
+				Bits((uint32_t)(~n & 0xFFFF), 16);
+				m_out.insert(m_out.end(), data + pos, data + pos + n);
+				pos += n;
+			} while (pos < size);
+		}
+
+	private:
+		std::vector<uint8_t> &m_out;
+		uint64_t m_buf = 0;
+		int m_count = 0;
+	};
+
+	std::vector<uint8_t> Zlib(const uint8_t *data, size_t size, bool stored = false)
+	{
+		std::vector<uint8_t> out = {0x78, 0x01};
+		DeflateWriter writer(out);
+		if (stored)
+			writer.Stored(data, size);
+		else
+			writer.Fixed(data, size);
+		uint32_t adler = Woff::detail::Adler32(data, size);
+		PutU32(out, adler);
+		return out;
+	}
+
+	uint32_t TableChecksum(const uint8_t *p, size_t n)
+	{
+		uint32_t sum = 0;
+		for (size_t i = 0; i < n; i += 4)
+		{
+			uint32_t v = 0;
+			for (size_t k = 0; k < 4; k++)
+				v = (v << 8) | (i + k < n ? p[i + k] : 0);
+			sum += v;
+		}
+		return sum;
+	}
+
+	using SfntTable = std::pair<std::string, std::vector<uint8_t>>;
+
+	// An sfnt with the tables' data in the given order (the directory is
+	// sorted by tag), each padded to four bytes.
+	std::vector<uint8_t> BuildSfnt(const std::vector<SfntTable> &tables, uint32_t flavor = 0x00010000)
+	{
+		std::vector<size_t> byTag(tables.size());
+		for (size_t i = 0; i < tables.size(); i++)
+			byTag[i] = i;
+		std::sort(byTag.begin(), byTag.end(), [&](size_t a, size_t b)
+				  { return tables[a].first < tables[b].first; });
+		std::vector<uint32_t> offsets(tables.size());
+		uint32_t offset = 12 + 16 * (uint32_t)tables.size();
+		for (size_t i = 0; i < tables.size(); i++)
+		{
+			offsets[i] = offset;
+			offset += ((uint32_t)tables[i].second.size() + 3) & ~3u;
+		}
+		uint16_t selector = 0;
+		while ((2u << selector) <= tables.size())
+			selector++;
+		std::vector<uint8_t> b;
+		PutU32(b, flavor);
+		PutU16(b, (uint32_t)tables.size());
+		PutU16(b, 16u << selector);
+		PutU16(b, selector);
+		PutU16(b, 16 * (uint32_t)tables.size() - (16u << selector));
+		for (size_t i : byTag)
+		{
+			b.insert(b.end(), tables[i].first.begin(), tables[i].first.end());
+			PutU32(b, TableChecksum(tables[i].second.data(), tables[i].second.size()));
+			PutU32(b, offsets[i]);
+			PutU32(b, (uint32_t)tables[i].second.size());
+		}
+		for (const auto &t : tables)
+		{
+			b.insert(b.end(), t.second.begin(), t.second.end());
+			b.resize((b.size() + 3) & ~(size_t)3, 0);
+		}
+		return b;
+	}
+
+	// Wrap an sfnt (as BuildSfnt lays it out) in WOFF, compressing each
+	// table unless that does not make it smaller, as the spec asks.
+	std::vector<uint8_t> BuildWoff(const std::vector<uint8_t> &sfnt, bool stored = false)
+	{
+		uint16_t count = SfntReader::detail::U16(&sfnt[4]);
+		struct Rec
+		{
+			uint32_t tag, checksum, offset, length;
+		};
+		std::vector<Rec> recs(count);
+		for (uint16_t i = 0; i < count; i++)
+		{
+			const uint8_t *r = &sfnt[12 + 16 * i];
+			recs[i] = {SfntReader::detail::U32(r), SfntReader::detail::U32(r + 4), SfntReader::detail::U32(r + 8), SfntReader::detail::U32(r + 12)};
+		}
+		std::vector<size_t> byOffset(count);
+		for (size_t i = 0; i < count; i++)
+			byOffset[i] = i;
+		std::sort(byOffset.begin(), byOffset.end(), [&](size_t a, size_t b)
+				  { return recs[a].offset < recs[b].offset; });
+		std::vector<uint8_t> data;
+		std::vector<std::pair<uint32_t, uint32_t>> placed(count); // offset, compLength
+		uint32_t base = 44 + 20 * (uint32_t)count;
+		for (size_t i : byOffset)
+		{
+			const uint8_t *p = &sfnt[recs[i].offset];
+			std::vector<uint8_t> z = Zlib(p, recs[i].length, stored);
+			placed[i].first = base + (uint32_t)data.size();
+			if (z.size() < recs[i].length)
+			{
+				placed[i].second = (uint32_t)z.size();
+				data.insert(data.end(), z.begin(), z.end());
+			}
+			else
+			{
+				placed[i].second = recs[i].length;
+				data.insert(data.end(), p, p + recs[i].length);
+			}
+			data.resize((data.size() + 3) & ~(size_t)3, 0);
+		}
+		std::vector<uint8_t> b;
+		PutU32(b, Woff::kWoffSignature);
+		PutU32(b, SfntReader::detail::U32(&sfnt[0]));
+		PutU32(b, base + (uint32_t)data.size());
+		PutU16(b, count);
+		PutU16(b, 0);
+		PutU32(b, (uint32_t)sfnt.size());
+		PutU16(b, 1);
+		PutU16(b, 0);
+		for (int i = 0; i < 5; i++)
+			PutU32(b, 0);
+		for (size_t i = 0; i < count; i++)
+		{
+			PutU32(b, recs[i].tag);
+			PutU32(b, placed[i].first);
+			PutU32(b, placed[i].second);
+			PutU32(b, recs[i].length);
+			PutU32(b, recs[i].checksum);
+		}
+		b.insert(b.end(), data.begin(), data.end());
+		return b;
+	}
+
+	// A font-shaped sfnt of about `glyfBytes`: a compressible glyf, a
+	// random (incompressible) table, head and name; data order differs
+	// from tag order.
+	std::vector<uint8_t> BuildWebFontSfnt(size_t glyfBytes, uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		std::vector<uint8_t> glyf;
+		std::string words = GlyphText(400);
+		while (glyf.size() < glyfBytes)
+		{
+			if (rng() % 4 == 0)
+				glyf.push_back((uint8_t)rng());
+			else
+				glyf.insert(glyf.end(), words.begin() + rng() % 200, words.begin() + 200 + rng() % 200);
+		}
+		glyf.resize(glyfBytes);
+		std::vector<uint8_t> noise(3001);
+		for (auto &b : noise)
+			b = (uint8_t)rng();
+		std::vector<uint8_t> head(54, 0);
+		head[12] = 0x5F;
+		head[13] = 0x0F;
+		head[14] = 0x3C;
+		head[15] = 0xF5;
+		return BuildSfnt({{"glyf", glyf}, {"head", head}, {"name", BuildNameTable("Web Sans")}, {"DSIG", noise}});
+	}
+
+	// Decode into a sink that compares each piece with `expected` as it
+	// arrives, the way the cache writer streams to disk.
+	bool DecodeStreaming(const std::vector<uint8_t> &woff, const std::vector<uint8_t> &expected, std::vector<uint8_t> &scratch)
+	{
+		size_t at = 0;
+		return Woff::Decode(
+				   woff.data(), woff.size(), [&](const uint8_t *p, size_t n)
+				   {
+				if (n > expected.size() - at || std::memcmp(p, expected.data() + at, n) != 0)
+					return false;
+				at += n;
+				return true; },
+				   scratch) &&
+			   at == expected.size();
+	}
+
+	int RunWoffBenchmark(int argc, char **argv)
+	{
+		bool ok = true;
+		std::printf("woff: inflate conformance\n");
+		const std::string text = GlyphText(120);
+		std::vector<uint8_t> out(text.size());
+		ok &= Check(Woff::Uncompress(kDynamicStream, sizeof(kDynamicStream), out.data(), out.size()) && std::equal(out.begin(), out.end(), text.begin()),
+					"zlib's dynamic Huffman stream");
+		out.resize(160);
+		ok &= Check(Woff::Uncompress(kFixedStream, sizeof(kFixedStream), out.data(), out.size()) && std::equal(out.begin(), out.end(), text.begin()),
+					"zlib's fixed Huffman stream");
+		{
+			bool roundTrips = true;
+			std::mt19937 rng(48);
+			for (size_t size : {0, 1, 2, 3, 258, 4096, 65535, 65536, 200000})
+			{
+				std::vector<uint8_t> data(size);
+				for (size_t i = 0; i < size; i++)
+					data[i] = i % 3 ? (uint8_t)text[i % text.size()] : (uint8_t)(rng() % 8);
+				for (bool stored : {false, true})
+				{
+					std::vector<uint8_t> z = Zlib(data.data(), data.size(), stored);
+					std::vector<uint8_t> back(size + 1);
+					roundTrips &= Woff::Uncompress(z.data(), z.size(), back.data(), size) && std::equal(data.begin(), data.end(), back.begin());
+					// A stream must fill the output exactly.
+					roundTrips &= !Woff::Uncompress(z.data(), z.size(), back.data(), size + 1);
+					if (size)
+						roundTrips &= !Woff::Uncompress(z.data(), z.size(), back.data(), size - 1);
+				}
+			}
+			ok &= Check(roundTrips, "stored and fixed blocks round-trip at block and window boundaries; sizes must match exactly");
+		}
+		{
+			out.resize(text.size());
+			size_t accepted = 0;
+			for (size_t n = 0; n < sizeof(kDynamicStream); n++)
+				accepted += Woff::Uncompress(kDynamicStream, n, out.data(), out.size());
+			std::vector<uint8_t> bad(std::begin(kDynamicStream), std::end(kDynamicStream));
+			bad.back() ^= 1;
+			ok &= Check(accepted == 0 && !Woff::Uncompress(bad.data(), bad.size(), out.data(), out.size()), "truncated streams and bad checksums are refused");
+
+			// Flips in the padding after the last block change nothing;
+			// any other accepted corruption would be a wrong decode.
+			std::mt19937 rng(4848);
+			size_t accepted2 = 0, wrong = 0;
+			for (int round = 0; round < 50000; round++)
+			{
+				bad.assign(std::begin(kDynamicStream), std::end(kDynamicStream));
+				int flips = 1 + (int)(rng() % 3);
+				for (int f = 0; f < flips; f++)
+					bad[2 + rng() % (bad.size() - 2)] ^= (uint8_t)(1 + rng() % 255);
+				if (Woff::Uncompress(bad.data(), bad.size(), out.data(), out.size()))
+				{
+					accepted2++;
+					wrong += !std::equal(out.begin(), out.end(), text.begin());
+				}
+			}
+			ok &= Check(wrong == 0, "corrupted streams decode within bounds and fail the checksum");
+			std::printf("  50000 corrupted streams: %zu accepted, all with the original output\n", accepted2);
+
+			// A match before the start of the output (fixed block: length 3,
+			// distance 1, as the first symbol).
+			std::vector<uint8_t> raw;
+			DeflateWriter w(raw);
+			w.Bits(1, 1);
+			w.Bits(1, 2);
+			w.Match(3, 1);
+			w.Literal(256);
+			w.Bits(0, 8);
+			Woff::detail::Inflater early(raw.data(), raw.size(), out.data(), 3);
+			// An over-subscribed code length code (every length 1).
+			std::vector<uint8_t> over;
+			DeflateWriter o(over);
+			o.Bits(1, 1);
+			o.Bits(2, 2);
+			o.Bits(0, 5);
+			o.Bits(0, 5);
+			o.Bits(15, 4);
+			for (int i = 0; i < 19; i++)
+				o.Bits(1, 3);
+			o.Bits(0, 16);
+			Woff::detail::Inflater oversubscribed(over.data(), over.size(), out.data(), out.size());
+			ok &= Check(!early.Run() && !oversubscribed.Run(), "distances before the output and over-subscribed codes are refused");
+		}
+
+		std::printf("woff: WOFF 1.0 container\n");
+		std::vector<uint8_t> sfnt = BuildWebFontSfnt(300000, 1);
+		std::vector<uint8_t> woff = BuildWoff(sfnt);
+		std::vector<uint8_t> decoded;
+		Woff::Header header;
+		ok &= Check(Woff::Detect(woff.data(), woff.size()) == Woff::Container::Woff && Woff::Detect(sfnt.data(), sfnt.size()) == Woff::Container::Sfnt &&
+						Woff::ReadHeader(woff.data(), woff.size(), header) && header.SfntSize() == sfnt.size() && header.totalSfntSize == sfnt.size(),
+					"container detection and the table directory");
+		ok &= Check(Woff::DecodeToBuffer(woff.data(), woff.size(), decoded) && decoded == sfnt, "decoding restores the sfnt byte for byte (table order kept)");
+		{
+			std::vector<SfntReader::FaceInfo> faces;
+			ok &= Check(SfntReader::ReadFaces(decoded.data(), decoded.size(), faces) && faces.size() == 1 && faces[0].familyName == L"Web Sans",
+						"the decoded font reads like any other");
+			std::vector<uint8_t> storedWoff = BuildWoff(sfnt, true);
+			ok &= Check(Woff::DecodeToBuffer(storedWoff.data(), storedWoff.size(), decoded) && decoded == sfnt, "tables in stored deflate blocks");
+		}
+		{
+			std::vector<uint8_t> scratch;
+			ok &= Check(DecodeStreaming(woff, sfnt, scratch) && scratch.capacity() < sfnt.size(), "streaming decode holds one table at a time");
+			std::printf("  %zu-byte font: scratch %zu bytes, largest table %u\n", sfnt.size(), scratch.capacity(), header.MaxTableLength());
+		}
+		{
+			size_t accepted = 0;
+			for (size_t n = 0; n < woff.size(); n += 97)
+			{
+				std::vector<uint8_t> prefix(woff.begin(), woff.begin() + n);
+				accepted += Woff::DecodeToBuffer(prefix.data(), prefix.size(), decoded);
+			}
+			std::vector<uint8_t> bomb = woff;
+			// First directory entry: claim a 1 GiB table.
+			bomb[44 + 12] = 0x40;
+			std::vector<uint8_t> inverted = woff;
+			inverted[44 + 8] = 0x7F; // compLength larger than the file
+			ok &= Check(accepted == 0 && !Woff::ReadHeader(bomb.data(), bomb.size(), header) && !Woff::ReadHeader(inverted.data(), inverted.size(), header),
+						"truncated files, oversized tables and out-of-file ranges are refused");
+			// Stored tables carry no check a decoder could apply; compressed
+			// ones have the zlib checksum.
+			Woff::ReadHeader(woff.data(), woff.size(), header);
+			const Woff::Table *glyf = nullptr;
+			for (const auto &table : header.tables)
+				glyf = table.tag == SfntReader::detail::Tag("glyf") ? &table : glyf;
+			std::mt19937 rng(480);
+			size_t survived = 0;
+			for (int round = 0; glyf && round < 2000; round++)
+			{
+				std::vector<uint8_t> bad = woff;
+				bad[glyf->offset + 2 + rng() % (glyf->compLength - 2)] ^= (uint8_t)(1 + rng() % 255);
+				if (Woff::DecodeToBuffer(bad.data(), bad.size(), decoded) && decoded != sfnt)
+					survived++;
+			}
+			ok &= Check(glyf && glyf->compLength < glyf->origLength && survived == 0, "corrupted compressed tables never decode to a different font");
+		}
+
+		std::printf("woff: WOFF2 header\n");
+		{
+			auto base128 = [](std::vector<uint8_t> &b, uint32_t v)
+			{
+				uint8_t tmp[5];
+				int n = 0;
+				do
+				{
+					tmp[n++] = (uint8_t)(v & 0x7F);
+					v >>= 7;
+				} while (v);
+				while (n--)
+					b.push_back((uint8_t)(tmp[n] | (n ? 0x80 : 0)));
+			};
+			auto build = [&](uint8_t glyfFlags, const std::vector<uint8_t> &lengthBytes)
+			{
+				std::vector<uint8_t> b;
+				PutU32(b, Woff::kWoff2Signature);
+				PutU32(b, 0x00010000);
+				PutU32(b, 0);
+				PutU16(b, 3);
+				PutU16(b, 0);
+				PutU32(b, 4000);
+				PutU32(b, 16);
+				while (b.size() < 48)
+					b.push_back(0);
+				b.push_back(glyfFlags); // glyf
+				b.insert(b.end(), lengthBytes.begin(), lengthBytes.end());
+				if ((glyfFlags >> 6) == 0)
+					base128(b, 1200);
+				b.push_back(11); // loca, transformed (version 0)
+				base128(b, 400);
+				base128(b, 0);
+				b.push_back(0x3F); // explicit tag
+				b.insert(b.end(), {'Z', 'Z', 'Z', 'Z'});
+				base128(b, 0xFFFFFFFFu);
+				b.resize(b.size() + 16, 0);
+				uint32_t size = (uint32_t)b.size();
+				b[8] = (uint8_t)(size >> 24);
+				b[9] = (uint8_t)(size >> 16);
+				b[10] = (uint8_t)(size >> 8);
+				b[11] = (uint8_t)size;
+				return b;
+			};
+			std::vector<uint8_t> len;
+			base128(len, 3000);
+			Woff::Woff2Info info;
+			std::vector<uint8_t> w2 = build(10, len);
+			ok &= Check(Woff::Detect(w2.data(), w2.size()) == Woff::Container::Woff2 && Woff::ReadWoff2Header(w2.data(), w2.size(), info) &&
+							info.numTables == 3 && info.transformedGlyf && info.totalSfntSize == 4000,
+						"table directory with known, explicit and transformed tables");
+			w2 = build(10 | 0xC0, len);
+			ok &= Check(Woff::ReadWoff2Header(w2.data(), w2.size(), info) && !info.transformedGlyf, "glyf version 3 is not transformed");
+			w2 = build(10, {0x80, 0x81, 0x00});
+			std::vector<uint8_t> w2b = build(10, {0x90, 0x80, 0x80, 0x80, 0x00});
+			std::vector<uint8_t> w2c = build(10, len);
+			w2c[11] ^= 1;
+			ok &= Check(!Woff::ReadWoff2Header(w2.data(), w2.size(), info) && !Woff::ReadWoff2Header(w2b.data(), w2b.size(), info) &&
+							!Woff::ReadWoff2Header(w2c.data(), w2c.size(), info),
+						"leading zeros, 32-bit overflow and a wrong length field are refused");
+		}
+
+		std::printf("woff: decoded-font cache\n");
+		{
+			std::filesystem::path dir = std::filesystem::temp_directory_path() / "FontPreviewBench-woff";
+			std::error_code ec;
+			std::filesystem::remove_all(dir, ec);
+			Woff::DecodedCache cache(dir);
+			uint64_t hash = FontHash::Hash64(woff.data(), woff.size());
+			ok &= Check(Woff::DecodedCache::FileName(0x1234, Woff::kFlavorCff) == "0000000000001234.otf" && !cache.Contains(hash, 0x00010000),
+						"entries are named by content hash and flavor");
+			std::atomic<int> stored{0};
+			std::vector<std::thread> writers;
+			for (int t = 0; t < 8; t++)
+			{
+				writers.emplace_back([&, t]
+									 {
+					std::vector<uint8_t> scratch;
+					if (cache.Store(hash, 0x00010000, std::to_string(t), [&](auto &&write)
+									{ return Woff::Decode(woff.data(), woff.size(), write, scratch); }))
+						stored++; });
+			}
+			for (auto &w : writers)
+				w.join();
+			std::ifstream in(cache.PathFor(hash, 0x00010000), std::ios::binary);
+			std::vector<uint8_t> onDisk((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+			in.close();
+			size_t files = 0;
+			for (std::filesystem::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+				files++;
+			ok &= Check(stored == 8 && onDisk == sfnt && files == 1, "concurrent writers of one entry leave one complete file");
+			std::vector<uint8_t> truncated(woff.begin(), woff.begin() + woff.size() / 2);
+			std::vector<uint8_t> scratch;
+			ok &= Check(!cache.Store(7, 0x00010000, "x", [&](auto &&write)
+									 { return Woff::Decode(truncated.data(), truncated.size(), write, scratch); }) &&
+							!cache.Contains(7, 0x00010000),
+						"a failed decode leaves no entry");
+			cache.Store(8, Woff::kFlavorCff, "x", [&](auto &&write)
+						{ return write(sfnt.data(), 16); });
+			ok &= Check(cache.Prune({Woff::DecodedCache::FileName(hash, 0x00010000)}) == 1 && cache.Contains(hash, 0x00010000) && !cache.Contains(8, Woff::kFlavorCff),
+						"pruning keeps only live entries");
+			std::filesystem::remove_all(dir, ec);
+		}
+
+		std::printf("woff: throughput\n");
+		{
+			std::vector<uint8_t> data(16 * 1024 * 1024);
+			std::string words = GlyphText(2000);
+			std::mt19937 rng(7);
+			for (size_t i = 0; i < data.size(); i++)
+				data[i] = rng() % 5 ? (uint8_t)words[(i * 7 + (i >> 12)) % words.size()] : (uint8_t)rng();
+			std::vector<uint8_t> z = Zlib(data.data(), data.size());
+			std::vector<uint8_t> back(data.size());
+			const int rounds = 5;
+			auto t0 = Clock::now();
+			bool same = true;
+			for (int r = 0; r < rounds; r++)
+				same &= Woff::Uncompress(z.data(), z.size(), back.data(), back.size());
+			double ms = ElapsedNs(t0, Clock::now()) / rounds / 1e6;
+			std::printf("  inflate 16 MB (fixed codes, ratio %.2f): %.1f ms, %.0f MB/s\n", (double)z.size() / data.size(), ms, 16.0 / (ms / 1000.0));
+			ok &= Check(same && back == data, "large stream round-trips");
+
+			// A folder of web fonts, decoded the way the plugin does it: one
+			// streaming decode per worker, output hashed instead of written.
+			const int fontCount = 48;
+			std::vector<std::vector<uint8_t>> fonts(fontCount);
+			std::vector<std::vector<uint8_t>> expected(fontCount);
+			size_t totalOut = 0;
+			for (int i = 0; i < fontCount; i++)
+			{
+				expected[i] = BuildWebFontSfnt(1024 * 1024 + (size_t)i * 4099, (uint32_t)i);
+				totalOut += expected[i].size();
+				fonts[i] = BuildWoff(expected[i]);
+			}
+			for (unsigned workers : {1u, 4u})
+			{
+				std::atomic<size_t> next{0};
+				std::atomic<int> good{0};
+				std::atomic<size_t> peakScratch{0};
+				auto worker = [&]
+				{
+					std::vector<uint8_t> scratch;
+					for (size_t i; (i = next.fetch_add(1)) < fonts.size();)
+					{
+						if (DecodeStreaming(fonts[i], expected[i], scratch))
+							good++;
+					}
+					size_t cap = scratch.capacity(), prev = peakScratch.load();
+					while (cap > prev && !peakScratch.compare_exchange_weak(prev, cap))
+						;
+				};
+				auto w0 = Clock::now();
+				std::vector<std::thread> threads;
+				for (unsigned w = 1; w < workers; w++)
+					threads.emplace_back(worker);
+				worker();
+				for (auto &t : threads)
+					t.join();
+				double wallMs = ElapsedNs(w0, Clock::now()) / 1e6;
+				std::printf("  %d fonts (%.1f MB decoded), %u worker(s): %.1f ms, %.0f MB/s, scratch <= %.1f MB per worker (%u hardware threads)\n", fontCount,
+							totalOut / (1024.0 * 1024.0), workers, wallMs, totalOut / (1024.0 * 1024.0) / (wallMs / 1000.0),
+							peakScratch.load() / (1024.0 * 1024.0), std::thread::hardware_concurrency());
+				ok &= Check(good == fontCount, "every font decodes to its sfnt");
+			}
+		}
+
+		// Real web fonts, when a folder is given.
+		if (argc > 0)
+		{
+			std::printf("woff: %s\n", argv[0]);
+			std::error_code ec;
+			std::vector<std::filesystem::path> files;
+			for (std::filesystem::recursive_directory_iterator it(argv[0], ec), end; !ec && it != end; it.increment(ec))
+			{
+				if (FontScan::IsWebFontFile(it->path()))
+					files.push_back(it->path());
+			}
+			std::sort(files.begin(), files.end());
+			size_t woffOk = 0, woffCount = 0, woff2Ok = 0, woff2Count = 0, outBytes = 0;
+			double decodeNs = 0.0;
+			for (const auto &path : files)
+			{
+				std::ifstream in(path, std::ios::binary);
+				std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+				Woff::Container container = Woff::Detect(bytes.data(), bytes.size());
+				if (container == Woff::Container::Woff2)
+				{
+					Woff::Woff2Info info;
+					woff2Count++;
+					woff2Ok += Woff::ReadWoff2Header(bytes.data(), bytes.size(), info);
+					continue;
+				}
+				woffCount++;
+				auto t0 = Clock::now();
+				bool decodedOk = Woff::DecodeToBuffer(bytes.data(), bytes.size(), decoded);
+				decodeNs += ElapsedNs(t0, Clock::now());
+				std::vector<SfntReader::FaceInfo> faces;
+				// Table checksums (head's covers the whole font) must match
+				// the directory's.
+				bool sums = decodedOk && SfntReader::ReadFaces(decoded.data(), decoded.size(), faces);
+				for (uint16_t i = 0; sums && i < SfntReader::detail::U16(&decoded[4]); i++)
+				{
+					const uint8_t *rec = &decoded[12 + 16 * i];
+					uint32_t tag = SfntReader::detail::U32(rec);
+					if (tag != SfntReader::detail::Tag("head"))
+						sums = TableChecksum(&decoded[SfntReader::detail::U32(rec + 8)], SfntReader::detail::U32(rec + 12)) == SfntReader::detail::U32(rec + 4);
+				}
+				woffOk += sums;
+				outBytes += decoded.size();
+				if (!sums)
+					std::printf("  [FAIL] %s\n", path.string().c_str());
+			}
+			std::printf("  %zu/%zu WOFF decoded (%.1f MB, %.0f MB/s), %zu/%zu WOFF2 headers valid\n", woffOk, woffCount, outBytes / (1024.0 * 1024.0),
+						decodeNs > 0 ? outBytes / (1024.0 * 1024.0) / (decodeNs / 1e9) : 0.0, woff2Ok, woff2Count);
+			ok &= Check(woffOk == woffCount && woff2Ok == woff2Count, "every web font in the folder is readable");
+		}
+		return ok ? 0 : 1;
+	}
+
+	//---------------------------------------------------------------------
+	//	catalog: eager against lazy axis resolution (SfntReader.h / FontScan.h)
+	//---------------------------------------------------------------------
+	struct BenchAxis
+	{
+		const char *tag;
+		float minValue, defaultValue, maxValue;
+	};
+
+	// An fvar table with the given axes and `instances` named instances at
+	// the default coordinates.
+	std::vector<uint8_t> BuildFvar(const std::vector<BenchAxis> &axes, uint16_t instances)
+	{
+		auto fixed = [](float v)
+		{ return (uint32_t)(int32_t)(v * 65536.0f); };
+		std::vector<uint8_t> b;
+		PutU16(b, 1);
+		PutU16(b, 0);
+		PutU16(b, 16);
+		PutU16(b, 2);
+		PutU16(b, (uint32_t)axes.size());
+		PutU16(b, 20);
+		PutU16(b, instances);
+		PutU16(b, 4 + 4 * (uint32_t)axes.size());
+		for (const BenchAxis &axis : axes)
+		{
+			b.insert(b.end(), axis.tag, axis.tag + 4);
+			PutU32(b, fixed(axis.minValue));
+			PutU32(b, fixed(axis.defaultValue));
+			PutU32(b, fixed(axis.maxValue));
+			PutU16(b, 0);
+			PutU16(b, 256);
+		}
+		for (uint16_t i = 0; i < instances; i++)
+		{
+			PutU16(b, 257 + i);
+			PutU16(b, 0);
+			for (const BenchAxis &axis : axes)
+				PutU32(b, fixed(axis.defaultValue));
+		}
+		return b;
+	}
+
+	// A TTC of sfnt images as BuildSfnt lays them out; table offsets are
+	// moved to the face's place in the collection.
+	std::vector<uint8_t> BuildCollection(const std::vector<std::vector<uint8_t>> &faces)
+	{
+		std::vector<uint8_t> b;
+		b.insert(b.end(), {'t', 't', 'c', 'f'});
+		PutU32(b, 0x00010000);
+		PutU32(b, (uint32_t)faces.size());
+		size_t directory = b.size();
+		b.resize(b.size() + 4 * faces.size());
+		for (size_t f = 0; f < faces.size(); f++)
+		{
+			uint32_t base = (uint32_t)b.size();
+			const uint8_t offset[4] = {(uint8_t)(base >> 24), (uint8_t)(base >> 16), (uint8_t)(base >> 8), (uint8_t)base};
+			std::copy(offset, offset + 4, b.begin() + directory + 4 * f);
+			b.insert(b.end(), faces[f].begin(), faces[f].end());
+			uint16_t tables = SfntReader::detail::U16(&b[base + 4]);
+			for (uint16_t t = 0; t < tables; t++)
+			{
+				uint8_t *rec = &b[base + 12 + 16 * (size_t)t + 8];
+				uint32_t moved = SfntReader::detail::U32(rec) + base;
+				rec[0] = (uint8_t)(moved >> 24);
+				rec[1] = (uint8_t)(moved >> 16);
+				rec[2] = (uint8_t)(moved >> 8);
+				rec[3] = (uint8_t)moved;
+			}
+		}
+		return b;
+	}
+
+	// `count` font files: every third face variable (wght, plus wdth on
+	// every sixth), every tenth file a two-face collection. Returns the
+	// number of variable faces written.
+	size_t WriteSyntheticCorpus(const std::filesystem::path &dir, size_t count)
+	{
+		size_t variable = 0;
+		auto face = [&](size_t i)
+		{
+			std::vector<SfntTable> tables = {{"name", BuildNameTable("Synth " + std::to_string(i))}};
+			if (i % 3 == 0)
+			{
+				std::vector<BenchAxis> axes = {{"wght", 100.0f, 400.0f, 900.0f}};
+				if (i % 6 == 0)
+					axes.push_back({"wdth", 75.0f, 100.0f, 125.0f});
+				tables.push_back({"fvar", BuildFvar(axes, 9)});
+				variable++;
+			}
+			// Some bulk, so the scan reads something like a real font.
+			tables.push_back({"glyf", std::vector<uint8_t>(4096 + (i % 7) * 1024, (uint8_t)i)});
+			return BuildSfnt(tables);
+		};
+		for (size_t i = 0; i < count; i++)
+		{
+			char name[32];
+			std::snprintf(name, sizeof(name), "font%05zu.%s", i, i % 10 == 9 ? "ttc" : "ttf");
+			std::vector<uint8_t> bytes = i % 10 == 9 ? BuildCollection({face(i), face(i + count)}) : face(i);
+			std::ofstream out(dir / name, std::ios::binary);
+			out.write((const char *)bytes.data(), (std::streamsize)bytes.size());
+		}
+		return variable;
+	}
+
+	bool SameAxes(const std::vector<SfntReader::Axis> &a, const std::vector<SfntReader::Axis> &b)
+	{
+		if (a.size() != b.size())
+			return false;
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			if (a[i].tag != b[i].tag || a[i].minValue != b[i].minValue || a[i].defaultValue != b[i].defaultValue || a[i].maxValue != b[i].maxValue)
+				return false;
+		}
+		return true;
+	}
+
+	int RunCatalogBenchmark(int argc, char **argv)
+	{
+		std::string source = argc > 0 ? argv[0] : std::string();
+		bool synthetic = source.empty() || std::isdigit((unsigned char)source[0]);
+		size_t fontCount = synthetic && !source.empty() ? (size_t)std::strtoul(source.c_str(), nullptr, 10) : 0;
+		if (fontCount == 0)
+			fontCount = 2000;
+		size_t requests = argc > 1 ? (size_t)std::strtoul(argv[1], nullptr, 10) : 0;
+		if (requests == 0)
+			requests = 40;
+		bool ok = true;
+
+		std::filesystem::path dir = synthetic ? std::filesystem::temp_directory_path() / "FontPreviewBench-catalog" : std::filesystem::path(source);
+		std::error_code ec;
+		size_t variableWritten = 0;
+		if (synthetic)
+		{
+			std::filesystem::remove_all(dir, ec);
+			std::filesystem::create_directories(dir, ec);
+			variableWritten = WriteSyntheticCorpus(dir, fontCount);
+		}
+
+		// Best of three, after a scan that warms the file cache.
+		auto scan = [&](bool readAxes, std::vector<FontScan::Face> &faces, FontScan::Stats &stats)
+		{
+			double best = 0.0;
+			for (int round = 0; round < 4; round++)
+			{
+				faces.clear();
+				stats = FontScan::Stats();
+				auto t0 = Clock::now();
+				bool listed = FontScan::ScanDirectory(dir, true, [&](const FontScan::Face &f)
+													  { faces.push_back(f); }, &stats, readAxes);
+				double ms = ElapsedNs(t0, Clock::now()) / 1e6;
+				if (!listed)
+					return -1.0;
+				if (round == 1 || (round > 1 && ms < best))
+					best = ms;
+			}
+			return best;
+		};
+		std::vector<FontScan::Face> eager, lazy;
+		FontScan::Stats eagerStats, lazyStats;
+		double eagerMs = scan(true, eager, eagerStats);
+		double lazyMs = scan(false, lazy, lazyStats);
+		if (eagerMs < 0.0 || lazyMs < 0.0)
+		{
+			std::fprintf(stderr, "catalog: cannot list %s\n", dir.string().c_str());
+			return 1;
+		}
+
+		std::printf("catalog: %s (%zu files, %zu faces)\n", synthetic ? "synthetic corpus" : dir.string().c_str(), eagerStats.files, eagerStats.faces);
+		std::printf("  eager: %8.2f ms  faces opened for axes %zu  fvar tables read %zu\n", eagerMs, eagerStats.faces, eagerStats.fvarTables);
+		std::printf("  lazy : %8.2f ms  faces opened for axes 0  fvar tables read %zu\n", lazyMs, lazyStats.fvarTables);
+		bool sameList = eager.size() == lazy.size();
+		for (size_t i = 0; sameList && i < eager.size(); i++)
+			sameList = eager[i].filePath == lazy[i].filePath && eager[i].info.faceIndex == lazy[i].info.faceIndex &&
+					   eager[i].info.familyName == lazy[i].info.familyName && eager[i].contentHash == lazy[i].contentHash;
+		ok &= Check(sameList, "both modes list the same faces in the same order");
+		ok &= Check(lazyStats.fvarTables == 0, "the lazy scan reads no fvar table");
+		if (synthetic)
+			ok &= Check(eager.size() == fontCount + fontCount / 10 && eagerStats.fvarTables == variableWritten, "the eager scan reads every variable face's fvar");
+
+		// What the plugin asks for after startup: the selection and the
+		// visible rows, then the same rows again while scrolling back.
+		// Each face is opened once; repeats come from the memo.
+		std::printf("catalog: lazy resolution of %zu requested faces\n", requests);
+		{
+			std::vector<char> resolved(lazy.size(), 0);
+			size_t opened = 0, fvarRead = 0, repeats = 0, mismatched = 0;
+			std::vector<size_t> order;
+			for (size_t i = 0; i < requests && i < lazy.size(); i++)
+				order.push_back(i);
+			for (size_t i = order.size(); i-- > 0;)
+				order.push_back(i);
+			auto t0 = Clock::now();
+			for (size_t i : order)
+			{
+				if (resolved[i])
+				{
+					repeats++;
+					continue;
+				}
+				resolved[i] = 1;
+				opened++;
+				if (!FontScan::ReadFaceAxes(lazy[i].filePath, lazy[i].info.faceIndex, lazy[i].info))
+					continue;
+				if (!lazy[i].info.axes.empty())
+					fvarRead++;
+			}
+			double resolveMs = ElapsedNs(t0, Clock::now()) / 1e6;
+			size_t expectedFvar = 0;
+			for (size_t i = 0; i < lazy.size(); i++)
+			{
+				if (!resolved[i])
+				{
+					mismatched += lazy[i].info.axes.empty() ? 0 : 1;
+					continue;
+				}
+				expectedFvar += eager[i].info.axes.empty() ? 0 : 1;
+				if (!SameAxes(lazy[i].info.axes, eager[i].info.axes) || lazy[i].info.namedInstanceCount != eager[i].info.namedInstanceCount)
+					mismatched++;
+			}
+			size_t wanted = std::min(requests, lazy.size());
+			std::printf("  lazy : %8.2f ms startup + %.2f ms on demand  faces opened for axes %zu  fvar tables read %zu\n", lazyMs, resolveMs, opened,
+						fvarRead);
+			ok &= Check(opened == wanted && repeats == order.size() - wanted, "lazy mode opens only the requested faces, each once");
+			ok &= Check(fvarRead == expectedFvar, "fvar is read only for requested variable faces");
+			ok &= Check(mismatched == 0, "lazily resolved axes match the eager scan");
+		}
+
+		if (synthetic)
+		{
+			std::printf("catalog: face lookup in collections\n");
+			std::vector<uint8_t> ttc;
+			ok &= Check(FontScan::ReadFontBytes(FontScan::WidePath(dir / "font00009.ttc"), ttc), "a collection file reads back");
+			// Face 0 is "Synth 9" (wght), face 1 "Synth <count + 9>".
+			SfntReader::FaceInfo first, second, missing;
+			ok &= Check(SfntReader::ReadFaceAxes(ttc.data(), ttc.size(), 0, first) && first.axes.size() == 1 && first.axes[0].tag == "wght" &&
+							first.namedInstanceCount == 9,
+						"a collection's first face resolves its own fvar");
+			ok &= Check(SfntReader::ReadFaceAxes(ttc.data(), ttc.size(), 1, second) && second.axes.empty() == ((fontCount + 9) % 3 != 0),
+						"the second face resolves its own fvar (or none)");
+			ok &= Check(!SfntReader::ReadFaceAxes(ttc.data(), ttc.size(), 2, missing) && !SfntReader::ReadFaceAxes(ttc.data(), 11, 0, missing),
+						"a face past the collection or a truncated image is rejected");
+			std::filesystem::remove_all(dir, ec);
+		}
+		return ok ? 0 : 1;
+	}
+
+	//---------------------------------------------------------------------
+	//	session: snapshot format, reconcile and restore time (Session.h)
+	//---------------------------------------------------------------------
+	bool SameRows(const Session::Snapshot &a, const Session::Snapshot &b)
+	{
+		if (a.rows.size() != b.rows.size() || a.filteredIndices != b.filteredIndices)
+			return false;
+		for (size_t i = 0; i < a.rows.size(); i++)
+		{
+			const Session::Row &x = a.rows[i], &y = b.rows[i];
+			if (x.displayName != y.displayName || x.filePath != y.filePath || x.sourcePath != y.sourcePath || x.isSystemFont != y.isSystemFont ||
+				x.faceIndex != y.faceIndex || x.contentHash != y.contentHash)
+				return false;
+		}
+		return true;
+	}
+
+	// The same fields in the pin file's layout (UTF-32 strings, 32-bit
+	// integers), for comparing sizes.
+	size_t PlainSnapshotBytes(const Session::Snapshot &s)
+	{
+		auto str = [](const std::wstring &w)
+		{ return 4 + 4 * FontPreviewCore::FromUtf8(FontPreviewCore::ToUtf8(w)).size(); };
+		size_t bytes = 8 + str(s.searchQuery) + 4 + str(s.sampleText) + 4 + str(s.selectedIdentity) + 4 + 8 + 4;
+		for (const Session::Row &row : s.rows)
+			bytes += 4 + str(row.displayName) + str(row.filePath) + str(row.sourcePath) + 4 + 4 + 8;
+		return bytes;
+	}
+
+	int RunSessionBenchmark(int argc, char **argv)
+	{
+		size_t fontCount = argc > 0 ? (size_t)std::strtoul(argv[0], nullptr, 10) : 0;
+		if (fontCount == 0)
+			fontCount = 5000;
+		std::string dir = argc > 1 ? argv[1] : std::string();
+		bool ok = true;
+
+		ReplaySession live;
+		LoadSyntheticCatalog(live, fontCount);
+		live.query = L"Noto";
+		ReplayApplyFilter(live);
+		live.selectedFont = live.filtered[live.filtered.size() / 2];
+		uint64_t signature = Session::CatalogSignature(live.fonts);
+
+		Session::Snapshot saved;
+		saved.searchQuery = live.query;
+		saved.filterType = live.filter;
+		saved.sampleText = L"あいう\U0001F600ABC";
+		saved.bgColor = 0x203040;
+		saved.selectedIdentity = FontPreviewCore::BuildFontIdentity(live.fonts[live.selectedFont]);
+		saved.topRow = 17;
+		Session::CaptureRows(live.fonts, live.filtered, signature, saved);
+		std::vector<uint8_t> bytes;
+		Session::Encode(saved, bytes);
+
+		std::printf("session: format (%zu fonts, %zu filtered)\n", live.fonts.size(), live.filtered.size());
+		{
+			Session::Snapshot loaded;
+			ok &= Check(Session::Decode(bytes.data(), bytes.size(), loaded), "a snapshot decodes");
+			ok &= Check(loaded.searchQuery == saved.searchQuery && loaded.filterType == saved.filterType && loaded.sampleText == saved.sampleText &&
+							loaded.bgColor == saved.bgColor && loaded.selectedIdentity == saved.selectedIdentity && loaded.topRow == saved.topRow &&
+							loaded.catalogSignature == signature,
+						"state round-trips, non-BMP text included");
+			ok &= Check(SameRows(saved, loaded), "rows and indices round-trip");
+			size_t plain = PlainSnapshotBytes(saved);
+			std::printf("  %zu bytes (%.1f per row), %zu in the pin file's layout (%.0f%%)\n", bytes.size(), (double)bytes.size() / saved.rows.size(), plain,
+						100.0 * bytes.size() / plain);
+			ok &= Check(bytes.size() * 3 < plain, "front coding keeps the file under a third of the plain layout");
+
+			Session::Snapshot all = saved;
+			std::vector<int> everything(live.fonts.size());
+			for (size_t i = 0; i < everything.size(); i++)
+				everything[i] = (int)i;
+			Session::CaptureRows(live.fonts, everything, signature, all);
+			std::vector<uint8_t> allBytes;
+			Session::Encode(all, allBytes);
+			Session::Snapshot allLoaded;
+			ok &= Check(Session::Decode(allBytes.data(), allBytes.size(), allLoaded) && SameRows(all, allLoaded), "the unfiltered catalog round-trips");
+			std::printf("  unfiltered: %zu bytes (%.1f per row)\n", allBytes.size(), (double)allBytes.size() / all.rows.size());
+
+			Session::Snapshot empty, emptyLoaded;
+			std::vector<uint8_t> emptyBytes;
+			Session::Encode(empty, emptyBytes);
+			ok &= Check(Session::Decode(emptyBytes.data(), emptyBytes.size(), emptyLoaded) && emptyLoaded.rows.empty() &&
+							emptyLoaded.sampleText == FontPreviewCore::kDefaultSampleText,
+						"a first-run snapshot (no rows) round-trips");
+		}
+
+		std::printf("session: damaged files\n");
+		{
+			Session::Snapshot small = saved;
+			small.rows.resize(40);
+			small.filteredIndices.resize(40);
+			std::vector<uint8_t> file;
+			Session::Encode(small, file);
+			Session::Snapshot out;
+			out.searchQuery = L"untouched";
+			size_t accepted = 0;
+			for (size_t n = 0; n < file.size(); n++)
+				accepted += Session::Decode(file.data(), n, out);
+			for (size_t i = 0; i < file.size(); i++)
+			{
+				for (int bit = 0; bit < 8; bit += 3)
+				{
+					std::vector<uint8_t> bad = file;
+					bad[i] ^= (uint8_t)(1 << bit);
+					accepted += Session::Decode(bad.data(), bad.size(), out);
+				}
+			}
+			ok &= Check(accepted == 0 && out.searchQuery == L"untouched", "every truncation and bit flip is rejected, the target untouched");
+			const char *foreign = "FPCP\x01\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00";
+			ok &= Check(!Session::Decode((const uint8_t *)foreign, 16, out), "a foreign file is rejected");
+
+			// Well-formed (checksummed) but nonsensical payloads.
+			Session::Snapshot wild = small;
+			wild.filteredIndices[5] = wild.filteredIndices[4];
+			Session::Encode(wild, file);
+			ok &= Check(!Session::Decode(file.data(), file.size(), out), "indices must be strictly ascending");
+		}
+
+		std::printf("session: reconcile\n");
+		{
+			Session::Snapshot loaded;
+			Session::Decode(bytes.data(), bytes.size(), loaded);
+			std::vector<int> indices;
+			ok &= Check(Session::ReuseIndices(loaded, Session::CatalogSignature(live.fonts), live.fonts.size(), live.query, live.filter, indices) &&
+							indices == live.filtered,
+						"an unchanged catalog reuses the stored index set");
+			ok &= Check(!Session::ReuseIndices(loaded, signature, live.fonts.size(), L"Noto S", live.filter, indices),
+						"a query typed before enumeration finished filters again");
+
+			ReplaySession changed;
+			LoadSyntheticCatalog(changed, fontCount);
+			changed.fonts[3].contentHash ^= 1;
+			ok &= Check(Session::CatalogSignature(changed.fonts) != signature, "a replaced font file changes the signature");
+			LoadSyntheticCatalog(changed, fontCount);
+			std::swap(changed.fonts[1], changed.fonts[2]);
+			ok &= Check(Session::CatalogSignature(changed.fonts) != signature, "reordering changes the signature");
+
+			// A font installed in the meantime shifts every index; the
+			// selection and top row follow by identity.
+			LoadSyntheticCatalog(changed, fontCount);
+			BenchFont added;
+			added.displayName = L"Aaa New Font";
+			FontPreviewCore::PrecomputeDisplayStrings(added);
+			changed.fonts.insert(changed.fonts.begin(), added);
+			ok &= Check(!Session::ReuseIndices(loaded, Session::CatalogSignature(changed.fonts), changed.fonts.size(), live.query, live.filter, indices),
+						"an added font invalidates the index set");
+			std::vector<BenchFont> provisional;
+			Session::RestoreRows(loaded, provisional);
+			int provisionalSelected = Session::FindByIdentity(provisional, loaded.selectedIdentity);
+			int topFont = loaded.filteredIndices[loaded.topRow];
+			std::wstring topIdentity = FontPreviewCore::BuildFontIdentity(live.fonts[topFont]);
+			int selected = Session::FindByIdentity(changed.fonts, FontPreviewCore::BuildFontIdentity(provisional[provisionalSelected]));
+			ok &= Check(provisionalSelected >= 0 && selected == live.selectedFont + 1, "the selection carries over through the snapshot rows");
+			ok &= Check(Session::FindByIdentity(changed.fonts, topIdentity) == topFont + 1, "so does the first visible family");
+			ok &= Check(Session::FindByIdentity(changed.fonts, L"sys:Gone") == -1 && Session::FindByIdentity(changed.fonts, L"") == -1,
+						"vanished fonts and an empty selection map to none");
+		}
+
+		std::printf("session: restore vs catalog build\n");
+		{
+			const int rounds = 20;
+			std::vector<uint8_t> file;
+			auto t0 = Clock::now();
+			for (int r = 0; r < rounds; r++)
+				Session::Encode(saved, file);
+			double encodeNs = ElapsedNs(t0, Clock::now()) / rounds;
+
+			// Startup with a snapshot: decode, rows to items, filter, select.
+			size_t sink = 0;
+			t0 = Clock::now();
+			for (int r = 0; r < rounds; r++)
+			{
+				ReplaySession s;
+				Session::Snapshot loaded;
+				Session::Decode(file.data(), file.size(), loaded);
+				Session::RestoreRows(loaded, s.fonts);
+				for (auto &f : s.fonts)
+					FontPreviewCore::PrecomputeDisplayStrings(f);
+				s.query = loaded.searchQuery;
+				s.selectedFont = Session::FindByIdentity(s.fonts, loaded.selectedIdentity);
+				ReplayApplyFilter(s);
+				sink += s.rows.size() + (size_t)s.selectedFont;
+			}
+			double restoreNs = ElapsedNs(t0, Clock::now()) / rounds;
+
+			// The reconcile on the UI thread once the catalog arrives.
+			t0 = Clock::now();
+			for (int r = 0; r < rounds; r++)
+			{
+				Session::Snapshot loaded;
+				Session::Decode(file.data(), file.size(), loaded);
+				std::vector<int> indices;
+				if (Session::ReuseIndices(loaded, Session::CatalogSignature(live.fonts), live.fonts.size(), live.query, live.filter, indices))
+					sink += indices.size() + (size_t)Session::FindByIdentity(live.fonts, loaded.selectedIdentity);
+			}
+			double reconcileNs = ElapsedNs(t0, Clock::now()) / rounds;
+			t0 = Clock::now();
+			for (int r = 0; r < rounds; r++)
+			{
+				ReplaySession s = live;
+				ReplayApplyFilter(s);
+				sink += s.rows.size();
+			}
+			double refilterNs = ElapsedNs(t0, Clock::now()) / rounds;
+			std::printf("  save %.2f ms, restore %.2f ms (%zu rows), reconcile %.2f ms (refilter + copy %.2f ms)  [sink %zu]\n", encodeNs / 1e6,
+						restoreNs / 1e6, saved.rows.size(), reconcileNs / 1e6, refilterNs / 1e6, sink);
+
+			if (!dir.empty())
+			{
+				ReplaySession scanned;
+				t0 = Clock::now();
+				bool listed = LoadDirectoryCatalog(scanned, dir);
+				double scanNs = ElapsedNs(t0, Clock::now());
+				ReplayApplyFilter(scanned);
+				Session::Snapshot s;
+				Session::CaptureRows(scanned.fonts, scanned.filtered, Session::CatalogSignature(scanned.fonts), s);
+				Session::Encode(s, file);
+				t0 = Clock::now();
+				Session::Snapshot loaded;
+				ReplaySession restored;
+				bool decoded = Session::Decode(file.data(), file.size(), loaded);
+				Session::RestoreRows(loaded, restored.fonts);
+				for (auto &f : restored.fonts)
+					FontPreviewCore::PrecomputeDisplayStrings(f);
+				ReplayApplyFilter(restored);
+				double restoreDirNs = ElapsedNs(t0, Clock::now());
+				std::printf("  %s: scan %.2f ms for %zu faces, restore from %zu-byte snapshot %.3f ms (%.0fx)\n", dir.c_str(), scanNs / 1e6,
+							scanned.fonts.size(), file.size(), restoreDirNs / 1e6, restoreDirNs > 0 ? scanNs / restoreDirNs : 0.0);
+				ok &= Check(listed && decoded && restored.filtered.size() == scanned.filtered.size(), "the folder's view restores from its snapshot");
+			}
+		}
+		return ok ? 0 : 1;
+	}
+
+	//---------------------------------------------------------------------
+	//	favorites: working set persistence, resolution and filter (Favorites.h)
+	//---------------------------------------------------------------------
+	// What a favorites filter costs without the bitset: every entry's
+	// identity built and looked up.
+	void FilterByIdentity(const std::vector<BenchFont> &fonts, const std::unordered_set<std::wstring> &members, const std::wstring &query,
+						  std::vector<int> &out)
+	{
+		out.clear();
+		std::wstring qLower = FontPreviewCore::ToLower(query);
+		for (size_t i = 0; i < fonts.size(); i++)
+		{
+			if (members.count(FontPreviewCore::BuildFontIdentity(fonts[i])) == 0)
+				continue;
+			if (!qLower.empty() && FontPreviewCore::ToLower(fonts[i].displayName).find(qLower) == std::wstring::npos)
+				continue;
+			out.push_back((int)i);
+		}
+	}
+
+	// Plugin: kWarmStartFonts.
+	const size_t kWarmStartBenchFonts = 12;
+
+	int RunFavoritesBenchmark(int argc, char **argv)
+	{
+		size_t fontCount = argc > 0 ? (size_t)std::strtoul(argv[0], nullptr, 10) : 0;
+		if (fontCount < 1000)
+			fontCount = 20000;
+		bool ok = true;
+		using FontPreviewCore::FontTypeFilter;
+
+		ReplaySession live;
+		LoadSyntheticCatalog(live, fontCount);
+		auto identity = [&](size_t i)
+		{ return FontPreviewCore::BuildFontIdentity(live.fonts[i]); };
+
+		std::printf("favorites: working set\n");
+		{
+			Favorites::WorkingSet set;
+			ok &= Check(set.ToggleFavorite(identity(1)) == Favorites::ToggleResult::Added && set.IsFavorite(identity(1)) &&
+							set.ToggleFavorite(identity(1)) == Favorites::ToggleResult::Removed && !set.IsFavorite(identity(1)),
+						"a favorite toggles on and off");
+			for (size_t i = 0; i < Favorites::kMaxFavorites; i++)
+				set.ToggleFavorite(L"sys:Font " + std::to_wstring(i));
+			ok &= Check(set.ToggleFavorite(identity(1)) == Favorites::ToggleResult::Full && set.Favorites().size() == Favorites::kMaxFavorites,
+						"favorites are capped");
+
+			Favorites::WorkingSet recent;
+			for (size_t i = 0; i < Favorites::kMaxRecent + 4; i++)
+				recent.Touch(identity(i));
+			ok &= Check(recent.Recent().size() == Favorites::kMaxRecent && recent.Recent().front() == identity(Favorites::kMaxRecent + 3) &&
+							recent.Recent().back() == identity(4),
+						"the recent list keeps the newest, most recent first");
+			ok &= Check(recent.Touch(identity(10)) && recent.Recent().front() == identity(10) && recent.Recent().size() == Favorites::kMaxRecent,
+						"touching a listed font moves it to the front");
+			std::stringstream sink;
+			recent.Save(sink);
+			ok &= Check(!recent.Touch(identity(10)) && !recent.IsDirty(), "touching the most recent font again changes nothing");
+
+			Favorites::WorkingSet order;
+			for (size_t i : {5, 6, 7})
+				order.ToggleFavorite(identity(i));
+			for (size_t i : {8, 6})
+				order.Touch(identity(i));
+			std::vector<std::wstring> preload;
+			order.PreloadOrder(4, preload);
+			ok &= Check(preload == std::vector<std::wstring>{identity(6), identity(8), identity(7), identity(5)},
+						"preload order: recent first, then the newest favorites, without duplicates");
+			order.PreloadOrder(1, preload);
+			ok &= Check(preload.size() == 1 && preload[0] == identity(6), "preload order stops at the limit");
+		}
+
+		std::printf("favorites: persistence\n");
+		{
+			Favorites::WorkingSet set;
+			set.ToggleFavorite(identity(3));
+			set.ToggleFavorite(L"file:C:\\Fonts\\\u65e5\u672c.ttf#2");
+			set.Touch(identity(9));
+			set.Touch(L"sys:\U0001F600 Emoji");
+			std::stringstream file;
+			set.Save(file);
+			std::string bytes = file.str();
+			Favorites::WorkingSet loaded;
+			std::stringstream in(bytes);
+			ok &= Check(loaded.Load(in) && loaded.Favorites() == set.Favorites() && loaded.Recent() == set.Recent() && !loaded.IsDirty(),
+						"favorites and the recent list round-trip, non-BMP names included");
+
+			size_t accepted = 0;
+			for (size_t n = 0; n < bytes.size(); n++)
+			{
+				std::stringstream cut(bytes.substr(0, n));
+				accepted += loaded.Load(cut);
+			}
+			ok &= Check(accepted == 0 && loaded.Favorites() == set.Favorites(), "every truncation is rejected, the set untouched");
+			Compare::PinSet pins;
+			pins.Toggle(identity(3), -1);
+			std::stringstream foreign;
+			pins.Save(foreign);
+			ok &= Check(!loaded.Load(foreign) && loaded.Recent() == set.Recent(), "a compare pin file is rejected");
+		}
+
+		std::printf("favorites: resolution and filter (%zu fonts)\n", live.fonts.size());
+		{
+			// Every 37th font, a file font's other face and a vanished one.
+			Favorites::WorkingSet set;
+			std::unordered_set<std::wstring> members;
+			for (size_t i = 0; i < live.fonts.size(); i += 37)
+			{
+				set.ToggleFavorite(identity(i));
+				members.insert(identity(i));
+			}
+			size_t fileFont = 0;
+			while (live.fonts[fileFont].isSystemFont)
+				fileFont++;
+			set.ToggleFavorite(L"file:" + live.fonts[fileFont].filePath + L"#7");
+			set.ToggleFavorite(L"sys:Gone");
+			FontPreviewCore::CatalogBits bits;
+			std::vector<int> indices;
+			Favorites::Resolve(live.fonts, set.Favorites(), bits, &indices);
+			size_t setBits = 0;
+			for (size_t i = 0; i < live.fonts.size(); i++)
+				setBits += FontPreviewCore::TestBit(bits, i);
+			bool indicesOk = indices.size() == set.Favorites().size() && indices[indices.size() - 1] == -1 && indices[indices.size() - 2] == -1;
+			for (size_t f = 0; f + 2 < indices.size(); f++)
+				indicesOk &= indices[f] == (int)(f * 37);
+			ok &= Check(setBits == members.size() && indicesOk, "identities resolve to their catalog entries, other faces and gone fonts to none");
+
+			// The next run lists the fonts in another order.
+			ReplaySession moved = live;
+			std::reverse(moved.fonts.begin(), moved.fonts.end());
+			std::vector<int> movedIndices;
+			FontPreviewCore::CatalogBits movedBits;
+			Favorites::Resolve(moved.fonts, set.Favorites(), movedBits, &movedIndices);
+			bool follows = true;
+			for (size_t f = 0; f + 2 < movedIndices.size(); f++)
+				follows &= movedIndices[f] == (int)(moved.fonts.size() - 1 - f * 37);
+			ok &= Check(follows, "favorites follow their fonts to new catalog indices");
+
+			bool same = true;
+			std::vector<int> viaBits, viaIdentity;
+			for (const wchar_t *query : {L"", L"noto", L"SANS JP", L"zzz"})
+			{
+				FontPreviewCore::FilterCatalog(live.fonts, FontTypeFilter::Favorites, query, viaBits, &bits);
+				FilterByIdentity(live.fonts, members, query, viaIdentity);
+				same &= viaBits == viaIdentity;
+			}
+			ok &= Check(same, "the bitset filter matches a filter by identity for every query");
+			FontPreviewCore::FilterCatalog(live.fonts, FontTypeFilter::Favorites, L"", viaBits, nullptr);
+			ok &= Check(viaBits.empty(), "no bitset, no members");
+
+			Favorites::WorkingSet recent;
+			for (size_t i : {40, 2, 900})
+				recent.Touch(identity(i));
+			FontPreviewCore::CatalogBits recentBits;
+			Favorites::Resolve(live.fonts, recent.Recent(), recentBits);
+			FontPreviewCore::FilterCatalog(live.fonts, FontTypeFilter::Recent, L"", viaBits, &recentBits);
+			ok &= Check(viaBits == std::vector<int>{2, 40, 900}, "the recent filter lists recent fonts in catalog order");
+
+			const int rounds = 50;
+			size_t out = 0;
+			auto t0 = Clock::now();
+			for (int r = 0; r < rounds; r++)
+			{
+				Favorites::Resolve(live.fonts, set.Favorites(), bits);
+				out += bits.size();
+			}
+			double resolveNs = ElapsedNs(t0, Clock::now()) / rounds;
+			t0 = Clock::now();
+			for (int r = 0; r < rounds; r++)
+			{
+				FontPreviewCore::FilterCatalog(live.fonts, FontTypeFilter::Favorites, L"", viaBits, &bits);
+				out += viaBits.size();
+			}
+			double bitsNs = ElapsedNs(t0, Clock::now()) / rounds;
+			t0 = Clock::now();
+			for (int r = 0; r < rounds; r++)
+			{
+				FilterByIdentity(live.fonts, members, L"", viaIdentity);
+				out += viaIdentity.size();
+			}
+			double identityNs = ElapsedNs(t0, Clock::now()) / rounds;
+			t0 = Clock::now();
+			for (int r = 0; r < rounds; r++)
+			{
+				FontPreviewCore::FilterCatalog(live.fonts, FontTypeFilter::All, L"noto", viaIdentity);
+				out += viaIdentity.size();
+			}
+			double allNs = ElapsedNs(t0, Clock::now()) / rounds;
+			std::printf("  %zu favorites: resolve %.1f us per install, filter %.1f us (by identity %.1f us, %.0fx), all fonts + query %.1f us  [sink %zu]\n",
+						members.size(), resolveNs / 1e3, bitsNs / 1e3, identityNs / 1e3, bitsNs > 0 ? identityNs / bitsNs : 0.0, allNs / 1e3, out);
+			ok &= Check(bitsNs * 10 < identityNs, "the bitset filter is over 10x faster than matching identities");
+		}
+
+		std::printf("favorites: warm start after a catalog swap\n");
+		{
+			// The plugin's order: a provisional catalog is rendered, the real
+			// one installed (Sync with the same text and box, new catalog
+			// generation), the warm start queued before the next frame.
+			// Entries hold the identity they were built for.
+			Favorites::WorkingSet set;
+			for (size_t i : {3, 40, 41, 900, 1500})
+				set.Touch(identity(i));
+			std::vector<std::wstring> order;
+			set.PreloadOrder(kWarmStartBenchFonts, order);
+			const std::wstring text = L"Sample \u3042";
+			LayoutCache::Cache<std::wstring> layouts(8u << 20);
+			auto warmStart = [&](const std::vector<BenchFont> &fonts, uint32_t generation, size_t &stored)
+			{
+				FontPreviewCore::CatalogBits members;
+				std::vector<int> indices;
+				Favorites::Resolve(fonts, order, members, &indices);
+				stored = 0;
+				for (int fontIndex : indices)
+				{
+					if (fontIndex >= 0 && !layouts.Contains(LayoutCache::Key(fontIndex, -1)))
+						stored += layouts.Store(generation, LayoutCache::Key(fontIndex, -1), FontPreviewCore::BuildFontIdentity(fonts[fontIndex]), 4096);
+				}
+				return indices;
+			};
+
+			ReplaySession provisional = live;
+			std::reverse(provisional.fonts.begin(), provisional.fonts.end());
+			layouts.Sync(text, 300.0f, 80.0f, 1);
+			// Every index holds a provisional layout, so a stale one would
+			// pass the warm start's Contains check.
+			for (size_t i = 0; i < provisional.fonts.size(); i++)
+				layouts.Store(layouts.Generation(), LayoutCache::Key((int)i, -1), FontPreviewCore::BuildFontIdentity(provisional.fonts[i]), 64);
+			uint32_t stale = layouts.Generation();
+
+			bool swapped = layouts.Sync(layouts.Text(), layouts.Width(), layouts.Height(), 2);
+			ok &= Check(swapped && layouts.Bytes() == 0, "installing a catalog drops the old catalog's layouts");
+			ok &= Check(!layouts.Store(stale, LayoutCache::Key(3, -1), identity(3), 4096) && !layouts.Contains(LayoutCache::Key(3, -1)),
+						"a layout queued for the old catalog is not stored");
+			size_t stored = 0;
+			std::vector<int> indices = warmStart(live.fonts, layouts.Generation(), stored);
+			size_t resolved = (size_t)std::count_if(indices.begin(), indices.end(), [](int i)
+													{ return i >= 0; });
+			ok &= Check(resolved == order.size() && stored == resolved, "the warm start stores every working-set layout");
+			ok &= Check(!layouts.Sync(text, 300.0f, 80.0f, 2), "the first frame after the install keeps them");
+			bool match = true;
+			for (int fontIndex : indices)
+			{
+				std::wstring built;
+				match &= layouts.Find(LayoutCache::Key(fontIndex, -1), [&](std::wstring &entry)
+									  { built = entry; }) &&
+						 built == identity((size_t)fontIndex);
+			}
+			ok &= Check(match, "each layout was built for the font now at its index");
+		}
+		return ok ? 0 : 1;
+	}
+
+	//---------------------------------------------------------------------
+	//	Dispatch
+	//---------------------------------------------------------------------
+	struct Benchmark
+	{
+		const char *name;
+		const char *help;
+		int (*run)(int argc, char **argv);
+	};
+
+	const Benchmark kBenchmarks[] = {
+		{"log", "[iterations]  per-call overhead of gated log sites", &RunLogBenchmark},
+		{"trace", "[threads] [spansPerThread] [out.json]  span overhead and ring/histogram consistency", &RunTraceBenchmark},
+		{"replay", "[script|-] [repeat]  replay an interaction script against the headless core", &RunReplayBenchmark},
+		{"previewcache", "[iterations]  preview cache keys, LRU eviction, catalog retention and stats", &RunPreviewCacheBenchmark},
+		{"memory", "[threads] [insertsPerThread]  eviction order and pressure of the global memory budget", &RunMemoryBenchmark},
+		{"invalidate", "[iterations]  repaint coalescing and per-action counters", &RunInvalidateBenchmark},
+		{"visibility", "visibility state machine and background task hold-back", &RunVisibilityBenchmark},
+		{"sweep", "[threads] [frames] [width] [height]  axis-sweep precompute throughput and playback jitter", &RunSweepBenchmark},
+		{"specimen", "[threads]  waterfall geometry, visible-only relayout and parallel layout", &RunSpecimenBenchmark},
+		{"compare", "[iterations]  pinned-font persistence and shared line breaking", &RunCompareBenchmark},
+		{"glyphs", "[iterations]  cmap index, block navigation and atlas reuse while scrolling", &RunGlyphsBenchmark},
+		{"autofit", "[iterations]  fitted text size from cached metrics, search vs incremental refit", &RunAutoFitBenchmark},
+		{"batch", "[objects]  batched, diffed font replacement against a stub edit section", &RunBatchBenchmark},
+		{"capi", "[fonts]  headless client of the exported catalog API: snapshots, queries, notifications", &RunCatalogApiBenchmark},
+		{"zip", "[entries]  font pack index: Zip64, names, hostile images, folder scan, view vs extraction", &RunZipBenchmark},
+		{"woff", "[dir]  inflate/WOFF conformance, WOFF2 headers, decoded-font cache, decode throughput", &RunWoffBenchmark},
+		{"catalog", "[fonts|dir] [requests]  catalog build with eager and lazy axis resolution: startup time, faces and fvar tables read", &RunCatalogBenchmark},
+		{"session", "[fonts] [dir]  session snapshot format, damaged files, reconcile, restore vs scan", &RunSessionBenchmark},
+		{"favorites", "[fonts]  favorites/recent persistence, resolution by identity, bitset filter", &RunFavoritesBenchmark},
+	};
+
+	void PrintUsage()
+	{
+		std::printf("usage: FontPreviewBench <benchmark> [options]\n");
+		for (const auto &b : kBenchmarks)
+			std::printf("  %-8s %s\n", b.name, b.help);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return 2;
+	}
+	for (const auto &b : kBenchmarks)
+	{
+		if (std::strcmp(argv[1], b.name) == 0)
+			return b.run(argc - 2, argv + 2);
+	}
+	PrintUsage();
+	return 2;
+}
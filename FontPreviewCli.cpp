@@ -0,0 +1,618 @@
+//----------------------------------------------------------------------------------
+//	FontPreview command-line front end (portable console tool)
+//----------------------------------------------------------------------------------
+// Scripts font selection against a folder of font files with the plugin's
+// own catalog, search and alias code (FontPreviewCore.h, FontScan.h), so
+// projects generated in a pipeline get the aliases the "VF+" / "+" buttons
+// would have written. Builds with FontPreviewCli.vcxproj on Windows, or on
+// any C++17 compiler:
+//   g++ -std=c++17 -O2 FontPreviewCli.cpp -o FontPreviewCli
+//
+// Usage: FontPreviewCli <command> <fonts dir> [arguments] [options]
+//   scan <dir>                  every face, in catalog order
+//   search <dir> [text]         faces whose display name contains `text`
+//       --has-axis <tag>        ... and that have this variation axis (repeatable)
+//       --variable              ... and that have any variation axis
+//   info <dir> <font>           one font in detail
+//   alias <dir> <font>          the alias object for a font, to stdout
+//       --vf                    Variable Font Text alias (default: standard text)
+//       --text <text>           sample text (default: the plugin's)
+//       --frames <n>            object length (default: the plugin's fallback)
+//       --axis <tag>=<value>    axis coordinate for --vf (default: the font's)
+//       --all                   every match of <font>, not just the first
+//       --out-dir <dir>         write <identity hash>.object files instead
+// Options for every command:
+//   --json                      JSON on stdout instead of text
+//   --flat                      only the folder itself, not its subfolders
+//   --time                      scan / command timings on stderr
+//
+// <font> is an identity ("file:<path>#<face>"), a catalog index, or text
+// matched like `search`. Arguments and output are UTF-8. Exit code 0 on
+// success, 1 when nothing matched, 2 for usage errors.
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "FontHash.h"
+#include "FontPreviewCore.h"
+#include "SfntReader.h"
+#include "FontScan.h"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double ElapsedMs(Clock::time_point since)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+	}
+
+	// A catalog entry in the plugin's FontItem shape.
+	struct CliFont
+	{
+		std::wstring displayName;
+		std::wstring filePath;
+		bool isSystemFont = false;
+		uint32_t faceIndex = 0;
+		uint64_t contentHash = 0;
+		std::wstring familyName;
+		std::wstring cacheKey;
+		std::wstring subfamilyName;
+		std::vector<SfntReader::Axis> axes;
+		uint16_t namedInstanceCount = 0;
+		size_t fileBytes = 0;
+	};
+
+	struct Options
+	{
+		std::string command;
+		std::string dir;
+		std::vector<std::string> positional;
+		bool json = false;
+		bool flat = false;
+		bool time = false;
+		bool variable = false;
+		std::vector<std::string> hasAxes;
+		bool vf = false;
+		bool all = false;
+		std::string text;
+		bool textSet = false;
+		int frames = 0;
+		FontPreviewCore::AxisCoordinates axisValues;
+		std::string outDir;
+	};
+
+	//---------------------------------------------------------------------
+	//	Output
+	//---------------------------------------------------------------------
+	// Appends `s` (UTF-8) as a JSON string literal.
+	void AppendJsonString(std::string &out, const std::string &s)
+	{
+		out.push_back('"');
+		for (unsigned char c : s)
+		{
+			switch (c)
+			{
+			case '"':
+				out += "\\\"";
+				break;
+			case '\\':
+				out += "\\\\";
+				break;
+			case '\n':
+				out += "\\n";
+				break;
+			case '\r':
+				out += "\\r";
+				break;
+			case '\t':
+				out += "\\t";
+				break;
+			default:
+				if (c < 0x20)
+				{
+					char buf[8];
+					std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+					out += buf;
+				}
+				else
+				{
+					out.push_back((char)c);
+				}
+			}
+		}
+		out.push_back('"');
+	}
+
+	void AppendJsonString(std::string &out, const std::wstring &s)
+	{
+		AppendJsonString(out, FontPreviewCore::ToUtf8(s));
+	}
+
+	std::string FormatFloat(float v)
+	{
+		char buf[32];
+		std::snprintf(buf, sizeof(buf), "%g", (double)v);
+		return buf;
+	}
+
+	std::string FormatHash(uint64_t hash)
+	{
+		char buf[24];
+		std::snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)hash);
+		return buf;
+	}
+
+	std::string AxesSummary(const CliFont &f)
+	{
+		std::string out;
+		for (const auto &axis : f.axes)
+		{
+			if (!out.empty())
+				out += ' ';
+			out += axis.tag + " " + FormatFloat(axis.minValue) + ".." + FormatFloat(axis.maxValue);
+		}
+		return out;
+	}
+
+	void AppendJsonFont(std::string &out, const std::vector<CliFont> &fonts, int index, bool detail)
+	{
+		const CliFont &f = fonts[index];
+		out += "{\"index\":" + std::to_string(index);
+		out += ",\"identity\":";
+		AppendJsonString(out, FontPreviewCore::BuildFontIdentity(f));
+		out += ",\"displayName\":";
+		AppendJsonString(out, f.displayName);
+		out += ",\"family\":";
+		AppendJsonString(out, f.familyName);
+		out += ",\"subfamily\":";
+		AppendJsonString(out, f.subfamilyName);
+		out += ",\"file\":";
+		AppendJsonString(out, f.filePath);
+		out += ",\"faceIndex\":" + std::to_string(f.faceIndex);
+		out += ",\"contentHash\":\"" + FormatHash(f.contentHash) + "\"";
+		out += ",\"axes\":[";
+		for (size_t i = 0; i < f.axes.size(); i++)
+		{
+			const auto &axis = f.axes[i];
+			out += i ? ",{\"tag\":" : "{\"tag\":";
+			AppendJsonString(out, axis.tag);
+			out += ",\"min\":" + FormatFloat(axis.minValue) + ",\"default\":" + FormatFloat(axis.defaultValue) +
+				   ",\"max\":" + FormatFloat(axis.maxValue) + "}";
+		}
+		out += "]";
+		if (detail)
+		{
+			out += ",\"namedInstances\":" + std::to_string(f.namedInstanceCount);
+			out += ",\"fileBytes\":" + std::to_string(f.fileBytes);
+			out += ",\"cacheKey\":";
+			AppendJsonString(out, f.cacheKey);
+		}
+		out += "}";
+	}
+
+	void PrintFontLines(const std::vector<CliFont> &fonts, const std::vector<int> &indices)
+	{
+		for (int i : indices)
+		{
+			const CliFont &f = fonts[i];
+			std::string axes = AxesSummary(f);
+			std::printf("%d\t%s\t%s%s%s\n", i, FontPreviewCore::ToUtf8(f.displayName).c_str(),
+						FontPreviewCore::ToUtf8(FontPreviewCore::BuildFontIdentity(f)).c_str(), axes.empty() ? "" : "\t", axes.c_str());
+		}
+	}
+
+	void PrintFonts(const Options &o, const std::vector<CliFont> &fonts, const std::vector<int> &indices, bool detail)
+	{
+		if (!o.json)
+		{
+			PrintFontLines(fonts, indices);
+			return;
+		}
+		std::string out = "{\"count\":" + std::to_string(indices.size()) + ",\"fonts\":[";
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			if (i)
+				out += ",";
+			AppendJsonFont(out, fonts, indices[i], detail);
+		}
+		out += "]}\n";
+		std::fputs(out.c_str(), stdout);
+	}
+
+	//---------------------------------------------------------------------
+	//	Catalog
+	//---------------------------------------------------------------------
+	bool LoadCatalog(const Options &o, std::vector<CliFont> &fonts)
+	{
+		auto t0 = Clock::now();
+		std::error_code ec;
+		std::filesystem::path dir = std::filesystem::absolute(std::filesystem::u8path(o.dir), ec);
+		if (ec)
+			dir = std::filesystem::u8path(o.dir);
+		FontScan::Stats stats;
+		bool ok = FontScan::ScanDirectory(dir, !o.flat, [&](const FontScan::Face &face)
+										  {
+			CliFont f;
+			f.filePath = face.filePath;
+			f.displayName = FontScan::DisplayName(face.info.familyName, face.fileName);
+			f.subfamilyName = face.info.subfamilyName;
+			f.faceIndex = face.info.faceIndex;
+			f.contentHash = face.contentHash;
+			f.axes = face.info.axes;
+			f.namedInstanceCount = face.info.namedInstanceCount;
+			f.fileBytes = face.fileBytes;
+			FontPreviewCore::PrecomputeDisplayStrings(f);
+			fonts.push_back(std::move(f)); }, &stats);
+		if (!ok)
+		{
+			std::fprintf(stderr, "cannot read folder: %s\n", o.dir.c_str());
+			return false;
+		}
+		if (o.time)
+			std::fprintf(stderr, "catalog: %zu files (%zu unreadable), %zu faces, %.1f MB in %.2f ms\n", stats.files, stats.unreadable, stats.faces,
+						 stats.bytes / (1024.0 * 1024.0), ElapsedMs(t0));
+		return true;
+	}
+
+	bool HasAxis(const CliFont &f, const std::string &tag)
+	{
+		for (const auto &axis : f.axes)
+		{
+			if (axis.tag == tag)
+				return true;
+		}
+		return false;
+	}
+
+	// The window's search (FilterCatalog), narrowed by axis options.
+	void Search(const Options &o, const std::vector<CliFont> &fonts, const std::string &text, std::vector<int> &out)
+	{
+		FontPreviewCore::FilterCatalog(fonts, FontPreviewCore::FontTypeFilter::All, FontPreviewCore::FromUtf8(text), out);
+		out.erase(std::remove_if(out.begin(), out.end(), [&](int i)
+								 {
+			const CliFont &f = fonts[i];
+			if (o.variable && f.axes.empty())
+				return true;
+			for (const auto &tag : o.hasAxes)
+			{
+				if (!HasAxis(f, tag))
+					return true;
+			}
+			return false; }),
+				  out.end());
+	}
+
+	// <font>: identity, catalog index, or search text.
+	void Resolve(const Options &o, const std::vector<CliFont> &fonts, const std::string &selector, std::vector<int> &out)
+	{
+		out.clear();
+		std::wstring wide = FontPreviewCore::FromUtf8(selector);
+		for (size_t i = 0; i < fonts.size(); i++)
+		{
+			if (FontPreviewCore::BuildFontIdentity(fonts[i]) == wide)
+			{
+				out.push_back((int)i);
+				return;
+			}
+		}
+		if (!selector.empty() && selector.find_first_not_of("0123456789") == std::string::npos)
+		{
+			long index = std::strtol(selector.c_str(), nullptr, 10);
+			if (index >= 0 && index < (long)fonts.size())
+				out.push_back((int)index);
+			return;
+		}
+		Search(o, fonts, selector, out);
+	}
+
+	//---------------------------------------------------------------------
+	//	Commands
+	//---------------------------------------------------------------------
+	int RunScan(const Options &o, const std::vector<CliFont> &fonts)
+	{
+		std::vector<int> all(fonts.size());
+		for (size_t i = 0; i < fonts.size(); i++)
+			all[i] = (int)i;
+		PrintFonts(o, fonts, all, false);
+		return 0;
+	}
+
+	int RunSearch(const Options &o, const std::vector<CliFont> &fonts)
+	{
+		auto t0 = Clock::now();
+		std::vector<int> matches;
+		Search(o, fonts, o.positional.empty() ? std::string() : o.positional[0], matches);
+		if (o.time)
+			std::fprintf(stderr, "search: %zu of %zu in %.3f ms\n", matches.size(), fonts.size(), ElapsedMs(t0));
+		PrintFonts(o, fonts, matches, false);
+		return matches.empty() ? 1 : 0;
+	}
+
+	int RunInfo(const Options &o, const std::vector<CliFont> &fonts)
+	{
+		if (o.positional.empty())
+		{
+			std::fprintf(stderr, "info: missing <font>\n");
+			return 2;
+		}
+		std::vector<int> matches;
+		Resolve(o, fonts, o.positional[0], matches);
+		if (matches.empty())
+		{
+			std::fprintf(stderr, "info: no font matches \"%s\"\n", o.positional[0].c_str());
+			return 1;
+		}
+		if (o.json)
+		{
+			PrintFonts(o, fonts, matches, true);
+			return 0;
+		}
+		for (int i : matches)
+		{
+			const CliFont &f = fonts[i];
+			std::printf("index:       %d\n", i);
+			std::printf("identity:    %s\n", FontPreviewCore::ToUtf8(FontPreviewCore::BuildFontIdentity(f)).c_str());
+			std::printf("name:        %s\n", FontPreviewCore::ToUtf8(f.displayName).c_str());
+			std::printf("family:      %s\n", FontPreviewCore::ToUtf8(f.familyName).c_str());
+			std::printf("subfamily:   %s\n", FontPreviewCore::ToUtf8(f.subfamilyName).c_str());
+			std::printf("file:        %s (face %u, %zu bytes)\n", FontPreviewCore::ToUtf8(f.filePath).c_str(), f.faceIndex, f.fileBytes);
+			std::printf("contentHash: %s\n", FormatHash(f.contentHash).c_str());
+			for (const auto &axis : f.axes)
+				std::printf("axis:        %s %g..%g (default %g)\n", axis.tag.c_str(), axis.minValue, axis.maxValue, axis.defaultValue);
+			if (f.namedInstanceCount)
+				std::printf("instances:   %u\n", f.namedInstanceCount);
+			std::printf("\n");
+		}
+		return 0;
+	}
+
+	// The font's defaults (what the sliders start at), overridden by --axis.
+	FontPreviewCore::AxisCoordinates AliasAxes(const Options &o, const CliFont &f)
+	{
+		FontPreviewCore::AxisCoordinates axes;
+		for (const auto &axis : f.axes)
+			axes.emplace_back(axis.tag, FontPreviewCore::FindAxisCoordinate(o.axisValues, axis.tag.c_str(), axis.defaultValue));
+		for (const auto &value : o.axisValues)
+		{
+			if (!HasAxis(f, value.first))
+				axes.push_back(value);
+		}
+		return axes;
+	}
+
+	int RunAlias(const Options &o, const std::vector<CliFont> &fonts)
+	{
+		if (o.positional.empty())
+		{
+			std::fprintf(stderr, "alias: missing <font>\n");
+			return 2;
+		}
+		std::vector<int> matches;
+		Resolve(o, fonts, o.positional[0], matches);
+		if (matches.empty())
+		{
+			std::fprintf(stderr, "alias: no font matches \"%s\"\n", o.positional[0].c_str());
+			return 1;
+		}
+		if (!o.all)
+			matches.resize(1);
+
+		auto t0 = Clock::now();
+		std::wstring text = o.textSet ? FontPreviewCore::FromUtf8(o.text) : std::wstring(FontPreviewCore::kDefaultSampleText);
+		std::string json = "{\"count\":" + std::to_string(matches.size()) + ",\"aliases\":[";
+		size_t bytes = 0;
+		for (size_t n = 0; n < matches.size(); n++)
+		{
+			const CliFont &f = fonts[matches[n]];
+			std::string alias;
+			if (o.vf)
+			{
+				FontPreviewCore::AxisCoordinates axes = AliasAxes(o, f);
+				alias = FontPreviewCore::BuildVFAliasForItem(f, text, o.frames, &axes);
+			}
+			else
+			{
+				alias = FontPreviewCore::BuildTextAliasForItem(f, text, o.frames);
+			}
+			bytes += alias.size();
+			std::wstring identity = FontPreviewCore::BuildFontIdentity(f);
+			std::string file;
+			if (!o.outDir.empty())
+			{
+				std::filesystem::path path = std::filesystem::u8path(o.outDir) / (FormatHash(FontHash::Hash64(identity.data(), identity.size() * sizeof(wchar_t))) + ".object");
+				std::ofstream out(path, std::ios::binary);
+				if (!out.write(alias.data(), (std::streamsize)alias.size()))
+				{
+					std::fprintf(stderr, "alias: cannot write %s\n", path.string().c_str());
+					return 1;
+				}
+				file = path.u8string();
+			}
+			if (o.json)
+			{
+				json += n ? ",{\"index\":" : "{\"index\":";
+				json += std::to_string(matches[n]) + ",\"identity\":";
+				AppendJsonString(json, identity);
+				json += ",\"kind\":";
+				json += o.vf ? "\"vf\"" : "\"text\"";
+				if (!file.empty())
+				{
+					json += ",\"file\":";
+					AppendJsonString(json, file);
+				}
+				else
+				{
+					json += ",\"alias\":";
+					AppendJsonString(json, alias);
+				}
+				json += "}";
+			}
+			else if (!file.empty())
+			{
+				std::printf("%s\t%s\n", file.c_str(), FontPreviewCore::ToUtf8(identity).c_str());
+			}
+			else
+			{
+				std::fwrite(alias.data(), 1, alias.size(), stdout);
+			}
+		}
+		if (o.json)
+			std::fputs((json + "]}\n").c_str(), stdout);
+		if (o.time)
+			std::fprintf(stderr, "alias: %zu aliases, %zu bytes in %.3f ms\n", matches.size(), bytes, ElapsedMs(t0));
+		return 0;
+	}
+
+	//---------------------------------------------------------------------
+	//	Dispatch
+	//---------------------------------------------------------------------
+	struct Command
+	{
+		const char *name;
+		const char *help;
+		int (*run)(const Options &o, const std::vector<CliFont> &fonts);
+	};
+
+	const Command kCommands[] = {
+		{"scan", "<dir>  every face, in catalog order", &RunScan},
+		{"search", "<dir> [text] [--has-axis tag] [--variable]  faces matching the window's search", &RunSearch},
+		{"info", "<dir> <font>  one font in detail", &RunInfo},
+		{"alias", "<dir> <font> [--vf] [--text t] [--frames n] [--axis tag=v] [--all] [--out-dir d]  alias objects", &RunAlias},
+	};
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: FontPreviewCli <command> <fonts dir> [arguments] [--json] [--flat] [--time]\n");
+		for (const auto &c : kCommands)
+			std::fprintf(stderr, "  %-7s %s\n", c.name, c.help);
+		std::fprintf(stderr, "<font> is an identity (file:<path>#<face>), a catalog index, or search text.\n");
+	}
+
+	// Returns false (after printing why) on a malformed command line.
+	bool ParseArgs(const std::vector<std::string> &args, Options &o)
+	{
+		if (args.size() < 2)
+			return false;
+		o.command = args[0];
+		o.dir = args[1];
+		for (size_t i = 2; i < args.size(); i++)
+		{
+			const std::string &a = args[i];
+			auto value = [&](std::string &out)
+			{
+				if (i + 1 >= args.size())
+				{
+					std::fprintf(stderr, "%s needs a value\n", a.c_str());
+					return false;
+				}
+				out = args[++i];
+				return true;
+			};
+			std::string v;
+			if (a == "--json")
+				o.json = true;
+			else if (a == "--flat")
+				o.flat = true;
+			else if (a == "--time")
+				o.time = true;
+			else if (a == "--variable")
+				o.variable = true;
+			else if (a == "--vf")
+				o.vf = true;
+			else if (a == "--all")
+				o.all = true;
+			else if (a == "--has-axis")
+			{
+				if (!value(v))
+					return false;
+				o.hasAxes.push_back(v);
+			}
+			else if (a == "--text")
+			{
+				if (!value(o.text))
+					return false;
+				o.textSet = true;
+			}
+			else if (a == "--frames")
+			{
+				if (!value(v))
+					return false;
+				o.frames = std::atoi(v.c_str());
+			}
+			else if (a == "--out-dir")
+			{
+				if (!value(o.outDir))
+					return false;
+			}
+			else if (a == "--axis")
+			{
+				if (!value(v))
+					return false;
+				size_t eq = v.find('=');
+				if (eq == std::string::npos || eq == 0)
+				{
+					std::fprintf(stderr, "--axis expects <tag>=<value>: %s\n", v.c_str());
+					return false;
+				}
+				o.axisValues.emplace_back(v.substr(0, eq), (float)std::atof(v.c_str() + eq + 1));
+			}
+			else if (a.size() > 2 && a.compare(0, 2, "--") == 0)
+			{
+				std::fprintf(stderr, "unknown option: %s\n", a.c_str());
+				return false;
+			}
+			else
+			{
+				o.positional.push_back(a);
+			}
+		}
+		return true;
+	}
+
+	int Run(const std::vector<std::string> &args)
+	{
+		Options o;
+		if (!ParseArgs(args, o))
+		{
+			PrintUsage();
+			return 2;
+		}
+		for (const auto &c : kCommands)
+		{
+			if (o.command != c.name)
+				continue;
+			std::vector<CliFont> fonts;
+			if (!LoadCatalog(o, fonts))
+				return 2;
+			auto t0 = Clock::now();
+			int rc = c.run(o, fonts);
+			if (o.time)
+				std::fprintf(stderr, "%s: %.3f ms\n", c.name, ElapsedMs(t0));
+			return rc;
+		}
+		PrintUsage();
+		return 2;
+	}
+}
+
+#ifdef _WIN32
+// Arguments arrive as UTF-16; everything past here is UTF-8.
+int wmain(int argc, wchar_t **argv)
+{
+	std::vector<std::string> args;
+	for (int i = 1; i < argc; i++)
+		args.push_back(FontPreviewCore::ToUtf8(argv[i]));
+	return Run(args);
+}
+#else
+int main(int argc, char **argv)
+{
+	return Run(std::vector<std::string>(argv + 1, argv + argc));
+}
+#endif
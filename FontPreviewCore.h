@@ -0,0 +1,598 @@
+//----------------------------------------------------------------------------------
+//	Headless catalog / filter / selection / alias logic (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cwchar>
+#include <cwctype>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// The parts of the plugin that do not touch Win32 controls, DirectWrite or
+// the host: filtering the catalog, mapping list rows to fonts, and building
+// alias text. The plugin calls these directly and FontPreviewBench replays
+// interaction scripts against them on any platform.
+//
+// Functions taking an `Item` expect the plugin's FontItem shape:
+// displayName, filePath, isSystemFont, faceIndex and contentHash.
+namespace FontPreviewCore
+{
+	enum class FontTypeFilter
+	{
+		All = 0,
+		System = 1,
+		Folder = 2,
+		Favorites = 3, // members only (see Favorites.h)
+		Recent = 4	   // members only
+	};
+
+	// A visible ListView row: a family (faceIndex < 0) or one of its faces.
+	struct ListRow
+	{
+		int fontIndex = -1;
+		int faceIndex = -1;
+	};
+
+	constexpr int kFallbackAliasFrames = 182;
+	constexpr const wchar_t *kDefaultSampleText = L"あいうABC123";
+
+	//---------------------------------------------------------------------
+	//	Strings
+	//---------------------------------------------------------------------
+	inline std::wstring ToLower(const std::wstring &s)
+	{
+		std::wstring r = s;
+		std::transform(r.begin(), r.end(), r.begin(), [](wchar_t c)
+					   { return (wchar_t)std::towlower((wint_t)c); });
+		return r;
+	}
+
+	// UTF-16 (Windows) or UTF-32 (elsewhere) to UTF-8, appended to `out` so
+	// callers can reuse a buffer. Unpaired surrogates become U+FFFD, matching
+	// WideCharToMultiByte's replacement behaviour.
+	inline void AppendUtf8(const std::wstring &w, std::string &out)
+	{
+		for (size_t i = 0; i < w.size(); i++)
+		{
+			uint32_t cp = (uint32_t)w[i];
+			if (sizeof(wchar_t) == 2 && cp >= 0xD800 && cp <= 0xDFFF)
+			{
+				uint32_t lo = i + 1 < w.size() ? (uint32_t)w[i + 1] : 0;
+				if (cp <= 0xDBFF && lo >= 0xDC00 && lo <= 0xDFFF)
+				{
+					cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+					i++;
+				}
+				else
+				{
+					cp = 0xFFFD;
+				}
+			}
+			if (cp < 0x80)
+			{
+				out.push_back((char)cp);
+			}
+			else if (cp < 0x800)
+			{
+				out.push_back((char)(0xC0 | (cp >> 6)));
+				out.push_back((char)(0x80 | (cp & 0x3F)));
+			}
+			else if (cp < 0x10000)
+			{
+				out.push_back((char)(0xE0 | (cp >> 12)));
+				out.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+				out.push_back((char)(0x80 | (cp & 0x3F)));
+			}
+			else
+			{
+				out.push_back((char)(0xF0 | (cp >> 18)));
+				out.push_back((char)(0x80 | ((cp >> 12) & 0x3F)));
+				out.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+				out.push_back((char)(0x80 | (cp & 0x3F)));
+			}
+		}
+	}
+
+	inline std::string ToUtf8(const std::wstring &w)
+	{
+		std::string out;
+		out.reserve(w.size());
+		AppendUtf8(w, out);
+		return out;
+	}
+
+	// UTF-8 to UTF-16 (Windows) or UTF-32 (elsewhere). Malformed sequences
+	// become U+FFFD, one per offending byte.
+	inline std::wstring FromUtf8(const std::string &s)
+	{
+		std::wstring out;
+		out.reserve(s.size());
+		for (size_t i = 0; i < s.size();)
+		{
+			uint8_t b = (uint8_t)s[i];
+			int extra = b < 0x80 ? 0 : (b & 0xE0) == 0xC0 ? 1 : (b & 0xF0) == 0xE0 ? 2 : (b & 0xF8) == 0xF0 ? 3 : -1;
+			uint32_t cp = extra == 0 ? b : extra == 1 ? (b & 0x1Fu) : extra == 2 ? (b & 0x0Fu) : (b & 0x07u);
+			bool ok = extra >= 0 && i + extra < s.size();
+			for (int k = 1; ok && k <= extra; k++)
+			{
+				uint8_t c = (uint8_t)s[i + k];
+				ok = (c & 0xC0) == 0x80;
+				cp = (cp << 6) | (c & 0x3Fu);
+			}
+			static const uint32_t kMin[] = {0, 0x80, 0x800, 0x10000};
+			if (!ok || cp < kMin[extra] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+			{
+				out.push_back((wchar_t)0xFFFD);
+				i++;
+				continue;
+			}
+			i += (size_t)extra + 1;
+			if (sizeof(wchar_t) == 2 && cp >= 0x10000)
+			{
+				out.push_back((wchar_t)(0xD800 + ((cp - 0x10000) >> 10)));
+				out.push_back((wchar_t)(0xDC00 + ((cp - 0x10000) & 0x3FF)));
+			}
+			else
+			{
+				out.push_back((wchar_t)cp);
+			}
+		}
+		return out;
+	}
+
+	//---------------------------------------------------------------------
+	//	Identity
+	//---------------------------------------------------------------------
+	template <typename Item>
+	std::wstring ExtractFamilyName(const Item &item)
+	{
+		std::wstring family = item.displayName;
+		if (!item.isSystemFont)
+		{
+			size_t pos = family.find(L" [");
+			if (pos != std::wstring::npos)
+				family = family.substr(0, pos);
+		}
+		return family;
+	}
+
+	// Stable identity of a catalog entry across sessions and re-enumeration:
+	// `sys:<family>` or `file:<path>#<face index>`.
+	template <typename Item>
+	std::wstring BuildFontIdentity(const Item &item)
+	{
+		if (item.isSystemFont)
+			return L"sys:" + item.displayName;
+		return L"file:" + item.filePath + L"#" + std::to_wstring(item.faceIndex);
+	}
+
+	// Identity plus content hash, so caches notice a font file being replaced.
+	template <typename Item>
+	std::wstring BuildFontCacheKey(const Item &item)
+	{
+		wchar_t hash[24];
+		std::swprintf(hash, sizeof(hash) / sizeof(hash[0]), L"@%016llx", (unsigned long long)item.contentHash);
+		return BuildFontIdentity(item) + hash;
+	}
+
+	// Strings read on every selection (family for DirectWrite, cache key for
+	// the preview caches) are built once per catalog so browsing does not
+	// allocate. `Item` needs `familyName` and `cacheKey` members.
+	template <typename Item>
+	void PrecomputeDisplayStrings(Item &item)
+	{
+		item.familyName = ExtractFamilyName(item);
+		item.cacheKey = BuildFontCacheKey(item);
+	}
+
+	//---------------------------------------------------------------------
+	//	Filter and selection
+	//---------------------------------------------------------------------
+	// A subset of the catalog, one bit per index (bit i % 64 of word i / 64).
+	using CatalogBits = std::vector<uint64_t>;
+
+	inline void ResetBits(CatalogBits &bits, size_t count)
+	{
+		bits.assign((count + 63) / 64, 0);
+	}
+
+	inline void SetBit(CatalogBits &bits, size_t i)
+	{
+		bits[i / 64] |= 1ull << (i % 64);
+	}
+
+	inline bool TestBit(const CatalogBits &bits, size_t i)
+	{
+		return i / 64 < bits.size() && (bits[i / 64] >> (i % 64) & 1) != 0;
+	}
+
+	inline int LowestBit(uint64_t word)
+	{
+#if defined(_MSC_VER)
+		unsigned long at;
+		_BitScanForward64(&at, word);
+		return (int)at;
+#else
+		return __builtin_ctzll(word);
+#endif
+	}
+
+	// Case-insensitive substring match on displayName plus the type filter.
+	// The Favorites and Recent filters list the set bits of `members` (none
+	// when it is null), skipping empty words, so only members are matched
+	// against the query.
+	template <typename Item>
+	void FilterCatalog(const std::vector<Item> &fonts, FontTypeFilter type, const std::wstring &query, std::vector<int> &outIndices,
+					   const CatalogBits *members = nullptr)
+	{
+		outIndices.clear();
+		std::wstring qLower = ToLower(query);
+		auto matches = [&](const Item &item)
+		{
+			return qLower.empty() || ToLower(item.displayName).find(qLower) != std::wstring::npos;
+		};
+		if (type == FontTypeFilter::Favorites || type == FontTypeFilter::Recent)
+		{
+			if (!members)
+				return;
+			for (size_t w = 0; w < members->size(); w++)
+			{
+				for (uint64_t word = (*members)[w]; word != 0; word &= word - 1)
+				{
+					size_t i = w * 64 + (size_t)LowestBit(word);
+					if (i >= fonts.size())
+						return;
+					if (matches(fonts[i]))
+						outIndices.push_back((int)i);
+				}
+			}
+			return;
+		}
+		for (size_t i = 0; i < fonts.size(); i++)
+		{
+			const auto &item = fonts[i];
+			if (type == FontTypeFilter::System && !item.isSystemFont)
+				continue;
+			if (type == FontTypeFilter::Folder && item.isSystemFont)
+				continue;
+			if (!matches(item))
+				continue;
+			outIndices.push_back((int)i);
+		}
+	}
+
+	// Keep the selection if it survived the filter, otherwise move it to the
+	// first result (or clear it). Returns true when the selection changed.
+	inline bool ReconcileSelection(const std::vector<int> &filtered, int &selectedFont, int &selectedFace)
+	{
+		if (filtered.empty())
+		{
+			bool changed = selectedFont != -1 || selectedFace != -1;
+			selectedFont = -1;
+			selectedFace = -1;
+			return changed;
+		}
+		if (std::find(filtered.begin(), filtered.end(), selectedFont) != filtered.end())
+			return false;
+		selectedFont = filtered.front();
+		selectedFace = -1;
+		return true;
+	}
+
+	// Expand filtered families into rows. `expandedFaceCount(fontIndex)`
+	// returns how many face rows to show under the family (0 = collapsed).
+	template <typename FaceCountFn>
+	void BuildListRows(const std::vector<int> &filtered, FaceCountFn expandedFaceCount, std::vector<ListRow> &outRows)
+	{
+		outRows.clear();
+		outRows.reserve(filtered.size());
+		for (int fontIdx : filtered)
+		{
+			outRows.push_back({fontIdx, -1});
+			int faces = expandedFaceCount(fontIdx);
+			for (int f = 0; f < faces; f++)
+				outRows.push_back({fontIdx, f});
+		}
+	}
+
+	inline int FindListRow(const std::vector<ListRow> &rows, int fontIndex, int faceIndex)
+	{
+		for (size_t i = 0; i < rows.size(); i++)
+		{
+			if (rows[i].fontIndex == fontIndex && rows[i].faceIndex == faceIndex)
+				return (int)i;
+		}
+		return -1;
+	}
+
+	// Arrow-key movement as the ListView does it: clamp, never wrap.
+	inline int StepListRow(const std::vector<ListRow> &rows, int row, int delta)
+	{
+		if (rows.empty())
+			return -1;
+		long long next = (long long)(row < 0 ? 0 : row) + delta;
+		if (next < 0)
+			next = 0;
+		if (next >= (long long)rows.size())
+			next = (long long)rows.size() - 1;
+		return (int)next;
+	}
+
+	//---------------------------------------------------------------------
+	//	Detail panel
+	//---------------------------------------------------------------------
+	constexpr const wchar_t *kAxesLoadingText = L"軸情報を読み込み中...";
+
+	// The detail panel's labels for the selection, in fixed buffers so a
+	// selection change formats them without allocating. Long names are
+	// truncated.
+	struct DetailText
+	{
+		wchar_t name[512];
+		wchar_t type[64];
+		const wchar_t *axes = L""; // item.axisTooltip, or kAxesLoadingText
+	};
+
+	inline void AppendTruncated(wchar_t *buf, size_t capacity, size_t &length, const wchar_t *text)
+	{
+		for (; *text && length + 1 < capacity; text++)
+			buf[length++] = *text;
+		buf[length] = L'\0';
+	}
+
+	// `faceName` is the selected face's name, or null for a family row or
+	// faces not loaded yet; `faceCount` <= 0 while faces are loading.
+	// `Item` needs displayName, isSystemFont, axesResolved and axisTooltip.
+	template <typename Item>
+	void FormatDetail(const Item &item, const wchar_t *faceName, int faceCount, DetailText &out)
+	{
+		size_t length = 0;
+		AppendTruncated(out.name, sizeof(out.name) / sizeof(out.name[0]), length, item.displayName.c_str());
+		if (faceName)
+		{
+			AppendTruncated(out.name, sizeof(out.name) / sizeof(out.name[0]), length, L" / ");
+			AppendTruncated(out.name, sizeof(out.name) / sizeof(out.name[0]), length, faceName);
+		}
+		const wchar_t *typeName = item.isSystemFont ? L"システムフォント" : L"外部フォント";
+		if (faceCount > 0)
+			std::swprintf(out.type, sizeof(out.type) / sizeof(out.type[0]), L"%ls（%d スタイル）", typeName, faceCount);
+		else
+			std::swprintf(out.type, sizeof(out.type) / sizeof(out.type[0]), L"%ls", typeName);
+		out.axes = item.axesResolved ? item.axisTooltip.c_str() : kAxesLoadingText;
+	}
+
+	//---------------------------------------------------------------------
+	//	Variable axes
+	//---------------------------------------------------------------------
+	// fvar axis tag ("wght", "opsz", ...) and a user-space coordinate.
+	using AxisCoordinates = std::vector<std::pair<std::string, float>>;
+
+	// Axis sliders move in "nice" steps (1, 2 or 5 x 10^n) chosen so a range
+	// has at most about kAxisSliderMaxSteps positions. A position is
+	// value / step, so common coordinates (wght 400, wdth 100) sit exactly
+	// on a position and equal positions mean equal cached instances.
+	constexpr int kAxisSliderMaxSteps = 200;
+
+	struct AxisSlider
+	{
+		float step = 1.0f;
+		int minPos = 0;
+		int maxPos = 0;
+	};
+
+	inline AxisSlider MakeAxisSlider(float minValue, float maxValue)
+	{
+		AxisSlider s;
+		if (!(maxValue > minValue))
+		{
+			s.minPos = s.maxPos = (int)std::lround(minValue);
+			return s;
+		}
+		double raw = ((double)maxValue - minValue) / kAxisSliderMaxSteps;
+		double pow10 = std::pow(10.0, std::floor(std::log10(raw)));
+		double m = raw / pow10;
+		s.step = (float)((m <= 1.0 ? 1.0 : m <= 2.0 ? 2.0 : m <= 5.0 ? 5.0 : 10.0) * pow10);
+		s.minPos = (int)std::ceil(minValue / s.step - 1e-4);
+		s.maxPos = (int)std::floor(maxValue / s.step + 1e-4);
+		if (s.maxPos < s.minPos)
+			s.maxPos = s.minPos;
+		return s;
+	}
+
+	inline int AxisValueToPosition(const AxisSlider &s, float value)
+	{
+		long pos = std::lround(value / s.step);
+		return (int)(std::min)((std::max)(pos, (long)s.minPos), (long)s.maxPos);
+	}
+
+	inline float AxisPositionToValue(const AxisSlider &s, int pos)
+	{
+		return (float)((double)pos * s.step);
+	}
+
+	// Digits worth showing for a slider's coordinates (wght 400, wdth 87.5).
+	inline int AxisSliderDecimals(const AxisSlider &s)
+	{
+		int decimals = (int)-std::floor(std::log10((double)s.step) + 1e-6);
+		return decimals > 0 ? decimals : 0;
+	}
+
+	// Coordinate for `tag` in `axes`, or `fallback` when the font has no
+	// such axis.
+	inline float FindAxisCoordinate(const AxisCoordinates &axes, const char *tag, float fallback)
+	{
+		for (const auto &axis : axes)
+		{
+			if (axis.first == tag)
+				return axis.second;
+		}
+		return fallback;
+	}
+
+	//---------------------------------------------------------------------
+	//	Alias generation
+	//---------------------------------------------------------------------
+	// Axis fields of the VF object, with the value written when the font
+	// has no such axis (or no coordinates were chosen).
+	struct VFAxisField
+	{
+		const char *tag;
+		const char *key;
+		float defaultValue;
+		int decimals;
+	};
+
+	constexpr VFAxisField kVFAxisFields[] = {
+		{"wght", "Weight", 400.0f, 0},
+		{"wdth", "Width", 100.0f, 0},
+		{"slnt", "Slant", 0.0f, 1},
+		{"opsz", "Optical Size", 12.0f, 1},
+		{"ital", "Italic Axis", 0.0f, 1},
+		{"GRAD", "Grade (GRAD)", 0.0f, 1},
+		{"XTRA", "XTRA", 0.0f, 0},
+		{"XOPQ", "XOPQ", 0.0f, 0},
+		{"YOPQ", "YOPQ", 0.0f, 0},
+		{"YTLC", "YTLC", 0.0f, 0},
+		{"YTUC", "YTUC", 0.0f, 0},
+		{"YTAS", "YTAS", 0.0f, 0},
+		{"YTDE", "YTDE", 0.0f, 0},
+		{"YTFI", "YTFI", 0.0f, 0},
+	};
+
+	// VF.object baseline. `fontValue` is the family for system fonts and the
+	// file path otherwise. `axes` (the preview's slider coordinates) fills
+	// the matching axis fields; the others keep their defaults.
+	inline std::string BuildVFAlias(bool isSystemFont, const std::wstring &fontValue, const std::wstring &text, int frameLength,
+									const AxisCoordinates *axes = nullptr)
+	{
+		if (frameLength <= 0)
+			frameLength = kFallbackAliasFrames;
+		std::ostringstream alias;
+		alias << "[Object]\n";
+		alias << "frame=0," << frameLength << "\n";
+		alias << "[Object.0]\n";
+		alias << "effect.name=Variable Font Text\n";
+		alias << "フォントファイル=" << (isSystemFont ? "" : ToUtf8(fontValue)) << "\n";
+		alias << "フォント=" << (isSystemFont ? ToUtf8(fontValue) : "") << "\n";
+		alias << "サイズ=80.0\n";
+		alias << "文字色=ffffff\n";
+		alias << "B=0\n";
+		alias << "I=0\n";
+		alias << "字間=0.0\n";
+		alias << "影設定.hide=1\n";
+		alias << "影を表示=0\n";
+		alias << "影色=000000\n";
+		alias << "影X=0.0\n";
+		alias << "影Y=0.0\n";
+		alias << "影濃度=100\n";
+		alias << "影ぼかし=0.0\n";
+		alias << "縁取り設定.hide=1\n";
+		alias << "縁取りを表示=0\n";
+		alias << "縁取り色=000000\n";
+		alias << "縁取り幅=5.0\n";
+		alias << "縁取りスタイル=丸\n";
+		alias << "切り抜き=0\n";
+		for (const auto &field : kVFAxisFields)
+		{
+			double scale = field.decimals > 0 ? 10.0 : 1.0;
+			double value = std::round((axes ? FindAxisCoordinate(*axes, field.tag, field.defaultValue) : field.defaultValue) * scale) / scale;
+			if (value == 0.0)
+				value = 0.0; // no "-0.0"
+			char buf[32];
+			std::snprintf(buf, sizeof(buf), "%.*f", field.decimals, value);
+			alias << field.key << "=" << buf << "\n";
+		}
+		alias << "軸更新モード=リアルタイム\n";
+		alias << "横幅=0\n";
+		alias << "縦幅=0\n";
+		alias << "文字揃え=中央揃え[中]\n";
+		alias << "行間=0.0\n";
+		alias << "アニメーション.hide=1\n";
+		alias << "表示速度=0.0\n";
+		alias << "文字毎に個別オブジェクト=1\n";
+		alias << "テキスト=" << ToUtf8(text) << "\n";
+		alias << "[Object.1]\n";
+		alias << "effect.name=標準描画\n";
+		alias << "X=0.00\n";
+		alias << "Y=0.00\n";
+		alias << "Z=0.00\n";
+		alias << "Group=1\n";
+		alias << "中心X=0.00\n";
+		alias << "中心Y=0.00\n";
+		alias << "中心Z=0.00\n";
+		alias << "X軸回転=0.00\n";
+		alias << "Y軸回転=0.00\n";
+		alias << "Z軸回転=0.00\n";
+		alias << "拡大率=100.000\n";
+		alias << "縦横比=0.000\n";
+		alias << "透明度=0.00\n";
+		alias << "合成モード=通常\n";
+		return alias.str();
+	}
+
+	// Text.object baseline.
+	inline std::string BuildTextAlias(const std::wstring &fontName, const std::wstring &text, int frameLength)
+	{
+		if (frameLength <= 0)
+			frameLength = kFallbackAliasFrames;
+		std::ostringstream alias;
+		alias << "[Object]\n";
+		alias << "frame=0," << frameLength << "\n";
+		alias << "[Object.0]\n";
+		alias << "effect.name=テキスト\n";
+		alias << "サイズ=80.0\n";
+		alias << "字間=0.00\n";
+		alias << "行間=0.00\n";
+		alias << "表示速度=0.00\n";
+		alias << "フォント=" << ToUtf8(fontName) << "\n";
+		alias << "文字色=ffffff\n";
+		alias << "影・縁色=000000\n";
+		alias << "文字装飾=標準文字\n";
+		alias << "文字揃え=中央揃え[中]\n";
+		alias << "B=0\n";
+		alias << "I=0\n";
+		alias << "テキスト=" << ToUtf8(text) << "\n";
+		alias << "文字毎に個別オブジェクト=0\n";
+		alias << "自動スクロール=0\n";
+		alias << "移動座標上に表示=0\n";
+		alias << "オブジェクトの長さを自動調節=0\n";
+		alias << "[Object.1]\n";
+		alias << "effect.name=標準描画\n";
+		alias << "X=0.00\n";
+		alias << "Y=0.00\n";
+		alias << "Z=0.00\n";
+		alias << "Group=1\n";
+		alias << "中心X=0.00\n";
+		alias << "中心Y=0.00\n";
+		alias << "中心Z=0.00\n";
+		alias << "X軸回転=0.00\n";
+		alias << "Y軸回転=0.00\n";
+		alias << "Z軸回転=0.00\n";
+		alias << "拡大率=100.000\n";
+		alias << "縦横比=0.000\n";
+		alias << "透明度=0.00\n";
+		alias << "合成モード=通常\n";
+		return alias.str();
+	}
+
+	// The aliases the plugin writes for a catalog entry (its "VF+" and "+"
+	// buttons); shared with FontPreviewCli so scripted projects match.
+	template <typename Item>
+	std::string BuildVFAliasForItem(const Item &item, const std::wstring &text, int frameLength, const AxisCoordinates *axes = nullptr)
+	{
+		return BuildVFAlias(item.isSystemFont, item.isSystemFont ? item.displayName : item.filePath, text, frameLength, axes);
+	}
+
+	template <typename Item>
+	std::string BuildTextAliasForItem(const Item &item, const std::wstring &text, int frameLength)
+	{
+		return BuildTextAlias(item.displayName, text, frameLength);
+	}
+}
@@ -14,7 +14,13 @@
 #include <unordered_set>
 #include <algorithm>
 #include <sstream>
+#include <fstream>
+#include <filesystem>
 #include <cmath>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
 #include <dwrite_3.h>
 #include <d3d11.h>
 #include <d2d1_1.h>
@@ -28,6 +34,30 @@ using Microsoft::WRL::ComPtr;
 #include "plugin2.h"
 #include "logger2.h"
 #include "AxisMapping.h"
+#include "FontHash.h"
+#include "FontPreviewCore.h"
+#include "TaskQueue.h"
+#include "LayoutCache.h"
+#include "LruCache.h"
+#include "PreviewCache.h"
+#include "LogGate.h"
+#include "Trace.h"
+#include "AllocCounter.h"
+#include "MemoryBudget.h"
+#include "DirtyState.h"
+#include "Visibility.h"
+#include "AxisSweep.h"
+#include "Specimen.h"
+#include "Compare.h"
+#include "GlyphGrid.h"
+#include "AutoFit.h"
+#include "BatchEdit.h"
+#include "CatalogApi.h"
+#include "ZipIndex.h"
+#include "Woff.h"
+#include "FontScan.h"
+#include "Session.h"
+#include "Favorites.h"
 
 #pragma comment(lib, "dwrite.lib")
 #pragma comment(lib, "shlwapi.lib")
@@ -39,6 +69,22 @@ using Microsoft::WRL::ComPtr;
 
 #define FontPreviewWindowName L"FontPreviewClient"
 #define WM_DO_SET_FONT_OBJECT (WM_APP + 100)
+#define WM_FONT_FACES_READY (WM_APP + 101)
+#define WM_FONT_AXES_READY (WM_APP + 102)
+#define WM_FLUSH_INVALIDATION (WM_APP + 103)
+#define WM_AXIS_SWEEP_FRAME (WM_APP + 104)
+#define WM_GLYPH_TABLE_READY (WM_APP + 105)
+#define WM_GLYPH_PREFETCH (WM_APP + 106)
+#define WM_FONT_CATALOG_READY (WM_APP + 107)
+#define WM_WARM_START_READY (WM_APP + 108)
+#define WM_CATALOG_CLIENT (WM_APP + 109)
+#define WM_CATALOG_DETAILS_READY (WM_APP + 110)
+
+// Set to 1 to resolve variation axes for every font when the catalog is installed
+// (the old behaviour) when comparing startup cost against lazy resolution.
+#ifndef FONTPREVIEW_EAGER_AXES
+#define FONTPREVIEW_EAGER_AXES 0
+#endif
 #define IDC_FONT_GRID 1001
 #define IDC_SEARCH_EDIT 1002
 #define IDC_TYPE_FILTER 1003
@@ -49,19 +95,42 @@ using Microsoft::WRL::ComPtr;
 #define IDC_TYPE_LABEL 1008
 #define IDC_AXIS_LABEL 1009
 #define IDC_ADD_BUTTON 1010
+#define IDC_PREVIEW_MODE 1011
+#define IDC_GLYPH_GOTO 1012
+#define IDC_GLYPH_BLOCK 1013
+#define IDC_AXIS_SLIDER_BASE 1100
+#define IDC_AXIS_SLIDER_LABEL_BASE 1120
+#define IDM_TRACE_TOGGLE 2001
+#define IDM_TRACE_SUMMARY 2002
+#define IDM_TRACE_EXPORT 2003
+#define IDM_MEMORY_REPORT 2004
+#define IDM_REPAINT_REPORT 2005
+#define IDM_VISIBILITY_REPORT 2006
+#define IDM_AXIS_SWEEP 2007
+#define IDM_COMPARE_PIN 2008
+#define IDM_COMPARE_CLEAR 2009
+#define IDM_AUTO_FIT 2010
+#define IDM_BATCH_REPLACE_FOCUSED 2011
+#define IDM_BATCH_REPLACE_RANGE 2012
+#define IDM_FAVORITE_TOGGLE 2013
+#define IDM_BATCH_REPLACE_LAYERS 2014
+#define IDM_MEMORY_BUDGET_BASE 2015
 
 constexpr int kGridCols = 2;
 constexpr int kGridRows = 5;
 
-enum class FontTypeFilter
-{
-	All = 0,
-	System = 1,
-	Folder = 2
-};
+using FontPreviewCore::FontTypeFilter;
+using FontPreviewCore::ListRow;
 
 EDIT_HANDLE *edit_handle = nullptr;
 LOG_HANDLE *logger = nullptr;
+// Per-frame verbose sites (render, resize, redraw) log at most this often.
+constexpr uint32_t kPerFrameLogIntervalMs = 500;
+
+#if FONTPREVIEW_ALLOC_COUNTER
+// Debug builds count this module's heap allocations; see HandleListViewSelection.
+FONTPREVIEW_DEFINE_ALLOC_COUNTER();
+#endif
 
 ComPtr<IDWriteFactory7> g_dwriteFactory;
 ComPtr<ID3D11Device> g_d3dDevice;
@@ -78,8 +147,40 @@ struct FontItem
 	std::wstring displayName;
 	std::wstring filePath;
 	bool isSystemFont = true;
+	// Content identity: `sourcePath` is the file backing this face (also
+	// resolved for system fonts, whose `filePath` stays empty for aliases).
+	std::wstring sourcePath;
+	UINT32 faceIndex = 0;
+	UINT64 contentHash = 0;
+	// Axis metadata is resolved on first use (see RequestFontAxes); until
+	// `axesResolved` is set the two vectors below are simply empty.
+	bool axesResolved = false;
 	std::vector<std::string> axisTags;
 	std::vector<std::pair<std::string, std::pair<float, float>>> axisRanges;
+	std::vector<float> axisDefaults; // parallel to axisRanges
+	uint32_t coverage = 0;			 // FONT_CATALOG_COVERAGE_*, with the axes
+	// Built once so selecting and drawing rows does not allocate:
+	// familyName/cacheKey per catalog (PrecomputeDisplayStrings), the axis
+	// strings when axes resolve (UpdateAxisDisplayStrings).
+	std::wstring familyName;
+	std::wstring cacheKey;
+	std::wstring axisTagLine;
+	std::wstring axisTooltip;
+	std::vector<std::wstring> axisSliderLabels; // "wght Weight" per axis
+};
+
+// One weight/style (or fvar named instance) of a family row. Enumerated on
+// demand and cached per family; see RequestFamilyFaces.
+struct FontFaceEntry
+{
+	std::wstring faceName;
+	DWRITE_FONT_WEIGHT weight = DWRITE_FONT_WEIGHT_NORMAL;
+	DWRITE_FONT_STRETCH stretch = DWRITE_FONT_STRETCH_NORMAL;
+	DWRITE_FONT_STYLE style = DWRITE_FONT_STYLE_NORMAL;
+	bool simulated = false;
+	std::vector<DWRITE_FONT_AXIS_VALUE> axisValues;
+	// HashFontFace of this entry, for preview cache keys.
+	uint64_t styleHash = 0;
 };
 
 // -----------------------------------------------------------------
@@ -92,9 +193,12 @@ struct FontItem
 
 std::vector<FontItem> g_fontList;
 std::vector<int> g_filteredIndices;
+std::vector<ListRow> g_listRows;
 int g_selectedFontIndex = -1;
+int g_selectedFaceIndex = -1;
 FontTypeFilter g_filterType = FontTypeFilter::All;
 std::wstring g_searchQuery;
+HWND g_hwndMain = nullptr;
 HWND g_hwndGrid = nullptr;
 HWND g_hwndPreview = nullptr;
 HWND g_hwndSearch = nullptr;
@@ -106,15 +210,65 @@ HWND g_hwndAddText = nullptr;
 HWND g_hwndNameLabel = nullptr;
 HWND g_hwndTypeLabel = nullptr;
 HWND g_hwndAxisLabel = nullptr;
+HWND g_hwndPreviewMode = nullptr;
+HWND g_hwndGlyphGoto = nullptr;
+HWND g_hwndGlyphBlock = nullptr;
 std::wstring g_fontFolderPath;
 COLORREF g_previewBgColor = RGB(255, 255, 255);
-std::wstring g_sampleText = L"あいうABC123";
+std::wstring g_sampleText = FontPreviewCore::kDefaultSampleText;
 bool g_inRenderPreview = false;
 
-static std::unordered_map<std::wstring, ComPtr<IDWriteFontCollection1>> g_externalFontCollections;
+// One collection per external font file, sized by the file (served from
+// its mapped view, see MappedFontFileLoader). No cap of its own; the global memory budget trims it last.
+static LruCache<std::wstring, ComPtr<IDWriteFontCollection1>> g_externalFontCollections;
+static std::mutex g_externalFontCollectionsMutex;
+static ComPtr<IDWriteFontCollection> g_systemFontCollection;
+
+// Background work (face enumeration, prefetch). Results are handed back to
+// the UI thread with PostMessage; `g_catalogGeneration` lets handlers drop
+// results that belong to a previous catalog (snapshot rows included).
+static TaskQueue g_backgroundTasks;
+static std::atomic<UINT> g_catalogGeneration{0};
+constexpr uint64_t kTaskTagFaceExpand = 1;
+constexpr uint64_t kTaskTagFacePrefetch = 2;
+constexpr uint64_t kTaskTagAxesSelect = 3;
+constexpr uint64_t kTaskTagAxesPrefetch = 4;
+constexpr uint64_t kTaskTagPreviewPrefetch = 5;
+constexpr uint64_t kTaskTagAxisSweep = 6;
+constexpr uint64_t kTaskTagSpecimen = 7;
+constexpr uint64_t kTaskTagCompare = 8;
+constexpr uint64_t kTaskTagGlyphs = 9;
+constexpr uint64_t kTaskTagWarmStart = 10;
+constexpr int kFacePrefetchMargin = 16;
+
+static std::mutex g_familyFacesMutex;
+static std::unordered_map<int, std::vector<FontFaceEntry>> g_familyFaces;
+static std::unordered_set<int> g_familyFacesPending;
+static std::unordered_set<int> g_expandedFamilies;
+// Estimated heap held by g_familyFaces, for the memory report.
+static size_t g_familyFacesBytes = 0;
+
+// Lazily resolved axis metadata. Workers park results here and the UI
+// thread moves them into g_fontList on WM_FONT_AXES_READY.
+struct FontAxesResult
+{
+	UINT generation = 0;
+	std::vector<std::string> axisTags;
+	std::vector<std::pair<std::string, std::pair<float, float>>> axisRanges;
+	std::vector<float> axisDefaults;
+	uint32_t coverage = 0;
+};
+static std::mutex g_fontAxesMutex;
+static std::unordered_map<int, FontAxesResult> g_fontAxesResults;
+static std::unordered_map<int, bool> g_fontAxesPending; // UI thread only; value = urgent
+// Resolves every font's details for catalog API clients (see "Catalog API").
+static CatalogApi::DetailPass g_catalogDetails;
+static std::atomic<bool> g_catalogDetailsPosted{false};
+static std::atomic<UINT> g_axisFaceCreates{0};
+static std::atomic<UINT> g_axisResolves{0};
 
 constexpr double kDefaultAliasSeconds = 1.1;
-constexpr int kFallbackAliasFrames = 182;
+using FontPreviewCore::kFallbackAliasFrames;
 
 static int ComputeAliasLengthFramesFromEditInfo(const EDIT_INFO &info, double seconds)
 {
@@ -149,21 +303,306 @@ std::string ToUtf8(const std::wstring &w)
 
 std::wstring ToLower(const std::wstring &s)
 {
-	std::wstring r = s;
-	std::transform(r.begin(), r.end(), r.begin(), ::towlower);
-	return r;
+	return FontPreviewCore::ToLower(s);
+}
+
+//---------------------------------------------------------------------
+//	Mapped font files
+//---------------------------------------------------------------------
+// External fonts reach DirectWrite through MappedFontFileLoader instead of
+// CreateFontFileReference(path): each file is mapped read-only once, and
+// the same view serves enumeration, content hashing, axis resolution and
+// rendering. Streams hand DirectWrite pointers into the view, so reads
+// neither copy nor reopen the file. The reference key is the path, or a
+// FontScan member path ("<pack>.zip|<entry>") for fonts stored
+// uncompressed in a .zip pack in the Fonts folder; those are served from
+// the pack's view through its ZipIndex, without extracting anything.
+// Views are dropped when the catalog is re-enumerated; streams DirectWrite
+// still holds keep theirs alive.
+struct MappedFontFile
+{
+	const uint8_t *data = nullptr;
+	UINT64 size = 0;
+	UINT64 lastWriteTime = 0; // FILETIME
+
+	~MappedFontFile()
+	{
+		if (data)
+			UnmapViewOfFile(data);
+	}
+};
+
+struct MappedFontPack
+{
+	std::shared_ptr<const MappedFontFile> file;
+	ZipIndex::Index index;
+	std::unordered_map<std::wstring, size_t> byName; // decoded entry name -> index entry
+};
+
+// A font file, or one font inside a pack; `file` keeps `data` mapped.
+struct MappedFontBytes
+{
+	std::shared_ptr<const MappedFontFile> file;
+	const uint8_t *data = nullptr;
+	UINT64 size = 0;
+};
+
+struct MappedFontStats
+{
+	UINT files = 0;
+	UINT packs = 0;
+	UINT hits = 0;
+	UINT failures = 0;
+	UINT64 mappedBytes = 0;
+};
+
+static std::mutex g_mappedFontsMutex;
+static std::unordered_map<std::wstring, std::shared_ptr<const MappedFontFile>> g_mappedFontFiles; // by lower-case path
+static std::unordered_map<std::wstring, std::shared_ptr<const MappedFontPack>> g_mappedFontPacks;
+static MappedFontStats g_mappedFontStats;
+
+static std::shared_ptr<const MappedFontFile> MapFontFileUncached(const std::wstring &path)
+{
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return nullptr;
+	LARGE_INTEGER size{};
+	FILETIME written{};
+	if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0 || !GetFileTime(file, nullptr, nullptr, &written))
+	{
+		CloseHandle(file);
+		return nullptr;
+	}
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping)
+		return nullptr;
+	const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!view)
+		return nullptr;
+	auto mapped = std::make_shared<MappedFontFile>();
+	mapped->data = static_cast<const uint8_t *>(view);
+	mapped->size = (UINT64)size.QuadPart;
+	mapped->lastWriteTime = ((UINT64)written.dwHighDateTime << 32) | written.dwLowDateTime;
+	return mapped;
+}
+
+// The shared view of `path`, mapping it on first use. A view that is not
+// `retain`ed is returned without being shared (hashing a system font file
+// should not keep it mapped). Caller holds g_mappedFontsMutex.
+static std::shared_ptr<const MappedFontFile> MapFontFileLocked(const std::wstring &path, bool retain = true)
+{
+	std::wstring key = ToLower(path);
+	auto it = g_mappedFontFiles.find(key);
+	if (it != g_mappedFontFiles.end())
+	{
+		g_mappedFontStats.hits++;
+		return it->second;
+	}
+	std::shared_ptr<const MappedFontFile> mapped = MapFontFileUncached(path);
+	if (!mapped)
+	{
+		g_mappedFontStats.failures++;
+		return nullptr;
+	}
+	if (!retain)
+		return mapped;
+	g_mappedFontStats.files++;
+	g_mappedFontStats.mappedBytes += mapped->size;
+	g_mappedFontFiles.emplace(std::move(key), mapped);
+	return mapped;
+}
+
+// Pack entry names without the UTF-8 flag (and not UTF-8 anyway) are read
+// with the OEM code page, as Explorer does.
+static std::wstring DecodePackEntryName(const ZipIndex::Entry &e)
+{
+	if (e.utf8 || ZipIndex::IsValidUtf8(e.name))
+		return FontPreviewCore::FromUtf8(e.name);
+	int len = MultiByteToWideChar(CP_OEMCP, 0, e.name.data(), (int)e.name.size(), nullptr, 0);
+	std::wstring out(len > 0 ? len : 0, L'\0');
+	if (len > 0)
+		MultiByteToWideChar(CP_OEMCP, 0, e.name.data(), (int)e.name.size(), out.data(), len);
+	return out;
+}
+
+static std::shared_ptr<const MappedFontPack> MapFontPack(const std::wstring &archivePath)
+{
+	std::lock_guard<std::mutex> lock(g_mappedFontsMutex);
+	std::wstring key = ToLower(archivePath);
+	auto it = g_mappedFontPacks.find(key);
+	if (it != g_mappedFontPacks.end())
+		return it->second;
+	std::shared_ptr<const MappedFontFile> file = MapFontFileLocked(archivePath);
+	if (!file)
+		return nullptr;
+	auto pack = std::make_shared<MappedFontPack>();
+	pack->file = file;
+	ZipIndex::Stats stats;
+	if (!pack->index.Assign(file->data, (size_t)file->size, &stats))
+	{
+		FP_LOG(logger, Warn, kCatEnum, L"FontPack: %ls is not a readable zip archive", archivePath.c_str());
+		pack.reset();
+	}
+	else
+	{
+		const auto &entries = pack->index.Entries();
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			if (ZipIndex::IsServableFont(entries[i]))
+				pack->byName.emplace(DecodePackEntryName(entries[i]), i);
+		}
+		g_mappedFontStats.packs++;
+		FP_LOG(logger, Info, kCatEnum, L"FontPack: %ls entries=%u fonts=%u compressed=%u encrypted=%u invalid=%u", archivePath.c_str(),
+			   (UINT)stats.entries, (UINT)pack->byName.size(), (UINT)stats.compressed, (UINT)stats.encrypted, (UINT)stats.invalid);
+	}
+	// Cache failures too, so a bad pack is reported once per enumeration.
+	g_mappedFontPacks.emplace(std::move(key), pack);
+	return pack;
+}
+
+// The bytes behind a font path or pack member path; see MapFontFileLocked
+// for `retain`.
+static bool AcquireMappedFontBytes(const std::wstring &path, MappedFontBytes &out, bool retain = true)
+{
+	std::wstring archivePath, entryName;
+	if (!FontScan::SplitArchiveMemberPath(path, archivePath, entryName))
+	{
+		std::lock_guard<std::mutex> lock(g_mappedFontsMutex);
+		out.file = MapFontFileLocked(path, retain);
+		out.data = out.file ? out.file->data : nullptr;
+		out.size = out.file ? out.file->size : 0;
+		return out.file != nullptr;
+	}
+	std::shared_ptr<const MappedFontPack> pack = MapFontPack(archivePath);
+	if (!pack)
+		return false;
+	auto it = pack->byName.find(entryName);
+	if (it == pack->byName.end())
+		return false;
+	const ZipIndex::Entry &e = pack->index.Entries()[it->second];
+	out.file = pack->file;
+	out.data = pack->file->data + e.dataOffset;
+	out.size = e.size;
+	return true;
+}
+
+// Drop the views (and pack indices) of the previous catalog.
+static void ResetMappedFontFiles()
+{
+	std::lock_guard<std::mutex> lock(g_mappedFontsMutex);
+	g_mappedFontFiles.clear();
+	g_mappedFontPacks.clear();
+	g_mappedFontStats = MappedFontStats{};
+}
+
+static void LogMappedFontStats(const wchar_t *reason)
+{
+	std::lock_guard<std::mutex> lock(g_mappedFontsMutex);
+	FP_LOG(logger, Info, kCatEnum, L"MappedFonts[%ls]: files=%u packs=%u mapped=%.1fMB hits=%u failures=%u", reason, g_mappedFontStats.files,
+		   g_mappedFontStats.packs, (double)g_mappedFontStats.mappedBytes / (1024.0 * 1024.0), g_mappedFontStats.hits, g_mappedFontStats.failures);
 }
 
-static std::wstring ExtractFamilyName(const FontItem &item)
+class MappedFontFileStream final : public IDWriteFontFileStream
+{
+public:
+	explicit MappedFontFileStream(MappedFontBytes bytes) : m_bytes(std::move(bytes)) {}
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **object) override
+	{
+		if (IsEqualIID(riid, __uuidof(IDWriteFontFileStream)) || IsEqualIID(riid, __uuidof(IUnknown)))
+		{
+			*object = static_cast<IDWriteFontFileStream *>(this);
+			AddRef();
+			return S_OK;
+		}
+		*object = nullptr;
+		return E_NOINTERFACE;
+	}
+	ULONG STDMETHODCALLTYPE AddRef() override { return ++m_refs; }
+	ULONG STDMETHODCALLTYPE Release() override
+	{
+		ULONG refs = --m_refs;
+		if (refs == 0)
+			delete this;
+		return refs;
+	}
+
+	HRESULT STDMETHODCALLTYPE ReadFileFragment(void const **start, UINT64 offset, UINT64 size, void **context) override
+	{
+		*context = nullptr;
+		if (offset > m_bytes.size || size > m_bytes.size - offset)
+		{
+			*start = nullptr;
+			return E_FAIL;
+		}
+		*start = m_bytes.data + offset;
+		return S_OK;
+	}
+	void STDMETHODCALLTYPE ReleaseFileFragment(void *) override {}
+	HRESULT STDMETHODCALLTYPE GetFileSize(UINT64 *size) override
+	{
+		*size = m_bytes.size;
+		return S_OK;
+	}
+	HRESULT STDMETHODCALLTYPE GetLastWriteTime(UINT64 *time) override
+	{
+		*time = m_bytes.file->lastWriteTime;
+		return S_OK;
+	}
+
+private:
+	std::atomic<ULONG> m_refs{1};
+	MappedFontBytes m_bytes;
+};
+
+// Registered with the factory for the plugin's lifetime; a static object,
+// so reference counting is a no-op. Keys are UTF-16 paths without a
+// terminator.
+class MappedFontFileLoader final : public IDWriteFontFileLoader
 {
-	std::wstring family = item.displayName;
-	if (!item.isSystemFont)
+public:
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **object) override
+	{
+		if (IsEqualIID(riid, __uuidof(IDWriteFontFileLoader)) || IsEqualIID(riid, __uuidof(IUnknown)))
+		{
+			*object = static_cast<IDWriteFontFileLoader *>(this);
+			return S_OK;
+		}
+		*object = nullptr;
+		return E_NOINTERFACE;
+	}
+	ULONG STDMETHODCALLTYPE AddRef() override { return 1; }
+	ULONG STDMETHODCALLTYPE Release() override { return 1; }
+
+	HRESULT STDMETHODCALLTYPE CreateStreamFromKey(void const *key, UINT32 keySize, IDWriteFontFileStream **stream) override
 	{
-		size_t pos = family.find(L" [");
-		if (pos != std::wstring::npos)
-			family = family.substr(0, pos);
+		*stream = nullptr;
+		if (!key || keySize == 0 || keySize % sizeof(wchar_t) != 0)
+			return E_INVALIDARG;
+		MappedFontBytes bytes;
+		if (!AcquireMappedFontBytes(std::wstring(static_cast<const wchar_t *>(key), keySize / sizeof(wchar_t)), bytes))
+			return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+		*stream = new MappedFontFileStream(std::move(bytes));
+		return S_OK;
 	}
-	return family;
+};
+
+static MappedFontFileLoader g_mappedFontLoader;
+static bool g_mappedFontLoaderRegistered = false;
+
+// A DirectWrite file for an external font or pack member, served from the
+// shared view. Plain paths fall back to the system loader if registration
+// failed.
+static HRESULT CreateMappedFontFileReference(const std::wstring &path, IDWriteFontFile **outFile)
+{
+	*outFile = nullptr;
+	if (!g_dwriteFactory || path.empty())
+		return E_FAIL;
+	if (!g_mappedFontLoaderRegistered)
+		return FontScan::IsArchiveMemberPath(path) ? E_NOTIMPL : g_dwriteFactory->CreateFontFileReference(path.c_str(), nullptr, outFile);
+	return g_dwriteFactory->CreateCustomFontFileReference(path.data(), (UINT32)(path.size() * sizeof(wchar_t)), &g_mappedFontLoader, outFile);
 }
 
 static HRESULT GetOrCreateExternalFontCollection(const std::wstring &filePath, IDWriteFontCollection1 **outCollection)
@@ -176,16 +615,19 @@ static HRESULT GetOrCreateExternalFontCollection(const std::wstring &filePath, I
 	if (filePath.empty())
 		return E_INVALIDARG;
 
-	auto it = g_externalFontCollections.find(filePath);
-	if (it != g_externalFontCollections.end() && it->second)
+	std::lock_guard<std::mutex> lock(g_externalFontCollectionsMutex);
+	if (ComPtr<IDWriteFontCollection1> *hit = g_externalFontCollections.Get(filePath))
 	{
-		*outCollection = it->second.Get();
-		(*outCollection)->AddRef();
-		return S_OK;
+		if (*hit)
+		{
+			*outCollection = hit->Get();
+			(*outCollection)->AddRef();
+			return S_OK;
+		}
 	}
 
 	ComPtr<IDWriteFontFile> fontFile;
-	HRESULT hr = g_dwriteFactory->CreateFontFileReference(filePath.c_str(), nullptr, &fontFile);
+	HRESULT hr = CreateMappedFontFileReference(filePath, &fontFile);
 	if (FAILED(hr) || !fontFile)
 		return FAILED(hr) ? hr : E_FAIL;
 
@@ -211,7 +653,9 @@ static HRESULT GetOrCreateExternalFontCollection(const std::wstring &filePath, I
 	if (FAILED(hr) || !collection)
 		return FAILED(hr) ? hr : E_FAIL;
 
-	g_externalFontCollections[filePath] = collection;
+	MappedFontBytes bytes;
+	bool mapped = AcquireMappedFontBytes(filePath, bytes);
+	g_externalFontCollections.Put(filePath, collection, mapped ? (size_t)bytes.size : (size_t)64 * 1024);
 	*outCollection = collection.Detach();
 	return S_OK;
 }
@@ -219,16 +663,25 @@ static HRESULT GetOrCreateExternalFontCollection(const std::wstring &filePath, I
 //---------------------------------------------------------------------
 //	Axis helpers
 //---------------------------------------------------------------------
+// DWRITE_MAKE_FONT_AXIS_TAG stores the first character in the low byte.
 std::string TagToString(DWRITE_FONT_AXIS_TAG tag)
 {
 	char buf[5] = {0};
-	buf[0] = (char)((tag >> 24) & 0xFF);
-	buf[1] = (char)((tag >> 16) & 0xFF);
-	buf[2] = (char)((tag >> 8) & 0xFF);
-	buf[3] = (char)(tag & 0xFF);
+	buf[0] = (char)(tag & 0xFF);
+	buf[1] = (char)((tag >> 8) & 0xFF);
+	buf[2] = (char)((tag >> 16) & 0xFF);
+	buf[3] = (char)((tag >> 24) & 0xFF);
 	return std::string(buf);
 }
 
+static DWRITE_FONT_AXIS_TAG StringToAxisTag(const std::string &tag)
+{
+	char c[4] = {' ', ' ', ' ', ' '};
+	for (size_t i = 0; i < 4 && i < tag.size(); i++)
+		c[i] = tag[i];
+	return DWRITE_MAKE_FONT_AXIS_TAG(c[0], c[1], c[2], c[3]);
+}
+
 	// Collect variation axis metadata (tags and ranges) from a DWrite font face.
 	// Fills `item.axisTags` and `item.axisRanges` when the font supports variations.
 	void CollectFontAxes(FontItem &item, IDWriteFontFace5 *fontFace)
@@ -237,6 +690,7 @@ std::string TagToString(DWRITE_FONT_AXIS_TAG tag)
 		return;
 	item.axisTags.clear();
 	item.axisRanges.clear();
+	item.axisDefaults.clear();
 
 	if (!fontFace->HasVariations())
 		return;
@@ -265,6 +719,7 @@ std::string TagToString(DWRITE_FONT_AXIS_TAG tag)
 		std::string tagStr = TagToString(defaultAxisValues[i].axisTag);
 		item.axisTags.push_back(tagStr);
 		item.axisRanges.push_back({tagStr, {axisRanges[i].minValue, axisRanges[i].maxValue}});
+		item.axisDefaults.push_back(defaultAxisValues[i].value);
 	}
 }
 
@@ -323,6 +778,21 @@ std::wstring BuildAxisTagLine(const FontItem &item)
 	return line;
 }
 
+static void UpdateAxisDisplayStrings(FontItem &item)
+{
+	item.axisTagLine = BuildAxisTagLine(item);
+	item.axisTooltip = BuildAxisTooltip(item);
+	item.axisSliderLabels.clear();
+	for (const auto &axis : item.axisRanges)
+	{
+		std::string human = AxisMapping::GetAxisHumanName(axis.first);
+		std::wstring label(axis.first.begin(), axis.first.end());
+		label += L" ";
+		label.append(human.begin(), human.end());
+		item.axisSliderLabels.push_back(std::move(label));
+	}
+}
+
 //---------------------------------------------------------------------
 //	UI helpers
 //---------------------------------------------------------------------
@@ -335,12 +805,7 @@ void SyncSampleTextFromEdit()
 	if (len >= 0)
 	{
 		g_sampleText.assign(buf, len);
-		if (logger)
-		{
-			wchar_t logbuf[160];
-			swprintf_s(logbuf, L"SyncSampleTextFromEdit: len=%d", len);
-			logger->verbose(logger, logbuf);
-		}
+		FP_LOG_VERBOSE_RATE(logger, kCatRender, kPerFrameLogIntervalMs, L"SyncSampleTextFromEdit: len=%d", len);
 	}
 }
 
@@ -360,6 +825,9 @@ HRESULT InitializeGraphics()
 		}
 		return hr;
 	}
+	g_mappedFontLoaderRegistered = SUCCEEDED(g_dwriteFactory->RegisterFontFileLoader(&g_mappedFontLoader));
+	if (!g_mappedFontLoaderRegistered)
+		FP_LOG(logger, Warn, kCatEnum, L"MappedFonts: loader registration failed; external fonts use file references");
 	if (logger)
 		logger->log(logger, L"InitializeGraphics: DWrite initialized");
 	return S_OK;
@@ -368,11 +836,11 @@ HRESULT InitializeGraphics()
 //---------------------------------------------------------------------
 //	Font enumeration helpers
 //---------------------------------------------------------------------
-std::wstring GetDefaultFontFolder()
+std::wstring GetPluginDirectory()
 {
 	wchar_t modulePath[MAX_PATH] = {0};
 	HMODULE hMod = NULL;
-	if (GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, (LPCWSTR)&GetDefaultFontFolder, &hMod))
+	if (GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, (LPCWSTR)&GetPluginDirectory, &hMod))
 	{
 		if (GetModuleFileNameW(hMod, modulePath, MAX_PATH) == 0)
 		{
@@ -385,484 +853,4435 @@ std::wstring GetDefaultFontFolder()
 		GetModuleFileNameW(NULL, modulePath, MAX_PATH);
 	}
 	PathRemoveFileSpec(modulePath);
-	std::wstring fontFolder = modulePath;
+	return modulePath;
+}
+
+std::wstring GetDefaultFontFolder()
+{
+	std::wstring fontFolder = GetPluginDirectory();
 	fontFolder += L"\\Fonts";
 	return fontFolder;
 }
 
-void EnumerateFolderFonts(const std::wstring &folderPath, std::unordered_set<std::wstring> &seenNames)
+// Resolve the on-disk path of a DirectWrite font file. Only files served by
+// the local file loader have one; other loaders return false.
+static bool GetLocalFontFilePath(IDWriteFontFile *fontFile, std::wstring &outPath)
 {
-	if (!g_dwriteFactory)
-		return;
-
-	std::wstring searchPath = folderPath + L"\\*.*";
-	WIN32_FIND_DATAW findData{};
-	HANDLE hFind = FindFirstFileW(searchPath.c_str(), &findData);
-	if (hFind == INVALID_HANDLE_VALUE)
-		return;
-
-	do
-	{
-		if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
-			continue;
-		std::wstring fileName = findData.cFileName;
-		std::wstring lowerName = ToLower(fileName);
-		bool isFontFile = false;
-		if (lowerName.length() >= 4)
-		{
-			std::wstring ext = lowerName.substr(lowerName.length() - 4);
-			isFontFile = (ext == L".ttf" || ext == L".otf" || ext == L".ttc");
-		}
-		if (!isFontFile)
-			continue;
-
-		ComPtr<IDWriteFontFile> fontFile;
-		HRESULT hr = g_dwriteFactory->CreateFontFileReference((folderPath + L"\\" + fileName).c_str(), nullptr, &fontFile);
-		if (FAILED(hr))
-			continue;
-
-		BOOL isSupported = FALSE;
-		DWRITE_FONT_FILE_TYPE fontFileType;
-		DWRITE_FONT_FACE_TYPE fontFaceType;
-		UINT32 numberOfFaces = 0;
-		hr = fontFile->Analyze(&isSupported, &fontFileType, &fontFaceType, &numberOfFaces);
-		if (FAILED(hr) || !isSupported)
-			continue;
+	if (!fontFile)
+		return false;
+	const void *key = nullptr;
+	UINT32 keySize = 0;
+	if (FAILED(fontFile->GetReferenceKey(&key, &keySize)))
+		return false;
+	ComPtr<IDWriteFontFileLoader> loader;
+	if (FAILED(fontFile->GetLoader(&loader)) || !loader)
+		return false;
+	ComPtr<IDWriteLocalFontFileLoader> localLoader;
+	if (FAILED(loader.As(&localLoader)) || !localLoader)
+		return false;
+	UINT32 length = 0;
+	if (FAILED(localLoader->GetFilePathLengthFromKey(key, keySize, &length)))
+		return false;
+	outPath.assign(length + 1, L'\0');
+	if (FAILED(localLoader->GetFilePathFromKey(key, keySize, &outPath[0], length + 1)))
+		return false;
+	outPath.resize(length);
+	return true;
+}
 
-		ComPtr<IDWriteFontSetBuilder> fontSetBuilder;
-		if (FAILED(g_dwriteFactory->CreateFontSetBuilder(&fontSetBuilder)))
-			continue;
-		ComPtr<IDWriteFontSetBuilder1> fontSetBuilder1;
-		if (FAILED(fontSetBuilder.As(&fontSetBuilder1)) || !fontSetBuilder1)
-			continue;
-		fontSetBuilder1->AddFontFile(fontFile.Get());
+//---------------------------------------------------------------------
+//	Content hashing
+//---------------------------------------------------------------------
+static FontHash::HashCache g_fontHashCache;
+static bool g_fontHashCacheLoaded = false;
 
-		ComPtr<IDWriteFontSet> fontSet;
-		if (FAILED(fontSetBuilder1->CreateFontSet(&fontSet)))
-			continue;
-		ComPtr<IDWriteFontSet1> fontSet1;
-		fontSet.As(&fontSet1);
-		UINT32 fontCount = fontSet ? fontSet->GetFontCount() : 0;
+static std::wstring GetFontHashCachePath()
+{
+	return GetPluginDirectory() + L"\\FontPreview.hashcache";
+}
 
-		for (UINT32 i = 0; i < fontCount; i++)
-		{
-			ComPtr<IDWriteLocalizedStrings> familyNames;
-			BOOL exists = FALSE;
-			if (!fontSet1)
-				continue;
-			if (FAILED(fontSet1->GetPropertyValues(i, DWRITE_FONT_PROPERTY_ID_FAMILY_NAME, &exists, &familyNames)) || !exists)
-				continue;
-			UINT32 index = 0;
-			BOOL localeExists = false;
-			if (FAILED(familyNames->FindLocaleName(L"ja-jp", &index, &localeExists)) || !localeExists)
-			{
-				familyNames->FindLocaleName(L"en-us", &index, &localeExists);
-			}
-			if (!localeExists)
-				index = 0;
-			UINT32 length = 0;
-			if (FAILED(familyNames->GetStringLength(index, &length)))
-				continue;
-			std::wstring familyName(length + 1, L'\0');
-			if (FAILED(familyNames->GetString(index, &familyName[0], length + 1)))
-				continue;
-			familyName.resize(length);
+static void LoadFontHashCache()
+{
+	if (g_fontHashCacheLoaded)
+		return;
+	g_fontHashCacheLoaded = true;
+	std::ifstream in(std::filesystem::path(GetFontHashCachePath()), std::ios::binary);
+	if (in && !g_fontHashCache.Load(in) && logger)
+		logger->warn(logger, L"FontHash: cache file ignored (unknown format)");
+}
 
-			FontItem item;
-			item.displayName = familyName + L" [" + fileName + L"]";
-			item.filePath = folderPath + L"\\" + fileName;
-			item.isSystemFont = false;
+static void SaveFontHashCache()
+{
+	if (!g_fontHashCache.IsDirty())
+		return;
+	std::ofstream out(std::filesystem::path(GetFontHashCachePath()), std::ios::binary | std::ios::trunc);
+	if (!out)
+	{
+		if (logger)
+			logger->warn(logger, L"FontHash: cache file could not be written");
+		return;
+	}
+	g_fontHashCache.Save(out);
+}
 
-			ComPtr<IDWriteFontFace> tempFace;
-			ComPtr<IDWriteFontFace5> face5;
-			IDWriteFontFile *files[] = {fontFile.Get()};
-			if (SUCCEEDED(g_dwriteFactory->CreateFontFace(fontFaceType, 1, files, 0, DWRITE_FONT_SIMULATIONS_NONE, &tempFace)))
-			{
-				tempFace.As(&face5);
-			}
-			if (face5)
-				CollectFontAxes(item, face5.Get());
+static UINT64 FileTimeToUInt64(const FILETIME &ft)
+{
+	return ((UINT64)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+}
 
-			std::wstring key = ToLower(item.displayName);
-			if (seenNames.find(key) != seenNames.end())
-			{
-				if (logger)
-				{
-					std::wstring msg = L"Font collision (keep first): " + item.displayName;
-					logger->log(logger, msg.c_str());
-				}
-				continue;
-			}
-			seenNames.insert(key);
-			g_fontList.push_back(item);
-		}
-	} while (FindNextFileW(hFind, &findData));
-	FindClose(hFind);
+// Hash a font file (or pack member) through its read-only mapping so the
+// OS pages the data in directly, without an intermediate read buffer. The
+// loader's shared view is used when it has one. `outFileSize` is the size
+// of the whole file (the pack, for members); `outHashed` the bytes hashed.
+static bool HashFileMapped(const std::wstring &path, UINT64 &outHash, UINT64 &outFileSize, UINT64 &outHashed)
+{
+	MappedFontBytes bytes;
+	if (!AcquireMappedFontBytes(path, bytes, false))
+		return false;
+	outHash = FontHash::Hash64(bytes.data, (size_t)bytes.size);
+	outFileSize = bytes.file->size;
+	outHashed = bytes.size;
+	return true;
 }
 
-void EnumerateFonts()
+struct FontHashStats
 {
-	g_fontList.clear();
-	std::unordered_set<std::wstring> seenNames;
-	if (!g_dwriteFactory)
-		return;
-	if (logger)
-		logger->info(logger, L"EnumerateFonts: start");
+	int files = 0;
+	int cached = 0;
+	int hashed = 0;
+	int failed = 0;
+	UINT64 hashedBytes = 0;
+	double elapsedMs = 0.0;
+};
 
-	ComPtr<IDWriteFontCollection> fontCollection;
-	HRESULT hr = g_dwriteFactory->GetSystemFontCollection(&fontCollection);
-	if (FAILED(hr))
-		return;
+// Fill `outHashes[i]` with the content hash of `paths[i]` (0 when the file
+// cannot be read). Files whose (mtime, size) match the cache only cost a
+// stat; the rest are hashed on worker threads. Pack members are keyed by
+// their member path and the pack's (mtime, size).
+static FontHashStats HashFontFiles(const std::vector<std::wstring> &paths, std::vector<UINT64> &outHashes)
+{
+	FontHashStats stats;
+	LARGE_INTEGER freq{}, t0{}, t1{};
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t0);
 
-	UINT32 familyCount = fontCollection->GetFontFamilyCount();
-	for (UINT32 i = 0; i < familyCount; i++)
+	stats.files = (int)paths.size();
+	outHashes.assign(paths.size(), 0);
+	std::vector<UINT64> mtimes(paths.size(), 0);
+	std::vector<UINT64> sizes(paths.size(), 0);
+	std::vector<size_t> misses;
+	for (size_t i = 0; i < paths.size(); i++)
 	{
-		ComPtr<IDWriteFontFamily> fontFamily;
-		if (FAILED(fontCollection->GetFontFamily(i, &fontFamily)))
-			continue;
-		ComPtr<IDWriteLocalizedStrings> familyNames;
-		if (FAILED(fontFamily->GetFamilyNames(&familyNames)))
+		WIN32_FILE_ATTRIBUTE_DATA attr{};
+		std::wstring archivePath, entryName;
+		const std::wstring &statPath = FontScan::SplitArchiveMemberPath(paths[i], archivePath, entryName) ? archivePath : paths[i];
+		if (!GetFileAttributesExW(statPath.c_str(), GetFileExInfoStandard, &attr))
+		{
+			stats.failed++;
 			continue;
-		UINT32 index = 0;
-		BOOL exists = false;
-		if (FAILED(familyNames->FindLocaleName(L"ja-jp", &index, &exists)) || !exists)
+		}
+		mtimes[i] = FileTimeToUInt64(attr.ftLastWriteTime);
+		sizes[i] = ((UINT64)attr.nFileSizeHigh << 32) | attr.nFileSizeLow;
+		UINT64 hash = 0;
+		if (g_fontHashCache.Lookup(paths[i], mtimes[i], sizes[i], hash))
 		{
-			familyNames->FindLocaleName(L"en-us", &index, &exists);
+			outHashes[i] = hash;
+			stats.cached++;
 		}
-		if (!exists)
-			index = 0;
-		UINT32 length = 0;
-		if (FAILED(familyNames->GetStringLength(index, &length)))
-			continue;
-		std::wstring familyName(length + 1, L'\0');
-		if (FAILED(familyNames->GetString(index, &familyName[0], length + 1)))
-			continue;
-		familyName.resize(length);
-
-		FontItem item;
-		item.displayName = familyName;
-		item.filePath.clear();
-		item.isSystemFont = true;
-
-		ComPtr<IDWriteFont> matchFont;
-		if (SUCCEEDED(fontFamily->GetFirstMatchingFont(DWRITE_FONT_WEIGHT_NORMAL, DWRITE_FONT_STRETCH_NORMAL, DWRITE_FONT_STYLE_NORMAL, &matchFont)))
+		else
 		{
-			ComPtr<IDWriteFontFace> baseFace;
-			ComPtr<IDWriteFontFace5> face5;
-			if (SUCCEEDED(matchFont->CreateFontFace(&baseFace)))
-				baseFace.As(&face5);
-			if (face5)
-				CollectFontAxes(item, face5.Get());
+			misses.push_back(i);
 		}
+	}
 
-		std::wstring key = ToLower(item.displayName);
-		if (seenNames.insert(key).second)
+	std::atomic<size_t> next{0};
+	std::atomic<int> failed{0};
+	std::atomic<UINT64> hashedBytes{0};
+	auto worker = [&]()
+	{
+		for (;;)
 		{
-			g_fontList.push_back(item);
-			if (logger)
+			size_t n = next.fetch_add(1);
+			if (n >= misses.size())
+				break;
+			size_t i = misses[n];
+			UINT64 hash = 0, size = 0, hashed = 0;
+			if (!HashFileMapped(paths[i], hash, size, hashed))
 			{
-				std::wstring msg = L"EnumerateFonts: added " + item.displayName;
-				logger->verbose(logger, msg.c_str());
+				failed++;
+				continue;
 			}
+			outHashes[i] = hash;
+			hashedBytes += hashed;
+			// A size change means the file was rewritten after the stat; leave
+			// it uncached so the next run picks up the final content.
+			if (size == sizes[i])
+				g_fontHashCache.Store(paths[i], mtimes[i], size, hash);
 		}
-	}
+	};
+	size_t workerCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), 8);
+	workerCount = std::min(workerCount, misses.size());
+	std::vector<std::thread> threads;
+	for (size_t w = 1; w < workerCount; w++)
+		threads.emplace_back(worker);
+	worker();
+	for (auto &t : threads)
+		t.join();
 
-	if (g_fontFolderPath.empty())
-		g_fontFolderPath = GetDefaultFontFolder();
-	if (PathFileExistsW(g_fontFolderPath.c_str()))
+	stats.failed += failed.load();
+	stats.hashed = (int)misses.size() - failed.load();
+	stats.hashedBytes = hashedBytes.load();
+	QueryPerformanceCounter(&t1);
+	stats.elapsedMs = (double)(t1.QuadPart - t0.QuadPart) * 1000.0 / (double)freq.QuadPart;
+	return stats;
+}
+
+// Hash every distinct backing file once and store the result on each item.
+static void AssignContentHashes(std::vector<FontItem> &fonts)
+{
+	FP_TRACE_SCOPE("FontHash");
+	LoadFontHashCache();
+	std::vector<std::wstring> paths;
+	std::unordered_map<std::wstring, size_t> slotByPath;
+	std::vector<size_t> slots(fonts.size(), (size_t)-1);
+	for (size_t i = 0; i < fonts.size(); i++)
+	{
+		if (fonts[i].sourcePath.empty())
+			continue;
+		auto res = slotByPath.emplace(ToLower(fonts[i].sourcePath), paths.size());
+		if (res.second)
+			paths.push_back(fonts[i].sourcePath);
+		slots[i] = res.first->second;
+	}
+	std::vector<UINT64> hashes;
+	FontHashStats stats = HashFontFiles(paths, hashes);
+	for (size_t i = 0; i < fonts.size(); i++)
 	{
-		EnumerateFolderFonts(g_fontFolderPath, seenNames);
+		if (slots[i] != (size_t)-1)
+			fonts[i].contentHash = hashes[slots[i]];
 	}
+	SaveFontHashCache();
+	if (logger)
+	{
+		wchar_t buf[256];
+		swprintf_s(buf, L"FontHash: files=%d cached=%d hashed=%d failed=%d read=%.1fMB time=%.1fms",
+				   stats.files, stats.cached, stats.hashed, stats.failed, (double)stats.hashedBytes / (1024.0 * 1024.0), stats.elapsedMs);
+		logger->info(logger, buf);
+	}
+}
+
+// Merge entries whose backing face is byte-identical (same content hash and
+// face index) and keep faces that merely share a name, with a suffix so the
+// rows can be told apart. Earlier entries win, so system fonts take
+// precedence over copies in the Fonts folder. Two system families are never
+// merged: named instances of one variable font (Bahnschrift Light, Segoe UI
+// Variable Display, ...) share a file and face but are distinct families
+// the host selects by name.
+static void DeduplicateFontsByContent(std::vector<FontItem> &fonts)
+{
+	std::unordered_map<UINT64, std::vector<std::pair<UINT32, size_t>>> byContent;
+	std::unordered_set<std::wstring> seenNames;
+	std::vector<FontItem> kept;
+	kept.reserve(fonts.size());
+	int merged = 0;
+	int renamed = 0;
+	for (auto &item : fonts)
+	{
+		if (item.contentHash != 0)
+		{
+			auto &faces = byContent[item.contentHash];
+			auto same = std::find_if(faces.begin(), faces.end(), [&](const std::pair<UINT32, size_t> &f)
+									 { return f.first == item.faceIndex && !(item.isSystemFont && kept[f.second].isSystemFont); });
+			if (same != faces.end())
+			{
+				FP_LOG_VERBOSE(logger, kCatEnum, L"Font duplicate merged: %ls == %ls", item.displayName.c_str(), kept[same->second].displayName.c_str());
+				merged++;
+				continue;
+			}
+			faces.push_back({item.faceIndex, kept.size()});
+		}
+
+		std::wstring key = ToLower(item.displayName);
+		if (!seenNames.insert(key).second)
+		{
+			// System rows use the display name as the DirectWrite family name,
+			// so a second family with the same name would render identically.
+			if (item.isSystemFont)
+				continue;
+			std::wstring base = item.displayName;
+			if (!base.empty() && base.back() == L']')
+				base.pop_back();
+			std::wstring candidate = base + L" #" + std::to_wstring(item.faceIndex) + L"]";
+			for (int n = 2; !seenNames.insert(ToLower(candidate)).second; n++)
+				candidate = base + L" #" + std::to_wstring(item.faceIndex) + L"-" + std::to_wstring(n) + L"]";
+			if (logger)
+			{
+				std::wstring msg = L"Font name collision (different content): " + item.displayName + L" -> " + candidate;
+				logger->log(logger, msg.c_str());
+			}
+			item.displayName = candidate;
+			renamed++;
+		}
+		kept.push_back(std::move(item));
+	}
+	fonts.swap(kept);
 	if (logger)
 	{
 		wchar_t buf[128];
-		swprintf_s(buf, L"EnumerateFonts: total fonts=%d", (int)g_fontList.size());
+		swprintf_s(buf, L"FontHash: merged=%d disambiguated=%d", merged, renamed);
+		logger->info(logger, buf);
+	}
+}
+
+//---------------------------------------------------------------------
+//	Web fonts (WOFF/WOFF2)
+//---------------------------------------------------------------------
+// DirectWrite only reads sfnt files, so each web font in the Fonts folder is
+// decoded once into FontPreview.webfonts (next to the plugin), named by its
+// content hash, and the decoded file is listed in its place. Host objects
+// can use it like any other file.
+static std::wstring GetWebFontCacheFolder()
+{
+	return GetPluginDirectory() + L"\\FontPreview.webfonts";
+}
+
+struct WebFontStats
+{
+	int files = 0;
+	int cached = 0;
+	int decoded = 0;
+	int failed = 0;
+	UINT64 decodedBytes = 0;
+	double elapsedMs = 0.0;
+};
+
+// WOFF2 goes through DirectWrite's decoder (Brotli and the glyf/loca
+// transforms); its output is copied out a chunk at a time.
+template <typename Write>
+static bool UnpackWoff2(const uint8_t *data, size_t size, Write &write)
+{
+	Woff::Woff2Info info;
+	if (!Woff::ReadWoff2Header(data, size, info) || size > UINT32_MAX)
+		return false;
+	ComPtr<IDWriteFontFileStream> stream;
+	if (FAILED(g_dwriteFactory->UnpackFontFile(DWRITE_CONTAINER_TYPE_WOFF2, data, (UINT32)size, &stream)) || !stream)
+		return false;
+	UINT64 total = 0;
+	if (FAILED(stream->GetFileSize(&total)))
+		return false;
+	const UINT64 kChunk = 1024 * 1024;
+	for (UINT64 offset = 0; offset < total; offset += kChunk)
+	{
+		const void *fragment = nullptr;
+		void *context = nullptr;
+		UINT64 n = std::min(kChunk, total - offset);
+		if (FAILED(stream->ReadFileFragment(&fragment, offset, n, &context)))
+			return false;
+		bool ok = write((const uint8_t *)fragment, (size_t)n);
+		stream->ReleaseFileFragment(context);
+		if (!ok)
+			return false;
+	}
+	return total > 0;
+}
+
+// Decode (or find the decoded copy of) every web font in `paths`, on
+// worker threads; `outPaths[i]` is the decoded file, empty on failure.
+// Unchanged files cost a stat and a header read: their content hash comes
+// from the hash cache. Each worker holds one table at a time, so peak
+// memory does not grow with the number or size of the fonts.
+static WebFontStats DecodeWebFonts(const std::vector<std::wstring> &paths, std::vector<std::wstring> &outPaths)
+{
+	FP_TRACE_SCOPE("WebFonts");
+	WebFontStats stats;
+	LARGE_INTEGER freq{}, t0{}, t1{};
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t0);
+	stats.files = (int)paths.size();
+	outPaths.assign(paths.size(), std::wstring());
+	LoadFontHashCache();
+	Woff::DecodedCache cache{std::filesystem::path(GetWebFontCacheFolder())};
+
+	std::vector<std::string> live(paths.size());
+	std::atomic<size_t> next{0};
+	std::atomic<int> cached{0}, decoded{0};
+	std::atomic<UINT64> decodedBytes{0};
+	auto worker = [&]()
+	{
+		std::vector<uint8_t> scratch;
+		std::string writerTag = std::to_string(GetCurrentThreadId());
+		for (;;)
+		{
+			size_t i = next.fetch_add(1);
+			if (i >= paths.size())
+				break;
+			MappedFontBytes bytes;
+			if (!AcquireMappedFontBytes(paths[i], bytes, false) || bytes.size < 8)
+				continue;
+			const uint8_t *data = bytes.data;
+			size_t size = (size_t)bytes.size;
+			Woff::Container container = Woff::Detect(data, size);
+			if (container != Woff::Container::Woff && container != Woff::Container::Woff2)
+				continue;
+			uint32_t flavor = ((uint32_t)data[4] << 24) | ((uint32_t)data[5] << 16) | ((uint32_t)data[6] << 8) | data[7];
+			UINT64 hash = 0;
+			UINT64 mtime = bytes.file->lastWriteTime;
+			if (!g_fontHashCache.Lookup(paths[i], mtime, size, hash))
+			{
+				hash = FontHash::Hash64(data, size);
+				g_fontHashCache.Store(paths[i], mtime, size, hash);
+			}
+			if (cache.Contains(hash, flavor))
+			{
+				cached++;
+			}
+			else
+			{
+				UINT64 written = 0;
+				bool ok = cache.Store(hash, flavor, writerTag, [&](auto &&write)
+									  {
+					auto counted = [&](const uint8_t *p, size_t n)
+					{
+						written += n;
+						return write(p, n);
+					};
+					if (container == Woff::Container::Woff)
+						return Woff::Decode(data, size, counted, scratch);
+					return UnpackWoff2(data, size, counted); });
+				if (!ok)
+					continue;
+				decoded++;
+				decodedBytes += written;
+			}
+			live[i] = Woff::DecodedCache::FileName(hash, flavor);
+			outPaths[i] = cache.PathFor(hash, flavor).wstring();
+		}
+	};
+	size_t workerCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), 4);
+	workerCount = std::min(workerCount, paths.size());
+	std::vector<std::thread> threads;
+	for (size_t w = 1; w < workerCount; w++)
+		threads.emplace_back(worker);
+	worker();
+	for (auto &t : threads)
+		t.join();
+	SaveFontHashCache();
+
+	// Entries of web fonts that were removed or changed.
+	if (std::filesystem::exists(cache.Dir()))
+		cache.Prune(live);
+	stats.cached = cached.load();
+	stats.decoded = decoded.load();
+	stats.failed = stats.files - stats.cached - stats.decoded;
+	stats.decodedBytes = decodedBytes.load();
+	QueryPerformanceCounter(&t1);
+	stats.elapsedMs = (double)(t1.QuadPart - t0.QuadPart) * 1000.0 / (double)freq.QuadPart;
+	return stats;
+}
+
+// Add the faces of one external font file (or pack member) to `fonts`,
+// listed as "<family> [<listedName>]".
+static void AddFolderFontFaces(const std::wstring &path, const std::wstring &listedName, std::vector<FontItem> &fonts)
+{
+	ComPtr<IDWriteFontFile> fontFile;
+	HRESULT hr = CreateMappedFontFileReference(path, &fontFile);
+	if (FAILED(hr))
+		return;
+
+	BOOL isSupported = FALSE;
+	DWRITE_FONT_FILE_TYPE fontFileType;
+	DWRITE_FONT_FACE_TYPE fontFaceType;
+	UINT32 numberOfFaces = 0;
+	hr = fontFile->Analyze(&isSupported, &fontFileType, &fontFaceType, &numberOfFaces);
+	if (FAILED(hr) || !isSupported)
+		return;
+
+	ComPtr<IDWriteFontSetBuilder> fontSetBuilder;
+	if (FAILED(g_dwriteFactory->CreateFontSetBuilder(&fontSetBuilder)))
+		return;
+	ComPtr<IDWriteFontSetBuilder1> fontSetBuilder1;
+	if (FAILED(fontSetBuilder.As(&fontSetBuilder1)) || !fontSetBuilder1)
+		return;
+	fontSetBuilder1->AddFontFile(fontFile.Get());
+
+	ComPtr<IDWriteFontSet> fontSet;
+	if (FAILED(fontSetBuilder1->CreateFontSet(&fontSet)))
+		return;
+	ComPtr<IDWriteFontSet1> fontSet1;
+	fontSet.As(&fontSet1);
+	UINT32 fontCount = fontSet ? fontSet->GetFontCount() : 0;
+	std::unordered_set<UINT32> seenFaces;
+
+	for (UINT32 i = 0; i < fontCount; i++)
+	{
+		// Named instances of a variable font share their face index and
+		// content with the default instance; list the face once.
+		UINT32 faceIndex = 0;
+		ComPtr<IDWriteFontFaceReference> faceRef;
+		if (SUCCEEDED(fontSet->GetFontFaceReference(i, &faceRef)) && faceRef)
+			faceIndex = faceRef->GetFontFaceIndex();
+		if (!seenFaces.insert(faceIndex).second)
+			continue;
+
+		ComPtr<IDWriteLocalizedStrings> familyNames;
+		BOOL exists = FALSE;
+		if (!fontSet1)
+			continue;
+		if (FAILED(fontSet1->GetPropertyValues(i, DWRITE_FONT_PROPERTY_ID_FAMILY_NAME, &exists, &familyNames)) || !exists)
+			continue;
+		UINT32 index = 0;
+		BOOL localeExists = false;
+		if (FAILED(familyNames->FindLocaleName(L"ja-jp", &index, &localeExists)) || !localeExists)
+		{
+			familyNames->FindLocaleName(L"en-us", &index, &localeExists);
+		}
+		if (!localeExists)
+			index = 0;
+		UINT32 length = 0;
+		if (FAILED(familyNames->GetStringLength(index, &length)))
+			continue;
+		std::wstring familyName(length + 1, L'\0');
+		if (FAILED(familyNames->GetString(index, &familyName[0], length + 1)))
+			continue;
+		familyName.resize(length);
+
+		FontItem item;
+		item.displayName = FontScan::DisplayName(familyName, listedName);
+		item.filePath = path;
+		item.isSystemFont = false;
+		item.sourcePath = item.filePath;
+		item.faceIndex = faceIndex;
+		fonts.push_back(item);
+	}
+}
+
+void EnumerateFolderFonts(const std::wstring &folderPath, std::vector<FontItem> &fonts)
+{
+	if (!g_dwriteFactory)
+		return;
+
+	std::wstring searchPath = folderPath + L"\\*.*";
+	WIN32_FIND_DATAW findData{};
+	HANDLE hFind = FindFirstFileW(searchPath.c_str(), &findData);
+	if (hFind == INVALID_HANDLE_VALUE)
+		return;
+	std::vector<std::wstring> webFonts, webFontNames;
+
+	do
+	{
+		if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			continue;
+		std::wstring fileName = findData.cFileName;
+		std::wstring path = folderPath + L"\\" + fileName;
+		if (FontScan::IsFontFile(std::filesystem::path(fileName)))
+		{
+			AddFolderFontFaces(path, fileName, fonts);
+		}
+		else if (FontScan::IsArchiveFile(std::filesystem::path(fileName)))
+		{
+			// Stored fonts in a pack, in the pack's order.
+			std::shared_ptr<const MappedFontPack> pack = MapFontPack(path);
+			if (!pack)
+				continue;
+			std::vector<std::pair<size_t, const std::wstring *>> members;
+			for (const auto &entry : pack->byName)
+				members.emplace_back(entry.second, &entry.first);
+			std::sort(members.begin(), members.end());
+			for (const auto &member : members)
+				AddFolderFontFaces(FontScan::ArchiveMemberPath(path, *member.second), fileName + L"/" + *member.second, fonts);
+		}
+		else if (FontScan::IsWebFontFile(std::filesystem::path(fileName)))
+		{
+			webFonts.push_back(path);
+			webFontNames.push_back(fileName);
+		}
+	} while (FindNextFileW(hFind, &findData));
+	FindClose(hFind);
+
+	// Also run with no web fonts, to drop the decoded copies of removed ones.
+	std::vector<std::wstring> decodedPaths;
+	WebFontStats stats = DecodeWebFonts(webFonts, decodedPaths);
+	for (size_t i = 0; i < webFonts.size(); i++)
+	{
+		if (!decodedPaths[i].empty())
+			AddFolderFontFaces(decodedPaths[i], webFontNames[i], fonts);
+	}
+	if (stats.files > 0)
+		FP_LOG(logger, Info, kCatEnum, L"WebFonts: files=%d cached=%d decoded=%d (%.1fMB) failed=%d time=%.1fms", stats.files, stats.cached, stats.decoded,
+		   (double)stats.decodedBytes / (1024.0 * 1024.0), stats.failed, stats.elapsedMs);
+}
+
+static void ResetFamilyFaces();
+static void ResetFontAxes();
+static void ResolveAllFontAxesNow();
+static void RetainPreviewBitmapsForCatalog();
+static void SyncPreviewLayoutsToCatalog();
+static void ResolveComparePins();
+static void ResolveWorkingSet();
+static void TouchRecentFont(int fontIndex);
+static void PublishCatalog(const wchar_t *reason, bool sameFonts);
+static void HandleFontAxesReady(int fontIndex, UINT generation);
+static void InvalidateCatalogEntry(int fontIndex);
+
+// A catalog enumerated off the UI thread, waiting to be installed.
+struct FontCatalogBuild
+{
+	std::vector<FontItem> fonts;
+	double elapsedMs = 0.0;
+};
+
+// List the system families and the Fonts folder into `out`. Runs on the
+// enumeration thread: it touches neither g_fontList nor any UI state, and
+// everything it shares (mapped files, font collections, the hash cache)
+// is locked.
+static void BuildFontCatalog(IDWriteFontCollection *fontCollection, const std::wstring &folderPath, FontCatalogBuild &out)
+{
+	FP_TRACE_SCOPE("EnumerateFonts");
+	std::vector<FontItem> &fonts = out.fonts;
+	std::unordered_set<std::wstring> seenNames;
+	if (!g_dwriteFactory || !fontCollection)
+		return;
+	if (logger)
+		logger->info(logger, L"EnumerateFonts: start");
+	LARGE_INTEGER freq{}, t0{}, t1{};
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t0);
+
+	UINT32 familyCount = fontCollection->GetFontFamilyCount();
+	for (UINT32 i = 0; i < familyCount; i++)
+	{
+		ComPtr<IDWriteFontFamily> fontFamily;
+		if (FAILED(fontCollection->GetFontFamily(i, &fontFamily)))
+			continue;
+		ComPtr<IDWriteLocalizedStrings> familyNames;
+		if (FAILED(fontFamily->GetFamilyNames(&familyNames)))
+			continue;
+		UINT32 index = 0;
+		BOOL exists = false;
+		if (FAILED(familyNames->FindLocaleName(L"ja-jp", &index, &exists)) || !exists)
+		{
+			familyNames->FindLocaleName(L"en-us", &index, &exists);
+		}
+		if (!exists)
+			index = 0;
+		UINT32 length = 0;
+		if (FAILED(familyNames->GetStringLength(index, &length)))
+			continue;
+		std::wstring familyName(length + 1, L'\0');
+		if (FAILED(familyNames->GetString(index, &familyName[0], length + 1)))
+			continue;
+		familyName.resize(length);
+
+		FontItem item;
+		item.displayName = familyName;
+		item.filePath.clear();
+		item.isSystemFont = true;
+
+		ComPtr<IDWriteFont> matchFont;
+		if (SUCCEEDED(fontFamily->GetFirstMatchingFont(DWRITE_FONT_WEIGHT_NORMAL, DWRITE_FONT_STRETCH_NORMAL, DWRITE_FONT_STYLE_NORMAL, &matchFont)))
+		{
+			ComPtr<IDWriteFont3> font3;
+			ComPtr<IDWriteFontFaceReference> faceRef;
+			ComPtr<IDWriteFontFile> fontFile;
+			if (SUCCEEDED(matchFont.As(&font3)) && font3 && SUCCEEDED(font3->GetFontFaceReference(&faceRef)) && faceRef)
+			{
+				item.faceIndex = faceRef->GetFontFaceIndex();
+				if (SUCCEEDED(faceRef->GetFontFile(&fontFile)))
+					GetLocalFontFilePath(fontFile.Get(), item.sourcePath);
+			}
+		}
+
+		std::wstring key = ToLower(item.displayName);
+		if (seenNames.insert(key).second)
+		{
+			fonts.push_back(item);
+			FP_LOG_VERBOSE(logger, kCatEnum, L"EnumerateFonts: added %ls", item.displayName.c_str());
+		}
+	}
+
+	if (PathFileExistsW(folderPath.c_str()))
+	{
+		EnumerateFolderFonts(folderPath, fonts);
+	}
+	AssignContentHashes(fonts);
+	LogMappedFontStats(L"enumerate");
+	DeduplicateFontsByContent(fonts);
+	for (auto &item : fonts)
+		FontPreviewCore::PrecomputeDisplayStrings(item);
+	QueryPerformanceCounter(&t1);
+	out.elapsedMs = freq.QuadPart ? (double)(t1.QuadPart - t0.QuadPart) * 1000.0 / (double)freq.QuadPart : 0.0;
+}
+
+// Replace g_fontList with an enumerated catalog (UI thread). Face and axis
+// state keyed by the old indices is dropped; carrying the selection over
+// is the caller's.
+static void InstallFontCatalog(FontCatalogBuild &&build)
+{
+	LARGE_INTEGER freq{}, t0{}, t1{};
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t0);
+	UINT faceCreatesBefore = g_axisFaceCreates;
+	ResetFamilyFaces();
+	ResetFontAxes();
+	// Layouts are keyed by index: drop the old catalog's now, before the
+	// warm start and prefetch queue work for the new one (see LayoutCache.h).
+	SyncPreviewLayoutsToCatalog();
+	g_fontList = std::move(build.fonts);
+#if FONTPREVIEW_EAGER_AXES
+	ResolveAllFontAxesNow();
+#endif
+	RetainPreviewBitmapsForCatalog();
+	ResolveComparePins();
+	ResolveWorkingSet();
+	PublishCatalog(L"enumerate", false);
+	QueryPerformanceCounter(&t1);
+	if (logger)
+	{
+		wchar_t buf[200];
+		double ms = freq.QuadPart ? (double)(t1.QuadPart - t0.QuadPart) * 1000.0 / (double)freq.QuadPart : 0.0;
+		swprintf_s(buf, L"EnumerateFonts: total fonts=%d axes=%ls time=%.1fms (install %.1fms) faceCreates=%u",
+				   (int)g_fontList.size(), FONTPREVIEW_EAGER_AXES ? L"eager" : L"lazy", build.elapsedMs + ms, ms, (UINT)(g_axisFaceCreates - faceCreatesBefore));
 		logger->info(logger, buf);
 	}
 }
 
-//---------------------------------------------------------------------
-//	Filtering and selection
-//---------------------------------------------------------------------
-void UpdateDetailPanel();
-void RedrawGrid();
-void RebuildListViewItems();
-void RenderPreview(const wchar_t *reason = L"");
-bool EnsurePreviewDevice();
-bool CreateOrResizeSwapChain(HWND hwnd, int width, int height);
-void ReleasePreviewTarget();
+// Enumeration runs once per session on its own thread, so the window can
+// show the session snapshot meanwhile (see ShowSessionSnapshot). The
+// result is handed back with WM_FONT_CATALOG_READY.
+static std::thread g_enumerateThread;
+static std::mutex g_enumerateMutex;
+static std::unique_ptr<FontCatalogBuild> g_enumerateResult;
+
+static void StartFontEnumeration()
+{
+	if (!g_dwriteFactory || g_enumerateThread.joinable())
+		return;
+	// Files in the folder may have changed since the last scan; map them
+	// afresh. Collections still held by previews keep their old views.
+	{
+		std::lock_guard<std::mutex> lock(g_externalFontCollectionsMutex);
+		g_externalFontCollections.Clear();
+	}
+	ResetMappedFontFiles();
+	// The system collection is cheap to get and lets snapshot rows expand
+	// and resolve axes before enumeration is done.
+	if (FAILED(g_dwriteFactory->GetSystemFontCollection(&g_systemFontCollection)))
+		return;
+	if (g_fontFolderPath.empty())
+		g_fontFolderPath = GetDefaultFontFolder();
+	HWND hwnd = g_hwndMain;
+	g_enumerateThread = std::thread([hwnd, collection = g_systemFontCollection, folder = g_fontFolderPath]()
+									{
+		auto build = std::make_unique<FontCatalogBuild>();
+		BuildFontCatalog(collection.Get(), folder, *build);
+		{
+			std::lock_guard<std::mutex> lock(g_enumerateMutex);
+			g_enumerateResult = std::move(build);
+		}
+		PostMessageW(hwnd, WM_FONT_CATALOG_READY, 0, 0); });
+}
+
+// The enumerated catalog, once; null until the thread has finished.
+static std::unique_ptr<FontCatalogBuild> TakeEnumeratedCatalog()
+{
+	std::unique_ptr<FontCatalogBuild> build;
+	{
+		std::lock_guard<std::mutex> lock(g_enumerateMutex);
+		build = std::move(g_enumerateResult);
+	}
+	if (build && g_enumerateThread.joinable())
+		g_enumerateThread.join();
+	return build;
+}
+
+static void StopFontEnumeration()
+{
+	if (g_enumerateThread.joinable())
+		g_enumerateThread.join();
+	std::lock_guard<std::mutex> lock(g_enumerateMutex);
+	g_enumerateResult.reset();
+}
+
+//---------------------------------------------------------------------
+//	Per-face expansion
+//---------------------------------------------------------------------
+// Pick the ja-jp string, then en-us, then the first entry.
+static bool GetLocalizedName(IDWriteLocalizedStrings *names, std::wstring &out)
+{
+	if (!names)
+		return false;
+	UINT32 index = 0;
+	BOOL exists = FALSE;
+	if (FAILED(names->FindLocaleName(L"ja-jp", &index, &exists)) || !exists)
+		names->FindLocaleName(L"en-us", &index, &exists);
+	if (!exists)
+		index = 0;
+	UINT32 length = 0;
+	if (FAILED(names->GetStringLength(index, &length)))
+		return false;
+	out.assign(length + 1, L'\0');
+	if (FAILED(names->GetString(index, &out[0], length + 1)))
+	{
+		out.clear();
+		return false;
+	}
+	out.resize(length);
+	return true;
+}
+
+// Identity needed to enumerate a family's faces off the UI thread. Copied
+// out of FontItem so workers never touch g_fontList.
+struct FamilyFaceRequest
+{
+	int fontIndex = -1;
+	UINT generation = 0;
+	std::wstring family;
+	std::wstring filePath;
+	bool isSystemFont = true;
+	UINT32 faceIndex = 0;
+	ComPtr<IDWriteFontCollection> systemCollection;
+};
+
+// Enumerate every font of a system family, or every font backed by the
+// row's face index for folder fonts (which includes fvar named instances).
+static uint64_t HashFontFace(const FontFaceEntry &face)
+{
+	uint64_t h = FontHash::Hash64(face.axisValues.data(), face.axisValues.size() * sizeof(DWRITE_FONT_AXIS_VALUE));
+	uint32_t style[4] = {(uint32_t)face.weight, (uint32_t)face.stretch, (uint32_t)face.style, face.simulated ? 1u : 0u};
+	return FontHash::Hash64(style, sizeof(style), h) | 1;
+}
+
+static void EnumerateFamilyFaces(const FamilyFaceRequest &req, std::vector<FontFaceEntry> &outFaces)
+{
+	FP_TRACE_SCOPE("FaceEnumerate");
+	ComPtr<IDWriteFontCollection> collection = req.systemCollection;
+	if (!req.isSystemFont)
+	{
+		ComPtr<IDWriteFontCollection1> external;
+		if (FAILED(GetOrCreateExternalFontCollection(req.filePath, &external)) || !external)
+			return;
+		collection = external;
+	}
+	if (!collection)
+		return;
+	UINT32 familyIndex = 0;
+	BOOL exists = FALSE;
+	if (FAILED(collection->FindFamilyName(req.family.c_str(), &familyIndex, &exists)) || !exists)
+		return;
+	ComPtr<IDWriteFontFamily> family;
+	if (FAILED(collection->GetFontFamily(familyIndex, &family)) || !family)
+		return;
+
+	UINT32 count = family->GetFontCount();
+	for (UINT32 i = 0; i < count; i++)
+	{
+		ComPtr<IDWriteFont> font;
+		if (FAILED(family->GetFont(i, &font)) || !font)
+			continue;
+		FontFaceEntry face;
+		face.weight = font->GetWeight();
+		face.stretch = font->GetStretch();
+		face.style = font->GetStyle();
+		face.simulated = font->GetSimulations() != DWRITE_FONT_SIMULATIONS_NONE;
+
+		ComPtr<IDWriteFont3> font3;
+		ComPtr<IDWriteFontFaceReference> faceRef;
+		if (SUCCEEDED(font.As(&font3)) && font3 && SUCCEEDED(font3->GetFontFaceReference(&faceRef)) && faceRef)
+		{
+			if (!req.isSystemFont && faceRef->GetFontFaceIndex() != req.faceIndex)
+				continue;
+			ComPtr<IDWriteFontFaceReference1> faceRef1;
+			if (SUCCEEDED(faceRef.As(&faceRef1)) && faceRef1)
+			{
+				UINT32 axisCount = faceRef1->GetFontAxisValueCount();
+				if (axisCount > 0)
+				{
+					face.axisValues.resize(axisCount);
+					if (FAILED(faceRef1->GetFontAxisValues(face.axisValues.data(), axisCount)))
+						face.axisValues.clear();
+				}
+			}
+		}
+
+		ComPtr<IDWriteLocalizedStrings> faceNames;
+		if (SUCCEEDED(font->GetFaceNames(&faceNames)) && faceNames)
+			GetLocalizedName(faceNames.Get(), face.faceName);
+		if (face.faceName.empty())
+			face.faceName = std::to_wstring((int)face.weight);
+		outFaces.push_back(std::move(face));
+	}
+	std::stable_sort(outFaces.begin(), outFaces.end(), [](const FontFaceEntry &a, const FontFaceEntry &b)
+					 {
+		if (a.stretch != b.stretch)
+			return a.stretch < b.stretch;
+		if (a.weight != b.weight)
+			return a.weight < b.weight;
+		return a.style < b.style; });
+	for (auto &face : outFaces)
+		face.styleHash = HashFontFace(face);
+}
+
+static size_t EstimateFaceListBytes(const std::vector<FontFaceEntry> &faces)
+{
+	size_t bytes = faces.capacity() * sizeof(FontFaceEntry);
+	for (const auto &face : faces)
+		bytes += face.faceName.capacity() * sizeof(wchar_t) + face.axisValues.capacity() * sizeof(DWRITE_FONT_AXIS_VALUE);
+	return bytes;
+}
+
+// Number of cached faces for a family, or -1 when not enumerated yet.
+static int GetFamilyFaceCount(int fontIndex)
+{
+	std::lock_guard<std::mutex> lock(g_familyFacesMutex);
+	auto it = g_familyFaces.find(fontIndex);
+	return it == g_familyFaces.end() ? -1 : (int)it->second.size();
+}
+
+static bool GetFamilyFace(int fontIndex, int faceIndex, FontFaceEntry &out)
+{
+	std::lock_guard<std::mutex> lock(g_familyFacesMutex);
+	auto it = g_familyFaces.find(fontIndex);
+	if (it == g_familyFaces.end() || faceIndex < 0 || faceIndex >= (int)it->second.size())
+		return false;
+	out = it->second[faceIndex];
+	return true;
+}
+
+// Like GetFamilyFace without the copy: `fn(const FontFaceEntry &)` runs
+// under the face lock, so it must not call back into the face cache.
+template <typename Fn>
+static bool WithFamilyFace(int fontIndex, int faceIndex, Fn &&fn)
+{
+	std::lock_guard<std::mutex> lock(g_familyFacesMutex);
+	auto it = g_familyFaces.find(fontIndex);
+	if (it == g_familyFaces.end() || faceIndex < 0 || faceIndex >= (int)it->second.size())
+		return false;
+	fn(it->second[faceIndex]);
+	return true;
+}
+
+// Queue face enumeration for a family unless it is cached or queued.
+// High priority is used when a family is expanded or selected, low priority
+// for viewport prefetch. Completion is signalled with WM_FONT_FACES_READY.
+static void RequestFamilyFaces(int fontIndex, TaskQueue::Priority priority)
+{
+	if (fontIndex < 0 || fontIndex >= (int)g_fontList.size())
+		return;
+	bool urgent = priority != TaskQueue::Priority::Low;
+	{
+		std::lock_guard<std::mutex> lock(g_familyFacesMutex);
+		if (g_familyFaces.count(fontIndex) != 0)
+			return;
+		if (!g_familyFacesPending.insert(fontIndex).second && !urgent)
+			return;
+	}
+
+	const FontItem &item = g_fontList[fontIndex];
+	FamilyFaceRequest req;
+	req.fontIndex = fontIndex;
+	req.generation = g_catalogGeneration;
+	req.family = item.familyName;
+	req.filePath = item.filePath;
+	req.isSystemFont = item.isSystemFont;
+	req.faceIndex = item.faceIndex;
+	req.systemCollection = g_systemFontCollection;
+	HWND notify = g_hwndMain;
+
+	auto task = [req, notify]()
+	{
+		{
+			std::lock_guard<std::mutex> lock(g_familyFacesMutex);
+			if (g_familyFaces.count(req.fontIndex) != 0)
+				return;
+		}
+		std::vector<FontFaceEntry> faces;
+		EnumerateFamilyFaces(req, faces);
+		{
+			std::lock_guard<std::mutex> lock(g_familyFacesMutex);
+			if (req.generation != g_catalogGeneration)
+				return;
+			g_familyFacesBytes += EstimateFaceListBytes(faces);
+			g_familyFaces[req.fontIndex] = std::move(faces);
+			g_familyFacesPending.erase(req.fontIndex);
+		}
+		if (notify)
+			PostMessageW(notify, WM_FONT_FACES_READY, (WPARAM)req.fontIndex, (LPARAM)req.generation);
+	};
+	if (!g_backgroundTasks.Post(priority, urgent ? kTaskTagFaceExpand : kTaskTagFacePrefetch, task))
+		task();
+}
+
+// Drop queued viewport prefetch (e.g. the filter changed and the rows it
+// was warming are gone). Explicit expand requests are kept.
+static void CancelFacePrefetch()
+{
+	if (g_backgroundTasks.Cancel(kTaskTagFacePrefetch) == 0)
+		return;
+	std::lock_guard<std::mutex> lock(g_familyFacesMutex);
+	g_familyFacesPending.clear();
+}
+
+// Forget every cached face; called when the catalog is rebuilt because
+// family indices are only valid for one catalog.
+static void ResetFamilyFaces()
+{
+	g_backgroundTasks.Cancel(kTaskTagFaceExpand);
+	g_backgroundTasks.Cancel(kTaskTagFacePrefetch);
+	std::lock_guard<std::mutex> lock(g_familyFacesMutex);
+	g_catalogGeneration++;
+	g_familyFaces.clear();
+	g_familyFacesBytes = 0;
+	g_familyFacesPending.clear();
+	g_expandedFamilies.clear();
+	g_listRows.clear();
+	g_selectedFaceIndex = -1;
+}
+
+//---------------------------------------------------------------------
+//	Lazy axis metadata
+//---------------------------------------------------------------------
+// Identity needed to open one face off the UI thread.
+struct FontAxesRequest
+{
+	int fontIndex = -1;
+	UINT generation = 0;
+	std::wstring sourcePath;
+	UINT32 faceIndex = 0;
+	std::wstring family;
+	ComPtr<IDWriteFontCollection> systemCollection;
+};
+
+static FontAxesRequest MakeFontAxesRequest(int fontIndex)
+{
+	const FontItem &item = g_fontList[fontIndex];
+	FontAxesRequest req;
+	req.fontIndex = fontIndex;
+	req.generation = g_catalogGeneration;
+	req.sourcePath = item.sourcePath;
+	req.faceIndex = item.faceIndex;
+	req.family = item.familyName;
+	if (item.isSystemFont)
+		req.systemCollection = g_systemFontCollection;
+	return req;
+}
+
+// Which of the catalog API's coverage scripts the face has glyphs for.
+static uint32_t ProbeCoverage(IDWriteFontFace *face)
+{
+	UINT32 codepoints[CatalogApi::kCoverageProbeCount];
+	UINT16 glyphs[CatalogApi::kCoverageProbeCount] = {};
+	for (size_t i = 0; i < CatalogApi::kCoverageProbeCount; i++)
+		codepoints[i] = CatalogApi::kCoverageProbes[i].codepoint;
+	if (FAILED(face->GetGlyphIndices(codepoints, (UINT32)CatalogApi::kCoverageProbeCount, glyphs)))
+		return 0;
+	uint32_t coverage = 0;
+	for (size_t i = 0; i < CatalogApi::kCoverageProbeCount; i++)
+	{
+		if (glyphs[i] != 0)
+			coverage |= CatalogApi::kCoverageProbes[i].flag;
+	}
+	return coverage;
+}
+
+// Create the face from its backing file when known; system fonts served by
+// a non-local loader fall back to the family's first matching font. Script
+// coverage is read from the same face.
+static void ResolveFontAxes(const FontAxesRequest &req, FontItem &out)
+{
+	FP_TRACE_SCOPE("AxisResolve");
+	ComPtr<IDWriteFontFace> face;
+	if (!req.sourcePath.empty())
+	{
+		ComPtr<IDWriteFontFile> fontFile;
+		BOOL isSupported = FALSE;
+		DWRITE_FONT_FILE_TYPE fileType;
+		DWRITE_FONT_FACE_TYPE faceType;
+		UINT32 faceCount = 0;
+		IDWriteFontFile *files[1] = {};
+		// Folder and pack fonts go through the mapped loader so the axis
+		// pass shares the views the catalog scan opened.
+		HRESULT hr = req.systemCollection ? g_dwriteFactory->CreateFontFileReference(req.sourcePath.c_str(), nullptr, &fontFile)
+										  : CreateMappedFontFileReference(req.sourcePath, &fontFile);
+		if (SUCCEEDED(hr) &&
+			SUCCEEDED(fontFile->Analyze(&isSupported, &fileType, &faceType, &faceCount)) && isSupported)
+		{
+			files[0] = fontFile.Get();
+			g_dwriteFactory->CreateFontFace(faceType, 1, files, req.faceIndex, DWRITE_FONT_SIMULATIONS_NONE, &face);
+		}
+	}
+	if (!face && req.systemCollection)
+	{
+		UINT32 familyIndex = 0;
+		BOOL exists = FALSE;
+		ComPtr<IDWriteFontFamily> family;
+		ComPtr<IDWriteFont> font;
+		if (SUCCEEDED(req.systemCollection->FindFamilyName(req.family.c_str(), &familyIndex, &exists)) && exists &&
+			SUCCEEDED(req.systemCollection->GetFontFamily(familyIndex, &family)) &&
+			SUCCEEDED(family->GetFirstMatchingFont(DWRITE_FONT_WEIGHT_NORMAL, DWRITE_FONT_STRETCH_NORMAL, DWRITE_FONT_STYLE_NORMAL, &font)))
+		{
+			font->CreateFontFace(&face);
+		}
+	}
+	g_axisResolves++;
+	if (!face)
+		return;
+	g_axisFaceCreates++;
+	out.coverage = ProbeCoverage(face.Get());
+	ComPtr<IDWriteFontFace5> face5;
+	if (SUCCEEDED(face.As(&face5)) && face5)
+		CollectFontAxes(out, face5.Get());
+}
+
+// Worker side: resolve one font and park the result for the UI thread.
+// False when the catalog changed meanwhile.
+static bool ParkFontAxesResult(const FontAxesRequest &req)
+{
+	FontItem resolved;
+	ResolveFontAxes(req, resolved);
+	std::lock_guard<std::mutex> lock(g_fontAxesMutex);
+	if (req.generation != g_catalogGeneration)
+		return false;
+	FontAxesResult &result = g_fontAxesResults[req.fontIndex];
+	result.generation = req.generation;
+	result.axisTags = std::move(resolved.axisTags);
+	result.axisRanges = std::move(resolved.axisRanges);
+	result.axisDefaults = std::move(resolved.axisDefaults);
+	result.coverage = resolved.coverage;
+	return true;
+}
+
+// Queue axis resolution for one font. High priority for the selected font
+// (detail panel), low priority for rows that just became visible.
+static void RequestFontAxes(int fontIndex, TaskQueue::Priority priority)
+{
+	if (fontIndex < 0 || fontIndex >= (int)g_fontList.size() || g_fontList[fontIndex].axesResolved)
+		return;
+	bool urgent = priority != TaskQueue::Priority::Low;
+	auto pending = g_fontAxesPending.find(fontIndex);
+	if (pending != g_fontAxesPending.end() && (pending->second || !urgent))
+		return;
+	g_fontAxesPending[fontIndex] = urgent;
+
+	FontAxesRequest req = MakeFontAxesRequest(fontIndex);
+	HWND notify = g_hwndMain;
+	auto task = [req, notify]()
+	{
+		if (ParkFontAxesResult(req) && notify)
+			PostMessageW(notify, WM_FONT_AXES_READY, (WPARAM)req.fontIndex, (LPARAM)req.generation);
+	};
+	if (!g_backgroundTasks.Post(priority, urgent ? kTaskTagAxesSelect : kTaskTagAxesPrefetch, task))
+		task();
+}
+
+// Move a finished result into g_fontList. Returns false when the result is
+// stale or has already been applied.
+static bool ApplyFontAxesResult(int fontIndex, UINT generation)
+{
+	if (generation != g_catalogGeneration || fontIndex < 0 || fontIndex >= (int)g_fontList.size())
+		return false;
+	FontAxesResult result;
+	{
+		std::lock_guard<std::mutex> lock(g_fontAxesMutex);
+		auto it = g_fontAxesResults.find(fontIndex);
+		if (it == g_fontAxesResults.end() || it->second.generation != generation)
+			return false;
+		result = std::move(it->second);
+		g_fontAxesResults.erase(it);
+	}
+	FontItem &item = g_fontList[fontIndex];
+	if (item.axesResolved) // the detail pass and a row request both ran
+		return false;
+	item.axisTags = std::move(result.axisTags);
+	item.axisRanges = std::move(result.axisRanges);
+	item.axisDefaults = std::move(result.axisDefaults);
+	item.coverage = result.coverage;
+	item.axesResolved = true;
+	UpdateAxisDisplayStrings(item);
+	g_fontAxesPending.erase(fontIndex);
+	InvalidateCatalogEntry(fontIndex);
+	return true;
+}
+
+static void CancelFontAxesPrefetch()
+{
+	if (g_backgroundTasks.Cancel(kTaskTagAxesPrefetch) == 0)
+		return;
+	for (auto it = g_fontAxesPending.begin(); it != g_fontAxesPending.end();)
+	{
+		if (!it->second)
+			it = g_fontAxesPending.erase(it);
+		else
+			++it;
+	}
+}
+
+// Called after ResetFamilyFaces has advanced g_catalogGeneration.
+static void ResetFontAxes()
+{
+	g_catalogDetails.Stop();
+	g_backgroundTasks.Cancel(kTaskTagAxesSelect);
+	g_backgroundTasks.Cancel(kTaskTagAxesPrefetch);
+	g_fontAxesPending.clear();
+	std::lock_guard<std::mutex> lock(g_fontAxesMutex);
+	g_fontAxesResults.clear();
+}
+
+// FONTPREVIEW_EAGER_AXES: resolve everything on the calling thread.
+static void ResolveAllFontAxesNow()
+{
+	for (int i = 0; i < (int)g_fontList.size(); i++)
+	{
+		FontItem &item = g_fontList[i];
+		ResolveFontAxes(MakeFontAxesRequest(i), item);
+		item.axesResolved = true;
+		UpdateAxisDisplayStrings(item);
+	}
+}
+
+//---------------------------------------------------------------------
+//	Catalog API
+//---------------------------------------------------------------------
+// Other plugins read the catalog through GetFontCatalogApi (see
+// FontCatalogApi.h / CatalogApi.h) instead of enumerating fonts again. The
+// UI thread keeps one immutable entry per font and publishes a new snapshot
+// after each enumeration; entries whose axes and coverage resolved later
+// are rebuilt and published together, at most every
+// kCatalogPublishDelayMs, so scrolling through unresolved rows does not
+// publish per row. Once a client has acquired or subscribed, the detail
+// pass resolves every font (see StartCatalogDetails).
+constexpr UINT_PTR kCatalogPublishTimerId = 3;
+constexpr UINT kCatalogPublishDelayMs = 250;
+
+static std::vector<std::shared_ptr<const CatalogApi::Entry>> g_catalogEntries; // parallel to g_fontList
+static bool g_catalogPublishPending = false;
+
+// Resolve the axes and coverage of every unresolved font on the detail
+// pass's thread, so clients get them even while the window is hidden (the
+// row-driven requests are low priority and held back then). Results go
+// through the same ApplyFontAxesResult and publish timer as row requests.
+// Runs after each publish of a new catalog and on WM_CATALOG_CLIENT.
+static void StartCatalogDetails()
+{
+	if (!g_hwndMain || !CatalogApi::Global().HasClient())
+		return;
+	auto requests = std::make_shared<std::vector<FontAxesRequest>>();
+	for (int i = 0; i < (int)g_fontList.size(); i++)
+	{
+		if (!g_fontList[i].axesResolved)
+			requests->push_back(MakeFontAxesRequest(i));
+	}
+	if (requests->empty())
+		return;
+	HWND notify = g_hwndMain;
+	g_catalogDetails.Start(requests->size(), [requests, notify](size_t i)
+						   {
+		const FontAxesRequest &req = (*requests)[i];
+		// One message for however many results land before the UI thread
+		// gets to it: a large catalog would overflow the message queue.
+		if (ParkFontAxesResult(req) && !g_catalogDetailsPosted.exchange(true))
+			PostMessageW(notify, WM_CATALOG_DETAILS_READY, 0, 0); });
+	FP_LOG(logger, Info, kCatEnum, L"CatalogApi: resolving details of %u fonts", (UINT)requests->size());
+}
+
+// WM_CATALOG_DETAILS_READY: apply what the detail pass parked so far. A
+// message posted for an older catalog still collects the current one's
+// results, which may have been parked while the flag was set.
+static void HandleCatalogDetailsReady()
+{
+	g_catalogDetailsPosted = false;
+	UINT generation = g_catalogGeneration;
+	std::vector<int> ready;
+	{
+		std::lock_guard<std::mutex> lock(g_fontAxesMutex);
+		for (const auto &result : g_fontAxesResults)
+		{
+			if (result.second.generation == generation)
+				ready.push_back(result.first);
+		}
+	}
+	for (int fontIndex : ready)
+		HandleFontAxesReady(fontIndex, generation);
+}
+
+// `sameFonts`: g_fontList was not rebuilt since the last publish, only
+// details of some fonts changed.
+static void PublishCatalog(const wchar_t *reason, bool sameFonts)
+{
+	FP_TRACE_SCOPE("CatalogPublish");
+	if (g_catalogPublishPending && g_hwndMain)
+		KillTimer(g_hwndMain, kCatalogPublishTimerId);
+	g_catalogPublishPending = false;
+	if (!sameFonts)
+		g_catalogEntries.clear();
+	g_catalogEntries.resize(g_fontList.size());
+	UINT rebuilt = 0;
+	for (size_t i = 0; i < g_fontList.size(); i++)
+	{
+		if (!g_catalogEntries[i])
+		{
+			g_catalogEntries[i] = CatalogApi::MakeEntry(g_fontList[i]);
+			rebuilt++;
+		}
+	}
+	uint64_t serial = CatalogApi::Global().Publish(g_catalogEntries, sameFonts);
+	FP_LOG(logger, Info, kCatEnum, L"CatalogApi[%ls]: serial=%llu entries=%u rebuilt=%u subscribers=%u", reason, (unsigned long long)serial,
+		   (UINT)g_catalogEntries.size(), rebuilt, (UINT)CatalogApi::Global().Subscribers());
+	if (!sameFonts)
+		StartCatalogDetails();
+}
+
+// A font's details changed: rebuild its entry with the next publish.
+static void InvalidateCatalogEntry(int fontIndex)
+{
+	if (fontIndex < 0 || fontIndex >= (int)g_catalogEntries.size())
+		return;
+	g_catalogEntries[fontIndex].reset();
+	if (!g_catalogPublishPending && g_hwndMain && SetTimer(g_hwndMain, kCatalogPublishTimerId, kCatalogPublishDelayMs, nullptr))
+		g_catalogPublishPending = true;
+}
+
+//---------------------------------------------------------------------
+//	Filtering and selection
+//---------------------------------------------------------------------
+void UpdateDetailPanel();
+static void MarkDirty(DirtyState::Action action, uint32_t regions, int row = -1);
+void RebuildListViewItems();
+void RenderPreview(const wchar_t *reason = L"");
+static void CancelPreviewPrefetch();
+bool EnsurePreviewDevice();
+bool CreateOrResizeSwapChain(HWND hwnd, int width, int height);
+void ReleasePreviewTarget();
+
+static void ShowFilteredFonts();
+
+// Catalog members of the working set (see "Favorites and recent fonts"),
+// rebuilt with every catalog install and change.
+static FontPreviewCore::CatalogBits g_favoriteBits;
+static FontPreviewCore::CatalogBits g_recentBits;
+
+void ApplyFilter()
+{
+	FP_TRACE_SCOPE("ApplyFilter");
+	FP_LOG_VERBOSE(logger, kCatFilter, L"ApplyFilter: query='%ls'", g_searchQuery.c_str());
+	const FontPreviewCore::CatalogBits *members = g_filterType == FontTypeFilter::Recent ? &g_recentBits : &g_favoriteBits;
+	FontPreviewCore::FilterCatalog(g_fontList, g_filterType, g_searchQuery, g_filteredIndices, members);
+	ShowFilteredFonts();
+}
+
+// The rest of ApplyFilter, also used when the filtered set comes from the
+// session snapshot: drop prefetches for rows that are gone, keep or move
+// the selection, and rebuild the rows.
+static void ShowFilteredFonts()
+{
+	CancelFacePrefetch();
+	CancelFontAxesPrefetch();
+	CancelPreviewPrefetch();
+	FontPreviewCore::ReconcileSelection(g_filteredIndices, g_selectedFontIndex, g_selectedFaceIndex);
+	RebuildListViewItems();
+	MarkDirty(DirtyState::Action::Filter, DirtyState::Detail | DirtyState::Preview);
+	FP_LOG(logger, Info, kCatFilter, L"ApplyFilter: filtered=%d", (int)g_filteredIndices.size());
+}
+
+// Expand g_filteredIndices into g_listRows, inserting the cached faces of
+// expanded families right below their family row.
+static void BuildListRows()
+{
+	std::lock_guard<std::mutex> lock(g_familyFacesMutex);
+	FontPreviewCore::BuildListRows(g_filteredIndices, [](int fontIdx)
+								   {
+		if (g_expandedFamilies.count(fontIdx) == 0)
+			return 0;
+		auto it = g_familyFaces.find(fontIdx);
+		return it == g_familyFaces.end() ? 0 : (int)it->second.size(); }, g_listRows);
+}
+
+static int FindListRow(int fontIndex, int faceIndex)
+{
+	return FontPreviewCore::FindListRow(g_listRows, fontIndex, faceIndex);
+}
+
+// Rebuild rows and resize the owner-data ListView. When `revealSelection`
+// is false the scroll position is kept (background face results). The
+// visible rows are repainted by the next invalidation flush, on behalf of
+// `action`.
+static void RefreshListRows(bool revealSelection, DirtyState::Action action)
+{
+	FP_TRACE_SCOPE("RebuildListViewItems");
+	if (!g_hwndGrid)
+		return;
+	BuildListRows();
+	ListView_SetItemCountEx(g_hwndGrid, (int)g_listRows.size(), LVSICF_NOSCROLL | LVSICF_NOINVALIDATEALL);
+	MarkDirty(action, DirtyState::ListAll);
+	ListView_SetItemState(g_hwndGrid, -1, 0, LVIS_SELECTED | LVIS_FOCUSED);
+	int row = FindListRow(g_selectedFontIndex, g_selectedFaceIndex);
+	if (row >= 0)
+	{
+		ListView_SetItemState(g_hwndGrid, row, LVIS_SELECTED | LVIS_FOCUSED, LVIS_SELECTED | LVIS_FOCUSED);
+		if (revealSelection)
+			ListView_EnsureVisible(g_hwndGrid, row, FALSE);
+	}
+	FP_LOG_VERBOSE(logger, kCatList, L"RebuildListViewItems: families=%d rows=%d", (int)g_filteredIndices.size(), (int)g_listRows.size());
+}
+
+void RebuildListViewItems()
+{
+	RefreshListRows(true, DirtyState::Action::Filter);
+}
+
+// LVN_GETDISPINFOW: family rows carry an expand marker (and ★ for
+// favorites), face rows are indented and show the style name.
+static void FillListRowText(NMLVDISPINFOW *info)
+{
+	if ((info->item.mask & LVIF_TEXT) == 0 || !info->item.pszText || info->item.cchTextMax <= 0)
+		return;
+	info->item.pszText[0] = L'\0';
+	int row = info->item.iItem;
+	if (row < 0 || row >= (int)g_listRows.size())
+		return;
+	const ListRow &lr = g_listRows[row];
+	if (lr.fontIndex < 0 || lr.fontIndex >= (int)g_fontList.size())
+		return;
+	if (lr.faceIndex < 0)
+	{
+		int faceCount = GetFamilyFaceCount(lr.fontIndex);
+		const wchar_t *marker = L"▸ ";
+		if (faceCount == 1)
+			marker = L"   ";
+		else if (g_expandedFamilies.count(lr.fontIndex) != 0)
+			marker = L"▾ ";
+		const FontItem &item = g_fontList[lr.fontIndex];
+		const wchar_t *favorite = FontPreviewCore::TestBit(g_favoriteBits, (size_t)lr.fontIndex) ? L"★ " : L"";
+		_snwprintf_s(info->item.pszText, info->item.cchTextMax, _TRUNCATE, L"%ls%ls%ls%ls%ls", marker, favorite, item.displayName.c_str(),
+					 item.axisTagLine.empty() ? L"" : L"  ", item.axisTagLine.c_str());
+		return;
+	}
+	WithFamilyFace(lr.fontIndex, lr.faceIndex, [&](const FontFaceEntry &face)
+				   { _snwprintf_s(info->item.pszText, info->item.cchTextMax, _TRUNCATE, L"      %ls  (%d)%ls",
+								  face.faceName.c_str(), (int)face.weight, face.simulated ? L" (疑似)" : L""); });
+}
+
+// LVN_ODCACHEHINT: warm face lists and axis metadata for the visible range
+// plus a margin so expanding a family usually finds its faces enumerated.
+static void PrefetchFacesForRows(int from, int to)
+{
+	int count = (int)g_listRows.size();
+	if (count == 0)
+		return;
+	from = (std::max)(0, from - kFacePrefetchMargin);
+	to = (std::min)(count - 1, to + kFacePrefetchMargin);
+	for (int row = from; row <= to; row++)
+	{
+		const ListRow &lr = g_listRows[row];
+		if (lr.faceIndex >= 0)
+			continue;
+		RequestFamilyFaces(lr.fontIndex, TaskQueue::Priority::Low);
+		RequestFontAxes(lr.fontIndex, TaskQueue::Priority::Low);
+	}
+}
+
+static void SetFamilyExpanded(int fontIndex, bool expand)
+{
+	if (fontIndex < 0 || fontIndex >= (int)g_fontList.size())
+		return;
+	bool changed;
+	if (expand)
+	{
+		changed = g_expandedFamilies.insert(fontIndex).second;
+		RequestFamilyFaces(fontIndex, TaskQueue::Priority::High);
+	}
+	else
+	{
+		changed = g_expandedFamilies.erase(fontIndex) != 0;
+	}
+	if (!changed)
+		return;
+	bool faceDropped = !expand && fontIndex == g_selectedFontIndex && g_selectedFaceIndex >= 0;
+	if (faceDropped)
+		g_selectedFaceIndex = -1;
+	RefreshListRows(false, DirtyState::Action::Expand);
+	if (faceDropped)
+		MarkDirty(DirtyState::Action::Expand, DirtyState::Detail | DirtyState::Preview);
+}
+
+// WM_FONT_AXES_READY: repaint the family row and refresh the detail panel.
+static void HandleFontAxesReady(int fontIndex, UINT generation)
+{
+	if (!ApplyFontAxesResult(fontIndex, generation))
+		return;
+	int row = FindListRow(fontIndex, -1);
+	if (row >= 0)
+		MarkDirty(DirtyState::Action::AxesReady, DirtyState::ListRows, row);
+	if (fontIndex == g_selectedFontIndex)
+		MarkDirty(DirtyState::Action::AxesReady, DirtyState::Detail);
+	FP_LOG_VERBOSE(logger, kCatTask, L"FontAxes: resolved font=%d axes=%d (resolves=%u faceCreates=%u)", fontIndex,
+				   (int)g_fontList[fontIndex].axisTags.size(), (UINT)g_axisResolves, (UINT)g_axisFaceCreates);
+}
+
+static void HandleCompareFacesReady(int fontIndex);
+
+// WM_FONT_FACES_READY: results from a background face enumeration.
+static void HandleFamilyFacesReady(int fontIndex, UINT generation)
+{
+	if (generation != g_catalogGeneration)
+		return;
+	if (g_expandedFamilies.count(fontIndex) != 0)
+	{
+		RefreshListRows(false, DirtyState::Action::FacesReady);
+	}
+	else
+	{
+		int row = FindListRow(fontIndex, -1);
+		if (row >= 0)
+			MarkDirty(DirtyState::Action::FacesReady, DirtyState::ListRows, row);
+	}
+	if (fontIndex == g_selectedFontIndex)
+		MarkDirty(DirtyState::Action::FacesReady, DirtyState::Detail);
+	HandleCompareFacesReady(fontIndex);
+}
+
+bool EnsurePreviewDevice()
+{
+	if (g_d3dDevice && g_d3dContext && g_d2dFactory && g_d2dDevice && g_d2dContext)
+		return true;
+	UINT flags = D3D11_CREATE_DEVICE_BGRA_SUPPORT;
+#if defined(_DEBUG)
+	flags |= D3D11_CREATE_DEVICE_DEBUG;
+#endif
+	D3D_FEATURE_LEVEL levels[] = {
+		D3D_FEATURE_LEVEL_11_1,
+		D3D_FEATURE_LEVEL_11_0,
+		D3D_FEATURE_LEVEL_10_1,
+		D3D_FEATURE_LEVEL_10_0,
+	};
+	ComPtr<ID3D11Device> device;
+	ComPtr<ID3D11DeviceContext> context;
+	HRESULT hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, flags, levels, _countof(levels), D3D11_SDK_VERSION, &device, &g_featureLevel, &context);
+	if (FAILED(hr))
+	{
+		if (logger)
+		{
+			wchar_t buf[128];
+			swprintf_s(buf, L"D3D11CreateDevice failed: 0x%08x", hr);
+			logger->warn(logger, buf);
+		}
+		return false;
+	}
+	g_d3dDevice = device;
+	g_d3dContext = context;
+	ComPtr<IDXGIDevice> dxgiDevice;
+	if (FAILED(g_d3dDevice.As(&dxgiDevice)))
+		return false;
+	D2D1_FACTORY_OPTIONS opts{};
+	if (FAILED(D2D1CreateFactory(D2D1_FACTORY_TYPE_MULTI_THREADED, __uuidof(ID2D1Factory1), &opts, &g_d2dFactory)))
+		return false;
+	if (FAILED(g_d2dFactory->CreateDevice(dxgiDevice.Get(), &g_d2dDevice)))
+		return false;
+	if (FAILED(g_d2dDevice->CreateDeviceContext(D2D1_DEVICE_CONTEXT_OPTIONS_NONE, &g_d2dContext)))
+		return false;
+	if (logger)
+		logger->info(logger, L"Preview: D3D11/D2D initialized");
+	return true;
+}
+
+void ReleasePreviewTarget()
+{
+	if (g_d2dContext)
+	{
+		g_d2dContext->SetTarget(nullptr);
+	}
+	g_d2dTarget.Reset();
+}
+
+bool CreateOrResizeSwapChain(HWND hwnd, int width, int height)
+{
+	FP_TRACE_SCOPE("SwapChainResize");
+	if (!hwnd || width <= 0 || height <= 0)
+		return false;
+	FP_LOG_VERBOSE_RATE(logger, kCatRender, kPerFrameLogIntervalMs, L"CreateOrResizeSwapChain: hwnd=%p size=%dx%d", (void *)hwnd, width, height);
+	if (!EnsurePreviewDevice())
+	{
+		if (logger)
+			logger->warn(logger, L"CreateOrResizeSwapChain: EnsurePreviewDevice failed");
+		return false;
+	}
+	ReleasePreviewTarget();
+	ComPtr<IDXGIDevice> dxgiDevice;
+	if (FAILED(g_d3dDevice.As(&dxgiDevice)))
+	{
+		if (logger)
+			logger->warn(logger, L"CreateOrResizeSwapChain: As IDXGIDevice failed");
+		return false;
+	}
+	ComPtr<IDXGIAdapter> adapter;
+	if (FAILED(dxgiDevice->GetAdapter(&adapter)))
+	{
+		if (logger)
+			logger->warn(logger, L"CreateOrResizeSwapChain: GetAdapter failed");
+		return false;
+	}
+	ComPtr<IDXGIFactory2> factory;
+	if (FAILED(adapter->GetParent(__uuidof(IDXGIFactory2), &factory)))
+	{
+		if (logger)
+			logger->warn(logger, L"CreateOrResizeSwapChain: GetParent IDXGIFactory2 failed");
+		return false;
+	}
+
+	if (!g_swapChain)
+	{
+		DXGI_SWAP_CHAIN_DESC1 desc{};
+		desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+		desc.Width = width;
+		desc.Height = height;
+		desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+		desc.SampleDesc.Count = 1;
+		desc.BufferCount = 2;
+		desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+		desc.AlphaMode = DXGI_ALPHA_MODE_IGNORE;
+		HRESULT hr = factory->CreateSwapChainForHwnd(g_d3dDevice.Get(), hwnd, &desc, nullptr, nullptr, &g_swapChain);
+		if (FAILED(hr))
+		{
+			if (logger)
+			{
+				wchar_t buf[160];
+				swprintf_s(buf, L"CreateSwapChainForHwnd failed 0x%08x", hr);
+				logger->warn(logger, buf);
+			}
+			return false;
+		}
+		factory->MakeWindowAssociation(hwnd, DXGI_MWA_NO_ALT_ENTER);
+	}
+	else
+	{
+		HRESULT hr = g_swapChain->ResizeBuffers(0, width, height, DXGI_FORMAT_UNKNOWN, 0);
+		if (FAILED(hr))
+		{
+			if (logger)
+			{
+				wchar_t buf[160];
+				swprintf_s(buf, L"ResizeBuffers failed 0x%08x", hr);
+				logger->warn(logger, buf);
+			}
+			// Drop the swapchain to force recreate next time; stale target may hold references
+			g_swapChain.Reset();
+			return false;
+		}
+	}
+
+	ComPtr<IDXGISurface> surface;
+	HRESULT hr = g_swapChain->GetBuffer(0, __uuidof(IDXGISurface), &surface);
+	if (FAILED(hr))
+	{
+		if (logger)
+		{
+			wchar_t buf[160];
+			swprintf_s(buf, L"GetBuffer failed 0x%08x", hr);
+			logger->warn(logger, buf);
+		}
+		return false;
+	}
+	D2D1_BITMAP_PROPERTIES1 props = D2D1::BitmapProperties1(
+		D2D1_BITMAP_OPTIONS_TARGET | D2D1_BITMAP_OPTIONS_CANNOT_DRAW,
+		D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_IGNORE),
+		96.0f, 96.0f);
+	hr = g_d2dContext->CreateBitmapFromDxgiSurface(surface.Get(), &props, &g_d2dTarget);
+	if (FAILED(hr))
+	{
+		if (logger)
+		{
+			wchar_t buf[160];
+			swprintf_s(buf, L"CreateBitmapFromDxgiSurface failed 0x%08x", hr);
+			logger->warn(logger, buf);
+		}
+		return false;
+	}
+	g_d2dContext->SetTarget(g_d2dTarget.Get());
+	FP_LOG_VERBOSE_RATE(logger, kCatRender, kPerFrameLogIntervalMs, L"CreateOrResizeSwapChain: target set successfully");
+	return true;
+}
+
+// Render the GPU-backed preview area into the preview HWND's swapchain.
+// This function creates/resizes the swap chain as needed, clears with
+// `g_previewBgColor`, draws sample text using DirectWrite/Direct2D,
+// and presents the buffer. It guards against re-entrant calls.
+// Face rows with axis coordinates (variable named instances) go through the
+// IDWriteFactory6 axis overload; everything else uses weight/style/stretch.
+static HRESULT CreatePreviewTextFormat(const std::wstring &family, IDWriteFontCollection *collection, const FontFaceEntry *face, FLOAT size, IDWriteTextFormat **outFormat)
+{
+	if (face && !face->axisValues.empty())
+	{
+		ComPtr<IDWriteTextFormat3> format3;
+		HRESULT hr = g_dwriteFactory->CreateTextFormat(family.c_str(), collection, face->axisValues.data(), (UINT32)face->axisValues.size(), size, L"ja-jp", &format3);
+		if (SUCCEEDED(hr))
+		{
+			*outFormat = format3.Detach();
+			return S_OK;
+		}
+	}
+	DWRITE_FONT_WEIGHT weight = face ? face->weight : DWRITE_FONT_WEIGHT_NORMAL;
+	DWRITE_FONT_STYLE style = face ? face->style : DWRITE_FONT_STYLE_NORMAL;
+	DWRITE_FONT_STRETCH stretch = face ? face->stretch : DWRITE_FONT_STRETCH_NORMAL;
+	return g_dwriteFactory->CreateTextFormat(family.c_str(), collection, weight, style, stretch, size, L"ja-jp", outFormat);
+}
+
+//---------------------------------------------------------------------
+//	Preview layout prefetch
+//---------------------------------------------------------------------
+// Text formats/layouts for the rows around the selection are built on the
+// background queue so arrow-key browsing only has to draw. Layouts depend on
+// the sample text and preview size; when either changes (or the catalog is
+// rebuilt) the whole cache is dropped.
+constexpr int kPreviewPrefetchRadius = 4;
+constexpr size_t kPreviewLayoutCacheBytes = 16u * 1024u * 1024u;
+
+struct PreviewLayout
+{
+	ComPtr<IDWriteTextLayout> layout;
+	bool prefetched = false;
+};
+
+struct PreviewLayoutJob
+{
+	int fontIndex = -1;
+	int faceIndex = -1;
+	uint64_t layoutKey = 0; // PreviewLayoutKey, or an axis instance key
+	UINT generation = 0;
+	std::wstring family;
+	std::wstring filePath;
+	bool isSystemFont = true;
+	bool hasFace = false;
+	FontFaceEntry face;
+	std::wstring text;
+	FLOAT width = 0.0f;
+	FLOAT height = 0.0f;
+	FLOAT fontSize = 48.0f; // DIPs
+	bool wrap = true;
+	bool autoFit = false; // single-line preview sizes itself to the box (ApplyAutoFit)
+};
+
+struct PreviewPrefetchStats
+{
+	UINT issued = 0;
+	UINT completed = 0;
+	UINT cancelled = 0;
+	UINT prefetchedHits = 0;
+	UINT renders = 0;
+};
+
+// Keyed by catalog index and guarded by build generations; see LayoutCache.h.
+// `completed` is counted under the cache's lock, the rest on the UI thread.
+static LayoutCache::Cache<PreviewLayout> g_previewLayouts(kPreviewLayoutCacheBytes);
+static PreviewPrefetchStats g_previewPrefetchStats;
+static bool g_autoFit = false; // see "Auto-fit text size"
+
+static uint64_t PreviewLayoutKey(int fontIndex, int faceIndex)
+{
+	return LayoutCache::Key(fontIndex, faceIndex);
+}
+
+// Rough resident cost of a layout: glyph runs scale with the text length.
+static size_t EstimatePreviewLayoutBytes(const std::wstring &text)
+{
+	return 4096 + text.size() * 96;
+}
+
+// Drop cached layouts when the sample text, layout box or catalog changed.
+static void SyncPreviewLayoutParams(const std::wstring &text, FLOAT width, FLOAT height)
+{
+	if (g_previewLayouts.Sync(text, width, height, g_catalogGeneration))
+		g_previewPrefetchStats.cancelled += (UINT)g_backgroundTasks.Cancel(kTaskTagPreviewPrefetch);
+}
+
+// Same parameters, new catalog (called from InstallFontCatalog).
+static void SyncPreviewLayoutsToCatalog()
+{
+	SyncPreviewLayoutParams(g_previewLayouts.Text(), g_previewLayouts.Width(), g_previewLayouts.Height());
+}
+
+static bool MakePreviewLayoutJob(int fontIndex, int faceIndex, PreviewLayoutJob &job)
+{
+	if (fontIndex < 0 || fontIndex >= (int)g_fontList.size())
+		return false;
+	const FontItem &item = g_fontList[fontIndex];
+	job.fontIndex = fontIndex;
+	job.faceIndex = faceIndex;
+	job.layoutKey = PreviewLayoutKey(fontIndex, faceIndex);
+	job.family = item.familyName;
+	job.filePath = item.filePath;
+	job.isSystemFont = item.isSystemFont;
+	job.hasFace = GetFamilyFace(fontIndex, faceIndex, job.face);
+	job.text = g_previewLayouts.Text();
+	job.width = g_previewLayouts.Width();
+	job.height = g_previewLayouts.Height();
+	job.autoFit = g_autoFit;
+	job.generation = g_previewLayouts.Generation();
+	return true;
+}
+
+static HRESULT CreateJobTextFormat(const PreviewLayoutJob &job, IDWriteTextFormat **outFormat)
+{
+	ComPtr<IDWriteFontCollection1> externalCollection;
+	IDWriteFontCollection *collection = nullptr;
+	if (!job.isSystemFont && SUCCEEDED(GetOrCreateExternalFontCollection(job.filePath, &externalCollection)) && externalCollection)
+		collection = externalCollection.Get();
+	return CreatePreviewTextFormat(job.family, collection, job.hasFace ? &job.face : nullptr, job.fontSize, outFormat);
+}
+
+// Thread-safe: DirectWrite factory objects may be used from any thread.
+// `outPrimaryHr` reports the requested family; on failure the layout falls
+// back to Segoe UI. A prebuilt `format` (axis instances) skips creating one.
+static HRESULT BuildPreviewLayout(const PreviewLayoutJob &job, ComPtr<IDWriteTextLayout> &outLayout, HRESULT *outPrimaryHr,
+								  IDWriteTextFormat *prebuiltFormat = nullptr)
+{
+	FP_TRACE_SCOPE("LayoutBuild");
+	ComPtr<IDWriteTextFormat> format = prebuiltFormat;
+	HRESULT hr = format ? S_OK : CreateJobTextFormat(job, &format);
+	if (outPrimaryHr)
+		*outPrimaryHr = hr;
+	if (FAILED(hr))
+		hr = g_dwriteFactory->CreateTextFormat(L"Segoe UI", nullptr, DWRITE_FONT_WEIGHT_NORMAL, DWRITE_FONT_STYLE_NORMAL, DWRITE_FONT_STRETCH_NORMAL, job.fontSize, L"ja-jp", &format);
+	if (FAILED(hr))
+		return hr;
+	hr = g_dwriteFactory->CreateTextLayout(job.text.c_str(), (UINT32)job.text.size(), format.Get(), job.width, job.height, &outLayout);
+	if (FAILED(hr))
+		return hr;
+	if (!job.wrap)
+		outLayout->SetWordWrapping(DWRITE_WORD_WRAPPING_NO_WRAP);
+	// Prebuilt formats are cached at whatever size they were created with.
+	if (format->GetFontSize() != job.fontSize)
+		outLayout->SetFontSize(job.fontSize, DWRITE_TEXT_RANGE{0, (UINT32)job.text.size()});
+	return hr;
+}
+
+static void StorePreviewLayout(const PreviewLayoutJob &job, ComPtr<IDWriteTextLayout> layout, bool prefetched)
+{
+	PreviewLayout entry;
+	entry.layout = std::move(layout);
+	entry.prefetched = prefetched;
+	g_previewLayouts.Store(job.generation, job.layoutKey, std::move(entry), EstimatePreviewLayoutBytes(job.text), [&]
+						   {
+		if (prefetched)
+			g_previewPrefetchStats.completed++; });
+}
+
+static bool AcquirePreviewLayout(uint64_t layoutKey, ComPtr<IDWriteTextLayout> &outLayout)
+{
+	g_previewPrefetchStats.renders++;
+	return g_previewLayouts.Find(layoutKey, [&](PreviewLayout &entry)
+								 {
+		if (entry.prefetched)
+		{
+			g_previewPrefetchStats.prefetchedHits++;
+			entry.prefetched = false;
+		}
+		outLayout = entry.layout; });
+}
+
+static void LogPreviewPrefetchStats(const wchar_t *reason)
+{
+	if (!logger)
+		return;
+	LayoutCache::Cache<PreviewLayout>::Stats stats;
+	PreviewPrefetchStats prefetch;
+	g_previewLayouts.Inspect([&](const LayoutCache::Cache<PreviewLayout>::Stats &current)
+							 {
+		stats = current;
+		prefetch = g_previewPrefetchStats; });
+	wchar_t buf[256];
+	swprintf_s(buf, L"PreviewPrefetch[%ls]: hit=%.1f%% (%llu/%llu) prefetchedHits=%u issued=%u completed=%u cancelled=%u entries=%u bytes=%uKB evictions=%llu",
+			   reason, stats.HitRate() * 100.0, (unsigned long long)stats.hits, (unsigned long long)(stats.hits + stats.misses),
+			   prefetch.prefetchedHits, prefetch.issued, prefetch.completed, prefetch.cancelled,
+			   (UINT)stats.entries, (UINT)(stats.bytes / 1024), (unsigned long long)stats.evictions);
+	logger->info(logger, buf);
+}
+
+static void ApplyAutoFit(PreviewLayoutJob &job, IDWriteTextFormat *prebuiltFormat);
+static void ClampAutoFitLayout(PreviewLayoutJob &job, IDWriteTextLayout *layout);
+
+// Background half of a layout prefetch (neighbours and warm start): the
+// collection and text format come with the layout.
+static bool BuildQueuedPreviewLayout(PreviewLayoutJob &job, bool prefetched)
+{
+	if (job.autoFit)
+		ApplyAutoFit(job, nullptr);
+	ComPtr<IDWriteTextLayout> layout;
+	if (FAILED(BuildPreviewLayout(job, layout, nullptr)))
+		return false;
+	if (job.autoFit)
+		ClampAutoFitLayout(job, layout.Get());
+	StorePreviewLayout(job, layout, prefetched);
+	return true;
+}
+
+// Queue layouts for the rows within kPreviewPrefetchRadius of `row`, nearest
+// first. Previously queued neighbours of an older selection are dropped.
+static void PrefetchNeighbourPreviews(int row)
+{
+	if (g_previewLayouts.Text().empty() || g_previewLayouts.Width() <= 0.0f)
+		return;
+	g_previewPrefetchStats.cancelled += (UINT)g_backgroundTasks.Cancel(kTaskTagPreviewPrefetch);
+	for (int d = 1; d <= kPreviewPrefetchRadius; d++)
+	{
+		for (int target : {row + d, row - d})
+		{
+			if (target < 0 || target >= (int)g_listRows.size())
+				continue;
+			const ListRow &lr = g_listRows[target];
+			if (g_previewLayouts.Contains(PreviewLayoutKey(lr.fontIndex, lr.faceIndex)))
+				continue;
+			PreviewLayoutJob job;
+			if (!MakePreviewLayoutJob(lr.fontIndex, lr.faceIndex, job))
+				continue;
+			auto task = [job]() mutable
+			{ BuildQueuedPreviewLayout(job, true); };
+			if (g_backgroundTasks.Post(TaskQueue::Priority::Low, kTaskTagPreviewPrefetch, task))
+				g_previewPrefetchStats.issued++;
+		}
+	}
+}
+
+static void CancelPreviewPrefetch()
+{
+	g_previewPrefetchStats.cancelled += (UINT)g_backgroundTasks.Cancel(kTaskTagPreviewPrefetch);
+}
+
+//---------------------------------------------------------------------
+//	Rendered preview cache
+//---------------------------------------------------------------------
+// Finished previews are kept as offscreen D2D bitmaps so re-selecting a
+// font is a single DrawBitmap. Keys cover everything that changes pixels
+// (see PreviewCache::Key); bitmaps belong to g_d2dContext and are used on
+// the UI thread only.
+constexpr size_t kPreviewBitmapCacheBytes = 48u * 1024u * 1024u;
+static PreviewCache::Cache<ComPtr<ID2D1Bitmap1>> g_previewBitmaps(kPreviewBitmapCacheBytes);
+static UINT g_previewBitmapWidth = 0;
+static UINT g_previewBitmapHeight = 0;
+static UINT g_previewRenderCount = 0;
+// Reused by every lookup so a cache hit does not build a Key (and its
+// wstring); Insert copies it on a miss.
+static PreviewCache::Key g_previewLookupKey;
+static bool g_lastPreviewBitmapHit = false;
+// Belongs to g_d2dContext, which lives until UninitializePlugin.
+static ComPtr<ID2D1SolidColorBrush> g_previewTextBrush;
+
+static void LogPreviewBitmapStats(const wchar_t *reason)
+{
+	if (!logger)
+		return;
+	auto stats = g_previewBitmaps.GetStats();
+	wchar_t buf[200];
+	swprintf_s(buf, L"PreviewCache[%ls]: hit=%.1f%% (%llu/%llu) entries=%u resident=%uKB/%uKB evictions=%llu",
+			   reason, stats.HitRate() * 100.0, (unsigned long long)stats.hits, (unsigned long long)(stats.hits + stats.misses),
+			   (UINT)stats.entries, (UINT)(stats.bytes / 1024), (UINT)(stats.capacityBytes / 1024), (unsigned long long)stats.evictions);
+	logger->info(logger, buf);
+}
+
+// Catalog rebuilt: drop previews of fonts that disappeared or changed.
+static void RetainPreviewBitmapsForCatalog()
+{
+	std::unordered_set<std::wstring> live;
+	live.reserve(g_fontList.size());
+	for (const auto &item : g_fontList)
+		live.insert(item.cacheKey);
+	size_t dropped = g_previewBitmaps.RetainFonts(live);
+	if (logger && dropped > 0)
+	{
+		wchar_t buf[128];
+		swprintf_s(buf, L"PreviewCache: catalog changed, dropped %u entries", (UINT)dropped);
+		logger->info(logger, buf);
+	}
+}
+
+//---------------------------------------------------------------------
+//	Memory budget
+//---------------------------------------------------------------------
+// One ceiling over every cache (FONTPREVIEW_MEMORY_BUDGET_MB, changeable
+// from the context menu). Prefetched layouts go first, rendered previews
+// next, font collections last. Enforce runs on the UI thread only because
+// g_previewBitmaps is not shared with workers.
+static MemoryBudget::Manager g_memoryBudget;
+static const UINT kMemoryBudgetChoicesMB[] = {48, 96, 192, 384};
+
+static void RegisterAxisInstanceMemory();
+static void RegisterAxisSweepMemory();
+static void RegisterSpecimenMemory();
+static void RegisterCompareMemory();
+static void RegisterGlyphMemory();
+static void RegisterAutoFitMemory();
+
+static void RegisterMemoryClients()
+{
+	g_memoryBudget.Register(
+		"PreviewLayouts", MemoryBudget::Priority::Low,
+		[]
+		{ return g_previewLayouts.Bytes(); },
+		[](size_t bytes)
+		{ return g_previewLayouts.Trim(bytes); });
+	g_memoryBudget.Register(
+		"PreviewBitmaps", MemoryBudget::Priority::Normal,
+		[]
+		{ return g_previewBitmaps.ResidentBytes(); },
+		[](size_t bytes)
+		{ return g_previewBitmaps.Trim(bytes); });
+	g_memoryBudget.Register(
+		"FontCollections", MemoryBudget::Priority::High,
+		[]
+		{ std::lock_guard<std::mutex> lock(g_externalFontCollectionsMutex); return g_externalFontCollections.Bytes(); },
+		[](size_t bytes)
+		{ std::lock_guard<std::mutex> lock(g_externalFontCollectionsMutex); return g_externalFontCollections.Trim(bytes); });
+	g_memoryBudget.Register(
+		"FamilyFaces", MemoryBudget::Priority::High,
+		[]
+		{ std::lock_guard<std::mutex> lock(g_familyFacesMutex); return g_familyFacesBytes; });
+	RegisterAxisInstanceMemory();
+	RegisterAxisSweepMemory();
+	RegisterSpecimenMemory();
+	RegisterCompareMemory();
+	RegisterGlyphMemory();
+	RegisterAutoFitMemory();
+}
+
+static void LogMemoryBudget(const wchar_t *reason)
+{
+	if (!logger)
+		return;
+	wchar_t buf[512];
+	int n = swprintf_s(buf, L"Memory[%ls]: total=%.1fMB budget=%.0fMB", reason,
+					   g_memoryBudget.TotalBytes() / (1024.0 * 1024.0), g_memoryBudget.Budget() / (1024.0 * 1024.0));
+	g_memoryBudget.ForEachClient([&](const char *name, MemoryBudget::Priority priority, size_t bytes)
+								 {
+		if (n > 0 && n < (int)_countof(buf))
+			n += swprintf_s(buf + n, _countof(buf) - n, L" %hs(%hs)=%uKB", name, MemoryBudget::PriorityName(priority), (UINT)(bytes / 1024)); });
+	MemoryBudget::Manager::Stats stats = g_memoryBudget.GetStats();
+	if (n > 0 && n < (int)_countof(buf))
+		swprintf_s(buf + n, _countof(buf) - n, L" peak=%.1fMB trims=%llu trimmed=%lluKB overBudget=%llu",
+				   stats.peakBytes / (1024.0 * 1024.0), (unsigned long long)stats.trims,
+				   (unsigned long long)(stats.trimmedBytes / 1024), (unsigned long long)stats.overBudget);
+	logger->info(logger, buf);
+}
+
+//---------------------------------------------------------------------
+//	Coalesced invalidation
+//---------------------------------------------------------------------
+// Handlers call MarkDirty instead of repainting; the first mark posts
+// WM_FLUSH_INVALIDATION and the flush repaints each stale region once.
+// See DirtyState.h.
+static DirtyState::Tracker g_dirty;
+// A selection's own allocations, reported together with those of the
+// flush that renders it.
+static int g_pendingSelectionFont = -1;
+static uint64_t g_pendingSelectionAllocs = 0;
+static uint64_t g_pendingSelectionBytes = 0;
+
+static void FlushInvalidation();
+
+static void MarkDirty(DirtyState::Action action, uint32_t regions, int row)
+{
+	if (!g_dirty.Mark(action, regions, row))
+		return;
+	if (g_hwndMain && PostMessageW(g_hwndMain, WM_FLUSH_INVALIDATION, 0, 0))
+		return;
+	FlushInvalidation();
+}
+
+static void ReportSelectionAllocations(uint64_t count, uint64_t bytes, int fontIdx);
+
+static void FlushInvalidation()
+{
+	FP_TRACE_SCOPE("FlushInvalidation");
+	AllocCounter::Scope allocs;
+	DirtyState::Flush flush = g_dirty.Take();
+	if (flush.regions == DirtyState::None)
+		return;
+	if (g_hwndGrid)
+	{
+		int rows = (int)g_listRows.size();
+		if ((flush.regions & DirtyState::ListAll) != 0)
+			InvalidateRect(g_hwndGrid, nullptr, FALSE);
+		else if ((flush.regions & DirtyState::ListRows) != 0 && flush.rowFirst < rows)
+			ListView_RedrawItems(g_hwndGrid, flush.rowFirst, (std::min)(flush.rowLast, rows - 1));
+	}
+	if ((flush.regions & DirtyState::Detail) != 0)
+		UpdateDetailPanel();
+	if ((flush.regions & DirtyState::Preview) != 0)
+	{
+		wchar_t reason[96];
+		int n = swprintf_s(reason, L"Invalidate");
+		for (int i = 0; i < (int)DirtyState::Action::Count && n > 0 && n < (int)_countof(reason); i++)
+		{
+			if ((flush.actions & (1u << i)) != 0)
+				n += swprintf_s(reason + n, _countof(reason) - n, L" %hs", DirtyState::ActionName((DirtyState::Action)i));
+		}
+		RenderPreview(reason);
+	}
+	if (g_pendingSelectionFont >= 0 && g_pendingSelectionFont < (int)g_fontList.size())
+		ReportSelectionAllocations(g_pendingSelectionAllocs + allocs.Allocations(), g_pendingSelectionBytes + allocs.Bytes(), g_pendingSelectionFont);
+	g_pendingSelectionFont = -1;
+	g_pendingSelectionAllocs = g_pendingSelectionBytes = 0;
+	FP_LOG_VERBOSE_RATE(logger, kCatList, kPerFrameLogIntervalMs, L"FlushInvalidation: regions=0x%x actions=0x%x rows=%d..%d",
+						flush.regions, flush.actions, flush.rowFirst, flush.rowLast);
+}
+
+// One line per user action that asked for a repaint since startup.
+static void LogRepaintCounters(const wchar_t *reason)
+{
+	if (!logger)
+		return;
+	for (int i = 0; i < (int)DirtyState::Action::Count; i++)
+	{
+		const DirtyState::ActionCounts &c = g_dirty.Counts((DirtyState::Action)i);
+		if (c.requests == 0)
+			continue;
+		wchar_t buf[256];
+		swprintf_s(buf, L"Repaint[%ls]: %hs requests=%llu flushes=%llu list=%llu rows=%llu detail=%llu preview=%llu", reason,
+				   DirtyState::ActionName((DirtyState::Action)i), (unsigned long long)c.requests, (unsigned long long)c.flushes,
+				   (unsigned long long)c.listRepaints, (unsigned long long)c.rowRepaints, (unsigned long long)c.detailUpdates,
+				   (unsigned long long)c.previewRenders);
+		logger->info(logger, buf);
+	}
+}
+
+//---------------------------------------------------------------------
+//	Visibility
+//---------------------------------------------------------------------
+// Background tasks and frames follow whether the window can be seen; see
+// Visibility.h. Occlusion is learned from Present and, while occluded,
+// re-checked with a test present on a timer.
+static Visibility::Scheduler g_visibility;
+constexpr UINT_PTR kOcclusionProbeTimerId = 1;
+constexpr UINT kOcclusionProbeIntervalMs = 500;
+
+static void ApplyVisibility(const Visibility::Transition &t, const wchar_t *reason)
+{
+	if (!t.changed)
+		return;
+	g_backgroundTasks.SetRunnableLevels(g_visibility.RunnableLevels());
+	if (g_hwndMain)
+	{
+		if (g_visibility.NeedsProbe())
+			SetTimer(g_hwndMain, kOcclusionProbeTimerId, kOcclusionProbeIntervalMs, nullptr);
+		else
+			KillTimer(g_hwndMain, kOcclusionProbeTimerId);
+	}
+	// Inside RenderPreview the frame being drawn is the repaint.
+	if (t.repaint && !g_inRenderPreview)
+		MarkDirty(DirtyState::Action::Shown, DirtyState::Preview);
+	FP_LOG(logger, Info, kCatRender, L"Visibility: %hs -> %hs (%ls) levels=%u pending=%u", Visibility::StateName(t.from),
+		   Visibility::StateName(t.to), reason, g_visibility.RunnableLevels(), (UINT)g_backgroundTasks.Pending());
+}
+
+static void ProbeOcclusion()
+{
+	bool occluded = g_swapChain && g_swapChain->Present(0, DXGI_PRESENT_TEST) == DXGI_STATUS_OCCLUDED;
+	ApplyVisibility(g_visibility.SetOccluded(occluded, true), L"probe");
+}
+
+static void LogVisibility(const wchar_t *reason)
+{
+	if (!logger)
+		return;
+	const Visibility::Stats &st = g_visibility.GetStats();
+	wchar_t buf[256];
+	swprintf_s(buf, L"Visibility[%ls]: state=%hs levels=%u pending=%u transitions=%llu hidden=%llu occluded=%llu skippedFrames=%llu probes=%llu",
+			   reason, Visibility::StateName(g_visibility.Current()), g_visibility.RunnableLevels(), (UINT)g_backgroundTasks.Pending(),
+			   (unsigned long long)st.transitions, (unsigned long long)st.timesHidden, (unsigned long long)st.timesOccluded,
+			   (unsigned long long)st.skippedFrames, (unsigned long long)st.probes);
+	logger->info(logger, buf);
+}
+
+//---------------------------------------------------------------------
+//	Auto-fit text size
+//---------------------------------------------------------------------
+// With auto-fit on, the single-line preview (and its prefetched
+// neighbours) uses the largest size at which the sample fits the pane
+// instead of 48 DIPs; see AutoFit.h. Each font, face and text is laid out
+// once at a reference size to measure it, and the measurements are cached
+// with the last answer so a resize (WM_SIZE re-renders the preview)
+// searches from there. The search itself builds no layouts; only the
+// chosen size does. Thread-safe: prefetch workers fit their own rows.
+constexpr float kAutoFitReferenceDips = 100.0f;
+constexpr size_t kAutoFitCacheBytes = 2u * 1024u * 1024u;
+
+struct AutoFitEntry
+{
+	AutoFit::Metrics metrics;
+	AutoFit::Last last;
+};
+
+struct AutoFitStats
+{
+	uint64_t fits = 0;
+	uint64_t measured = 0; // reference layouts built
+	uint64_t steps = 0;	   // AutoFit::Fits calls
+	uint64_t corrected = 0; // real layout taller than the estimate
+	float lastSize = 0.0f;
+};
+
+static std::mutex g_autoFitMutex;
+static LruCache<uint64_t, AutoFitEntry> g_autoFitCache(kAutoFitCacheBytes);
+static AutoFitStats g_autoFitStats;
+
+// Font, face or axis instance, and text; not the box.
+static uint64_t AutoFitKey(const PreviewLayoutJob &job)
+{
+	uint64_t key = FontHash::Hash64(job.family.data(), job.family.size() * sizeof(wchar_t));
+	key = FontHash::Hash64(job.filePath.data(), job.filePath.size() * sizeof(wchar_t), key);
+	if (job.hasFace)
+	{
+		key = FontHash::Hash64(&job.face.styleHash, sizeof(job.face.styleHash), key);
+		if (!job.face.axisValues.empty())
+			key = FontHash::Hash64(job.face.axisValues.data(), job.face.axisValues.size() * sizeof(DWRITE_FONT_AXIS_VALUE), key);
+	}
+	return FontHash::Hash64(job.text.data(), job.text.size() * sizeof(wchar_t), key);
+}
+
+// One unwrapped layout at kAutoFitReferenceDips: cluster advances, break
+// opportunities and the tallest line.
+static bool MeasureAutoFit(const PreviewLayoutJob &job, IDWriteTextFormat *prebuiltFormat, AutoFit::Metrics &out)
+{
+	FP_TRACE_SCOPE("AutoFitMeasure");
+	PreviewLayoutJob ref = job;
+	ref.fontSize = kAutoFitReferenceDips;
+	ref.width = 1.0e6f;
+	ref.height = 1.0e6f;
+	ComPtr<IDWriteTextLayout> layout;
+	if (FAILED(BuildPreviewLayout(ref, layout, nullptr, prebuiltFormat)))
+		return false;
+	UINT32 count = 0;
+	layout->GetClusterMetrics(nullptr, 0, &count);
+	std::vector<DWRITE_CLUSTER_METRICS> clusters(count);
+	if (count == 0 || FAILED(layout->GetClusterMetrics(clusters.data(), count, &count)))
+		return false;
+	UINT32 lineCount = 0;
+	layout->GetLineMetrics(nullptr, 0, &lineCount);
+	std::vector<DWRITE_LINE_METRICS> lines(lineCount);
+	if (lineCount == 0 || FAILED(layout->GetLineMetrics(lines.data(), lineCount, &lineCount)))
+		return false;
+	float lineHeight = 0.0f;
+	for (const DWRITE_LINE_METRICS &line : lines)
+		lineHeight = (std::max)(lineHeight, line.height);
+	std::vector<float> widths(count);
+	std::vector<uint8_t> flags(count);
+	for (UINT32 i = 0; i < count; i++)
+	{
+		widths[i] = clusters[i].width;
+		flags[i] = (uint8_t)((clusters[i].canWrapLineAfter ? AutoFit::kCanBreakAfter : 0) | (clusters[i].isNewline ? AutoFit::kMustBreakAfter : 0) |
+							 (clusters[i].isWhitespace ? AutoFit::kWhitespace : 0));
+	}
+	out.Assign(widths.data(), flags.data(), count, lineHeight, kAutoFitReferenceDips);
+	return !out.Empty();
+}
+
+// Set job.fontSize to the fitted size for job.width x job.height. Leaves
+// it alone when the text cannot be measured.
+static void ApplyAutoFit(PreviewLayoutJob &job, IDWriteTextFormat *prebuiltFormat)
+{
+	FP_TRACE_SCOPE("AutoFit");
+	uint64_t key = AutoFitKey(job);
+	AutoFit::Result result;
+	{
+		std::lock_guard<std::mutex> lock(g_autoFitMutex);
+		if (AutoFitEntry *hit = g_autoFitCache.Get(key))
+		{
+			result = AutoFit::Refit(hit->metrics, job.width, job.height, hit->last);
+			hit->last = AutoFit::Last{job.width, job.height, result.size, result.fits};
+			g_autoFitStats.fits++;
+			g_autoFitStats.steps += (uint64_t)result.steps;
+			g_autoFitStats.lastSize = result.size;
+			job.fontSize = result.size;
+			return;
+		}
+	}
+	AutoFitEntry entry;
+	if (!MeasureAutoFit(job, prebuiltFormat, entry.metrics))
+		return;
+	result = AutoFit::Search(entry.metrics, job.width, job.height);
+	entry.last = AutoFit::Last{job.width, job.height, result.size, result.fits};
+	job.fontSize = result.size;
+	std::lock_guard<std::mutex> lock(g_autoFitMutex);
+	g_autoFitStats.fits++;
+	g_autoFitStats.measured++;
+	g_autoFitStats.steps += (uint64_t)result.steps;
+	g_autoFitStats.lastSize = result.size;
+	size_t bytes = entry.metrics.Bytes();
+	g_autoFitCache.Put(key, std::move(entry), bytes);
+}
+
+// The estimate ignores hinting and per-line fallback differences; if the
+// real layout came out taller than the box, shrink it in place.
+static void ClampAutoFitLayout(PreviewLayoutJob &job, IDWriteTextLayout *layout)
+{
+	DWRITE_TEXT_METRICS metrics{};
+	for (int attempt = 0; attempt < 3 && SUCCEEDED(layout->GetMetrics(&metrics)) && metrics.height > job.height; attempt++)
+	{
+		job.fontSize *= 0.95f;
+		layout->SetFontSize(job.fontSize, DWRITE_TEXT_RANGE{0, (UINT32)job.text.size()});
+		std::lock_guard<std::mutex> lock(g_autoFitMutex);
+		g_autoFitStats.corrected++;
+	}
+}
+
+static size_t StopAxisSweep(const wchar_t *reason);
+
+static void SetAutoFit(bool on)
+{
+	if (on == g_autoFit)
+		return;
+	g_autoFit = on;
+	StopAxisSweep(L"auto-fit");
+	CancelPreviewPrefetch();
+	g_previewLayouts.Invalidate();
+	g_previewBitmaps.Clear();
+	FP_LOG(logger, Info, kCatRender, L"AutoFit: %ls", on ? L"on" : L"off");
+	MarkDirty(DirtyState::Action::PreviewMode, DirtyState::Preview);
+}
+
+static void LogAutoFitStats(const wchar_t *reason)
+{
+	if (!logger || !g_autoFit)
+		return;
+	AutoFitStats stats;
+	LruCache<uint64_t, AutoFitEntry>::Stats cache;
+	{
+		std::lock_guard<std::mutex> lock(g_autoFitMutex);
+		stats = g_autoFitStats;
+		cache = g_autoFitCache.GetStats();
+	}
+	wchar_t buf[256];
+	swprintf_s(buf, L"AutoFit[%ls]: fits=%llu measured=%llu steps/fit=%.1f corrected=%llu lastSize=%.1f entries=%u bytes=%uKB",
+			   reason, (unsigned long long)stats.fits, (unsigned long long)stats.measured, stats.fits ? (double)stats.steps / stats.fits : 0.0,
+			   (unsigned long long)stats.corrected, stats.lastSize, (UINT)cache.entries, (UINT)(cache.bytes / 1024));
+	logger->info(logger, buf);
+}
+
+static void RegisterAutoFitMemory()
+{
+	g_memoryBudget.Register(
+		"AutoFitMetrics", MemoryBudget::Priority::Low,
+		[]
+		{ std::lock_guard<std::mutex> lock(g_autoFitMutex); return g_autoFitCache.Bytes(); },
+		[](size_t bytes)
+		{ std::lock_guard<std::mutex> lock(g_autoFitMutex); return g_autoFitCache.Trim(bytes); });
+}
+
+//---------------------------------------------------------------------
+//	Axis sliders
+//---------------------------------------------------------------------
+// One slider per variation axis of the selected font (the first
+// kMaxAxisSliders; further axes keep their defaults). Moving a slider
+// previews that instance through the axis overload of CreateTextFormat.
+// Formats are cached per quantized coordinate (see
+// FontPreviewCore::MakeAxisSlider), so scrubbing only builds a layout for
+// new positions and revisited ones hit the preview bitmap cache. The
+// coordinates also go into the VF alias.
+constexpr int kMaxAxisSliders = 6;
+constexpr size_t kAxisInstanceCacheBytes = 4u * 1024u * 1024u;
+// Rough resident cost of a text format and its instanced font face.
+constexpr size_t kAxisInstanceBytes = 32u * 1024u;
+
+struct AxisSliderState
+{
+	UINT catalog = 0; // g_catalogGeneration the indices belong to
+	int fontIndex = -1;
+	int faceIndex = -1;
+	int count = 0; // sliders in use
+	// Set once a slider moved; until then the row previews as listed.
+	bool active = false;
+	FontPreviewCore::AxisSlider sliders[kMaxAxisSliders];
+	// Every axis of the font in fvar order; sliders edit the first `count`.
+	std::vector<DWRITE_FONT_AXIS_VALUE> values;
+	uint64_t fontSeed = 0; // hash of the font's cacheKey
+	uint64_t hash = 0;	   // fontSeed and values: the instance identity
+};
+
+static HWND g_hwndAxisSliders[kMaxAxisSliders] = {};
+static HWND g_hwndAxisSliderLabels[kMaxAxisSliders] = {};
+static AxisSliderState g_axisSliders;
+static std::mutex g_axisInstanceMutex;
+static LruCache<uint64_t, ComPtr<IDWriteTextFormat>> g_axisInstanceFormats(kAxisInstanceCacheBytes);
+
+static bool AxisInstanceActive(int fontIdx, int faceIdx)
+{
+	return g_axisSliders.active && g_axisSliders.fontIndex == fontIdx && g_axisSliders.faceIndex == faceIdx;
+}
+
+// Layout cache key of the current instance; the top bit keeps it apart
+// from PreviewLayoutKey.
+static uint64_t AxisInstanceLayoutKey()
+{
+	return g_axisSliders.hash | (1ull << 63);
+}
+
+static void RehashAxisInstance()
+{
+	g_axisSliders.hash = FontHash::Hash64(g_axisSliders.values.data(), g_axisSliders.values.size() * sizeof(DWRITE_FONT_AXIS_VALUE),
+										  g_axisSliders.fontSeed);
+}
+
+static void UpdateAxisSliderLabel(int i)
+{
+	if (i >= g_axisSliders.count || !g_hwndAxisSliderLabels[i])
+		return;
+	const FontItem &item = g_fontList[g_axisSliders.fontIndex];
+	wchar_t buf[96];
+	_snwprintf_s(buf, _countof(buf), _TRUNCATE, L"%ls  %.*f", i < (int)item.axisSliderLabels.size() ? item.axisSliderLabels[i].c_str() : L"",
+				 FontPreviewCore::AxisSliderDecimals(g_axisSliders.sliders[i]), g_axisSliders.values[i].value);
+	SetWindowTextW(g_hwndAxisSliderLabels[i], buf);
+}
+
+static void CreateAxisSliders(HWND hwnd)
+{
+	for (int i = 0; i < kMaxAxisSliders; i++)
+	{
+		g_hwndAxisSliderLabels[i] = CreateWindowExW(0, WC_STATIC, L"", WS_CHILD | SS_LEFT, 0, 0, 100, 18, hwnd,
+													(HMENU)(INT_PTR)(IDC_AXIS_SLIDER_LABEL_BASE + i), GetModuleHandleW(nullptr), nullptr);
+		g_hwndAxisSliders[i] = CreateWindowExW(0, TRACKBAR_CLASSW, L"", WS_CHILD | WS_TABSTOP | TBS_HORZ | TBS_NOTICKS, 0, 0, 100, 24, hwnd,
+											   (HMENU)(INT_PTR)(IDC_AXIS_SLIDER_BASE + i), GetModuleHandleW(nullptr), nullptr);
+	}
+}
+
+// Stack the sliders in the given box; unused ones are hidden.
+static void LayoutAxisSliders(int x, int y, int width, int height)
+{
+	int rowHeight = g_axisSliders.count > 0 ? (std::min)(44, height / g_axisSliders.count) : 0;
+	for (int i = 0; i < kMaxAxisSliders; i++)
+	{
+		bool shown = i < g_axisSliders.count && rowHeight >= 24;
+		if (shown)
+		{
+			int top = y + i * rowHeight;
+			if (g_hwndAxisSliderLabels[i])
+				MoveWindow(g_hwndAxisSliderLabels[i], x, top, width, 18, TRUE);
+			if (g_hwndAxisSliders[i])
+				MoveWindow(g_hwndAxisSliders[i], x, top + 18, width, (std::max)(6, rowHeight - 20), TRUE);
+		}
+		if (g_hwndAxisSliderLabels[i])
+			ShowWindow(g_hwndAxisSliderLabels[i], shown ? SW_SHOWNA : SW_HIDE);
+		if (g_hwndAxisSliders[i])
+			ShowWindow(g_hwndAxisSliders[i], shown ? SW_SHOWNA : SW_HIDE);
+	}
+}
+
+void UpdateLayout(HWND hwnd);
+
+// Point the sliders at the selected font and face: the font's defaults,
+// overridden by the face's named-instance coordinates. Left alone while the
+// selection stays, so detail refreshes keep what the user dialled in.
+static void SyncAxisSliders()
+{
+	int fontIdx = g_selectedFontIndex;
+	bool valid = fontIdx >= 0 && fontIdx < (int)g_fontList.size();
+	size_t axisCount = valid ? g_fontList[fontIdx].axisRanges.size() : 0;
+	if (g_axisSliders.catalog == g_catalogGeneration && (valid ? fontIdx : -1) == g_axisSliders.fontIndex &&
+		g_selectedFaceIndex == g_axisSliders.faceIndex && axisCount == g_axisSliders.values.size())
+		return;
+	int oldCount = g_axisSliders.count;
+	g_axisSliders.catalog = g_catalogGeneration;
+	g_axisSliders.fontIndex = valid ? fontIdx : -1;
+	g_axisSliders.faceIndex = g_selectedFaceIndex;
+	g_axisSliders.active = false;
+	g_axisSliders.values.resize(axisCount);
+	g_axisSliders.count = (int)(std::min)(axisCount, (size_t)kMaxAxisSliders);
+	g_axisSliders.fontSeed = 0;
+	if (axisCount > 0)
+	{
+		const FontItem &item = g_fontList[fontIdx];
+		for (size_t i = 0; i < axisCount; i++)
+		{
+			g_axisSliders.values[i].axisTag = StringToAxisTag(item.axisRanges[i].first);
+			g_axisSliders.values[i].value = i < item.axisDefaults.size() ? item.axisDefaults[i] : item.axisRanges[i].second.first;
+		}
+		WithFamilyFace(fontIdx, g_selectedFaceIndex, [&](const FontFaceEntry &face)
+					   {
+			for (const auto &v : face.axisValues)
+				for (auto &cur : g_axisSliders.values)
+					if (cur.axisTag == v.axisTag)
+						cur.value = v.value; });
+		g_axisSliders.fontSeed = FontHash::Hash64(item.cacheKey.data(), item.cacheKey.size() * sizeof(wchar_t));
+		for (int i = 0; i < g_axisSliders.count; i++)
+		{
+			FontPreviewCore::AxisSlider &slider = g_axisSliders.sliders[i];
+			slider = FontPreviewCore::MakeAxisSlider(item.axisRanges[i].second.first, item.axisRanges[i].second.second);
+			if (HWND h = g_hwndAxisSliders[i])
+			{
+				SendMessageW(h, TBM_SETRANGEMIN, FALSE, slider.minPos);
+				SendMessageW(h, TBM_SETRANGEMAX, FALSE, slider.maxPos);
+				SendMessageW(h, TBM_SETLINESIZE, 0, 1);
+				SendMessageW(h, TBM_SETPAGESIZE, 0, (std::max)(1, (slider.maxPos - slider.minPos) / 10));
+				SendMessageW(h, TBM_SETPOS, TRUE, FontPreviewCore::AxisValueToPosition(slider, g_axisSliders.values[i].value));
+			}
+			UpdateAxisSliderLabel(i);
+		}
+	}
+	RehashAxisInstance();
+	if (g_axisSliders.count != oldCount && g_hwndMain)
+		UpdateLayout(g_hwndMain);
+}
+
+// WM_HSCROLL from one of the sliders (every drag step, not just the end).
+static bool HandleAxisSliderScroll(HWND slider)
+{
+	for (int i = 0; i < g_axisSliders.count; i++)
+	{
+		if (g_hwndAxisSliders[i] != slider)
+			continue;
+		int pos = (int)SendMessageW(slider, TBM_GETPOS, 0, 0);
+		float value = FontPreviewCore::AxisPositionToValue(g_axisSliders.sliders[i], pos);
+		if (g_axisSliders.active && value == g_axisSliders.values[i].value)
+			return true;
+		g_axisSliders.values[i].value = value;
+		g_axisSliders.active = true;
+		StopAxisSweep(L"slider");
+		RehashAxisInstance();
+		UpdateAxisSliderLabel(i);
+		MarkDirty(DirtyState::Action::AxisSlider, DirtyState::Preview);
+		return true;
+	}
+	return false;
+}
+
+// Point `job` at the slider instance and return its cached text format,
+// creating it on a miss. Null when the instance cannot be created; the
+// layout then falls back like any other row.
+static ComPtr<IDWriteTextFormat> PrepareAxisInstanceJob(PreviewLayoutJob &job)
+{
+	job.layoutKey = AxisInstanceLayoutKey();
+	job.hasFace = true;
+	job.face.axisValues = g_axisSliders.values;
+	{
+		std::lock_guard<std::mutex> lock(g_axisInstanceMutex);
+		if (ComPtr<IDWriteTextFormat> *hit = g_axisInstanceFormats.Get(g_axisSliders.hash))
+			return *hit;
+	}
+	ComPtr<IDWriteTextFormat> format;
+	if (FAILED(CreateJobTextFormat(job, &format)))
+		return nullptr;
+	std::lock_guard<std::mutex> lock(g_axisInstanceMutex);
+	g_axisInstanceFormats.Put(g_axisSliders.hash, format, kAxisInstanceBytes);
+	return format;
+}
+
+static void RegisterAxisInstanceMemory()
+{
+	g_memoryBudget.Register(
+		"AxisInstances", MemoryBudget::Priority::Low,
+		[]
+		{ std::lock_guard<std::mutex> lock(g_axisInstanceMutex); return g_axisInstanceFormats.Bytes(); },
+		[](size_t bytes)
+		{ std::lock_guard<std::mutex> lock(g_axisInstanceMutex); return g_axisInstanceFormats.Trim(bytes); });
+}
+
+// VF alias coordinates: the sliders when they belong to this font.
+static void CollectAliasAxes(int fontIdx, FontPreviewCore::AxisCoordinates &out)
+{
+	out.clear();
+	if (fontIdx != g_axisSliders.fontIndex)
+		return;
+	for (const auto &v : g_axisSliders.values)
+		out.emplace_back(TagToString(v.axisTag), v.value);
+}
+
+static bool DrawPreviewLayout(IDWriteTextLayout *layout, D2D1_POINT_2F origin = D2D1::Point2F(10.0f, 10.0f))
+{
+	if (!g_previewTextBrush && FAILED(g_d2dContext->CreateSolidColorBrush(D2D1::ColorF(0, 0, 0, 1), &g_previewTextBrush)))
+		return false;
+	g_d2dContext->DrawTextLayout(origin, layout, g_previewTextBrush.Get(), D2D1_DRAW_TEXT_OPTIONS_NONE);
+	return true;
+}
+
+// Draw the sample text for a row onto the current target, using the
+// prefetched layout when available. A moved slider draws its instance.
+static bool DrawPreviewText(int fontIdx, int faceIdx, const std::wstring &sample)
+{
+	ComPtr<IDWriteTextLayout> textLayout;
+	HRESULT hr = S_OK;
+	bool instance = AxisInstanceActive(fontIdx, faceIdx);
+	bool cached = AcquirePreviewLayout(instance ? AxisInstanceLayoutKey() : PreviewLayoutKey(fontIdx, faceIdx), textLayout);
+	if (!cached)
+	{
+		PreviewLayoutJob job;
+		MakePreviewLayoutJob(fontIdx, faceIdx, job);
+		ComPtr<IDWriteTextFormat> instanceFormat;
+		if (instance)
+			instanceFormat = PrepareAxisInstanceJob(job);
+		if (job.autoFit)
+			ApplyAutoFit(job, instanceFormat.Get());
+		HRESULT hrPrimary = S_OK;
+		hr = BuildPreviewLayout(job, textLayout, &hrPrimary, instanceFormat.Get());
+		if (FAILED(hrPrimary) && logger)
+		{
+			wchar_t buf[200];
+			swprintf_s(buf, L"RenderPreview: primary format failed 0x%08x, fallback hr=0x%08x", hrPrimary, hr);
+			logger->warn(logger, buf);
+		}
+		if (SUCCEEDED(hr) && job.autoFit)
+			ClampAutoFitLayout(job, textLayout.Get());
+		if (SUCCEEDED(hr))
+			StorePreviewLayout(job, textLayout, false);
+	}
+	if (FAILED(hr) || !textLayout || !DrawPreviewLayout(textLayout.Get()))
+		return false;
+	FP_LOG_VERBOSE_RATE(logger, kCatRender, kPerFrameLogIntervalMs, L"RenderPreview: drew text len=%u family=%ls layout=%ls",
+						(unsigned)sample.size(), g_fontList[fontIdx].familyName.c_str(), cached ? L"cached" : L"built");
+	return true;
+}
+
+// Clear a new preview-sized bitmap to the background colour and run
+// `draw` on it. Must be called outside BeginDraw/EndDraw on the swap chain
+// target; null when creating or drawing failed.
+template <typename Fn>
+static ComPtr<ID2D1Bitmap1> RenderOffscreen(UINT width, UINT height, Fn &&draw)
+{
+	ComPtr<ID2D1Bitmap1> bitmap;
+	D2D1_BITMAP_PROPERTIES1 props = D2D1::BitmapProperties1(
+		D2D1_BITMAP_OPTIONS_TARGET,
+		D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_IGNORE),
+		96.0f, 96.0f);
+	if (FAILED(g_d2dContext->CreateBitmap(D2D1::SizeU(width, height), nullptr, 0, props, &bitmap)))
+		return nullptr;
+	g_d2dContext->SetTarget(bitmap.Get());
+	g_d2dContext->BeginDraw();
+	g_d2dContext->Clear(D2D1::ColorF(GetRValue(g_previewBgColor) / 255.0f, GetGValue(g_previewBgColor) / 255.0f, GetBValue(g_previewBgColor) / 255.0f, 1.0f));
+	bool drawn = draw();
+	HRESULT hr = g_d2dContext->EndDraw();
+	g_d2dContext->SetTarget(g_d2dTarget.Get());
+	if (!drawn || FAILED(hr))
+		return nullptr;
+	return bitmap;
+}
+
+// Everything that changes a row's pixels (see PreviewCache::Key).
+static void MakePreviewBitmapKey(int fontIdx, int faceIdx, const std::wstring &sample, UINT width, UINT height, PreviewCache::Key &key)
+{
+	uint64_t faceHash = 0;
+	WithFamilyFace(fontIdx, faceIdx, [&](const FontFaceEntry &face)
+				   { faceHash = face.styleHash; });
+	if (AxisInstanceActive(fontIdx, faceIdx))
+		faceHash = FontHash::Hash64(&g_axisSliders.hash, sizeof(g_axisSliders.hash), faceHash);
+	PreviewCache::AssignKey(key, g_fontList[fontIdx].cacheKey, faceHash, sample, width, height, (uint32_t)(g_previewBgColor & 0xFFFFFF),
+							g_hwndPreview ? GetDpiForWindow(g_hwndPreview) : 96);
+}
+
+// Whether a row's preview at the current pane size is already rendered.
+static bool PreviewBitmapCached(int fontIdx, int faceIdx, const std::wstring &sample)
+{
+	if (g_previewBitmapWidth == 0 || g_previewBitmapHeight == 0)
+		return false;
+	MakePreviewBitmapKey(fontIdx, faceIdx, sample, g_previewBitmapWidth, g_previewBitmapHeight, g_previewLookupKey);
+	return g_previewBitmaps.Contains(g_previewLookupKey);
+}
+
+// Return the finished preview for the selection, rendering it offscreen on
+// a miss. Must be called outside BeginDraw/EndDraw on the swap chain target.
+static ComPtr<ID2D1Bitmap1> AcquirePreviewBitmap(int fontIdx, int faceIdx, const std::wstring &sample, UINT width, UINT height, bool &outHit)
+{
+	outHit = false;
+	if (width != g_previewBitmapWidth || height != g_previewBitmapHeight)
+	{
+		// Other sizes cannot be reused until the pane is resized back.
+		g_previewBitmaps.Clear();
+		g_previewBitmapWidth = width;
+		g_previewBitmapHeight = height;
+	}
+	PreviewCache::Key &key = g_previewLookupKey;
+	MakePreviewBitmapKey(fontIdx, faceIdx, sample, width, height, key);
+	if (ComPtr<ID2D1Bitmap1> *hit = g_previewBitmaps.Find(key))
+	{
+		outHit = true;
+		return *hit;
+	}
+
+	ComPtr<ID2D1Bitmap1> bitmap = RenderOffscreen(width, height, [&]
+												  { return DrawPreviewText(fontIdx, faceIdx, sample); });
+	if (bitmap)
+		g_previewBitmaps.Insert(key, bitmap);
+	return bitmap;
+}
+
+//---------------------------------------------------------------------
+//	Specimen views (waterfall / paragraph)
+//---------------------------------------------------------------------
+// Several sizes of the selection stacked in the preview (see Specimen.h).
+// Each line's layout is cached under the font, instance, text, width and
+// size, so scrolling back or returning to a font reuses it and a new
+// sample text only lays out the lines that are on screen. Missing lines
+// are laid out in parallel before the frame (the UI thread takes part, see
+// TaskQueue::ParallelFor), then every visible line is drawn in the same
+// BeginDraw/EndDraw as the rest of the preview.
+constexpr size_t kSpecimenLayoutCacheBytes = 8u * 1024u * 1024u;
+constexpr unsigned kSpecimenHelpers = 3;
+constexpr float kSpecimenWheelStepDips = 60.0f;
+
+struct SpecimenLine
+{
+	ComPtr<IDWriteTextLayout> layout;
+	ComPtr<IDWriteTextLayout> label; // "12pt"
+	float height = 0.0f;
+};
+
+// What one frame draws: the visible lines and their positions.
+struct SpecimenFrame
+{
+	int count = 0;
+	SpecimenLine lines[Specimen::kMaxLines];
+	float tops[Specimen::kMaxLines] = {};
+};
+
+struct SpecimenStats
+{
+	uint64_t frames = 0;
+	uint64_t linesDrawn = 0;
+	uint64_t linesBuilt = 0;
+	uint64_t parallelBatches = 0;
+};
+
+static Specimen::Mode g_specimenMode = Specimen::Mode::Single;
+static float g_specimenScroll = 0.0f;
+static Specimen::Plan g_specimenPlan;
+static uint64_t g_specimenPlanKey = 0;
+static std::wstring g_specimenParagraph;
+static SpecimenStats g_specimenStats;
+static std::mutex g_specimenMutex;
+static LruCache<uint64_t, SpecimenLine> g_specimenLayouts(kSpecimenLayoutCacheBytes);
+static ComPtr<IDWriteTextFormat> g_specimenLabelFormat;
+static ComPtr<ID2D1SolidColorBrush> g_specimenLabelBrush;
+
+struct SpecimenKeyParts
+{
+	uint64_t font = 0; // cacheKey hash
+	uint64_t face = 0; // styleHash or axis instance hash
+	uint64_t text = 0;
+	uint32_t width = 0;
+	int32_t mode = 0;
+};
+
+static uint64_t SpecimenLineKey(uint64_t planKey, int line)
+{
+	return FontHash::Hash64(&line, sizeof(line), planKey);
+}
+
+static void SetSpecimenMode(Specimen::Mode mode)
+{
+	if (mode == g_specimenMode)
+		return;
+	bool glyphControls = (mode == Specimen::Mode::Glyphs) != (g_specimenMode == Specimen::Mode::Glyphs);
+	g_specimenMode = mode;
+	g_specimenScroll = 0.0f;
+	g_specimenPlanKey = 0;
+	if (mode != Specimen::Mode::Single)
+		StopAxisSweep(L"specimen view");
+	FP_LOG(logger, Info, kCatRender, L"Specimen: mode=%hs", Specimen::ModeName(mode));
+	if (glyphControls)
+		UpdateLayout(g_hwndMain);
+	MarkDirty(DirtyState::Action::PreviewMode, DirtyState::Preview);
+}
+
+// Small grey captions ("12pt", font names in the compare view).
+static IDWriteTextFormat *SpecimenLabelFormat()
+{
+	if (!g_specimenLabelFormat)
+		g_dwriteFactory->CreateTextFormat(L"Segoe UI", nullptr, DWRITE_FONT_WEIGHT_NORMAL, DWRITE_FONT_STYLE_NORMAL, DWRITE_FONT_STRETCH_NORMAL,
+										  11.0f, L"ja-jp", &g_specimenLabelFormat);
+	return g_specimenLabelFormat.Get();
+}
+
+static ID2D1SolidColorBrush *SpecimenLabelBrush()
+{
+	if (!g_specimenLabelBrush)
+		g_d2dContext->CreateSolidColorBrush(D2D1::ColorF(0.5f, 0.5f, 0.5f, 1.0f), &g_specimenLabelBrush);
+	return g_specimenLabelBrush.Get();
+}
+
+// WM_MOUSEWHEEL over the preview while a specimen view is shown.
+static bool HandleSpecimenWheel(int delta, POINT screenPt)
+{
+	if (g_specimenMode == Specimen::Mode::Single || !g_hwndPreview)
+		return false;
+	RECT rc{};
+	GetWindowRect(g_hwndPreview, &rc);
+	if (!PtInRect(&rc, screenPt))
+		return false;
+	g_specimenScroll -= (float)delta / WHEEL_DELTA * kSpecimenWheelStepDips;
+	MarkDirty(DirtyState::Action::PreviewScroll, DirtyState::Preview);
+	return true;
+}
+
+// Fill `frame` with the lines visible in a w x h preview, laying out the
+// missing ones first. Returns false when nothing can be drawn.
+static bool PrepareSpecimen(int fontIdx, int faceIdx, const std::wstring &sample, int w, int h, SpecimenFrame &frame)
+{
+	FP_TRACE_SCOPE("SpecimenPrepare");
+	frame.count = 0;
+	Specimen::Mode mode = g_specimenMode;
+	const std::wstring *text = &sample;
+	if (mode == Specimen::Mode::Paragraph)
+	{
+		Specimen::MakeParagraphText(sample, g_specimenParagraph);
+		text = &g_specimenParagraph;
+	}
+	float textWidth = (std::max)(40.0f, (FLOAT)w - 20.0f - Specimen::kLabelWidthDips);
+	float viewHeight = (FLOAT)h - 20.0f;
+
+	const FontItem &item = g_fontList[fontIdx];
+	SpecimenKeyParts parts;
+	parts.font = FontHash::Hash64(item.cacheKey.data(), item.cacheKey.size() * sizeof(wchar_t));
+	WithFamilyFace(fontIdx, faceIdx, [&](const FontFaceEntry &face)
+				   { parts.face = face.styleHash; });
+	bool instance = AxisInstanceActive(fontIdx, faceIdx);
+	if (instance)
+		parts.face = FontHash::Hash64(&g_axisSliders.hash, sizeof(g_axisSliders.hash), parts.face);
+	parts.text = PreviewCache::HashText(*text);
+	parts.width = (uint32_t)textWidth;
+	parts.mode = (int32_t)mode;
+	uint64_t planKey = FontHash::Hash64(&parts, sizeof(parts));
+	if (planKey != g_specimenPlanKey)
+	{
+		g_specimenPlan = Specimen::MakePlan(mode, text->size(), textWidth);
+		g_specimenPlanKey = planKey;
+	}
+	Specimen::Plan &plan = g_specimenPlan;
+
+	// Measured heights can pull more lines into view; a few passes settle it.
+	int first = 0, last = 0;
+	for (int pass = 0; pass < 3; pass++)
+	{
+		g_specimenScroll = Specimen::ClampScroll(plan, g_specimenScroll, viewHeight);
+		Specimen::VisibleRange(plan, g_specimenScroll, viewHeight, first, last);
+		int missing[Specimen::kMaxLines];
+		int missingCount = 0;
+		{
+			std::lock_guard<std::mutex> lock(g_specimenMutex);
+			for (int i = first; i < last; i++)
+			{
+				if (SpecimenLine *hit = g_specimenLayouts.Get(SpecimenLineKey(planKey, i)))
+					Specimen::SetMeasured(plan, i, hit->height);
+				else
+					missing[missingCount++] = i;
+			}
+		}
+		if (missingCount == 0)
+			break;
+
+		SpecimenLabelFormat();
+		PreviewLayoutJob base;
+		if (!MakePreviewLayoutJob(fontIdx, faceIdx, base))
+			return false;
+		if (instance)
+		{
+			base.hasFace = true;
+			base.face.axisValues = g_axisSliders.values;
+		}
+		base.text = *text;
+		base.width = textWidth;
+		base.wrap = mode == Specimen::Mode::Paragraph;
+		SpecimenLine built[Specimen::kMaxLines];
+		g_backgroundTasks.ParallelFor((size_t)missingCount, kSpecimenHelpers, TaskQueue::Priority::High, kTaskTagSpecimen, [&](size_t n)
+									  {
+			FP_TRACE_SCOPE("SpecimenLayout");
+			int line = missing[n];
+			PreviewLayoutJob job = base;
+			job.fontSize = Specimen::PointsToDips(plan.sizes[line]);
+			job.height = plan.heights[line];
+			SpecimenLine &out = built[n];
+			if (FAILED(BuildPreviewLayout(job, out.layout, nullptr)))
+				return;
+			DWRITE_TEXT_METRICS metrics{};
+			out.height = SUCCEEDED(out.layout->GetMetrics(&metrics)) ? std::ceil(metrics.height) : job.height;
+			if (g_specimenLabelFormat)
+			{
+				wchar_t label[16];
+				int len = swprintf_s(label, L"%gpt", plan.sizes[line]);
+				g_dwriteFactory->CreateTextLayout(label, (UINT32)(std::max)(0, len), g_specimenLabelFormat.Get(), Specimen::kLabelWidthDips, 20.0f, &out.label);
+			} });
+		g_specimenStats.parallelBatches++;
+		std::lock_guard<std::mutex> lock(g_specimenMutex);
+		for (int n = 0; n < missingCount; n++)
+		{
+			if (!built[n].layout)
+				return false;
+			Specimen::SetMeasured(plan, missing[n], built[n].height);
+			g_specimenLayouts.Put(SpecimenLineKey(planKey, missing[n]), built[n], EstimatePreviewLayoutBytes(*text) + 2048);
+			g_specimenStats.linesBuilt++;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(g_specimenMutex);
+	for (int i = first; i < last; i++)
+	{
+		SpecimenLine *line = g_specimenLayouts.Get(SpecimenLineKey(planKey, i));
+		if (!line)
+			continue;
+		frame.lines[frame.count] = *line;
+		frame.tops[frame.count] = 10.0f + plan.tops[i] - g_specimenScroll;
+		frame.count++;
+	}
+	g_specimenStats.frames++;
+	g_specimenStats.linesDrawn += (uint64_t)frame.count;
+	FP_LOG_VERBOSE_RATE(logger, kCatRender, kPerFrameLogIntervalMs, L"Specimen: mode=%hs lines=%d..%d of %d scroll=%.0f content=%.0f",
+						Specimen::ModeName(mode), first, last, plan.count, g_specimenScroll, Specimen::ContentHeight(plan));
+	return frame.count > 0;
+}
+
+// Called between BeginDraw and EndDraw on the swap chain target.
+static void DrawSpecimen(const SpecimenFrame &frame)
+{
+	ID2D1SolidColorBrush *labelBrush = SpecimenLabelBrush();
+	for (int i = 0; i < frame.count; i++)
+	{
+		const SpecimenLine &line = frame.lines[i];
+		if (line.label && labelBrush)
+			g_d2dContext->DrawTextLayout(D2D1::Point2F(10.0f, frame.tops[i]), line.label.Get(), labelBrush, D2D1_DRAW_TEXT_OPTIONS_NONE);
+		DrawPreviewLayout(line.layout.Get(), D2D1::Point2F(10.0f + Specimen::kLabelWidthDips, frame.tops[i]));
+	}
+}
+
+static void LogSpecimenStats(const wchar_t *reason)
+{
+	if (!logger || g_specimenStats.frames == 0)
+		return;
+	LruCache<uint64_t, SpecimenLine>::Stats stats;
+	{
+		std::lock_guard<std::mutex> lock(g_specimenMutex);
+		stats = g_specimenLayouts.GetStats();
+	}
+	wchar_t buf[256];
+	swprintf_s(buf, L"Specimen[%ls]: mode=%hs frames=%llu linesDrawn=%llu linesBuilt=%llu batches=%llu hit=%.1f%% entries=%u bytes=%uKB",
+			   reason, Specimen::ModeName(g_specimenMode), (unsigned long long)g_specimenStats.frames, (unsigned long long)g_specimenStats.linesDrawn,
+			   (unsigned long long)g_specimenStats.linesBuilt, (unsigned long long)g_specimenStats.parallelBatches, stats.HitRate() * 100.0,
+			   (UINT)stats.entries, (UINT)(stats.bytes / 1024));
+	logger->info(logger, buf);
+}
+
+static void RegisterSpecimenMemory()
+{
+	g_memoryBudget.Register(
+		"SpecimenLayouts", MemoryBudget::Priority::Low,
+		[]
+		{ std::lock_guard<std::mutex> lock(g_specimenMutex); return g_specimenLayouts.Bytes(); },
+		[](size_t bytes)
+		{ std::lock_guard<std::mutex> lock(g_specimenMutex); return g_specimenLayouts.Trim(bytes); });
+}
+
+//---------------------------------------------------------------------
+//	Compare view
+//---------------------------------------------------------------------
+// The sample text in every pinned font (see Compare.h), stacked and drawn
+// in one BeginDraw/EndDraw. The text is analysed once per sample text with
+// IDWriteTextAnalyzer (script runs and line-break opportunities); each
+// font then only maps and positions its glyphs for those runs and breaks
+// its own widths against the shared opportunities. A new sample text or
+// width reshapes the pinned fonts in parallel; changing the selection
+// does not touch the rows. Rows draw with their own face only (no font
+// fallback), so missing glyphs show as such. Left-to-right text only.
+constexpr float kCompareFontSizePt = 24.0f;
+constexpr unsigned kCompareHelpers = 3;
+constexpr float kCompareLabelHeightDips = 18.0f;
+constexpr float kCompareRowGapDips = 12.0f;
+
+struct CompareScriptRun
+{
+	UINT32 start = 0;
+	UINT32 length = 0;
+	DWRITE_SCRIPT_ANALYSIS analysis{};
+};
+
+// What every pinned font shares for the current sample text.
+struct CompareAnalysis
+{
+	std::wstring text;
+	std::vector<CompareScriptRun> runs;
+	std::vector<uint8_t> breaks; // Compare::BreakFlags per position
+	uint64_t textHash = 0;
+	bool valid = false;
+};
+
+// Glyphs of one script run on one line, at `x` from the line start.
+struct ComparePiece
+{
+	int line = 0;
+	UINT32 glyphStart = 0;
+	UINT32 glyphCount = 0;
+	float x = 0.0f;
+};
+
+// One pinned font shaped for the current text and width.
+struct CompareShape
+{
+	std::vector<UINT16> glyphs;
+	std::vector<FLOAT> advances;
+	std::vector<DWRITE_GLYPH_OFFSET> offsets;
+	std::vector<ComparePiece> pieces;
+	int lineCount = 0;
+	bool truncated = false; // more than Compare::kMaxRowLines lines
+	float ascent = 0.0f;	// DIPs
+	float lineHeight = 0.0f;
+
+	size_t Bytes() const
+	{
+		return glyphs.capacity() * sizeof(UINT16) + advances.capacity() * sizeof(FLOAT) + offsets.capacity() * sizeof(DWRITE_GLYPH_OFFSET) +
+			   pieces.capacity() * sizeof(ComparePiece);
+	}
+};
+
+// A pin resolved against the catalog. UI thread only, except that each
+// ParallelFor task in PrepareCompare fills its own slot.
+struct CompareSlot
+{
+	int fontIndex = -1; // -1: the pinned font is not in the catalog
+	int faceIndex = -1;
+	uint64_t fontKey = 0; // cacheKey hash; slots survive re-resolving while it matches
+	ComPtr<IDWriteFontFace> face;
+	ComPtr<IDWriteTextLayout> label;
+	uint64_t shapeKey = 0; // face, text and width the shape was built for
+	CompareShape shape;
+	bool failed = false;
+};
+
+struct CompareStats
+{
+	uint64_t frames = 0;
+	uint64_t rowsDrawn = 0;
+	uint64_t analyses = 0;
+	uint64_t rowsShaped = 0;
+	uint64_t parallelBatches = 0;
+	uint64_t facesCreated = 0;
+};
+
+static Compare::PinSet g_comparePins;
+static bool g_comparePinsLoaded = false;
+static std::vector<CompareSlot> g_compareSlots;
+static CompareAnalysis g_compareAnalysis;
+static CompareStats g_compareStats;
+static float g_compareContentHeight = 0.0f;
+static ComPtr<IDWriteTextLayout> g_compareHint;
+
+static std::wstring GetComparePinsPath()
+{
+	return GetPluginDirectory() + L"\\FontPreview.compare";
+}
+
+static void LoadComparePins()
+{
+	if (g_comparePinsLoaded)
+		return;
+	g_comparePinsLoaded = true;
+	std::ifstream in(std::filesystem::path(GetComparePinsPath()), std::ios::binary);
+	if (in && !g_comparePins.Load(in) && logger)
+		logger->warn(logger, L"Compare: pin file ignored (unknown format)");
+}
+
+static void SaveComparePins()
+{
+	if (!g_comparePins.IsDirty())
+		return;
+	std::ofstream out(std::filesystem::path(GetComparePinsPath()), std::ios::binary | std::ios::trunc);
+	if (!out)
+	{
+		if (logger)
+			logger->warn(logger, L"Compare: pin file could not be written");
+		return;
+	}
+	g_comparePins.Save(out);
+}
+
+// Map the pins onto the catalog (after it is installed and on every pin
+// change). Slots that still point at the same font keep their face and
+// shape.
+static void ResolveComparePins()
+{
+	LoadComparePins();
+	const std::vector<Compare::Pin> &pins = g_comparePins.Pins();
+	std::vector<int> indices;
+	Compare::ResolvePins(g_fontList, pins, indices);
+	std::vector<CompareSlot> slots(pins.size());
+	for (size_t i = 0; i < pins.size(); i++)
+	{
+		CompareSlot &slot = slots[i];
+		slot.faceIndex = pins[i].faceIndex;
+		slot.fontIndex = indices[i];
+		if (slot.fontIndex < 0)
+			continue;
+		const std::wstring &cacheKey = g_fontList[slot.fontIndex].cacheKey;
+		slot.fontKey = FontHash::Hash64(cacheKey.data(), cacheKey.size() * sizeof(wchar_t));
+		for (CompareSlot &old : g_compareSlots)
+		{
+			if (old.fontKey == slot.fontKey && old.faceIndex == slot.faceIndex && old.fontKey != 0)
+			{
+				int fontIndex = slot.fontIndex;
+				slot = std::move(old);
+				slot.fontIndex = fontIndex;
+				old.fontKey = 0;
+				break;
+			}
+		}
+	}
+	g_compareSlots = std::move(slots);
+	if (g_specimenMode == Specimen::Mode::Compare)
+		MarkDirty(DirtyState::Action::ComparePins, DirtyState::Preview);
+}
+
+static bool IsComparePinned(int fontIdx, int faceIdx)
+{
+	if (fontIdx < 0 || fontIdx >= (int)g_fontList.size())
+		return false;
+	return g_comparePins.Find(FontPreviewCore::BuildFontIdentity(g_fontList[fontIdx]), faceIdx) >= 0;
+}
+
+static void ToggleComparePin(int fontIdx, int faceIdx)
+{
+	if (fontIdx < 0 || fontIdx >= (int)g_fontList.size())
+		return;
+	LoadComparePins();
+	Compare::ToggleResult result = g_comparePins.Toggle(FontPreviewCore::BuildFontIdentity(g_fontList[fontIdx]), faceIdx);
+	if (result == Compare::ToggleResult::Full)
+	{
+		FP_LOG(logger, Warn, kCatRender, L"Compare: at most %d fonts can be pinned", Compare::kMaxPinned);
+		return;
+	}
+	FP_LOG(logger, Info, kCatRender, L"Compare: %ls %ls (%d pinned)", result == Compare::ToggleResult::Added ? L"pinned" : L"unpinned",
+		   g_fontList[fontIdx].displayName.c_str(), (int)g_comparePins.Size());
+	SaveComparePins();
+	ResolveComparePins();
+}
+
+static void ClearComparePins()
+{
+	LoadComparePins();
+	g_comparePins.Clear();
+	SaveComparePins();
+	ResolveComparePins();
+}
+
+// WM_FONT_FACES_READY: a pinned face row was waiting for its family's faces.
+static void HandleCompareFacesReady(int fontIndex)
+{
+	if (g_specimenMode != Specimen::Mode::Compare)
+		return;
+	for (const CompareSlot &slot : g_compareSlots)
+	{
+		if (slot.fontIndex == fontIndex && slot.faceIndex >= 0 && !slot.face)
+		{
+			MarkDirty(DirtyState::Action::ComparePins, DirtyState::Preview);
+			return;
+		}
+	}
+}
+
+// IDWriteTextAnalysisSource and sink over one string. Lives on the stack
+// for the duration of the Analyze* calls, so reference counting is a no-op.
+class CompareTextAnalysis final : public IDWriteTextAnalysisSource, public IDWriteTextAnalysisSink
+{
+public:
+	CompareTextAnalysis(const std::wstring &text, std::vector<CompareScriptRun> &runs, std::vector<DWRITE_LINE_BREAKPOINT> &breakpoints)
+		: m_text(text), m_runs(runs), m_breakpoints(breakpoints)
+	{
+		m_breakpoints.assign(text.size(), DWRITE_LINE_BREAKPOINT{});
+	}
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **object) override
+	{
+		if (IsEqualIID(riid, __uuidof(IDWriteTextAnalysisSource)) || IsEqualIID(riid, __uuidof(IUnknown)))
+			*object = static_cast<IDWriteTextAnalysisSource *>(this);
+		else if (IsEqualIID(riid, __uuidof(IDWriteTextAnalysisSink)))
+			*object = static_cast<IDWriteTextAnalysisSink *>(this);
+		else
+		{
+			*object = nullptr;
+			return E_NOINTERFACE;
+		}
+		return S_OK;
+	}
+	ULONG STDMETHODCALLTYPE AddRef() override { return 1; }
+	ULONG STDMETHODCALLTYPE Release() override { return 1; }
+
+	HRESULT STDMETHODCALLTYPE GetTextAtPosition(UINT32 position, WCHAR const **text, UINT32 *length) override
+	{
+		bool inside = position < (UINT32)m_text.size();
+		*text = inside ? m_text.c_str() + position : nullptr;
+		*length = inside ? (UINT32)m_text.size() - position : 0;
+		return S_OK;
+	}
+	HRESULT STDMETHODCALLTYPE GetTextBeforePosition(UINT32 position, WCHAR const **text, UINT32 *length) override
+	{
+		bool inside = position > 0 && position <= (UINT32)m_text.size();
+		*text = inside ? m_text.c_str() : nullptr;
+		*length = inside ? position : 0;
+		return S_OK;
+	}
+	DWRITE_READING_DIRECTION STDMETHODCALLTYPE GetParagraphReadingDirection() override { return DWRITE_READING_DIRECTION_LEFT_TO_RIGHT; }
+	HRESULT STDMETHODCALLTYPE GetLocaleName(UINT32 position, UINT32 *length, WCHAR const **localeName) override
+	{
+		*length = position < (UINT32)m_text.size() ? (UINT32)m_text.size() - position : 0;
+		*localeName = L"ja-jp";
+		return S_OK;
+	}
+	HRESULT STDMETHODCALLTYPE GetNumberSubstitution(UINT32 position, UINT32 *length, IDWriteNumberSubstitution **substitution) override
+	{
+		*length = position < (UINT32)m_text.size() ? (UINT32)m_text.size() - position : 0;
+		*substitution = nullptr;
+		return S_OK;
+	}
+
+	HRESULT STDMETHODCALLTYPE SetScriptAnalysis(UINT32 position, UINT32 length, DWRITE_SCRIPT_ANALYSIS const *analysis) override
+	{
+		CompareScriptRun run;
+		run.start = position;
+		run.length = length;
+		run.analysis = *analysis;
+		m_runs.push_back(run);
+		return S_OK;
+	}
+	HRESULT STDMETHODCALLTYPE SetLineBreakpoints(UINT32 position, UINT32 length, DWRITE_LINE_BREAKPOINT const *breakpoints) override
+	{
+		if (position + length > (UINT32)m_breakpoints.size())
+			return E_INVALIDARG;
+		std::copy(breakpoints, breakpoints + length, m_breakpoints.begin() + position);
+		return S_OK;
+	}
+	HRESULT STDMETHODCALLTYPE SetBidiLevel(UINT32, UINT32, UINT8, UINT8) override { return S_OK; }
+	HRESULT STDMETHODCALLTYPE SetNumberSubstitution(UINT32, UINT32, IDWriteNumberSubstitution *) override { return S_OK; }
+
+private:
+	const std::wstring &m_text;
+	std::vector<CompareScriptRun> &m_runs;
+	std::vector<DWRITE_LINE_BREAKPOINT> &m_breakpoints;
+};
+
+// Script runs and break opportunities of `text`, once per sample text.
+static bool AnalyzeCompareText(const std::wstring &text)
+{
+	if (g_compareAnalysis.text == text && (g_compareAnalysis.valid || text.empty()))
+		return g_compareAnalysis.valid;
+	FP_TRACE_SCOPE("CompareAnalyze");
+	CompareAnalysis &a = g_compareAnalysis;
+	a = CompareAnalysis{};
+	a.text = text;
+	a.textHash = PreviewCache::HashText(text);
+	ComPtr<IDWriteTextAnalyzer> analyzer;
+	if (text.empty() || FAILED(g_dwriteFactory->CreateTextAnalyzer(&analyzer)))
+		return false;
+	std::vector<DWRITE_LINE_BREAKPOINT> points;
+	CompareTextAnalysis analysis(text, a.runs, points);
+	UINT32 length = (UINT32)text.size();
+	HRESULT hr = analyzer->AnalyzeScript(&analysis, 0, length, &analysis);
+	if (SUCCEEDED(hr))
+		hr = analyzer->AnalyzeLineBreakpoints(&analysis, 0, length, &analysis);
+	if (FAILED(hr) || a.runs.empty())
+	{
+		FP_LOG(logger, Warn, kCatRender, L"Compare: text analysis failed 0x%08x", hr);
+		a.runs.clear();
+		return false;
+	}
+	std::sort(a.runs.begin(), a.runs.end(), [](const CompareScriptRun &l, const CompareScriptRun &r)
+			  { return l.start < r.start; });
+	a.breaks.assign(length, 0);
+	for (UINT32 i = 0; i < length; i++)
+	{
+		uint8_t flags = points[i].isWhitespace ? Compare::kWhitespace : 0;
+		if (i + 1 < length)
+		{
+			UINT8 after = points[i].breakConditionAfter;
+			UINT8 before = points[i + 1].breakConditionBefore;
+			if (after == DWRITE_BREAK_CONDITION_MUST_BREAK || before == DWRITE_BREAK_CONDITION_MUST_BREAK)
+				flags |= Compare::kMustBreakAfter;
+			else if (after != DWRITE_BREAK_CONDITION_MAY_NOT_BREAK && before != DWRITE_BREAK_CONDITION_MAY_NOT_BREAK &&
+					 (after == DWRITE_BREAK_CONDITION_CAN_BREAK || before == DWRITE_BREAK_CONDITION_CAN_BREAK))
+				flags |= Compare::kCanBreakAfter;
+		}
+		a.breaks[i] = flags;
+	}
+	a.valid = true;
+	g_compareStats.analyses++;
+	return true;
+}
+
+// The face the preview's text format would pick: the family in the system
+// or the file's collection, the face row's weight/stretch/style and, for
+// named instances, its axis coordinates. Thread-safe.
+static HRESULT CreateCompareFontFace(const PreviewLayoutJob &job, ComPtr<IDWriteFontFace> &outFace)
+{
+	ComPtr<IDWriteFontCollection1> externalCollection;
+	ComPtr<IDWriteFontCollection> collection = g_systemFontCollection;
+	HRESULT hr = S_OK;
+	if (!job.isSystemFont)
+	{
+		hr = GetOrCreateExternalFontCollection(job.filePath, &externalCollection);
+		collection = externalCollection.Get();
+	}
+	else if (!collection)
+	{
+		hr = g_dwriteFactory->GetSystemFontCollection(&collection);
+	}
+	if (SUCCEEDED(hr) && !collection)
+		hr = E_FAIL;
+	UINT32 familyIndex = 0;
+	BOOL exists = FALSE;
+	ComPtr<IDWriteFontFamily> family;
+	ComPtr<IDWriteFont> font;
+	if (SUCCEEDED(hr))
+		hr = collection->FindFamilyName(job.family.c_str(), &familyIndex, &exists);
+	if (SUCCEEDED(hr) && !exists)
+		hr = E_FAIL;
+	if (SUCCEEDED(hr))
+		hr = collection->GetFontFamily(familyIndex, &family);
+	if (SUCCEEDED(hr))
+		hr = family->GetFirstMatchingFont(job.hasFace ? job.face.weight : DWRITE_FONT_WEIGHT_NORMAL, job.hasFace ? job.face.stretch : DWRITE_FONT_STRETCH_NORMAL,
+										  job.hasFace ? job.face.style : DWRITE_FONT_STYLE_NORMAL, &font);
+	if (SUCCEEDED(hr))
+		hr = font->CreateFontFace(&outFace);
+	if (SUCCEEDED(hr) && job.hasFace && !job.face.axisValues.empty())
+	{
+		ComPtr<IDWriteFontFace5> face5;
+		ComPtr<IDWriteFontResource> resource;
+		ComPtr<IDWriteFontFace5> instance;
+		if (SUCCEEDED(outFace.As(&face5)) && SUCCEEDED(face5->GetFontResource(&resource)) &&
+			SUCCEEDED(resource->CreateFontFace(DWRITE_FONT_SIMULATIONS_NONE, job.face.axisValues.data(), (UINT32)job.face.axisValues.size(), &instance)))
+			outFace = instance.Get();
+	}
+	return hr;
+}
 
-void ApplyFilter()
+// Map and position the glyphs of every shared script run in `face`, then
+// break the cluster widths into lines. Thread-safe; `analysis` is only read.
+static bool ShapeCompareRow(IDWriteTextAnalyzer *analyzer, const CompareAnalysis &analysis, IDWriteFontFace *face, float emSize, float maxWidth,
+							CompareShape &out)
 {
-	g_filteredIndices.clear();
-	std::wstring qLower = ToLower(g_searchQuery);
-	if (logger)
+	FP_TRACE_SCOPE("CompareShape");
+	out = CompareShape{};
+	const std::wstring &text = analysis.text;
+	UINT32 length = (UINT32)text.size();
+	std::vector<UINT16> clusterMap(length);
+	std::vector<DWRITE_SHAPING_TEXT_PROPERTIES> textProps(length);
+	std::vector<UINT16> runGlyphs;
+	std::vector<DWRITE_SHAPING_GLYPH_PROPERTIES> glyphProps;
+	std::vector<UINT32> glyphAt(length);				  // first glyph of each position's cluster
+	std::vector<UINT32> runGlyphEnd(analysis.runs.size()); // one past each run's last glyph
+	std::vector<float> widths(length, 0.0f);
+	std::vector<uint8_t> breaks = analysis.breaks;
+	for (size_t r = 0; r < analysis.runs.size(); r++)
 	{
-		std::wstring msg = L"ApplyFilter: query='" + g_searchQuery + L"'";
-		logger->verbose(logger, msg.c_str());
+		const CompareScriptRun &run = analysis.runs[r];
+		UINT32 maxGlyphs = run.length * 3 / 2 + 16;
+		UINT32 glyphCount = 0;
+		HRESULT hr;
+		for (;;)
+		{
+			runGlyphs.resize(maxGlyphs);
+			glyphProps.resize(maxGlyphs);
+			hr = analyzer->GetGlyphs(text.c_str() + run.start, run.length, face, FALSE, FALSE, &run.analysis, L"ja-jp", nullptr, nullptr, nullptr, 0,
+									 maxGlyphs, &clusterMap[run.start], &textProps[run.start], runGlyphs.data(), glyphProps.data(), &glyphCount);
+			if (hr != E_NOT_SUFFICIENT_BUFFER)
+				break;
+			maxGlyphs *= 2;
+		}
+		if (FAILED(hr))
+			return false;
+		UINT32 base = (UINT32)out.glyphs.size();
+		out.glyphs.insert(out.glyphs.end(), runGlyphs.begin(), runGlyphs.begin() + glyphCount);
+		out.advances.resize(base + glyphCount);
+		out.offsets.resize(base + glyphCount);
+		hr = analyzer->GetGlyphPlacements(text.c_str() + run.start, &clusterMap[run.start], &textProps[run.start], run.length, runGlyphs.data(), glyphProps.data(),
+										  glyphCount, face, emSize, FALSE, FALSE, &run.analysis, L"ja-jp", nullptr, nullptr, 0, &out.advances[base],
+										  &out.offsets[base]);
+		if (FAILED(hr))
+			return false;
+		runGlyphEnd[r] = base + glyphCount;
+		// A cluster's width goes on its first position; no breaks inside it.
+		UINT32 clusterStart = run.start;
+		for (UINT32 i = 0; i < run.length; i++)
+			glyphAt[run.start + i] = base + clusterMap[run.start + i];
+		for (UINT32 i = 1; i <= run.length; i++)
+		{
+			UINT32 pos = run.start + i;
+			if (i < run.length && clusterMap[pos] == clusterMap[pos - 1])
+			{
+				breaks[pos - 1] &= (uint8_t)~(Compare::kCanBreakAfter | Compare::kMustBreakAfter);
+				continue;
+			}
+			UINT32 glyphEnd = i < run.length ? glyphAt[pos] : runGlyphEnd[r];
+			float width = 0.0f;
+			for (UINT32 g = glyphAt[clusterStart]; g < glyphEnd; g++)
+				width += out.advances[g];
+			widths[clusterStart] = width;
+			clusterStart = pos;
+		}
 	}
-	for (size_t i = 0; i < g_fontList.size(); i++)
+
+	DWRITE_FONT_METRICS metrics{};
+	face->GetMetrics(&metrics);
+	float scale = emSize / (float)(metrics.designUnitsPerEm ? metrics.designUnitsPerEm : 1);
+	out.ascent = metrics.ascent * scale;
+	out.lineHeight = std::ceil((metrics.ascent + metrics.descent + metrics.lineGap) * scale);
+
+	Compare::LineSpan lines[Compare::kMaxRowLines];
+	out.lineCount = Compare::BreakLines(widths.data(), breaks.data(), length, maxWidth, lines, Compare::kMaxRowLines);
+	out.truncated = out.lineCount > 0 && lines[out.lineCount - 1].end < length;
+	for (int l = 0; l < out.lineCount; l++)
 	{
-		const auto &item = g_fontList[i];
-		if (g_filterType == FontTypeFilter::System && !item.isSystemFont)
-			continue;
-		if (g_filterType == FontTypeFilter::Folder && item.isSystemFont)
-			continue;
-		if (!qLower.empty())
+		float x = 0.0f;
+		for (size_t r = 0; r < analysis.runs.size(); r++)
 		{
-			std::wstring nameLower = ToLower(item.displayName);
-			if (nameLower.find(qLower) == std::wstring::npos)
+			const CompareScriptRun &run = analysis.runs[r];
+			UINT32 start = (std::max)(lines[l].start, run.start);
+			UINT32 end = (std::min)(lines[l].end, run.start + run.length);
+			if (start >= end)
 				continue;
+			ComparePiece piece;
+			piece.line = l;
+			piece.glyphStart = glyphAt[start];
+			piece.glyphCount = (end < run.start + run.length ? glyphAt[end] : runGlyphEnd[r]) - piece.glyphStart;
+			piece.x = x;
+			for (UINT32 g = piece.glyphStart; g < piece.glyphStart + piece.glyphCount; g++)
+				x += out.advances[g];
+			out.pieces.push_back(piece);
 		}
-		g_filteredIndices.push_back((int)i);
 	}
-	RebuildListViewItems();
-	if (!g_filteredIndices.empty())
+	return true;
+}
+
+// Caption above a row: the font's name, plus the face for face rows.
+static void BuildCompareLabel(CompareSlot &slot)
+{
+	IDWriteTextFormat *format = SpecimenLabelFormat();
+	if (slot.label || !format)
+		return;
+	std::wstring caption = g_fontList[slot.fontIndex].displayName;
+	WithFamilyFace(slot.fontIndex, slot.faceIndex, [&](const FontFaceEntry &face)
+				   { caption += L" / " + face.faceName; });
+	g_dwriteFactory->CreateTextLayout(caption.c_str(), (UINT32)caption.size(), format, 4096.0f, kCompareLabelHeightDips, &slot.label);
+}
+
+// Bring every pinned row up to date for `sample` in a w x h preview. Rows
+// whose text or width changed are reshaped in parallel (the UI thread
+// takes part, see TaskQueue::ParallelFor). Returns the rows ready to draw.
+static int PrepareCompare(const std::wstring &sample, int w, int h)
+{
+	FP_TRACE_SCOPE("ComparePrepare");
+	float width = (std::max)(40.0f, (FLOAT)w - 20.0f);
+	float emSize = Specimen::PointsToDips(kCompareFontSizePt);
+	if (!AnalyzeCompareText(sample))
+		return 0;
+	uint64_t textKey = FontHash::Hash64(&width, sizeof(width), g_compareAnalysis.textHash);
+
+	size_t stale[Compare::kMaxPinned];
+	uint64_t staleKeys[Compare::kMaxPinned];
+	bool hadFace[Compare::kMaxPinned];
+	PreviewLayoutJob jobs[Compare::kMaxPinned];
+	size_t staleCount = 0;
+	for (size_t i = 0; i < g_compareSlots.size() && staleCount < (size_t)Compare::kMaxPinned; i++)
 	{
-		if (std::find(g_filteredIndices.begin(), g_filteredIndices.end(), g_selectedFontIndex) == g_filteredIndices.end())
+		CompareSlot &slot = g_compareSlots[i];
+		if (slot.fontIndex < 0)
+			continue;
+		if (slot.faceIndex >= 0 && GetFamilyFaceCount(slot.fontIndex) < 0)
 		{
-			g_selectedFontIndex = g_filteredIndices.front();
+			RequestFamilyFaces(slot.fontIndex, TaskQueue::Priority::High);
+			continue;
 		}
+		uint64_t shapeKey = FontHash::Hash64(&slot.fontKey, sizeof(slot.fontKey), textKey);
+		if (slot.shapeKey == shapeKey)
+			continue;
+		hadFace[staleCount] = slot.face.Get() != nullptr;
+		if (!slot.face)
+			MakePreviewLayoutJob(slot.fontIndex, slot.faceIndex, jobs[staleCount]);
+		staleKeys[staleCount] = shapeKey;
+		stale[staleCount++] = i;
 	}
-	else
+	if (staleCount > 0)
 	{
-		g_selectedFontIndex = -1;
+		g_backgroundTasks.ParallelFor(staleCount, kCompareHelpers, TaskQueue::Priority::High, kTaskTagCompare, [&](size_t n)
+									  {
+			CompareSlot &slot = g_compareSlots[stale[n]];
+			if (!slot.face && FAILED(CreateCompareFontFace(jobs[n], slot.face)))
+				slot.face.Reset();
+			ComPtr<IDWriteTextAnalyzer> analyzer;
+			slot.failed = !slot.face || FAILED(g_dwriteFactory->CreateTextAnalyzer(&analyzer)) ||
+						  !ShapeCompareRow(analyzer.Get(), g_compareAnalysis, slot.face.Get(), emSize, width, slot.shape); });
+		g_compareStats.parallelBatches++;
+		for (size_t n = 0; n < staleCount; n++)
+		{
+			CompareSlot &slot = g_compareSlots[stale[n]];
+			slot.shapeKey = staleKeys[n];
+			g_compareStats.rowsShaped++;
+			if (!hadFace[n] && slot.face)
+				g_compareStats.facesCreated++;
+			if (slot.failed)
+				FP_LOG(logger, Warn, kCatRender, L"Compare: could not shape %ls", g_fontList[slot.fontIndex].displayName.c_str());
+		}
 	}
-	UpdateDetailPanel();
-	RedrawGrid();
-	RenderPreview(L"ApplyFilter");
-	if (logger)
+
+	int ready = 0;
+	float y = 0.0f;
+	for (CompareSlot &slot : g_compareSlots)
 	{
-		wchar_t buf[128];
-		swprintf_s(buf, L"ApplyFilter: filtered=%d", (int)g_filteredIndices.size());
-		logger->info(logger, buf);
+		if (slot.fontIndex < 0 || slot.shapeKey == 0)
+			continue;
+		BuildCompareLabel(slot);
+		y += kCompareLabelHeightDips + (slot.failed ? 0.0f : slot.shape.lineCount * slot.shape.lineHeight) + kCompareRowGapDips;
+		ready++;
 	}
+	g_compareContentHeight = y;
+	float maxScroll = (std::max)(0.0f, y - ((FLOAT)h - 20.0f));
+	g_specimenScroll = (std::min)((std::max)(g_specimenScroll, 0.0f), maxScroll);
+	FP_LOG_VERBOSE_RATE(logger, kCatRender, kPerFrameLogIntervalMs, L"Compare: pinned=%d ready=%d reshaped=%d content=%.0f",
+						(int)g_compareSlots.size(), ready, (int)staleCount, g_compareContentHeight);
+	return ready;
 }
 
-void RebuildListViewItems()
+// Called between BeginDraw and EndDraw on the swap chain target.
+static void DrawCompare(int rows)
 {
-	if (!g_hwndGrid)
+	g_compareStats.frames++;
+	ID2D1SolidColorBrush *labelBrush = SpecimenLabelBrush();
+	if (rows == 0)
+	{
+		static const wchar_t kHint[] = L"右クリックメニューの「比較にピン留め」で選択中のフォントを追加します";
+		if (!g_compareHint && SpecimenLabelFormat())
+			g_dwriteFactory->CreateTextLayout(kHint, (UINT32)wcslen(kHint), SpecimenLabelFormat(), 4096.0f, kCompareLabelHeightDips, &g_compareHint);
+		if (g_compareHint && labelBrush)
+			g_d2dContext->DrawTextLayout(D2D1::Point2F(10.0f, 10.0f), g_compareHint.Get(), labelBrush, D2D1_DRAW_TEXT_OPTIONS_NONE);
+		return;
+	}
+	if (!g_previewTextBrush && FAILED(g_d2dContext->CreateSolidColorBrush(D2D1::ColorF(0, 0, 0, 1), &g_previewTextBrush)))
 		return;
-	ListView_DeleteAllItems(g_hwndGrid);
-	LVITEMW item{};
-	item.mask = LVIF_TEXT | LVIF_PARAM;
-	for (size_t i = 0; i < g_filteredIndices.size(); i++)
+	float emSize = Specimen::PointsToDips(kCompareFontSizePt);
+	float y = 10.0f - g_specimenScroll;
+	for (const CompareSlot &slot : g_compareSlots)
 	{
-		item.iItem = (int)i;
-		item.lParam = g_filteredIndices[i];
-		int fontIdx = g_filteredIndices[i];
-		if (fontIdx >= 0 && fontIdx < (int)g_fontList.size())
-		{
-			item.pszText = const_cast<wchar_t *>(g_fontList[fontIdx].displayName.c_str());
-		}
-		else
+		if (slot.fontIndex < 0 || slot.shapeKey == 0)
+			continue;
+		if (slot.label && labelBrush)
+			g_d2dContext->DrawTextLayout(D2D1::Point2F(10.0f, y), slot.label.Get(), labelBrush, D2D1_DRAW_TEXT_OPTIONS_NONE);
+		y += kCompareLabelHeightDips;
+		if (!slot.failed)
 		{
-			item.pszText = const_cast<wchar_t *>(L"");
+			const CompareShape &shape = slot.shape;
+			for (const ComparePiece &piece : shape.pieces)
+			{
+				DWRITE_GLYPH_RUN run{};
+				run.fontFace = slot.face.Get();
+				run.fontEmSize = emSize;
+				run.glyphCount = piece.glyphCount;
+				run.glyphIndices = &shape.glyphs[piece.glyphStart];
+				run.glyphAdvances = &shape.advances[piece.glyphStart];
+				run.glyphOffsets = &shape.offsets[piece.glyphStart];
+				D2D1_POINT_2F baseline = D2D1::Point2F(10.0f + piece.x, y + piece.line * shape.lineHeight + shape.ascent);
+				g_d2dContext->DrawGlyphRun(baseline, &run, g_previewTextBrush.Get(), DWRITE_MEASURING_MODE_NATURAL);
+			}
+			y += shape.lineCount * shape.lineHeight;
 		}
-		ListView_InsertItem(g_hwndGrid, &item);
+		y += kCompareRowGapDips;
+		g_compareStats.rowsDrawn++;
 	}
-	if (g_selectedFontIndex >= 0)
-	{
-		for (size_t i = 0; i < g_filteredIndices.size(); i++)
+}
+
+static void LogCompareStats(const wchar_t *reason)
+{
+	if (!logger || g_compareStats.frames == 0)
+		return;
+	wchar_t buf[256];
+	swprintf_s(buf, L"Compare[%ls]: pinned=%d frames=%llu rowsDrawn=%llu analyses=%llu rowsShaped=%llu batches=%llu faces=%llu",
+			   reason, (int)g_compareSlots.size(), (unsigned long long)g_compareStats.frames, (unsigned long long)g_compareStats.rowsDrawn,
+			   (unsigned long long)g_compareStats.analyses, (unsigned long long)g_compareStats.rowsShaped,
+			   (unsigned long long)g_compareStats.parallelBatches, (unsigned long long)g_compareStats.facesCreated);
+	logger->info(logger, buf);
+}
+
+static size_t CompareBytes()
+{
+	size_t bytes = g_compareAnalysis.text.capacity() * sizeof(wchar_t) + g_compareAnalysis.breaks.capacity() +
+				   g_compareAnalysis.runs.capacity() * sizeof(CompareScriptRun);
+	for (const CompareSlot &slot : g_compareSlots)
+		bytes += slot.shape.Bytes() + (slot.face ? 4096 : 0);
+	return bytes;
+}
+
+// Shapes and faces are rebuilt on the next compare frame.
+static void RegisterCompareMemory()
+{
+	g_memoryBudget.Register(
+		"CompareRows", MemoryBudget::Priority::Low,
+		[]
+		{ return CompareBytes(); },
+		[](size_t)
 		{
-			if (g_filteredIndices[i] == g_selectedFontIndex)
+			size_t before = CompareBytes();
+			for (CompareSlot &slot : g_compareSlots)
 			{
-				ListView_SetItemState(g_hwndGrid, (int)i, LVIS_SELECTED | LVIS_FOCUSED, LVIS_SELECTED | LVIS_FOCUSED);
-				ListView_EnsureVisible(g_hwndGrid, (int)i, FALSE);
-				break;
+				slot.shape = CompareShape{};
+				slot.shapeKey = 0;
+				slot.face.Reset();
 			}
+			return before - CompareBytes();
+		});
+}
+
+//---------------------------------------------------------------------
+//	Glyph browser
+//---------------------------------------------------------------------
+// Every codepoint the selection's cmap maps, as a scrolling grid (see
+// GlyphGrid.h). A worker reads the cmap into ranges and lists the Unicode
+// blocks; the UI thread only ever looks at the cells in view. Cells are
+// rasterized once (glyph and codepoint) into a fixed-size atlas bitmap and
+// each frame draws them from it with one DrawBitmap per cell. After a
+// frame, a worker resolves the glyph ids of the next page in the scroll
+// direction and the UI thread rasterizes them a chunk per
+// WM_GLYPH_PREFETCH, since the D2D context is not shared. The atlas never
+// evicts a cell drawn in the current frame. Memory is the cmap's ranges
+// plus the atlas, however many glyphs the font has.
+constexpr float kGlyphCellDips = 64.0f;
+constexpr float kGlyphLabelDips = 14.0f;
+constexpr float kGlyphHeaderDips = 22.0f;
+constexpr float kGlyphEmFraction = 0.6f; // glyph em size relative to the cell
+// Slots per visible cell: the view, the page being prefetched and slack
+// for scrolling back.
+constexpr float kGlyphAtlasSlack = 2.5f;
+constexpr UINT kGlyphAtlasMaxSide = 2048;
+// Prefetched cells rasterized per WM_GLYPH_PREFETCH, so input stays responsive.
+constexpr size_t kGlyphRasterPerMessage = 48;
+
+// The selection's cmap, built by a worker and then owned by the UI thread.
+struct GlyphTable
+{
+	uint64_t key = 0; // font and face, see GlyphTableKey
+	ComPtr<IDWriteFontFace> face;
+	GlyphGrid::CodepointIndex index;
+	std::vector<GlyphGrid::BlockEntry> blocks;
+	float ascent = 0.8f; // per em
+	float descent = 0.2f;
+	bool failed = false;
+};
+
+// Codepoints and their glyph ids and advances (DIPs at the cell's em size).
+struct GlyphPage
+{
+	uint64_t key = 0; // GlyphTable::key
+	std::vector<UINT32> codepoints;
+	std::vector<UINT16> glyphs;
+	std::vector<FLOAT> advances;
+};
+
+struct GlyphAtlas
+{
+	ComPtr<ID2D1Bitmap1> bitmap;
+	GlyphGrid::AtlasSlots slots;
+	int columns = 0;
+	UINT width = 0; // pixels
+	UINT height = 0;
+	uint64_t key = 0; // table and background the cells were drawn for
+};
+
+// What DrawGlyphs shows: cells [first, last) of the grid, or a hint.
+struct GlyphFrame
+{
+	bool ready = false;
+	const wchar_t *hint = nullptr;
+	uint32_t first = 0;
+	uint32_t last = 0;
+	float width = 0.0f;
+	float bottom = 0.0f;
+};
+
+struct GlyphStats
+{
+	uint64_t frames = 0;
+	uint64_t cellsDrawn = 0;
+	uint64_t cellsRasterized = 0; // on demand, for the frame in view
+	uint64_t cellsPrefetched = 0;
+	uint64_t pagesPrefetched = 0;
+	uint64_t tablesLoaded = 0;
+	uint64_t atlasCreates = 0;
+};
+
+static GlyphTable g_glyphTable;
+static uint64_t g_glyphRequestedKey = 0;
+static GlyphAtlas g_glyphAtlas;
+static GlyphGrid::Layout g_glyphLayout;
+static GlyphStats g_glyphStats;
+static uint64_t g_glyphFrameStamp = 0;
+static uint32_t g_glyphSelected = 0;
+static float g_glyphLastScroll = 0.0f;
+static int g_glyphBlockShown = -1;
+static GlyphPage g_glyphVisible;			   // reused every frame
+static std::vector<int> g_glyphCellSlots;	   // atlas slot per visible cell
+static std::vector<uint32_t> g_glyphMissing;   // visible cells not in the atlas
+static GlyphPage g_glyphMissingPage;
+static uint32_t g_glyphPrefetchFirst = 0;
+static uint64_t g_glyphPrefetchKey = 0;
+static GlyphPage g_glyphPrefetchPage; // being rasterized, UI thread
+static size_t g_glyphPrefetchNext = 0;
+// Handed back by workers, waiting for the UI thread.
+static std::mutex g_glyphMutex;
+static std::vector<GlyphTable> g_glyphLoadedTables;
+static std::vector<GlyphPage> g_glyphPrefetched;
+
+static uint64_t GlyphTableKey(int fontIdx, int faceIdx)
+{
+	const std::wstring &cacheKey = g_fontList[fontIdx].cacheKey;
+	uint64_t key = FontHash::Hash64(cacheKey.data(), cacheKey.size() * sizeof(wchar_t));
+	WithFamilyFace(fontIdx, faceIdx, [&](const FontFaceEntry &face)
+				   { key = FontHash::Hash64(&face.styleHash, sizeof(face.styleHash), key); });
+	return key | 1; // 0 means "none"
+}
+
+// Worker side: the face the preview uses, its cmap and its blocks.
+static bool LoadGlyphTable(const PreviewLayoutJob &job, GlyphTable &table)
+{
+	if (FAILED(CreateCompareFontFace(job, table.face)))
+		return false;
+	DWRITE_FONT_METRICS metrics{};
+	table.face->GetMetrics(&metrics);
+	if (metrics.designUnitsPerEm != 0)
+	{
+		table.ascent = (float)metrics.ascent / metrics.designUnitsPerEm;
+		table.descent = (float)metrics.descent / metrics.designUnitsPerEm;
+	}
+	const void *data = nullptr;
+	UINT32 size = 0;
+	void *context = nullptr;
+	BOOL exists = FALSE;
+	if (FAILED(table.face->TryGetFontTable(DWRITE_MAKE_OPENTYPE_TAG('c', 'm', 'a', 'p'), &data, &size, &context, &exists)) || !exists)
+		return false;
+	std::vector<std::pair<uint32_t, uint32_t>> pairs;
+	bool ok = GlyphGrid::ReadCmap((const uint8_t *)data, size, pairs);
+	table.face->ReleaseFontTable(context);
+	if (!ok)
+		return false;
+	table.index.Assign(std::move(pairs));
+	GlyphGrid::ListBlocks(table.index, table.blocks);
+	return true;
+}
+
+static void RequestGlyphTable(int fontIdx, int faceIdx, uint64_t key)
+{
+	if (g_glyphRequestedKey == key)
+		return;
+	PreviewLayoutJob job;
+	if (!MakePreviewLayoutJob(fontIdx, faceIdx, job))
+		return;
+	g_glyphRequestedKey = key;
+	g_backgroundTasks.Cancel(kTaskTagGlyphs);
+	HWND hwnd = g_hwndMain;
+	g_backgroundTasks.Post(TaskQueue::Priority::High, kTaskTagGlyphs, [job, key, hwnd]
+						   {
+		FP_TRACE_SCOPE("GlyphTable");
+		GlyphTable table;
+		table.key = key;
+		table.failed = !LoadGlyphTable(job, table);
+		{
+			std::lock_guard<std::mutex> lock(g_glyphMutex);
+			g_glyphLoadedTables.push_back(std::move(table));
 		}
+		if (hwnd)
+			PostMessageW(hwnd, WM_GLYPH_TABLE_READY, 0, 0); });
+}
+
+static void FillGlyphBlockCombo()
+{
+	g_glyphBlockShown = -1;
+	if (!g_hwndGlyphBlock)
+		return;
+	SendMessageW(g_hwndGlyphBlock, CB_RESETCONTENT, 0, 0);
+	for (const GlyphGrid::BlockEntry &entry : g_glyphTable.blocks)
+	{
+		wchar_t text[96];
+		swprintf_s(text, L"%ls (%u)", GlyphGrid::kBlocks[entry.block].name, entry.count);
+		SendMessageW(g_hwndGlyphBlock, CB_ADDSTRING, 0, (LPARAM)text);
 	}
-	if (logger)
+}
+
+// WM_GLYPH_TABLE_READY: adopt the table for the current selection; tables
+// for selections since left are dropped.
+static void HandleGlyphTableReady()
+{
+	std::vector<GlyphTable> loaded;
 	{
-		wchar_t buf[128];
-		swprintf_s(buf, L"RebuildListViewItems: items=%d", (int)g_filteredIndices.size());
-		logger->verbose(logger, buf);
+		std::lock_guard<std::mutex> lock(g_glyphMutex);
+		loaded.swap(g_glyphLoadedTables);
+	}
+	for (GlyphTable &table : loaded)
+	{
+		if (table.key != g_glyphRequestedKey)
+			continue;
+		g_glyphTable = std::move(table);
+		g_glyphStats.tablesLoaded++;
+		g_glyphSelected = 0;
+		g_glyphLastScroll = 0.0f;
+		if (g_specimenMode == Specimen::Mode::Glyphs)
+			g_specimenScroll = 0.0f;
+		FillGlyphBlockCombo();
+		if (g_glyphTable.failed)
+			FP_LOG(logger, Warn, kCatRender, L"Glyphs: no readable cmap");
+		else
+			FP_LOG(logger, Info, kCatRender, L"Glyphs: %u codepoints in %u ranges (%uKB), %u blocks", g_glyphTable.index.Count(),
+				   (UINT)g_glyphTable.index.Ranges().size(), (UINT)(g_glyphTable.index.Bytes() / 1024), (UINT)g_glyphTable.blocks.size());
+		if (g_specimenMode == Specimen::Mode::Glyphs)
+			MarkDirty(DirtyState::Action::GlyphTable, DirtyState::Preview);
 	}
 }
 
-void RedrawGrid()
+// Glyph ids and advances for page.codepoints. Thread-safe.
+static void ResolveGlyphPage(IDWriteFontFace *face, GlyphPage &page)
 {
-	if (g_hwndGrid)
+	size_t n = page.codepoints.size();
+	page.glyphs.assign(n, 0);
+	page.advances.assign(n, 0.0f);
+	if (n == 0 || FAILED(face->GetGlyphIndices(page.codepoints.data(), (UINT32)n, page.glyphs.data())))
+		return;
+	DWRITE_FONT_METRICS fontMetrics{};
+	face->GetMetrics(&fontMetrics);
+	if (fontMetrics.designUnitsPerEm == 0)
+		return;
+	float scale = kGlyphCellDips * kGlyphEmFraction / fontMetrics.designUnitsPerEm;
+	std::vector<DWRITE_GLYPH_METRICS> metrics(n);
+	if (SUCCEEDED(face->GetDesignGlyphMetrics(page.glyphs.data(), (UINT32)n, metrics.data(), FALSE)))
 	{
-		RedrawWindow(g_hwndGrid, nullptr, nullptr, RDW_INVALIDATE | RDW_ERASE | RDW_UPDATENOW);
-		if (logger)
-			logger->verbose(logger, L"RedrawGrid: invalidated ListView");
+		for (size_t i = 0; i < n; i++)
+			page.advances[i] = metrics[i].advanceWidth * scale;
 	}
 }
 
-bool EnsurePreviewDevice()
+static void ResetGlyphAtlas()
 {
-	if (g_d3dDevice && g_d3dContext && g_d2dFactory && g_d2dDevice && g_d2dContext)
+	g_glyphAtlas.bitmap.Reset();
+	g_glyphAtlas.slots.Reset(0);
+	g_glyphAtlas.width = g_glyphAtlas.height = 0;
+	g_glyphAtlas.key = 0;
+	g_glyphPrefetchPage = GlyphPage{};
+	g_glyphPrefetchKey = 0;
+}
+
+// An atlas with room for kGlyphAtlasSlack times the visible cells, in
+// whole rows and at most kGlyphAtlasMaxSide square; recreated (empty)
+// when the table or background changes or the view outgrows it.
+static bool EnsureGlyphAtlas(uint32_t visibleCells, uint64_t key)
+{
+	UINT cellPx = (UINT)kGlyphCellDips;
+	int columns = (int)(kGlyphAtlasMaxSide / cellPx);
+	int maxSlots = columns * columns;
+	int want = (std::min)(maxSlots, (std::max)(columns, (int)std::ceil(visibleCells * kGlyphAtlasSlack)));
+	if (g_glyphAtlas.bitmap && g_glyphAtlas.key == key && (g_glyphAtlas.slots.Capacity() >= want || g_glyphAtlas.slots.Capacity() == maxSlots))
 		return true;
-	UINT flags = D3D11_CREATE_DEVICE_BGRA_SUPPORT;
-#if defined(_DEBUG)
-	flags |= D3D11_CREATE_DEVICE_DEBUG;
-#endif
-	D3D_FEATURE_LEVEL levels[] = {
-		D3D_FEATURE_LEVEL_11_1,
-		D3D_FEATURE_LEVEL_11_0,
-		D3D_FEATURE_LEVEL_10_1,
-		D3D_FEATURE_LEVEL_10_0,
-	};
-	ComPtr<ID3D11Device> device;
-	ComPtr<ID3D11DeviceContext> context;
-	HRESULT hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, flags, levels, _countof(levels), D3D11_SDK_VERSION, &device, &g_featureLevel, &context);
-	if (FAILED(hr))
+	ResetGlyphAtlas();
+	int rows = (want + columns - 1) / columns;
+	D2D1_BITMAP_PROPERTIES1 props = D2D1::BitmapProperties1(
+		D2D1_BITMAP_OPTIONS_TARGET,
+		D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_IGNORE),
+		96.0f, 96.0f);
+	if (FAILED(g_d2dContext->CreateBitmap(D2D1::SizeU(columns * cellPx, rows * cellPx), nullptr, 0, props, &g_glyphAtlas.bitmap)))
+		return false;
+	g_glyphAtlas.slots.Reset(rows * columns);
+	g_glyphAtlas.columns = columns;
+	g_glyphAtlas.width = columns * cellPx;
+	g_glyphAtlas.height = rows * cellPx;
+	g_glyphAtlas.key = key;
+	g_glyphStats.atlasCreates++;
+	FP_LOG(logger, Info, kCatRender, L"Glyphs: atlas %ux%u (%d cells, %uKB)", g_glyphAtlas.width, g_glyphAtlas.height, rows * columns,
+		   (UINT)((size_t)g_glyphAtlas.width * g_glyphAtlas.height * 4 / 1024));
+	return true;
+}
+
+static D2D1_RECT_F GlyphAtlasRect(int slot)
+{
+	float x = (float)(slot % g_glyphAtlas.columns) * kGlyphCellDips;
+	float y = (float)(slot / g_glyphAtlas.columns) * kGlyphCellDips;
+	return D2D1::RectF(x, y, x + kGlyphCellDips, y + kGlyphCellDips);
+}
+
+// Draw page cells [begin, end) that are not in the atlas yet into newly
+// allocated slots stamped `stamp`, leaving slots stamped `protectFrom` or
+// later alone. `outSlots` (optional) receives each cell's slot, -1 when
+// the atlas had no free slot. Must be called outside BeginDraw/EndDraw on
+// the swap chain target. Returns the cells drawn.
+static size_t RasterizeGlyphCells(const GlyphPage &page, size_t begin, size_t end, uint64_t stamp, uint64_t protectFrom, int *outSlots)
+{
+	if (!g_previewTextBrush && FAILED(g_d2dContext->CreateSolidColorBrush(D2D1::ColorF(0, 0, 0, 1), &g_previewTextBrush)))
+		return 0;
+	IDWriteTextFormat *labelFormat = SpecimenLabelFormat();
+	ID2D1SolidColorBrush *labelBrush = SpecimenLabelBrush();
+	D2D1_COLOR_F bg = D2D1::ColorF(GetRValue(g_previewBgColor) / 255.0f, GetGValue(g_previewBgColor) / 255.0f, GetBValue(g_previewBgColor) / 255.0f, 1.0f);
+	float em = kGlyphCellDips * kGlyphEmFraction;
+	float glyphTop = (kGlyphCellDips - kGlyphLabelDips - (g_glyphTable.ascent + g_glyphTable.descent) * em) / 2.0f;
+	size_t drawn = 0;
+	g_d2dContext->SetTarget(g_glyphAtlas.bitmap.Get());
+	g_d2dContext->BeginDraw();
+	for (size_t n = begin; n < end; n++)
 	{
-		if (logger)
+		uint32_t cp = page.codepoints[n];
+		int slot = g_glyphAtlas.slots.Contains(cp) ? -1 : g_glyphAtlas.slots.Allocate(cp, stamp, protectFrom);
+		if (outSlots)
+			outSlots[n - begin] = slot;
+		if (slot < 0)
+			continue;
+		D2D1_RECT_F rect = GlyphAtlasRect(slot);
+		g_d2dContext->PushAxisAlignedClip(rect, D2D1_ANTIALIAS_MODE_ALIASED);
+		g_d2dContext->Clear(bg);
+		if (page.glyphs[n] != 0)
 		{
-			wchar_t buf[128];
-			swprintf_s(buf, L"D3D11CreateDevice failed: 0x%08x", hr);
-			logger->warn(logger, buf);
+			DWRITE_GLYPH_RUN run{};
+			run.fontFace = g_glyphTable.face.Get();
+			run.fontEmSize = em;
+			run.glyphCount = 1;
+			run.glyphIndices = &page.glyphs[n];
+			run.glyphAdvances = &page.advances[n];
+			D2D1_POINT_2F baseline = D2D1::Point2F(rect.left + (kGlyphCellDips - page.advances[n]) / 2.0f, rect.top + glyphTop + g_glyphTable.ascent * em);
+			g_d2dContext->DrawGlyphRun(baseline, &run, g_previewTextBrush.Get(), DWRITE_MEASURING_MODE_NATURAL);
 		}
-		return false;
+		wchar_t label[12];
+		int len = swprintf_s(label, L"%04X", cp);
+		ComPtr<IDWriteTextLayout> layout;
+		if (labelFormat && labelBrush &&
+			SUCCEEDED(g_dwriteFactory->CreateTextLayout(label, (UINT32)(std::max)(0, len), labelFormat, kGlyphCellDips, kGlyphLabelDips, &layout)))
+		{
+			layout->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_CENTER);
+			g_d2dContext->DrawTextLayout(D2D1::Point2F(rect.left, rect.bottom - kGlyphLabelDips), layout.Get(), labelBrush, D2D1_DRAW_TEXT_OPTIONS_NONE);
+		}
+		g_d2dContext->PopAxisAlignedClip();
+		drawn++;
 	}
-	g_d3dDevice = device;
-	g_d3dContext = context;
-	ComPtr<IDXGIDevice> dxgiDevice;
-	if (FAILED(g_d3dDevice.As(&dxgiDevice)))
+	HRESULT hr = g_d2dContext->EndDraw();
+	g_d2dContext->SetTarget(g_d2dTarget.Get());
+	if (FAILED(hr))
+	{
+		FP_LOG(logger, Warn, kCatRender, L"Glyphs: atlas draw failed 0x%08x", hr);
+		ResetGlyphAtlas();
+		return 0;
+	}
+	return drawn;
+}
+
+// WM_MOUSEWHEEL is shared with the specimen views (g_specimenScroll); a
+// click on a cell selects it.
+static bool HandleGlyphClick(HWND hwnd, POINT clientPt)
+{
+	if (g_specimenMode != Specimen::Mode::Glyphs || !g_hwndPreview || g_glyphLayout.count == 0)
 		return false;
-	D2D1_FACTORY_OPTIONS opts{};
-	if (FAILED(D2D1CreateFactory(D2D1_FACTORY_TYPE_MULTI_THREADED, __uuidof(ID2D1Factory1), &opts, &g_d2dFactory)))
+	POINT pt = clientPt;
+	ClientToScreen(hwnd, &pt);
+	ScreenToClient(g_hwndPreview, &pt);
+	RECT rc{};
+	GetClientRect(g_hwndPreview, &rc);
+	if (!PtInRect(&rc, pt))
 		return false;
-	if (FAILED(g_d2dFactory->CreateDevice(dxgiDevice.Get(), &g_d2dDevice)))
+	float x = (float)pt.x - 10.0f;
+	float y = (float)pt.y - 10.0f - kGlyphHeaderDips;
+	if (x < 0.0f || y < 0.0f)
+		return true;
+	int column = (int)(x / kGlyphCellDips);
+	uint32_t index = (uint32_t)((y + g_specimenScroll) / kGlyphCellDips) * (uint32_t)g_glyphLayout.columns + (uint32_t)column;
+	if (column >= g_glyphLayout.columns || index >= g_glyphLayout.count)
+		return true;
+	g_glyphSelected = index;
+	MarkDirty(DirtyState::Action::PreviewScroll, DirtyState::Preview);
+	return true;
+}
+
+static void JumpToGlyph(uint32_t index)
+{
+	if (g_glyphTable.index.Count() == 0)
+		return;
+	g_glyphSelected = (std::min)(index, g_glyphTable.index.Count() - 1);
+	g_specimenScroll = GlyphGrid::ScrollForIndex(g_glyphLayout, g_glyphSelected);
+	MarkDirty(DirtyState::Action::PreviewScroll, DirtyState::Preview);
+}
+
+// IDC_GLYPH_GOTO: "U+4E00", "4e00" or the character itself; lands on the
+// next mapped codepoint when the font lacks it.
+static void JumpToGlyphFromEdit()
+{
+	wchar_t text[32];
+	int len = GetWindowTextW(g_hwndGlyphGoto, text, _countof(text));
+	uint32_t cp = 0;
+	if (len > 0 && GlyphGrid::ParseCodepoint(text, (size_t)len, cp))
+		JumpToGlyph(g_glyphTable.index.LowerBound(cp));
+}
+
+// IDC_GLYPH_BLOCK: the block's first glyph.
+static void JumpToGlyphBlock(int entry)
+{
+	if (entry < 0 || entry >= (int)g_glyphTable.blocks.size())
+		return;
+	g_glyphBlockShown = entry;
+	JumpToGlyph(g_glyphTable.blocks[entry].firstIndex);
+}
+
+// Ask a worker for the glyph ids of the page after the view in the scroll
+// direction; cells already in the atlas are left out.
+static void PrefetchGlyphPage(uint32_t first, uint32_t last, bool down)
+{
+	uint32_t pageFirst = 0, pageLast = 0;
+	GlyphGrid::AdjacentPage(g_glyphLayout, first, last, down, pageFirst, pageLast);
+	if (pageLast <= pageFirst || (pageFirst == g_glyphPrefetchFirst && g_glyphTable.key == g_glyphPrefetchKey))
+		return;
+	GlyphPage page;
+	page.key = g_glyphTable.key;
+	for (uint32_t i = pageFirst; i < pageLast; i++)
+	{
+		uint32_t cp = g_glyphTable.index.CodepointAt(i);
+		if (!g_glyphAtlas.slots.Contains(cp))
+			page.codepoints.push_back(cp);
+	}
+	g_glyphPrefetchFirst = pageFirst;
+	g_glyphPrefetchKey = g_glyphTable.key;
+	if (page.codepoints.empty())
+		return;
+	g_backgroundTasks.Cancel(kTaskTagGlyphs);
+	ComPtr<IDWriteFontFace> face = g_glyphTable.face;
+	HWND hwnd = g_hwndMain;
+	g_backgroundTasks.Post(TaskQueue::Priority::Low, kTaskTagGlyphs, [page = std::move(page), face, hwnd]() mutable
+						   {
+		FP_TRACE_SCOPE("GlyphPrefetch");
+		ResolveGlyphPage(face.Get(), page);
+		{
+			std::lock_guard<std::mutex> lock(g_glyphMutex);
+			g_glyphPrefetched.clear();
+			g_glyphPrefetched.push_back(std::move(page));
+		}
+		if (hwnd)
+			PostMessageW(hwnd, WM_GLYPH_PREFETCH, 0, 0); });
+}
+
+// WM_GLYPH_PREFETCH: rasterize the next chunk of the prefetched page. Its
+// cells are stamped older than the frame on screen, so they never push
+// out a visible cell and a later page may reuse their slots.
+static void HandleGlyphPrefetch()
+{
+	{
+		std::lock_guard<std::mutex> lock(g_glyphMutex);
+		if (!g_glyphPrefetched.empty())
+		{
+			g_glyphPrefetchPage = std::move(g_glyphPrefetched.back());
+			g_glyphPrefetched.clear();
+			g_glyphPrefetchNext = 0;
+			g_glyphStats.pagesPrefetched++;
+		}
+	}
+	GlyphPage &page = g_glyphPrefetchPage;
+	if (g_specimenMode != Specimen::Mode::Glyphs || page.key != g_glyphTable.key || !g_glyphAtlas.bitmap ||
+		g_glyphPrefetchNext >= page.codepoints.size() || g_visibility.Current() != Visibility::State::Visible)
+		return;
+	size_t end = (std::min)(page.codepoints.size(), g_glyphPrefetchNext + kGlyphRasterPerMessage);
+	g_glyphStats.cellsPrefetched += RasterizeGlyphCells(page, g_glyphPrefetchNext, end, g_glyphFrameStamp - 1, g_glyphFrameStamp, nullptr);
+	g_glyphPrefetchNext = end;
+	if (end < page.codepoints.size() && g_hwndMain)
+		PostMessageW(g_hwndMain, WM_GLYPH_PREFETCH, 0, 0);
+}
+
+// Bring the cells visible in a w x h preview into the atlas (rasterizing
+// the missing ones now) and queue the next page. Returns false with
+// frame.hint set while the table is loading or unreadable.
+static bool PrepareGlyphs(int fontIdx, int faceIdx, int w, int h, GlyphFrame &frame)
+{
+	FP_TRACE_SCOPE("GlyphPrepare");
+	uint64_t key = GlyphTableKey(fontIdx, faceIdx);
+	if (g_glyphTable.key != key)
+	{
+		RequestGlyphTable(fontIdx, faceIdx, key);
+		frame.hint = L"cmap を読み込み中...";
 		return false;
-	if (FAILED(g_d2dDevice->CreateDeviceContext(D2D1_DEVICE_CONTEXT_OPTIONS_NONE, &g_d2dContext)))
+	}
+	if (g_glyphTable.failed || g_glyphTable.index.Count() == 0)
+	{
+		frame.hint = L"このフォントの cmap を読み取れません";
 		return false;
-	if (logger)
-		logger->info(logger, L"Preview: D3D11/D2D initialized");
+	}
+	frame.width = (std::max)(kGlyphCellDips, (FLOAT)w - 20.0f);
+	frame.bottom = (FLOAT)h - 10.0f;
+	float viewHeight = (std::max)(0.0f, (FLOAT)h - 20.0f - kGlyphHeaderDips);
+	g_glyphLayout = GlyphGrid::MakeLayout(g_glyphTable.index.Count(), frame.width, kGlyphCellDips);
+	g_specimenScroll = GlyphGrid::ClampScroll(g_glyphLayout, g_specimenScroll, viewHeight);
+	bool down = g_specimenScroll >= g_glyphLastScroll;
+	g_glyphLastScroll = g_specimenScroll;
+	GlyphGrid::VisibleCells(g_glyphLayout, g_specimenScroll, viewHeight, frame.first, frame.last);
+	uint64_t atlasKey = FontHash::Hash64(&g_previewBgColor, sizeof(g_previewBgColor), key);
+	if (!EnsureGlyphAtlas(frame.last - frame.first, atlasKey))
+	{
+		frame.hint = L"グリフ一覧を表示できません";
+		return false;
+	}
+
+	// Cells already in the atlas are restamped first so filling the missing
+	// ones cannot evict them.
+	uint64_t stamp = ++g_glyphFrameStamp;
+	uint32_t count = frame.last - frame.first;
+	g_glyphVisible.codepoints.resize(count);
+	g_glyphCellSlots.assign(count, -1);
+	g_glyphMissing.clear();
+	g_glyphMissingPage.codepoints.clear();
+	for (uint32_t n = 0; n < count; n++)
+	{
+		uint32_t cp = g_glyphTable.index.CodepointAt(frame.first + n);
+		g_glyphVisible.codepoints[n] = cp;
+		g_glyphCellSlots[n] = g_glyphAtlas.slots.Find(cp, stamp);
+		if (g_glyphCellSlots[n] < 0)
+		{
+			g_glyphMissing.push_back(n);
+			g_glyphMissingPage.codepoints.push_back(cp);
+		}
+	}
+	if (!g_glyphMissing.empty())
+	{
+		ResolveGlyphPage(g_glyphTable.face.Get(), g_glyphMissingPage);
+		std::vector<int> slots(g_glyphMissing.size(), -1);
+		g_glyphStats.cellsRasterized += RasterizeGlyphCells(g_glyphMissingPage, 0, g_glyphMissing.size(), stamp, stamp, slots.data());
+		for (size_t m = 0; m < g_glyphMissing.size(); m++)
+			g_glyphCellSlots[g_glyphMissing[m]] = slots[m];
+	}
+	PrefetchGlyphPage(frame.first, frame.last, down);
+
+	int block = GlyphGrid::FindBlockEntry(g_glyphTable.blocks, frame.first);
+	if (block != g_glyphBlockShown && g_hwndGlyphBlock)
+	{
+		SendMessageW(g_hwndGlyphBlock, CB_SETCURSEL, (WPARAM)block, 0);
+		g_glyphBlockShown = block;
+	}
+	frame.ready = true;
+	FP_LOG_VERBOSE_RATE(logger, kCatRender, kPerFrameLogIntervalMs, L"Glyphs: cells=%u..%u of %u missing=%u atlas=%u/%d",
+						frame.first, frame.last, g_glyphLayout.count, (UINT)g_glyphMissing.size(), (UINT)g_glyphAtlas.slots.Used(),
+						g_glyphAtlas.slots.Capacity());
 	return true;
 }
 
-void ReleasePreviewTarget()
+static void DrawGlyphHeader(const GlyphFrame &frame, IDWriteTextFormat *format, ID2D1SolidColorBrush *brush)
 {
-	if (g_d2dContext)
+	uint32_t selected = (std::min)(g_glyphSelected, g_glyphLayout.count - 1);
+	uint32_t cp = g_glyphTable.index.CodepointAt(selected);
+	wchar_t ch[3] = {};
+	if (cp >= 0x10000)
 	{
-		g_d2dContext->SetTarget(nullptr);
+		ch[0] = (wchar_t)(0xD800 + ((cp - 0x10000) >> 10));
+		ch[1] = (wchar_t)(0xDC00 + ((cp - 0x10000) & 0x3FF));
 	}
-	g_d2dTarget.Reset();
+	else
+	{
+		ch[0] = (wchar_t)cp;
+	}
+	int block = GlyphGrid::FindBlock(cp);
+	wchar_t text[192];
+	int len = swprintf_s(text, L"U+%04X  %ls  %ls    %u / %u", cp, ch, block >= 0 ? GlyphGrid::kBlocks[block].name : L"Other", selected + 1,
+						 g_glyphLayout.count);
+	ComPtr<IDWriteTextLayout> layout;
+	if (SUCCEEDED(g_dwriteFactory->CreateTextLayout(text, (UINT32)(std::max)(0, len), format, frame.width, kGlyphHeaderDips, &layout)))
+		g_d2dContext->DrawTextLayout(D2D1::Point2F(10.0f, 10.0f), layout.Get(), brush, D2D1_DRAW_TEXT_OPTIONS_NONE);
 }
 
-bool CreateOrResizeSwapChain(HWND hwnd, int width, int height)
+// Called between BeginDraw and EndDraw on the swap chain target.
+static void DrawGlyphs(const GlyphFrame &frame)
 {
-	if (!hwnd || width <= 0 || height <= 0)
-		return false;
-	if (logger)
+	g_glyphStats.frames++;
+	IDWriteTextFormat *format = SpecimenLabelFormat();
+	ID2D1SolidColorBrush *brush = SpecimenLabelBrush();
+	if (!format || !brush)
+		return;
+	if (!frame.ready)
 	{
-		wchar_t buf[160];
-		swprintf_s(buf, L"CreateOrResizeSwapChain: hwnd=%p size=%dx%d", hwnd, width, height);
-		logger->verbose(logger, buf);
+		const wchar_t *hint = frame.hint ? frame.hint : L"";
+		ComPtr<IDWriteTextLayout> layout;
+		if (SUCCEEDED(g_dwriteFactory->CreateTextLayout(hint, (UINT32)wcslen(hint), format, 4096.0f, kGlyphHeaderDips, &layout)))
+			g_d2dContext->DrawTextLayout(D2D1::Point2F(10.0f, 10.0f), layout.Get(), brush, D2D1_DRAW_TEXT_OPTIONS_NONE);
+		return;
 	}
-	if (!EnsurePreviewDevice())
+	DrawGlyphHeader(frame, format, brush);
+	float top = 10.0f + kGlyphHeaderDips;
+	g_d2dContext->PushAxisAlignedClip(D2D1::RectF(10.0f, top, 10.0f + frame.width, frame.bottom), D2D1_ANTIALIAS_MODE_ALIASED);
+	uint32_t columns = (uint32_t)g_glyphLayout.columns;
+	for (uint32_t i = frame.first; i < frame.last; i++)
 	{
-		if (logger)
-			logger->warn(logger, L"CreateOrResizeSwapChain: EnsurePreviewDevice failed");
-		return false;
+		float x = 10.0f + (float)(i % columns) * kGlyphCellDips;
+		float y = top + (float)(i / columns) * kGlyphCellDips - g_specimenScroll;
+		D2D1_RECT_F dest = D2D1::RectF(x, y, x + kGlyphCellDips, y + kGlyphCellDips);
+		int slot = g_glyphCellSlots[i - frame.first];
+		if (slot >= 0)
+		{
+			D2D1_RECT_F source = GlyphAtlasRect(slot);
+			g_d2dContext->DrawBitmap(g_glyphAtlas.bitmap.Get(), &dest, 1.0f, D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR, &source);
+			g_glyphStats.cellsDrawn++;
+		}
+		if (i == g_glyphSelected)
+			g_d2dContext->DrawRectangle(D2D1::RectF(x + 1.0f, y + 1.0f, x + kGlyphCellDips - 1.0f, y + kGlyphCellDips - 1.0f), brush, 2.0f);
 	}
-	ReleasePreviewTarget();
-	ComPtr<IDXGIDevice> dxgiDevice;
-	if (FAILED(g_d3dDevice.As(&dxgiDevice)))
+	g_d2dContext->PopAxisAlignedClip();
+}
+
+static void LogGlyphStats(const wchar_t *reason)
+{
+	if (!logger || g_glyphStats.frames == 0)
+		return;
+	const GlyphGrid::AtlasSlots::Stats &atlas = g_glyphAtlas.slots.GetStats();
+	wchar_t buf[320];
+	swprintf_s(buf, L"Glyphs[%ls]: codepoints=%u ranges=%u frames=%llu cellsDrawn=%llu rasterized=%llu prefetched=%llu pages=%llu atlas=%d cells %uKB hits=%llu fills=%llu evictions=%llu full=%llu tables=%llu",
+			   reason, g_glyphTable.index.Count(), (UINT)g_glyphTable.index.Ranges().size(), (unsigned long long)g_glyphStats.frames,
+			   (unsigned long long)g_glyphStats.cellsDrawn, (unsigned long long)g_glyphStats.cellsRasterized, (unsigned long long)g_glyphStats.cellsPrefetched,
+			   (unsigned long long)g_glyphStats.pagesPrefetched, g_glyphAtlas.slots.Capacity(), (UINT)((size_t)g_glyphAtlas.width * g_glyphAtlas.height * 4 / 1024),
+			   (unsigned long long)atlas.hits, (unsigned long long)atlas.fills, (unsigned long long)atlas.evictions, (unsigned long long)atlas.full,
+			   (unsigned long long)g_glyphStats.tablesLoaded);
+	logger->info(logger, buf);
+}
+
+static size_t GlyphAtlasBytes()
+{
+	return (size_t)g_glyphAtlas.width * g_glyphAtlas.height * 4;
+}
+
+// Only the atlas is trimmed (the table is a few KB of ranges); it is
+// recreated empty on the next glyph frame.
+static void RegisterGlyphMemory()
+{
+	g_memoryBudget.Register(
+		"GlyphAtlas", MemoryBudget::Priority::Low,
+		[]
+		{ return GlyphAtlasBytes() + g_glyphTable.index.Bytes() + g_glyphTable.blocks.capacity() * sizeof(GlyphGrid::BlockEntry); },
+		[](size_t)
+		{
+			size_t freed = GlyphAtlasBytes();
+			ResetGlyphAtlas();
+			return freed;
+		});
+}
+
+//---------------------------------------------------------------------
+//	Axis sweep animation
+//---------------------------------------------------------------------
+// Loops the slider axes of the selected font from their minimum to their
+// maximum and back (see AxisSweep.h). Workers build one text layout per
+// keyframe (instancing the font and shaping is the expensive part); the UI
+// thread rasterizes each into a bitmap as it arrives, since the D2D context
+// is not shared. Once every keyframe is in the ring, a timer plays them back
+// at kAxisSweepFps and each tick only draws a finished bitmap. Changing the
+// selection, text, size or background ends the sweep.
+constexpr UINT_PTR kAxisSweepTimerId = 2;
+constexpr double kAxisSweepFps = 30.0;
+constexpr int kAxisSweepMaxFrames = 60;
+constexpr size_t kAxisSweepFrameBudgetBytes = 24u * 1024u * 1024u;
+// Keyframes rasterized per WM_AXIS_SWEEP_FRAME, so input stays responsive.
+constexpr int kAxisSweepRasterPerMessage = 4;
+
+struct AxisSweepState
+{
+	bool running = false; // precomputing or playing
+	bool playing = false;
+	uint32_t generation = 0; // g_axisSweepFrames generation
+	int frameCount = 0;
+	int shownFrame = 0;
+	// What the frames were rendered for; anything else stops the sweep.
+	UINT catalog = 0;
+	int fontIndex = -1;
+	int faceIndex = -1;
+	UINT width = 0;
+	UINT height = 0;
+	COLORREF bgColor = 0;
+	uint64_t textHash = 0;
+	double precomputeStartMs = 0.0;
+	double precomputeMs = 0.0;
+	AxisSweep::Pacer pacer;
+};
+
+static AxisSweepState g_axisSweep;
+static AxisSweep::FrameRing<ComPtr<ID2D1Bitmap1>> g_axisSweepFrames;
+// Layouts finished by workers, waiting for the UI thread to rasterize them.
+struct AxisSweepLayout
+{
+	uint32_t generation = 0;
+	int frame = 0;
+	ComPtr<IDWriteTextLayout> layout;
+};
+static std::mutex g_axisSweepMutex;
+static std::vector<AxisSweepLayout> g_axisSweepLayouts;
+
+static double NowMs()
+{
+	static LARGE_INTEGER freq{};
+	if (freq.QuadPart == 0)
+		QueryPerformanceFrequency(&freq);
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return (double)now.QuadPart * 1000.0 / (double)freq.QuadPart;
+}
+
+static void LogAxisSweep(const wchar_t *reason)
+{
+	if (!logger || g_axisSweep.frameCount == 0)
+		return;
+	AxisSweep::Pacer::Stats st = g_axisSweep.pacer.GetStats();
+	double precomputeRate = g_axisSweep.precomputeMs > 0.0 ? g_axisSweep.frameCount * 1000.0 / g_axisSweep.precomputeMs : 0.0;
+	wchar_t buf[320];
+	swprintf_s(buf, L"AxisSweep[%ls]: frames=%d size=%ux%u fps=%.0f presented=%llu dropped=%llu pauses=%llu interval=%.2fms jitter p50=%.2fms p95=%.2fms max=%.2fms precompute=%.1fms (%.1f frames/s) resident=%uKB",
+			   reason, g_axisSweep.frameCount, g_axisSweep.width, g_axisSweep.height, kAxisSweepFps, (unsigned long long)st.presented,
+			   (unsigned long long)st.dropped, (unsigned long long)st.pauses, st.meanIntervalMs, st.p50JitterMs, st.p95JitterMs, st.maxJitterMs,
+			   g_axisSweep.precomputeMs, precomputeRate, (UINT)(g_axisSweepFrames.Bytes() / 1024));
+	logger->info(logger, buf);
+}
+
+// Returns the bytes released. Safe from the memory budget's trim callback.
+static size_t StopAxisSweep(const wchar_t *reason)
+{
+	if (!g_axisSweep.running)
+		return 0;
+	g_backgroundTasks.Cancel(kTaskTagAxisSweep);
+	if (g_hwndMain)
+		KillTimer(g_hwndMain, kAxisSweepTimerId);
+	LogAxisSweep(reason);
+	size_t freed = g_axisSweepFrames.Bytes();
+	g_axisSweep.generation = g_axisSweepFrames.Reset(0);
 	{
-		if (logger)
-			logger->warn(logger, L"CreateOrResizeSwapChain: As IDXGIDevice failed");
-		return false;
+		std::lock_guard<std::mutex> lock(g_axisSweepMutex);
+		g_axisSweepLayouts.clear();
 	}
-	ComPtr<IDXGIAdapter> adapter;
-	if (FAILED(dxgiDevice->GetAdapter(&adapter)))
-	{
-		if (logger)
-			logger->warn(logger, L"CreateOrResizeSwapChain: GetAdapter failed");
+	g_axisSweep.running = false;
+	g_axisSweep.playing = false;
+	g_axisSweep.frameCount = 0;
+	if (!g_inRenderPreview)
+		MarkDirty(DirtyState::Action::AxisSweep, DirtyState::Preview);
+	return freed;
+}
+
+static bool AxisSweepMatches(int fontIdx, int faceIdx, const std::wstring &sample, UINT width, UINT height)
+{
+	return g_axisSweep.catalog == g_catalogGeneration && g_axisSweep.fontIndex == fontIdx && g_axisSweep.faceIndex == faceIdx &&
+		   g_axisSweep.width == width && g_axisSweep.height == height && g_axisSweep.bgColor == g_previewBgColor &&
+		   g_axisSweep.textHash == PreviewCache::HashText(sample);
+}
+
+// Queue one layout per keyframe for the selection's slider axes. Needs a
+// rendered preview first: the layout parameters come from the last frame.
+static bool StartAxisSweep()
+{
+	StopAxisSweep(L"restart");
+	int fontIdx = g_selectedFontIndex;
+	if (g_specimenMode != Specimen::Mode::Single || g_axisSliders.count == 0 || g_axisSliders.fontIndex != fontIdx || g_axisSliders.faceIndex != g_selectedFaceIndex ||
+		g_previewBitmapWidth == 0 || g_previewBitmapHeight == 0 || !g_d2dContext)
 		return false;
-	}
-	ComPtr<IDXGIFactory2> factory;
-	if (FAILED(adapter->GetParent(__uuidof(IDXGIFactory2), &factory)))
+	UINT width = g_previewBitmapWidth;
+	UINT height = g_previewBitmapHeight;
+	int frameCount = AxisSweep::FrameCountFor((size_t)width * height * 4, kAxisSweepFrameBudgetBytes, kAxisSweepMaxFrames);
+	PreviewLayoutJob base;
+	if (frameCount == 0 || !MakePreviewLayoutJob(fontIdx, g_selectedFaceIndex, base))
 	{
-		if (logger)
-			logger->warn(logger, L"CreateOrResizeSwapChain: GetParent IDXGIFactory2 failed");
+		FP_LOG(logger, Warn, kCatRender, L"AxisSweep: preview %ux%u too large for %uMB of frames", width, height,
+			   (UINT)(kAxisSweepFrameBudgetBytes / (1024 * 1024)));
 		return false;
 	}
+	g_axisSweep.catalog = g_catalogGeneration;
+	g_axisSweep.fontIndex = fontIdx;
+	g_axisSweep.faceIndex = g_selectedFaceIndex;
+	g_axisSweep.width = width;
+	g_axisSweep.height = height;
+	g_axisSweep.bgColor = g_previewBgColor;
+	g_axisSweep.textHash = PreviewCache::HashText(base.text);
+	g_axisSweep.frameCount = frameCount;
+	g_axisSweep.shownFrame = 0;
+	g_axisSweep.precomputeMs = 0.0;
+	g_axisSweep.precomputeStartMs = NowMs();
+	g_axisSweep.generation = g_axisSweepFrames.Reset(frameCount);
+	g_axisSweep.running = true;
+	g_axisSweep.playing = false;
 
-	if (!g_swapChain)
+	base.hasFace = true;
+	base.face.axisValues = g_axisSliders.values;
+	// One size for every frame, fitted at the sliders' position.
+	if (base.autoFit)
+		ApplyAutoFit(base, nullptr);
+	HWND hwnd = g_hwndMain;
+	const FontItem &item = g_fontList[fontIdx];
+	for (int k = 0; k < frameCount; k++)
 	{
-		DXGI_SWAP_CHAIN_DESC1 desc{};
-		desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-		desc.Width = width;
-		desc.Height = height;
-		desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-		desc.SampleDesc.Count = 1;
-		desc.BufferCount = 2;
-		desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
-		desc.AlphaMode = DXGI_ALPHA_MODE_IGNORE;
-		HRESULT hr = factory->CreateSwapChainForHwnd(g_d3dDevice.Get(), hwnd, &desc, nullptr, nullptr, &g_swapChain);
-		if (FAILED(hr))
-		{
-			if (logger)
+		PreviewLayoutJob job = base;
+		for (int i = 0; i < g_axisSliders.count; i++)
+			job.face.axisValues[i].value = AxisSweep::KeyframeValue(item.axisRanges[i].second.first, item.axisRanges[i].second.second, k, frameCount);
+		uint32_t generation = g_axisSweep.generation;
+		g_backgroundTasks.Post(TaskQueue::Priority::Normal, kTaskTagAxisSweep, [job, k, generation, hwnd]
+							   {
+			FP_TRACE_SCOPE("AxisSweepFrame");
+			ComPtr<IDWriteTextLayout> layout;
+			if (FAILED(BuildPreviewLayout(job, layout, nullptr)))
+				layout.Reset();
 			{
-				wchar_t buf[160];
-				swprintf_s(buf, L"CreateSwapChainForHwnd failed 0x%08x", hr);
-				logger->warn(logger, buf);
+				std::lock_guard<std::mutex> lock(g_axisSweepMutex);
+				g_axisSweepLayouts.push_back(AxisSweepLayout{generation, k, std::move(layout)});
 			}
-			return false;
-		}
-		factory->MakeWindowAssociation(hwnd, DXGI_MWA_NO_ALT_ENTER);
+			if (hwnd)
+				PostMessageW(hwnd, WM_AXIS_SWEEP_FRAME, 0, 0); });
 	}
-	else
+	FP_LOG(logger, Info, kCatRender, L"AxisSweep: precomputing %d frames of %ux%u for %ls (%d axes)", frameCount, width, height,
+		   item.familyName.c_str(), g_axisSliders.count);
+	return true;
+}
+
+// WM_AXIS_SWEEP_FRAME: rasterize finished layouts into the ring and start
+// playback once it is complete. A failed layout stops the sweep.
+static void HandleAxisSweepFrames()
+{
+	if (!g_axisSweep.running || g_axisSweep.playing)
+		return;
+	for (int n = 0; n < kAxisSweepRasterPerMessage; n++)
 	{
-		HRESULT hr = g_swapChain->ResizeBuffers(0, width, height, DXGI_FORMAT_UNKNOWN, 0);
-		if (FAILED(hr))
+		AxisSweepLayout next;
 		{
-			if (logger)
-			{
-				wchar_t buf[160];
-				swprintf_s(buf, L"ResizeBuffers failed 0x%08x", hr);
-				logger->warn(logger, buf);
-			}
-			// Drop the swapchain to force recreate next time; stale target may hold references
-			g_swapChain.Reset();
-			return false;
+			std::lock_guard<std::mutex> lock(g_axisSweepMutex);
+			if (g_axisSweepLayouts.empty())
+				break;
+			next = std::move(g_axisSweepLayouts.back());
+			g_axisSweepLayouts.pop_back();
 		}
-	}
-
-	ComPtr<IDXGISurface> surface;
-	HRESULT hr = g_swapChain->GetBuffer(0, __uuidof(IDXGISurface), &surface);
-	if (FAILED(hr))
-	{
-		if (logger)
+		if (next.generation != g_axisSweep.generation)
+			continue;
+		ComPtr<ID2D1Bitmap1> bitmap;
+		if (next.layout)
+			bitmap = RenderOffscreen(g_axisSweep.width, g_axisSweep.height, [&]
+									 { return DrawPreviewLayout(next.layout.Get()); });
+		if (!bitmap)
 		{
-			wchar_t buf[160];
-			swprintf_s(buf, L"GetBuffer failed 0x%08x", hr);
-			logger->warn(logger, buf);
+			StopAxisSweep(L"frame failed");
+			return;
 		}
-		return false;
+		if (g_axisSweepFrames.Store(next.generation, next.frame, std::move(bitmap), (size_t)g_axisSweep.width * g_axisSweep.height * 4))
+			break;
 	}
-	D2D1_BITMAP_PROPERTIES1 props = D2D1::BitmapProperties1(
-		D2D1_BITMAP_OPTIONS_TARGET | D2D1_BITMAP_OPTIONS_CANNOT_DRAW,
-		D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_IGNORE),
-		96.0f, 96.0f);
-	hr = g_d2dContext->CreateBitmapFromDxgiSurface(surface.Get(), &props, &g_d2dTarget);
-	if (FAILED(hr))
+	if (!g_axisSweepFrames.Complete())
+		return;
+	double now = NowMs();
+	g_axisSweep.precomputeMs = now - g_axisSweep.precomputeStartMs;
+	g_axisSweep.playing = true;
+	g_axisSweep.pacer.Start(kAxisSweepFps, g_axisSweep.frameCount, now);
+	if (g_hwndMain)
+		SetTimer(g_hwndMain, kAxisSweepTimerId, (UINT)(g_axisSweep.pacer.PeriodMs() / 2), nullptr);
+	LogAxisSweep(L"ready");
+	g_memoryBudget.Enforce();
+}
+
+// Timer ticks run at twice the frame rate; the pacer decides which ticks
+// present. Nothing is drawn while the window cannot be seen.
+static void HandleAxisSweepTimer()
+{
+	if (!g_axisSweep.playing)
+		return;
+	if (g_visibility.Current() != Visibility::State::Visible)
 	{
-		if (logger)
-		{
-			wchar_t buf[160];
-			swprintf_s(buf, L"CreateBitmapFromDxgiSurface failed 0x%08x", hr);
-			logger->warn(logger, buf);
-		}
-		return false;
+		g_axisSweep.pacer.Pause();
+		return;
 	}
-	g_d2dContext->SetTarget(g_d2dTarget.Get());
-	if (logger)
-		logger->verbose(logger, L"CreateOrResizeSwapChain: target set successfully");
-	return true;
+	int frame = g_axisSweep.pacer.Tick(NowMs());
+	if (frame < 0)
+		return;
+	g_axisSweep.shownFrame = frame;
+	RenderPreview(L"AxisSweep");
 }
 
-// Render the GPU-backed preview area into the preview HWND's swapchain.
-// This function creates/resizes the swap chain as needed, clears with
-// `g_previewBgColor`, draws sample text using DirectWrite/Direct2D,
-// and presents the buffer. It guards against re-entrant calls.
+static void RegisterAxisSweepMemory()
+{
+	g_memoryBudget.Register(
+		"AxisSweep", MemoryBudget::Priority::Normal,
+		[]
+		{ return g_axisSweepFrames.Bytes(); },
+		[](size_t)
+		{ return StopAxisSweep(L"memory budget"); });
+}
+
+static void ResumeWarmStart();
+
 void RenderPreview(const wchar_t *reason)
 {
+	FP_TRACE_SCOPE("RenderPreview");
 	if (g_inRenderPreview)
 		return;
 	g_inRenderPreview = true;
@@ -877,17 +5296,20 @@ void RenderPreview(const wchar_t *reason)
 			logger->warn(logger, L"RenderPreview: no preview hwnd");
 		return;
 	}
+	if (g_visibility.NeedsProbe())
+		ProbeOcclusion();
+	if (!g_visibility.BeginFrame())
+	{
+		FP_LOG_VERBOSE_RATE(logger, kCatRender, kPerFrameLogIntervalMs, L"RenderPreview skipped[%ls]: %hs", reason ? reason : L"",
+							Visibility::StateName(g_visibility.Current()));
+		return;
+	}
 	SyncSampleTextFromEdit();
 	RECT rc{};
 	GetClientRect(g_hwndPreview, &rc);
 	int w = rc.right - rc.left;
 	int h = rc.bottom - rc.top;
-	if (logger)
-	{
-		wchar_t buf[160];
-		swprintf_s(buf, L"RenderPreview start[%ls]: size=%dx%d selected=%d", reason ? reason : L"", w, h, g_selectedFontIndex);
-		logger->verbose(logger, buf);
-	}
+	FP_LOG_VERBOSE_RATE(logger, kCatRender, kPerFrameLogIntervalMs, L"RenderPreview start[%ls]: size=%dx%d selected=%d", reason ? reason : L"", w, h, g_selectedFontIndex);
 	if (w <= 0 || h <= 0)
 		return;
 	if (!CreateOrResizeSwapChain(g_hwndPreview, w, h))
@@ -906,73 +5328,99 @@ void RenderPreview(const wchar_t *reason)
 	float bgR = GetRValue(g_previewBgColor) / 255.0f;
 	float bgG = GetGValue(g_previewBgColor) / 255.0f;
 	float bgB = GetBValue(g_previewBgColor) / 255.0f;
-	if (logger)
+	FP_LOG_VERBOSE_RATE(logger, kCatRender, kPerFrameLogIntervalMs, L"RenderPreview bg color=%06x", (unsigned)(g_previewBgColor & 0xFFFFFF));
+	static const std::wstring kFallbackSample = L"あいうABC123";
+	const std::wstring &sample = g_sampleText.empty() ? kFallbackSample : g_sampleText;
+	if (g_sampleText.empty() && logger)
+		logger->warn(logger, L"RenderPreview: sample text empty, using fallback");
+	SyncPreviewLayoutParams(sample, (FLOAT)w - 20.0f, (FLOAT)h - 20.0f);
+
+	int fontIdx = g_selectedFontIndex;
+	bool validFont = fontIdx >= 0 && fontIdx < (int)g_fontList.size();
+	ComPtr<ID2D1Bitmap1> previewBitmap;
+	bool bitmapHit = false;
+	bool sweepFrame = false;
+	g_lastPreviewBitmapHit = false;
+	if (g_axisSweep.running && !AxisSweepMatches(fontIdx, g_selectedFaceIndex, sample, (UINT)w, (UINT)h))
+		StopAxisSweep(L"preview changed");
+	SpecimenFrame specimen;
+	bool specimenFrame = false;
+	bool compareMode = g_specimenMode == Specimen::Mode::Compare;
+	int compareRows = 0;
+	bool glyphMode = validFont && g_specimenMode == Specimen::Mode::Glyphs;
+	GlyphFrame glyphs;
+	if (g_axisSweep.playing)
+	{
+		previewBitmap = g_axisSweepFrames.Frame(g_axisSweep.shownFrame);
+		bitmapHit = sweepFrame = true;
+	}
+	else if (compareMode)
+	{
+		// Enforce first: the rows drawn below are owned by the slots, so a
+		// trim must not land between preparing and drawing them.
+		g_memoryBudget.Enforce();
+		compareRows = PrepareCompare(sample, w, h);
+	}
+	else if (glyphMode)
+	{
+		// As above: a trim drops the atlas the frame is about to draw from.
+		g_memoryBudget.Enforce();
+		PrepareGlyphs(fontIdx, g_selectedFaceIndex, w, h, glyphs);
+	}
+	else if (validFont && g_specimenMode != Specimen::Mode::Single)
+	{
+		specimenFrame = PrepareSpecimen(fontIdx, g_selectedFaceIndex, sample, w, h, specimen);
+		g_memoryBudget.Enforce();
+	}
+	else if (validFont)
 	{
-		wchar_t buf[160];
-		swprintf_s(buf, L"RenderPreview bg color=%06x", g_previewBgColor & 0xFFFFFF);
-		logger->verbose(logger, buf);
+		FP_TRACE_SCOPE("PreviewBitmap");
+		previewBitmap = AcquirePreviewBitmap(fontIdx, g_selectedFaceIndex, sample, (UINT)w, (UINT)h, bitmapHit);
+		g_lastPreviewBitmapHit = bitmapHit && previewBitmap;
+		if (!bitmapHit)
+			g_memoryBudget.Enforce();
 	}
+
 	g_d2dContext->BeginDraw();
 	g_d2dContext->Clear(D2D1::ColorF(bgR, bgG, bgB, 1.0f));
-
-	std::wstring sample = g_sampleText;
-	if (sample.empty())
+	if (compareMode)
 	{
-		sample = L"あいうABC123";
-		if (logger)
-			logger->warn(logger, L"RenderPreview: sample text empty, using fallback");
+		DrawCompare(compareRows);
 	}
-
-	int fontIdx = g_selectedFontIndex;
-	if (fontIdx >= 0 && fontIdx < (int)g_fontList.size())
-	{
-		const auto &item = g_fontList[fontIdx];
-		std::wstring family = ExtractFamilyName(item);
-		ComPtr<IDWriteFontCollection1> externalCollection;
-		IDWriteFontCollection *collectionForCreate = nullptr;
-		if (!item.isSystemFont)
-		{
-			HRESULT colHr = GetOrCreateExternalFontCollection(item.filePath, &externalCollection);
-			if (SUCCEEDED(colHr) && externalCollection)
-				collectionForCreate = externalCollection.Get();
-			else if (logger)
-				logger->warn(logger, L"RenderPreview: external font collection create failed; falling back to system collection");
-		}
-		ComPtr<IDWriteTextFormat> format;
-		HRESULT hrPrimary = g_dwriteFactory->CreateTextFormat(family.c_str(), collectionForCreate, DWRITE_FONT_WEIGHT_NORMAL, DWRITE_FONT_STYLE_NORMAL, DWRITE_FONT_STRETCH_NORMAL, 48.0f, L"ja-jp", &format);
-		HRESULT hrFallback = hrPrimary;
-		if (FAILED(hrPrimary))
-		{
-			hrFallback = g_dwriteFactory->CreateTextFormat(L"Segoe UI", nullptr, DWRITE_FONT_WEIGHT_NORMAL, DWRITE_FONT_STYLE_NORMAL, DWRITE_FONT_STRETCH_NORMAL, 48.0f, L"ja-jp", &format);
-			if (logger)
-			{
-				wchar_t buf[200];
-				swprintf_s(buf, L"RenderPreview: primary format failed 0x%08x, fallback hr=0x%08x", hrPrimary, hrFallback);
-				logger->warn(logger, buf);
-			}
-		}
-		HRESULT hr = FAILED(hrPrimary) ? hrFallback : hrPrimary;
-		if (SUCCEEDED(hr))
-		{
-			ComPtr<ID2D1SolidColorBrush> textBrush;
-			if (SUCCEEDED(g_d2dContext->CreateSolidColorBrush(D2D1::ColorF(0, 0, 0, 1), &textBrush)))
-			{
-				D2D1_RECT_F layout = D2D1::RectF(10.0f, 10.0f, (FLOAT)w - 10.0f, (FLOAT)h - 10.0f);
-				g_d2dContext->DrawTextW(sample.c_str(), (UINT32)sample.size(), format.Get(), layout, textBrush.Get(), D2D1_DRAW_TEXT_OPTIONS_NONE, DWRITE_MEASURING_MODE_NATURAL);
-				if (logger)
-				{
-					wchar_t buf[200];
-					swprintf_s(buf, L"RenderPreview: drew text len=%u family=%ls", (unsigned)sample.size(), family.c_str());
-					logger->verbose(logger, buf);
-				}
-			}
-		}
+	else if (glyphMode)
+	{
+		DrawGlyphs(glyphs);
 	}
-	else
+	else if (specimenFrame)
+	{
+		DrawSpecimen(specimen);
+	}
+	else if (previewBitmap)
+	{
+		D2D1_RECT_F dest = D2D1::RectF(0.0f, 0.0f, (FLOAT)w, (FLOAT)h);
+		g_d2dContext->DrawBitmap(previewBitmap.Get(), &dest, 1.0f, D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR);
+		FP_LOG_VERBOSE_RATE(logger, kCatRender, kPerFrameLogIntervalMs, L"RenderPreview: bitmap %ls", bitmapHit ? L"cache hit" : L"rendered");
+	}
+	else if (validFont && g_specimenMode == Specimen::Mode::Single)
+	{
+		// Offscreen bitmap unavailable; draw directly.
+		DrawPreviewText(fontIdx, g_selectedFaceIndex, sample);
+	}
+	else if (!validFont)
 	{
 		if (logger)
 			logger->warn(logger, L"RenderPreview: no valid font index to draw");
 	}
+	if (validFont && !sweepFrame && ++g_previewRenderCount % 32 == 0)
+	{
+		LogPreviewPrefetchStats(L"periodic");
+		LogPreviewBitmapStats(L"periodic");
+		LogMemoryBudget(L"periodic");
+		LogSpecimenStats(L"periodic");
+		LogCompareStats(L"periodic");
+		LogGlyphStats(L"periodic");
+		LogAutoFitStats(L"periodic");
+	}
 
 	HRESULT endHr = g_d2dContext->EndDraw();
 	if (FAILED(endHr) && logger)
@@ -982,19 +5430,29 @@ void RenderPreview(const wchar_t *reason)
 		logger->warn(logger, buf);
 	}
 	DXGI_PRESENT_PARAMETERS params{};
-	HRESULT presentHr = g_swapChain->Present1(1, 0, &params);
+	HRESULT presentHr;
+	{
+		FP_TRACE_SCOPE("Present");
+		presentHr = g_swapChain->Present1(1, 0, &params);
+	}
 	if (FAILED(presentHr) && logger)
 	{
 		wchar_t buf[128];
 		swprintf_s(buf, L"RenderPreview: Present1 failed 0x%08x", presentHr);
 		logger->warn(logger, buf);
 	}
+	else if (SUCCEEDED(presentHr))
+	{
+		ApplyVisibility(g_visibility.SetOccluded(presentHr == DXGI_STATUS_OCCLUDED), L"present");
+	}
+	ResumeWarmStart();
 }
 
 void UpdateDetailPanel()
 {
 	if (!g_hwndNameLabel || !g_hwndTypeLabel || !g_hwndAxisLabel)
 		return;
+	SyncAxisSliders();
 	if (g_selectedFontIndex < 0 || g_selectedFontIndex >= (int)g_fontList.size())
 	{
 		SetWindowTextW(g_hwndNameLabel, L"フォント未選択");
@@ -1002,132 +5460,49 @@ void UpdateDetailPanel()
 		SetWindowTextW(g_hwndAxisLabel, L"");
 		return;
 	}
+	// Stack buffers and precomputed strings only: this runs on every
+	// selection change. FontPreviewBench's replay formats through the same
+	// FormatDetail under its allocation budget.
 	const auto &item = g_fontList[g_selectedFontIndex];
-	SetWindowTextW(g_hwndNameLabel, item.displayName.c_str());
-	SetWindowTextW(g_hwndTypeLabel, item.isSystemFont ? L"システムフォント" : L"外部フォント");
-	std::wstring axis = BuildAxisTooltip(item);
-	SetWindowTextW(g_hwndAxisLabel, axis.c_str());
+	int faceCount = GetFamilyFaceCount(g_selectedFontIndex);
+	FontPreviewCore::DetailText text;
+	if (!WithFamilyFace(g_selectedFontIndex, g_selectedFaceIndex, [&](const FontFaceEntry &face)
+						{ FontPreviewCore::FormatDetail(item, face.faceName.c_str(), faceCount, text); }))
+		FontPreviewCore::FormatDetail(item, nullptr, faceCount, text);
+	SetWindowTextW(g_hwndNameLabel, text.name);
+	SetWindowTextW(g_hwndTypeLabel, text.type);
+	if (!item.axesResolved)
+		RequestFontAxes(g_selectedFontIndex, TaskQueue::Priority::High);
+	SetWindowTextW(g_hwndAxisLabel, text.axes);
 }
 
 //---------------------------------------------------------------------
 //	Alias generation (VF.object baseline)
 //---------------------------------------------------------------------
-std::string BuildVFAliasFromSelection(const FontItem &item, const std::wstring &text, int frameLength)
-{
-	if (frameLength <= 0)
-		frameLength = kFallbackAliasFrames;
-	std::wstring fontValue = item.isSystemFont ? item.displayName : item.filePath;
-	std::ostringstream alias;
-	alias << "[Object]\n";
-	alias << "frame=0," << frameLength << "\n";
-	alias << "[Object.0]\n";
-	alias << "effect.name=Variable Font Text\n";
-	alias << "フォントファイル=" << (item.isSystemFont ? "" : ToUtf8(fontValue)) << "\n";
-	alias << "フォント=" << (item.isSystemFont ? ToUtf8(fontValue) : "") << "\n";
-	alias << "サイズ=80.0\n";
-	alias << "文字色=ffffff\n";
-	alias << "B=0\n";
-	alias << "I=0\n";
-	alias << "字間=0.0\n";
-	alias << "影設定.hide=1\n";
-	alias << "影を表示=0\n";
-	alias << "影色=000000\n";
-	alias << "影X=0.0\n";
-	alias << "影Y=0.0\n";
-	alias << "影濃度=100\n";
-	alias << "影ぼかし=0.0\n";
-	alias << "縁取り設定.hide=1\n";
-	alias << "縁取りを表示=0\n";
-	alias << "縁取り色=000000\n";
-	alias << "縁取り幅=5.0\n";
-	alias << "縁取りスタイル=丸\n";
-	alias << "切り抜き=0\n";
-	alias << "Weight=400\n";
-	alias << "Width=100\n";
-	alias << "Slant=0.0\n";
-	alias << "Optical Size=12.0\n";
-	alias << "Italic Axis=0.0\n";
-	alias << "Grade (GRAD)=0.0\n";
-	alias << "XTRA=0\n";
-	alias << "XOPQ=0\n";
-	alias << "YOPQ=0\n";
-	alias << "YTLC=0\n";
-	alias << "YTUC=0\n";
-	alias << "YTAS=0\n";
-	alias << "YTDE=0\n";
-	alias << "YTFI=0\n";
-	alias << "軸更新モード=リアルタイム\n";
-	alias << "横幅=0\n";
-	alias << "縦幅=0\n";
-	alias << "文字揃え=中央揃え[中]\n";
-	alias << "行間=0.0\n";
-	alias << "アニメーション.hide=1\n";
-	alias << "表示速度=0.0\n";
-	alias << "文字毎に個別オブジェクト=1\n";
-	alias << "テキスト=" << ToUtf8(text) << "\n";
-	alias << "[Object.1]\n";
-	alias << "effect.name=標準描画\n";
-	alias << "X=0.00\n";
-	alias << "Y=0.00\n";
-	alias << "Z=0.00\n";
-	alias << "Group=1\n";
-	alias << "中心X=0.00\n";
-	alias << "中心Y=0.00\n";
-	alias << "中心Z=0.00\n";
-	alias << "X軸回転=0.00\n";
-	alias << "Y軸回転=0.00\n";
-	alias << "Z軸回転=0.00\n";
-	alias << "拡大率=100.000\n";
-	alias << "縦横比=0.000\n";
-	alias << "透明度=0.00\n";
-	alias << "合成モード=通常\n";
-	return alias.str();
+std::string BuildVFAliasFromSelection(const FontItem &item, const std::wstring &text, int frameLength,
+									  const FontPreviewCore::AxisCoordinates *axes)
+{
+	FP_TRACE_SCOPE("AliasBuild");
+	return FontPreviewCore::BuildVFAliasForItem(item, text, frameLength, axes);
 }
 //---------------------------------------------------------------------
 //	Alias generation (Text.object baseline)
 //---------------------------------------------------------------------
 std::string BuildAliasFromSelection(const FontItem &item, const std::wstring &text, int frameLength)
 {
-	if (frameLength <= 0)
-		frameLength = kFallbackAliasFrames;
-	std::ostringstream alias;
-	alias << "[Object]\n";
-	alias << "frame=0," << frameLength << "\n";
-	alias << "[Object.0]\n";
-	alias << "effect.name=テキスト\n";
-	alias << "サイズ=80.0\n";
-	alias << "字間=0.00\n";
-	alias << "行間=0.00\n";
-	alias << "表示速度=0.00\n";
-	alias << "フォント=" << ToUtf8(item.displayName) << "\n";
-	alias << "文字色=ffffff\n";
-	alias << "影・縁色=000000\n";
-	alias << "文字装飾=標準文字\n";
-	alias << "文字揃え=中央揃え[中]\n";
-	alias << "B=0\n";
-	alias << "I=0\n";
-	alias << "テキスト=" << ToUtf8(text) << "\n";
-	alias << "文字毎に個別オブジェクト=0\n";
-	alias << "自動スクロール=0\n";
-	alias << "移動座標上に表示=0\n";
-	alias << "オブジェクトの長さを自動調節=0\n";
-	alias << "[Object.1]\n";
-	alias << "effect.name=標準描画\n";
-	alias << "X=0.00\n";
-	alias << "Y=0.00\n";
-	alias << "Z=0.00\n";
-	alias << "Group=1\n";
-	alias << "中心X=0.00\n";
-	alias << "中心Y=0.00\n";
-	alias << "中心Z=0.00\n";
-	alias << "X軸回転=0.00\n";
-	alias << "Y軸回転=0.00\n";
-	alias << "Z軸回転=0.00\n";
-	alias << "拡大率=100.000\n";
-	alias << "縦横比=0.000\n";
-	alias << "透明度=0.00\n";
-	alias << "合成モード=通常\n";
-	return alias.str();
+	FP_TRACE_SCOPE("AliasBuild");
+	return FontPreviewCore::BuildTextAliasForItem(item, text, frameLength);
+}
+
+// Objects reference fonts by file path, which a font inside a pack does
+// not have; those are preview-only until extracted.
+static bool HostCanUseFont(const FontItem &item)
+{
+	if (item.isSystemFont || !FontScan::IsArchiveMemberPath(item.filePath))
+		return true;
+	if (logger)
+		logger->warn(logger, L"zip 内のフォントはオブジェクトに設定できません。展開してから使用してください");
+	return false;
 }
 
 bool CreateVariableFontObject(UINT flags)
@@ -1145,6 +5520,8 @@ bool CreateVariableFontObject(UINT flags)
 		return false;
 	}
 	const auto &item = g_fontList[g_selectedFontIndex];
+	if (!HostCanUseFont(item))
+		return false;
 
 	int frameLength = kFallbackAliasFrames;
 	if (edit_handle->get_edit_info)
@@ -1154,20 +5531,19 @@ bool CreateVariableFontObject(UINT flags)
 		int computed = ComputeAliasLengthFramesFromEditInfo(info, kDefaultAliasSeconds);
 		if (computed > 0)
 			frameLength = computed;
-		if (logger)
-		{
-			wchar_t buf[192];
-			swprintf_s(buf, L"Alias length: seconds=%.3f rate=%d scale=%d => frames=%d", kDefaultAliasSeconds, info.rate, info.scale, frameLength);
-			logger->verbose(logger, buf);
-		}
+		FP_LOG_VERBOSE(logger, kCatEdit, L"Alias length: seconds=%.3f rate=%d scale=%d => frames=%d", kDefaultAliasSeconds, info.rate, info.scale, frameLength);
 	}
 
 	std::string alias;
 	switch (flags)
 	{
 	case IDC_ADD_VF_BUTTON:
-		alias = BuildVFAliasFromSelection(item, g_sampleText, frameLength);
+	{
+		FontPreviewCore::AxisCoordinates axes;
+		CollectAliasAxes(g_selectedFontIndex, axes);
+		alias = BuildVFAliasFromSelection(item, g_sampleText, frameLength, &axes);
 		break;
+	}
 	case IDC_ADD_BUTTON:
 		alias = BuildAliasFromSelection(item, g_sampleText, frameLength);
 		break;
@@ -1182,13 +5558,17 @@ bool CreateVariableFontObject(UINT flags)
 	};
 	CreateAliasParam param{alias, false};
 
-	bool called = edit_handle->call_edit_section_param(&param, [](void *p, EDIT_SECTION *edit)
-													   {
+	bool called;
+	{
+		FP_TRACE_SCOPE("EditSection.CreateObject");
+		called = edit_handle->call_edit_section_param(&param, [](void *p, EDIT_SECTION *edit)
+													  {
 		auto* ctx = static_cast<CreateAliasParam*>(p);
 		if (!ctx || !edit || !edit->create_object_from_alias) return;
 		int layer = edit->info ? edit->info->layer : 0;
 		int frame = edit->info ? edit->info->frame : 0;
 		ctx->created = edit->create_object_from_alias(ctx->aliasText.c_str(), layer, frame, 0) != nullptr; });
+	}
 
 	bool ok = called && param.created;
 	if (!ok)
@@ -1198,17 +5578,30 @@ bool CreateVariableFontObject(UINT flags)
 		if (logger)
 			logger->warn(logger, L"create_object_from_alias failed");
 	}
-	else if (logger)
+	else
 	{
-		logger->log(logger, L"Variable Font Text object created from FontPreview");
+		if (logger)
+			logger->log(logger, L"Variable Font Text object created from FontPreview");
+		TouchRecentFont(g_selectedFontIndex);
 	}
 	return ok;
 }
 
+// The selected font as objects store it, into `out` (whose strings keep
+// their capacity between calls).
+static void SelectedFontRef(const FontItem &item, BatchEdit::FontRef &out)
+{
+	out.name.clear();
+	out.file.clear();
+	FontPreviewCore::AppendUtf8(item.isSystemFont ? item.displayName : item.filePath, item.isSystemFont ? out.name : out.file);
+}
+
 // Update the selected object(s) in the host editor with the currently
 // selected font from the preview UI. This invokes `call_edit_section_param`
-// to run on the host's edit section thread and set effect item values.
-// Returns true if the host update succeeded.
+// to run on the host's edit section thread and set effect item values;
+// only the effects an object has are written, and only values that differ
+// (see BatchEdit.h). Returns true if every selected text object now uses
+// the font.
 bool SetFontTextObject()
 {
 	if (g_selectedFontIndex < 0 || g_selectedFontIndex >= (int)g_fontList.size())
@@ -1222,6 +5615,8 @@ bool SetFontTextObject()
 			g_selectedFontIndex, item.displayName.c_str(), item.isSystemFont ? 1 : 0, item.filePath.c_str());
 		logger->log(logger, buf);
 	}
+	if (!HostCanUseFont(item))
+		return false;
 	if (!edit_handle)
 	{
 		if (logger)
@@ -1231,75 +5626,145 @@ bool SetFontTextObject()
 
 	struct SetObjectParam
 	{
-		std::string sysNameUtf8;
-		std::string displayNameUtf8;
-		std::string filePathUtf8;
-		bool isSystem = false;
-		bool updated = false;
+		const BatchEdit::Replacement *replacement = nullptr;
+		std::vector<BatchEdit::Write<OBJECT_HANDLE>> *writes = nullptr;
+		BatchEdit::Stats stats;
+	};
+
+	// Kept between calls so a repeated apply does not allocate.
+	static BatchEdit::Replacement s_replacement;
+	static std::vector<BatchEdit::Write<OBJECT_HANDLE>> s_writes;
+	s_replacement.anyFont = true;
+	SelectedFontRef(item, s_replacement.to);
+	s_writes.clear();
+	SetObjectParam param;
+	param.replacement = &s_replacement;
+	param.writes = &s_writes;
+
+	FP_TRACE_SCOPE("EditSection.SetFont");
+	bool called = edit_handle->call_edit_section_param(&param, [](void *p, EDIT_SECTION *edit)
+																   {
+		auto *ctx = static_cast<SetObjectParam *>(p);
+		if (!ctx || !edit || !edit->get_object_item_value || !edit->set_object_item_value)
+			return;
+		int n = edit->get_selected_object_num ? edit->get_selected_object_num() : 0;
+		for (int i = 0; i < n; i++)
+		{
+			if (OBJECT_HANDLE object = edit->get_selected_object(i))
+				BatchEdit::PlanObject(edit, object, *ctx->replacement, *ctx->writes, ctx->stats);
+		}
+		if (n < 1)
+		{
+			if (OBJECT_HANDLE object = edit->get_focus_object())
+				BatchEdit::PlanObject(edit, object, *ctx->replacement, *ctx->writes, ctx->stats);
+		}
+		BatchEdit::ApplyWrites(edit, *ctx->writes, ctx->stats); });
+
+	FP_LOG(logger, Info, kCatEdit, L"SetFontTextObject: objects=%u writes=%u unchanged=%u unsupported=%u failed=%u", (UINT)param.stats.matched,
+		   (UINT)param.stats.writes, (UINT)param.stats.unchanged, (UINT)param.stats.unsupported, (UINT)param.stats.failed);
+	bool ok = called && param.stats.matched > param.stats.unsupported && param.stats.failed == 0;
+	if (ok)
+		TouchRecentFont(g_selectedFontIndex);
+	return ok;
+}
+
+// Replace a font on many objects at once, in one edit section: either
+// every text object using the focused object's font, on every layer, or
+// every text object in the timeline's selected frame range (the whole
+// timeline when nothing is selected), optionally only on the layers the
+// selected objects (or the focused one) are on. The selected font is the
+// new one.
+enum class BatchReplaceKind
+{
+	FocusedFont,
+	SelectedRange,
+	SelectedLayers,
+};
+
+static bool BatchReplaceFont(BatchReplaceKind kind)
+{
+	if (g_selectedFontIndex < 0 || g_selectedFontIndex >= (int)g_fontList.size())
+		return false;
+	if (!HostCanUseFont(g_fontList[g_selectedFontIndex]))
+		return false;
+	if (!edit_handle)
+	{
+		if (logger)
+			logger->error(logger, L"編集ハンドルが利用できません");
+		return false;
+	}
+
+	struct BatchParam
+	{
+		BatchReplaceKind kind;
+		BatchEdit::Replacement replacement;
+		std::vector<BatchEdit::Write<OBJECT_HANDLE>> *writes = nullptr;
+		BatchEdit::Scope scope;
+		BatchEdit::Stats stats;
+		bool noSource = false;
+		bool noLayers = false;
 	};
 
-	SetObjectParam param{};
-	param.isSystem = item.isSystemFont;
-	param.sysNameUtf8 = ToUtf8(item.displayName);
-	{
-		std::wstring family = item.displayName;
-		if (!item.isSystemFont)
-		{
-			size_t pos = family.find(L" [");
-			if (pos != std::wstring::npos)
-				family = family.substr(0, pos);
-		}
-		param.displayNameUtf8 = ToUtf8(family);
-	}
-	param.filePathUtf8 = ToUtf8(item.filePath);
+	static std::vector<BatchEdit::Write<OBJECT_HANDLE>> s_writes;
+	BatchParam param;
+	param.kind = kind;
+	param.writes = &s_writes;
+	SelectedFontRef(g_fontList[g_selectedFontIndex], param.replacement.to);
 
+	FP_TRACE_SCOPE("EditSection.BatchReplace");
+	double startMs = NowMs();
 	bool called = edit_handle->call_edit_section_param(&param, [](void *p, EDIT_SECTION *edit)
-																   {
-		auto *ctx = static_cast<SetObjectParam *>(p);
-		if (!ctx || !edit || !edit->set_object_item_value)
+													  {
+		auto *ctx = static_cast<BatchParam *>(p);
+		if (!ctx || !edit)
 			return;
-
-		auto applyToObject = [&](OBJECT_HANDLE object) -> bool
+		if (ctx->kind == BatchReplaceKind::FocusedFont)
 		{
-			if (!object)
-				return false;
-			bool ok = false;
-
-			// 1) Variable Font Text (this plugin)
-			if (ctx->isSystem)
+			OBJECT_HANDLE focus = edit->get_focus_object ? edit->get_focus_object() : nullptr;
+			if (!BatchEdit::ReadFont(edit, focus, ctx->replacement.from))
 			{
-				// 2) Standard Text object (best-effort)
-				ok |= !!edit->set_object_item_value(object, L"テキスト", L"フォント", ctx->sysNameUtf8.c_str());
-				ok |= !!edit->set_object_item_value(object, L"Variable Font Text", L"フォント", ctx->sysNameUtf8.c_str());
-				ok |= !!edit->set_object_item_value(object, L"Variable Font Text", L"フォントファイル", "");
+				ctx->noSource = true;
+				return;
 			}
-			else
+		}
+		else
+		{
+			ctx->replacement.anyFont = true;
+			if (ctx->kind == BatchReplaceKind::SelectedLayers && !BatchEdit::SelectedLayers(edit, ctx->scope))
 			{
-				ok |= !!edit->set_object_item_value(object, L"Variable Font Text", L"フォント", "");
-				ok |= !!edit->set_object_item_value(object, L"Variable Font Text", L"フォントファイル", ctx->filePathUtf8.c_str());
+				ctx->noLayers = true;
+				return;
 			}
-			return ok;
-		};
-
-		int updatedCount = 0;
-		int n = edit->get_selected_object_num ? edit->get_selected_object_num() : 0;
-		if (n >= 1)
-		{
-			for (int i = 0; i < n; i++)
+			if (edit->info && edit->info->select_range_start >= 0 && edit->info->select_range_end >= edit->info->select_range_start)
 			{
-				OBJECT_HANDLE object = edit->get_selected_object(i);
-				if (applyToObject(object))
-					updatedCount++;
+				ctx->scope.frameFirst = edit->info->select_range_start;
+				ctx->scope.frameLast = edit->info->select_range_end;
 			}
-			ctx->updated = (updatedCount > 0);
-			return;
 		}
+		ctx->stats = BatchEdit::ReplaceInScope(edit, ctx->scope, ctx->replacement, *ctx->writes); });
+	double elapsedMs = NowMs() - startMs;
 
-		OBJECT_HANDLE object = edit->get_focus_object();
-		ctx->updated = applyToObject(object);
-	});
-
-	return called && param.updated;
+	if (param.noSource)
+	{
+		if (logger)
+			logger->warn(logger, L"フォーカス中のオブジェクトにテキストがありません");
+		return false;
+	}
+	if (param.noLayers)
+	{
+		if (logger)
+			logger->warn(logger, L"選択中またはフォーカス中のオブジェクトがありません");
+		return false;
+	}
+	static const wchar_t *const kKindNames[] = {L"focused font", L"range", L"layers"};
+	FP_LOG(logger, Info, kCatEdit,
+		   L"BatchReplace[%ls]: scanned=%u matched=%u changed=%u writes=%u unchanged=%u unsupported=%u failed=%u layers=%d-%d frames=%d-%d time=%.1fms",
+		   kKindNames[(int)kind], (UINT)param.stats.scanned, (UINT)param.stats.matched, (UINT)param.stats.changed, (UINT)param.stats.writes,
+		   (UINT)param.stats.unchanged, (UINT)param.stats.unsupported, (UINT)param.stats.failed, param.scope.layerFirst, param.scope.layerLast,
+		   param.scope.frameFirst, param.scope.frameLast == INT_MAX ? -1 : param.scope.frameLast, elapsedMs);
+	if (called && param.stats.changed > 0)
+		TouchRecentFont(g_selectedFontIndex);
+	return called && param.stats.failed == 0;
 }
 
 //---------------------------------------------------------------------
@@ -1370,16 +5835,37 @@ void UpdateLayout(HWND hwnd)
 	int axisW = w - margin * 3 - previewW;
 	if (g_hwndPreview)
 		MoveWindow(g_hwndPreview, margin, y, previewW, paneHeight, TRUE);
+	// Axis ranges on top, one slider row per axis below.
+	int axisX = margin + previewW + margin;
+	int axisLabelHeight = std::max(48, paneHeight - g_axisSliders.count * 44);
 	if (g_hwndAxisLabel)
-		MoveWindow(g_hwndAxisLabel, margin + previewW + margin, y, axisW, paneHeight, TRUE);
+		MoveWindow(g_hwndAxisLabel, axisX, y, axisW, axisLabelHeight, TRUE);
+	LayoutAxisSliders(axisX, y + axisLabelHeight + 4, axisW, paneHeight - axisLabelHeight - 4);
 
 	int sampleTop = y + paneHeight + margin;
+	int modeW = 130;
+	int bgW = 110;
+	int sampleW = std::max(80, w - margin * 4 - bgW - modeW);
+	// The glyph browser swaps the sample text for its go-to box and block list.
+	bool glyphControls = g_specimenMode == Specimen::Mode::Glyphs;
 	if (g_hwndSample)
 	{
-		int bgW = 110;
-		int sampleW = std::max(80, w - margin * 3 - bgW);
 		MoveWindow(g_hwndSample, margin, sampleTop, sampleW, sampleRowHeight, TRUE);
+		ShowWindow(g_hwndSample, glyphControls ? SW_HIDE : SW_SHOW);
+	}
+	int gotoW = std::min(120, sampleW / 3);
+	if (g_hwndGlyphGoto)
+	{
+		MoveWindow(g_hwndGlyphGoto, margin, sampleTop, gotoW, sampleRowHeight, TRUE);
+		ShowWindow(g_hwndGlyphGoto, glyphControls ? SW_SHOW : SW_HIDE);
+	}
+	if (g_hwndGlyphBlock)
+	{
+		MoveWindow(g_hwndGlyphBlock, margin + gotoW + 6, sampleTop, sampleW - gotoW - 6, 300, TRUE);
+		ShowWindow(g_hwndGlyphBlock, glyphControls ? SW_SHOW : SW_HIDE);
 	}
+	if (g_hwndPreviewMode)
+		MoveWindow(g_hwndPreviewMode, w - margin * 2 - 110 - modeW, sampleTop, modeW, 200, TRUE);
 	if (g_hwndBgBtn)
 		MoveWindow(g_hwndBgBtn, w - margin - 110, sampleTop, 110, sampleRowHeight, TRUE);
 }
@@ -1391,14 +5877,16 @@ static void CreateControls(HWND hwnd)
 {
 	g_hwndNameLabel = CreateWindowExW(0, WC_STATIC, L"", WS_VISIBLE | WS_CHILD | SS_LEFT,
 									  10, 10, 400, 24, hwnd, (HMENU)IDC_NAME_LABEL, GetModuleHandleW(nullptr), nullptr);
-	g_hwndSearch = CreateWindowExW(WS_EX_CLIENTEDGE, WC_EDIT, L"", WS_VISIBLE | WS_CHILD | ES_AUTOHSCROLL,
+	g_hwndSearch = CreateWindowExW(WS_EX_CLIENTEDGE, WC_EDIT, g_searchQuery.c_str(), WS_VISIBLE | WS_CHILD | ES_AUTOHSCROLL,
 								   10, 40, 400, 24, hwnd, (HMENU)IDC_SEARCH_EDIT, GetModuleHandleW(nullptr), nullptr);
 	g_hwndType = CreateWindowExW(0, WC_COMBOBOX, nullptr, WS_VISIBLE | WS_CHILD | CBS_DROPDOWNLIST,
 								 420, 40, 200, 120, hwnd, (HMENU)IDC_TYPE_FILTER, GetModuleHandleW(nullptr), nullptr);
 	SendMessageW(g_hwndType, CB_ADDSTRING, 0, (LPARAM)L"すべて");
 	SendMessageW(g_hwndType, CB_ADDSTRING, 0, (LPARAM)L"システム");
 	SendMessageW(g_hwndType, CB_ADDSTRING, 0, (LPARAM)L"外部");
-	SendMessageW(g_hwndType, CB_SETCURSEL, 0, 0);
+	SendMessageW(g_hwndType, CB_ADDSTRING, 0, (LPARAM)L"お気に入り");
+	SendMessageW(g_hwndType, CB_ADDSTRING, 0, (LPARAM)L"最近使用");
+	SendMessageW(g_hwndType, CB_SETCURSEL, (WPARAM)g_filterType, 0);
 
 	g_hwndTypeLabel = CreateWindowExW(0, WC_STATIC, L"", WS_VISIBLE | WS_CHILD | SS_LEFT,
 									  10, 70, 200, 24, hwnd, (HMENU)IDC_TYPE_LABEL, GetModuleHandleW(nullptr), nullptr);
@@ -1408,10 +5896,19 @@ static void CreateControls(HWND hwnd)
 								500, 70, 70, 28, hwnd, (HMENU)IDC_ADD_BUTTON, GetModuleHandleW(nullptr), nullptr);
 	g_hwndAxisLabel = CreateWindowExW(WS_EX_CLIENTEDGE, WC_STATIC, L"", WS_VISIBLE | WS_CHILD | SS_LEFT,
 									  10, 100, 400, 80, hwnd, (HMENU)IDC_AXIS_LABEL, GetModuleHandleW(nullptr), nullptr);
+	CreateAxisSliders(hwnd);
+	g_hwndPreviewMode = CreateWindowExW(0, WC_COMBOBOX, nullptr, WS_VISIBLE | WS_CHILD | CBS_DROPDOWNLIST,
+										10, 400, 130, 200, hwnd, (HMENU)IDC_PREVIEW_MODE, GetModuleHandleW(nullptr), nullptr);
+	SendMessageW(g_hwndPreviewMode, CB_ADDSTRING, 0, (LPARAM)L"1 行");
+	SendMessageW(g_hwndPreviewMode, CB_ADDSTRING, 0, (LPARAM)L"ウォーターフォール");
+	SendMessageW(g_hwndPreviewMode, CB_ADDSTRING, 0, (LPARAM)L"段落");
+	SendMessageW(g_hwndPreviewMode, CB_ADDSTRING, 0, (LPARAM)L"比較");
+	SendMessageW(g_hwndPreviewMode, CB_ADDSTRING, 0, (LPARAM)L"グリフ一覧");
+	SendMessageW(g_hwndPreviewMode, CB_SETCURSEL, 0, 0);
 	g_hwndPreview = CreateWindowExW(WS_EX_CLIENTEDGE, WC_STATIC, L"", WS_VISIBLE | WS_CHILD,
 									10, 190, 400, 200, hwnd, nullptr, GetModuleHandleW(nullptr), nullptr);
 
-	g_hwndGrid = CreateWindowExW(WS_EX_CLIENTEDGE, WC_LISTVIEWW, L"", WS_VISIBLE | WS_CHILD | LVS_REPORT | LVS_SINGLESEL | LVS_SHOWSELALWAYS | LVS_NOCOLUMNHEADER,
+	g_hwndGrid = CreateWindowExW(WS_EX_CLIENTEDGE, WC_LISTVIEWW, L"", WS_VISIBLE | WS_CHILD | LVS_REPORT | LVS_OWNERDATA | LVS_SINGLESEL | LVS_SHOWSELALWAYS | LVS_NOCOLUMNHEADER,
 								 10, 200, 600, 360, hwnd, (HMENU)IDC_FONT_GRID, GetModuleHandleW(nullptr), nullptr);
 	if (g_hwndGrid)
 	{
@@ -1433,35 +5930,55 @@ static void CreateControls(HWND hwnd)
 								   10, 580, 320, 24, hwnd, (HMENU)IDC_SAMPLE_TEXT_EDIT, GetModuleHandleW(nullptr), nullptr);
 	g_hwndBgBtn = CreateWindowExW(0, WC_BUTTON, L"背景色", WS_VISIBLE | WS_CHILD | BS_PUSHBUTTON,
 								  340, 580, 200, 28, hwnd, (HMENU)IDC_BG_COLOR_BTN, GetModuleHandleW(nullptr), nullptr);
+	g_hwndGlyphGoto = CreateWindowExW(WS_EX_CLIENTEDGE, WC_EDIT, L"", WS_CHILD | ES_AUTOHSCROLL,
+									  10, 580, 120, 24, hwnd, (HMENU)IDC_GLYPH_GOTO, GetModuleHandleW(nullptr), nullptr);
+	g_hwndGlyphBlock = CreateWindowExW(0, WC_COMBOBOX, nullptr, WS_CHILD | WS_VSCROLL | CBS_DROPDOWNLIST,
+									   140, 580, 200, 300, hwnd, (HMENU)IDC_GLYPH_BLOCK, GetModuleHandleW(nullptr), nullptr);
 }
 
 // handle selection/change/click/dblclk for the font list
+// Warm selections (faces, axes and the preview bitmap already cached) are
+// expected not to allocate. Debug builds count this thread's allocations
+// and warn when a warm selection did; see AllocCounter.h.
+static void ReportSelectionAllocations(uint64_t count, uint64_t bytes, int fontIdx)
+{
+	if (!AllocCounter::Installed())
+		return;
+	FP_LOG_VERBOSE(logger, kCatList, L"ListView: selection allocations=%llu bytes=%llu warm=%d",
+				   (unsigned long long)count, (unsigned long long)bytes, g_lastPreviewBitmapHit ? 1 : 0);
+	if (count > 0 && g_lastPreviewBitmapHit && g_fontList[fontIdx].axesResolved)
+		FP_LOG_RATE(logger, Warn, kCatList, kPerFrameLogIntervalMs, L"ListView: warm selection allocated %llu times (%llu bytes)",
+					(unsigned long long)count, (unsigned long long)bytes);
+}
+
 static void HandleListViewSelection(HWND hwnd, int hintIdx, bool dblclk) {
+	AllocCounter::Scope allocs;
 	int idx = ListView_GetNextItem(g_hwndGrid, -1, LVNI_SELECTED);
 	if (idx < 0) idx = hintIdx;
-	if (idx < 0) return;
-	LVITEMW lvi{};
-	lvi.iItem = idx;
-	lvi.iSubItem = 0;
-	lvi.mask = LVIF_PARAM;
-	if (!ListView_GetItem(g_hwndGrid, &lvi)) return;
-
-	int fontIdx = (int)lvi.lParam;
+	if (idx < 0 || idx >= (int)g_listRows.size()) return;
+
+	int fontIdx = g_listRows[idx].fontIndex;
+	int faceIdx = g_listRows[idx].faceIndex;
 	if (fontIdx < 0 || fontIdx >= (int)g_fontList.size()) return;
-	if (fontIdx == g_selectedFontIndex && !dblclk)
+	// A click raises LVN_ITEMCHANGED and NM_CLICK (and NM_DBLCLK); only the
+	// first changes the selection, a double click only adds the object.
+	bool changed = fontIdx != g_selectedFontIndex || faceIdx != g_selectedFaceIndex;
+	if (!changed && !dblclk)
 	{
-		if (logger)
-			logger->verbose(logger, L"ListView: selection unchanged, skip");
+		FP_LOG_VERBOSE(logger, kCatList, L"ListView: selection unchanged, skip");
 		return;
 	}
-	g_selectedFontIndex = fontIdx;
-	UpdateDetailPanel();
-	RedrawGrid();
-	RenderPreview(L"ListViewSelection");
-	if (logger) {
-		wchar_t buf[128];
-		swprintf_s(buf, L"ListView: select idx=%d fontIndex=%d", idx, g_selectedFontIndex);
-		logger->info(logger, buf);
+	if (changed)
+	{
+		g_selectedFontIndex = fontIdx;
+		g_selectedFaceIndex = faceIdx;
+		RequestFamilyFaces(fontIdx, TaskQueue::Priority::High);
+		MarkDirty(DirtyState::Action::Selection, DirtyState::Detail | DirtyState::Preview);
+		PrefetchNeighbourPreviews(idx);
+		g_pendingSelectionFont = fontIdx;
+		g_pendingSelectionAllocs += allocs.Allocations();
+		g_pendingSelectionBytes += allocs.Bytes();
+		FP_LOG(logger, Info, kCatList, L"ListView: select idx=%d fontIndex=%d face=%d", idx, g_selectedFontIndex, g_selectedFaceIndex);
 	}
 	if (dblclk) {
 		PostMessageW(hwnd, WM_DO_SET_FONT_OBJECT, 0, 0);
@@ -1479,8 +5996,7 @@ static void HandleBgColorButton(HWND hwnd) {
 	cc.Flags = CC_FULLOPEN | CC_RGBINIT;
 	if (ChooseColorW(&cc)) {
 		g_previewBgColor = cc.rgbResult;
-		RedrawGrid();
-		RenderPreview(L"BgColorChange");
+		MarkDirty(DirtyState::Action::Background, DirtyState::Preview);
 	}
 }
 
@@ -1499,12 +6015,499 @@ void ApplyFilterFromUI()
 			g_filterType = FontTypeFilter::System;
 		else if (sel == 2)
 			g_filterType = FontTypeFilter::Folder;
+		else if (sel == 3)
+			g_filterType = FontTypeFilter::Favorites;
+		else if (sel == 4)
+			g_filterType = FontTypeFilter::Recent;
 		else
 			g_filterType = FontTypeFilter::All;
 	}
 	ApplyFilter();
 }
 
+//---------------------------------------------------------------------
+//	Favorites and recent fonts
+//---------------------------------------------------------------------
+// FontPreview.favorites (next to the plugin) keeps the favorites and the
+// fonts last applied to objects, by identity (see Favorites.h). Both are
+// resolved to catalog bitsets on every install and change; the list's ★
+// marks and the Favorites/Recent filters read those. Once the preview has
+// a size (after the first frame, and again when the catalog is installed)
+// the working set is warmed at low priority: the queue builds each font's
+// layout, which brings its collection and text format, and the UI thread
+// then renders the preview bitmap, so the first selections are cache hits.
+constexpr size_t kWarmStartFonts = 12;
+
+struct WarmStartStats
+{
+	UINT fonts = 0;	  // working-set fonts in the catalog
+	UINT cached = 0;  // preview already rendered
+	UINT queued = 0;
+	UINT arrived = 0;
+	UINT bitmaps = 0; // rendered when their layout arrived
+	UINT skipped = 0; // arrived while the preview could not use them
+	double startMs = 0.0;
+};
+
+static Favorites::WorkingSet g_workingSet;
+static bool g_workingSetLoaded = false;
+static UINT g_warmStartGeneration = 0;
+static bool g_warmStartPending = true; // waiting for a frame's layout parameters
+static WarmStartStats g_warmStart;
+
+static std::wstring GetFavoritesPath()
+{
+	return GetPluginDirectory() + L"\\FontPreview.favorites";
+}
+
+static void LoadWorkingSet()
+{
+	if (g_workingSetLoaded)
+		return;
+	g_workingSetLoaded = true;
+	std::ifstream in(std::filesystem::path(GetFavoritesPath()), std::ios::binary);
+	if (in && !g_workingSet.Load(in) && logger)
+		logger->warn(logger, L"Favorites: file ignored (unknown format)");
+}
+
+static void SaveWorkingSet()
+{
+	if (!g_workingSet.IsDirty())
+		return;
+	std::ofstream out(std::filesystem::path(GetFavoritesPath()), std::ios::binary | std::ios::trunc);
+	if (!out)
+	{
+		if (logger)
+			logger->warn(logger, L"Favorites: file could not be written");
+		return;
+	}
+	g_workingSet.Save(out);
+}
+
+static void ResolveWorkingSet()
+{
+	LoadWorkingSet();
+	Favorites::Resolve(g_fontList, g_workingSet.Favorites(), g_favoriteBits);
+	Favorites::Resolve(g_fontList, g_workingSet.Recent(), g_recentBits);
+}
+
+static bool IsFavoriteFont(int fontIdx)
+{
+	return fontIdx >= 0 && FontPreviewCore::TestBit(g_favoriteBits, (size_t)fontIdx);
+}
+
+static void ToggleFavorite(int fontIdx)
+{
+	if (fontIdx < 0 || fontIdx >= (int)g_fontList.size())
+		return;
+	LoadWorkingSet();
+	Favorites::ToggleResult result = g_workingSet.ToggleFavorite(FontPreviewCore::BuildFontIdentity(g_fontList[fontIdx]));
+	if (result == Favorites::ToggleResult::Full)
+	{
+		FP_LOG(logger, Warn, kCatFilter, L"Favorites: at most %u fonts can be marked", (UINT)Favorites::kMaxFavorites);
+		return;
+	}
+	FP_LOG(logger, Info, kCatFilter, L"Favorites: %ls %ls (%u marked)", result == Favorites::ToggleResult::Added ? L"added" : L"removed",
+		   g_fontList[fontIdx].displayName.c_str(), (UINT)g_workingSet.Favorites().size());
+	SaveWorkingSet();
+	ResolveWorkingSet();
+	if (g_filterType == FontTypeFilter::Favorites)
+		ApplyFilter();
+	else
+		MarkDirty(DirtyState::Action::Favorites, DirtyState::ListRows, FindListRow(fontIdx, -1));
+}
+
+// A font was applied to objects: it becomes the most recent one.
+static void TouchRecentFont(int fontIdx)
+{
+	if (fontIdx < 0 || fontIdx >= (int)g_fontList.size())
+		return;
+	LoadWorkingSet();
+	if (!g_workingSet.Touch(FontPreviewCore::BuildFontIdentity(g_fontList[fontIdx])))
+		return;
+	SaveWorkingSet();
+	ResolveWorkingSet();
+	if (g_filterType == FontTypeFilter::Recent)
+		ApplyFilter();
+}
+
+static void LogWarmStart(const wchar_t *reason)
+{
+	FP_LOG(logger, Info, kCatRender, L"WarmStart[%ls]: fonts=%u cached=%u queued=%u bitmaps=%u skipped=%u time=%.1fms", reason, g_warmStart.fonts,
+		   g_warmStart.cached, g_warmStart.queued, g_warmStart.bitmaps, g_warmStart.skipped, NowMs() - g_warmStart.startMs);
+}
+
+// Queue the working set's layouts (recent fonts first, see
+// WorkingSet::PreloadOrder). Needs the layout parameters of a rendered
+// frame, so before the first one this only marks the start pending (see
+// ResumeWarmStart). Fonts whose preview is already rendered are skipped;
+// completions of an older start are ignored.
+static void StartWarmStart(const wchar_t *reason)
+{
+	g_backgroundTasks.Cancel(kTaskTagWarmStart);
+	UINT generation = ++g_warmStartGeneration;
+	g_warmStart = WarmStartStats{};
+	g_warmStartPending = !g_hwndMain || g_previewLayouts.Text().empty() || g_previewLayouts.Width() <= 0.0f;
+	if (g_warmStartPending)
+		return;
+	LoadWorkingSet();
+	std::vector<std::wstring> order;
+	g_workingSet.PreloadOrder(kWarmStartFonts, order);
+	if (order.empty())
+		return;
+	FontPreviewCore::CatalogBits members;
+	std::vector<int> indices;
+	Favorites::Resolve(g_fontList, order, members, &indices);
+	g_warmStart.startMs = NowMs();
+	HWND hwnd = g_hwndMain;
+	for (int fontIndex : indices)
+	{
+		if (fontIndex < 0)
+			continue;
+		g_warmStart.fonts++;
+		if (PreviewBitmapCached(fontIndex, -1, g_previewLayouts.Text()))
+		{
+			g_warmStart.cached++;
+			continue;
+		}
+		PreviewLayoutJob job;
+		if (!MakePreviewLayoutJob(fontIndex, -1, job))
+			continue;
+		RequestFontAxes(fontIndex, TaskQueue::Priority::Low);
+		auto task = [job, generation, hwnd]() mutable
+		{
+			if (!g_previewLayouts.Contains(job.layoutKey))
+				BuildQueuedPreviewLayout(job, false);
+			PostMessageW(hwnd, WM_WARM_START_READY, (WPARAM)job.fontIndex, (LPARAM)generation);
+		};
+		if (g_backgroundTasks.Post(TaskQueue::Priority::Low, kTaskTagWarmStart, task))
+			g_warmStart.queued++;
+	}
+	if (g_warmStart.queued == 0)
+		LogWarmStart(reason);
+}
+
+// After every frame: the first one that has layout parameters starts the
+// warm start the catalog install (or startup) is waiting on.
+static void ResumeWarmStart()
+{
+	if (g_warmStartPending && g_previewLayouts.Width() > 0.0f)
+		StartWarmStart(L"first frame");
+}
+
+// WM_WARM_START_READY: a working-set layout was built; render its preview
+// bitmap while the pane shows single previews. A layout that failed or is
+// already gone again (sample text or size changed) is a skip.
+static void HandleWarmStartReady(int fontIndex, UINT generation)
+{
+	if (generation != g_warmStartGeneration || fontIndex < 0 || fontIndex >= (int)g_fontList.size())
+		return;
+	bool layoutReady = g_previewLayouts.Contains(PreviewLayoutKey(fontIndex, -1));
+	if (layoutReady && g_visibility.Current() == Visibility::State::Visible && g_specimenMode == Specimen::Mode::Single && g_d2dContext &&
+		g_previewBitmapWidth > 0 && g_previewBitmapHeight > 0)
+	{
+		FP_TRACE_SCOPE("WarmStartBitmap");
+		bool hit = false;
+		if (AcquirePreviewBitmap(fontIndex, -1, g_previewLayouts.Text(), g_previewBitmapWidth, g_previewBitmapHeight, hit) && !hit)
+		{
+			g_warmStart.bitmaps++;
+			g_memoryBudget.Enforce();
+		}
+	}
+	else
+	{
+		g_warmStart.skipped++;
+	}
+	if (++g_warmStart.arrived == g_warmStart.queued)
+		LogWarmStart(L"done");
+}
+
+//---------------------------------------------------------------------
+//	Session snapshot
+//---------------------------------------------------------------------
+// FontPreview.session (next to the plugin) keeps the view across restarts;
+// see Session.h. Until the startup enumeration finishes, g_fontList holds
+// the snapshot's rows (`g_catalogProvisional`), so the list, selection and
+// preview work from the first frame. HandleFontCatalogReady then swaps in
+// the real catalog and carries the selection and scroll over by identity.
+static Session::Snapshot g_session; // as loaded
+static bool g_catalogProvisional = false;
+static uint64_t g_catalogSignature = 0; // Session::CatalogSignature of the live catalog
+static bool g_sessionSaved = false;
+
+static std::wstring GetSessionPath()
+{
+	return GetPluginDirectory() + L"\\FontPreview.session";
+}
+
+// Restore the persisted state; call before CreateControls, which shows it.
+static void LoadSession()
+{
+	std::ifstream in(std::filesystem::path(GetSessionPath()), std::ios::binary);
+	if (!in)
+		return;
+	std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	if (!Session::Decode(bytes.data(), bytes.size(), g_session))
+	{
+		if (logger)
+			logger->warn(logger, L"Session: snapshot ignored (unknown format or damaged)");
+		return;
+	}
+	g_searchQuery = g_session.searchQuery;
+	g_filterType = g_session.filterType;
+	g_sampleText = g_session.sampleText;
+	g_previewBgColor = (COLORREF)g_session.bgColor;
+}
+
+// Font of the first visible list row, or -1.
+static int TopListFont()
+{
+	if (!g_hwndGrid || !IsWindow(g_hwndGrid))
+		return -1;
+	int top = ListView_GetTopIndex(g_hwndGrid);
+	return top >= 0 && top < (int)g_listRows.size() ? g_listRows[top].fontIndex : -1;
+}
+
+// Make `row` the first visible row, as far as the list can scroll.
+static void ScrollListToRow(int row)
+{
+	if (!g_hwndGrid || row < 0 || row >= (int)g_listRows.size())
+		return;
+	int page = std::max(ListView_GetCountPerPage(g_hwndGrid), 1);
+	ListView_EnsureVisible(g_hwndGrid, std::min((int)g_listRows.size() - 1, row + page - 1), FALSE);
+	ListView_EnsureVisible(g_hwndGrid, row, FALSE);
+}
+
+// List the snapshot's rows as the catalog until enumeration is done. The
+// caller filters them (they all match the restored query) and scrolls to
+// g_session.topRow once the list has its size.
+static void ShowSessionSnapshot()
+{
+	std::vector<FontItem> fonts;
+	Session::RestoreRows(g_session, fonts);
+	for (auto &item : fonts)
+		FontPreviewCore::PrecomputeDisplayStrings(item);
+	g_fontList = std::move(fonts);
+	g_catalogProvisional = true;
+	g_selectedFontIndex = Session::FindByIdentity(g_fontList, g_session.selectedIdentity);
+	g_selectedFaceIndex = -1;
+	ResolveComparePins();
+	ResolveWorkingSet();
+	FP_LOG(logger, Info, kCatEnum, L"Session: restored rows=%d top=%u selected=%d", (int)g_fontList.size(), g_session.topRow, g_selectedFontIndex);
+}
+
+static void SaveSession()
+{
+	Session::Snapshot s;
+	s.searchQuery = g_searchQuery;
+	s.filterType = g_filterType;
+	s.sampleText = g_sampleText;
+	s.bgColor = (uint32_t)(g_previewBgColor & 0xFFFFFF);
+	if (g_selectedFontIndex >= 0 && g_selectedFontIndex < (int)g_fontList.size())
+		s.selectedIdentity = FontPreviewCore::BuildFontIdentity(g_fontList[g_selectedFontIndex]);
+	int topFont = TopListFont();
+	if (topFont >= 0)
+		s.topRow = (uint32_t)(std::lower_bound(g_filteredIndices.begin(), g_filteredIndices.end(), topFont) - g_filteredIndices.begin());
+	// Indices into snapshot rows mean nothing to the next catalog.
+	Session::CaptureRows(g_fontList, g_filteredIndices, g_catalogProvisional ? 0 : g_catalogSignature, s);
+	std::vector<uint8_t> bytes;
+	Session::Encode(s, bytes);
+	std::ofstream out(std::filesystem::path(GetSessionPath()), std::ios::binary | std::ios::trunc);
+	if (!out || !out.write((const char *)bytes.data(), (std::streamsize)bytes.size()))
+	{
+		if (logger)
+			logger->warn(logger, L"Session: snapshot could not be written");
+		return;
+	}
+	g_sessionSaved = true;
+	FP_LOG(logger, Info, kCatEnum, L"Session: saved rows=%u bytes=%u provisional=%d", (UINT)s.rows.size(), (UINT)bytes.size(), g_catalogProvisional ? 1 : 0);
+}
+
+// WM_FONT_CATALOG_READY: replace the snapshot rows (or the empty list of a
+// first run) with the enumerated catalog.
+static void HandleFontCatalogReady()
+{
+	std::unique_ptr<FontCatalogBuild> build = TakeEnumeratedCatalog();
+	if (!build)
+		return;
+	FP_TRACE_SCOPE("SessionReconcile");
+	std::wstring selected, top;
+	if (g_selectedFontIndex >= 0 && g_selectedFontIndex < (int)g_fontList.size())
+		selected = FontPreviewCore::BuildFontIdentity(g_fontList[g_selectedFontIndex]);
+	int topFont = TopListFont();
+	if (topFont >= 0)
+		top = FontPreviewCore::BuildFontIdentity(g_fontList[topFont]);
+
+	InstallFontCatalog(std::move(*build));
+	g_catalogProvisional = false;
+	g_catalogSignature = Session::CatalogSignature(g_fontList);
+	g_selectedFontIndex = Session::FindByIdentity(g_fontList, selected);
+	g_selectedFaceIndex = -1;
+	bool kept = g_selectedFontIndex >= 0;
+	// An unchanged catalog with the query and filter still as saved needs
+	// no filtering; otherwise (or when the user already typed) filter.
+	bool reused = Session::ReuseIndices(g_session, g_catalogSignature, g_fontList.size(), g_searchQuery, g_filterType, g_filteredIndices);
+	if (reused)
+		ShowFilteredFonts();
+	else
+		ApplyFilter();
+	ScrollListToRow(FindListRow(Session::FindByIdentity(g_fontList, top), -1));
+	// Slider state still names snapshot indices; resync before any input.
+	UpdateDetailPanel();
+	FP_LOG(logger, Info, kCatEnum, L"Session: reconciled fonts=%d filtered=%d indices=%ls selection=%ls", (int)g_fontList.size(),
+		   (int)g_filteredIndices.size(), reused ? L"reused" : L"refiltered", selected.empty() ? L"none" : kept ? L"kept" : L"lost");
+	// Only the first catalog can match the snapshot.
+	g_session.filteredIndices = std::vector<uint32_t>();
+	g_session.rows = std::vector<Session::Row>();
+	// Layouts are keyed by index; the bitmaps warmed from the snapshot rows
+	// carried over and are skipped.
+	StartWarmStart(L"catalog");
+}
+
+//---------------------------------------------------------------------
+//	Tools menu (tracing, memory)
+//---------------------------------------------------------------------
+static void LogTraceSummary()
+{
+	if (!logger)
+		return;
+	std::vector<std::string> lines = Trace::Registry::Get().SummaryLines();
+	if (lines.empty())
+	{
+		logger->info(logger, L"Trace: no samples (enable tracing from the context menu)");
+		return;
+	}
+	for (const auto &line : lines)
+	{
+		std::wstring wide(line.begin(), line.end());
+		std::wstring msg = L"Trace: " + wide;
+		logger->info(logger, msg.c_str());
+	}
+}
+
+static void ExportTrace()
+{
+	std::wstring path = GetPluginDirectory() + L"\\FontPreview.trace.json";
+	std::ofstream out(std::filesystem::path(path), std::ios::binary);
+	if (out)
+		Trace::Registry::Get().WriteChromeTrace(out);
+	if (logger)
+	{
+		std::wstring msg = (out ? L"Trace: wrote " : L"Trace: could not write ") + path;
+		logger->info(logger, msg.c_str());
+	}
+}
+
+// Right-click menu: toggle tracing, dump histograms to the log, write the
+// recent spans as Chrome trace JSON next to the plugin, report cache memory,
+// repaint counts and visibility state, toggle auto-fit, mark a favorite,
+// replace a font across the timeline, or change the memory budget for this
+// session.
+static void ShowToolsMenu(HWND hwnd, LPARAM lparam)
+{
+	POINT pt{GET_X_LPARAM(lparam), GET_Y_LPARAM(lparam)};
+	if (pt.x == -1 && pt.y == -1)
+		GetCursorPos(&pt);
+	HMENU menu = CreatePopupMenu();
+	if (!menu)
+		return;
+	AppendMenuW(menu, MF_STRING | (Trace::IsEnabled() ? MF_CHECKED : MF_UNCHECKED), IDM_TRACE_TOGGLE, L"計測を有効にする");
+	AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
+	AppendMenuW(menu, MF_STRING, IDM_TRACE_SUMMARY, L"計測結果をログに出力");
+	AppendMenuW(menu, MF_STRING, IDM_TRACE_EXPORT, L"トレースを書き出す (FontPreview.trace.json)");
+	AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
+	AppendMenuW(menu, MF_STRING, IDM_MEMORY_REPORT, L"メモリ使用量をログに出力");
+	AppendMenuW(menu, MF_STRING, IDM_REPAINT_REPORT, L"再描画回数をログに出力");
+	AppendMenuW(menu, MF_STRING, IDM_VISIBILITY_REPORT, L"表示状態をログに出力");
+	AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
+	AppendMenuW(menu, MF_STRING | (g_autoFit ? MF_CHECKED : MF_UNCHECKED), IDM_AUTO_FIT, L"文字サイズを自動調整");
+	bool canSweep = g_axisSliders.count > 0 && g_axisSliders.fontIndex == g_selectedFontIndex && g_specimenMode == Specimen::Mode::Single;
+	AppendMenuW(menu, MF_STRING | (g_axisSweep.running ? MF_CHECKED : MF_UNCHECKED) | (canSweep || g_axisSweep.running ? MF_ENABLED : MF_GRAYED),
+				IDM_AXIS_SWEEP, L"軸アニメーション（スライダーの範囲を往復）");
+	bool pinned = IsComparePinned(g_selectedFontIndex, g_selectedFaceIndex);
+	bool canPin = g_selectedFontIndex >= 0 && (pinned || g_comparePins.Size() < (size_t)Compare::kMaxPinned);
+	AppendMenuW(menu, MF_STRING | (pinned ? MF_CHECKED : MF_UNCHECKED) | (canPin ? MF_ENABLED : MF_GRAYED), IDM_COMPARE_PIN, L"比較にピン留め");
+	AppendMenuW(menu, MF_STRING | (g_comparePins.Size() > 0 ? MF_ENABLED : MF_GRAYED), IDM_COMPARE_CLEAR, L"比較のピンをすべて外す");
+	AppendMenuW(menu, MF_STRING | (IsFavoriteFont(g_selectedFontIndex) ? MF_CHECKED : MF_UNCHECKED) | (g_selectedFontIndex >= 0 ? MF_ENABLED : MF_GRAYED),
+				IDM_FAVORITE_TOGGLE, L"お気に入り");
+	AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
+	UINT canReplace = g_selectedFontIndex >= 0 && edit_handle ? MF_ENABLED : MF_GRAYED;
+	AppendMenuW(menu, MF_STRING | canReplace, IDM_BATCH_REPLACE_FOCUSED, L"フォーカス中のオブジェクトと同じフォントをすべて置き換え");
+	AppendMenuW(menu, MF_STRING | canReplace, IDM_BATCH_REPLACE_RANGE, L"選択範囲のテキストのフォントをすべて置き換え");
+	AppendMenuW(menu, MF_STRING | canReplace, IDM_BATCH_REPLACE_LAYERS, L"選択中のオブジェクトのレイヤーだけ、選択範囲のテキストのフォントを置き換え");
+	if (HMENU budgetMenu = CreatePopupMenu())
+	{
+		size_t budgetMB = g_memoryBudget.Budget() / (1024 * 1024);
+		for (UINT i = 0; i < _countof(kMemoryBudgetChoicesMB); i++)
+		{
+			wchar_t label[32];
+			swprintf_s(label, L"%u MB", kMemoryBudgetChoicesMB[i]);
+			AppendMenuW(budgetMenu, MF_STRING | (budgetMB == kMemoryBudgetChoicesMB[i] ? MF_CHECKED : MF_UNCHECKED), IDM_MEMORY_BUDGET_BASE + i, label);
+		}
+		AppendMenuW(menu, MF_POPUP, (UINT_PTR)budgetMenu, L"メモリ上限");
+	}
+	int cmd = (int)TrackPopupMenu(menu, TPM_RIGHTBUTTON | TPM_RETURNCMD, pt.x, pt.y, 0, hwnd, nullptr);
+	DestroyMenu(menu);
+	switch (cmd)
+	{
+	case IDM_TRACE_TOGGLE:
+		Trace::SetEnabled(!Trace::IsEnabled());
+		if (logger)
+			logger->info(logger, Trace::IsEnabled() ? L"Trace: enabled" : L"Trace: disabled");
+		break;
+	case IDM_TRACE_SUMMARY:
+		LogTraceSummary();
+		break;
+	case IDM_TRACE_EXPORT:
+		ExportTrace();
+		break;
+	case IDM_MEMORY_REPORT:
+		LogMemoryBudget(L"menu");
+		break;
+	case IDM_REPAINT_REPORT:
+		LogRepaintCounters(L"menu");
+		break;
+	case IDM_VISIBILITY_REPORT:
+		LogVisibility(L"menu");
+		break;
+	case IDM_AXIS_SWEEP:
+		if (g_axisSweep.running)
+			StopAxisSweep(L"menu");
+		else
+			StartAxisSweep();
+		break;
+	case IDM_COMPARE_PIN:
+		ToggleComparePin(g_selectedFontIndex, g_selectedFaceIndex);
+		break;
+	case IDM_COMPARE_CLEAR:
+		ClearComparePins();
+		break;
+	case IDM_FAVORITE_TOGGLE:
+		ToggleFavorite(g_selectedFontIndex);
+		break;
+	case IDM_AUTO_FIT:
+		SetAutoFit(!g_autoFit);
+		break;
+	case IDM_BATCH_REPLACE_FOCUSED:
+		BatchReplaceFont(BatchReplaceKind::FocusedFont);
+		break;
+	case IDM_BATCH_REPLACE_RANGE:
+		BatchReplaceFont(BatchReplaceKind::SelectedRange);
+		break;
+	case IDM_BATCH_REPLACE_LAYERS:
+		BatchReplaceFont(BatchReplaceKind::SelectedLayers);
+		break;
+	default:
+		if (cmd >= IDM_MEMORY_BUDGET_BASE && cmd < IDM_MEMORY_BUDGET_BASE + (int)_countof(kMemoryBudgetChoicesMB))
+		{
+			g_memoryBudget.SetBudget((size_t)kMemoryBudgetChoicesMB[cmd - IDM_MEMORY_BUDGET_BASE] * 1024 * 1024);
+			g_memoryBudget.Enforce();
+			LogMemoryBudget(L"budget changed");
+		}
+		break;
+	}
+}
+
 // forward decls for refactor helpers
 static void CreateControls(HWND hwnd);
 
@@ -1516,7 +6519,10 @@ LRESULT CALLBACK wnd_proc(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam)
 	switch (message)
 	{
 	case WM_LBUTTONDOWN:
-		// Allow default processing; ListView handles its own clicks
+		// The ListView handles its own clicks; the preview (a static) passes
+		// them through, which selects a cell in the glyph browser.
+		if (HandleGlyphClick(hwnd, POINT{GET_X_LPARAM(lparam), GET_Y_LPARAM(lparam)}))
+			return 0;
 		break;
 	case WM_DO_SET_FONT_OBJECT:
 		// Apply selected font to the host object.
@@ -1525,7 +6531,10 @@ LRESULT CALLBACK wnd_proc(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam)
 		}
 		return 0;
 	case WM_MOUSEWHEEL:
-		// ListView manages scrolling; no parent fallback needed
+		// The ListView scrolls itself; wheel messages reaching the parent
+		// scroll the specimen view when the cursor is over the preview.
+		if (HandleSpecimenWheel(GET_WHEEL_DELTA_WPARAM(wparam), POINT{GET_X_LPARAM(lparam), GET_Y_LPARAM(lparam)}))
+			return 0;
 		break;
 	case WM_COMMAND:
 		switch (LOWORD(wparam))
@@ -1538,12 +6547,27 @@ LRESULT CALLBACK wnd_proc(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam)
 			if (HIWORD(wparam) == CBN_SELCHANGE)
 				ApplyFilterFromUI();
 			return 0;
+		case IDC_PREVIEW_MODE:
+			if (HIWORD(wparam) == CBN_SELCHANGE)
+			{
+				int sel = (int)SendMessageW(g_hwndPreviewMode, CB_GETCURSEL, 0, 0);
+				if (sel >= 0 && sel < (int)Specimen::Mode::Count)
+					SetSpecimenMode((Specimen::Mode)sel);
+			}
+			return 0;
+		case IDC_GLYPH_GOTO:
+			if (HIWORD(wparam) == EN_CHANGE)
+				JumpToGlyphFromEdit();
+			return 0;
+		case IDC_GLYPH_BLOCK:
+			if (HIWORD(wparam) == CBN_SELCHANGE)
+				JumpToGlyphBlock((int)SendMessageW(g_hwndGlyphBlock, CB_GETCURSEL, 0, 0));
+			return 0;
 		case IDC_SAMPLE_TEXT_EDIT:
 			if (HIWORD(wparam) == EN_CHANGE)
 			{
 				SyncSampleTextFromEdit();
-				RedrawGrid();
-				RenderPreview(L"SampleTextChange");
+				MarkDirty(DirtyState::Action::SampleText, DirtyState::Preview);
 			}
 			return 0;
 			case IDC_BG_COLOR_BTN:
@@ -1568,6 +6592,35 @@ LRESULT CALLBACK wnd_proc(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam)
 		LPNMHDR pnm = (LPNMHDR)lparam;
 		if (pnm->idFrom == IDC_FONT_GRID)
 		{
+			if (pnm->code == LVN_GETDISPINFOW)
+			{
+				FillListRowText((NMLVDISPINFOW *)lparam);
+				return 0;
+			}
+			if (pnm->code == LVN_ODCACHEHINT)
+			{
+				NMLVCACHEHINT *hint = (NMLVCACHEHINT *)lparam;
+				PrefetchFacesForRows(hint->iFrom, hint->iTo);
+				return 0;
+			}
+			if (pnm->code == LVN_KEYDOWN)
+			{
+				NMLVKEYDOWN *key = (NMLVKEYDOWN *)lparam;
+				int row = ListView_GetNextItem(g_hwndGrid, -1, LVNI_SELECTED);
+				if (row >= 0 && row < (int)g_listRows.size() && (key->wVKey == VK_RIGHT || key->wVKey == VK_LEFT))
+					SetFamilyExpanded(g_listRows[row].fontIndex, key->wVKey == VK_RIGHT);
+				return 0;
+			}
+			if (pnm->code == NM_CLICK)
+			{
+				// Clicking the ▸/▾ marker toggles the family.
+				LPNMITEMACTIVATE act = (LPNMITEMACTIVATE)lparam;
+				if (act->iItem >= 0 && act->iItem < (int)g_listRows.size() && g_listRows[act->iItem].faceIndex < 0 && act->ptAction.x < 20)
+				{
+					int fontIdx = g_listRows[act->iItem].fontIndex;
+					SetFamilyExpanded(fontIdx, g_expandedFamilies.count(fontIdx) == 0);
+				}
+			}
 			if (pnm->code == LVN_ITEMACTIVATE || pnm->code == NM_CLICK || pnm->code == LVN_ITEMCHANGED || pnm->code == NM_DBLCLK)
 			{
 				int hint = -1;
@@ -1589,13 +6642,85 @@ LRESULT CALLBACK wnd_proc(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam)
 		}
 		break;
 	}
+	case WM_FONT_FACES_READY:
+		HandleFamilyFacesReady((int)wparam, (UINT)lparam);
+		return 0;
+	case WM_FONT_AXES_READY:
+		HandleFontAxesReady((int)wparam, (UINT)lparam);
+		return 0;
+	case WM_FLUSH_INVALIDATION:
+		FlushInvalidation();
+		return 0;
+	case WM_CONTEXTMENU:
+		if ((HWND)wparam == g_hwndSearch || (HWND)wparam == g_hwndSample)
+			break;
+		ShowToolsMenu(hwnd, lparam);
+		return 0;
 	case WM_PAINT:
 		RenderPreview(L"WM_PAINT");
 		break;
 	case WM_SIZE:
+		ApplyVisibility(g_visibility.SetMinimized(wparam == SIZE_MINIMIZED), L"WM_SIZE");
 		UpdateLayout(hwnd);
 		RenderPreview(L"WM_SIZE");
 		return 0;
+	case WM_SHOWWINDOW:
+		ApplyVisibility(g_visibility.SetShown(wparam != FALSE), L"WM_SHOWWINDOW");
+		break;
+	case WM_WINDOWPOSCHANGED:
+	{
+		// Docking hosts switch panes with SetWindowPos rather than ShowWindow.
+		const WINDOWPOS *pos = (const WINDOWPOS *)lparam;
+		if (pos && (pos->flags & (SWP_SHOWWINDOW | SWP_HIDEWINDOW)) != 0)
+			ApplyVisibility(g_visibility.SetShown((pos->flags & SWP_SHOWWINDOW) != 0), L"WM_WINDOWPOSCHANGED");
+		break;
+	}
+	case WM_HSCROLL:
+		if (lparam && HandleAxisSliderScroll((HWND)lparam))
+			return 0;
+		break;
+	case WM_TIMER:
+		if (wparam == kOcclusionProbeTimerId)
+		{
+			ProbeOcclusion();
+			return 0;
+		}
+		if (wparam == kAxisSweepTimerId)
+		{
+			HandleAxisSweepTimer();
+			return 0;
+		}
+		if (wparam == kCatalogPublishTimerId)
+		{
+			PublishCatalog(L"details", true);
+			return 0;
+		}
+		break;
+	case WM_AXIS_SWEEP_FRAME:
+		HandleAxisSweepFrames();
+		return 0;
+	case WM_GLYPH_TABLE_READY:
+		HandleGlyphTableReady();
+		return 0;
+	case WM_GLYPH_PREFETCH:
+		HandleGlyphPrefetch();
+		return 0;
+	case WM_FONT_CATALOG_READY:
+		HandleFontCatalogReady();
+		return 0;
+	case WM_WARM_START_READY:
+		HandleWarmStartReady((int)wparam, (UINT)lparam);
+		return 0;
+	case WM_CATALOG_CLIENT:
+		StartCatalogDetails();
+		return 0;
+	case WM_CATALOG_DETAILS_READY:
+		HandleCatalogDetailsReady();
+		return 0;
+	case WM_DESTROY:
+		// Children are still alive here, so the scroll position is readable.
+		SaveSession();
+		break;
 	}
 	return DefWindowProc(hwnd, message, wparam, lparam);
 }
@@ -1616,11 +6741,56 @@ EXTERN_C __declspec(dllexport) bool InitializePlugin(DWORD)
 	return SUCCEEDED(InitializeGraphics());
 }
 
+//---------------------------------------------------------------------
+//	Font catalog API (see FontCatalogApi.h)
+//---------------------------------------------------------------------
+EXTERN_C __declspec(dllexport) const FONT_CATALOG_API *GetFontCatalogApi(int version)
+{
+	return CatalogApi::GetApi(version);
+}
+
 //---------------------------------------------------------------------
 //	Plugin DLL cleanup
 //---------------------------------------------------------------------
 EXTERN_C __declspec(dllexport) void UninitializePlugin()
 {
+	StopFontEnumeration();
+	if (!g_sessionSaved)
+		SaveSession();
+	CatalogApi::Global().Shutdown();
+	g_catalogDetails.Stop();
+	g_backgroundTasks.Shutdown();
+	StopAxisSweep(L"shutdown");
+	LogPreviewPrefetchStats(L"shutdown");
+	LogPreviewBitmapStats(L"shutdown");
+	LogMemoryBudget(L"shutdown");
+	LogRepaintCounters(L"shutdown");
+	LogVisibility(L"shutdown");
+	LogSpecimenStats(L"shutdown");
+	LogCompareStats(L"shutdown");
+	LogGlyphStats(L"shutdown");
+	LogAutoFitStats(L"shutdown");
+	g_dirty.Discard();
+	if (g_hwndMain)
+		KillTimer(g_hwndMain, kOcclusionProbeTimerId);
+	if (Trace::IsEnabled())
+		LogTraceSummary();
+	g_previewLayouts.Clear();
+	g_previewBitmaps.Clear();
+	g_previewTextBrush.Reset();
+	g_specimenLayouts.Clear();
+	g_specimenLabelFormat.Reset();
+	g_specimenLabelBrush.Reset();
+	g_compareSlots.clear();
+	g_compareHint.Reset();
+	ResetGlyphAtlas();
+	g_glyphTable = GlyphTable{};
+	g_systemFontCollection.Reset();
+	g_externalFontCollections.Clear();
+	if (g_dwriteFactory && g_mappedFontLoaderRegistered)
+		g_dwriteFactory->UnregisterFontFileLoader(&g_mappedFontLoader);
+	g_mappedFontLoaderRegistered = false;
+	ResetMappedFontFiles();
 	g_dwriteFactory.Reset();
 	g_d2dTarget.Reset();
 	g_d2dContext.Reset();
@@ -1672,13 +6842,23 @@ EXTERN_C __declspec(dllexport) void RegisterPlugin(HOST_APP_TABLE *host)
 		}
 	}
 
+	// The first frame shows the last session's view; the catalog arrives
+	// from the enumeration thread (WM_FONT_CATALOG_READY).
+	LoadSession();
 	CreateControls(hwnd);
 
-	EnumerateFonts();
+	g_hwndMain = hwnd;
+	RegisterMemoryClients();
+	g_backgroundTasks.Start(2);
+	CatalogApi::Global().SetClientCallback([hwnd]
+										   { PostMessageW(hwnd, WM_CATALOG_CLIENT, 0, 0); });
+	ShowSessionSnapshot();
+	StartFontEnumeration();
 	ApplyFilter();
 	RebuildListViewItems();
 	UpdateDetailPanel();
 	UpdateLayout(hwnd);
+	ScrollListToRow((int)g_session.topRow);
 	RenderPreview(L"RegisterPlugin init");
 	ShowWindow(hwnd, SW_SHOW);
 	UpdateWindow(hwnd);
@@ -0,0 +1,316 @@
+//----------------------------------------------------------------------------------
+//	Font folder scanning without DirectWrite (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cctype>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "FontHash.h"
+#include "FontPreviewCore.h"
+#include "SfntReader.h"
+#include "Woff.h"
+#include "ZipIndex.h"
+
+// Lists the faces of every TTF/OTF/TTC file under a folder the way the
+// plugin lists its Fonts folder: one entry per face, named
+// "<family> [<file name>]", with the file's content hash. Fonts stored
+// uncompressed in .zip packs are listed too, as "<pack>|<entry>" paths
+// (see ZipIndex.h), and WOFF files are decoded in memory (see Woff.h);
+// WOFF2 needs the platform decoder and is only counted. Files are visited in sorted path order so the catalog
+// (and every index into it) is the same on every run and platform. Used by
+// FontPreviewCli and the replay benchmark's `load dir`.
+namespace FontScan
+{
+	struct Face
+	{
+		std::wstring filePath; // as scanned, absolute when the folder was; ArchiveMemberPath for packs
+		std::wstring fileName; // "<pack>.zip/<entry>" for packs
+		SfntReader::FaceInfo info;
+		uint64_t contentHash = 0;
+		size_t fileBytes = 0;
+	};
+
+	struct Stats
+	{
+		size_t files = 0;			// font files and packs found
+		size_t faces = 0;			// faces reported
+		size_t unreadable = 0;		// files that could not be opened or parsed
+		size_t bytes = 0;			// bytes read
+		size_t archives = 0;		// of `files`, .zip packs
+		size_t packedFonts = 0;		// font entries served from packs
+		size_t compressedFonts = 0; // font entries skipped for needing inflation
+		size_t webFonts = 0;		// of `files`, WOFF files decoded
+		size_t woff2Fonts = 0;		// of `files`, WOFF2 files skipped
+		size_t fvarTables = 0;		// of `faces`, variable faces whose axes were read
+	};
+
+	// Separates a pack's path from the entry inside it. Not valid in
+	// Windows file names, so a member path never names a real file.
+	constexpr wchar_t kArchiveSeparator = L'|';
+
+	inline std::wstring ArchiveMemberPath(const std::wstring &archivePath, const std::wstring &entryName)
+	{
+		return archivePath + kArchiveSeparator + entryName;
+	}
+
+	inline bool IsArchiveMemberPath(const std::wstring &path)
+	{
+		return path.find(kArchiveSeparator) != std::wstring::npos;
+	}
+
+	// Splits a member path; false for plain file paths.
+	inline bool SplitArchiveMemberPath(const std::wstring &path, std::wstring &archivePath, std::wstring &entryName)
+	{
+		size_t bar = path.find(kArchiveSeparator);
+		if (bar == std::wstring::npos)
+			return false;
+		archivePath = path.substr(0, bar);
+		entryName = path.substr(bar + 1);
+		return true;
+	}
+
+	inline std::string LowerExtension(const std::filesystem::path &path)
+	{
+		std::string ext = path.extension().string();
+		std::transform(ext.begin(), ext.end(), ext.begin(), [](char c)
+					   { return (char)std::tolower((unsigned char)c); });
+		return ext;
+	}
+
+	inline bool IsFontFile(const std::filesystem::path &path)
+	{
+		std::string ext = LowerExtension(path);
+		return ext == ".ttf" || ext == ".otf" || ext == ".ttc";
+	}
+
+	inline bool IsArchiveFile(const std::filesystem::path &path)
+	{
+		return LowerExtension(path) == ".zip";
+	}
+
+	inline bool IsWebFontFile(const std::filesystem::path &path)
+	{
+		std::string ext = LowerExtension(path);
+		return ext == ".woff" || ext == ".woff2";
+	}
+
+	// Other entry names are in the creating system's code page, which is
+	// unknown here; bytes map to U+0000..U+00FF so the name still
+	// round-trips. The plugin decodes those with the OEM code page, as
+	// Explorer does.
+	inline std::wstring DecodeEntryName(const ZipIndex::Entry &e)
+	{
+		if (e.utf8 || ZipIndex::IsValidUtf8(e.name))
+			return FontPreviewCore::FromUtf8(e.name);
+		std::wstring out;
+		out.reserve(e.name.size());
+		for (char c : e.name)
+			out.push_back((wchar_t)(uint8_t)c);
+		return out;
+	}
+
+	// Paths are UTF-8 outside Windows; path::wstring() would go through the
+	// C locale there and throw on anything non-ASCII.
+	inline std::wstring WidePath(const std::filesystem::path &path)
+	{
+#ifdef _WIN32
+		return path.wstring();
+#else
+		return FontPreviewCore::FromUtf8(path.string());
+#endif
+	}
+
+	// The plugin's display name for a Fonts-folder face.
+	inline std::wstring DisplayName(const std::wstring &familyName, const std::wstring &fileName)
+	{
+		return familyName + L" [" + fileName + L"]";
+	}
+
+	// Calls `onFace(const Face &)` for every readable face under `dir`
+	// (recursively when asked). Returns false when `dir` cannot be listed.
+	// Without `readAxes` the faces come without variation axes; resolve
+	// them per face with ReadFaceAxes when they are needed.
+	template <typename Fn>
+	bool ScanDirectory(const std::filesystem::path &dir, bool recursive, Fn &&onFace, Stats *stats = nullptr, bool readAxes = true)
+	{
+		std::error_code ec;
+		std::vector<std::filesystem::path> files;
+		auto collect = [&](const std::filesystem::directory_entry &entry)
+		{
+			if (entry.is_regular_file(ec) && (IsFontFile(entry.path()) || IsArchiveFile(entry.path()) || IsWebFontFile(entry.path())))
+				files.push_back(entry.path());
+		};
+		if (recursive)
+		{
+			std::filesystem::recursive_directory_iterator it(dir, ec), end;
+			if (ec)
+				return false;
+			for (; it != end; it.increment(ec))
+			{
+				if (ec)
+					break;
+				collect(*it);
+			}
+		}
+		else
+		{
+			std::filesystem::directory_iterator it(dir, ec), end;
+			if (ec)
+				return false;
+			for (; it != end; it.increment(ec))
+			{
+				if (ec)
+					break;
+				collect(*it);
+			}
+		}
+		std::sort(files.begin(), files.end());
+
+		Stats local;
+		Stats &s = stats ? *stats : local;
+		std::vector<uint8_t> bytes;
+		std::vector<SfntReader::FaceInfo> faces;
+		std::vector<ZipIndex::Entry> entries;
+		std::vector<uint8_t> decoded;
+		Face face;
+		auto report = [&]()
+		{
+			for (auto &info : faces)
+			{
+				face.info = std::move(info);
+				s.faces++;
+				if (!face.info.axes.empty())
+					s.fvarTables++;
+				onFace(static_cast<const Face &>(face));
+			}
+		};
+		for (const auto &path : files)
+		{
+			s.files++;
+			std::ifstream in(path, std::ios::binary | std::ios::ate);
+			std::streamoff size = in ? (std::streamoff)in.tellg() : -1;
+			bytes.resize(size > 0 ? (size_t)size : 0);
+			in.seekg(0);
+			if (size <= 0 || !in.read((char *)bytes.data(), (std::streamsize)bytes.size()))
+			{
+				s.unreadable++;
+				continue;
+			}
+			s.bytes += bytes.size();
+			std::wstring widePath = WidePath(path);
+			std::wstring fileName = WidePath(path.filename());
+			if (!IsArchiveFile(path))
+			{
+				// Web fonts are listed and hashed as the sfnt they decode to,
+				// as the plugin lists its decoded copy.
+				const std::vector<uint8_t> *sfnt = &bytes;
+				Woff::Container container = Woff::Detect(bytes.data(), bytes.size());
+				if (container == Woff::Container::Woff2)
+				{
+					s.woff2Fonts++;
+					continue;
+				}
+				if (container == Woff::Container::Woff)
+				{
+					if (!Woff::DecodeToBuffer(bytes.data(), bytes.size(), decoded))
+					{
+						s.unreadable++;
+						continue;
+					}
+					s.webFonts++;
+					sfnt = &decoded;
+				}
+				if (!SfntReader::ReadFaces(sfnt->data(), sfnt->size(), faces, readAxes))
+				{
+					s.unreadable++;
+					continue;
+				}
+				face.filePath = widePath;
+				face.fileName = fileName;
+				face.contentHash = FontHash::Hash64(sfnt->data(), sfnt->size());
+				face.fileBytes = sfnt->size();
+				report();
+				continue;
+			}
+
+			s.archives++;
+			if (!ZipIndex::Read(bytes.data(), bytes.size(), entries))
+			{
+				s.unreadable++;
+				continue;
+			}
+			for (const auto &e : entries)
+			{
+				if (!ZipIndex::IsServableFont(e))
+				{
+					if (e.method != ZipIndex::kStored && ZipIndex::IsFontEntry(e))
+						s.compressedFonts++;
+					continue;
+				}
+				const uint8_t *member = bytes.data() + e.dataOffset;
+				if (!SfntReader::ReadFaces(member, (size_t)e.size, faces, readAxes))
+					continue;
+				std::wstring entryName = DecodeEntryName(e);
+				s.packedFonts++;
+				face.filePath = ArchiveMemberPath(widePath, entryName);
+				face.fileName = fileName + L"/" + entryName;
+				face.contentHash = FontHash::Hash64(member, (size_t)e.size);
+				face.fileBytes = (size_t)e.size;
+				report();
+			}
+		}
+		return true;
+	}
+
+	// Reads the sfnt behind a scanned face's `filePath`: the file itself,
+	// its decoded WOFF or the stored member of a pack.
+	inline bool ReadFontBytes(const std::wstring &filePath, std::vector<uint8_t> &out)
+	{
+		std::wstring archivePath, entryName;
+		bool member = SplitArchiveMemberPath(filePath, archivePath, entryName);
+		const std::wstring &file = member ? archivePath : filePath;
+#ifdef _WIN32
+		std::ifstream in(std::filesystem::path(file), std::ios::binary);
+#else
+		std::ifstream in(FontPreviewCore::ToUtf8(file), std::ios::binary);
+#endif
+		if (!in)
+			return false;
+		std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		if (member)
+		{
+			std::vector<ZipIndex::Entry> entries;
+			if (!ZipIndex::Read(bytes.data(), bytes.size(), entries))
+				return false;
+			for (const auto &e : entries)
+			{
+				if (ZipIndex::IsServableFont(e) && DecodeEntryName(e) == entryName)
+				{
+					out.assign(bytes.begin() + (size_t)e.dataOffset, bytes.begin() + (size_t)(e.dataOffset + e.size));
+					return true;
+				}
+			}
+			return false;
+		}
+		if (Woff::Detect(bytes.data(), bytes.size()) == Woff::Container::Woff)
+			return Woff::DecodeToBuffer(bytes.data(), bytes.size(), out);
+		out = std::move(bytes);
+		return true;
+	}
+
+	// Lazy axis resolution for a face listed with `readAxes` off: opens its
+	// file and reads that face's `fvar` only.
+	inline bool ReadFaceAxes(const std::wstring &filePath, uint32_t faceIndex, SfntReader::FaceInfo &out)
+	{
+		std::vector<uint8_t> bytes;
+		return ReadFontBytes(filePath, bytes) && SfntReader::ReadFaceAxes(bytes.data(), bytes.size(), faceIndex, out);
+	}
+}
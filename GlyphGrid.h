@@ -0,0 +1,557 @@
+//----------------------------------------------------------------------------------
+//	Glyph browser: cmap index, Unicode blocks, grid geometry, atlas slots (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// The glyph browser lists every codepoint a font's cmap maps to a glyph.
+// A CJK font maps tens of thousands, so nothing here is per codepoint: the
+// cmap becomes a handful of ranges (CodepointIndex), the grid only ever
+// asks for the cells between two indices, and rasterized cells live in a
+// fixed number of atlas slots (AtlasSlots) that are reused as the view
+// scrolls. Memory therefore depends on the cmap's segment count and the
+// atlas size, not on the glyph count.
+namespace GlyphGrid
+{
+	constexpr uint32_t kMaxCodepoint = 0x10FFFF;
+
+	//---------------------------------------------------------------------
+	//	Codepoint index
+	//---------------------------------------------------------------------
+	struct Range
+	{
+		uint32_t first = 0;
+		uint32_t last = 0;	// inclusive
+		uint32_t index = 0; // position of `first` in the mapped sequence
+	};
+
+	class CodepointIndex
+	{
+	public:
+		// Sorts and merges overlapping or adjacent [first, last] pairs.
+		void Assign(std::vector<std::pair<uint32_t, uint32_t>> pairs)
+		{
+			m_ranges.clear();
+			m_count = 0;
+			std::sort(pairs.begin(), pairs.end());
+			for (const auto &p : pairs)
+			{
+				if (p.first > p.second || p.first > kMaxCodepoint)
+					continue;
+				uint32_t last = (std::min)(p.second, kMaxCodepoint);
+				if (!m_ranges.empty() && p.first <= m_ranges.back().last + 1)
+				{
+					m_ranges.back().last = (std::max)(m_ranges.back().last, last);
+					continue;
+				}
+				Range r;
+				r.first = p.first;
+				r.last = last;
+				m_ranges.push_back(r);
+			}
+			for (Range &r : m_ranges)
+			{
+				r.index = m_count;
+				m_count += r.last - r.first + 1;
+			}
+			m_ranges.shrink_to_fit();
+		}
+
+		uint32_t Count() const { return m_count; }
+		const std::vector<Range> &Ranges() const { return m_ranges; }
+		size_t Bytes() const { return m_ranges.capacity() * sizeof(Range); }
+
+		// `i` must be < Count().
+		uint32_t CodepointAt(uint32_t i) const
+		{
+			auto it = std::upper_bound(m_ranges.begin(), m_ranges.end(), i, [](uint32_t v, const Range &r)
+									   { return v < r.index; });
+			const Range &r = *(it - 1);
+			return r.first + (i - r.index);
+		}
+
+		// Index of the first mapped codepoint >= cp; Count() when none.
+		uint32_t LowerBound(uint32_t cp) const
+		{
+			auto it = std::lower_bound(m_ranges.begin(), m_ranges.end(), cp, [](const Range &r, uint32_t v)
+									   { return r.last < v; });
+			if (it == m_ranges.end())
+				return m_count;
+			return cp <= it->first ? it->index : it->index + (cp - it->first);
+		}
+
+		bool Contains(uint32_t cp) const
+		{
+			uint32_t i = LowerBound(cp);
+			return i < m_count && CodepointAt(i) == cp;
+		}
+
+	private:
+		std::vector<Range> m_ranges;
+		uint32_t m_count = 0;
+	};
+
+	//---------------------------------------------------------------------
+	//	cmap
+	//---------------------------------------------------------------------
+	namespace detail
+	{
+		inline uint16_t U16(const uint8_t *p) { return (uint16_t)((p[0] << 8) | p[1]); }
+		inline uint32_t U32(const uint8_t *p) { return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3]; }
+
+		// Add [first, last] split around codepoints that map to glyph 0.
+		struct RunBuilder
+		{
+			std::vector<std::pair<uint32_t, uint32_t>> &out;
+			bool open = false;
+			uint32_t first = 0;
+			uint32_t last = 0;
+
+			void Add(uint32_t cp, bool mapped)
+			{
+				if (mapped && open && cp == last + 1)
+				{
+					last = cp;
+					return;
+				}
+				Close();
+				if (mapped)
+				{
+					open = true;
+					first = last = cp;
+				}
+			}
+			void Close()
+			{
+				if (open)
+					out.emplace_back(first, last);
+				open = false;
+			}
+		};
+
+		inline bool ReadFormat4(const uint8_t *sub, size_t avail, std::vector<std::pair<uint32_t, uint32_t>> &out)
+		{
+			if (avail < 14)
+				return false;
+			uint32_t segCount = U16(sub + 6) / 2u;
+			size_t endCodes = 14, startCodes = 16 + 2 * (size_t)segCount, deltas = 16 + 4 * (size_t)segCount, rangeOffsets = 16 + 6 * (size_t)segCount;
+			if (rangeOffsets + 2 * (size_t)segCount > avail)
+				return false;
+			RunBuilder runs{out};
+			for (uint32_t s = 0; s < segCount; s++)
+			{
+				uint32_t end = U16(sub + endCodes + 2 * s);
+				uint32_t start = U16(sub + startCodes + 2 * s);
+				uint16_t delta = U16(sub + deltas + 2 * s);
+				uint16_t rangeOffset = U16(sub + rangeOffsets + 2 * s);
+				if (start > end)
+					continue;
+				// 0xFFFF closes the required final segment and maps nothing.
+				for (uint32_t c = start; c <= end && c != 0xFFFF; c++)
+				{
+					uint16_t glyph = 0;
+					if (rangeOffset == 0)
+					{
+						glyph = (uint16_t)(c + delta);
+					}
+					else
+					{
+						size_t at = rangeOffsets + 2 * (size_t)s + rangeOffset + 2 * (size_t)(c - start);
+						if (at + 2 > avail)
+							break;
+						glyph = U16(sub + at);
+						if (glyph != 0)
+							glyph = (uint16_t)(glyph + delta);
+					}
+					runs.Add(c, glyph != 0);
+				}
+				runs.Close();
+			}
+			return true;
+		}
+
+		inline bool ReadFormat12(const uint8_t *sub, size_t avail, std::vector<std::pair<uint32_t, uint32_t>> &out)
+		{
+			if (avail < 16)
+				return false;
+			uint32_t groups = U32(sub + 12);
+			if (groups > (avail - 16) / 12)
+				return false;
+			for (uint32_t g = 0; g < groups; g++)
+			{
+				const uint8_t *p = sub + 16 + 12 * (size_t)g;
+				uint32_t first = U32(p), last = U32(p + 4), glyph = U32(p + 8);
+				if (first > last || first > kMaxCodepoint)
+					continue;
+				if (glyph == 0) // only `first` maps to .notdef
+					first++;
+				if (first <= last)
+					out.emplace_back(first, (std::min)(last, kMaxCodepoint));
+			}
+			return true;
+		}
+	}
+
+	// Codepoints the best Unicode subtable maps to a real glyph: format 12
+	// (full Unicode), else format 4 (BMP), else a (3,0) symbol subtable.
+	// Returns false for tables it cannot read; malformed input is never
+	// trusted past the table bounds.
+	inline bool ReadCmap(const uint8_t *table, size_t size, std::vector<std::pair<uint32_t, uint32_t>> &out)
+	{
+		using namespace detail;
+		out.clear();
+		if (size < 4)
+			return false;
+		uint32_t numTables = U16(table + 2);
+		if (4 + 8 * (size_t)numTables > size)
+			return false;
+		int bestRank = 0;
+		size_t bestOffset = 0;
+		uint16_t bestFormat = 0;
+		for (uint32_t i = 0; i < numTables; i++)
+		{
+			const uint8_t *rec = table + 4 + 8 * (size_t)i;
+			uint16_t platform = U16(rec), encoding = U16(rec + 2);
+			uint32_t offset = U32(rec + 4);
+			if ((size_t)offset + 2 > size)
+				continue;
+			uint16_t format = U16(table + offset);
+			bool unicode = platform == 0 || (platform == 3 && (encoding == 1 || encoding == 10));
+			int rank = format == 12 && unicode ? 3 : format == 4 && unicode ? 2 : format == 4 && platform == 3 && encoding == 0 ? 1 : 0;
+			if (rank > bestRank)
+			{
+				bestRank = rank;
+				bestOffset = offset;
+				bestFormat = format;
+			}
+		}
+		if (bestRank == 0)
+			return false;
+		const uint8_t *sub = table + bestOffset;
+		size_t avail = size - bestOffset;
+		return bestFormat == 12 ? ReadFormat12(sub, avail, out) : ReadFormat4(sub, avail, out);
+	}
+
+	//---------------------------------------------------------------------
+	//	Unicode blocks
+	//---------------------------------------------------------------------
+	struct Block
+	{
+		uint32_t first;
+		uint32_t last;
+		const wchar_t *name;
+	};
+
+	// The blocks worth jumping to in Latin and CJK fonts; codepoints
+	// outside them are listed under "Other".
+	constexpr Block kBlocks[] = {
+		{0x0000, 0x007F, L"Basic Latin"},
+		{0x0080, 0x00FF, L"Latin-1 Supplement"},
+		{0x0100, 0x017F, L"Latin Extended-A"},
+		{0x0180, 0x024F, L"Latin Extended-B"},
+		{0x0250, 0x02AF, L"IPA Extensions"},
+		{0x02B0, 0x02FF, L"Spacing Modifier Letters"},
+		{0x0300, 0x036F, L"Combining Diacritical Marks"},
+		{0x0370, 0x03FF, L"Greek and Coptic"},
+		{0x0400, 0x04FF, L"Cyrillic"},
+		{0x0590, 0x05FF, L"Hebrew"},
+		{0x0600, 0x06FF, L"Arabic"},
+		{0x0900, 0x097F, L"Devanagari"},
+		{0x0E00, 0x0E7F, L"Thai"},
+		{0x10A0, 0x10FF, L"Georgian"},
+		{0x1100, 0x11FF, L"Hangul Jamo"},
+		{0x1E00, 0x1EFF, L"Latin Extended Additional"},
+		{0x1F00, 0x1FFF, L"Greek Extended"},
+		{0x2000, 0x206F, L"General Punctuation"},
+		{0x2070, 0x209F, L"Superscripts and Subscripts"},
+		{0x20A0, 0x20CF, L"Currency Symbols"},
+		{0x2100, 0x214F, L"Letterlike Symbols"},
+		{0x2150, 0x218F, L"Number Forms"},
+		{0x2190, 0x21FF, L"Arrows"},
+		{0x2200, 0x22FF, L"Mathematical Operators"},
+		{0x2300, 0x23FF, L"Miscellaneous Technical"},
+		{0x2460, 0x24FF, L"Enclosed Alphanumerics"},
+		{0x2500, 0x257F, L"Box Drawing"},
+		{0x2580, 0x259F, L"Block Elements"},
+		{0x25A0, 0x25FF, L"Geometric Shapes"},
+		{0x2600, 0x26FF, L"Miscellaneous Symbols"},
+		{0x2700, 0x27BF, L"Dingbats"},
+		{0x2E80, 0x2EFF, L"CJK Radicals Supplement"},
+		{0x2F00, 0x2FDF, L"Kangxi Radicals"},
+		{0x3000, 0x303F, L"CJK Symbols and Punctuation"},
+		{0x3040, 0x309F, L"Hiragana"},
+		{0x30A0, 0x30FF, L"Katakana"},
+		{0x3100, 0x312F, L"Bopomofo"},
+		{0x3130, 0x318F, L"Hangul Compatibility Jamo"},
+		{0x3190, 0x319F, L"Kanbun"},
+		{0x31F0, 0x31FF, L"Katakana Phonetic Extensions"},
+		{0x3200, 0x32FF, L"Enclosed CJK Letters and Months"},
+		{0x3300, 0x33FF, L"CJK Compatibility"},
+		{0x3400, 0x4DBF, L"CJK Unified Ideographs Extension A"},
+		{0x4DC0, 0x4DFF, L"Yijing Hexagram Symbols"},
+		{0x4E00, 0x9FFF, L"CJK Unified Ideographs"},
+		{0xA000, 0xA48F, L"Yi Syllables"},
+		{0xAC00, 0xD7AF, L"Hangul Syllables"},
+		{0xE000, 0xF8FF, L"Private Use Area"},
+		{0xF900, 0xFAFF, L"CJK Compatibility Ideographs"},
+		{0xFB00, 0xFB4F, L"Alphabetic Presentation Forms"},
+		{0xFB50, 0xFDFF, L"Arabic Presentation Forms-A"},
+		{0xFE00, 0xFE0F, L"Variation Selectors"},
+		{0xFE10, 0xFE1F, L"Vertical Forms"},
+		{0xFE30, 0xFE4F, L"CJK Compatibility Forms"},
+		{0xFE50, 0xFE6F, L"Small Form Variants"},
+		{0xFE70, 0xFEFF, L"Arabic Presentation Forms-B"},
+		{0xFF00, 0xFFEF, L"Halfwidth and Fullwidth Forms"},
+		{0xFFF0, 0xFFFF, L"Specials"},
+		{0x1F000, 0x1F02F, L"Mahjong Tiles"},
+		{0x1F100, 0x1F1FF, L"Enclosed Alphanumeric Supplement"},
+		{0x1F200, 0x1F2FF, L"Enclosed Ideographic Supplement"},
+		{0x1F300, 0x1F5FF, L"Miscellaneous Symbols and Pictographs"},
+		{0x1F600, 0x1F64F, L"Emoticons"},
+		{0x1F680, 0x1F6FF, L"Transport and Map Symbols"},
+		{0x1F900, 0x1F9FF, L"Supplemental Symbols and Pictographs"},
+		{0x20000, 0x2A6DF, L"CJK Unified Ideographs Extension B"},
+		{0x2A700, 0x2B73F, L"CJK Unified Ideographs Extension C"},
+		{0x2B740, 0x2B81F, L"CJK Unified Ideographs Extension D"},
+		{0x2B820, 0x2CEAF, L"CJK Unified Ideographs Extension E"},
+		{0x2CEB0, 0x2EBEF, L"CJK Unified Ideographs Extension F"},
+		{0x2F800, 0x2FA1F, L"CJK Compatibility Ideographs Supplement"},
+		{0x30000, 0x3134F, L"CJK Unified Ideographs Extension G"},
+		{0xE0100, 0xE01EF, L"Variation Selectors Supplement"},
+		{0xF0000, 0x10FFFF, L"Supplementary Private Use Area"},
+	};
+	constexpr int kBlockCount = (int)(sizeof(kBlocks) / sizeof(kBlocks[0]));
+
+	// Index into kBlocks, or -1 for "Other".
+	inline int FindBlock(uint32_t cp)
+	{
+		const Block *end = kBlocks + kBlockCount;
+		const Block *it = std::upper_bound(kBlocks, end, cp, [](uint32_t v, const Block &b)
+										   { return v < b.first; });
+		if (it == kBlocks)
+			return -1;
+		--it;
+		return cp <= it->last ? (int)(it - kBlocks) : -1;
+	}
+
+	// Blocks the font has glyphs in, with the index of their first glyph
+	// and how many there are. Costs two searches per block.
+	struct BlockEntry
+	{
+		int block = -1;
+		uint32_t firstIndex = 0;
+		uint32_t count = 0;
+	};
+
+	inline void ListBlocks(const CodepointIndex &index, std::vector<BlockEntry> &out)
+	{
+		out.clear();
+		for (int b = 0; b < kBlockCount; b++)
+		{
+			uint32_t from = index.LowerBound(kBlocks[b].first);
+			uint32_t to = index.LowerBound(kBlocks[b].last + 1);
+			if (to > from)
+				out.push_back(BlockEntry{b, from, to - from});
+		}
+	}
+
+	// Position in `blocks` (as listed by ListBlocks) of the entry holding
+	// glyph `index`, or -1 when the glyph is outside every listed block.
+	inline int FindBlockEntry(const std::vector<BlockEntry> &blocks, uint32_t index)
+	{
+		auto it = std::upper_bound(blocks.begin(), blocks.end(), index, [](uint32_t v, const BlockEntry &e)
+								   { return v < e.firstIndex; });
+		if (it == blocks.begin())
+			return -1;
+		--it;
+		return index < it->firstIndex + it->count ? (int)(it - blocks.begin()) : -1;
+	}
+
+	// Go-to input: "U+4E00", "0x4E00" or bare hex of two or more digits
+	// ("4e00") is a codepoint; a single character (or surrogate pair) is
+	// itself. Surrounding spaces are ignored.
+	inline bool ParseCodepoint(const wchar_t *s, size_t len, uint32_t &out)
+	{
+		while (len > 0 && (*s == L' ' || *s == L'\t'))
+			s++, len--;
+		while (len > 0 && (s[len - 1] == L' ' || s[len - 1] == L'\t'))
+			len--;
+		if (len == 0)
+			return false;
+		if (len == 1)
+		{
+			out = (uint32_t)s[0];
+			return out < 0xD800 || out > 0xDFFF;
+		}
+		if (len == 2 && s[0] >= 0xD800 && s[0] <= 0xDBFF && s[1] >= 0xDC00 && s[1] <= 0xDFFF)
+		{
+			out = 0x10000 + (((uint32_t)s[0] - 0xD800) << 10) + ((uint32_t)s[1] - 0xDC00);
+			return true;
+		}
+		if (((s[0] == L'U' || s[0] == L'u') && s[1] == L'+') || (s[0] == L'0' && (s[1] == L'x' || s[1] == L'X')))
+			s += 2, len -= 2;
+		if (len == 0 || len > 6)
+			return false;
+		uint32_t cp = 0;
+		for (size_t i = 0; i < len; i++)
+		{
+			wchar_t c = s[i];
+			uint32_t digit = c >= L'0' && c <= L'9' ? (uint32_t)(c - L'0') : c >= L'a' && c <= L'f' ? (uint32_t)(c - L'a' + 10) : c >= L'A' && c <= L'F' ? (uint32_t)(c - L'A' + 10) : 16u;
+			if (digit > 15)
+				return false;
+			cp = cp * 16 + digit;
+		}
+		if (cp > kMaxCodepoint)
+			return false;
+		out = cp;
+		return true;
+	}
+
+	//---------------------------------------------------------------------
+	//	Grid geometry
+	//---------------------------------------------------------------------
+	struct Layout
+	{
+		uint32_t count = 0;
+		int columns = 1;
+		uint32_t rows = 0;
+		float cell = 64.0f; // square cells, DIPs
+	};
+
+	inline Layout MakeLayout(uint32_t count, float width, float cell)
+	{
+		Layout l;
+		l.count = count;
+		l.cell = cell > 1.0f ? cell : 1.0f;
+		l.columns = (std::max)(1, (int)std::floor(width / l.cell));
+		l.rows = (count + (uint32_t)l.columns - 1) / (uint32_t)l.columns;
+		return l;
+	}
+
+	inline float ContentHeight(const Layout &l) { return (float)l.rows * l.cell; }
+
+	inline float ClampScroll(const Layout &l, float scroll, float viewHeight)
+	{
+		float maxScroll = (std::max)(0.0f, ContentHeight(l) - viewHeight);
+		return scroll < 0.0f ? 0.0f : scroll > maxScroll ? maxScroll : scroll;
+	}
+
+	// Cells of the rows intersecting [scroll, scroll + viewHeight), as
+	// indices [first, last).
+	inline void VisibleCells(const Layout &l, float scroll, float viewHeight, uint32_t &first, uint32_t &last)
+	{
+		uint32_t rowFirst = (uint32_t)(std::max)(0.0f, std::floor(scroll / l.cell));
+		uint32_t rowLast = (uint32_t)(std::max)(0.0f, std::ceil((scroll + viewHeight) / l.cell));
+		first = (std::min)(l.count, rowFirst * (uint32_t)l.columns);
+		last = (std::min)(l.count, rowLast * (uint32_t)l.columns);
+	}
+
+	// Scroll offset that puts the row of `index` at the top.
+	inline float ScrollForIndex(const Layout &l, uint32_t index)
+	{
+		return (float)(index / (uint32_t)l.columns) * l.cell;
+	}
+
+	// The page after [first, last) when scrolling down, the one before
+	// when scrolling up; empty at either end.
+	inline void AdjacentPage(const Layout &l, uint32_t first, uint32_t last, bool down, uint32_t &pageFirst, uint32_t &pageLast)
+	{
+		uint32_t span = last - first;
+		if (down)
+		{
+			pageFirst = last;
+			pageLast = (std::min)(l.count, last + span);
+		}
+		else
+		{
+			pageFirst = first > span ? first - span : 0;
+			pageLast = first;
+		}
+	}
+
+	//---------------------------------------------------------------------
+	//	Atlas slots
+	//---------------------------------------------------------------------
+	// Which codepoint each cell of a fixed-size atlas holds. A slot is
+	// stamped with the frame that last used it; Allocate reuses slots in
+	// clock order but never one stamped at or after `protectFrom`, so the
+	// cells on screen survive while the next page is rasterized.
+	class AtlasSlots
+	{
+	public:
+		static constexpr uint32_t kEmpty = 0xFFFFFFFFu;
+
+		struct Stats
+		{
+			uint64_t hits = 0;
+			uint64_t fills = 0;
+			uint64_t evictions = 0;
+			uint64_t full = 0; // Allocate found every slot protected
+		};
+
+		void Reset(int capacity)
+		{
+			m_codepoints.assign(capacity > 0 ? (size_t)capacity : 0, kEmpty);
+			m_stamps.assign(m_codepoints.size(), 0);
+			m_lookup.clear();
+			m_lookup.reserve(m_codepoints.size());
+			m_hand = 0;
+		}
+
+		int Capacity() const { return (int)m_codepoints.size(); }
+		size_t Used() const { return m_lookup.size(); }
+		const Stats &GetStats() const { return m_stats; }
+		void ResetStats() { m_stats = Stats{}; }
+
+		// Slot holding `cp` (restamped with `frame`), or -1.
+		int Find(uint32_t cp, uint64_t frame)
+		{
+			auto it = m_lookup.find(cp);
+			if (it == m_lookup.end())
+				return -1;
+			m_stamps[(size_t)it->second] = (std::max)(m_stamps[(size_t)it->second], frame);
+			m_stats.hits++;
+			return it->second;
+		}
+
+		bool Contains(uint32_t cp) const { return m_lookup.count(cp) != 0; }
+
+		// Claim a slot for `cp`; -1 when every slot is protected.
+		int Allocate(uint32_t cp, uint64_t frame, uint64_t protectFrom)
+		{
+			size_t n = m_codepoints.size();
+			for (size_t step = 0; step < n; step++)
+			{
+				size_t slot = m_hand;
+				m_hand = (m_hand + 1) % n;
+				if (m_codepoints[slot] != kEmpty && m_stamps[slot] >= protectFrom)
+					continue;
+				if (m_codepoints[slot] != kEmpty)
+				{
+					m_lookup.erase(m_codepoints[slot]);
+					m_stats.evictions++;
+				}
+				m_codepoints[slot] = cp;
+				m_stamps[slot] = frame;
+				m_lookup[cp] = (int)slot;
+				m_stats.fills++;
+				return (int)slot;
+			}
+			m_stats.full++;
+			return -1;
+		}
+
+	private:
+		std::vector<uint32_t> m_codepoints;
+		std::vector<uint64_t> m_stamps;
+		std::unordered_map<uint32_t, int> m_lookup;
+		size_t m_hand = 0;
+		Stats m_stats;
+	};
+}
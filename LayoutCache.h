@@ -0,0 +1,146 @@
+//----------------------------------------------------------------------------------
+//	Index-keyed layout cache with build generations (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "LruCache.h"
+
+// Preview layouts are keyed by catalog position (font index, face index),
+// so they are only valid for the catalog, sample text and layout box they
+// were built with. They are built on worker threads: a job records
+// Generation() when it is queued, and Store drops its result when Sync
+// changed anything meanwhile.
+//
+// Sync must see a new catalog as soon as it is installed, before anything
+// queues layout work for it. Otherwise jobs queued for the new catalog
+// carry the old generation (their results are dropped at the next Sync),
+// and Contains can match a layout of the previous catalog that happens to
+// sit at the same index.
+namespace LayoutCache
+{
+	inline uint64_t Key(int fontIndex, int faceIndex)
+	{
+		return ((uint64_t)(uint32_t)fontIndex << 32) | (uint32_t)(faceIndex + 1);
+	}
+
+	template <typename Entry>
+	class Cache
+	{
+	public:
+		using Stats = typename LruCache<uint64_t, Entry>::Stats;
+
+		explicit Cache(size_t capacityBytes) : m_entries(capacityBytes) {}
+
+		// UI thread: the parameters new jobs are built with.
+		const std::wstring &Text() const { return m_text; }
+		float Width() const { return m_width; }
+		float Height() const { return m_height; }
+
+		// UI thread. When the text, box or catalog changed, drops every
+		// layout, advances the generation and returns true.
+		bool Sync(const std::wstring &text, float width, float height, uint32_t catalog)
+		{
+			if (text == m_text && width == m_width && height == m_height && catalog == m_catalog)
+				return false;
+			m_text = text;
+			m_width = width;
+			m_height = height;
+			m_catalog = catalog;
+			Invalidate();
+			return true;
+		}
+
+		// Drop every layout, including ones still being built (a setting
+		// that changes all layouts changed).
+		void Invalidate()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_generation++;
+			m_entries.Clear();
+		}
+
+		uint32_t Generation() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_generation;
+		}
+
+		// Any thread. Returns false (and keeps nothing) when `generation` is
+		// stale. `onStored` runs under the lock, for counters kept with it.
+		template <typename Fn>
+		bool Store(uint32_t generation, uint64_t key, Entry entry, size_t bytes, Fn &&onStored)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (generation != m_generation || !m_entries.Put(key, std::move(entry), bytes))
+				return false;
+			onStored();
+			return true;
+		}
+
+		bool Store(uint32_t generation, uint64_t key, Entry entry, size_t bytes)
+		{
+			return Store(generation, key, std::move(entry), bytes, [] {});
+		}
+
+		// Lookup without touching recency or hit counters.
+		bool Contains(uint64_t key) const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_entries.Contains(key);
+		}
+
+		// Calls `fn(Entry &)` under the lock on a hit; counts the lookup.
+		template <typename Fn>
+		bool Find(uint64_t key, Fn &&fn)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			Entry *entry = m_entries.Get(key);
+			if (!entry)
+				return false;
+			fn(*entry);
+			return true;
+		}
+
+		// Calls `fn(const Stats &)` under the lock, so counters kept with
+		// the cache can be read consistently.
+		template <typename Fn>
+		void Inspect(Fn &&fn) const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			fn(m_entries.GetStats());
+		}
+
+		size_t Bytes() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_entries.Bytes();
+		}
+
+		size_t Trim(size_t bytes)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_entries.Trim(bytes);
+		}
+
+		void Clear()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_entries.Clear();
+		}
+
+	private:
+		mutable std::mutex m_mutex;
+		LruCache<uint64_t, Entry> m_entries;
+		uint32_t m_generation = 0;
+		// UI thread only.
+		std::wstring m_text;
+		float m_width = 0.0f;
+		float m_height = 0.0f;
+		uint32_t m_catalog = 0;
+	};
+}
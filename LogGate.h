@@ -0,0 +1,220 @@
+//----------------------------------------------------------------------------------
+//	Gated logging (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstdarg>
+#include <cwchar>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// Verbose sites compile to nothing when this is 0. The default keeps them
+// in Debug builds only; define FONTPREVIEW_LOG_VERBOSE=1 to keep them in
+// Release as well.
+#ifndef FONTPREVIEW_LOG_VERBOSE
+#if defined(_DEBUG)
+#define FONTPREVIEW_LOG_VERBOSE 1
+#else
+#define FONTPREVIEW_LOG_VERBOSE 0
+#endif
+#endif
+
+// The host logger (LOG_HANDLE) has no way to ask whether a level is shown,
+// so every call used to pay for swprintf_s / wstring concatenation up front.
+// LogGate keeps its own level and category mask and the FP_LOG* macros test
+// them before any argument is evaluated.
+namespace LogGate
+{
+	enum class Level : int
+	{
+		Error = 0,
+		Warn = 1,
+		Info = 2,
+		Verbose = 3
+	};
+
+	enum Category : uint32_t
+	{
+		kCatGeneral = 1u << 0,
+		kCatEnum = 1u << 1,
+		kCatFilter = 1u << 2,
+		kCatList = 1u << 3,
+		kCatRender = 1u << 4,
+		kCatTask = 1u << 5,
+		kCatEdit = 1u << 6,
+		kCatAll = 0xFFFFFFFFu
+	};
+
+	struct State
+	{
+		std::atomic<int> level{(int)(FONTPREVIEW_LOG_VERBOSE ? Level::Verbose : Level::Info)};
+		std::atomic<uint32_t> categories{kCatAll};
+	};
+
+	inline State &GetState()
+	{
+		static State state;
+		return state;
+	}
+
+	inline void SetLevel(Level level) { GetState().level.store((int)level, std::memory_order_relaxed); }
+	inline Level GetLevel() { return (Level)GetState().level.load(std::memory_order_relaxed); }
+	inline void SetCategories(uint32_t mask) { GetState().categories.store(mask, std::memory_order_relaxed); }
+
+	// Two relaxed loads; this is all a disabled site costs.
+	inline bool Enabled(Level level, uint32_t category)
+	{
+		const State &s = GetState();
+		return (int)level <= s.level.load(std::memory_order_relaxed) &&
+			   (category & s.categories.load(std::memory_order_relaxed)) != 0;
+	}
+
+	// Route a finished message to the matching LOG_HANDLE entry point. The
+	// handle type is a template parameter so this header stays SDK-free.
+	template <typename Handle>
+	inline void Write(Handle *handle, Level level, const wchar_t *message)
+	{
+		if (!handle)
+			return;
+		switch (level)
+		{
+		case Level::Error:
+			handle->error(handle, message);
+			break;
+		case Level::Warn:
+			handle->warn(handle, message);
+			break;
+		case Level::Info:
+			handle->info(handle, message);
+			break;
+		default:
+			handle->verbose(handle, message);
+			break;
+		}
+	}
+
+	template <typename Handle>
+	inline void WriteFormat(Handle *handle, Level level, const wchar_t *fmt, ...)
+	{
+		wchar_t buf[512];
+		va_list args;
+		va_start(args, fmt);
+		int n = std::vswprintf(buf, sizeof(buf) / sizeof(buf[0]), fmt, args);
+		va_end(args);
+		if (n < 0)
+			buf[sizeof(buf) / sizeof(buf[0]) - 1] = L'\0';
+		Write(handle, level, buf);
+	}
+
+	// `make` returns std::wstring; it only runs when the site is enabled.
+	template <typename Handle, typename Fn>
+	inline void WriteLazy(Handle *handle, Level level, Fn &&make)
+	{
+		std::wstring message = make();
+		Write(handle, level, message.c_str());
+	}
+
+	// Per-site limiter for per-frame / per-event messages. Allows one
+	// message per interval and reports how many were swallowed meanwhile.
+	class RateLimiter
+	{
+	public:
+		explicit RateLimiter(uint32_t intervalMs) : m_intervalMs(intervalMs) {}
+
+		bool Allow(uint32_t &outSuppressed)
+		{
+			int64_t now = NowMs();
+			int64_t last = m_lastMs.load(std::memory_order_relaxed);
+			if (last != 0 && now - last < (int64_t)m_intervalMs)
+			{
+				m_suppressed.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			if (!m_lastMs.compare_exchange_strong(last, now, std::memory_order_relaxed))
+			{
+				m_suppressed.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			outSuppressed = m_suppressed.exchange(0, std::memory_order_relaxed);
+			return true;
+		}
+
+	private:
+		static int64_t NowMs()
+		{
+			using namespace std::chrono;
+			return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count() + 1;
+		}
+
+		uint32_t m_intervalMs;
+		std::atomic<int64_t> m_lastMs{0};
+		std::atomic<uint32_t> m_suppressed{0};
+	};
+
+	template <typename Handle>
+	inline void WriteRateLimitedFormat(Handle *handle, Level level, uint32_t suppressed, const wchar_t *fmt, ...)
+	{
+		wchar_t buf[512];
+		va_list args;
+		va_start(args, fmt);
+		int n = std::vswprintf(buf, sizeof(buf) / sizeof(buf[0]), fmt, args);
+		va_end(args);
+		if (n < 0)
+		{
+			buf[sizeof(buf) / sizeof(buf[0]) - 1] = L'\0';
+			n = (int)std::wcslen(buf);
+		}
+		if (suppressed > 0 && n >= 0 && (size_t)n < sizeof(buf) / sizeof(buf[0]))
+			std::swprintf(buf + n, sizeof(buf) / sizeof(buf[0]) - n, L" (+%u suppressed)", suppressed);
+		Write(handle, level, buf);
+	}
+}
+
+// printf-style sites. Arguments are not evaluated when the site is off.
+#define FP_LOG(handle, level, category, ...)                                                       \
+	do                                                                                              \
+	{                                                                                               \
+		if ((handle) && LogGate::Enabled(LogGate::Level::level, LogGate::category))                  \
+			LogGate::WriteFormat((handle), LogGate::Level::level, __VA_ARGS__);                       \
+	} while (0)
+
+// Sites that build a std::wstring: pass a lambda returning the message.
+#define FP_LOG_LAZY(handle, level, category, make)                                                 \
+	do                                                                                              \
+	{                                                                                               \
+		if ((handle) && LogGate::Enabled(LogGate::Level::level, LogGate::category))                  \
+			LogGate::WriteLazy((handle), LogGate::Level::level, make);                                \
+	} while (0)
+
+// Per-frame sites: at most one message per `intervalMs` per call site.
+#define FP_LOG_RATE(handle, level, category, intervalMs, ...)                                      \
+	do                                                                                              \
+	{                                                                                               \
+		if ((handle) && LogGate::Enabled(LogGate::Level::level, LogGate::category))                  \
+		{                                                                                           \
+			static LogGate::RateLimiter fpRateLimiter_(intervalMs);                                 \
+			uint32_t fpSuppressed_ = 0;                                                             \
+			if (fpRateLimiter_.Allow(fpSuppressed_))                                                \
+				LogGate::WriteRateLimitedFormat((handle), LogGate::Level::level, fpSuppressed_, __VA_ARGS__); \
+		}                                                                                           \
+	} while (0)
+
+#if FONTPREVIEW_LOG_VERBOSE
+#define FP_LOG_VERBOSE(handle, category, ...) FP_LOG(handle, Verbose, category, __VA_ARGS__)
+#define FP_LOG_VERBOSE_LAZY(handle, category, make) FP_LOG_LAZY(handle, Verbose, category, make)
+#define FP_LOG_VERBOSE_RATE(handle, category, intervalMs, ...) FP_LOG_RATE(handle, Verbose, category, intervalMs, __VA_ARGS__)
+#else
+#define FP_LOG_VERBOSE(handle, category, ...) \
+	do                                        \
+	{                                         \
+	} while (0)
+#define FP_LOG_VERBOSE_LAZY(handle, category, make) \
+	do                                              \
+	{                                               \
+	} while (0)
+#define FP_LOG_VERBOSE_RATE(handle, category, intervalMs, ...) \
+	do                                                         \
+	{                                                          \
+	} while (0)
+#endif
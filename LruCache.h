@@ -0,0 +1,185 @@
+//----------------------------------------------------------------------------------
+//	Byte-capped LRU cache (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
+// Least-recently-used map whose capacity is expressed in bytes. Each entry
+// carries a caller-supplied size estimate; inserting past the cap evicts
+// from the cold end. Not thread-safe: callers that share an instance across
+// threads guard it with their own mutex.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache
+{
+public:
+	struct Stats
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t inserts = 0;
+		uint64_t evictions = 0;
+		size_t entries = 0;
+		size_t bytes = 0;
+		size_t capacityBytes = 0;
+
+		double HitRate() const
+		{
+			uint64_t total = hits + misses;
+			return total ? (double)hits / (double)total : 0.0;
+		}
+	};
+
+	explicit LruCache(size_t capacityBytes = 0) : m_capacityBytes(capacityBytes) {}
+
+	void SetCapacity(size_t capacityBytes)
+	{
+		m_capacityBytes = capacityBytes;
+		EvictToFit(0);
+	}
+
+	// Returns nullptr on miss. A hit moves the entry to the hot end.
+	Value *Get(const Key &key)
+	{
+		auto it = m_index.find(key);
+		if (it == m_index.end())
+		{
+			m_misses++;
+			return nullptr;
+		}
+		m_hits++;
+		m_order.splice(m_order.begin(), m_order, it->second);
+		return std::addressof(it->second->value);
+	}
+
+	// Lookup without touching recency or hit counters.
+	bool Contains(const Key &key) const { return m_index.find(key) != m_index.end(); }
+
+	// Insert or replace. Entries larger than the whole cap are not stored.
+	bool Put(const Key &key, Value value, size_t bytes)
+	{
+		Erase(key);
+		if (m_capacityBytes != 0 && bytes > m_capacityBytes)
+			return false;
+		EvictToFit(bytes);
+		m_order.push_front(Node{key, std::move(value), bytes});
+		m_index[key] = m_order.begin();
+		m_bytes += bytes;
+		m_inserts++;
+		return true;
+	}
+
+	bool Erase(const Key &key)
+	{
+		auto it = m_index.find(key);
+		if (it == m_index.end())
+			return false;
+		m_bytes -= it->second->bytes;
+		m_order.erase(it->second);
+		m_index.erase(it);
+		return true;
+	}
+
+	// Drop every entry matching `pred(key, value)`; returns how many.
+	template <typename Pred>
+	size_t EraseIf(Pred pred)
+	{
+		size_t removed = 0;
+		for (auto it = m_order.begin(); it != m_order.end();)
+		{
+			if (pred(it->key, it->value))
+			{
+				m_bytes -= it->bytes;
+				m_index.erase(it->key);
+				it = m_order.erase(it);
+				removed++;
+			}
+			else
+			{
+				++it;
+			}
+		}
+		return removed;
+	}
+
+	// Evict from the cold end until at least `bytes` were freed (or the
+	// cache is empty). Used by the global memory budget; returns the bytes
+	// actually freed.
+	size_t Trim(size_t bytes)
+	{
+		size_t freed = 0;
+		while (!m_order.empty() && freed < bytes)
+		{
+			Node &cold = m_order.back();
+			freed += cold.bytes;
+			m_bytes -= cold.bytes;
+			m_index.erase(cold.key);
+			m_order.pop_back();
+			m_evictions++;
+		}
+		return freed;
+	}
+
+	void Clear()
+	{
+		m_order.clear();
+		m_index.clear();
+		m_bytes = 0;
+	}
+
+	void ResetStats()
+	{
+		m_hits = m_misses = m_inserts = m_evictions = 0;
+	}
+
+	Stats GetStats() const
+	{
+		Stats s;
+		s.hits = m_hits;
+		s.misses = m_misses;
+		s.inserts = m_inserts;
+		s.evictions = m_evictions;
+		s.entries = m_index.size();
+		s.bytes = m_bytes;
+		s.capacityBytes = m_capacityBytes;
+		return s;
+	}
+
+	size_t Bytes() const { return m_bytes; }
+	size_t Size() const { return m_index.size(); }
+
+private:
+	struct Node
+	{
+		Key key;
+		Value value;
+		size_t bytes = 0;
+	};
+
+	void EvictToFit(size_t incoming)
+	{
+		if (m_capacityBytes == 0)
+			return;
+		while (!m_order.empty() && m_bytes + incoming > m_capacityBytes)
+		{
+			Node &cold = m_order.back();
+			m_bytes -= cold.bytes;
+			m_index.erase(cold.key);
+			m_order.pop_back();
+			m_evictions++;
+		}
+	}
+
+	std::list<Node> m_order;
+	std::unordered_map<Key, typename std::list<Node>::iterator, Hash> m_index;
+	size_t m_capacityBytes = 0;
+	size_t m_bytes = 0;
+	uint64_t m_hits = 0;
+	uint64_t m_misses = 0;
+	uint64_t m_inserts = 0;
+	uint64_t m_evictions = 0;
+};
@@ -0,0 +1,179 @@
+//----------------------------------------------------------------------------------
+//	Global memory budget for the plugin's caches (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Default global budget in MB; override at build time or change at runtime
+// with Manager::SetBudget.
+#ifndef FONTPREVIEW_MEMORY_BUDGET_MB
+#define FONTPREVIEW_MEMORY_BUDGET_MB 96
+#endif
+
+// Each cache keeps its own byte cap; the manager adds one ceiling over all
+// of them. Caches register a usage callback and, when they can shed
+// entries, a trim callback. Enforce() asks the lowest-priority caches to
+// give memory back first until the total fits.
+namespace MemoryBudget
+{
+	enum class Priority : int
+	{
+		Low = 0,	// cheap to rebuild (prefetch, layouts)
+		Normal = 1, // visible cost to rebuild (rendered previews)
+		High = 2	// needed to render anything (font collections)
+	};
+
+	inline const char *PriorityName(Priority p)
+	{
+		return p == Priority::Low ? "low" : p == Priority::Normal ? "normal" : "high";
+	}
+
+	class Manager
+	{
+	public:
+		// Current resident bytes of the cache.
+		using UsageFn = std::function<size_t()>;
+		// Free at least `bytes` if possible; returns what was freed.
+		using TrimFn = std::function<size_t(size_t bytes)>;
+
+		struct Stats
+		{
+			uint64_t enforcements = 0;
+			uint64_t trims = 0;
+			uint64_t trimmedBytes = 0;
+			uint64_t overBudget = 0; // enforcements that could not reach the budget
+			size_t peakBytes = 0;
+		};
+
+		explicit Manager(size_t budgetBytes = (size_t)FONTPREVIEW_MEMORY_BUDGET_MB * 1024 * 1024)
+			: m_budgetBytes(budgetBytes) {}
+
+		// `name` must outlive the manager (a string literal). A null `trim`
+		// registers an accounting-only client that is reported, never trimmed.
+		int Register(const char *name, Priority priority, UsageFn usage, TrimFn trim = nullptr)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			Client c;
+			c.id = ++m_nextId;
+			c.name = name;
+			c.priority = priority;
+			c.usage = std::move(usage);
+			c.trim = std::move(trim);
+			m_clients.push_back(std::move(c));
+			return m_nextId;
+		}
+
+		void Unregister(int id)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (auto it = m_clients.begin(); it != m_clients.end(); ++it)
+			{
+				if (it->id == id)
+				{
+					m_clients.erase(it);
+					return;
+				}
+			}
+		}
+
+		void SetBudget(size_t bytes)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_budgetBytes = bytes;
+		}
+
+		size_t Budget() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_budgetBytes;
+		}
+
+		size_t TotalBytes() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return TotalLocked();
+		}
+
+		// Trim until the total fits: Low before Normal before High, and in
+		// registration order within a priority. Returns the bytes freed.
+		// Callbacks run under the manager lock; they may take their cache's
+		// own lock but must not call back into the manager. Does not
+		// allocate, so it is safe on the allocation-free selection path.
+		size_t Enforce()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stats.enforcements++;
+			size_t total = TotalLocked();
+			if (total > m_stats.peakBytes)
+				m_stats.peakBytes = total;
+			if (m_budgetBytes == 0 || total <= m_budgetBytes)
+				return 0;
+			size_t freed = 0;
+			for (int p = (int)Priority::Low; p <= (int)Priority::High && total > m_budgetBytes; p++)
+			{
+				for (auto &c : m_clients)
+				{
+					if ((int)c.priority != p || !c.trim)
+						continue;
+					size_t excess = total - m_budgetBytes;
+					size_t got = c.trim(excess);
+					if (got > 0)
+					{
+						m_stats.trims++;
+						m_stats.trimmedBytes += got;
+					}
+					freed += got;
+					total = got >= total ? 0 : total - got;
+					if (total <= m_budgetBytes)
+						break;
+				}
+			}
+			if (total > m_budgetBytes)
+				m_stats.overBudget++;
+			return freed;
+		}
+
+		// Visit every client as fn(name, priority, bytes) under the lock.
+		template <typename Fn>
+		void ForEachClient(Fn &&fn) const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (const auto &c : m_clients)
+				fn(c.name, c.priority, c.usage ? c.usage() : (size_t)0);
+		}
+
+		Stats GetStats() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_stats;
+		}
+
+	private:
+		struct Client
+		{
+			int id = 0;
+			const char *name = "";
+			Priority priority = Priority::Normal;
+			UsageFn usage;
+			TrimFn trim;
+		};
+
+		size_t TotalLocked() const
+		{
+			size_t total = 0;
+			for (const auto &c : m_clients)
+				total += c.usage ? c.usage() : 0;
+			return total;
+		}
+
+		mutable std::mutex m_mutex;
+		std::vector<Client> m_clients;
+		size_t m_budgetBytes;
+		int m_nextId = 0;
+		Stats m_stats;
+	};
+}
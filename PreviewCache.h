@@ -0,0 +1,111 @@
+//----------------------------------------------------------------------------------
+//	Rendered preview cache (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <unordered_set>
+#include "FontHash.h"
+#include "LruCache.h"
+
+namespace PreviewCache
+{
+	// Everything that changes the pixels of a finished preview. `fontKey`
+	// identifies the font and its content (see the plugin's
+	// BuildFontCacheKey), `faceHash` the selected style (0 for the family).
+	struct Key
+	{
+		std::wstring fontKey;
+		uint64_t faceHash = 0;
+		uint64_t textHash = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t bgColor = 0;
+		uint32_t dpi = 96;
+
+		bool operator==(const Key &o) const
+		{
+			return fontKey == o.fontKey && faceHash == o.faceHash && textHash == o.textHash &&
+				   width == o.width && height == o.height && bgColor == o.bgColor && dpi == o.dpi;
+		}
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key &k) const
+		{
+			uint64_t h = FontHash::Hash64(k.fontKey.data(), k.fontKey.size() * sizeof(wchar_t), k.textHash);
+			uint64_t mix[5] = {h, k.faceHash, ((uint64_t)k.width << 32) | k.height, ((uint64_t)k.bgColor << 32) | k.dpi, 0};
+			return (size_t)FontHash::Hash64(mix, sizeof(mix));
+		}
+	};
+
+	inline uint64_t HashText(const std::wstring &text)
+	{
+		return FontHash::Hash64(text.data(), text.size() * sizeof(wchar_t));
+	}
+
+	// Fill a (reused) key for one preview; assigning into `key.fontKey`
+	// keeps its capacity, so a warm lookup does not allocate.
+	inline void AssignKey(Key &key, const std::wstring &fontKey, uint64_t faceHash, const std::wstring &text, uint32_t width, uint32_t height,
+						  uint32_t bgColor, uint32_t dpi)
+	{
+		key.fontKey.assign(fontKey);
+		key.faceHash = faceHash;
+		key.textHash = HashText(text);
+		key.width = width;
+		key.height = height;
+		key.bgColor = bgColor;
+		key.dpi = dpi;
+	}
+
+	// 32-bit BGRA, matching the preview swap chain format.
+	inline size_t BitmapBytes(uint32_t width, uint32_t height)
+	{
+		return (size_t)width * (size_t)height * 4;
+	}
+
+	// Byte-budgeted LRU of rendered previews. `Bitmap` is the GPU handle
+	// (ComPtr<ID2D1Bitmap1> in the plugin); the cache only accounts for it.
+	template <typename Bitmap>
+	class Cache
+	{
+	public:
+		using Stats = typename LruCache<Key, Bitmap, KeyHash>::Stats;
+
+		explicit Cache(size_t capacityBytes) : m_lru(capacityBytes) {}
+
+		Bitmap *Find(const Key &key) { return m_lru.Get(key); }
+		// Without counting a hit or touching the recency order.
+		bool Contains(const Key &key) const { return m_lru.Contains(key); }
+
+		bool Insert(const Key &key, Bitmap bitmap)
+		{
+			return m_lru.Put(key, std::move(bitmap), BitmapBytes(key.width, key.height));
+		}
+
+		// Catalog rebuilt: keep only previews whose font is still listed
+		// with the same content. Returns the number of dropped entries.
+		size_t RetainFonts(const std::unordered_set<std::wstring> &liveFontKeys)
+		{
+			return m_lru.EraseIf([&](const Key &k, const Bitmap &)
+								 { return liveFontKeys.count(k.fontKey) == 0; });
+		}
+
+		size_t InvalidateFont(const std::wstring &fontKey)
+		{
+			return m_lru.EraseIf([&](const Key &k, const Bitmap &)
+								 { return k.fontKey == fontKey; });
+		}
+
+		void SetCapacity(size_t capacityBytes) { m_lru.SetCapacity(capacityBytes); }
+		size_t Trim(size_t bytes) { return m_lru.Trim(bytes); }
+		void Clear() { m_lru.Clear(); }
+		Stats GetStats() const { return m_lru.GetStats(); }
+		size_t ResidentBytes() const { return m_lru.Bytes(); }
+
+	private:
+		LruCache<Key, Bitmap, KeyHash> m_lru;
+	};
+}
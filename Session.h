@@ -0,0 +1,358 @@
+//----------------------------------------------------------------------------------
+//	Session snapshot: restoring the last view before enumeration (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "FontHash.h"
+#include "FontPreviewCore.h"
+
+// What the window showed when it was last closed: the search query, type
+// filter, sample text, background colour, selected font and scroll
+// position, plus the filtered rows themselves. On the next start the
+// plugin lists those rows as a provisional catalog, so the first frame
+// shows the old view while the real catalog is enumerated in the
+// background; once it arrives the selection and scroll are carried over
+// by identity. When the catalog turns out unchanged (same signature) the
+// stored index set is reused instead of filtering again.
+//
+// The file is small even with every font listed: strings are UTF-8 and
+// front-coded against the same field of the previous row (sorted catalogs
+// share long path and family prefixes), integers are varints, the indices
+// are deltas, and a trailing XXH64 rejects torn or foreign files.
+namespace Session
+{
+	struct Row
+	{
+		std::wstring displayName;
+		std::wstring filePath;
+		std::wstring sourcePath;
+		bool isSystemFont = true;
+		uint32_t faceIndex = 0;
+		uint64_t contentHash = 0;
+	};
+
+	struct Snapshot
+	{
+		std::wstring searchQuery;
+		FontPreviewCore::FontTypeFilter filterType = FontPreviewCore::FontTypeFilter::All;
+		std::wstring sampleText = FontPreviewCore::kDefaultSampleText;
+		uint32_t bgColor = 0xFFFFFF;  // COLORREF
+		std::wstring selectedIdentity; // FontPreviewCore::BuildFontIdentity, empty for none
+		uint32_t topRow = 0;		   // first visible filtered row
+		// Catalog the indices refer to; 0 when they refer to no live
+		// catalog (saved before enumeration finished).
+		uint64_t catalogSignature = 0;
+		std::vector<uint32_t> filteredIndices; // ascending
+		std::vector<Row> rows;				   // parallel to filteredIndices
+	};
+
+	// Order-sensitive hash of the catalog's identities and contents.
+	template <typename Item>
+	uint64_t CatalogSignature(const std::vector<Item> &fonts)
+	{
+		uint64_t h = FontHash::Hash64(nullptr, 0, fonts.size());
+		std::string utf8;
+		for (const auto &item : fonts)
+		{
+			utf8.clear();
+			FontPreviewCore::AppendUtf8(FontPreviewCore::BuildFontIdentity(item), utf8);
+			h = FontHash::Hash64(utf8.data(), utf8.size(), h);
+			h = FontHash::Hash64(&item.contentHash, sizeof(item.contentHash), h);
+		}
+		return h | 1;
+	}
+
+	// Record the filtered rows of `fonts` into `out` (the UI state fields
+	// are the caller's).
+	template <typename Item>
+	void CaptureRows(const std::vector<Item> &fonts, const std::vector<int> &filtered, uint64_t signature, Snapshot &out)
+	{
+		out.catalogSignature = signature;
+		out.filteredIndices.clear();
+		out.rows.clear();
+		out.filteredIndices.reserve(filtered.size());
+		out.rows.reserve(filtered.size());
+		for (int index : filtered)
+		{
+			if (index < 0 || index >= (int)fonts.size())
+				continue;
+			const Item &item = fonts[index];
+			out.filteredIndices.push_back((uint32_t)index);
+			Row row;
+			row.displayName = item.displayName;
+			row.filePath = item.filePath;
+			row.sourcePath = item.sourcePath;
+			row.isSystemFont = item.isSystemFont;
+			row.faceIndex = item.faceIndex;
+			row.contentHash = item.contentHash;
+			out.rows.push_back(std::move(row));
+		}
+	}
+
+	// The stored rows as catalog items, for the provisional catalog.
+	template <typename Item>
+	void RestoreRows(const Snapshot &snapshot, std::vector<Item> &out)
+	{
+		out.clear();
+		out.reserve(snapshot.rows.size());
+		for (const Row &row : snapshot.rows)
+		{
+			Item item;
+			item.displayName = row.displayName;
+			item.filePath = row.filePath;
+			item.sourcePath = row.sourcePath;
+			item.isSystemFont = row.isSystemFont;
+			item.faceIndex = row.faceIndex;
+			item.contentHash = row.contentHash;
+			out.push_back(std::move(item));
+		}
+	}
+
+	// The stored index set, if it is still valid for a catalog with this
+	// signature and the same query and filter; false means filter again.
+	// Favorites and Recent also depend on the working set and filter only
+	// their members, so they are always filtered again.
+	inline bool ReuseIndices(const Snapshot &snapshot, uint64_t signature, size_t catalogSize, const std::wstring &query,
+							 FontPreviewCore::FontTypeFilter type, std::vector<int> &out)
+	{
+		if (snapshot.catalogSignature == 0 || snapshot.catalogSignature != signature || snapshot.searchQuery != query ||
+			snapshot.filterType != type || type == FontPreviewCore::FontTypeFilter::Favorites ||
+			type == FontPreviewCore::FontTypeFilter::Recent)
+			return false;
+		out.clear();
+		out.reserve(snapshot.filteredIndices.size());
+		for (uint32_t index : snapshot.filteredIndices)
+		{
+			if (index >= catalogSize)
+				return false;
+			out.push_back((int)index);
+		}
+		return true;
+	}
+
+	// Catalog index of the font with this identity, or -1; used to carry a
+	// selection or scroll position from one catalog to the next.
+	template <typename Item>
+	int FindByIdentity(const std::vector<Item> &fonts, const std::wstring &identity)
+	{
+		if (identity.empty())
+			return -1;
+		for (size_t i = 0; i < fonts.size(); i++)
+		{
+			if (FontPreviewCore::BuildFontIdentity(fonts[i]) == identity)
+				return (int)i;
+		}
+		return -1;
+	}
+
+	//---------------------------------------------------------------------
+	//	File format
+	//---------------------------------------------------------------------
+	namespace detail
+	{
+		constexpr char kMagic[4] = {'F', 'P', 'S', 'S'};
+		constexpr uint32_t kVersion = 1;
+		constexpr uint64_t kMaxRows = 1u << 22;
+		constexpr uint64_t kMaxString = 1u << 16;
+
+		enum RowFlags : uint8_t
+		{
+			kSystem = 1 << 0,
+			kSourceIsFile = 1 << 1, // sourcePath == filePath, not stored
+		};
+
+		inline void PutVarint(std::vector<uint8_t> &out, uint64_t v)
+		{
+			while (v >= 0x80)
+			{
+				out.push_back((uint8_t)(v | 0x80));
+				v >>= 7;
+			}
+			out.push_back((uint8_t)v);
+		}
+
+		inline void PutString(std::vector<uint8_t> &out, const std::wstring &s)
+		{
+			std::string utf8 = FontPreviewCore::ToUtf8(s);
+			PutVarint(out, utf8.size());
+			out.insert(out.end(), utf8.begin(), utf8.end());
+		}
+
+		// `prev` holds the previous row's UTF-8 value of the same field.
+		inline void PutFrontCoded(std::vector<uint8_t> &out, const std::wstring &s, std::string &prev)
+		{
+			std::string utf8 = FontPreviewCore::ToUtf8(s);
+			size_t shared = 0, limit = std::min(utf8.size(), prev.size());
+			while (shared < limit && utf8[shared] == prev[shared])
+				shared++;
+			PutVarint(out, shared);
+			PutVarint(out, utf8.size() - shared);
+			out.insert(out.end(), utf8.begin() + shared, utf8.end());
+			prev.swap(utf8);
+		}
+
+		class Reader
+		{
+		public:
+			Reader(const uint8_t *data, size_t size) : m_p(data), m_end(data + size) {}
+
+			bool Varint(uint64_t &v)
+			{
+				v = 0;
+				for (int shift = 0; shift < 64; shift += 7)
+				{
+					if (m_p == m_end)
+						return false;
+					uint8_t b = *m_p++;
+					v |= (uint64_t)(b & 0x7F) << shift;
+					if ((b & 0x80) == 0)
+						return true;
+				}
+				return false;
+			}
+
+			bool Bytes(size_t n, std::string &out)
+			{
+				if (n > (size_t)(m_end - m_p))
+					return false;
+				out.append((const char *)m_p, n);
+				m_p += n;
+				return true;
+			}
+
+			bool String(std::wstring &out)
+			{
+				uint64_t len = 0;
+				std::string utf8;
+				if (!Varint(len) || len > kMaxString || !Bytes((size_t)len, utf8))
+					return false;
+				out = FontPreviewCore::FromUtf8(utf8);
+				return true;
+			}
+
+			bool FrontCoded(std::wstring &out, std::string &prev)
+			{
+				uint64_t shared = 0, suffix = 0;
+				if (!Varint(shared) || !Varint(suffix) || shared > prev.size() || suffix > kMaxString)
+					return false;
+				prev.resize((size_t)shared);
+				if (!Bytes((size_t)suffix, prev))
+					return false;
+				out = FontPreviewCore::FromUtf8(prev);
+				return true;
+			}
+
+			bool Byte(uint8_t &b)
+			{
+				if (m_p == m_end)
+					return false;
+				b = *m_p++;
+				return true;
+			}
+
+			bool AtEnd() const { return m_p == m_end; }
+
+		private:
+			const uint8_t *m_p;
+			const uint8_t *m_end;
+		};
+	}
+
+	inline void Encode(const Snapshot &s, std::vector<uint8_t> &out)
+	{
+		using namespace detail;
+		out.assign(kMagic, kMagic + 4);
+		PutVarint(out, kVersion);
+		PutString(out, s.searchQuery);
+		PutVarint(out, (uint64_t)s.filterType);
+		PutString(out, s.sampleText);
+		PutVarint(out, s.bgColor);
+		PutString(out, s.selectedIdentity);
+		PutVarint(out, s.topRow);
+		PutVarint(out, s.catalogSignature);
+		size_t count = std::min(s.rows.size(), s.filteredIndices.size());
+		PutVarint(out, count);
+		uint32_t prevIndex = 0;
+		std::string prevName, prevFile, prevSource;
+		for (size_t i = 0; i < count; i++)
+		{
+			const Row &row = s.rows[i];
+			PutVarint(out, s.filteredIndices[i] - prevIndex);
+			prevIndex = s.filteredIndices[i];
+			uint8_t flags = (row.isSystemFont ? kSystem : 0) | (row.sourcePath == row.filePath ? kSourceIsFile : 0);
+			out.push_back(flags);
+			PutFrontCoded(out, row.displayName, prevName);
+			PutFrontCoded(out, row.filePath, prevFile);
+			if ((flags & kSourceIsFile) == 0)
+				PutFrontCoded(out, row.sourcePath, prevSource);
+			PutVarint(out, row.faceIndex);
+			for (int b = 0; b < 8; b++)
+				out.push_back((uint8_t)(row.contentHash >> (b * 8)));
+		}
+		uint64_t check = FontHash::Hash64(out.data(), out.size());
+		for (int b = 0; b < 8; b++)
+			out.push_back((uint8_t)(check >> (b * 8)));
+	}
+
+	// Returns false (leaving `out` untouched) for a foreign, truncated or
+	// damaged file.
+	inline bool Decode(const uint8_t *data, size_t size, Snapshot &out)
+	{
+		using namespace detail;
+		if (!data || size < 4 + 8 || std::memcmp(data, kMagic, 4) != 0)
+			return false;
+		uint64_t check = 0;
+		for (int b = 0; b < 8; b++)
+			check |= (uint64_t)data[size - 8 + b] << (b * 8);
+		if (FontHash::Hash64(data, size - 8) != check)
+			return false;
+		Reader in(data + 4, size - 4 - 8);
+		Snapshot s;
+		uint64_t version = 0, type = 0, bg = 0, top = 0, count = 0;
+		if (!in.Varint(version) || version != kVersion || !in.String(s.searchQuery) || !in.Varint(type) ||
+			type > (uint64_t)FontPreviewCore::FontTypeFilter::Recent || !in.String(s.sampleText) || !in.Varint(bg) || bg > 0xFFFFFF ||
+			!in.String(s.selectedIdentity) || !in.Varint(top) || top > kMaxRows || !in.Varint(s.catalogSignature) ||
+			!in.Varint(count) || count > kMaxRows)
+			return false;
+		s.filterType = (FontPreviewCore::FontTypeFilter)type;
+		s.bgColor = (uint32_t)bg;
+		s.topRow = (uint32_t)top;
+		s.filteredIndices.reserve((size_t)count);
+		s.rows.reserve((size_t)count);
+		uint64_t index = 0;
+		std::string prevName, prevFile, prevSource;
+		for (uint64_t i = 0; i < count; i++)
+		{
+			uint64_t delta = 0, face = 0;
+			uint8_t flags = 0;
+			Row row;
+			if (!in.Varint(delta) || (i > 0 && delta == 0) || index + delta > 0xFFFFFFFFu || !in.Byte(flags) ||
+				!in.FrontCoded(row.displayName, prevName) || !in.FrontCoded(row.filePath, prevFile))
+				return false;
+			index += delta;
+			row.isSystemFont = (flags & kSystem) != 0;
+			if ((flags & kSourceIsFile) != 0)
+				row.sourcePath = row.filePath;
+			else if (!in.FrontCoded(row.sourcePath, prevSource))
+				return false;
+			std::string hash;
+			if (!in.Varint(face) || face > 0xFFFFFFFFu || !in.Bytes(8, hash))
+				return false;
+			row.faceIndex = (uint32_t)face;
+			for (int b = 0; b < 8; b++)
+				row.contentHash |= (uint64_t)(uint8_t)hash[b] << (b * 8);
+			s.filteredIndices.push_back((uint32_t)index);
+			s.rows.push_back(std::move(row));
+		}
+		if (!in.AtEnd())
+			return false;
+		out = std::move(s);
+		return true;
+	}
+}
@@ -0,0 +1,263 @@
+//----------------------------------------------------------------------------------
+//	Minimal sfnt (TTF/OTF/TTC) reader (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+// Reads just enough of a font file to build a catalog without DirectWrite:
+// family / subfamily names from `name` and variation axes from `fvar`.
+// Used by FontPreviewBench to replay scripts against an on-disk corpus on
+// any platform. Malformed input is rejected, never trusted. Catalogs can
+// skip `fvar` while listing and read one face's axes when it is first
+// needed (ReadFaceAxes), as the plugin resolves axes lazily.
+namespace SfntReader
+{
+	struct Axis
+	{
+		std::string tag;
+		float minValue = 0.0f;
+		float defaultValue = 0.0f;
+		float maxValue = 0.0f;
+	};
+
+	struct FaceInfo
+	{
+		uint32_t faceIndex = 0;
+		std::wstring familyName;
+		std::wstring subfamilyName;
+		std::vector<Axis> axes;
+		uint16_t namedInstanceCount = 0;
+	};
+
+	namespace detail
+	{
+		inline bool Has(size_t size, size_t offset, size_t length)
+		{
+			return offset <= size && length <= size - offset;
+		}
+
+		inline uint16_t U16(const uint8_t *p) { return (uint16_t)((p[0] << 8) | p[1]); }
+		inline uint32_t U32(const uint8_t *p) { return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3]; }
+		inline float Fixed(const uint8_t *p) { return (float)(int32_t)U32(p) / 65536.0f; }
+
+		inline uint32_t Tag(const char (&t)[5])
+		{
+			return ((uint32_t)(uint8_t)t[0] << 24) | ((uint32_t)(uint8_t)t[1] << 16) | ((uint32_t)(uint8_t)t[2] << 8) | (uint8_t)t[3];
+		}
+
+		struct Table
+		{
+			size_t offset = 0;
+			size_t length = 0;
+		};
+
+		inline bool FindTable(const uint8_t *data, size_t size, size_t fontOffset, uint32_t tag, Table &out)
+		{
+			if (!Has(size, fontOffset, 12))
+				return false;
+			uint16_t numTables = U16(data + fontOffset + 4);
+			size_t dir = fontOffset + 12;
+			if (!Has(size, dir, (size_t)numTables * 16))
+				return false;
+			for (uint16_t i = 0; i < numTables; i++)
+			{
+				const uint8_t *rec = data + dir + (size_t)i * 16;
+				if (U32(rec) != tag)
+					continue;
+				out.offset = U32(rec + 8);
+				out.length = U32(rec + 12);
+				return Has(size, out.offset, out.length);
+			}
+			return false;
+		}
+
+		inline std::wstring DecodeUtf16BE(const uint8_t *p, size_t bytes)
+		{
+			std::wstring out;
+			out.reserve(bytes / 2);
+			for (size_t i = 0; i + 1 < bytes; i += 2)
+			{
+				uint32_t cu = U16(p + i);
+				if (sizeof(wchar_t) == 4 && cu >= 0xD800 && cu <= 0xDBFF && i + 3 < bytes)
+				{
+					uint32_t lo = U16(p + i + 2);
+					if (lo >= 0xDC00 && lo <= 0xDFFF)
+					{
+						out.push_back((wchar_t)(0x10000 + ((cu - 0xD800) << 10) + (lo - 0xDC00)));
+						i += 2;
+						continue;
+					}
+				}
+				out.push_back((wchar_t)cu);
+			}
+			return out;
+		}
+
+		// Rank a name record; higher is better, 0 means unusable. Mirrors the
+		// plugin's ja-jp then en-us locale preference.
+		inline int NameRank(uint16_t platform, uint16_t encoding, uint16_t language)
+		{
+			if (platform == 3 && (encoding == 1 || encoding == 10))
+				return language == 0x0411 ? 5 : language == 0x0409 ? 4 : 3;
+			if (platform == 0)
+				return 2;
+			if (platform == 1 && encoding == 0)
+				return 1;
+			return 0;
+		}
+
+		inline bool ReadName(const uint8_t *data, const Table &name, uint16_t nameId, std::wstring &out)
+		{
+			if (name.length < 6)
+				return false;
+			const uint8_t *base = data + name.offset;
+			uint16_t count = U16(base + 2);
+			size_t storage = U16(base + 4);
+			if (!Has(name.length, 6, (size_t)count * 12))
+				return false;
+			int bestRank = 0;
+			const uint8_t *best = nullptr;
+			for (uint16_t i = 0; i < count; i++)
+			{
+				const uint8_t *rec = base + 6 + (size_t)i * 12;
+				if (U16(rec + 6) != nameId)
+					continue;
+				int rank = NameRank(U16(rec), U16(rec + 2), U16(rec + 4));
+				if (rank > bestRank && Has(name.length, storage + U16(rec + 10), U16(rec + 8)))
+				{
+					bestRank = rank;
+					best = rec;
+				}
+			}
+			if (!best)
+				return false;
+			const uint8_t *str = base + storage + U16(best + 10);
+			size_t len = U16(best + 8);
+			if (bestRank == 1)
+				out.assign(str, str + len); // Mac Roman; ASCII range is what matters here
+			else
+				out = DecodeUtf16BE(str, len);
+			return !out.empty();
+		}
+
+		inline void ReadAxes(const uint8_t *data, const Table &fvar, FaceInfo &out)
+		{
+			if (fvar.length < 16)
+				return;
+			const uint8_t *base = data + fvar.offset;
+			size_t axesOffset = U16(base + 4);
+			uint16_t axisCount = U16(base + 8);
+			size_t axisSize = U16(base + 10);
+			out.namedInstanceCount = U16(base + 12);
+			if (axisSize < 20 || !Has(fvar.length, axesOffset, (size_t)axisCount * axisSize))
+				return;
+			for (uint16_t i = 0; i < axisCount; i++)
+			{
+				const uint8_t *rec = base + axesOffset + (size_t)i * axisSize;
+				Axis axis;
+				axis.tag.assign((const char *)rec, 4);
+				axis.minValue = Fixed(rec + 4);
+				axis.defaultValue = Fixed(rec + 8);
+				axis.maxValue = Fixed(rec + 12);
+				out.axes.push_back(axis);
+			}
+		}
+
+		// Offset of face `faceIndex`'s table directory in a TTF/OTF/TTC image.
+		inline bool FaceOffset(const uint8_t *data, size_t size, uint32_t faceIndex, size_t &out)
+		{
+			if (!data || size < 12)
+				return false;
+			uint32_t version = U32(data);
+			if (version == Tag("ttcf"))
+			{
+				if (faceIndex >= U32(data + 8) || !Has(size, 12 + (size_t)faceIndex * 4, 4))
+					return false;
+				out = U32(data + 12 + (size_t)faceIndex * 4);
+				return true;
+			}
+			out = 0;
+			return faceIndex == 0 && (version == 0x00010000 || version == Tag("OTTO") || version == Tag("true"));
+		}
+
+		inline bool ReadFace(const uint8_t *data, size_t size, size_t fontOffset, uint32_t faceIndex, bool readAxes, FaceInfo &out)
+		{
+			Table name;
+			if (!FindTable(data, size, fontOffset, Tag("name"), name))
+				return false;
+			out.faceIndex = faceIndex;
+			if (!ReadName(data, name, 16, out.familyName) && !ReadName(data, name, 1, out.familyName))
+				return false;
+			if (!ReadName(data, name, 17, out.subfamilyName))
+				ReadName(data, name, 2, out.subfamilyName);
+			Table fvar;
+			if (readAxes && FindTable(data, size, fontOffset, Tag("fvar"), fvar))
+				ReadAxes(data, fvar, out);
+			return true;
+		}
+	}
+
+	// Parse every face of a TTF/OTF/TTC image. Faces without a usable name
+	// are skipped; returns false when nothing could be read. Without
+	// `readAxes`, `axes` and `namedInstanceCount` are left empty.
+	inline bool ReadFaces(const uint8_t *data, size_t size, std::vector<FaceInfo> &outFaces, bool readAxes = true)
+	{
+		using namespace detail;
+		outFaces.clear();
+		if (!data || size < 12)
+			return false;
+		uint32_t version = U32(data);
+		if (version == Tag("ttcf"))
+		{
+			uint32_t numFonts = U32(data + 8);
+			if (!Has(size, 12, (size_t)numFonts * 4))
+				return false;
+			for (uint32_t i = 0; i < numFonts; i++)
+			{
+				FaceInfo face;
+				if (ReadFace(data, size, U32(data + 12 + (size_t)i * 4), i, readAxes, face))
+					outFaces.push_back(std::move(face));
+			}
+		}
+		else if (version == 0x00010000 || version == Tag("OTTO") || version == Tag("true"))
+		{
+			FaceInfo face;
+			if (ReadFace(data, size, 0, 0, readAxes, face))
+				outFaces.push_back(std::move(face));
+		}
+		return !outFaces.empty();
+	}
+
+	// The variation axes (and named instance count) of one face, for
+	// catalogs listed without them. A face without `fvar` has none; returns
+	// false only when the image has no such face.
+	inline bool ReadFaceAxes(const uint8_t *data, size_t size, uint32_t faceIndex, FaceInfo &out)
+	{
+		using namespace detail;
+		out.axes.clear();
+		out.namedInstanceCount = 0;
+		size_t fontOffset = 0;
+		if (!FaceOffset(data, size, faceIndex, fontOffset) || !Has(size, fontOffset, 12))
+			return false;
+		Table fvar;
+		if (FindTable(data, size, fontOffset, Tag("fvar"), fvar))
+			ReadAxes(data, fvar, out);
+		return true;
+	}
+
+	template <typename Path>
+	inline bool ReadFontFile(const Path &path, std::vector<FaceInfo> &outFaces)
+	{
+		std::ifstream in(path, std::ios::binary);
+		if (!in)
+			return false;
+		std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		return ReadFaces(bytes.data(), bytes.size(), outFaces);
+	}
+}
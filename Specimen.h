@@ -0,0 +1,145 @@
+//----------------------------------------------------------------------------------
+//	Multi-size specimen geometry: waterfall and paragraph views (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <string>
+
+// The single-line preview draws at one size. Specimen views stack several
+// lines instead: a waterfall repeats the sample once per size (no
+// wrapping), a paragraph repeats it into a wrapped block per size. A Plan
+// holds the lines' sizes and heights; heights start as estimates and are
+// replaced by measured ones as lines get laid out, so only the lines inside
+// the scrolled viewport ever need a layout. Allocation-free.
+namespace Specimen
+{
+	enum class Mode : int
+	{
+		Single = 0,
+		Waterfall,
+		Paragraph,
+		Compare, // pinned fonts stacked, see Compare.h; no size lines
+		Glyphs,	 // every mapped codepoint, see GlyphGrid.h; no size lines
+		Count
+	};
+
+	inline const char *ModeName(Mode m)
+	{
+		static const char *const kNames[] = {"single", "waterfall", "paragraph", "compare", "glyphs"};
+		int i = (int)m;
+		return i >= 0 && i < (int)Mode::Count ? kNames[i] : "?";
+	}
+
+	constexpr float kWaterfallSizes[] = {8, 9, 10, 11, 12, 14, 16, 18, 20, 24, 28, 32, 36, 42, 48, 60, 72, 96, 120, 144};
+	constexpr float kParagraphSizes[] = {9, 10.5f, 12, 14, 18, 24, 36};
+	constexpr int kMaxLines = 32;
+	// Paragraph blocks repeat the sample until they have this many characters.
+	constexpr size_t kParagraphMinChars = 160;
+	constexpr float kLineGapDips = 6.0f;
+	constexpr float kLabelWidthDips = 44.0f; // "144pt" column left of each line
+
+	inline float PointsToDips(float points) { return points * 96.0f / 72.0f; }
+
+	struct Plan
+	{
+		Mode mode = Mode::Single;
+		int count = 0;
+		float sizes[kMaxLines] = {};   // points
+		float heights[kMaxLines] = {}; // DIPs, without the gap
+		bool measured[kMaxLines] = {};
+		float tops[kMaxLines + 1] = {}; // tops[count] is the content height
+	};
+
+	// Height of a line before it is laid out: one line for a waterfall,
+	// a rough character-count wrap for a paragraph.
+	inline float EstimateHeight(Mode mode, float sizePt, size_t textChars, float width)
+	{
+		float lineHeight = std::ceil(PointsToDips(sizePt) * 1.35f);
+		if (mode != Mode::Paragraph || width <= 0.0f)
+			return lineHeight;
+		float advance = PointsToDips(sizePt) * 0.8f; // between Latin and CJK widths
+		float perLine = (std::max)(1.0f, std::floor(width / advance));
+		return lineHeight * std::ceil((float)textChars / perLine);
+	}
+
+	inline void UpdateTops(Plan &plan)
+	{
+		float y = 0.0f;
+		for (int i = 0; i < plan.count; i++)
+		{
+			plan.tops[i] = y;
+			y += plan.heights[i] + kLineGapDips;
+		}
+		plan.tops[plan.count] = y;
+	}
+
+	// `textChars` is the length of the text each line shows; `width` the
+	// room for the text (the label column already taken off).
+	inline Plan MakePlan(Mode mode, size_t textChars, float width)
+	{
+		Plan plan;
+		plan.mode = mode;
+		const float *sizes = mode == Mode::Paragraph ? kParagraphSizes : kWaterfallSizes;
+		size_t n = mode == Mode::Paragraph ? sizeof(kParagraphSizes) / sizeof(float)
+										   : mode == Mode::Waterfall ? sizeof(kWaterfallSizes) / sizeof(float)
+																	 : 0;
+		plan.count = (int)(n < (size_t)kMaxLines ? n : (size_t)kMaxLines);
+		for (int i = 0; i < plan.count; i++)
+		{
+			plan.sizes[i] = sizes[i];
+			plan.heights[i] = EstimateHeight(mode, sizes[i], textChars, width);
+		}
+		UpdateTops(plan);
+		return plan;
+	}
+
+	// Record a laid-out line's real height; returns true when it moved the
+	// lines below it.
+	inline bool SetMeasured(Plan &plan, int line, float height)
+	{
+		if (line < 0 || line >= plan.count)
+			return false;
+		bool moved = plan.heights[line] != height;
+		plan.heights[line] = height;
+		plan.measured[line] = true;
+		if (moved)
+			UpdateTops(plan);
+		return moved;
+	}
+
+	inline float ContentHeight(const Plan &plan) { return plan.tops[plan.count]; }
+
+	inline float ClampScroll(const Plan &plan, float scroll, float viewHeight)
+	{
+		float maxScroll = (std::max)(0.0f, ContentHeight(plan) - viewHeight);
+		return scroll < 0.0f ? 0.0f : scroll > maxScroll ? maxScroll : scroll;
+	}
+
+	// Lines intersecting [scroll, scroll + viewHeight) as [first, last).
+	inline void VisibleRange(const Plan &plan, float scroll, float viewHeight, int &first, int &last)
+	{
+		first = 0;
+		while (first < plan.count && plan.tops[first] + plan.heights[first] <= scroll)
+			first++;
+		last = first;
+		while (last < plan.count && plan.tops[last] < scroll + viewHeight)
+			last++;
+	}
+
+	// Paragraph text: the sample repeated (space separated) to at least
+	// kParagraphMinChars characters.
+	inline void MakeParagraphText(const std::wstring &sample, std::wstring &out)
+	{
+		out.clear();
+		if (sample.empty())
+			return;
+		while (out.size() < kParagraphMinChars)
+		{
+			if (!out.empty())
+				out += L' ';
+			out += sample;
+		}
+	}
+}
@@ -0,0 +1,219 @@
+//----------------------------------------------------------------------------------
+//	Background task queue (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+// Small worker pool for UI-side background work (face enumeration,
+// prefetch). Tasks are grouped by a caller-chosen tag so that a whole group
+// can be dropped at once, e.g. when the catalog or the filter changes.
+// Higher priority queues are always drained first, and the lower ones can
+// be held back (see SetRunnableLevels) while the UI is not visible.
+class TaskQueue
+{
+public:
+	enum class Priority
+	{
+		High = 0,
+		Normal = 1,
+		Low = 2
+	};
+
+	TaskQueue() = default;
+	TaskQueue(const TaskQueue &) = delete;
+	TaskQueue &operator=(const TaskQueue &) = delete;
+	~TaskQueue() { Shutdown(); }
+
+	void Start(unsigned threadCount)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_threads.empty())
+			return;
+		m_stopping = false;
+		if (threadCount == 0)
+			threadCount = 1;
+		for (unsigned i = 0; i < threadCount; i++)
+			m_threads.emplace_back([this]
+								   { WorkerLoop(); });
+	}
+
+	// Drops pending tasks and joins the workers. Running tasks complete.
+	void Shutdown()
+	{
+		std::vector<std::thread> threads;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+			for (auto &q : m_queues)
+				q.clear();
+			threads.swap(m_threads);
+		}
+		m_cv.notify_all();
+		for (auto &t : threads)
+			t.join();
+	}
+
+	bool IsRunning() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return !m_threads.empty() && !m_stopping;
+	}
+
+	bool Post(Priority priority, uint64_t tag, std::function<void()> fn)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_threads.empty() || m_stopping)
+				return false;
+			m_queues[(int)priority].push_back(Task{tag, std::move(fn)});
+		}
+		m_cv.notify_one();
+		return true;
+	}
+
+	// Remove every pending task with `tag`; returns how many were dropped.
+	size_t Cancel(uint64_t tag)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		size_t dropped = 0;
+		for (auto &q : m_queues)
+		{
+			for (auto it = q.begin(); it != q.end();)
+			{
+				if (it->tag == tag)
+				{
+					it = q.erase(it);
+					dropped++;
+				}
+				else
+				{
+					++it;
+				}
+			}
+		}
+		return dropped;
+	}
+
+	// Let only the `levels` highest priorities run (3 = all, 1 = High only,
+	// 0 = none). Held-back tasks stay queued; running tasks complete.
+	void SetRunnableLevels(unsigned levels)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_runnableLevels = levels < 3 ? levels : 3;
+		}
+		m_cv.notify_all();
+	}
+
+	unsigned RunnableLevels() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_runnableLevels;
+	}
+
+	// Run fn(i) for every i in [0, count): up to `helpers` tasks are posted
+	// to share the work and the calling thread claims indices as well, then
+	// waits for the ones a worker already started. Nothing waits on a
+	// queued task, so this also completes while workers are busy or held
+	// back. Helper tasks that start late find no work and return at once.
+	template <typename Fn>
+	void ParallelFor(size_t count, unsigned helpers, Priority priority, uint64_t tag, Fn &&fn)
+	{
+		if (count == 0)
+			return;
+		struct Shared
+		{
+			std::atomic<size_t> next{0};
+			std::mutex mutex;
+			std::condition_variable cv;
+			size_t done = 0;
+			size_t count = 0;
+			std::function<void(size_t)> fn;
+		};
+		auto shared = std::make_shared<Shared>();
+		shared->count = count;
+		shared->fn = std::ref(fn);
+		auto run = [](Shared &st)
+		{
+			size_t ran = 0;
+			for (size_t i; (i = st.next.fetch_add(1)) < st.count; ran++)
+				st.fn(i);
+			if (ran == 0)
+				return;
+			std::lock_guard<std::mutex> lock(st.mutex);
+			st.done += ran;
+			if (st.done == st.count)
+				st.cv.notify_all();
+		};
+		for (unsigned h = 0; h < helpers && h + 1 < count; h++)
+			Post(priority, tag, [shared, run]
+				 { run(*shared); });
+		run(*shared);
+		std::unique_lock<std::mutex> lock(shared->mutex);
+		shared->cv.wait(lock, [&]
+						{ return shared->done == shared->count; });
+	}
+
+	size_t Pending() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		size_t n = 0;
+		for (const auto &q : m_queues)
+			n += q.size();
+		return n;
+	}
+
+private:
+	struct Task
+	{
+		uint64_t tag = 0;
+		std::function<void()> fn;
+	};
+
+	bool PopLocked(Task &out)
+	{
+		for (unsigned i = 0; i < m_runnableLevels; i++)
+		{
+			auto &q = m_queues[i];
+			if (!q.empty())
+			{
+				out = std::move(q.front());
+				q.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void WorkerLoop()
+	{
+		for (;;)
+		{
+			Task task;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_cv.wait(lock, [&]
+						  { return m_stopping || PopLocked(task); });
+				if (!task.fn)
+					return;
+			}
+			task.fn();
+		}
+	}
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::deque<Task> m_queues[3];
+	std::vector<std::thread> m_threads;
+	bool m_stopping = false;
+	unsigned m_runnableLevels = 3;
+};
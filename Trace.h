@@ -0,0 +1,372 @@
+//----------------------------------------------------------------------------------
+//	Latency tracing (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Scoped spans for UI-critical operations. Each finished span is
+//  - recorded into a fixed-size lock-free ring buffer (recent timeline,
+//    dumped as Chrome trace JSON: chrome://tracing or Perfetto), and
+//  - added to a per-operation log-linear latency histogram
+//    (count/p50/p95/p99/max).
+// When tracing is disabled a span costs one relaxed atomic load.
+namespace Trace
+{
+	constexpr size_t kMaxOps = 64;
+	constexpr size_t kRingCapacity = 1 << 14; // power of two
+	// Log-linear buckets: 8 sub-buckets per power of two up to 2^40 ns
+	// (~18 min), i.e. at most 12.5% relative error per reported value.
+	constexpr int kSubBucketBits = 3;
+	constexpr int kSubBuckets = 1 << kSubBucketBits;
+	constexpr int kMaxExponent = 40;
+	constexpr int kBucketCount = (kMaxExponent + 1) * kSubBuckets;
+
+	inline uint64_t NowNs()
+	{
+		using namespace std::chrono;
+		return (uint64_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	inline uint32_t CurrentThreadId()
+	{
+		static thread_local uint32_t id = (uint32_t)(std::hash<std::thread::id>()(std::this_thread::get_id()) & 0x7FFFFFFF);
+		return id;
+	}
+
+	//---------------------------------------------------------------------
+	//	Histogram
+	//---------------------------------------------------------------------
+	class Histogram
+	{
+	public:
+		static int BucketFor(uint64_t ns)
+		{
+			if (ns < (uint64_t)kSubBuckets)
+				return (int)ns;
+			int msb = 63;
+			while ((ns >> msb) == 0)
+				msb--;
+			int exponent = msb - kSubBucketBits + 1;
+			if (exponent > kMaxExponent)
+				return kBucketCount - 1;
+			int sub = (int)((ns >> (msb - kSubBucketBits)) & (kSubBuckets - 1));
+			return exponent * kSubBuckets + sub;
+		}
+
+		// Inclusive upper bound of a bucket in ns.
+		static uint64_t BucketUpperNs(int bucket)
+		{
+			int exponent = bucket / kSubBuckets;
+			int sub = bucket % kSubBuckets;
+			if (exponent == 0)
+				return (uint64_t)sub;
+			int shift = exponent - 1;
+			return ((((uint64_t)(kSubBuckets + sub)) + 1) << shift) - 1;
+		}
+
+		void Record(uint64_t ns)
+		{
+			m_buckets[BucketFor(ns)].fetch_add(1, std::memory_order_relaxed);
+			m_count.fetch_add(1, std::memory_order_relaxed);
+			m_sumNs.fetch_add(ns, std::memory_order_relaxed);
+			uint64_t prev = m_maxNs.load(std::memory_order_relaxed);
+			while (ns > prev && !m_maxNs.compare_exchange_weak(prev, ns, std::memory_order_relaxed))
+			{
+			}
+		}
+
+		struct Summary
+		{
+			uint64_t count = 0;
+			double meanNs = 0.0;
+			uint64_t p50Ns = 0;
+			uint64_t p95Ns = 0;
+			uint64_t p99Ns = 0;
+			uint64_t maxNs = 0;
+		};
+
+		Summary Summarize() const
+		{
+			Summary s;
+			uint64_t counts[kBucketCount];
+			uint64_t total = 0;
+			for (int i = 0; i < kBucketCount; i++)
+			{
+				counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+				total += counts[i];
+			}
+			s.count = total;
+			if (total == 0)
+				return s;
+			s.meanNs = (double)m_sumNs.load(std::memory_order_relaxed) / (double)m_count.load(std::memory_order_relaxed);
+			s.maxNs = m_maxNs.load(std::memory_order_relaxed);
+			s.p50Ns = Percentile(counts, total, 0.50, s.maxNs);
+			s.p95Ns = Percentile(counts, total, 0.95, s.maxNs);
+			s.p99Ns = Percentile(counts, total, 0.99, s.maxNs);
+			return s;
+		}
+
+		void Reset()
+		{
+			for (auto &b : m_buckets)
+				b.store(0, std::memory_order_relaxed);
+			m_count.store(0, std::memory_order_relaxed);
+			m_sumNs.store(0, std::memory_order_relaxed);
+			m_maxNs.store(0, std::memory_order_relaxed);
+		}
+
+	private:
+		static uint64_t Percentile(const uint64_t *counts, uint64_t total, double q, uint64_t maxNs)
+		{
+			uint64_t rank = (uint64_t)(q * (double)total + 0.5);
+			if (rank == 0)
+				rank = 1;
+			uint64_t seen = 0;
+			for (int i = 0; i < kBucketCount; i++)
+			{
+				seen += counts[i];
+				if (seen >= rank)
+				{
+					uint64_t upper = BucketUpperNs(i);
+					return upper < maxNs ? upper : maxNs;
+				}
+			}
+			return maxNs;
+		}
+
+		std::atomic<uint64_t> m_buckets[kBucketCount] = {};
+		std::atomic<uint64_t> m_count{0};
+		std::atomic<uint64_t> m_sumNs{0};
+		std::atomic<uint64_t> m_maxNs{0};
+	};
+
+	//---------------------------------------------------------------------
+	//	Ring buffer
+	//---------------------------------------------------------------------
+	struct Event
+	{
+		uint32_t op = 0;
+		uint32_t threadId = 0;
+		uint64_t startNs = 0;
+		uint64_t durationNs = 0;
+	};
+
+	// Multi-producer ring: writers claim a slot with fetch_add and publish
+	// it through a per-slot sequence number (odd while writing), so readers
+	// can skip torn or overwritten slots without taking a lock. A writer
+	// lapped by a full ring while mid-write can still leave a mixed slot;
+	// this is diagnostics, not a log of record.
+	class Ring
+	{
+	public:
+		void Push(const Event &e)
+		{
+			uint64_t ticket = m_head.fetch_add(1, std::memory_order_relaxed);
+			Slot &slot = m_slots[ticket & (kRingCapacity - 1)];
+			uint64_t seq = ticket * 2 + 1;
+			slot.seq.store(seq, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			slot.op.store(e.op, std::memory_order_relaxed);
+			slot.threadId.store(e.threadId, std::memory_order_relaxed);
+			slot.startNs.store(e.startNs, std::memory_order_relaxed);
+			slot.durationNs.store(e.durationNs, std::memory_order_relaxed);
+			slot.seq.store(seq + 1, std::memory_order_release);
+		}
+
+		// Copy out the most recent events (oldest first).
+		std::vector<Event> Snapshot() const
+		{
+			std::vector<Event> out;
+			uint64_t head = m_head.load(std::memory_order_acquire);
+			uint64_t first = head > kRingCapacity ? head - kRingCapacity : 0;
+			out.reserve((size_t)(head - first));
+			for (uint64_t ticket = first; ticket < head; ticket++)
+			{
+				const Slot &slot = m_slots[ticket & (kRingCapacity - 1)];
+				uint64_t expected = ticket * 2 + 2;
+				if (slot.seq.load(std::memory_order_acquire) != expected)
+					continue;
+				Event e;
+				e.op = slot.op.load(std::memory_order_relaxed);
+				e.threadId = slot.threadId.load(std::memory_order_relaxed);
+				e.startNs = slot.startNs.load(std::memory_order_relaxed);
+				e.durationNs = slot.durationNs.load(std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (slot.seq.load(std::memory_order_acquire) != expected)
+					continue;
+				out.push_back(e);
+			}
+			return out;
+		}
+
+		uint64_t Written() const { return m_head.load(std::memory_order_relaxed); }
+
+		void Reset()
+		{
+			m_head.store(0, std::memory_order_relaxed);
+			for (auto &s : m_slots)
+				s.seq.store(0, std::memory_order_relaxed);
+		}
+
+	private:
+		struct Slot
+		{
+			std::atomic<uint64_t> seq{0};
+			std::atomic<uint32_t> op{0};
+			std::atomic<uint32_t> threadId{0};
+			std::atomic<uint64_t> startNs{0};
+			std::atomic<uint64_t> durationNs{0};
+		};
+
+		std::atomic<uint64_t> m_head{0};
+		Slot m_slots[kRingCapacity];
+	};
+
+	//---------------------------------------------------------------------
+	//	Registry
+	//---------------------------------------------------------------------
+	class Registry
+	{
+	public:
+		static Registry &Get()
+		{
+			static Registry registry;
+			return registry;
+		}
+
+		bool IsEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+		void SetEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+
+		// Returns a stable id for `name` (a string literal). Ops beyond
+		// kMaxOps share the last slot.
+		uint32_t RegisterOp(const char *name)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			uint32_t count = m_opCount.load(std::memory_order_relaxed);
+			for (uint32_t i = 0; i < count; i++)
+				if (std::string(m_opNames[i]) == name)
+					return i;
+			if (count >= kMaxOps)
+				return (uint32_t)kMaxOps - 1;
+			m_opNames[count] = name;
+			m_opCount.store(count + 1, std::memory_order_release);
+			return count;
+		}
+
+		void Record(uint32_t op, uint64_t startNs, uint64_t durationNs)
+		{
+			if (op >= kMaxOps)
+				return;
+			m_histograms[op].Record(durationNs);
+			m_ring.Push(Event{op, CurrentThreadId(), startNs, durationNs});
+		}
+
+		const char *OpName(uint32_t op) const
+		{
+			return op < OpCount() ? m_opNames[op] : "?";
+		}
+
+		uint32_t OpCount() const { return m_opCount.load(std::memory_order_acquire); }
+
+		Histogram::Summary Summarize(uint32_t op) const { return m_histograms[op].Summarize(); }
+		const Ring &GetRing() const { return m_ring; }
+
+		void Reset()
+		{
+			for (auto &h : m_histograms)
+				h.Reset();
+			m_ring.Reset();
+		}
+
+		// One line per operation with at least one sample.
+		std::vector<std::string> SummaryLines() const
+		{
+			std::vector<std::string> lines;
+			uint32_t ops = OpCount();
+			for (uint32_t op = 0; op < ops; op++)
+			{
+				Histogram::Summary s = Summarize(op);
+				if (s.count == 0)
+					continue;
+				char buf[256];
+				std::snprintf(buf, sizeof(buf), "%-24s n=%-7llu mean=%.3fms p50=%.3fms p95=%.3fms p99=%.3fms max=%.3fms",
+							  OpName(op), (unsigned long long)s.count, s.meanNs / 1e6, s.p50Ns / 1e6, s.p95Ns / 1e6,
+							  s.p99Ns / 1e6, s.maxNs / 1e6);
+				lines.push_back(buf);
+			}
+			return lines;
+		}
+
+		// Chrome trace event format ("X" complete events, microseconds).
+		void WriteChromeTrace(std::ostream &out) const
+		{
+			std::vector<Event> events = m_ring.Snapshot();
+			uint64_t origin = events.empty() ? 0 : events.front().startNs;
+			for (const auto &e : events)
+				if (e.startNs < origin)
+					origin = e.startNs;
+			out << "{\"traceEvents\":[";
+			bool first = true;
+			char buf[256];
+			for (const auto &e : events)
+			{
+				std::snprintf(buf, sizeof(buf), "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+							  first ? "" : ",\n", OpName(e.op), e.threadId, (double)(e.startNs - origin) / 1000.0,
+							  (double)e.durationNs / 1000.0);
+				out << buf;
+				first = false;
+			}
+			out << "],\"displayTimeUnit\":\"ms\"}\n";
+		}
+
+	private:
+		Registry() = default;
+
+		std::atomic<bool> m_enabled{false};
+		mutable std::mutex m_mutex;
+		const char *m_opNames[kMaxOps] = {};
+		std::atomic<uint32_t> m_opCount{0};
+		Histogram m_histograms[kMaxOps];
+		Ring m_ring;
+	};
+
+	inline bool IsEnabled() { return Registry::Get().IsEnabled(); }
+	inline void SetEnabled(bool enabled) { Registry::Get().SetEnabled(enabled); }
+
+	//---------------------------------------------------------------------
+	//	Scoped span
+	//---------------------------------------------------------------------
+	class Span
+	{
+	public:
+		explicit Span(uint32_t op) : m_op(op), m_startNs(IsEnabled() ? NowNs() : 0) {}
+		~Span()
+		{
+			if (m_startNs != 0)
+				Registry::Get().Record(m_op, m_startNs, NowNs() - m_startNs);
+		}
+		Span(const Span &) = delete;
+		Span &operator=(const Span &) = delete;
+
+	private:
+		uint32_t m_op;
+		uint64_t m_startNs;
+	};
+}
+
+#define FP_TRACE_CONCAT_(a, b) a##b
+#define FP_TRACE_CONCAT(a, b) FP_TRACE_CONCAT_(a, b)
+// Time the rest of the enclosing scope as operation `name` (a literal).
+#define FP_TRACE_SCOPE(name)                                                                   \
+	static const uint32_t FP_TRACE_CONCAT(fpTraceOp_, __LINE__) = Trace::Registry::Get().RegisterOp(name); \
+	Trace::Span FP_TRACE_CONCAT(fpTraceSpan_, __LINE__)(FP_TRACE_CONCAT(fpTraceOp_, __LINE__))
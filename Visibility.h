@@ -0,0 +1,130 @@
+//----------------------------------------------------------------------------------
+//	Visibility-aware background scheduling (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+
+// Tracks whether the preview window can be seen and derives from it how
+// much background work may run and whether rendering is worth doing:
+//
+//   Visible   all task priorities run, frames are presented
+//   Occluded  shown but fully covered (Present reported occlusion): only
+//             High tasks run, frames are skipped until a probe succeeds
+//   Hidden    hidden, docked away or minimised: no tasks run, no frames
+//
+// Tasks are never dropped by a state change, only held back; returning to
+// Visible lets the queues drain in priority order. A frame skipped while
+// not visible leaves the preview stale, which the caller repaints on the
+// transition back. UI-thread only: not synchronised.
+namespace Visibility
+{
+	enum class State : int
+	{
+		Visible = 0,
+		Occluded,
+		Hidden
+	};
+
+	inline const char *StateName(State s)
+	{
+		return s == State::Visible ? "visible" : s == State::Occluded ? "occluded" : "hidden";
+	}
+
+	struct Transition
+	{
+		bool changed = false;
+		State from = State::Visible;
+		State to = State::Visible;
+		bool repaint = false; // back to Visible with a frame skipped meanwhile
+	};
+
+	struct Stats
+	{
+		uint64_t transitions = 0;
+		uint64_t skippedFrames = 0;
+		uint64_t probes = 0;
+		uint64_t timesHidden = 0;
+		uint64_t timesOccluded = 0;
+	};
+
+	class Scheduler
+	{
+	public:
+		State Current() const { return m_state; }
+
+		// Number of TaskQueue priority levels allowed to run (High first).
+		unsigned RunnableLevels() const
+		{
+			return m_state == State::Visible ? 3u : m_state == State::Occluded ? 1u : 0u;
+		}
+
+		// True while occluded: the caller should periodically probe with a
+		// test present and report through SetOccluded.
+		bool NeedsProbe() const { return m_state == State::Occluded; }
+
+		Transition SetShown(bool shown)
+		{
+			m_shown = shown;
+			return Recompute();
+		}
+
+		Transition SetMinimized(bool minimized)
+		{
+			m_minimized = minimized;
+			return Recompute();
+		}
+
+		// From a real Present (DXGI_STATUS_OCCLUDED or success) or a probe.
+		Transition SetOccluded(bool occluded, bool probe = false)
+		{
+			if (probe)
+				m_stats.probes++;
+			m_occluded = occluded;
+			return Recompute();
+		}
+
+		// Call before drawing a frame. False means skip it; the preview is
+		// then marked stale for the next Visible transition.
+		bool BeginFrame()
+		{
+			if (m_state == State::Visible)
+				return true;
+			m_stats.skippedFrames++;
+			m_stale = true;
+			return false;
+		}
+
+		const Stats &GetStats() const { return m_stats; }
+
+	private:
+		Transition Recompute()
+		{
+			State next = (!m_shown || m_minimized) ? State::Hidden : m_occluded ? State::Occluded : State::Visible;
+			Transition t;
+			t.from = m_state;
+			t.to = next;
+			if (next == m_state)
+				return t;
+			t.changed = true;
+			m_state = next;
+			m_stats.transitions++;
+			if (next == State::Hidden)
+				m_stats.timesHidden++;
+			else if (next == State::Occluded)
+				m_stats.timesOccluded++;
+			else
+			{
+				t.repaint = m_stale;
+				m_stale = false;
+			}
+			return t;
+		}
+
+		State m_state = State::Visible;
+		bool m_shown = true;
+		bool m_minimized = false;
+		bool m_occluded = false;
+		bool m_stale = false;
+		Stats m_stats;
+	};
+}
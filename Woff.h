@@ -0,0 +1,700 @@
+//----------------------------------------------------------------------------------
+//	WOFF decoding and the decoded-font cache (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+// Web fonts arrive as WOFF (sfnt tables, each zlib-compressed) or WOFF2
+// (one Brotli stream with glyf/loca transformed). DirectWrite only reads
+// sfnt, so the plugin decodes them once into a content-addressed cache
+// folder and lists the decoded file. WOFF is decoded here, table by table
+// into a sink, so at most one table is held in memory; WOFF2 headers are
+// validated here and the payload is left to the platform decoder
+// (IDWriteFactory5::UnpackFontFile), since a Brotli decoder with its
+// dictionary is not part of this tree.
+namespace Woff
+{
+	enum class Container
+	{
+		Unknown,
+		Sfnt, // TTF/OTF/TTC
+		Woff,
+		Woff2,
+	};
+
+	constexpr uint32_t kWoffSignature = 0x774F4646;  // 'wOFF'
+	constexpr uint32_t kWoff2Signature = 0x774F4632; // 'wOF2'
+	constexpr uint32_t kFlavorCff = 0x4F54544F;		 // 'OTTO'
+	constexpr uint32_t kFlavorCollection = 0x74746366; // 'ttcf'
+	// Refuse to produce more than this from one file (decompression bombs).
+	constexpr uint64_t kMaxSfntSize = 256ull * 1024 * 1024;
+
+	namespace detail
+	{
+		inline bool Has(size_t size, size_t offset, size_t length)
+		{
+			return offset <= size && length <= size - offset;
+		}
+
+		inline uint16_t U16(const uint8_t *p) { return (uint16_t)((p[0] << 8) | p[1]); }
+		inline uint32_t U32(const uint8_t *p) { return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3]; }
+
+		inline void Put16(uint8_t *p, uint32_t v)
+		{
+			p[0] = (uint8_t)(v >> 8);
+			p[1] = (uint8_t)v;
+		}
+
+		inline void Put32(uint8_t *p, uint32_t v)
+		{
+			Put16(p, v >> 16);
+			Put16(p + 2, v & 0xFFFF);
+		}
+
+		// Canonical Huffman code of a deflate block. Codes of up to kFastBits
+		// bits resolve with one table lookup; longer ones walk the counts.
+		struct Huffman
+		{
+			static constexpr int kFastBits = 10;
+			uint16_t count[16] = {};
+			uint16_t symbol[320] = {};
+			uint16_t fast[1 << kFastBits] = {}; // (length << 9) | symbol, 0 = slow path
+
+			bool Build(const uint8_t *lengths, int n)
+			{
+				std::fill(std::begin(count), std::end(count), (uint16_t)0);
+				std::fill(std::begin(fast), std::end(fast), (uint16_t)0);
+				for (int i = 0; i < n; i++)
+					count[lengths[i]]++;
+				count[0] = 0;
+				int left = 1;
+				for (int len = 1; len < 16; len++)
+				{
+					left = (left << 1) - count[len];
+					if (left < 0)
+						return false; // over-subscribed
+				}
+				uint16_t offsets[16] = {};
+				for (int len = 1; len < 15; len++)
+					offsets[len + 1] = (uint16_t)(offsets[len] + count[len]);
+				for (int i = 0; i < n; i++)
+				{
+					if (lengths[i])
+						symbol[offsets[lengths[i]]++] = (uint16_t)i;
+				}
+				// Deflate sends codes most significant bit first; the bit
+				// reader yields them reversed.
+				uint32_t code = 0;
+				int index = 0;
+				for (int len = 1; len <= kFastBits; len++)
+				{
+					for (int k = 0; k < count[len]; k++, index++, code++)
+					{
+						uint32_t reversed = 0;
+						for (int b = 0; b < len; b++)
+							reversed |= ((code >> b) & 1) << (len - 1 - b);
+						for (uint32_t fill = reversed; fill < (1u << kFastBits); fill += 1u << len)
+							fast[fill] = (uint16_t)((len << 9) | symbol[index]);
+					}
+					code <<= 1;
+				}
+				return true;
+			}
+		};
+
+		class Inflater
+		{
+		public:
+			Inflater(const uint8_t *in, size_t inSize, uint8_t *out, size_t outSize)
+				: m_in(in), m_inSize(inSize), m_out(out), m_outSize(outSize) {}
+
+			// Raw deflate stream; true when it ends exactly at `outSize`.
+			bool Run()
+			{
+				static const uint16_t kLengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+				static const uint8_t kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+				static const uint16_t kDistBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+				static const uint8_t kDistExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+				bool last = false;
+				while (!last)
+				{
+					last = Bits(1) != 0;
+					uint32_t type = Bits(2);
+					if (type == 0)
+					{
+						if (!Stored())
+							return false;
+						continue;
+					}
+					if (type == 1)
+						Fixed();
+					else if (type != 2 || !Dynamic())
+						return false;
+					for (;;)
+					{
+						int sym = Decode(m_lit);
+						if (sym < 0)
+							return false;
+						if (sym < 256)
+						{
+							if (m_pos == m_outSize)
+								return false;
+							m_out[m_pos++] = (uint8_t)sym;
+							continue;
+						}
+						if (sym == 256)
+							break;
+						sym -= 257;
+						if (sym >= 29)
+							return false;
+						size_t length = kLengthBase[sym] + Bits(kLengthExtra[sym]);
+						int dsym = Decode(m_dist);
+						if (dsym < 0 || dsym >= 30)
+							return false;
+						size_t distance = kDistBase[dsym] + Bits(kDistExtra[dsym]);
+						if (m_error || distance > m_pos || length > m_outSize - m_pos)
+							return false;
+						uint8_t *dst = m_out + m_pos;
+						const uint8_t *src = dst - distance;
+						if (distance >= length)
+							std::copy(src, src + length, dst);
+						else
+						{
+							for (size_t i = 0; i < length; i++)
+								dst[i] = src[i]; // overlapping: repeats the last `distance` bytes
+						}
+						m_pos += length;
+					}
+					if (m_error)
+						return false;
+				}
+				return !m_error && m_pos == m_outSize;
+			}
+
+			// Bytes consumed, rounded up to a whole byte.
+			size_t Consumed() const { return m_next - m_bitCount / 8; }
+
+		private:
+			void Refill()
+			{
+				while (m_bitCount <= 56 && m_next < m_inSize)
+				{
+					m_bitBuf |= (uint64_t)m_in[m_next++] << m_bitCount;
+					m_bitCount += 8;
+				}
+			}
+
+			uint32_t Bits(int n)
+			{
+				if (n == 0)
+					return 0;
+				if (m_bitCount < n)
+				{
+					Refill();
+					if (m_bitCount < n)
+					{
+						m_error = true;
+						return 0;
+					}
+				}
+				uint32_t v = (uint32_t)(m_bitBuf & ((1ull << n) - 1));
+				m_bitBuf >>= n;
+				m_bitCount -= n;
+				return v;
+			}
+
+			int Decode(const Huffman &h)
+			{
+				if (m_bitCount < 15)
+					Refill();
+				uint32_t entry = h.fast[m_bitBuf & ((1u << Huffman::kFastBits) - 1)];
+				int len = (int)(entry >> 9);
+				if (entry && len <= m_bitCount)
+				{
+					m_bitBuf >>= len;
+					m_bitCount -= len;
+					return (int)(entry & 0x1FF);
+				}
+				// Longer code (or the stream's last bits): canonical walk.
+				int code = 0, first = 0, index = 0;
+				for (len = 1; len < 16; len++)
+				{
+					if (m_bitCount == 0)
+					{
+						m_error = true;
+						return -1;
+					}
+					code |= (int)(m_bitBuf & 1);
+					m_bitBuf >>= 1;
+					m_bitCount--;
+					int count = h.count[len];
+					if (code - count < first)
+						return h.symbol[index + (code - first)];
+					index += count;
+					first = (first + count) << 1;
+					code <<= 1;
+				}
+				m_error = true;
+				return -1;
+			}
+
+			bool Stored()
+			{
+				// Drop to the byte boundary, then LEN and NLEN.
+				Bits(m_bitCount % 8);
+				uint32_t len = Bits(16);
+				uint32_t nlen = Bits(16);
+				if (m_error || len != (~nlen & 0xFFFF))
+					return false;
+				// Whole bytes still in the bit buffer come first.
+				while (len && m_bitCount >= 8)
+				{
+					if (m_pos == m_outSize)
+						return false;
+					m_out[m_pos++] = (uint8_t)Bits(8);
+					len--;
+				}
+				if (!Has(m_inSize, m_next, len) || len > m_outSize - m_pos)
+					return false;
+				std::copy(m_in + m_next, m_in + m_next + len, m_out + m_pos);
+				m_next += len;
+				m_pos += len;
+				return true;
+			}
+
+			void Fixed()
+			{
+				uint8_t lengths[288 + 30];
+				std::fill(lengths, lengths + 144, (uint8_t)8);
+				std::fill(lengths + 144, lengths + 256, (uint8_t)9);
+				std::fill(lengths + 256, lengths + 280, (uint8_t)7);
+				std::fill(lengths + 280, lengths + 288, (uint8_t)8);
+				std::fill(lengths + 288, lengths + 318, (uint8_t)5);
+				m_lit.Build(lengths, 288);
+				m_dist.Build(lengths + 288, 30);
+			}
+
+			bool Dynamic()
+			{
+				static const uint8_t kOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+				int nlen = (int)Bits(5) + 257, ndist = (int)Bits(5) + 1, ncode = (int)Bits(4) + 4;
+				if (m_error || nlen > 286 || ndist > 30)
+					return false;
+				uint8_t lengths[320] = {};
+				for (int i = 0; i < ncode; i++)
+					lengths[kOrder[i]] = (uint8_t)Bits(3);
+				Huffman codeLengths;
+				if (m_error || !codeLengths.Build(lengths, 19))
+					return false;
+				std::fill(lengths, lengths + 19, (uint8_t)0);
+				for (int i = 0; i < nlen + ndist;)
+				{
+					int sym = Decode(codeLengths);
+					if (sym < 0)
+						return false;
+					if (sym < 16)
+					{
+						lengths[i++] = (uint8_t)sym;
+						continue;
+					}
+					int repeat = 0;
+					uint8_t value = 0;
+					if (sym == 16)
+					{
+						if (i == 0)
+							return false;
+						value = lengths[i - 1];
+						repeat = 3 + (int)Bits(2);
+					}
+					else if (sym == 17)
+						repeat = 3 + (int)Bits(3);
+					else
+						repeat = 11 + (int)Bits(7);
+					if (m_error || i + repeat > nlen + ndist)
+						return false;
+					while (repeat--)
+						lengths[i++] = value;
+				}
+				if (lengths[256] == 0)
+					return false; // no end-of-block code
+				return m_lit.Build(lengths, nlen) && m_dist.Build(lengths + nlen, ndist);
+			}
+
+			const uint8_t *m_in;
+			size_t m_inSize;
+			size_t m_next = 0;
+			uint8_t *m_out;
+			size_t m_outSize;
+			size_t m_pos = 0;
+			uint64_t m_bitBuf = 0;
+			int m_bitCount = 0;
+			bool m_error = false;
+			Huffman m_lit;
+			Huffman m_dist;
+		};
+
+		inline uint32_t Adler32(const uint8_t *data, size_t size)
+		{
+			uint32_t a = 1, b = 0;
+			while (size)
+			{
+				size_t n = std::min<size_t>(size, 5552); // keeps b below 2^32 between reductions
+				size -= n;
+				while (n--)
+				{
+					a += *data++;
+					b += a;
+				}
+				a %= 65521;
+				b %= 65521;
+			}
+			return (b << 16) | a;
+		}
+	}
+
+	// A zlib stream (RFC 1950) that must decompress to exactly `outSize`
+	// bytes; the trailing Adler-32 is checked.
+	inline bool Uncompress(const uint8_t *in, size_t inSize, uint8_t *out, size_t outSize)
+	{
+		using namespace detail;
+		if (inSize < 6 || (in[0] & 0x0F) != 8 || (in[0] >> 4) > 7 || ((in[0] << 8) | in[1]) % 31 != 0 || (in[1] & 0x20))
+			return false;
+		Inflater inflater(in + 2, inSize - 2, out, outSize);
+		if (!inflater.Run())
+			return false;
+		size_t end = 2 + inflater.Consumed();
+		return Has(inSize, end, 4) && U32(in + end) == Adler32(out, outSize);
+	}
+
+	inline Container Detect(const uint8_t *data, size_t size)
+	{
+		if (!data || size < 4)
+			return Container::Unknown;
+		uint32_t tag = detail::U32(data);
+		if (tag == kWoffSignature)
+			return Container::Woff;
+		if (tag == kWoff2Signature)
+			return Container::Woff2;
+		if (tag == 0x00010000 || tag == kFlavorCff || tag == 0x74727565 || tag == kFlavorCollection)
+			return Container::Sfnt;
+		return Container::Unknown;
+	}
+
+	struct Table
+	{
+		uint32_t tag = 0;
+		uint32_t offset = 0;
+		uint32_t compLength = 0;
+		uint32_t origLength = 0;
+		uint32_t origChecksum = 0;
+	};
+
+	struct Header
+	{
+		uint32_t flavor = 0;
+		uint32_t totalSfntSize = 0; // as declared
+		std::vector<Table> tables;	// in directory (tag) order
+
+		uint32_t MaxTableLength() const
+		{
+			uint32_t m = 0;
+			for (const auto &t : tables)
+				m = std::max(m, t.origLength);
+			return m;
+		}
+
+		// Size of the sfnt Decode produces.
+		uint64_t SfntSize() const
+		{
+			uint64_t size = 12 + 16 * (uint64_t)tables.size();
+			for (const auto &t : tables)
+				size += ((uint64_t)t.origLength + 3) & ~3ull;
+			return size;
+		}
+	};
+
+	// WOFF 1.0 header and table directory; every table range is checked
+	// against the file.
+	inline bool ReadHeader(const uint8_t *data, size_t size, Header &out)
+	{
+		using namespace detail;
+		out = Header{};
+		if (!data || size < 44 || U32(data) != kWoffSignature)
+			return false;
+		out.flavor = U32(data + 4);
+		uint16_t numTables = U16(data + 12);
+		out.totalSfntSize = U32(data + 16);
+		if (numTables == 0 || !Has(size, 44, (size_t)numTables * 20))
+			return false;
+		out.tables.resize(numTables);
+		for (uint16_t i = 0; i < numTables; i++)
+		{
+			const uint8_t *rec = data + 44 + (size_t)i * 20;
+			Table &t = out.tables[i];
+			t.tag = U32(rec);
+			t.offset = U32(rec + 4);
+			t.compLength = U32(rec + 8);
+			t.origLength = U32(rec + 12);
+			t.origChecksum = U32(rec + 16);
+			if (!Has(size, t.offset, t.compLength) || t.compLength > t.origLength)
+				return false;
+		}
+		return out.SfntSize() <= kMaxSfntSize;
+	}
+
+	// Decode a WOFF file into the sfnt it wraps, calling
+	// `write(const uint8_t *, size_t)` (returning bool) with consecutive
+	// pieces: the sfnt header and directory, then each table padded to four
+	// bytes, in the order the tables appear in the WOFF file (which keeps
+	// the original layout). `scratch` holds one table at a time. Returns
+	// false on malformed input or when `write` fails.
+	template <typename Write>
+	bool Decode(const uint8_t *data, size_t size, Write &&write, std::vector<uint8_t> &scratch)
+	{
+		using namespace detail;
+		Header header;
+		if (!ReadHeader(data, size, header))
+			return false;
+		const size_t count = header.tables.size();
+		std::vector<size_t> order(count);
+		for (size_t i = 0; i < count; i++)
+			order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+						 { return header.tables[a].offset < header.tables[b].offset; });
+		std::vector<uint32_t> outOffsets(count);
+		uint32_t offset = (uint32_t)(12 + 16 * count);
+		for (size_t i : order)
+		{
+			outOffsets[i] = offset;
+			offset += (header.tables[i].origLength + 3) & ~3u;
+		}
+
+		uint16_t entrySelector = 0;
+		while ((2u << entrySelector) <= count)
+			entrySelector++;
+		uint16_t searchRange = (uint16_t)(16u << entrySelector);
+		scratch.assign(12 + 16 * count, 0);
+		Put32(&scratch[0], header.flavor);
+		Put16(&scratch[4], (uint32_t)count);
+		Put16(&scratch[6], searchRange);
+		Put16(&scratch[8], entrySelector);
+		Put16(&scratch[10], (uint32_t)(16 * count - searchRange));
+		for (size_t i = 0; i < count; i++)
+		{
+			uint8_t *rec = &scratch[12 + 16 * i];
+			const Table &t = header.tables[i];
+			Put32(rec, t.tag);
+			Put32(rec + 4, t.origChecksum);
+			Put32(rec + 8, outOffsets[i]);
+			Put32(rec + 12, t.origLength);
+		}
+		if (!write(scratch.data(), scratch.size()))
+			return false;
+
+		for (size_t i : order)
+		{
+			const Table &t = header.tables[i];
+			size_t padded = ((size_t)t.origLength + 3) & ~(size_t)3;
+			scratch.assign(padded, 0);
+			const uint8_t *src = data + t.offset;
+			if (t.compLength == t.origLength)
+				std::copy(src, src + t.compLength, scratch.begin());
+			else if (!Uncompress(src, t.compLength, scratch.data(), t.origLength))
+				return false;
+			if (!write(scratch.data(), scratch.size()))
+				return false;
+		}
+		return true;
+	}
+
+	inline bool DecodeToBuffer(const uint8_t *data, size_t size, std::vector<uint8_t> &out)
+	{
+		out.clear();
+		std::vector<uint8_t> scratch;
+		return Decode(
+			data, size, [&](const uint8_t *p, size_t n)
+			{ out.insert(out.end(), p, p + n); return true; },
+			scratch);
+	}
+
+	//---------------------------------------------------------------------
+	//	WOFF2 (header and table directory only)
+	//---------------------------------------------------------------------
+	struct Woff2Info
+	{
+		uint32_t flavor = 0;
+		uint32_t totalSfntSize = 0;
+		uint32_t totalCompressedSize = 0;
+		uint16_t numTables = 0;
+		bool transformedGlyf = false; // glyf/loca need reconstruction
+		bool collection = false;
+	};
+
+	namespace detail
+	{
+		inline bool ReadBase128(const uint8_t *data, size_t size, size_t &pos, uint32_t &out)
+		{
+			uint32_t v = 0;
+			for (int i = 0; i < 5; i++)
+			{
+				if (pos >= size)
+					return false;
+				uint8_t b = data[pos++];
+				if ((i == 0 && b == 0x80) || (v & 0xFE000000u))
+					return false; // leading zeros / overflow
+				v = (v << 7) | (b & 0x7F);
+				if (!(b & 0x80))
+				{
+					out = v;
+					return true;
+				}
+			}
+			return false;
+		}
+	}
+
+	// Validate a WOFF2 header and walk its table directory, so a damaged
+	// file is rejected before it reaches the platform decoder.
+	inline bool ReadWoff2Header(const uint8_t *data, size_t size, Woff2Info &out)
+	{
+		using namespace detail;
+		out = Woff2Info{};
+		if (!data || size < 48 || U32(data) != kWoff2Signature || U32(data + 8) != size)
+			return false;
+		out.flavor = U32(data + 4);
+		out.numTables = U16(data + 12);
+		out.totalSfntSize = U32(data + 16);
+		out.totalCompressedSize = U32(data + 20);
+		out.collection = out.flavor == kFlavorCollection;
+		if (out.numTables == 0 || out.totalSfntSize > kMaxSfntSize)
+			return false;
+		const uint32_t kGlyf = 0x676C7966, kLoca = 0x6C6F6361;
+		static const char kKnownTags[63][5] = {
+			"cmap", "head", "hhea", "hmtx", "maxp", "name", "OS/2", "post", "cvt ", "fpgm", "glyf", "loca", "prep", "CFF ", "VORG", "EBDT",
+			"EBLC", "gasp", "hdmx", "kern", "LTSH", "PCLT", "VDMX", "vhea", "vmtx", "BASE", "GDEF", "GPOS", "GSUB", "EBSC", "JSTF", "MATH",
+			"CBDT", "CBLC", "COLR", "CPAL", "SVG ", "sbix", "acnt", "avar", "bdat", "bloc", "bsln", "cvar", "fdsc", "feat", "fmtx", "fvar",
+			"gvar", "hsty", "just", "lcar", "mort", "morx", "opbd", "prop", "trak", "Zapf", "Silf", "Glat", "Gloc", "Feat", "Sill"};
+		size_t pos = 48;
+		for (uint16_t i = 0; i < out.numTables; i++)
+		{
+			if (pos >= size)
+				return false;
+			uint8_t flags = data[pos++];
+			uint32_t tag;
+			if ((flags & 0x3F) == 0x3F)
+			{
+				if (!Has(size, pos, 4))
+					return false;
+				tag = U32(data + pos);
+				pos += 4;
+			}
+			else
+				tag = U32((const uint8_t *)kKnownTags[flags & 0x3F]);
+			uint32_t origLength = 0, transformLength = 0;
+			if (!ReadBase128(data, size, pos, origLength))
+				return false;
+			uint8_t version = flags >> 6;
+			// glyf and loca are transformed at version 0, other tables at
+			// any other version.
+			bool transformed = (tag == kGlyf || tag == kLoca) ? version == 0 : version != 0;
+			if (transformed)
+			{
+				if (!ReadBase128(data, size, pos, transformLength))
+					return false;
+				if (tag == kGlyf)
+					out.transformedGlyf = true;
+			}
+		}
+		return Has(size, pos, out.totalCompressedSize);
+	}
+
+	//---------------------------------------------------------------------
+	//	Decoded-font cache
+	//---------------------------------------------------------------------
+	// Decoded sfnt files named by the content hash of the web font they came
+	// from, so a renamed or copied file hits the same entry and a changed
+	// one gets a new entry. Files are written under a temporary name and
+	// renamed into place, so a reader never sees a partial file and two
+	// writers of the same entry are harmless.
+	class DecodedCache
+	{
+	public:
+		explicit DecodedCache(std::filesystem::path dir = std::filesystem::path()) : m_dir(std::move(dir)) {}
+
+		const std::filesystem::path &Dir() const { return m_dir; }
+
+		static std::string FileName(uint64_t contentHash, uint32_t flavor)
+		{
+			char name[32];
+			std::snprintf(name, sizeof(name), "%016llx%s", (unsigned long long)contentHash, flavor == kFlavorCff ? ".otf" : flavor == kFlavorCollection ? ".ttc" : ".ttf");
+			return name;
+		}
+
+		std::filesystem::path PathFor(uint64_t contentHash, uint32_t flavor) const
+		{
+			return m_dir / FileName(contentHash, flavor);
+		}
+
+		bool Contains(uint64_t contentHash, uint32_t flavor) const
+		{
+			std::error_code ec;
+			return std::filesystem::file_size(PathFor(contentHash, flavor), ec) > 0 && !ec;
+		}
+
+		// Run `produce(write)` into a temporary file and publish it as the
+		// entry; `write(const uint8_t *, size_t)` appends to the file.
+		template <typename Produce>
+		bool Store(uint64_t contentHash, uint32_t flavor, const std::string &writerTag, Produce &&produce) const
+		{
+			std::error_code ec;
+			std::filesystem::create_directories(m_dir, ec);
+			std::filesystem::path final = PathFor(contentHash, flavor);
+			std::filesystem::path temp = final;
+			temp += "." + writerTag + ".tmp";
+			bool ok;
+			{
+				std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+				ok = (bool)out && produce([&](const uint8_t *p, size_t n)
+										  { return (bool)out.write((const char *)p, (std::streamsize)n); });
+				ok = ok && (bool)out.flush();
+			}
+			if (ok)
+			{
+				std::filesystem::rename(temp, final, ec);
+				ok = !ec || Contains(contentHash, flavor); // lost a race to an identical entry
+			}
+			std::filesystem::remove(temp, ec);
+			return ok;
+		}
+
+		// Remove entries not in `live` (file names as FileName returns);
+		// returns the number removed. Files in use stay until next time.
+		size_t Prune(const std::vector<std::string> &live) const
+		{
+			std::error_code ec;
+			size_t removed = 0;
+			std::filesystem::directory_iterator it(m_dir, ec), end;
+			for (; !ec && it != end; it.increment(ec))
+			{
+				std::string name = it->path().filename().string();
+				if (name.size() < 16 || std::find(live.begin(), live.end(), name) != live.end())
+					continue;
+				std::error_code rm;
+				if (std::filesystem::remove(it->path(), rm) && !rm)
+					removed++;
+			}
+			return removed;
+		}
+
+	private:
+		std::filesystem::path m_dir;
+	};
+}
@@ -0,0 +1,295 @@
+//----------------------------------------------------------------------------------
+//	Zip central directory index (portable)
+//----------------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cctype>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Font packs are often distributed as .zip files. Entries stored without
+// compression are byte ranges of the archive, so a font inside one can be
+// served straight from a view of the archive with no extraction. This
+// reads the central directory (including Zip64 sizes and offsets) from an
+// in-memory image, resolves where each entry's data starts from its local
+// header, and rejects anything that points outside the image. Compressed
+// and encrypted entries are listed but not servable. Nothing here copies
+// entry data.
+namespace ZipIndex
+{
+	enum Method : uint16_t
+	{
+		kStored = 0,
+		kDeflated = 8,
+	};
+
+	struct Entry
+	{
+		std::string name; // as stored: UTF-8 when `utf8`, else the creator's code page
+		bool utf8 = false;
+		bool encrypted = false;
+		uint16_t method = kStored;
+		uint32_t crc32 = 0;
+		uint64_t compressedSize = 0;
+		uint64_t size = 0;
+		uint64_t localHeaderOffset = 0;
+		uint64_t dataOffset = 0; // valid when Servable()
+
+		bool IsDirectory() const { return !name.empty() && name.back() == '/'; }
+		// The bytes [dataOffset, dataOffset + size) are the file itself.
+		bool Servable() const { return method == kStored && !encrypted && compressedSize == size && dataOffset != 0; }
+	};
+
+	struct Stats
+	{
+		size_t entries = 0;
+		size_t servable = 0;
+		size_t compressed = 0; // needs inflating; skipped
+		size_t encrypted = 0;
+		size_t invalid = 0; // local header missing or out of bounds
+	};
+
+	// CRC-32 (IEEE), as stored per entry; lets a caller verify a stored
+	// entry before trusting it.
+	inline uint32_t Crc32(const uint8_t *data, size_t size, uint32_t crc = 0)
+	{
+		static const auto table = []
+		{
+			std::vector<uint32_t> t(256);
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t c = i;
+				for (int k = 0; k < 8; k++)
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				t[i] = c;
+			}
+			return t;
+		}();
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	namespace detail
+	{
+		constexpr uint32_t kEocdSignature = 0x06054b50;
+		constexpr uint32_t kZip64EocdSignature = 0x06064b50;
+		constexpr uint32_t kZip64LocatorSignature = 0x07064b50;
+		constexpr uint32_t kCentralSignature = 0x02014b50;
+		constexpr uint32_t kLocalSignature = 0x04034b50;
+		constexpr size_t kEocdSize = 22;
+		constexpr size_t kMaxComment = 0xFFFF;
+
+		inline bool Has(uint64_t size, uint64_t offset, uint64_t length)
+		{
+			return offset <= size && length <= size - offset;
+		}
+
+		inline uint16_t U16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+		inline uint32_t U32(const uint8_t *p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24); }
+		inline uint64_t U64(const uint8_t *p) { return (uint64_t)U32(p) | ((uint64_t)U32(p + 4) << 32); }
+
+		// Last end-of-central-directory record; it sits before a comment of
+		// at most 64 KiB.
+		inline bool FindEocd(const uint8_t *data, size_t size, size_t &out)
+		{
+			if (size < kEocdSize)
+				return false;
+			size_t lowest = size - kEocdSize > kMaxComment ? size - kEocdSize - kMaxComment : 0;
+			for (size_t pos = size - kEocdSize + 1; pos-- > lowest;)
+			{
+				if (U32(data + pos) == kEocdSignature && pos + kEocdSize + U16(data + pos + 20) == size)
+				{
+					out = pos;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// Extra fields of a central record: Zip64 extended information (the
+		// 0xFFFFFFFF fields of the record, in order) and Info-ZIP's Unicode
+		// path (a UTF-8 name, valid while the CRC of the stored name matches).
+		inline void ReadExtra(const uint8_t *extra, size_t length, uint32_t size32, uint32_t compressed32, uint32_t offset32, Entry &e)
+		{
+			size_t pos = 0;
+			while (pos + 4 <= length)
+			{
+				uint16_t id = U16(extra + pos);
+				size_t len = U16(extra + pos + 2);
+				pos += 4;
+				if (len > length - pos)
+					return;
+				if (id == 0x0001)
+				{
+					size_t at = pos, end = pos + len;
+					if (size32 == 0xFFFFFFFFu && at + 8 <= end)
+					{
+						e.size = U64(extra + at);
+						at += 8;
+					}
+					if (compressed32 == 0xFFFFFFFFu && at + 8 <= end)
+					{
+						e.compressedSize = U64(extra + at);
+						at += 8;
+					}
+					if (offset32 == 0xFFFFFFFFu && at + 8 <= end)
+						e.localHeaderOffset = U64(extra + at);
+				}
+				else if (id == 0x7075 && len >= 5 && extra[pos] == 1 && !e.utf8 &&
+						 U32(extra + pos + 1) == Crc32((const uint8_t *)e.name.data(), e.name.size()))
+				{
+					e.name.assign((const char *)extra + pos + 5, len - 5);
+					e.utf8 = true;
+				}
+				pos += len;
+			}
+		}
+	}
+
+	// Index every entry of the archive image. Returns false when there is
+	// no readable central directory; individual bad entries are counted in
+	// `stats` and left unservable.
+	inline bool Read(const uint8_t *data, size_t size, std::vector<Entry> &out, Stats *stats = nullptr)
+	{
+		using namespace detail;
+		out.clear();
+		Stats local;
+		Stats &s = stats ? *stats : local;
+		s = Stats{};
+		size_t eocd = 0;
+		if (!data || !FindEocd(data, size, eocd))
+			return false;
+		uint64_t count = U16(data + eocd + 10);
+		uint64_t dirSize = U32(data + eocd + 12);
+		uint64_t dirOffset = U32(data + eocd + 16);
+		if ((count == 0xFFFF || dirSize == 0xFFFFFFFFu || dirOffset == 0xFFFFFFFFu) && eocd >= 20 &&
+			U32(data + eocd - 20) == kZip64LocatorSignature)
+		{
+			uint64_t z64 = U64(data + eocd - 20 + 8);
+			if (!Has(size, z64, 56) || U32(data + z64) != kZip64EocdSignature)
+				return false;
+			count = U64(data + z64 + 32);
+			dirSize = U64(data + z64 + 40);
+			dirOffset = U64(data + z64 + 48);
+		}
+		if (!Has(size, dirOffset, dirSize) || count > dirSize / 46)
+			return false;
+		out.reserve((size_t)count);
+		uint64_t pos = dirOffset, end = dirOffset + dirSize;
+		for (uint64_t i = 0; i < count; i++)
+		{
+			if (!Has(end, pos, 46) || U32(data + pos) != kCentralSignature)
+				return false;
+			const uint8_t *rec = data + pos;
+			uint16_t flags = U16(rec + 8);
+			size_t nameLen = U16(rec + 28), extraLen = U16(rec + 30), commentLen = U16(rec + 32);
+			if (!Has(end, pos + 46, (uint64_t)nameLen + extraLen + commentLen))
+				return false;
+			Entry e;
+			e.name.assign((const char *)rec + 46, nameLen);
+			e.utf8 = (flags & 0x0800) != 0;
+			e.encrypted = (flags & 0x0001) != 0;
+			e.method = U16(rec + 10);
+			e.crc32 = U32(rec + 16);
+			uint32_t compressed32 = U32(rec + 20), size32 = U32(rec + 24), offset32 = U32(rec + 42);
+			e.compressedSize = compressed32;
+			e.size = size32;
+			e.localHeaderOffset = offset32;
+			ReadExtra(rec + 46 + nameLen, extraLen, size32, compressed32, offset32, e);
+			pos += 46 + nameLen + extraLen + commentLen;
+
+			s.entries++;
+			if (e.encrypted)
+				s.encrypted++;
+			else if (e.method != kStored)
+				s.compressed++;
+			else if (Has(size, e.localHeaderOffset, 30) && U32(data + e.localHeaderOffset) == kLocalSignature)
+			{
+				// The local header's name and extra lengths may differ from
+				// the central record's.
+				const uint8_t *lh = data + e.localHeaderOffset;
+				uint64_t dataOffset = e.localHeaderOffset + 30 + U16(lh + 26) + U16(lh + 28);
+				if (Has(size, dataOffset, e.compressedSize))
+					e.dataOffset = dataOffset;
+			}
+			if (e.Servable())
+				s.servable++;
+			else if (!e.encrypted && e.method == kStored)
+				s.invalid++;
+			out.push_back(std::move(e));
+		}
+		return true;
+	}
+
+	// Archivers on Linux and macOS often store UTF-8 names without setting
+	// the flag; a name that decodes as UTF-8 almost certainly is.
+	inline bool IsValidUtf8(const std::string &s)
+	{
+		for (size_t i = 0; i < s.size();)
+		{
+			uint8_t b = (uint8_t)s[i];
+			size_t extra = b < 0x80 ? 0 : (b & 0xE0) == 0xC0 ? 1 : (b & 0xF0) == 0xE0 ? 2 : (b & 0xF8) == 0xF0 ? 3 : 4;
+			if (extra == 4 || (extra == 1 && b < 0xC2) || i + extra >= s.size() + (extra == 0 ? 1 : 0))
+				return false;
+			for (size_t k = 1; k <= extra; k++)
+			{
+				if (((uint8_t)s[i + k] & 0xC0) != 0x80)
+					return false;
+			}
+			i += extra + 1;
+		}
+		return true;
+	}
+
+	// A TTF/OTF/TTC entry, skipping macOS resource forks.
+	inline bool IsFontEntry(const Entry &e)
+	{
+		if (e.IsDirectory() || e.name.compare(0, 9, "__MACOSX/") == 0)
+			return false;
+		size_t dot = e.name.rfind('.');
+		if (dot == std::string::npos)
+			return false;
+		std::string ext = e.name.substr(dot);
+		for (char &c : ext)
+			c = (char)std::tolower((unsigned char)c);
+		return ext == ".ttf" || ext == ".otf" || ext == ".ttc";
+	}
+
+	// Font files a pack can serve without extraction.
+	inline bool IsServableFont(const Entry &e)
+	{
+		return e.Servable() && IsFontEntry(e);
+	}
+
+	// Entry lookup by stored name.
+	class Index
+	{
+	public:
+		bool Assign(const uint8_t *data, size_t size, Stats *stats = nullptr)
+		{
+			m_byName.clear();
+			if (!Read(data, size, m_entries, stats))
+				return false;
+			m_byName.reserve(m_entries.size());
+			for (size_t i = 0; i < m_entries.size(); i++)
+				m_byName.emplace(m_entries[i].name, i);
+			return true;
+		}
+
+		const std::vector<Entry> &Entries() const { return m_entries; }
+
+		const Entry *Find(const std::string &name) const
+		{
+			auto it = m_byName.find(name);
+			return it == m_byName.end() ? nullptr : &m_entries[it->second];
+		}
+
+	private:
+		std::vector<Entry> m_entries;
+		std::unordered_map<std::string, size_t> m_byName;
+	};
+}